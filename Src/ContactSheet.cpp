@@ -112,7 +112,7 @@ void TexView::ShowContactSheetDialog(bool* popen, bool justOpened)
 	ImGui::SameLine();
 	ShowHelpMark("Filtering method to use when resizing images.");
 
-	const char* fileTypeItems[] = { "tga", "png", "bmp", "jpg", "gif" };
+	const char* fileTypeItems[] = { "tga", "png", "bmp", "jpg", "gif", "qoi" };
 	ImGui::Combo("File Type", &Config.FileSaveType, fileTypeItems, tNumElements(fileTypeItems));
 	ImGui::SameLine();
 	ShowHelpMark("Output image format. JPG and GIF do not support alpha channel.");
@@ -125,11 +125,21 @@ void TexView::ShowContactSheetDialog(bool* popen, bool justOpened)
 		case 2: extension = ".bmp"; break;
 		case 3: extension = ".jpg"; break;
 		case 4: extension = ".gif"; break;
+		case 5: extension = ".qoi"; break;
 	}
 
 	if (Config.FileSaveType == 0)
 		ImGui::Checkbox("RLE Compression", &Config.FileSaveTargaRLE);
 
+	if (Config.FileSaveType == 1)
+	{
+		// Matches tImage::tFilePNG::tLevel.
+		const char* pngLevelItems[] = { "Fastest", "Fast", "Default", "Smallest" };
+		ImGui::Combo("PNG Compression", &Config.FileSavePNGLevel, pngLevelItems, tNumElements(pngLevelItems));
+		ImGui::SameLine();
+		ShowHelpMark("Trades saving speed for file size. The image is always lossless.");
+	}
+
 	static char filename[128] = "ContactSheet";
 	ImGui::InputText("Filename", filename, tNumElements(filename));
 	ImGui::SameLine(); ShowHelpMark("The output filename without extension.");
@@ -222,16 +232,20 @@ void TexView::ShowContactSheetDialog(bool* popen, bool justOpened)
 		{
 			if (Config.FileSaveType == 0)
 				outPic.SaveTGA(outFile, tImage::tFileTGA::tFormat::Auto, Config.FileSaveTargaRLE ? tImage::tFileTGA::tCompression::RLE : tImage::tFileTGA::tCompression::None);
+			else if (Config.FileSaveType == 1)
+				outPic.SavePNG(outFile, tImage::tFilePNG::tFormat::Auto, tImage::tFilePNG::tLevel(Config.FileSavePNGLevel));
 			else
 				outPic.Save(outFile, colourFmt);
 		}
 		else
 		{
-			tImage::tPicture finalResampled(outPic);
+			tImage::tPicture finalResampled(std::move(outPic));
 			finalResampled.Resample(finalWidth, finalHeight, tImage::tPicture::tFilter(Config.ResampleFilter));
 
 			if (Config.FileSaveType == 0)
 				finalResampled.SaveTGA(outFile, tImage::tFileTGA::tFormat::Auto, Config.FileSaveTargaRLE ? tImage::tFileTGA::tCompression::RLE : tImage::tFileTGA::tCompression::None);
+			else if (Config.FileSaveType == 1)
+				finalResampled.SavePNG(outFile, tImage::tFilePNG::tFormat::Auto, tImage::tFilePNG::tLevel(Config.FileSavePNGLevel));
 			else
 				finalResampled.Save(outFile, colourFmt);
 		}
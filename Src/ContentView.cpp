@@ -88,7 +88,16 @@ void TexView::ShowContentViewDialog(bool* popen)
 				tSystem::tConvertTimeToString(i->FileModTime).Chars(),
 				i->FileSizeB
 			);
+
+			// Probing only reads the file header so it's fine to do for every visible item.
+			if (i->Probe())
+			{
+				tString infoText;
+				tsPrintf(infoText, "\n%d x %d %s", i->Info.Width, i->Info.Height, i->Info.PixelFormat.Chars());
+				tooltipText += infoText;
+			}
 			ShowToolTip(tooltipText.Chars());
+			UpdateCatalog(i);
 
 			// We use a separator to indicate the current item.
 			if (isCurr)
@@ -17,6 +17,8 @@
 #include <Math/tVector2.h>
 #include <Foundation/tVersion.h>
 #include <System/tFile.h>
+#include <Image/tBandPipeline.h>
+#include <Image/tFileJPG.h>
 #include "imgui.h"
 #include "Dialogs.h"
 #include "TacitImage.h"
@@ -32,6 +34,7 @@ namespace TexView
 	bool DoOverwriteFileModal(const tString& outFile, int finalWidth, int finalHeight);
 
 	void SaveAllImages(const tString& extension, float percent, int width, int height);
+	bool SaveStreamed(const tString& outFile, tImage::tBandSource&, int outW, int outH);
 	void GetFilesNeedingOverwrite(tListZ<tStringItem>& overwriteFiles, const tString& extension);
 	void DoOverwriteMultipleFilesModal(const tListZ<tStringItem>& overwriteFiles, bool& pressedOK, bool& pressedCancel);
 }
@@ -80,9 +83,21 @@ void TexView::ShowInfoOverlay(bool* popen, float x, float y, float w, float h, i
 			if (info.IsValid())
 			{
 				ImGui::Text("Size: %dx%d", info.Width, info.Height);
+				if (CurrImage->GetNumFrames() > 1)
+				{
+					const char* paused = IsAnimationPlaying() ? "" : " (Paused)";
+					ImGui::Text("Frame: %d of %d%s", CurrImage->GetCurrFrame()+1, CurrImage->GetNumFrames(), paused);
+				}
 				ImGui::Text("Pixel Format: %s", info.PixelFormat.Chars());
 				ImGui::Text("Bit Depth: %d", info.SrcFileBitDepth);
 				ImGui::Text("Opaque: %s", info.Opaque ? "true" : "false");
+				const tImage::tPictureStats& stats = CurrImage->GetStats();
+				if (stats.IsValid())
+				{
+					ImGui::Text("Alpha Coverage: %.1f%%", stats.AlphaCoverage * 100.0f);
+					ImGui::Text("Mean RGBA: %.1f %.1f %.1f %.1f", stats.Mean[0], stats.Mean[1], stats.Mean[2], stats.Mean[3]);
+					ImGui::Text("Colours (approx): %d", stats.NumDistinctColours);
+				}
 				ImGui::Text("Mipmaps: %d", info.Mipmaps);
 				ImGui::Text("File Size (B): %d", info.FileSizeBytes);
 				ImGui::Text("Cursor: (%d, %d)", cursorX, cursorY);
@@ -159,7 +174,7 @@ void TexView::ShowCheatSheetPopup(bool* popen)
 		ImGui::Text("Right Arrow");	ImGui::SameLine(); ImGui::SetCursorPosX(col); ImGui::Text("Next Image");
 		ImGui::Text("Ctrl-Left");	ImGui::SameLine(); ImGui::SetCursorPosX(col); ImGui::Text("Skip to First Image");
 		ImGui::Text("Ctrl-Right");	ImGui::SameLine(); ImGui::SetCursorPosX(col); ImGui::Text("Skip to Last Image");
-		ImGui::Text("Space");		ImGui::SameLine(); ImGui::SetCursorPosX(col); ImGui::Text("Next Image");
+		ImGui::Text("Space");		ImGui::SameLine(); ImGui::SetCursorPosX(col); ImGui::Text("Next Image or Pause Sequence or Animation");
 		ImGui::Text("Ctrl +");		ImGui::SameLine(); ImGui::SetCursorPosX(col); ImGui::Text("Zoom In");
 		ImGui::Text("Ctrl -");		ImGui::SameLine(); ImGui::SetCursorPosX(col); ImGui::Text("Zoom Out");
 		ImGui::Text("F1");			ImGui::SameLine(); ImGui::SetCursorPosX(col); ImGui::Text("Toggle Cheat Sheet");
@@ -174,6 +189,9 @@ void TexView::ShowCheatSheetPopup(bool* popen)
 		ImGui::Text("Alt-F4");		ImGui::SameLine(); ImGui::SetCursorPosX(col); ImGui::Text("Quit");
 		ImGui::Text("Ctrl-S");		ImGui::SameLine(); ImGui::SetCursorPosX(col); ImGui::Text("Save As...");
 		ImGui::Text("Alt-S");		ImGui::SameLine(); ImGui::SetCursorPosX(col); ImGui::Text("Save All...");
+		ImGui::Text("Ctrl-Z");		ImGui::SameLine(); ImGui::SetCursorPosX(col); ImGui::Text("Undo");
+		ImGui::Text("Ctrl-Y");		ImGui::SameLine(); ImGui::SetCursorPosX(col); ImGui::Text("Redo");
+		ImGui::Text("Ctrl-R");		ImGui::SameLine(); ImGui::SetCursorPosX(col); ImGui::Text("Resize Image...");
 		ImGui::Text("I");			ImGui::SameLine(); ImGui::SetCursorPosX(col); ImGui::Text("Toggle Info Overlay");
 		ImGui::Text("T");			ImGui::SameLine(); ImGui::SetCursorPosX(col); ImGui::Text("Toggle Tile");
 		ImGui::Text("L");			ImGui::SameLine(); ImGui::SetCursorPosX(col); ImGui::Text("Toggle Log");
@@ -183,6 +201,7 @@ void TexView::ShowCheatSheetPopup(bool* popen)
 		ImGui::Text("C");			ImGui::SameLine(); ImGui::SetCursorPosX(col); ImGui::Text("Contact Sheet...");
 		ImGui::Text("P");			ImGui::SameLine(); ImGui::SetCursorPosX(col); ImGui::Text("Preferences...");
 		ImGui::Text("V");			ImGui::SameLine(); ImGui::SetCursorPosX(col); ImGui::Text("Content Thumbnail View...");
+		ImGui::Text("Q");			ImGui::SameLine(); ImGui::SetCursorPosX(col); ImGui::Text("Play/Stop Image Sequence");
 	}
 	ImGui::End();
 }
@@ -252,6 +271,23 @@ void TexView::ShowPreferencesDialog(bool* popen)
 		Config.SlidehowFrameDuration = 1.0/30.0;
 	ImGui::Unindent();
 
+	ImGui::Separator();
+	ImGui::Text("Sequence");
+	ImGui::Indent();
+	ImGui::PushItemWidth(110);
+	if (ImGui::InputFloat("Frame Rate (fps)", &Config.SequenceFPS, 1.0f, 10.0f, "%.2f"))
+	{
+		tMath::tiClamp(Config.SequenceFPS, 0.0f, 240.0f);
+		SetSequenceFPS(Config.SequenceFPS);
+	}
+	ImGui::SameLine();
+	ShowHelpMark("Rate numbered image sequences play at. Zero plays them as fast as they decode.");
+	ImGui::InputInt("Buffer Frames", &Config.SequenceBufferFrames); ImGui::SameLine();
+	ShowHelpMark("Frames decoded ahead while a sequence plays. Used the next time a sequence starts.");
+	tMath::tiClamp(Config.SequenceBufferFrames, 2, 256);
+	ImGui::PopItemWidth();
+	ImGui::Unindent();
+
 	ImGui::Separator();
 	ImGui::Text("System");
 	ImGui::Indent();
@@ -266,6 +302,22 @@ void TexView::ShowPreferencesDialog(bool* popen)
 	ShowHelpMark("Maximum number of cache files that may be created. Minimum 200.");
 	tMath::tiClampMin(Config.MaxCacheFiles, 200);
 
+	if (ImGui::InputInt("Max Decode Cache (MB)", &Config.MaxDecodeCacheMB, 256, 1024))
+	{
+		tMath::tiClampMin(Config.MaxDecodeCacheMB, 0);
+		TacitImage::DecodeCache.SetMaxBytes(int64(Config.MaxDecodeCacheMB) << 20);
+	}
+	ImGui::SameLine();
+	ShowHelpMark("Disk space for keeping the decoded pixels of big images that are slow to load. Zero turns it off.");
+
+	if (ImGui::InputInt("Max Undo (MB)", &Config.MaxUndoMB, 64, 256))
+	{
+		tMath::tiClampMin(Config.MaxUndoMB, 0);
+		EditHistory::MaxBytes = int64(Config.MaxUndoMB) << 20;
+	}
+	ImGui::SameLine();
+	ShowHelpMark("Memory for undoing the edits to each image. The oldest edits are forgotten first.");
+
 	ImGui::PopItemWidth();
 	ImGui::Unindent();
 
@@ -274,12 +326,17 @@ void TexView::ShowPreferencesDialog(bool* popen)
 	ImGui::Indent();
 	ImGui::Checkbox("Confirm Deletes", &Config.ConfirmDeletes);
 	ImGui::Checkbox("Confirm File Overwrites", &Config.ConfirmFileOverwrites);
+	if (ImGui::Checkbox("Single Instance", &Config.SingleInstance) && !EnableSingleInstance(Config.SingleInstance))
+		Config.SingleInstance = false;
+	ImGui::SameLine();
+	ShowHelpMark("Files opened while the viewer is running show up in this window instead of another viewer.");
 	if (ImGui::Button("Reset UI"))
 	{
 		GLFWmonitor* monitor = glfwGetPrimaryMonitor();
 		const GLFWvidmode* mode = glfwGetVideoMode(monitor);
 		Config.Reset(mode->width, mode->height);
 		ChangeScreenMode(false, true);
+		EnableSingleInstance(Config.SingleInstance);
 	}
 	ImGui::Unindent();
 
@@ -326,7 +383,7 @@ void TexView::DoSaveAsModalDialog(bool justOpened)
 	ImGui::SameLine();
 	ShowHelpMark("Filtering method to use when resizing images.");
 
-	const char* fileTypeItems[] = { "tga", "png", "bmp", "jpg", "gif" };
+	const char* fileTypeItems[] = { "tga", "png", "bmp", "jpg", "gif", "qoi" };
 	ImGui::Combo("File Type", &Config.FileSaveType, fileTypeItems, tNumElements(fileTypeItems));
 	ImGui::SameLine();
 	ShowHelpMark("Output image format. JPG and GIF do not support alpha channel.");
@@ -339,11 +396,39 @@ void TexView::DoSaveAsModalDialog(bool justOpened)
 		case 2: extension = ".bmp"; break;
 		case 3: extension = ".jpg"; break;
 		case 4: extension = ".gif"; break;
+		case 5: extension = ".qoi"; break;
 	}
 
 	if (Config.FileSaveType == 0)
 		ImGui::Checkbox("RLE Compression", &Config.FileSaveTargaRLE);
 
+	if (Config.FileSaveType == 1)
+	{
+		// Matches tImage::tFilePNG::tLevel.
+		const char* pngLevelItems[] = { "Fastest", "Fast", "Default", "Smallest" };
+		ImGui::Combo("PNG Compression", &Config.FileSavePNGLevel, pngLevelItems, tNumElements(pngLevelItems));
+		ImGui::SameLine();
+		ShowHelpMark("Trades saving speed for file size. The image is always lossless.");
+	}
+
+	if (Config.FileSaveType == 3)
+	{
+		// Matches Settings::JPGSaveMode.
+		const char* jpgModeItems[] = { "Re-encode", "Lossless", "Exif Orientation" };
+		ImGui::Combo("JPG Rotate/Flip", &Config.FileSaveJPGMode, jpgModeItems, tNumElements(jpgModeItems));
+		ImGui::SameLine();
+		ShowHelpMark("How a jpg that was only rotated or flipped gets saved. Anything else is always re-encoded.");
+
+		if (Config.FileSaveJPGMode == int(Settings::JPGSaveMode::Lossless))
+		{
+			// Matches tImage::tFileJPG::tEdge.
+			const char* jpgEdgeItems[] = { "Trim", "Pad" };
+			ImGui::Combo("Partial MCU", &Config.FileSaveJPGEdge, jpgEdgeItems, tNumElements(jpgEdgeItems));
+			ImGui::SameLine();
+			ShowHelpMark("What to do with a partial block that ends up on the left or top edge.");
+		}
+	}
+
 	static char filename[128] = "Filename";
 	if (justOpened)
 	{
@@ -458,7 +543,7 @@ void TexView::DoSaveAllModalDialog(bool justOpened)
 	ImGui::Separator();
 	ImGui::NewLine();
 
-	const char* fileTypeItems[] = { "tga", "png", "bmp", "jpg", "gif" };
+	const char* fileTypeItems[] = { "tga", "png", "bmp", "jpg", "gif", "qoi" };
 	ImGui::Combo("File Type", &Config.FileSaveType, fileTypeItems, tNumElements(fileTypeItems));
 	ImGui::SameLine();
 	ShowHelpMark("Output image format. JPG and GIF do not support alpha channel.");
@@ -471,11 +556,21 @@ void TexView::DoSaveAllModalDialog(bool justOpened)
 		case 2: extension = ".bmp"; break;
 		case 3: extension = ".jpg"; break;
 		case 4: extension = ".gif"; break;
+		case 5: extension = ".qoi"; break;
 	}
 
 	if (Config.FileSaveType == 0)
 		ImGui::Checkbox("RLE Compression", &Config.FileSaveTargaRLE);
 
+	if (Config.FileSaveType == 1)
+	{
+		// Matches tImage::tFilePNG::tLevel.
+		const char* pngLevelItems[] = { "Fastest", "Fast", "Default", "Smallest" };
+		ImGui::Combo("PNG Compression", &Config.FileSavePNGLevel, pngLevelItems, tNumElements(pngLevelItems));
+		ImGui::SameLine();
+		ShowHelpMark("Trades saving speed for file size. The image is always lossless.");
+	}
+
 	ImGui::NewLine();
 	if (ImGui::Button("Cancel", tVector2(100, 0)))
 		ImGui::CloseCurrentPopup();
@@ -607,15 +702,42 @@ void TexView::SaveAllImages(const tString& extension, float percent, int width,
 		// can process many files, so we don't want them all in memory at once by indiscriminantly
 		// loading them all.
 		bool imageLoaded = image->IsLoaded();
-		if (!imageLoaded)
-			image->Load();
+
+		// Unloaded tga and qoi files going to tga, png or qoi are streamed a band of rows at a time, so huge images
+		// never need to fit in memory. A file being saved over can't be read as it's written, so it is loaded instead.
+		tSystem::tFileType srcType = tSystem::tGetFileType(image->Filename);
+		bool streamOut = (Config.FileSaveType == 0) || (Config.FileSaveType == 1) || (Config.FileSaveType == 5);
+		bool streamIn = streamOut && !imageLoaded && (tStricmp(outFile.Chars(), image->Filename.Chars()) != 0);
+		tImage::tBandSource* fileSource = nullptr;
+		if (streamIn && (srcType == tSystem::tFileType::TGA))
+			fileSource = new tImage::tBandTGASource(image->Filename);
+		else if (streamIn && (srcType == tSystem::tFileType::QOI))
+			fileSource = new tImage::tBandQOISource(image->Filename);
+
+		// Targas the band reader doesn't support, like colour-mapped ones, are loaded normally.
+		if (fileSource && !fileSource->IsValid())
+		{
+			delete fileSource;
+			fileSource = nullptr;
+		}
+
+		// If the image was only loaded for this we can take its pixels rather than copy them since it's about to be
+		// unloaded anyways.
 		tImage::tPicture outPic;
-		outPic.Set(*image->GetPrimaryPicture());
-		if (!imageLoaded)
-			image->Unload();
+		if (!fileSource)
+		{
+			if (!imageLoaded)
+				image->Load();
+			if (imageLoaded)
+				outPic.Set(*image->GetPrimaryPicture());
+			else
+				outPic.Set(std::move(*image->GetPrimaryPicture()));
+			if (!imageLoaded)
+				image->Unload();
+		}
 
-		int outW = outPic.GetWidth();
-		int outH = outPic.GetHeight();
+		int outW = fileSource ? fileSource->GetWidth() : outPic.GetWidth();
+		int outH = fileSource ? fileSource->GetHeight() : outPic.GetHeight();
 		float aspect = float(outW) / float(outH);
 
 		switch (Settings::SizeMode(Config.SaveAllSizeMode))
@@ -645,6 +767,17 @@ void TexView::SaveAllImages(const tString& extension, float percent, int width,
 		tMath::tiClampMin(outW, 4);
 		tMath::tiClampMin(outH, 4);
 
+		if (fileSource)
+		{
+			bool streamed = SaveStreamed(outFile, *fileSource, outW, outH);
+			delete fileSource;
+			if (streamed)
+				tPrintf("Saved image as : %s\n", outFile.Chars());
+			else
+				tPrintf("Failed to save image %s\n", outFile.Chars());
+			continue;
+		}
+
 		if ((outPic.GetWidth() != outW) || (outPic.GetHeight() != outH))
 			outPic.Resample(outW, outH, tImage::tPicture::tFilter(Config.ResampleFilter));
 
@@ -652,6 +785,8 @@ void TexView::SaveAllImages(const tString& extension, float percent, int width,
 		tImage::tPicture::tColourFormat colourFmt = outPic.IsOpaque() ? tImage::tPicture::tColourFormat::Colour : tImage::tPicture::tColourFormat::ColourAndAlpha;
 		if (Config.FileSaveType == 0)
 			success = outPic.SaveTGA(outFile, tImage::tFileTGA::tFormat::Auto, Config.FileSaveTargaRLE ? tImage::tFileTGA::tCompression::RLE : tImage::tFileTGA::tCompression::None);
+		else if (Config.FileSaveType == 1)
+			success = outPic.SavePNG(outFile, tImage::tFilePNG::tFormat::Auto, tImage::tFilePNG::tLevel(Config.FileSavePNGLevel));
 		else
 			success = outPic.Save(outFile, colourFmt);
 
@@ -667,25 +802,105 @@ void TexView::SaveAllImages(const tString& extension, float percent, int width,
 }
 
 
-void TexView::SaveImageTo(const tString& outFile, int finalWidth, int finalHeight)
+bool TexView::SaveStreamed(const tString& outFile, tImage::tBandSource& source, int outW, int outH)
 {
-	tImage::tPicture outPic(CurrImage->GetWidth(), CurrImage->GetHeight());
-	outPic.Set(*CurrImage->GetPrimaryPicture());
+	// The source is read on its own thread while the resampler and the sink work on the rows before it.
+	tImage::tBandPrefetch prefetch(source);
+	tImage::tBandResample* resample = nullptr;
+	if ((source.GetWidth() != outW) || (source.GetHeight() != outH))
+		resample = new tImage::tBandResample(prefetch, outW, outH, tImage::tPicture::tFilter(Config.ResampleFilter));
+	tImage::tBandSource& outSource = resample ? *resample : (tImage::tBandSource&)prefetch;
 
-	if ((outPic.GetWidth() != finalWidth) || (outPic.GetHeight() != finalHeight))
-		outPic.Resample(finalWidth, finalHeight, tImage::tPicture::tFilter(Config.ResampleFilter));
+	bool success = false;
+	if (Config.FileSaveType == 0)
+	{
+		tImage::tBandTGASink sink
+		(
+			outFile, tImage::tFileTGA::tFormat::Auto,
+			Config.FileSaveTargaRLE ? tImage::tFileTGA::tCompression::RLE : tImage::tFileTGA::tCompression::None
+		);
+		success = tImage::tStream(sink, outSource);
+	}
+	else if (Config.FileSaveType == 1)
+	{
+		tImage::tFilePNG::tLevel level = tImage::tFilePNG::tLevel(Config.FileSavePNGLevel);
+		tImage::tBandPNGSink sink(outFile, tImage::tFilePNG::tFormat::Auto, level);
+		success = tImage::tStream(sink, outSource);
+	}
+	else if (Config.FileSaveType == 5)
+	{
+		tImage::tBandQOISink sink(outFile);
+		success = tImage::tStream(sink, outSource);
+	}
+
+	delete resample;
+	return success;
+}
+
+
+void TexView::SaveImageTo(const tString& outFile, int finalWidth, int finalHeight)
+{
+	// A copy is only needed if we have to resample. Otherwise we save straight from the current picture.
+	tImage::tPicture* srcPic = CurrImage->GetPrimaryPicture();
+	tImage::tPicture resampled;
+	if ((srcPic->GetWidth() != finalWidth) || (srcPic->GetHeight() != finalHeight))
+	{
+		resampled.Set(*srcPic);
+		resampled.Resample(finalWidth, finalHeight, tImage::tPicture::tFilter(Config.ResampleFilter));
+	}
+	tImage::tPicture& outPic = resampled.IsValid() ? resampled : *srcPic;
 
+	// A jpg that was only rotated or flipped since it was loaded or saved can be written without decoding it again.
 	bool success = false;
+	bool sameSize = true;
+	tImage::tFileJPG::tOrientation orientation;
+	Settings::JPGSaveMode jpgMode = Settings::JPGSaveMode(Config.FileSaveJPGMode);
+	if
+	(
+		!resampled.IsValid() && (Config.FileSaveType == 3) && (jpgMode != Settings::JPGSaveMode::Reencode) &&
+		(CurrImage->Filetype == tSystem::tFileType::JPG) && CurrImage->GetOrientationSinceSaved(orientation)
+	)
+	{
+		tImage::tFileJPG jpg(CurrImage->Filename);
+		tImage::tFileJPG::tEdge edge = tImage::tFileJPG::tEdge(Config.FileSaveJPGEdge);
+		if (jpg.IsValid() && (jpgMode == Settings::JPGSaveMode::Orientation))
+			success = jpg.SaveReoriented(outFile, orientation);
+
+		// Files with exif data but no orientation tag can't be reoriented, so the blocks get moved instead.
+		if (jpg.IsValid() && !success)
+		{
+			success = jpg.SaveTransformed(outFile, orientation, edge);
+			int width = 0; int height = 0;
+			jpg.GetTransformedSize(width, height, orientation, edge);
+			sameSize = (width == outPic.GetWidth()) && (height == outPic.GetHeight());
+		}
+	}
+
 	tImage::tPicture::tColourFormat colourFmt = outPic.IsOpaque() ? tImage::tPicture::tColourFormat::Colour : tImage::tPicture::tColourFormat::ColourAndAlpha;
-	if (Config.FileSaveType == 0)
-		success = outPic.SaveTGA(outFile, tImage::tFileTGA::tFormat::Auto, Config.FileSaveTargaRLE ? tImage::tFileTGA::tCompression::RLE : tImage::tFileTGA::tCompression::None);
-	else
-		success = outPic.Save(outFile, colourFmt);
+	if (!success)
+	{
+		sameSize = true;
+		if (Config.FileSaveType == 0)
+			success = outPic.SaveTGA(outFile, tImage::tFileTGA::tFormat::Auto, Config.FileSaveTargaRLE ? tImage::tFileTGA::tCompression::RLE : tImage::tFileTGA::tCompression::None);
+		else if (Config.FileSaveType == 1)
+			success = outPic.SavePNG(outFile, tImage::tFilePNG::tFormat::Auto, tImage::tFilePNG::tLevel(Config.FileSavePNGLevel));
+		else
+			success = outPic.Save(outFile, colourFmt);
+	}
 	if (success)
 		tPrintf("Saved image as : %s\n", outFile.Chars());
 	else
 		tPrintf("Failed to save image %s\n", outFile.Chars());
 
+	// Saving over the current file without resizing leaves the pictures as they are, so the image keeps its undo
+	// history and only the saved step moves. A lossless jpg save that trimmed a partial MCU changed the size though.
+	if (success && !resampled.IsValid() && sameSize && (tStricmp(outFile.Chars(), CurrImage->Filename.Chars()) == 0))
+	{
+		CurrImage->MarkSaved();
+		SetWindowTitle();
+		return;
+	}
+
 	Images.Clear();
 	PopulateImages();
 	SetCurrentImage(outFile);
@@ -724,6 +939,75 @@ bool TexView::DoOverwriteFileModal(const tString& outFile, int finalWidth, int f
 }
 
 
+void TexView::DoResizeImageModalDialog(bool justOpened)
+{
+	static int newWidth = 512;
+	static int newHeight = 512;
+	static int mode = 0;
+	static int anchor = int(tImage::tPicture::Anchor::MiddleMiddle);
+	if (justOpened && CurrImage)
+	{
+		newWidth = CurrImage->GetWidth();
+		newHeight = CurrImage->GetHeight();
+	}
+
+	const char* modeItems[] = { "Resample", "Crop" };
+	ImGui::Combo("Mode", &mode, modeItems, tNumElements(modeItems));
+	ImGui::SameLine();
+	ShowHelpMark("Resample scales the image. Crop cuts it down or adds transparent borders.");
+
+	ImGui::InputInt("Width", &newWidth); ImGui::SameLine();
+	ShowHelpMark("New width in pixels.");
+	tMath::tiClamp(newWidth, 1, 16384);
+
+	ImGui::InputInt("Height", &newHeight); ImGui::SameLine();
+	ShowHelpMark("New height in pixels.");
+	tMath::tiClamp(newHeight, 1, 16384);
+
+	if (mode == 0)
+	{
+		// Matches tImage::tPicture::tFilter.
+		const char* filterItems[] = { "NearestNeighbour", "Box", "Bilinear", "Bicubic", "Quadratic", "Hamming" };
+		ImGui::Combo("Filter", &Config.ResampleFilter, filterItems, tNumElements(filterItems));
+		ImGui::SameLine();
+		ShowHelpMark("Filtering method to use when resizing images.");
+	}
+	else
+	{
+		// Matches tImage::tPicture::Anchor.
+		const char* anchorItems[] =
+		{
+			"Left Top",		"Middle Top",		"Right Top",
+			"Left Middle",	"Middle Middle",	"Right Middle",
+			"Left Bottom",	"Middle Bottom",	"Right Bottom"
+		};
+		ImGui::Combo("Anchor", &anchor, anchorItems, tNumElements(anchorItems));
+		ImGui::SameLine();
+		ShowHelpMark("The part of the image that stays where it is.");
+	}
+
+	ImGui::NewLine();
+	if (ImGui::Button("Cancel", tVector2(100, 0)))
+		ImGui::CloseCurrentPopup();
+	ImGui::SameLine();
+
+	ImGui::SetCursorPosX(ImGui::GetWindowContentRegionMax().x - 100.0f);
+	if (ImGui::Button("Apply", tVector2(100, 0)) && CurrImage)
+	{
+		CurrImage->Unbind();
+		if (mode == 0)
+			CurrImage->Resample(newWidth, newHeight, tImage::tPicture::tFilter(Config.ResampleFilter));
+		else
+			CurrImage->Crop(newWidth, newHeight, tImage::tPicture::Anchor(anchor));
+		CurrImage->Bind();
+		SetWindowTitle();
+		ImGui::CloseCurrentPopup();
+	}
+
+	ImGui::EndPopup();
+}
+
+
 void TexView::DoDeleteFileModal()
 {
 	tString fullname = CurrImage->Filename;
@@ -25,6 +25,7 @@ namespace TexView
 
 	void DoSaveAsModalDialog(bool justOpened);
 	void DoSaveAllModalDialog(bool justOpened);
+	void DoResizeImageModalDialog(bool justOpened);
 	void DoDeleteFileModal();
 	void DoDeleteFileNoRecycleModal();
 }
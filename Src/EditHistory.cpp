@@ -0,0 +1,291 @@
+// EditHistory.cpp
+//
+// Undo and redo of the edits made to an image. Rotates and flips are stored as the operation alone since they can be
+// inverted exactly. Crops and resamples lose pixels, so the pixels they destroy are kept as tiles of the picture from
+// before the edit. Tiles that are still present in the edited picture are not stored, so a crop only keeps what was cut
+// away. Redo just applies the edit again. The history stays under a memory budget by dropping its oldest steps.
+//
+// Copyright (c) 2020 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <Foundation/tStandard.h>
+#include "EditHistory.h"
+using namespace tImage;
+int64 EditHistory::MaxBytes = 256*1024*1024;
+
+
+bool EditHistory::Apply(tList<tPicture>& pictures, const Edit& edit)
+{
+	tPicture* picture = pictures.First();
+	if (!picture || !picture->IsValid())
+		return false;
+
+	if (!edit.IsInvertible() && ((pictures.GetNumItems() != 1) || (edit.Width <= 0) || (edit.Height <= 0)))
+		return false;
+
+	Step* step = new Step;
+	step->Change = edit;
+	step->BeforeWidth = picture->GetWidth();
+	step->BeforeHeight = picture->GetHeight();
+	if (!edit.IsInvertible())
+		StoreTiles(*step, *picture);
+
+	step->NumBytes += sizeof(Step);
+	for (Tile* tile = step->Tiles.First(); tile; tile = tile->Next())
+		step->NumBytes += sizeof(Tile) + tile->W*tile->H*sizeof(tPixel);
+
+	// Resampling can fail, in which case the picture is left as it was.
+	if (!ApplyEdit(pictures, edit))
+	{
+		delete step;
+		return false;
+	}
+
+	RemoveRedoSteps();
+	Steps.Append(step);
+	NumApplied++;
+	TotalBytes += step->NumBytes;
+	Evict();
+	return true;
+}
+
+
+bool EditHistory::Undo(tList<tPicture>& pictures)
+{
+	if (!CanUndo())
+		return false;
+
+	Step* step = Steps.First();
+	for (int s = 1; s < NumApplied; s++)
+		step = step->Next();
+
+	ApplyInverse(pictures, *step);
+	NumApplied--;
+	return true;
+}
+
+
+bool EditHistory::Redo(tList<tPicture>& pictures)
+{
+	if (!CanRedo())
+		return false;
+
+	Step* step = Steps.First();
+	for (int s = 0; s < NumApplied; s++)
+		step = step->Next();
+
+	// The tiles are still good since the pictures are back to how they were when they were stored.
+	ApplyEdit(pictures, step->Change);
+	NumApplied++;
+	return true;
+}
+
+
+bool EditHistory::RevertToSaved(tList<tPicture>& pictures)
+{
+	if ((SavedPosition < NumDropped) || (SavedPosition > NumDropped + Steps.GetNumItems()))
+		return false;
+
+	while (GetPosition() > SavedPosition)
+		Undo(pictures);
+
+	while (GetPosition() < SavedPosition)
+		Redo(pictures);
+
+	return true;
+}
+
+
+bool EditHistory::GetOrientationSinceSaved(tFileJPG::tOrientation& orientation) const
+{
+	if ((SavedPosition < NumDropped) || (SavedPosition > NumDropped + Steps.GetNumItems()))
+		return false;
+
+	// Steps after the saved one and up to the current one are done in order. If the saved step is ahead of the current
+	// one, the steps in between are undone, the newest first.
+	int saved = int(SavedPosition - NumDropped);
+	orientation = tFileJPG::tOrientation::Normal;
+	int index = 0;
+	for (const Step* step = Steps.First(); step; step = step->Next(), index++)
+	{
+		bool done = (index >= saved) && (index < NumApplied);
+		bool undone = (index >= NumApplied) && (index < saved);
+		if (!done && !undone)
+			continue;
+
+		tFileJPG::tOrientation change = tFileJPG::tOrientation::Invalid;
+		switch (step->Change.Operation)
+		{
+			case Edit::Op::Rotate90ACW:	change = tFileJPG::tOrientation::Rotate90ACW;	break;
+			case Edit::Op::Rotate90CW:	change = tFileJPG::tOrientation::Rotate90CW;	break;
+			case Edit::Op::FlipH:		change = tFileJPG::tOrientation::FlipH;			break;
+			case Edit::Op::FlipV:		change = tFileJPG::tOrientation::FlipV;			break;
+			default:																	return false;
+		}
+
+		if (done)
+			orientation = tFileJPG::Combine(orientation, change);
+		else
+			orientation = tFileJPG::Combine(tFileJPG::Invert(change), orientation);
+	}
+
+	return true;
+}
+
+
+void EditHistory::Clear()
+{
+	Steps.Empty();
+	NumApplied = 0;
+	NumDropped = 0;
+	TotalBytes = 0;
+	SavedPosition = 0;
+}
+
+
+bool EditHistory::ApplyEdit(tList<tPicture>& pictures, const Edit& edit)
+{
+	bool success = true;
+	for (tPicture* picture = pictures.First(); picture; picture = picture->Next())
+	{
+		switch (edit.Operation)
+		{
+			case Edit::Op::Rotate90ACW:	picture->Rotate90(true);											break;
+			case Edit::Op::Rotate90CW:	picture->Rotate90(false);											break;
+			case Edit::Op::FlipH:		picture->Flip(true);												break;
+			case Edit::Op::FlipV:		picture->Flip(false);												break;
+			case Edit::Op::Crop:		picture->Crop(edit.Width, edit.Height, edit.OriginX, edit.OriginY);	break;
+			case Edit::Op::Resample:	success = picture->Resample(edit.Width, edit.Height, edit.Filter);	break;
+		}
+	}
+
+	return success;
+}
+
+
+void EditHistory::ApplyInverse(tList<tPicture>& pictures, const Step& step)
+{
+	const Edit& edit = step.Change;
+	switch (edit.Operation)
+	{
+		case Edit::Op::Rotate90ACW:
+			for (tPicture* picture = pictures.First(); picture; picture = picture->Next())
+				picture->Rotate90(false);
+			return;
+
+		case Edit::Op::Rotate90CW:
+			for (tPicture* picture = pictures.First(); picture; picture = picture->Next())
+				picture->Rotate90(true);
+			return;
+
+		case Edit::Op::FlipH:
+		case Edit::Op::FlipV:
+			ApplyEdit(pictures, edit);
+			return;
+
+		default:
+			break;
+	}
+
+	// Lossy edits only ever have one picture. The part of the old picture that survived a crop is copied back from the
+	// current pixels and the tiles fill in the rest.
+	tPicture* picture = pictures.First();
+	int width = step.BeforeWidth;
+	int height = step.BeforeHeight;
+	tPixel* pixels = tPicture::AllocPixels(width*height);
+	if (edit.Operation == Edit::Op::Crop)
+	{
+		int curWidth = picture->GetWidth();
+		const tPixel* curPixels = picture->GetPixels();
+		int x0 = tMath::tMax(edit.OriginX, 0);
+		int y0 = tMath::tMax(edit.OriginY, 0);
+		int x1 = tMath::tMin(edit.OriginX + edit.Width, width);
+		int y1 = tMath::tMin(edit.OriginY + edit.Height, height);
+		for (int y = y0; (y < y1) && (x0 < x1); y++)
+		{
+			const tPixel* src = curPixels + (y - edit.OriginY)*curWidth + (x0 - edit.OriginX);
+			tStd::tMemcpy(pixels + y*width + x0, src, (x1 - x0)*int(sizeof(tPixel)));
+		}
+	}
+
+	for (const Tile* tile = step.Tiles.First(); tile; tile = tile->Next())
+	{
+		int rowBytes = tile->W*int(sizeof(tPixel));
+		for (int y = 0; y < tile->H; y++)
+			tStd::tMemcpy(pixels + (tile->Y + y)*width + tile->X, tile->Pixels + y*tile->W, rowBytes);
+	}
+
+	int srcFileBitDepth = picture->SrcFileBitDepth;
+	int srcFileNumFrames = picture->SrcFileNumFrames;
+	picture->Set(width, height, pixels, false);
+	picture->SrcFileBitDepth = srcFileBitDepth;
+	picture->SrcFileNumFrames = srcFileNumFrames;
+}
+
+
+void EditHistory::StoreTiles(Step& step, const tPicture& picture)
+{
+	// The region of the old picture that a crop keeps. Resampling keeps nothing.
+	const Edit& edit = step.Change;
+	int width = picture.GetWidth();
+	int height = picture.GetHeight();
+	int keepX0 = 0, keepY0 = 0, keepX1 = 0, keepY1 = 0;
+	if (edit.Operation == Edit::Op::Crop)
+	{
+		keepX0 = edit.OriginX;					keepY0 = edit.OriginY;
+		keepX1 = edit.OriginX + edit.Width;		keepY1 = edit.OriginY + edit.Height;
+	}
+
+	const tPixel* pixels = picture.GetPixels();
+	const int tileSize = TileSize;
+	for (int ty = 0; ty < height; ty += tileSize)
+	{
+		for (int tx = 0; tx < width; tx += tileSize)
+		{
+			int tw = tMath::tMin(tileSize, width - tx);
+			int th = tMath::tMin(tileSize, height - ty);
+			if ((tx >= keepX0) && (ty >= keepY0) && (tx+tw <= keepX1) && (ty+th <= keepY1))
+				continue;
+
+			Tile* tile = new Tile(tx, ty, tw, th);
+			for (int y = 0; y < th; y++)
+				tStd::tMemcpy(tile->Pixels + y*tw, pixels + (ty + y)*width + tx, tw*int(sizeof(tPixel)));
+			step.Tiles.Append(tile);
+		}
+	}
+}
+
+
+void EditHistory::RemoveRedoSteps()
+{
+	if (SavedPosition > GetPosition())
+		SavedPosition = -1;
+
+	while (Steps.GetNumItems() > NumApplied)
+	{
+		Step* step = Steps.Last();
+		TotalBytes -= step->NumBytes;
+		delete Steps.Remove(step);
+	}
+}
+
+
+void EditHistory::Evict()
+{
+	// Only called right after a step is applied, when there is nothing to redo.
+	while ((TotalBytes > MaxBytes) && (Steps.GetNumItems() > 1))
+	{
+		Step* step = Steps.Remove();
+		TotalBytes -= step->NumBytes;
+		delete step;
+		NumApplied--;
+		NumDropped++;
+	}
+}
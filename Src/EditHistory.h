@@ -0,0 +1,128 @@
+// EditHistory.h
+//
+// Undo and redo of the edits made to an image. Rotates and flips are stored as the operation alone since they can be
+// inverted exactly. Crops and resamples lose pixels, so the pixels they destroy are kept as tiles of the picture from
+// before the edit. Tiles that are still present in the edited picture are not stored, so a crop only keeps what was cut
+// away. Redo just applies the edit again. The history stays under a memory budget by dropping its oldest steps.
+//
+// Copyright (c) 2020 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#pragma once
+#include <Foundation/tList.h>
+#include <Image/tPicture.h>
+#include <Image/tFileJPG.h>
+
+
+struct Edit
+{
+	enum class Op
+	{
+		Rotate90ACW,
+		Rotate90CW,
+		FlipH,
+		FlipV,
+		Crop,
+		Resample
+	};
+
+	bool IsInvertible() const																							{ return (Operation != Op::Crop) && (Operation != Op::Resample); }
+
+	Op Operation		= Op::FlipH;
+	int Width			= 0;							// Crop and resample.
+	int Height			= 0;
+	int OriginX			= 0;							// Crop. Where the new bottom-left is in the old picture.
+	int OriginY			= 0;
+	tImage::tPicture::tFilter Filter = tImage::tPicture::tFilter::Bilinear;
+};
+
+
+class EditHistory
+{
+public:
+	EditHistory()																										{ }
+	~EditHistory()																										{ Clear(); }
+
+	// Applies the edit to every picture and records it. Any steps that were undone can't be redone after this. Crops
+	// and resamples only support a single picture. Returns false if the edit couldn't be applied, in which case the
+	// pictures are left alone.
+	bool Apply(tList<tImage::tPicture>&, const Edit&);
+
+	// Return false if there is nothing to undo or redo.
+	bool Undo(tList<tImage::tPicture>&);
+	bool Redo(tList<tImage::tPicture>&);
+	bool CanUndo() const																								{ return NumApplied > 0; }
+	bool CanRedo() const																								{ return NumApplied < Steps.GetNumItems(); }
+
+	// Call when the pictures match the file on disk, such as after loading or saving. The pictures are modified if the
+	// history has moved away from the saved step.
+	void MarkSaved()																									{ SavedPosition = GetPosition(); }
+	bool IsModified() const																								{ return SavedPosition != GetPosition(); }
+
+	// Undoes or redoes to the saved step. Returns false if the saved step has been dropped from the history, either to
+	// stay under budget or because it was undone and then replaced by a new edit. The file needs reloading then.
+	bool RevertToSaved(tList<tImage::tPicture>&);
+
+	// Gets the single rotate or flip that takes the saved pictures to the current ones. Returns false if a crop or
+	// resample lies in between or the saved step can't be reached.
+	bool GetOrientationSinceSaved(tImage::tFileJPG::tOrientation&) const;
+
+	// Empties the history. The pictures are taken to match the file afterwards.
+	void Clear();
+	int GetNumSteps() const																								{ return Steps.GetNumItems(); }
+	int64 GetTotalBytes() const																							{ return TotalBytes; }
+
+	// Shared by all histories. Each history drops its oldest steps to stay under it. The step being applied is kept
+	// even if it is bigger than the budget on its own, but then nothing before it can be undone.
+	static int64 MaxBytes;
+
+	// Tiles are square and this many pixels wide.
+	const static int TileSize			= 64;
+
+private:
+	struct Tile : public tLink<Tile>
+	{
+		Tile(int x, int y, int w, int h)																				: X(x), Y(y), W(w), H(h), Pixels(tImage::tPicture::AllocPixels(w*h)) { }
+		~Tile()																											{ tImage::tPicture::FreePixels(Pixels); }
+		int X, Y, W, H;
+		tPixel* Pixels;
+	};
+
+	struct Step : public tLink<Step>
+	{
+		Edit Change;
+		int BeforeWidth		= 0;
+		int BeforeHeight	= 0;
+		tList<Tile> Tiles;								// The pixels the edit destroyed. Only lossy edits have any.
+		int64 NumBytes		= 0;
+	};
+
+	// Positions count steps from the start of the history, including the ones that have been dropped.
+	int64 GetPosition() const																							{ return NumDropped + NumApplied; }
+
+	static bool ApplyEdit(tList<tImage::tPicture>&, const Edit&);
+	static void ApplyInverse(tList<tImage::tPicture>&, const Step&);
+
+	// Stores the tiles of the picture that the edit will destroy. Must be called before the edit is applied.
+	static void StoreTiles(Step&, const tImage::tPicture&);
+
+	// Removes the steps that were undone. Evict then removes the oldest steps until the history is under budget.
+	void RemoveRedoSteps();
+	void Evict();
+
+	// Oldest first. The first NumApplied steps are applied to the pictures and the rest can be redone.
+	tList<Step> Steps;
+	int NumApplied = 0;
+	int64 NumDropped = 0;
+	int64 TotalBytes = 0;
+
+	// Negative if the saved step can't be reached any more.
+	int64 SavedPosition = 0;
+};
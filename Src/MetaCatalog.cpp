@@ -0,0 +1,366 @@
+// MetaCatalog.cpp
+//
+// A per-directory catalog of what is known about each image file without loading it. Records hold the probed header
+// info, the perceptual hash, and whether a thumbnail has been cached. They are keyed by file name and are only used if
+// the file size and modification time still match, so reopening a directory doesn't need to probe every file again.
+//
+// Copyright (c) 2020 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <Foundation/tStandard.h>
+#include <Math/tFundamentals.h>
+#include <Math/tHash.h>
+#include <System/tFile.h>
+#include "MetaCatalog.h"
+using namespace tSystem;
+using namespace tImage;
+
+
+void MetaRecord::SetInfo(const tImageInfo& info)
+{
+	Flags &= ~(Flag_Info | Flag_Cubemap | Flag_Opaque);
+	if (!info.IsValid())
+		return;
+
+	Flags |= Flag_Info;
+	if (info.Cubemap)
+		Flags |= Flag_Cubemap;
+	if (info.Opaque)
+		Flags |= Flag_Opaque;
+
+	FileType	= uint8(info.FileType);
+	PixelFormat	= int32(info.PixelFormat);
+	Width		= info.Width;
+	Height		= info.Height;
+	NumFrames	= info.NumFrames;
+	BitDepth	= int16(info.BitDepth);
+	NumMipmaps	= int16(info.NumMipmaps);
+}
+
+
+void MetaRecord::GetInfo(tImageInfo& info) const
+{
+	info = tImageInfo();
+	if (!HasInfo())
+		return;
+
+	info.FileType		= tFileType(FileType);
+	info.Width			= Width;
+	info.Height			= Height;
+	info.PixelFormat	= tPixelFormat(PixelFormat);
+	info.BitDepth		= BitDepth;
+	info.NumMipmaps		= NumMipmaps;
+	info.NumFrames		= NumFrames;
+	info.Cubemap		= (Flags & Flag_Cubemap) ? true : false;
+	info.Opaque			= (Flags & Flag_Opaque) ? true : false;
+}
+
+
+tString MetaCatalog::GetCatalogFile(const tString& cacheDir, const tString& imagesDir)
+{
+	// The same directory may come to us with different slashes or case.
+	tString dir = tGetSimplifiedPath(imagesDir, true);
+	dir.Replace('\\', '/');
+	dir.ToLower();
+
+	tString catalogFile;
+	tsPrintf(catalogFile, "%s%016|64X.cat", cacheDir.Chars(), tMath::tHashString64(dir));
+	return catalogFile;
+}
+
+
+void MetaCatalog::Clear()
+{
+	Records.Clear(0, 4096);
+	NamePool.Clear(0, 64*1024);
+
+	delete[] Slots;
+	NumSlots = 64;
+	Slots = new uint32[NumSlots];
+	tStd::tMemset(Slots, 0, NumSlots*sizeof(uint32));
+	Dirty = false;
+}
+
+
+bool MetaCatalog::Load(const tString& catalogFile)
+{
+	WaitForSave();
+	Clear();
+	CatalogFile = catalogFile;
+	if (!tFileExists(catalogFile))
+		return false;
+
+	int numBytes = 0;
+	uint8* data = tLoadFile(catalogFile, nullptr, &numBytes);
+	if (!data)
+		return false;
+
+	// The header sizes are checked against the file size before anything else is read. Everything after the header
+	// is covered by the checksum so a partly written file is rejected.
+	FileHeader header;
+	bool valid = (numBytes >= int(sizeof(FileHeader)));
+	if (valid)
+	{
+		tStd::tMemcpy(&header, data, sizeof(FileHeader));
+		int64 expectedSize =
+			int64(sizeof(FileHeader)) + int64(header.NumRecords)*sizeof(MetaRecord) +
+			int64(header.NumSlots)*sizeof(uint32) + int64(header.PoolSize);
+
+		valid =
+			(header.Magic == Magic) && (header.Version == Version) &&
+			(header.NumSlots >= 64) && tMath::tIsPower2(header.NumSlots) &&
+			(header.NumSlots >= 2*header.NumRecords) && (expectedSize == int64(numBytes)) &&
+			(tMath::tHashData32(data + sizeof(FileHeader), numBytes - int(sizeof(FileHeader))) == header.Checksum);
+	}
+
+	MetaRecord* records = (MetaRecord*)(data + sizeof(FileHeader));
+	uint32* slots = (uint32*)(records + (valid ? header.NumRecords : 0));
+	char* pool = (char*)(slots + (valid ? header.NumSlots : 0));
+	for (uint32 r = 0; valid && (r < header.NumRecords); r++)
+		if ((uint64(records[r].NameOffset) + records[r].NameLength) > header.PoolSize)
+			valid = false;
+
+	for (uint32 s = 0; valid && (s < header.NumSlots); s++)
+		if (slots[s] > header.NumRecords)
+			valid = false;
+
+	if (!valid)
+	{
+		delete[] data;
+		return false;
+	}
+
+	// The slots are used as they are in the file so loading doesn't need to rehash.
+	if (header.NumRecords > 0)
+	{
+		Records.Clear(header.NumRecords, 4096);
+		Records.Append(records, header.NumRecords);
+	}
+
+	if (header.PoolSize > 0)
+	{
+		NamePool.Clear(header.PoolSize, 64*1024);
+		NamePool.Append(pool, header.PoolSize);
+	}
+
+	delete[] Slots;
+	NumSlots = header.NumSlots;
+	Slots = new uint32[NumSlots];
+	tStd::tMemcpy(Slots, slots, NumSlots*sizeof(uint32));
+	delete[] data;
+	return true;
+}
+
+
+int MetaCatalog::FindIndex(const char* name, int nameLength, uint32 nameHash) const
+{
+	const MetaRecord* records = Records.GetElements();
+	const char* pool = NamePool.GetElements();
+	uint32 mask = NumSlots - 1;
+
+	// There are always empty slots so this terminates.
+	for (uint32 s = nameHash & mask; Slots[s]; s = (s + 1) & mask)
+	{
+		const MetaRecord& record = records[Slots[s] - 1];
+		if
+		(
+			(record.NameHash == nameHash) && (record.NameLength == nameLength) &&
+			!tStd::tMemcmp(pool + record.NameOffset, name, nameLength)
+		)
+			return Slots[s] - 1;
+	}
+
+	return -1;
+}
+
+
+void MetaCatalog::InsertSlot(int index)
+{
+	uint32 mask = NumSlots - 1;
+	uint32 s = Records.GetElements()[index].NameHash & mask;
+	while (Slots[s])
+		s = (s + 1) & mask;
+
+	Slots[s] = index + 1;
+}
+
+
+void MetaCatalog::Rehash(int numSlots)
+{
+	delete[] Slots;
+	NumSlots = numSlots;
+	Slots = new uint32[NumSlots];
+	tStd::tMemset(Slots, 0, NumSlots*sizeof(uint32));
+	for (int r = 0; r < Records.GetNumElements(); r++)
+		InsertSlot(r);
+}
+
+
+const MetaRecord* MetaCatalog::Find(const tString& name, uint64 fileSize, uint64 modTime)
+{
+	int index = FindIndex(name.Chars(), name.Length(), tMath::tHashString32(name));
+	if (index < 0)
+		return nullptr;
+
+	MetaRecord& record = Records[index];
+	record.Flags |= MetaRecord::Flag_Touched;
+	if ((record.FileSize != fileSize) || (record.ModTime != modTime))
+		return nullptr;
+
+	return &record;
+}
+
+
+void MetaCatalog::Set(const tString& name, const MetaRecord& src)
+{
+	int nameLength = name.Length();
+	if ((nameLength <= 0) || (nameLength > 0xFFFF))
+		return;
+
+	MetaRecord record = src;
+	record.NameHash = tMath::tHashString32(name);
+	record.NameLength = uint16(nameLength);
+	record.Flags |= MetaRecord::Flag_Touched;
+
+	int index = FindIndex(name.Chars(), nameLength, record.NameHash);
+	if (index >= 0)
+	{
+		// Records have no padding so they can be compared directly.
+		MetaRecord& existing = Records[index];
+		record.NameOffset = existing.NameOffset;
+		if (!tStd::tMemcmp(&existing, &record, sizeof(MetaRecord)))
+			return;
+
+		existing = record;
+		Dirty = true;
+		return;
+	}
+
+	record.NameOffset = NamePool.GetNumElements();
+	NamePool.Append(name.Chars(), nameLength);
+	Records.Append(record);
+	if (2*Records.GetNumElements() > NumSlots)
+		Rehash(2*NumSlots);
+	else
+		InsertSlot(Records.GetNumElements() - 1);
+
+	Dirty = true;
+}
+
+
+bool MetaCatalog::SaveAsync()
+{
+	if (!Dirty || CatalogFile.IsEmpty())
+		return false;
+
+	// Same pattern as the thumbnail workers. If we can set the flag the previous save is done.
+	if (SaveThread.joinable())
+	{
+		if (SaveThreadFlag.test_and_set())
+			return false;
+		SaveThread.join();
+	}
+
+	// Only touched records are written. The rest belong to files that are no longer in the directory.
+	const MetaRecord* records = Records.GetElements();
+	const char* pool = NamePool.GetElements();
+	int numRecords = 0;
+	int poolSize = 0;
+	for (int r = 0; r < Records.GetNumElements(); r++)
+	{
+		if (records[r].Flags & MetaRecord::Flag_Touched)
+		{
+			numRecords++;
+			poolSize += records[r].NameLength;
+		}
+	}
+
+	int numSlots = 64;
+	while (numSlots < 2*numRecords)
+		numSlots *= 2;
+
+	int numBytes = sizeof(FileHeader) + numRecords*sizeof(MetaRecord) + numSlots*sizeof(uint32) + poolSize;
+	uint8* data = new uint8[numBytes];
+	MetaRecord* dstRecords = (MetaRecord*)(data + sizeof(FileHeader));
+	uint32* dstSlots = (uint32*)(dstRecords + numRecords);
+	char* dstPool = (char*)(dstSlots + numSlots);
+	tStd::tMemset(dstSlots, 0, numSlots*sizeof(uint32));
+
+	int dstIndex = 0;
+	int poolOffset = 0;
+	uint32 mask = numSlots - 1;
+	for (int r = 0; r < Records.GetNumElements(); r++)
+	{
+		const MetaRecord& src = records[r];
+		if (!(src.Flags & MetaRecord::Flag_Touched))
+			continue;
+
+		MetaRecord& dst = dstRecords[dstIndex];
+		dst = src;
+		dst.Flags &= ~MetaRecord::Flag_Touched;
+		dst.NameOffset = poolOffset;
+		tStd::tMemcpy(dstPool + poolOffset, pool + src.NameOffset, src.NameLength);
+		poolOffset += src.NameLength;
+
+		uint32 s = dst.NameHash & mask;
+		while (dstSlots[s])
+			s = (s + 1) & mask;
+		dstSlots[s] = dstIndex + 1;
+		dstIndex++;
+	}
+
+	FileHeader header;
+	header.Magic		= Magic;
+	header.Version		= Version;
+	header.NumRecords	= numRecords;
+	header.NumSlots		= numSlots;
+	header.PoolSize		= poolSize;
+	header.Checksum		= tMath::tHashData32(data + sizeof(FileHeader), numBytes - int(sizeof(FileHeader)));
+	tStd::tMemcpy(data, &header, sizeof(FileHeader));
+	Dirty = false;
+
+	// The worker owns the data from here on.
+	tString catalogFile = CatalogFile;
+	SaveThreadFlag.test_and_set();
+	SaveThread = std::thread
+	(
+		[this, catalogFile, data, numBytes]
+		{
+			WriteFile(catalogFile, data, numBytes);
+			SaveThreadFlag.clear();
+		}
+	);
+
+	return true;
+}
+
+
+void MetaCatalog::WaitForSave()
+{
+	if (SaveThread.joinable())
+		SaveThread.join();
+}
+
+
+void MetaCatalog::WriteFile(tString catalogFile, uint8* data, int numBytes)
+{
+	tString tempFile = catalogFile + ".tmp";
+	tFileHandle file = tOpenFile(tempFile.Chars(), "wb");
+	bool written = false;
+	if (file)
+	{
+		written = (tWriteFile(file, data, numBytes) == numBytes);
+		tCloseFile(file);
+	}
+	delete[] data;
+
+	if (!written || !tReplaceFile(catalogFile, tempFile))
+		tDeleteFile(tempFile);
+}
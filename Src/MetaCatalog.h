@@ -0,0 +1,127 @@
+// MetaCatalog.h
+//
+// A per-directory catalog of what is known about each image file without loading it. Records hold the probed header
+// info, the perceptual hash, and whether a thumbnail has been cached. They are keyed by file name and are only used if
+// the file size and modification time still match, so reopening a directory doesn't need to probe every file again.
+//
+// Copyright (c) 2020 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#pragma once
+#include <thread>
+#include <atomic>
+#include <Foundation/tArray.h>
+#include <Foundation/tString.h>
+#include <Image/tImageProbe.h>
+
+
+// Records are stored in the file exactly as they are in memory, so the layout must not change without bumping the
+// catalog version.
+struct MetaRecord
+{
+	enum Flag
+	{
+		Flag_Info			= 1 << 0,				// The probed info fields are valid.
+		Flag_Cubemap		= 1 << 1,
+		Flag_Opaque			= 1 << 2,
+		Flag_Thumbnail		= 1 << 3,				// A thumbnail is in the thumbnail cache.
+		Flag_Hash			= 1 << 4,				// DHash and PHash are valid.
+		Flag_Touched		= 1 << 7				// In memory only. Set when looked up or set since loading.
+	};
+
+	bool HasInfo() const																								{ return (Flags & Flag_Info) ? true : false; }
+	void SetInfo(const tImage::tImageInfo&);
+	void GetInfo(tImage::tImageInfo&) const;
+
+	uint64 FileSize		= 0;
+	uint64 ModTime		= 0;
+	uint64 DHash		= 0;
+	uint64 PHash		= 0;
+	uint32 NameHash		= 0;
+	uint32 NameOffset	= 0;						// Into the name pool.
+	uint16 NameLength	= 0;
+	uint8 FileType		= 0;						// A tSystem::tFileType.
+	uint8 Flags			= 0;
+	int32 PixelFormat	= 0;						// A tImage::tPixelFormat.
+	int32 Width			= 0;
+	int32 Height		= 0;
+	int32 NumFrames		= 0;
+	int16 BitDepth		= 0;
+	int16 NumMipmaps	= 0;
+};
+tStaticAssert(sizeof(MetaRecord) == 64);
+
+
+class MetaCatalog
+{
+public:
+	MetaCatalog()																										{ Clear(); }
+	~MetaCatalog()																										{ WaitForSave(); delete[] Slots; }
+
+	// Catalogs are kept in the cache directory, not the image directory, since that may not be writable.
+	static tString GetCatalogFile(const tString& cacheDir, const tString& imagesDir);
+
+	// Waits for any save in progress and then reads the catalog file. Returns false and leaves the catalog empty if
+	// the file doesn't exist or is invalid. Either way the catalog will be saved to catalogFile.
+	bool Load(const tString& catalogFile);
+	void Clear();
+	const tString& GetFile() const																						{ return CatalogFile; }
+	int GetNumRecords() const																							{ return Records.GetNumElements(); }
+	bool IsDirty() const																								{ return Dirty; }
+
+	// Returns nullptr if there is no record for the file or if its size or modification time don't match. A stale
+	// record stays until it is replaced by Set. Records that are neither found nor set before the next save belong
+	// to files that are gone and are not written.
+	const MetaRecord* Find(const tString& name, uint64 fileSize, uint64 modTime);
+
+	// Adds or replaces the record for a file. The name and touched fields of the record are filled in here. The
+	// catalog is only marked dirty if something changed.
+	void Set(const tString& name, const MetaRecord&);
+
+	// Saves on a worker thread if the catalog is dirty. The records are copied first so the catalog may keep being
+	// used. The file is written to a temporary and then swapped in, so after a crash the catalog is either the old one
+	// or the new one. A torn or corrupt file fails its checksum and is ignored by Load. Returns false if there was
+	// nothing to save or the previous save hasn't finished.
+	bool SaveAsync();
+	void WaitForSave();
+
+	const static uint32 Magic			= 0x54414354;	// 'TCAT'.
+	const static uint32 Version			= 2;
+
+private:
+	struct FileHeader
+	{
+		uint32 Magic;
+		uint32 Version;
+		uint32 NumRecords;
+		uint32 NumSlots;
+		uint32 PoolSize;
+		uint32 Checksum;							// Of everything after the header.
+	};
+
+	int FindIndex(const char* name, int nameLength, uint32 nameHash) const;
+	void InsertSlot(int index);
+	void Rehash(int numSlots);
+	static void WriteFile(tString catalogFile, uint8* data, int numBytes);
+
+	tString CatalogFile;
+	bool Dirty = false;
+
+	// The slots are an open addressing hash table of record indices plus one. Zero means empty. There are always at
+	// least twice as many slots as records and the number of slots is a power of two.
+	tArray<MetaRecord> Records;
+	tArray<char> NamePool;
+	uint32* Slots = nullptr;
+	int NumSlots = 0;
+
+	// Only one save runs at a time. The flag is cleared by the worker thread when it is done.
+	std::thread SaveThread;
+	std::atomic_flag SaveThreadFlag = ATOMIC_FLAG_INIT;
+};
@@ -0,0 +1,375 @@
+// PixelCache.cpp
+//
+// A size-bounded disk cache of decoded pixels. Large images that are slow to decode (big jpgs and pngs, and dds files
+// that need their levels decompressed) are written out raw after the first decode so revisiting them is a single read
+// straight into the picture buffers. Entries are keyed by a hash of the file contents and the decode options, so
+// renaming or copying a file still hits and changing it misses. The least recently used entries are removed when the
+// total size goes over budget.
+//
+// Copyright (c) 2020 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <Foundation/tStandard.h>
+#include <Math/tHash.h>
+#include <System/tFile.h>
+#include "PixelCache.h"
+using namespace tSystem;
+using namespace tImage;
+const float PixelCache::MinDecodeTime = 0.05f;
+
+
+namespace
+{
+	bool Compare_FileModTimeAscending(const tStringItem& a, const tStringItem& b)
+	{
+		tFileInfo ia; tGetFileInfo(ia, a);
+		tFileInfo ib; tGetFileInfo(ib, b);
+		return ia.ModificationTime < ib.ModificationTime;
+	}
+
+	// tReadFile and tWriteFile take an int, so big pictures go in pieces.
+	const int64 MaxChunkBytes = 1 << 30;
+
+	bool ReadBytes(tFileHandle file, void* dest, int64 numBytes)
+	{
+		for (int64 offset = 0; offset < numBytes; offset += MaxChunkBytes)
+		{
+			int chunkBytes = int(tMath::tMin(numBytes - offset, MaxChunkBytes));
+			if (tReadFile(file, (uint8*)dest + offset, chunkBytes) != chunkBytes)
+				return false;
+		}
+		return true;
+	}
+
+	bool WriteBytes(tFileHandle file, const void* src, int64 numBytes)
+	{
+		for (int64 offset = 0; offset < numBytes; offset += MaxChunkBytes)
+		{
+			int chunkBytes = int(tMath::tMin(numBytes - offset, MaxChunkBytes));
+			if (tWriteFile(file, (const uint8*)src + offset, chunkBytes) != chunkBytes)
+				return false;
+		}
+		return true;
+	}
+}
+
+
+void PixelCache::Init(const tString& cacheDir, int64 maxBytes)
+{
+	std::lock_guard<std::mutex> lock(Mutex);
+	Entries.Empty();
+	TotalBytes = 0;
+	MaxBytes = maxBytes;
+	CacheDir = cacheDir;
+	if (!tDirExists(CacheDir))
+		tCreateDir(CacheDir);
+
+	// Temporaries are left behind if we quit or crash during a save.
+	tList<tStringItem> files;
+	tFindFilesInDir(files, CacheDir, "*.tmp");
+	for (tStringItem* file = files.First(); file; file = file->Next())
+		tDeleteFile(*file);
+
+	files.Empty();
+	tFindFilesInDir(files, CacheDir, "*.pix");
+	files.Sort(Compare_FileModTimeAscending);
+	for (tStringItem* file = files.First(); file; file = file->Next())
+	{
+		tString name = tGetFileBaseName(*file);
+		tFileInfo info;
+		if ((name.Length() != 16) || !tGetFileInfo(info, *file))
+			continue;
+
+		Entry* entry = new Entry;
+		entry->Key = tStd::tStrtoui64(name.Chars(), 16);
+		entry->NumBytes = int64(info.FileSize);
+		Entries.Append(entry);
+		TotalBytes += entry->NumBytes;
+	}
+
+	Evict();
+}
+
+
+void PixelCache::SetMaxBytes(int64 maxBytes)
+{
+	std::lock_guard<std::mutex> lock(Mutex);
+	MaxBytes = maxBytes;
+	Evict();
+}
+
+
+uint64 PixelCache::ComputeKey(const tString& imageFile, uint32 decodeOptions)
+{
+	tFileInfo info;
+	if (!tGetFileInfo(info, imageFile))
+		return 0;
+
+	uint32 version = Version;
+	uint64 fileSize = info.FileSize;
+	uint64 modTime = info.ModificationTime;
+	tString path = tGetSimplifiedPath(imageFile);
+	uint64 hash = tMath::tHashData64((uint8*)&version, sizeof(version));
+	hash = tMath::tHashData64((uint8*)&decodeOptions, sizeof(decodeOptions), hash);
+	hash = tMath::tHashData64((uint8*)&fileSize, sizeof(fileSize), hash);
+	hash = tMath::tHashData64((uint8*)&modTime, sizeof(modTime), hash);
+	hash = tMath::tHashData64((uint8*)path.Chars(), path.Length(), hash);
+
+	// Zero means no key.
+	return hash ? hash : 1;
+}
+
+
+bool PixelCache::Load(tList<tPicture>& pictures, uint64 key)
+{
+	if (!key)
+		return false;
+
+	{
+		std::lock_guard<std::mutex> lock(Mutex);
+		Entry* entry = FindEntry(key);
+		if (!entry)
+			return false;
+
+		// Most recently used goes to the back.
+		Entries.Append(Entries.Remove(entry));
+	}
+
+	tString entryFile = GetEntryFile(key);
+	tFileInfo info;
+	tFileHandle file = tGetFileInfo(info, entryFile) ? tOpenFile(entryFile.Chars(), "rb") : nullptr;
+	bool ok = false;
+	tList<tPicture> loaded;
+	if (file)
+	{
+		int64 fileSize = int64(info.FileSize);
+		FileHeader header;
+		ok =
+		(
+			(tReadFile(file, &header, sizeof(header)) == sizeof(header)) &&
+			(header.Magic == Magic) && (header.Version == Version) && (header.Key == key) &&
+			(header.NumPictures > 0) && (header.NumPictures <= 1024)
+		);
+
+		// The headers are all read and checked against the file size before any pixels are allocated. A picture
+		// can't have more than an int of pixels.
+		PictureHeader* pictureHeaders = ok ? new PictureHeader[header.NumPictures] : nullptr;
+		if (ok)
+		{
+			int numBytes = int(header.NumPictures*sizeof(PictureHeader));
+			ok = (tReadFile(file, pictureHeaders, numBytes) == numBytes);
+		}
+
+		int64 expectedSize = ok ? sizeof(FileHeader) + header.NumPictures*sizeof(PictureHeader) : 0;
+		for (int p = 0; ok && (p < header.NumPictures); p++)
+		{
+			const PictureHeader& ph = pictureHeaders[p];
+			int64 numPixels = int64(ph.Width)*int64(ph.Height);
+			ok = (ph.Width > 0) && (ph.Height > 0) && (ph.Width <= 65536) && (ph.Height <= 65536);
+			ok = ok && (numPixels <= 0x7FFFFFFF);
+			expectedSize += numPixels*int64(sizeof(tPixel));
+		}
+		ok = ok && (expectedSize == fileSize);
+
+		for (int p = 0; ok && (p < header.NumPictures); p++)
+		{
+			const PictureHeader& ph = pictureHeaders[p];
+			int64 numPixels = int64(ph.Width)*int64(ph.Height);
+			tPixel* pixels = tPicture::AllocPixels(int(numPixels));
+			ok = ReadBytes(file, pixels, numPixels*int64(sizeof(tPixel)));
+
+			// The picture takes ownership of the pixels even if the read failed.
+			tPicture* picture = new tPicture(ph.Width, ph.Height, pixels, false);
+			picture->SrcFileBitDepth = ph.SrcFileBitDepth;
+			picture->SrcFileNumFrames = ph.SrcFileNumFrames;
+			loaded.Append(picture);
+		}
+
+		delete[] pictureHeaders;
+		tCloseFile(file);
+	}
+
+	if (!ok)
+	{
+		std::lock_guard<std::mutex> lock(Mutex);
+		Entry* entry = FindEntry(key);
+		if (entry)
+			RemoveEntry(entry);
+		return false;
+	}
+
+	while (!loaded.IsEmpty())
+		pictures.Append(loaded.Remove());
+
+	return true;
+}
+
+
+bool PixelCache::Save(uint64 key, const tList<tPicture>& pictures)
+{
+	int64 numBytes = GetEntrySize(pictures);
+	if (!key || !numBytes)
+		return false;
+
+	// Written to a temporary first so a partly written entry is never found.
+	tString entryFile = GetEntryFile(key);
+	tString tempFile = entryFile + ".tmp";
+	tFileHandle file = tOpenFile(tempFile.Chars(), "wb");
+	if (!file)
+		return false;
+
+	FileHeader header;
+	header.Magic = Magic;
+	header.Version = Version;
+	header.Key = key;
+	header.NumPictures = pictures.GetNumItems();
+	header.Reserved = 0;
+	bool ok = (tWriteFile(file, &header, sizeof(header)) == sizeof(header));
+
+	for (const tPicture* picture = pictures.First(); ok && picture; picture = picture->Next())
+	{
+		PictureHeader ph;
+		ph.Width = picture->GetWidth();
+		ph.Height = picture->GetHeight();
+		ph.SrcFileBitDepth = picture->SrcFileBitDepth;
+		ph.SrcFileNumFrames = picture->SrcFileNumFrames;
+		ok = (tWriteFile(file, &ph, sizeof(ph)) == sizeof(ph));
+	}
+
+	for (const tPicture* picture = pictures.First(); ok && picture; picture = picture->Next())
+	{
+		int64 pixelBytes = int64(picture->GetNumPixels())*int64(sizeof(tPixel));
+		ok = WriteBytes(file, picture->GetPixels(), pixelBytes);
+	}
+
+	tCloseFile(file);
+	if (!ok || !tReplaceFile(entryFile, tempFile))
+	{
+		tDeleteFile(tempFile);
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(Mutex);
+	Entry* entry = FindEntry(key);
+	if (entry)
+	{
+		TotalBytes -= entry->NumBytes;
+		Entries.Remove(entry);
+	}
+	else
+	{
+		entry = new Entry;
+		entry->Key = key;
+	}
+
+	entry->NumBytes = numBytes;
+	Entries.Append(entry);
+	TotalBytes += numBytes;
+	Evict();
+	return true;
+}
+
+
+bool PixelCache::SaveAsync(uint64 key, const tList<tPicture>& pictures)
+{
+	if (!key || !GetEntrySize(pictures))
+		return false;
+
+	// Same pattern as the catalog. If we can set the flag the previous save is done.
+	if (SaveThread.joinable())
+	{
+		if (SaveThreadFlag.test_and_set())
+			return false;
+		SaveThread.join();
+	}
+
+	// The caller is free to change or unload its pictures once we return, so the worker gets copies.
+	tList<tPicture>* copies = new tList<tPicture>;
+	for (const tPicture* picture = pictures.First(); picture; picture = picture->Next())
+	{
+		tPicture* copy = new tPicture(*picture);
+		copy->SrcFileBitDepth = picture->SrcFileBitDepth;
+		copy->SrcFileNumFrames = picture->SrcFileNumFrames;
+		copies->Append(copy);
+	}
+
+	SaveThreadFlag.test_and_set();
+	SaveThread = std::thread
+	(
+		[this, key, copies]
+		{
+			Save(key, *copies);
+			delete copies;
+			SaveThreadFlag.clear();
+		}
+	);
+
+	return true;
+}
+
+
+void PixelCache::WaitForSave()
+{
+	if (SaveThread.joinable())
+		SaveThread.join();
+}
+
+
+tString PixelCache::GetEntryFile(uint64 key) const
+{
+	tString file;
+	tsPrintf(file, "%s%016|64X.pix", CacheDir.Chars(), key);
+	return file;
+}
+
+
+int64 PixelCache::GetEntrySize(const tList<tPicture>& pictures)
+{
+	if (!IsValid() || pictures.IsEmpty())
+		return 0;
+
+	int64 numBytes = sizeof(FileHeader) + pictures.GetNumItems()*sizeof(PictureHeader);
+	for (const tPicture* picture = pictures.First(); picture; picture = picture->Next())
+	{
+		if (!picture->IsValid())
+			return 0;
+		numBytes += int64(picture->GetNumPixels())*int64(sizeof(tPixel));
+	}
+
+	// The budget may be changed from another thread.
+	std::lock_guard<std::mutex> lock(Mutex);
+	return (numBytes > MaxBytes/4) ? 0 : numBytes;
+}
+
+
+PixelCache::Entry* PixelCache::FindEntry(uint64 key) const
+{
+	// Searched from the most recently used end since that is where revisits usually are.
+	for (Entry* entry = Entries.Last(); entry; entry = entry->Prev())
+		if (entry->Key == key)
+			return entry;
+
+	return nullptr;
+}
+
+
+void PixelCache::RemoveEntry(Entry* entry)
+{
+	tDeleteFile(GetEntryFile(entry->Key));
+	TotalBytes -= entry->NumBytes;
+	delete Entries.Remove(entry);
+}
+
+
+void PixelCache::Evict()
+{
+	while ((TotalBytes > MaxBytes) && !Entries.IsEmpty())
+		RemoveEntry(Entries.First());
+}
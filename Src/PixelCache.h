@@ -0,0 +1,117 @@
+// PixelCache.h
+//
+// A size-bounded disk cache of decoded pixels. Large images that are slow to decode (big jpgs and pngs, and dds files
+// that need their levels decompressed) are written out raw after the first decode so revisiting them is a single read
+// straight into the picture buffers. Entries are keyed by the file path, size and modification time together with the
+// decode options, so the file is never read to make a key and saving over it misses. The least recently used entries
+// are removed when the total size goes over budget. Entries are written on a worker thread.
+//
+// Copyright (c) 2020 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#pragma once
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <Foundation/tList.h>
+#include <Foundation/tString.h>
+#include <Image/tPicture.h>
+
+
+class PixelCache
+{
+public:
+	~PixelCache()																										{ WaitForSave(); }
+
+	// Reads the existing entries in cacheDir, creating it if needed. Entries are ordered by when they were written,
+	// since that is all the file system remembers. Within a session the order is by last use.
+	void Init(const tString& cacheDir, int64 maxBytes);
+	bool IsValid() const																								{ return !CacheDir.IsEmpty(); }
+
+	// Removes the least recently used entries until the cache fits. A max of zero empties it.
+	void SetMaxBytes(int64 maxBytes);
+	int64 GetMaxBytes() const																							{ return MaxBytes; }
+	int64 GetTotalBytes() const																							{ return TotalBytes; }
+	int GetNumEntries() const																							{ return Entries.GetNumItems(); }
+
+	// Hashes the simplified path, size and modification time of the image file together with the decode options.
+	// Returns 0 if the file doesn't exist. Anything that changes the decoded pixels, like the row order or which levels
+	// are decoded, must be part of the options.
+	static uint64 ComputeKey(const tString& imageFile, uint32 decodeOptions);
+
+	// Appends the cached pictures for the key. The pixels are read directly into the picture buffers. Returns false
+	// if there is no entry or it can't be read, in which case the entry is removed and nothing is appended.
+	bool Load(tList<tImage::tPicture>&, uint64 key);
+
+	// Writes the pictures under the key, replacing any existing entry, and then evicts entries until the cache is
+	// under budget. Entries bigger than a quarter of the budget are not stored since they would flush most of it.
+	bool Save(uint64 key, const tList<tImage::tPicture>&);
+
+	// Copies the pictures and saves them on a worker thread so the caller isn't held up by the disk. Returns false
+	// without copying anything if the entry wouldn't be stored or the previous save is still running.
+	bool SaveAsync(uint64 key, const tList<tImage::tPicture>&);
+	void WaitForSave();
+
+	// Images with fewer pixels than this decode quickly enough that a cache entry isn't worth the disk space.
+	const static int MinPixels			= 2048*2048;
+
+	// Pictures that decode faster than this are not worth the disk space.
+	const static float MinDecodeTime;
+
+	const static uint32 Magic			= 0x58495054;	// 'TPIX'.
+	const static uint32 Version			= 3;
+
+private:
+	// The file header is followed by a picture header for each picture and then the pixels of each picture in turn.
+	struct FileHeader
+	{
+		uint32 Magic;
+		uint32 Version;
+		uint64 Key;
+		int32 NumPictures;
+		int32 Reserved;
+	};
+
+	struct PictureHeader
+	{
+		int32 Width;
+		int32 Height;
+		int32 SrcFileBitDepth;
+		int32 SrcFileNumFrames;
+	};
+
+	struct Entry : public tLink<Entry>
+	{
+		uint64 Key;
+		int64 NumBytes;
+	};
+
+	tString GetEntryFile(uint64 key) const;
+
+	// Returns the size of the entry file for the pictures, or 0 if they can't be stored.
+	int64 GetEntrySize(const tList<tImage::tPicture>&);
+
+	// These expect the mutex to be locked.
+	Entry* FindEntry(uint64 key) const;
+	void RemoveEntry(Entry*);
+	void Evict();
+
+	tString CacheDir;
+	int64 MaxBytes = 0;
+	int64 TotalBytes = 0;
+
+	// Least recently used first. Loads and saves may come from more than one thread.
+	tList<Entry> Entries;
+	std::mutex Mutex;
+
+	// Only one save runs at a time. The flag is cleared by the worker thread when it is done.
+	std::thread SaveThread;
+	std::atomic_flag SaveThreadFlag = ATOMIC_FLAG_INIT;
+};
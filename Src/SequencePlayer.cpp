@@ -0,0 +1,353 @@
+// SequencePlayer.cpp
+//
+// Real-time playback of numbered image sequences like render_0001.png, render_0002.png and so on. Worker threads decode
+// the frames ahead of the playhead into a fixed-size ring. A tTimer decides which frame is due. If the due frame has
+// not been decoded yet, the newest decoded frame before it is shown and the frames in between are dropped, so slow
+// decodes never slow the clock down.
+//
+// Copyright (c) 2020 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <Foundation/tStandard.h>
+#include <System/tFile.h>
+#include <System/tMachine.h>
+#include "SequencePlayer.h"
+using namespace tImage;
+
+
+bool SequencePlayer::SplitFrameName(const tString& file, tString& prefix, int& number, tString& suffix)
+{
+	// Only the base name is searched, so digits in the directory or extension don't count.
+	int nameStart = file.Length() - tSystem::tGetFileName(file).Length();
+	int extStart = file.FindChar('.', true);
+	if (extStart < nameStart)
+		extStart = file.Length();
+
+	int digitsEnd = extStart;
+	while ((digitsEnd > nameStart) && !tStd::tIsdigit(file.Chars()[digitsEnd-1]))
+		digitsEnd--;
+
+	int digitsStart = digitsEnd;
+	while ((digitsStart > nameStart) && tStd::tIsdigit(file.Chars()[digitsStart-1]))
+		digitsStart--;
+
+	// Anything longer than nine digits won't fit in an int and isn't a frame number anyway.
+	int numDigits = digitsEnd - digitsStart;
+	if ((numDigits <= 0) || (numDigits > 9))
+		return false;
+
+	prefix = file.Prefix(digitsStart);
+	suffix = file.Chars() + digitsEnd;
+	number = tStd::tAtoi(file.Prefix(digitsEnd).Chars() + digitsStart);
+	return true;
+}
+
+
+bool SequencePlayer::Start
+(
+	const tArray<tString>& frameFiles, int startFrame, float fps,
+	int bufferFrames, int numThreads, bool loop
+)
+{
+	Stop();
+	if ((frameFiles.GetNumElements() <= 0) || (startFrame < 0) || (startFrame >= frameFiles.GetNumElements()))
+		return false;
+
+	Files = frameFiles;
+	NumFrames = Files.GetNumElements();
+	FPS = tMath::tMax(fps, 0.0f);
+	Loop = loop;
+	Playing = false;
+
+	// A ring longer than the sequence would only decode the same files twice.
+	BufferFrames = tMath::tClamp(bufferFrames, 2, tMath::tMax(NumFrames, 2));
+	Slots = new Slot[BufferFrames];
+	Playhead = startFrame;
+	Shown = startFrame - 1;
+	NumShown = 0;
+	NumDropped = 0;
+	NumDecoded = 0;
+	DecodeSeconds = 0.0;
+	ShowTimesNext = 0;
+	for (int t = 0; t < NumShowTimes; t++)
+		ShowTimes[t] = -1.0;
+
+	// One core is left for the main thread to upload and draw.
+	NumThreads = (numThreads > 0) ? numThreads : tMath::tClamp(tSystem::tGetNumCores() - 1, 1, 8);
+	Quit = false;
+	Workers = new std::thread[NumThreads];
+	for (int t = 0; t < NumThreads; t++)
+		Workers[t] = std::thread(&SequencePlayer::Work, this);
+
+	RestartClock();
+	return true;
+}
+
+
+void SequencePlayer::Stop()
+{
+	if (!IsActive())
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(Mutex);
+		Quit = true;
+	}
+	Condition.notify_all();
+	for (int t = 0; t < NumThreads; t++)
+		Workers[t].join();
+
+	delete[] Workers;
+	Workers = nullptr;
+	NumThreads = 0;
+	delete[] Slots;
+	Slots = nullptr;
+	BufferFrames = 0;
+	Files.Clear();
+	NumFrames = 0;
+	Playing = false;
+}
+
+
+void SequencePlayer::Play()
+{
+	if (!IsActive() || Playing)
+		return;
+
+	Playing = true;
+	RestartClock();
+}
+
+
+void SequencePlayer::Seek(int frame)
+{
+	if (!IsActive())
+		return;
+
+	// Positions start again from the new frame. Workers still decoding an old position throw the result away.
+	{
+		std::lock_guard<std::mutex> lock(Mutex);
+		for (int s = 0; s < BufferFrames; s++)
+		{
+			Slots[s].Position = -1;
+			Slots[s].Ready = false;
+			Slots[s].Picture.Clear();
+		}
+		Playhead = tMath::tClamp(frame, 0, NumFrames-1);
+		Shown = Playhead - 1;
+	}
+	Condition.notify_all();
+	RestartClock();
+}
+
+
+void SequencePlayer::SetFPS(float fps)
+{
+	FPS = tMath::tMax(fps, 0.0f);
+	RestartClock();
+}
+
+
+void SequencePlayer::RestartClock()
+{
+	std::lock_guard<std::mutex> lock(Mutex);
+	Clock.Reset(true);
+	LastUpdateTime = tSystem::tGetTimeDouble();
+	ClockOrigin = Shown + 1;
+}
+
+
+bool SequencePlayer::Update(tPicture& picture, int& frame)
+{
+	if (!IsActive())
+		return false;
+
+	double now = tSystem::tGetTimeDouble();
+	if (Playing)
+		Clock.Update(float(now - LastUpdateTime));
+	LastUpdateTime = now;
+	if (!Playing)
+		return false;
+
+	std::unique_lock<std::mutex> lock(Mutex);
+	int64 last = Loop ? -1 : NumFrames-1;
+	if ((last >= 0) && (Shown >= last))
+		return false;
+
+	int64 due = (FPS > 0.0f) ? ClockOrigin + int64(Clock.GetTime() * FPS) : Shown + 1;
+	if (last >= 0)
+		due = tMath::tMin(due, last);
+	if (due <= Shown)
+		return false;
+
+	// The newest decoded frame that is due. This may be before the playhead if it was moved on while the frame was
+	// being decoded. Only positions inside the ring can have been decoded.
+	int64 found = -1;
+	int64 newest = tMath::tMin(due, Playhead + BufferFrames - 1);
+	int64 oldest = tMath::tMax(Shown + 1, newest - BufferFrames + 1);
+	for (int64 p = newest; p >= oldest; p--)
+	{
+		Slot& slot = Slots[p % BufferFrames];
+		if ((slot.Position == p) && slot.Ready)
+		{
+			found = p;
+			break;
+		}
+	}
+
+	// If nothing due is ready the workers skip ahead to the due frame so they stop starting frames that will be late.
+	// Frames already being decoded are still shown when they finish, unless something newer is ready by then.
+	if (found < 0)
+	{
+		if (due > Playhead)
+		{
+			Playhead = due;
+			lock.unlock();
+			Condition.notify_all();
+		}
+		return false;
+	}
+
+	Slot& slot = Slots[found % BufferFrames];
+	picture = std::move(slot.Picture);
+	slot.Position = -1;
+	slot.Ready = false;
+	NumDropped += int(found - Shown - 1);
+	Shown = found;
+	Playhead = tMath::tMax(Playhead, found + 1);
+
+	// A frame that failed to decode counts as dropped.
+	bool valid = picture.IsValid();
+	if (valid)
+	{
+		frame = int(found % NumFrames);
+		NumShown++;
+		ShowTimes[ShowTimesNext] = now;
+		ShowTimesNext = (ShowTimesNext + 1) % NumShowTimes;
+	}
+	else
+	{
+		NumDropped++;
+	}
+
+	lock.unlock();
+	Condition.notify_all();
+	return valid;
+}
+
+
+bool SequencePlayer::IsFinished() const
+{
+	std::lock_guard<std::mutex> lock(Mutex);
+	return IsActive() && !Loop && (Shown >= NumFrames-1);
+}
+
+
+SequencePlayer::Stats SequencePlayer::GetStats() const
+{
+	Stats stats;
+	if (!IsActive())
+		return stats;
+
+	std::lock_guard<std::mutex> lock(Mutex);
+	stats.TargetFPS = FPS;
+	stats.NumThreads = NumThreads;
+	stats.NumShown = NumShown;
+	stats.NumDropped = NumDropped;
+	stats.NumDecoded = NumDecoded;
+	for (int s = 0; s < BufferFrames; s++)
+		if (Slots[s].Ready && (Slots[s].Position > Shown))
+			stats.NumBuffered++;
+
+	if (NumDecoded > 0)
+	{
+		stats.DecodeTime = float(DecodeSeconds / double(NumDecoded));
+		if (stats.DecodeTime > 0.0f)
+			stats.DecodeFPS = float(NumThreads) / stats.DecodeTime;
+	}
+	if (FPS > 0.0f)
+		stats.Headroom = stats.DecodeFPS / FPS;
+
+	// The rate over the frames shown in the last second. Once playback stops it falls to zero.
+	double now = tSystem::tGetTimeDouble();
+	double oldest = now;
+	double newest = 0.0;
+	int count = 0;
+	for (int t = 0; t < NumShowTimes; t++)
+	{
+		if ((ShowTimes[t] < 0.0) || (now - ShowTimes[t] > 1.0))
+			continue;
+		oldest = tMath::tMin(oldest, ShowTimes[t]);
+		newest = tMath::tMax(newest, ShowTimes[t]);
+		count++;
+	}
+	if ((count >= 2) && (newest > oldest))
+		stats.AchievedFPS = float(double(count - 1) / (newest - oldest));
+
+	return stats;
+}
+
+
+void SequencePlayer::Work()
+{
+	std::unique_lock<std::mutex> lock(Mutex);
+	while (!Quit)
+	{
+		// The earliest position in the ring that nobody has started on.
+		int64 end = Playhead + BufferFrames;
+		if (!Loop)
+			end = tMath::tMin(end, int64(NumFrames));
+
+		int64 position = -1;
+		for (int64 p = Playhead; p < end; p++)
+		{
+			if (Slots[p % BufferFrames].Position != p)
+			{
+				position = p;
+				break;
+			}
+		}
+
+		if (position < 0)
+		{
+			Condition.wait(lock);
+			continue;
+		}
+
+		// Claiming the slot drops whatever it held, which is a frame that has already been passed.
+		Slot& slot = Slots[position % BufferFrames];
+		slot.Position = position;
+		slot.Ready = false;
+		slot.Picture.Clear();
+		tString file = Files[int(position % NumFrames)];
+		lock.unlock();
+
+		double start = tSystem::tGetTimeDouble();
+		tPicture picture;
+		try
+		{
+			picture.Load(file);
+		}
+		catch (tError error)
+		{
+			picture.Clear();
+		}
+		double seconds = tSystem::tGetTimeDouble() - start;
+
+		lock.lock();
+		NumDecoded++;
+		DecodeSeconds += seconds;
+		if (slot.Position == position)
+		{
+			slot.Picture = std::move(picture);
+			slot.Ready = true;
+		}
+	}
+}
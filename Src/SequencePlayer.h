@@ -0,0 +1,130 @@
+// SequencePlayer.h
+//
+// Real-time playback of numbered image sequences like render_0001.png, render_0002.png and so on. Worker threads decode
+// the frames ahead of the playhead into a fixed-size ring. A tTimer decides which frame is due. If the due frame has
+// not been decoded yet, the newest decoded frame before it is shown and the frames in between are dropped, so slow
+// decodes never slow the clock down.
+//
+// Copyright (c) 2020 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#pragma once
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <Foundation/tArray.h>
+#include <Foundation/tString.h>
+#include <System/tTime.h>
+#include <Image/tPicture.h>
+
+
+class SequencePlayer
+{
+public:
+	SequencePlayer()																									{ }
+	~SequencePlayer()																									{ Stop(); }
+
+	// Splits a file name around its frame number, which is the last run of digits in the base name. For
+	// C:/Renders/shot_0012.png the prefix is C:/Renders/shot_, the number is 12 and the suffix is .png. Files are in the
+	// same sequence if their prefixes and suffixes match. Returns false if the base name has no digits.
+	static bool SplitFrameName(const tString& file, tString& prefix, int& number, tString& suffix);
+
+	// Starts decoding from startFrame. The frame files are in display order and are loaded with tPicture::Load. An fps
+	// of zero shows every frame as soon as it is decoded, without dropping any. Zero threads picks a count from the
+	// number of cores. Any sequence already playing is stopped first. Playback starts paused.
+	bool Start
+	(
+		const tArray<tString>& frameFiles, int startFrame, float fps,
+		int bufferFrames = 32, int numThreads = 0, bool loop = true
+	);
+	void Stop();
+	bool IsActive() const																								{ return NumFrames > 0; }
+	int GetNumFrames() const																							{ return NumFrames; }
+
+	// The clock only runs while playing, and restarts from the next frame when Play is called.
+	void Play();
+	void Pause()																										{ Playing = false; }
+	bool IsPlaying() const																								{ return Playing; }
+
+	// Frames after the given one are decoded next. The frame itself is shown by the next Update.
+	void Seek(int frame);
+	void SetFPS(float fps);
+	float GetFPS() const																								{ return FPS; }
+
+	// Call once per display frame. If a newer frame is ready to be shown it is moved into picture, frame is set to its
+	// index in the file list, and true is returned. Otherwise the frame already on screen should stay.
+	bool Update(tImage::tPicture& picture, int& frame);
+
+	// Only a sequence that doesn't loop can finish. It is finished once the last frame has been shown or dropped.
+	bool IsFinished() const;
+
+	struct Stats
+	{
+		float TargetFPS		= 0.0f;
+		float AchievedFPS	= 0.0f;						// Frames shown per second over the last second.
+		float DecodeTime	= 0.0f;						// Average seconds for one thread to decode a frame.
+		float DecodeFPS		= 0.0f;						// Frames per second all the threads can decode.
+
+		// DecodeFPS over TargetFPS. Below one the decoders can't keep up and frames get dropped. Zero when there is no
+		// target rate.
+		float Headroom		= 0.0f;
+		int NumThreads		= 0;
+		int NumShown		= 0;
+		int NumDropped		= 0;
+		int NumDecoded		= 0;
+		int NumBuffered		= 0;						// Decoded frames waiting to be shown.
+	};
+	Stats GetStats() const;
+
+private:
+	// Position counts frames from the start of playback and keeps counting when the sequence loops. The frame file is
+	// Position % NumFrames and the ring slot is Position % BufferFrames.
+	struct Slot
+	{
+		int64 Position		= -1;
+		bool Ready			= false;
+		tImage::tPicture Picture;						// Invalid when ready if the decode failed.
+	};
+
+	void Work();
+	void RestartClock();
+
+	tArray<tString> Files;
+	int NumFrames = 0;
+	float FPS = 0.0f;
+	bool Loop = true;
+	bool Playing = false;
+
+	// The playback clock is advanced from the high resolution time each update.
+	tSystem::tTimer Clock;
+	double LastUpdateTime = 0.0;
+	int64 ClockOrigin = 0;								// The position due when the clock reads zero.
+
+	// Everything below is shared with the workers. Slots from Playhead to Playhead + BufferFrames are decoded.
+	mutable std::mutex Mutex;
+	std::condition_variable Condition;
+	std::thread* Workers = nullptr;
+	int NumThreads = 0;
+	bool Quit = false;
+	Slot* Slots = nullptr;
+	int BufferFrames = 0;
+	int64 Playhead = 0;
+	int64 Shown = -1;
+
+	int NumShown = 0;
+	int NumDropped = 0;
+	int NumDecoded = 0;
+	double DecodeSeconds = 0.0;
+
+	// The wall clock times of the most recent frames shown, for the achieved rate.
+	const static int NumShowTimes = 256;
+	double ShowTimes[NumShowTimes];
+	int ShowTimesNext = 0;
+};
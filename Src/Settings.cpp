@@ -42,13 +42,21 @@ void Settings::Reset()
 	ResampleFilter			= 2;
 	ConfirmDeletes			= true;
 	ConfirmFileOverwrites	= true;
+	SingleInstance			= false;
 
 	SlidehowFrameDuration	= 1.0/30.0;
+	SequenceFPS				= 24.0f;
+	SequenceBufferFrames	= 32;
 	FileSaveType			= 0;
 	FileSaveTargaRLE		= false;
+	FileSavePNGLevel		= 2;
+	FileSaveJPGMode			= 1;
+	FileSaveJPGEdge			= 0;
 	SaveAllSizeMode			= 0;
 	MaxImageMemMB			= 1024;
 	MaxCacheFiles			= 7000;
+	MaxDecodeCacheMB		= 2048;
+	MaxUndoMB				= 256;
 }
 
 
@@ -90,12 +98,20 @@ void Settings::Load(const tString& filename, int screenW, int screenH)
 				ReadItem(ResampleFilter);
 				ReadItem(ConfirmDeletes);
 				ReadItem(ConfirmFileOverwrites);
+				ReadItem(SingleInstance);
 				ReadItem(SlidehowFrameDuration);
+				ReadItem(SequenceFPS);
+				ReadItem(SequenceBufferFrames);
 				ReadItem(FileSaveType);
 				ReadItem(FileSaveTargaRLE);
+				ReadItem(FileSavePNGLevel);
+				ReadItem(FileSaveJPGMode);
+				ReadItem(FileSaveJPGEdge);
 				ReadItem(SaveAllSizeMode);
 				ReadItem(MaxImageMemMB);
 				ReadItem(MaxCacheFiles);
+				ReadItem(MaxDecodeCacheMB);
+				ReadItem(MaxUndoMB);
 			}
 		}
 	}
@@ -107,12 +123,19 @@ void Settings::Load(const tString& filename, int screenW, int screenH)
 	tiClamp(WindowX, 0, screenW - WindowW);
 	tiClamp(WindowY, 0, screenH - WindowH);
 	tiClamp(OverlayCorner, 0, 3);
-	tiClamp(FileSaveType, 0, 4);
+	tiClamp(FileSaveType, 0, 5);
+	tiClamp(FileSavePNGLevel, 0, 3);
+	tiClamp(FileSaveJPGMode, 0, 2);
+	tiClamp(FileSaveJPGEdge, 0, 1);
 	tiClamp(ThumbnailWidth, float(TacitImage::ThumbMinDispWidth), float(TacitImage::ThumbWidth));
 	tiClamp(SortKey, 0, 3);
 	tiClampMin(MaxImageMemMB, 256);
 	tiClampMin(MaxCacheFiles, 200);
+	tiClampMin(MaxDecodeCacheMB, 0);
+	tiClampMin(MaxUndoMB, 0);
 	tiClamp(SaveAllSizeMode, 0, 3);
+	tiClamp(SequenceFPS, 0.0f, 240.0f);
+	tiClamp(SequenceBufferFrames, 2, 256);
 }
 
 
@@ -139,12 +162,20 @@ bool Settings::Save(const tString& filename)
 	WriteItem(ResampleFilter);
 	WriteItem(ConfirmDeletes);
 	WriteItem(ConfirmFileOverwrites);
+	WriteItem(SingleInstance);
 	WriteItem(SlidehowFrameDuration);
+	WriteItem(SequenceFPS);
+	WriteItem(SequenceBufferFrames);
 	WriteItem(FileSaveType);
 	WriteItem(FileSaveTargaRLE);
+	WriteItem(FileSavePNGLevel);
+	WriteItem(FileSaveJPGMode);
+	WriteItem(FileSaveJPGEdge);
 	WriteItem(SaveAllSizeMode);
 	WriteItem(MaxImageMemMB);
 	WriteItem(MaxCacheFiles);
+	WriteItem(MaxDecodeCacheMB);
+	WriteItem(MaxUndoMB);
 	
 	return true;
 }
@@ -53,9 +53,21 @@ struct Settings
 	int ResampleFilter;					// Matches tImage::tPicture::tFilter.
 	bool ConfirmDeletes;
 	bool ConfirmFileOverwrites;
+	bool SingleInstance;				// New launches hand their files to the running viewer.
 	double SlidehowFrameDuration;
+	float SequenceFPS;					// Zero plays sequences as fast as they decode.
+	int SequenceBufferFrames;			// Frames of a sequence decoded ahead of the one shown.
 	int FileSaveType;
 	bool FileSaveTargaRLE;
+	int FileSavePNGLevel;				// Matches tImage::tFilePNG::tLevel.
+	enum class JPGSaveMode
+	{
+		Reencode,						// Decode, edit, and compress again. Loses quality each time.
+		Lossless,						// Rotates and flips the compressed blocks directly.
+		Orientation						// Only changes the exif orientation tag.
+	};
+	int FileSaveJPGMode;				// Matches JPGSaveMode values.
+	int FileSaveJPGEdge;				// Matches tImage::tFileJPG::tEdge.
 	enum class SizeMode
 	{
 		Percent,
@@ -66,6 +78,8 @@ struct Settings
 	int SaveAllSizeMode;
 	int MaxImageMemMB;					// Max image mem before unloading images.
 	int MaxCacheFiles;					// Max number of cache files before removing oldest.
+	int MaxDecodeCacheMB;				// Disk space for caching decoded pixels. Zero turns the cache off.
+	int MaxUndoMB;						// Memory for the undo history of each image.
 
 	void Load(const tString& filename, int screenWidth, int screenHeight);
 	bool Save(const tString& filename);
@@ -0,0 +1,736 @@
+// SingleInstance.cpp
+//
+// Lets a new launch of the viewer hand its files to one that is already running instead of starting up. The running
+// viewer listens on a named pipe on Windows and a Unix domain socket elsewhere. A launch connects, sends its file list
+// and exits as soon as the running viewer accepts it. If nothing is listening the launch starts up as normal.
+//
+// Copyright (c) 2020 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <Foundation/tStandard.h>
+#include <Math/tFundamentals.h>
+#include <System/tPrint.h>
+#include <System/tTime.h>
+#ifdef PLATFORM_WIN
+#include <Windows.h>
+#else
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <poll.h>
+#include <errno.h>
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+#endif
+#include "SingleInstance.h"
+
+
+namespace
+{
+	// Time limits cover a whole exchange rather than each step of it, so a peer that trickles bytes or never answers
+	// can only hold the other end up for as long as it was given.
+	double GetDeadline(int timeoutMS)
+	{
+		return SingleInstance::GetClock() + double(timeoutMS)/1000.0;
+	}
+
+
+	int GetRemainingMS(double deadline)
+	{
+		double remaining = deadline - SingleInstance::GetClock();
+		return (remaining > 0.0) ? int(remaining*1000.0) + 1 : 0;
+	}
+
+
+	#ifdef PLATFORM_WIN
+	typedef HANDLE Connection;
+
+
+	bool ReadAll(Connection pipe, void* dest, int numBytes, double deadline)
+	{
+		// The pipes are overlapped so a read can be given up on.
+		HANDLE event = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+		if (!event)
+			return false;
+
+		uint8* d = (uint8*)dest;
+		bool ok = true;
+		while ((numBytes > 0) && ok)
+		{
+			OVERLAPPED overlapped;
+			tStd::tMemset(&overlapped, 0, sizeof(overlapped));
+			overlapped.hEvent = event;
+			if (!ReadFile(pipe, d, numBytes, nullptr, &overlapped) && (GetLastError() != ERROR_IO_PENDING))
+			{
+				ok = false;
+				break;
+			}
+
+			if (WaitForSingleObject(event, GetRemainingMS(deadline)) != WAIT_OBJECT_0)
+				CancelIo(pipe);
+
+			DWORD numRead = 0;
+			ok = GetOverlappedResult(pipe, &overlapped, &numRead, TRUE) && (numRead > 0);
+			d += numRead;
+			numBytes -= int(numRead);
+		}
+
+		CloseHandle(event);
+		return ok;
+	}
+
+
+	bool WriteAll(Connection pipe, const void* src, int numBytes, double deadline)
+	{
+		HANDLE event = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+		if (!event)
+			return false;
+
+		const uint8* s = (const uint8*)src;
+		bool ok = true;
+		while ((numBytes > 0) && ok)
+		{
+			OVERLAPPED overlapped;
+			tStd::tMemset(&overlapped, 0, sizeof(overlapped));
+			overlapped.hEvent = event;
+			if (!WriteFile(pipe, s, numBytes, nullptr, &overlapped) && (GetLastError() != ERROR_IO_PENDING))
+			{
+				ok = false;
+				break;
+			}
+
+			if (WaitForSingleObject(event, GetRemainingMS(deadline)) != WAIT_OBJECT_0)
+				CancelIo(pipe);
+
+			DWORD numWritten = 0;
+			ok = GetOverlappedResult(pipe, &overlapped, &numWritten, TRUE) && (numWritten > 0);
+			s += numWritten;
+			numBytes -= int(numWritten);
+		}
+
+		CloseHandle(event);
+		return ok;
+	}
+
+
+	// Fills in the user of a process. The buffer is big enough for any SID. Returns nullptr if the process can't be
+	// queried, which is the case for processes of other users.
+	PSID GetProcessUser(HANDLE process, TOKEN_USER* buffer, DWORD bufferSize)
+	{
+		HANDLE token = nullptr;
+		if (!OpenProcessToken(process, TOKEN_QUERY, &token))
+			return nullptr;
+
+		DWORD size = 0;
+		BOOL ok = GetTokenInformation(token, TokenUser, buffer, bufferSize, &size);
+		CloseHandle(token);
+		return ok ? buffer->User.Sid : nullptr;
+	}
+
+
+	// Anyone on the machine can create a pipe with our name, and anyone can connect to ours, so both ends check that
+	// the process at the other end runs as this user in this session before trusting it.
+	bool IsSameUserAndSession(ULONG processID)
+	{
+		DWORD ourSession = 0;
+		DWORD theirSession = 0;
+		if (!ProcessIdToSessionId(GetCurrentProcessId(), &ourSession))
+			return false;
+		if (!ProcessIdToSessionId(processID, &theirSession) || (theirSession != ourSession))
+			return false;
+
+		HANDLE process = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, processID);
+		if (!process)
+			return false;
+
+		const DWORD bufferSize = sizeof(TOKEN_USER) + SECURITY_MAX_SID_SIZE;
+		alignas(TOKEN_USER) uint8 ourBuffer[bufferSize];
+		alignas(TOKEN_USER) uint8 theirBuffer[bufferSize];
+		PSID ourUser = GetProcessUser(GetCurrentProcess(), (TOKEN_USER*)ourBuffer, bufferSize);
+		PSID theirUser = GetProcessUser(process, (TOKEN_USER*)theirBuffer, bufferSize);
+		CloseHandle(process);
+		return ourUser && theirUser && EqualSid(ourUser, theirUser);
+	}
+
+
+	#else
+	typedef int Connection;
+
+
+	bool ReadAll(Connection sock, void* dest, int numBytes, double deadline)
+	{
+		uint8* d = (uint8*)dest;
+		while (numBytes > 0)
+		{
+			pollfd fd = { sock, POLLIN, 0 };
+			int numReady = poll(&fd, 1, GetRemainingMS(deadline));
+			if ((numReady < 0) && (errno == EINTR))
+				continue;
+			if (numReady <= 0)
+				return false;
+
+			ssize_t numRead = recv(sock, d, numBytes, 0);
+			if ((numRead < 0) && ((errno == EINTR) || (errno == EAGAIN)))
+				continue;
+			if (numRead <= 0)
+				return false;
+
+			d += numRead;
+			numBytes -= int(numRead);
+		}
+
+		return true;
+	}
+
+
+	bool WriteAll(Connection sock, const void* src, int numBytes, double deadline)
+	{
+		const uint8* s = (const uint8*)src;
+		while (numBytes > 0)
+		{
+			pollfd fd = { sock, POLLOUT, 0 };
+			int numReady = poll(&fd, 1, GetRemainingMS(deadline));
+			if ((numReady < 0) && (errno == EINTR))
+				continue;
+			if (numReady <= 0)
+				return false;
+
+			// MSG_NOSIGNAL stops a closed connection from raising SIGPIPE and killing the process.
+			ssize_t numWritten = send(sock, s, numBytes, MSG_NOSIGNAL);
+			if ((numWritten < 0) && ((errno == EINTR) || (errno == EAGAIN)))
+				continue;
+			if (numWritten <= 0)
+				return false;
+
+			s += numWritten;
+			numBytes -= int(numWritten);
+		}
+
+		return true;
+	}
+
+
+	bool MakeAddress(sockaddr_un& addr, const tString& endpoint)
+	{
+		tStd::tMemset(&addr, 0, sizeof(addr));
+		addr.sun_family = AF_UNIX;
+		if (endpoint.Length() >= int(sizeof(addr.sun_path)))
+			return false;
+
+		tStd::tStrcpy(addr.sun_path, endpoint.Chars());
+		return true;
+	}
+
+
+	// Connects a non-blocking socket. A listener that has stopped accepting fills its backlog, and a blocking connect
+	// would then wait for it forever. Linux refuses with EAGAIN while the backlog is full instead of queueing, so that
+	// is retried until the deadline. Elsewhere the connect is in progress and done once the socket is writable.
+	bool Connect(int sock, const sockaddr_un& addr, double deadline)
+	{
+		while (true)
+		{
+			if (connect(sock, (const sockaddr*)&addr, sizeof(addr)) == 0)
+				return true;
+
+			if ((errno == EINPROGRESS) || (errno == EINTR))
+			{
+				pollfd fd = { sock, POLLOUT, 0 };
+				int numReady = 0;
+				while (((numReady = poll(&fd, 1, GetRemainingMS(deadline))) < 0) && (errno == EINTR));
+				int error = 0;
+				socklen_t size = sizeof(error);
+				return (numReady > 0) && (getsockopt(sock, SOL_SOCKET, SO_ERROR, &error, &size) == 0) && !error;
+			}
+
+			if ((errno != EAGAIN) || !GetRemainingMS(deadline))
+				return false;
+			tSystem::tSleep(5);
+		}
+	}
+
+
+	// The socket must be in a directory owned by this user that nobody else can get into. Otherwise another user could
+	// bind the path first, or swap the socket for their own, and take the files. If create is true and the directory
+	// doesn't exist it is made. Returns false if the directory isn't private.
+	bool IsPrivateDir(const tString& endpoint, bool create)
+	{
+		tString dir = endpoint.Prefix(endpoint.FindChar('/', true));
+		struct stat info;
+		if (lstat(dir.Chars(), &info) != 0)
+		{
+			if (!create || (errno != ENOENT) || (mkdir(dir.Chars(), S_IRWXU) != 0) || (lstat(dir.Chars(), &info) != 0))
+				return false;
+		}
+
+		return S_ISDIR(info.st_mode) && (info.st_uid == getuid()) && !(info.st_mode & (S_IRWXG | S_IRWXO));
+	}
+
+
+	// The private directory keeps others from binding or replacing the socket, and this keeps a process of another
+	// user from talking to it through a socket it was handed.
+	bool IsSameUser(int sock)
+	{
+		#ifdef SO_PEERCRED
+		ucred cred;
+		socklen_t size = sizeof(cred);
+		return (getsockopt(sock, SOL_SOCKET, SO_PEERCRED, &cred, &size) == 0) && (cred.uid == getuid());
+		#else
+		uid_t uid = 0;
+		gid_t gid = 0;
+		return (getpeereid(sock, &uid, &gid) == 0) && (uid == getuid());
+		#endif
+	}
+	#endif
+
+
+	// How long the listener waits on a sender that has connected. A sender that stalls can't hold it up for longer.
+	const int ServeTimeoutMS = 1000;
+
+
+	// Reads one message from a sender. Bad messages get RejectReply here. Returns the request if the message was good,
+	// in which case the caller sends the reply.
+	SingleInstance::Request* ReadRequest(Connection connection)
+	{
+		// The header is read first so the payload size can be checked before anything is allocated for it.
+		double deadline = GetDeadline(ServeTimeoutMS);
+		uint8 header[SingleInstance::HeaderBytes];
+		if (!ReadAll(connection, header, SingleInstance::HeaderBytes, deadline))
+			return nullptr;
+
+		uint32 magic = 0;
+		uint32 payloadBytes = 0;
+		tStd::tMemcpy(&magic, header, 4);
+		tStd::tMemcpy(&payloadBytes, header+4, 4);
+		uint8 reject = SingleInstance::RejectReply;
+		if ((magic != SingleInstance::Magic) || (payloadBytes > SingleInstance::MaxPayloadBytes))
+		{
+			WriteAll(connection, &reject, 1, deadline);
+			return nullptr;
+		}
+
+		int numBytes = SingleInstance::HeaderBytes + int(payloadBytes);
+		uint8* message = new uint8[numBytes];
+		tStd::tMemcpy(message, header, SingleInstance::HeaderBytes);
+		if (!ReadAll(connection, message + SingleInstance::HeaderBytes, int(payloadBytes), deadline))
+		{
+			delete[] message;
+			return nullptr;
+		}
+
+		SingleInstance::Request* request = new SingleInstance::Request;
+		if (!SingleInstance::Decode(*request, message, numBytes))
+		{
+			delete request;
+			request = nullptr;
+			WriteAll(connection, &reject, 1, deadline);
+		}
+
+		delete[] message;
+		return request;
+	}
+}
+
+
+uint8* SingleInstance::Encode(int& numBytes, const tList<tStringItem>& files, double launchTime)
+{
+	int payloadBytes = 0;
+	for (tStringItem* file = files.First(); file; file = file->Next())
+		payloadBytes += file->Length() + 1;
+
+	numBytes = HeaderBytes + payloadBytes;
+	uint8* message = new uint8[numBytes];
+	uint32 magic = Magic;
+	uint32 size = uint32(payloadBytes);
+	tStd::tMemcpy(message, &magic, 4);
+	tStd::tMemcpy(message+4, &size, 4);
+	tStd::tMemcpy(message+8, &launchTime, 8);
+
+	uint8* dest = message + HeaderBytes;
+	for (tStringItem* file = files.First(); file; file = file->Next())
+	{
+		tStd::tMemcpy(dest, file->Chars(), file->Length() + 1);
+		dest += file->Length() + 1;
+	}
+
+	return message;
+}
+
+
+bool SingleInstance::Decode(Request& request, const uint8* message, int numBytes)
+{
+	request.Files.Empty();
+	if (!message || (numBytes < HeaderBytes))
+		return false;
+
+	uint32 magic = 0;
+	uint32 payloadBytes = 0;
+	tStd::tMemcpy(&magic, message, 4);
+	tStd::tMemcpy(&payloadBytes, message+4, 4);
+	if ((magic != Magic) || (payloadBytes > MaxPayloadBytes) || (int(payloadBytes) != numBytes - HeaderBytes))
+		return false;
+
+	// Every path must be terminated and none may be empty. An empty list is fine and just brings the viewer forward.
+	const char* payload = (const char*)(message + HeaderBytes);
+	if ((payloadBytes > 0) && (payload[payloadBytes-1] != '\0'))
+		return false;
+
+	for (int offset = 0; offset < int(payloadBytes); )
+	{
+		int length = tStd::tStrlen(payload + offset);
+		if (length == 0)
+		{
+			request.Files.Empty();
+			return false;
+		}
+		request.Files.Append(new tStringItem(payload + offset));
+		offset += length + 1;
+	}
+
+	tStd::tMemcpy(&request.LaunchTime, message+8, 8);
+	return true;
+}
+
+
+double SingleInstance::GetClock()
+{
+	return double(tSystem::tGetHardwareTimerCount()) / double(tSystem::tGetHardwareTimerFrequency());
+}
+
+
+tString SingleInstance::GetEndpoint(const tString& name)
+{
+	tString endpoint;
+	#ifdef PLATFORM_WIN
+	char user[256];
+	DWORD userSize = sizeof(user);
+	if (!GetUserNameA(user, &userSize))
+		tStd::tStrcpy(user, "User");
+	DWORD session = 0;
+	ProcessIdToSessionId(GetCurrentProcessId(), &session);
+	tsPrintf(endpoint, "\\\\.\\pipe\\%s-%s-%d", name.Chars(), user, int(session));
+	#else
+	// The runtime dir is private to the user by definition. Without one we make our own private dir.
+	const char* runtimeDir = getenv("XDG_RUNTIME_DIR");
+	if (runtimeDir && (runtimeDir[0] == '/'))
+		tsPrintf(endpoint, "%s/%s.sock", runtimeDir, name.Chars());
+	else
+		tsPrintf(endpoint, "/tmp/%s-%d/%s.sock", name.Chars(), int(getuid()), name.Chars());
+	#endif
+	return endpoint;
+}
+
+
+bool SingleInstance::Handoff(const tString& name, const tList<tStringItem>& files, double launchTime, int timeoutMS)
+{
+	int numBytes = 0;
+	uint8* message = Encode(numBytes, files, launchTime);
+	uint8 reply = RejectReply;
+	bool sent = Send(GetEndpoint(name), message, numBytes, timeoutMS, reply);
+	delete[] message;
+	return sent && (reply == AcceptReply);
+}
+
+
+bool SingleInstance::Send(const tString& endpoint, const uint8* message, int numBytes, int timeoutMS, uint8& reply)
+{
+	double deadline = GetDeadline(timeoutMS);
+
+	#ifdef PLATFORM_WIN
+	HANDLE pipe = INVALID_HANDLE_VALUE;
+	while (true)
+	{
+		// The listener is only allowed to identify us, not act as us.
+		pipe = CreateFileA
+		(
+			endpoint.Chars(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_EXISTING,
+			FILE_FLAG_OVERLAPPED | SECURITY_SQOS_PRESENT | SECURITY_IDENTIFICATION, nullptr
+		);
+		if (pipe != INVALID_HANDLE_VALUE)
+			break;
+
+		// Busy means the listener is between connections, or has hung and stopped taking them, so it is only waited on
+		// until the deadline. Anything else, usually file not found, means no listener. A wait of zero would mean the
+		// pipe's default rather than none.
+		DWORD error = GetLastError();
+		int remainingMS = GetRemainingMS(deadline);
+		if ((error != ERROR_PIPE_BUSY) || !remainingMS || !WaitNamedPipeA(endpoint.Chars(), remainingMS))
+			return false;
+	}
+
+	// Paths only go to a viewer of our own. Windows only lets it come to the front if the process that has the
+	// foreground says it may.
+	ULONG serverProcessID = 0;
+	if (!GetNamedPipeServerProcessId(pipe, &serverProcessID) || !IsSameUserAndSession(serverProcessID))
+	{
+		CloseHandle(pipe);
+		return false;
+	}
+	AllowSetForegroundWindow(serverProcessID);
+
+	bool ok = WriteAll(pipe, message, numBytes, deadline) && ReadAll(pipe, &reply, 1, deadline);
+	CloseHandle(pipe);
+	return ok;
+
+	#else
+	sockaddr_un addr;
+	if (!MakeAddress(addr, endpoint) || !IsPrivateDir(endpoint, false))
+		return false;
+
+	int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (sock < 0)
+		return false;
+
+	bool ok =
+		(fcntl(sock, F_SETFL, fcntl(sock, F_GETFL) | O_NONBLOCK) == 0) &&
+		Connect(sock, addr, deadline) && IsSameUser(sock) &&
+		WriteAll(sock, message, numBytes, deadline) &&
+		ReadAll(sock, &reply, 1, deadline);
+	close(sock);
+	return ok;
+	#endif
+}
+
+
+bool SingleInstance::Listen(const tString& name)
+{
+	Stop();
+	Endpoint = GetEndpoint(name);
+
+	#ifdef PLATFORM_WIN
+	// Only the first instance of a pipe may use FILE_FLAG_FIRST_PIPE_INSTANCE, so a second viewer fails here. Remote
+	// clients are rejected so only this machine can open files in the viewer.
+	HANDLE pipe = CreateNamedPipeA
+	(
+		Endpoint.Chars(), PIPE_ACCESS_DUPLEX | FILE_FLAG_FIRST_PIPE_INSTANCE | FILE_FLAG_OVERLAPPED,
+		PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+		PIPE_UNLIMITED_INSTANCES, 4096, 4096, 0, nullptr
+	);
+	if (pipe == INVALID_HANDLE_VALUE)
+		return false;
+
+	QuitEvent = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+	if (!QuitEvent)
+	{
+		CloseHandle(pipe);
+		return false;
+	}
+	FirstPipe = pipe;
+
+	#else
+	sockaddr_un addr;
+	if (!MakeAddress(addr, Endpoint) || !IsPrivateDir(Endpoint, true))
+		return false;
+
+	ListenSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (ListenSocket < 0)
+		return false;
+
+	bool bound = (bind(ListenSocket, (sockaddr*)&addr, sizeof(addr)) == 0);
+	if (!bound && (errno == EADDRINUSE))
+	{
+		// The socket file outlives a viewer that crashed. If nothing answers on it, it's stale and can be replaced. The
+		// probe doesn't block so a viewer with a full backlog counts as answering rather than holding this up.
+		int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+		bool answered =
+			(probe >= 0) && (fcntl(probe, F_SETFL, fcntl(probe, F_GETFL) | O_NONBLOCK) == 0) &&
+			(
+				(connect(probe, (sockaddr*)&addr, sizeof(addr)) == 0) ||
+				(errno == EAGAIN) || (errno == EINPROGRESS) || (errno == EINTR)
+			);
+		if (probe >= 0)
+			close(probe);
+		if (!answered)
+		{
+			unlink(Endpoint.Chars());
+			bound = (bind(ListenSocket, (sockaddr*)&addr, sizeof(addr)) == 0);
+		}
+	}
+
+	if (!bound || (listen(ListenSocket, 8) != 0) || (pipe(WakePipe) != 0))
+	{
+		// The endpoint is only unlinked if this instance bound it, otherwise it belongs to the running viewer.
+		close(ListenSocket);
+		ListenSocket = -1;
+		if (bound)
+			unlink(Endpoint.Chars());
+		WakePipe[0] = WakePipe[1] = -1;
+		return false;
+	}
+
+	// The directory already keeps other users out. This is in case it is ever shared.
+	chmod(Endpoint.Chars(), S_IRUSR | S_IWUSR);
+	#endif
+
+	Worker = new std::thread(&SingleInstance::Work, this);
+	return true;
+}
+
+
+void SingleInstance::Stop()
+{
+	if (!Worker)
+		return;
+
+	#ifdef PLATFORM_WIN
+	SetEvent(QuitEvent);
+	Worker->join();
+	CloseHandle(QuitEvent);
+	QuitEvent = nullptr;
+
+	#else
+	uint8 quit = 'Q';
+	while ((write(WakePipe[1], &quit, 1) < 0) && (errno == EINTR));
+	Worker->join();
+	close(ListenSocket);
+	close(WakePipe[0]);
+	close(WakePipe[1]);
+	ListenSocket = -1;
+	WakePipe[0] = WakePipe[1] = -1;
+	unlink(Endpoint.Chars());
+	#endif
+
+	delete Worker;
+	Worker = nullptr;
+
+	std::lock_guard<std::mutex> lock(Mutex);
+	Requests.Empty();
+}
+
+
+SingleInstance::Request* SingleInstance::Receive()
+{
+	std::lock_guard<std::mutex> lock(Mutex);
+	return Requests.Remove();
+}
+
+
+void SingleInstance::Serve(Connection connection)
+{
+	Request* request = ReadRequest(connection);
+	if (!request)
+		return;
+
+	// The request is queued before the reply goes out, so once a sender hears back the files are ready to open.
+	{
+		std::lock_guard<std::mutex> lock(Mutex);
+		Requests.Append(request);
+	}
+
+	uint8 reply = AcceptReply;
+	if (WriteAll(connection, &reply, 1, GetDeadline(ServeTimeoutMS)))
+		return;
+
+	// The sender didn't hear back so it starts up by itself. The request is taken back unless it was already received.
+	std::lock_guard<std::mutex> lock(Mutex);
+	for (Request* queued = Requests.First(); queued; queued = queued->Next())
+	{
+		if (queued == request)
+		{
+			delete Requests.Remove(request);
+			break;
+		}
+	}
+}
+
+
+void SingleInstance::Work()
+{
+	#ifdef PLATFORM_WIN
+	HANDLE pipe = FirstPipe;
+	FirstPipe = nullptr;
+	HANDLE connectEvent = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+	while (pipe != INVALID_HANDLE_VALUE)
+	{
+		OVERLAPPED overlapped;
+		tStd::tMemset(&overlapped, 0, sizeof(overlapped));
+		overlapped.hEvent = connectEvent;
+
+		// An overlapped ConnectNamedPipe never succeeds straight away. A sender that got in before it was called shows
+		// up as ERROR_PIPE_CONNECTED.
+		bool connected = false;
+		ConnectNamedPipe(pipe, &overlapped);
+		DWORD error = GetLastError();
+		if (error == ERROR_IO_PENDING)
+		{
+			HANDLE events[2] = { QuitEvent, connectEvent };
+			if (WaitForMultipleObjects(2, events, FALSE, INFINITE) != WAIT_OBJECT_0 + 1)
+			{
+				CancelIo(pipe);
+				DWORD dummy = 0;
+				GetOverlappedResult(pipe, &overlapped, &dummy, TRUE);
+				break;
+			}
+			DWORD dummy = 0;
+			connected = GetOverlappedResult(pipe, &overlapped, &dummy, FALSE) ? true : false;
+		}
+		else
+		{
+			connected = (error == ERROR_PIPE_CONNECTED);
+		}
+
+		// The next instance is made before this one is closed so there's never a moment with no pipe, which would let
+		// another viewer take the name.
+		HANDLE next = CreateNamedPipeA
+		(
+			Endpoint.Chars(), PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED,
+			PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+			PIPE_UNLIMITED_INSTANCES, 4096, 4096, 0, nullptr
+		);
+
+		ULONG clientProcessID = 0;
+		if (connected && GetNamedPipeClientProcessId(pipe, &clientProcessID) && IsSameUserAndSession(clientProcessID))
+		{
+			// Disconnecting throws away anything the sender hasn't read, so this waits for it to close its end first.
+			Serve(pipe);
+			uint8 dummy = 0;
+			ReadAll(pipe, &dummy, 1, GetDeadline(ServeTimeoutMS));
+		}
+		if (connected)
+			DisconnectNamedPipe(pipe);
+		CloseHandle(pipe);
+		pipe = next;
+	}
+
+	if (pipe != INVALID_HANDLE_VALUE)
+		CloseHandle(pipe);
+	CloseHandle(connectEvent);
+
+	#else
+	while (true)
+	{
+		pollfd fds[2] = { { ListenSocket, POLLIN, 0 }, { WakePipe[0], POLLIN, 0 } };
+		if (poll(fds, 2, -1) < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+
+		if (fds[1].revents)
+			break;
+
+		if (!(fds[0].revents & POLLIN))
+			continue;
+
+		int connection = accept(ListenSocket, nullptr, nullptr);
+		if (connection < 0)
+			continue;
+
+		if (IsSameUser(connection))
+			Serve(connection);
+		close(connection);
+	}
+	#endif
+}
+
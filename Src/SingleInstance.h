@@ -0,0 +1,100 @@
+// SingleInstance.h
+//
+// Lets a new launch of the viewer hand its files to one that is already running instead of starting up. The running
+// viewer listens on a named pipe on Windows and a Unix domain socket elsewhere. A launch connects, sends its file list
+// and exits as soon as the running viewer accepts it. If nothing is listening the launch starts up as normal.
+//
+// Copyright (c) 2020 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#pragma once
+#include <thread>
+#include <mutex>
+#include <Foundation/tPlatform.h>
+#include <Foundation/tList.h>
+#include <Foundation/tString.h>
+
+
+class SingleInstance
+{
+public:
+	SingleInstance()																									{ }
+	~SingleInstance()																									{ Stop(); }
+
+	// The pipe or socket path for name. Each user gets their own instance, and on Windows so does each session. The
+	// socket goes in $XDG_RUNTIME_DIR, or in a directory in /tmp only this user can enter if that isn't set. Both ends
+	// check that the other runs as the same user before any paths are sent.
+	static tString GetEndpoint(const tString& name);
+
+	// Seconds on a clock every process shares. tGetTimeDouble can't be compared between processes since it starts at
+	// zero in each one.
+	static double GetClock();
+
+	// Sends the files to the instance listening on name and waits up to timeoutMS for it to accept them. The launch
+	// time is the sender's GetClock when it started, so the receiver can report how long the open took. Returns false
+	// if nothing is listening or the files weren't accepted, in which case this launch should start normally.
+	static bool Handoff(const tString& name, const tList<tStringItem>& files, double launchTime, int timeoutMS = 1000);
+
+	// Starts listening on a worker thread. Returns false if another instance is already listening or the endpoint
+	// couldn't be created.
+	bool Listen(const tString& name);
+	void Stop();
+	bool IsListening() const																							{ return Worker ? true : false; }
+
+	struct Request : public tLink<Request>
+	{
+		tList<tStringItem> Files;
+		double LaunchTime = 0.0;
+	};
+
+	// Takes the oldest accepted request. The caller must delete it. Returns nullptr if none are waiting.
+	Request* Receive();
+
+	// A message is a header holding Magic, the payload size and the launch time, followed by the payload of file paths,
+	// each null terminated. The listener replies with a single AcceptReply or RejectReply byte. Encode returns a buffer
+	// the caller must delete[].
+	static uint8* Encode(int& numBytes, const tList<tStringItem>& files, double launchTime);
+	static bool Decode(Request&, const uint8* message, int numBytes);
+
+	// Sends an already encoded message to endpoint and gets the reply byte. Connecting, sending and the reply must all
+	// happen within timeoutMS. Returns false if nothing is listening or no reply came back in time.
+	static bool Send(const tString& endpoint, const uint8* message, int numBytes, int timeoutMS, uint8& reply);
+
+	const static uint32 Magic			= 0x31485654;	// TVH1 in memory.
+	const static int HeaderBytes		= 16;
+	const static int MaxPayloadBytes	= 1 << 20;
+	const static uint8 AcceptReply		= 'A';
+	const static uint8 RejectReply		= 'R';
+
+private:
+	#ifdef PLATFORM_WIN
+	typedef void* Connection;							// A HANDLE.
+	#else
+	typedef int Connection;
+	#endif
+
+	// Reads a message from the connection, queues the request if it is good and replies.
+	void Serve(Connection);
+	void Work();
+
+	std::thread* Worker = nullptr;
+	tString Endpoint;
+
+	std::mutex Mutex;
+	tList<Request> Requests;
+
+	#ifdef PLATFORM_WIN
+	void* QuitEvent = nullptr;							// Signalled by Stop to wake the worker.
+	void* FirstPipe = nullptr;							// Made by Listen and handed to the worker.
+	#else
+	int ListenSocket = -1;
+	int WakePipe[2] = { -1, -1 };						// Written by Stop to wake the worker.
+	#endif
+};
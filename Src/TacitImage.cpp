@@ -18,6 +18,9 @@
 #include <GLFW/glfw3.h>				// Include glfw3.h after our OpenGL definitions.
 #include <Math/tHash.h>
 #include <Image/tTexture.h>
+#include <Image/tBlockCompress.h>
+#include <Image/tPixelConvert.h>
+#include <Image/tTiledPicture.h>
 #include <System/tFile.h>
 #include <System/tTime.h>
 #include <System/tMachine.h>
@@ -29,6 +32,7 @@ using namespace tImage;
 using namespace tMath;
 int TacitImage::ThumbnailNumThreadsRunning = 0;
 tString TacitImage::ThumbCacheDir;
+PixelCache TacitImage::DecodeCache;
 
 
 TacitImage::TacitImage() :
@@ -100,6 +104,11 @@ bool TacitImage::Load()
 			else
 			{
 				success = DDSTexture2D.Load(Filename);
+
+				// The texture is kept for as long as the image is loaded. Holding its mip chain in one block is one
+				// allocation instead of one per level.
+				if (success)
+					DDSTexture2D.MakeContiguous();
 				tImage::tPixelFormat pfmt = DDSTexture2D.GetPixelFormat();
 				if (tIsNormalFormat(pfmt))
 					srcFileBitdepth = tGetBytesPerPixel(pfmt) * 8;
@@ -107,10 +116,30 @@ bool TacitImage::Load()
 		}
 		else
 		{
-			tPicture* picture = new tPicture();
-			Pictures.Append(picture);
-			success = picture->Load(Filename);
+			// Big images may still have their decoded pixels cached from an earlier visit.
+			uint64 cacheKey = GetDecodeCacheKey();
+			success = cacheKey && DecodeCache.Load(Pictures, cacheKey);
+			if (!success)
+			{
+				float decodeStart = tSystem::tGetTime();
+				tPicture* picture = new tPicture();
+				Pictures.Append(picture);
+				success = picture->Load(Filename);
+				if (success && cacheKey && ((tSystem::tGetTime() - decodeStart) >= PixelCache::MinDecodeTime))
+					DecodeCache.SaveAsync(cacheKey, Pictures);
+			}
+
+			tPicture* picture = Pictures.First();
+			picture->Filename = Filename;
 			srcFileBitdepth = picture->SrcFileBitDepth;
+
+			// CxImage doesn't always report the number of frames in a GIF, but indexing one is cheap.
+			if (success && ((Filetype == tFileType::GIF) || (picture->SrcFileNumFrames > 1)))
+			{
+				if (!FrameSource.Open(Filename) || (FrameSource.GetNumFrames() <= 1))
+					FrameSource.Close();
+			}
+			CurrFrame = 0;
 		}
 	}
 	catch (tError error)
@@ -118,52 +147,128 @@ bool TacitImage::Load()
 		success = false;
 	}
 
-	if (Filetype == tSystem::tFileType::DDS)
+	// Decompressing the dds levels is a round trip through GL, so big ones are cached like any other slow decode.
+	if ((Filetype == tSystem::tFileType::DDS) && (DDSCubemap.IsValid() || DDSTexture2D.IsValid()))
 	{
-		if (DDSCubemap.IsValid())
-			ConvertCubemapToPicture();
-		else if (DDSTexture2D.IsValid())
-			ConvertTexture2DToPicture();
+		uint64 cacheKey = GetDecodeCacheKey();
+		if (!cacheKey || !DecodeCache.Load(Pictures, cacheKey))
+		{
+			float decodeStart = tSystem::tGetTime();
+			if (DDSCubemap.IsValid())
+				ConvertCubemapToPicture();
+			else
+				ConvertTexture2DToPicture();
+
+			if (cacheKey && ((tSystem::tGetTime() - decodeStart) >= PixelCache::MinDecodeTime))
+				DecodeCache.SaveAsync(cacheKey, Pictures);
+		}
 	}
 
 	if (success)
-	{
-		LoadedTime = tSystem::tGetTime();
+		FinishLoad(srcFileBitdepth);
 
-		// Fill in info struct.
-		Info.Width			= GetWidth();
-		Info.Height			= GetHeight();
+	return success;
+}
 
-		tPixelFormat format = tPixelFormat::Invalid;
-		if (Filetype == tSystem::tFileType::DDS)
-		{
-			if (DDSCubemap.IsValid())
-				format = DDSCubemap.GetSide(tCubemap::tSide::PosX)->GetPixelFormat();
-			else
-				format = DDSTexture2D.GetPixelFormat();
-		}
-		else
-		{
-			tPicture* picture = Pictures.First();
-			if (picture)
-				format = (srcFileBitdepth == 24) ? tPixelFormat::R8G8B8 : tPixelFormat::R8G8B8A8;
-		}
 
-		Info.PixelFormat		= tImage::tGetPixelFormatName(format);
-		Info.SrcFileBitDepth	= srcFileBitdepth;
-		Info.Opaque				= IsOpaque();
-		Info.FileSizeBytes		= tSystem::tGetFileSize(Filename);
-		Info.MemSizeBytes		= GetMemSizeBytes();
-		Info.Mipmaps			= Pictures.GetNumItems();
+bool TacitImage::LoadDecoded(tPicture&& picture)
+{
+	if (IsLoaded() || !picture.IsValid() || (Filetype == tSystem::tFileType::DDS))
+		return false;
+
+	int srcFileBitdepth = picture.SrcFileBitDepth;
+	tPicture* loaded = new tPicture(std::move(picture));
+	loaded->Filename = Filename;
+	Pictures.Append(loaded);
+	CurrFrame = 0;
+	FinishLoad(srcFileBitdepth);
+	return true;
+}
+
+
+void TacitImage::FinishLoad(int srcFileBitdepth)
+{
+	LoadedTime = tSystem::tGetTime();
+
+	// Fill in info struct.
+	Info.Width			= GetWidth();
+	Info.Height			= GetHeight();
 
-		// Create alt image if possible.
+	tPixelFormat format = tPixelFormat::Invalid;
+	if (Filetype == tSystem::tFileType::DDS)
+	{
 		if (DDSCubemap.IsValid())
-			CreateAltPictureDDSCubemap();
-		else if (DDSTexture2D.IsValid() && (Info.Mipmaps > 1))
-			CreateAltPictureDDS2DMipmaps();
+			format = DDSCubemap.GetSide(tCubemap::tSide::PosX)->GetPixelFormat();
+		else
+			format = DDSTexture2D.GetPixelFormat();
+	}
+	else
+	{
+		tPicture* picture = Pictures.First();
+		if (picture)
+			format = (srcFileBitdepth == 24) ? tPixelFormat::R8G8B8 : tPixelFormat::R8G8B8A8;
 	}
 
-	return success;
+	Info.PixelFormat		= tImage::tGetPixelFormatName(format);
+	Info.SrcFileBitDepth	= srcFileBitdepth;
+	Info.Opaque				= IsOpaque();
+	Info.FileSizeBytes		= tSystem::tGetFileSize(Filename);
+	Info.MemSizeBytes		= GetMemSizeBytes();
+	Info.Mipmaps			= Pictures.GetNumItems();
+
+	// Create alt image if possible.
+	if (DDSCubemap.IsValid())
+		CreateAltPictureDDSCubemap();
+	else if (DDSTexture2D.IsValid() && (Info.Mipmaps > 1))
+		CreateAltPictureDDS2DMipmaps();
+}
+
+
+uint64 TacitImage::GetDecodeCacheKey()
+{
+	if (!UseDecodeCache || !DecodeCache.IsValid() || (DecodeCache.GetMaxBytes() <= 0))
+		return 0;
+
+	Probe();
+	if ((int64(ProbedInfo.Width) * int64(ProbedInfo.Height)) < PixelCache::MinPixels)
+		return 0;
+
+	// The file type picks the decoder. Load has no other options that change the pixels.
+	return PixelCache::ComputeKey(Filename, uint32(Filetype));
+}
+
+
+bool TacitImage::Probe()
+{
+	// A file that fails to probe would fail every frame, so we only try once.
+	if (!Probed)
+	{
+		tImageInfo probed;
+		tProbeImage(probed, Filename);
+		SetProbedInfo(probed);
+	}
+
+	return Info.IsValid();
+}
+
+
+void TacitImage::SetProbedInfo(const tImageInfo& probed)
+{
+	Probed = true;
+	ProbedInfo = probed;
+	// Info from a load is more accurate, so it isn't replaced.
+	if (!probed.IsValid() || Info.IsValid())
+		return;
+
+	// Bit depths match what Load reports. Block compressed dds files don't have one.
+	Info.Width				= probed.Width;
+	Info.Height				= probed.Height;
+	Info.PixelFormat		= tGetPixelFormatName(probed.PixelFormat);
+	Info.SrcFileBitDepth	= (tIsNormalFormat(probed.PixelFormat) || (Filetype != tFileType::DDS)) ? probed.BitDepth : -1;
+	Info.Opaque				= probed.Opaque;
+	Info.FileSizeBytes		= int(FileSizeB);
+	Info.MemSizeBytes		= 0;
+	Info.Mipmaps			= probed.NumMipmaps;
 }
 
 
@@ -266,6 +371,10 @@ bool TacitImage::Unload()
 	AltPicture.Clear();
 	AltPictureEnabled = false;
 	Pictures.Clear();
+	Stats.Clear();
+	History.Clear();
+	FrameSource.Close();
+	CurrFrame = 0;
 	Info.MemSizeBytes = 0;
 
 	LoadedTime = -1.0f;
@@ -348,15 +457,140 @@ tColouri TacitImage::GetPixel(int x, int y) const
 
 void TacitImage::Rotate90(bool antiClockWise)
 {
-	for (tPicture* picture = Pictures.First(); picture; picture = picture->Next())
-		picture->Rotate90(antiClockWise);
+	Edit edit;
+	edit.Operation = antiClockWise ? Edit::Op::Rotate90ACW : Edit::Op::Rotate90CW;
+	History.Apply(Pictures, edit);
 }
 
 
 void TacitImage::Flip(bool horizontal)
 {
-	for (tPicture* picture = Pictures.First(); picture; picture = picture->Next())
-		picture->Flip(horizontal);
+	Edit edit;
+	edit.Operation = horizontal ? Edit::Op::FlipH : Edit::Op::FlipV;
+	History.Apply(Pictures, edit);
+}
+
+
+bool TacitImage::Crop(int newWidth, int newHeight, tPicture::Anchor anchor)
+{
+	tPicture* picture = Pictures.First();
+	if (!picture || (newWidth <= 0) || (newHeight <= 0))
+		return false;
+
+	// Same origins as tPicture::Crop. The anchors go left to right and then top to bottom.
+	int width = picture->GetWidth();
+	int height = picture->GetHeight();
+	int column = int(anchor) % 3;
+	int row = int(anchor) / 3;
+
+	Edit edit;
+	edit.Operation = Edit::Op::Crop;
+	edit.Width = newWidth;
+	edit.Height = newHeight;
+	edit.OriginX = (column == 0) ? 0 : ((column == 1) ? width/2 - newWidth/2 : width - newWidth);
+	edit.OriginY = (row == 0) ? height - newHeight : ((row == 1) ? height/2 - newHeight/2 : 0);
+	if (!History.Apply(Pictures, edit))
+		return false;
+
+	Stats.Clear();
+	return true;
+}
+
+
+bool TacitImage::Resample(int newWidth, int newHeight, tPicture::tFilter filter)
+{
+	Edit edit;
+	edit.Operation = Edit::Op::Resample;
+	edit.Width = newWidth;
+	edit.Height = newHeight;
+	edit.Filter = filter;
+	if (!History.Apply(Pictures, edit))
+		return false;
+
+	Stats.Clear();
+	return true;
+}
+
+
+bool TacitImage::Undo()
+{
+	if (!History.Undo(Pictures))
+		return false;
+
+	Stats.Clear();
+	return true;
+}
+
+
+bool TacitImage::Redo()
+{
+	if (!History.Redo(Pictures))
+		return false;
+
+	Stats.Clear();
+	return true;
+}
+
+
+void TacitImage::MarkSaved()
+{
+	History.MarkSaved();
+	tSystem::tFileInfo info;
+	if (tSystem::tGetFileInfo(info, Filename))
+	{
+		FileModTime = info.ModificationTime;
+		FileSizeB = info.FileSize;
+		Info.FileSizeBytes = int(FileSizeB);
+	}
+}
+
+
+bool TacitImage::RevertToSaved()
+{
+	if (!IsModified())
+		return true;
+
+	if (History.RevertToSaved(Pictures))
+	{
+		Stats.Clear();
+		return true;
+	}
+
+	// The saved step was dropped from the history so the only way back is the file.
+	Unload();
+	return Load();
+}
+
+
+bool TacitImage::SetFrame(int frame)
+{
+	tPicture* picture = Pictures.First();
+	if (!picture || !FrameSource.IsValid())
+		return false;
+
+	const tPicture* framePicture = FrameSource.GetFrame(frame);
+	if (!framePicture)
+		return false;
+
+	Unbind();
+	picture->Set(*framePicture);
+	CurrFrame = frame;
+	Stats.Clear();
+	History.Clear();
+	return true;
+}
+
+
+const tPictureStats& TacitImage::GetStats()
+{
+	if (Stats.IsValid())
+		return Stats;
+
+	tPicture* picture = Pictures.First();
+	if (picture && picture->IsValid())
+		Stats.Compute(*picture);
+
+	return Stats;
 }
 
 
@@ -447,6 +681,17 @@ uint64 TacitImage::Bind()
 	tPicture* picture = Pictures.First();
 	if (picture && picture->IsValid())
 	{
+		// Pictures bigger than the largest texture the driver can make are drawn from a smaller mipmap instead of not
+		// at all. The pixels themselves are untouched, so inspecting and saving still see the full resolution.
+		GLint maxTextureSize = 0;
+		glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+		tPicture reduced;
+		if ((maxTextureSize > 0) && (tMath::tMax(picture->GetWidth(), picture->GetHeight()) > maxTextureSize))
+		{
+			if (ReducePicture(reduced, *picture, maxTextureSize))
+				picture = &reduced;
+		}
+
 		tList<tLayer> layers;
 		layers.Append
 		(
@@ -511,6 +756,26 @@ void TacitImage::BindLayers(const tList<tLayer>& layers, uint texID)
 }
 
 
+bool TacitImage::ReducePicture(tPicture& dest, tPicture& src, int maxDimension)
+{
+	// Only the mipmap that is read back and the tiles it's filtered from are ever generated. Each tile is used as soon
+	// as it is made, so a small cache is enough.
+	tTiledPicture tiled;
+	if (!tiled.Set(src, 16*tTiledPicture::TileNumBytes))
+		return false;
+
+	for (int level = 1; level < tiled.GetNumLevels(); level++)
+	{
+		int width = tiled.GetWidth(level);
+		int height = tiled.GetHeight(level);
+		if ((width <= maxDimension) && (height <= maxDimension))
+			return tiled.GetRegion(dest, level, 0, 0, width, height);
+	}
+
+	return false;
+}
+
+
 void TacitImage::GetGLFormatInfo(GLint& srcFormat, GLenum& srcType, GLint& dstFormat, bool& compressed, tPixelFormat pixelFormat)
 {
 	srcFormat = GL_RGBA;
@@ -615,9 +880,9 @@ bool TacitImage::ConvertTexture2DToPicture()
 		tiClampMin(mipW, 1);
 		int mipH = h >> level;
 		tiClampMin(mipH, 1);
-		uint8* rgbaData = new uint8[mipW * mipH * 4];
+		tPixel* rgbaData = tPicture::AllocPixels(mipW * mipH);
 		glGetTexImage(GL_TEXTURE_2D, level, GL_RGBA, GL_UNSIGNED_BYTE, rgbaData);
-		Pictures.Append(new tPicture(mipW, mipH, (tPixel*)rgbaData, false));
+		Pictures.Append(new tPicture(mipW, mipH, rgbaData, false));
 	}
 
 	glDeleteTextures(1, &tempTexID);
@@ -656,9 +921,9 @@ bool TacitImage::ConvertCubemapToPicture()
 		layers.Append(new tLayer(*tex->GetLayers().First()));
 		BindLayers(layers, tempTexID);
 
-		uint8* rgbaData = new uint8[w * h * 4];
+		tPixel* rgbaData = tPicture::AllocPixels(w * h);
 		glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, rgbaData);
-		Pictures.Append(new tPicture(w, h, (tPixel*)rgbaData, false));
+		Pictures.Append(new tPicture(w, h, rgbaData, false));
 
 		layers.Empty();
 		glDeleteTextures(1, &tempTexID);
@@ -728,7 +993,7 @@ void TacitImage::GenerateThumbnail()
 
 	// Retrieve from cache if possible.
 	tuint256 hash = 0;
-	int thumbVersion = 1;
+	int thumbVersion = 3;
 	tFileInfo fileInfo;
 	tGetFileInfo(fileInfo, Filename);
 	hash = tHashData256((uint8*)&thumbVersion, sizeof(thumbVersion));
@@ -744,35 +1009,50 @@ void TacitImage::GenerateThumbnail()
 	{
 		tChunkReader chunk(hashFile);
 		ThumbnailPicture.Load(chunk.First());
+		PerceptualHash.Load(chunk.First().Next());
 		return;
 	}
 
-	// We need an opengl context if we are processing dds files (for now... opengl is used for decompression). GLFW doesn't support creating
-	// contexts without an associated window. However, contexts with hidden windows can be created with the GLFW_VISIBLE window hint.
-	GLFWwindow* offscreenContext = nullptr;
-	if (Filetype == tFileType::DDS)
-	{
-		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
-		offscreenContext = glfwCreateWindow(32, 32, "", nullptr, nullptr);
-		if (!offscreenContext)
-			return;
-
-		glfwMakeContextCurrent(offscreenContext);
-	}
+	// Most dds files have a mipmap close to the thumbnail size. Reading and decoding only that one is much faster than
+	// loading them all and needs no GL context. Anything it can't handle takes the full load below.
+	tPicture ddsLayerPic;
+	tPicture* srcPic = nullptr;
+	if ((Filetype == tFileType::DDS) && LoadThumbnailLayerDDS(ddsLayerPic))
+		srcPic = &ddsLayerPic;
 
 	TacitImage thumbLoader;
-	thumbLoader.Load(Filename);
-
-	if (Filetype == tFileType::DDS)
+	thumbLoader.UseDecodeCache = false;
+	if (!srcPic)
 	{
-		glfwMakeContextCurrent(nullptr);
-		glfwDestroyWindow(offscreenContext);
-	}
+		// We need an opengl context if we are processing dds files (opengl is used for decompression). GLFW doesn't support creating
+		// contexts without an associated window. However, contexts with hidden windows can be created with the GLFW_VISIBLE window hint.
+		GLFWwindow* offscreenContext = nullptr;
+		if (Filetype == tFileType::DDS)
+		{
+			glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+			offscreenContext = glfwCreateWindow(32, 32, "", nullptr, nullptr);
+			if (!offscreenContext)
+				return;
 
+			glfwMakeContextCurrent(offscreenContext);
+		}
+
+		thumbLoader.Load(Filename);
 
-	tPicture* srcPic = thumbLoader.GetPrimaryPicture();
+		if (Filetype == tFileType::DDS)
+		{
+			glfwMakeContextCurrent(nullptr);
+			glfwDestroyWindow(offscreenContext);
+		}
+
+		srcPic = thumbLoader.GetPrimaryPicture();
+	}
 	tAssert(srcPic);
 
+	// The perceptual hash is computed from the full size picture (or a mipmap at least as big as the thumbnail) so it
+	// doesn't depend on the thumbnail aspect. The hash downsamples by area averaging, so a mipmap gives the same bits.
+	PerceptualHash.Set(*srcPic);
+
 	// We make the thumbnail keep its aspect ratio.
 	int srcW = srcPic->GetWidth();
 	int srcH = srcPic->GetHeight();
@@ -802,10 +1082,40 @@ void TacitImage::GenerateThumbnail()
 	// Write to cache file.
 	tChunkWriter writer(hashFile);
 	ThumbnailPicture.Save(writer);
+	PerceptualHash.Save(writer);
 	// std::this_thread::sleep_for(std::chrono::milliseconds(100));
 }
 
 
+bool TacitImage::LoadThumbnailLayerDDS(tPicture& picture) const
+{
+	// Cubemaps show the front (+Z) side, like the first picture of a loaded cubemap. The rows are flipped after
+	// decoding instead of reversing the blocks, since not every block format (BC7 for one) can be reversed.
+	tLayer* layer = tFileDDS::LoadClosestLayer(Filename, ThumbWidth, ThumbHeight, tFileDDS::tSurfIndex_PosZ, false);
+	if (!layer)
+		return false;
+
+	// We're already on one of several thumbnail threads so the conversion only uses this one.
+	int width = layer->Width;
+	int height = layer->Height;
+	tPixel* pixels = tPicture::AllocPixels(width*height);
+	bool decoded = tIsNormalFormat(layer->PixelFormat) ?
+		tConvertPixels(pixels, tPixelFormat::R8G8B8A8, layer->Data, layer->PixelFormat, width*height, 1) :
+		tDecodeBC(pixels, layer->Data, width, height, layer->PixelFormat);
+	delete layer;
+
+	if (!decoded)
+	{
+		tPicture::FreePixels(pixels);
+		return false;
+	}
+
+	picture.Set(width, height, pixels, false);
+	picture.Flip(false);
+	return true;
+}
+
+
 void TacitImage::RequestThumbnail()
 {
 	if (ThumbnailRequested)
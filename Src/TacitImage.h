@@ -22,6 +22,12 @@
 #include <Image/tPicture.h>
 #include <Image/tTexture.h>
 #include <Image/tCubemap.h>
+#include <Image/tPictureStats.h>
+#include <Image/tPerceptualHash.h>
+#include <Image/tFrameSource.h>
+#include <Image/tImageProbe.h>
+#include "PixelCache.h"
+#include "EditHistory.h"
 
 
 class TacitImage : public tLink<TacitImage>
@@ -33,8 +39,22 @@ public:
 
 	bool Load();						// Load into main memory.
 	bool Load(const tString& filename);
+
+	// Loads from a picture that has already been decoded from the file, such as a frame of a sequence decoded ahead of
+	// time. The pixels are taken from the picture. Returns false for dds files or if the image is already loaded.
+	bool LoadDecoded(tImage::tPicture&&);
 	bool IsLoaded() const																								{ return (Pictures.Count() > 0); }
 
+	// Fills in the Info from the file header without loading the image. Returns true if Info is valid afterwards. The
+	// header is only ever read once. Info that came from loading is left alone, and Load overwrites the probed
+	// values.
+	bool Probe();
+	bool IsProbed() const																								{ return Probed; }
+
+	// Sets the result of probing without reading the file. Used when it comes from the metadata catalog.
+	void SetProbedInfo(const tImage::tImageInfo&);
+	const tImage::tImageInfo& GetProbedInfo() const																		{ return ProbedInfo; }
+
 	bool IsOpaque() const;
 	bool Unload();
 	float GetLoadedTime() const																							{ return LoadedTime; }
@@ -49,8 +69,29 @@ public:
 	int GetHeight() const;
 	tColouri GetPixel(int x, int y) const;
 
+	// Edits are recorded so they can be undone. Crop and Resample return false for images with more than one picture,
+	// such as dds files with mipmaps. Unloading or changing frames loses the edits and the history.
 	void Rotate90(bool antiClockWise);
 	void Flip(bool horizontal);
+	bool Crop(int newWidth, int newHeight, tImage::tPicture::Anchor);
+	bool Resample(int newWidth, int newHeight, tImage::tPicture::tFilter);
+	bool Undo();
+	bool Redo();
+	bool CanUndo() const																								{ return History.CanUndo(); }
+	bool CanRedo() const																								{ return History.CanRedo(); }
+	bool CanCropOrResample() const																						{ return Pictures.GetNumItems() == 1; }
+
+	// Modified means the pictures no longer match the file. Call MarkSaved after writing the pictures to the file.
+	bool IsModified() const																								{ return History.IsModified(); }
+	void MarkSaved();
+
+	// Undoes or redoes back to how the file is on disk. If the history no longer goes back that far the file is loaded
+	// again instead.
+	bool RevertToSaved();
+
+	// The rotate or flip that takes the file on disk to the current pictures. Returns false if the pictures were
+	// cropped or resampled since, or the history no longer goes back to the file.
+	bool GetOrientationSinceSaved(tImage::tFileJPG::tOrientation& orientation) const									{ return History.GetOrientationSinceSaved(orientation); }
 
 	struct ImgInfo
 	{
@@ -65,8 +106,22 @@ public:
 		int Mipmaps				= 0;
 	};
 	void PrintInfo();
+	// Histograms and other statistics of the primary picture. They are computed on first request and cached until the
+	// image is unloaded. Rotating and flipping don't change any of the stats so the cache survives those.
+	const tImage::tPictureStats& GetStats();
+
 	tImage::tPicture* GetPrimaryPicture()																				{ return Pictures.First(); }
 
+	// Animated GIFs and multi-page images have more than one frame. Frames are decoded on demand. SetFrame replaces
+	// the primary picture with the requested frame and unbinds so the next Bind uploads it.
+	int GetNumFrames() const																							{ return FrameSource.IsValid() ? FrameSource.GetNumFrames() : 1; }
+	int GetCurrFrame() const																							{ return CurrFrame; }
+	float GetFrameDuration(int frame) const																				{ return FrameSource.GetFrameDuration(frame); }
+	bool SetFrame(int frame);
+
+	// Changing frames throws away edits, so animations shouldn't advance while there are any.
+	bool HasEdits() const																								{ return History.CanUndo() || History.IsModified(); }
+
 	bool IsAltMipmapsPictureAvail() const																				{ return DDSTexture2D.IsValid() && AltPicture.IsValid(); }
 	bool IsAltCubemapPictureAvail() const																				{ return DDSCubemap.IsValid() && AltPicture.IsValid(); }
 	void EnableAltPicture(bool enabled)																					{ AltPictureEnabled = enabled; }
@@ -81,19 +136,27 @@ public:
 	// You are allowed to unrequest. It will succeed if a worker was never assigned.
 	void UnrequestThumbnail();
 	bool IsThumbnailWorkerActive() const { return ThumbnailThreadRunning; }
+	bool IsThumbnailAvail() const		{ return !ThumbnailThreadRunning && ThumbnailPicture.IsValid(); }
 	uint64 BindThumbnail();
 
-	ImgInfo Info;						// Info is only valid AFTER loading.
+	ImgInfo Info;						// Info is only valid AFTER loading or probing.
 	tString Filename;					// Valid before load.
 	tSystem::tFileType Filetype;		// Valid before load.
 	uint64 FileModTime;					// Valid before load.
 	uint64 FileSizeB;					// Valid before load.
 
+	// Valid once the thumbnail has been generated. It is stored in the thumbnail cache file so near-duplicate searches
+	// don't need to reload every image.
+	tImage::tPerceptualHash PerceptualHash;
+
 	const static int ThumbWidth			= 256;
 	const static int ThumbHeight		= 144;
 	const static int ThumbMinDispWidth	= 64;
 	static tString ThumbCacheDir;
 
+	// Decoded pixels of big images, shared by all images. Disabled until it has been initialized with a non-zero size.
+	static PixelCache DecodeCache;
+
 private:
 	// Dds files are special and already in HW ready format. The tTexture can store dds files, while tPicture stores
 	// other types (tga, gif, jpg, bmp, tif, png, etc). If the image is a dds file, the tTexture is valid and in order
@@ -110,6 +173,13 @@ private:
 	bool AltPictureEnabled = false;
 	tImage::tPicture AltPicture;
 
+	tImage::tPictureStats Stats;
+	EditHistory History;
+
+	// Only valid for images with more than one frame.
+	tImage::tFrameSource FrameSource;
+	int CurrFrame = 0;
+
 	bool ThumbnailRequested = false;			// True if ever requested.
 	bool ThumbnailThreadRunning = false;		// Only true while worker thread going.
 	static int ThumbnailNumThreadsRunning;		// How many worker threads active.
@@ -117,23 +187,40 @@ private:
 	std::atomic_flag ThumbnailThreadFlag = ATOMIC_FLAG_INIT;
 	tImage::tPicture ThumbnailPicture;
 
-	// These 2 functions run on a helper thread.
+	// Returns the decode cache key of the file, or 0 if this image shouldn't use the cache. Only big images are worth
+	// hashing.
+	uint64 GetDecodeCacheKey();
+	bool UseDecodeCache = true;				// The thumbnail loader doesn't. It only needs the pixels once.
+
+	// These functions run on a helper thread.
 	static void GenerateThumbnailBridge(TacitImage* tacitImage);
 	void GenerateThumbnail();
 
+	// Reads and decodes the dds mipmap closest to the thumbnail size. Returns false if the file isn't supported.
+	bool LoadThumbnailLayerDDS(tImage::tPicture&) const;
+
 	// Zero is invalid and means texture has never been bound and loaded into VRAM.
 	uint TexIDPrimary	= 0;
 	uint TexIDAlt		= 0;
 	uint TexIDThumbnail	= 0;
 
+	// Sets the load time and fills in the Info once the pictures or dds data are in place.
+	void FinishLoad(int srcFileBitdepth);
+
 	// Returns the approx main mem size of this image. Considers the Pictures list and the AltPicture.
 	int GetMemSizeBytes() const;
 	bool ConvertTexture2DToPicture();
 	bool ConvertCubemapToPicture();
 	void GetGLFormatInfo(GLint& srcFormat, GLenum& srcType, GLint& dstFormat, bool& compressed, tImage::tPixelFormat);
 	void BindLayers(const tList<tImage::tLayer>&, uint texID);
+
+	// Makes dest the most detailed mipmap of src with both sides no bigger than maxDimension. Returns false if there
+	// isn't one.
+	static bool ReducePicture(tImage::tPicture& dest, tImage::tPicture& src, int maxDimension);
 	void CreateAltPictureDDS2DMipmaps();
 	void CreateAltPictureDDSCubemap();
 
 	float LoadedTime = -1.0f;
+	bool Probed = false;
+	tImage::tImageInfo ProbedInfo;
 };
@@ -31,6 +31,9 @@
 #include "imgui_impl_opengl2.h"
 #include "TacitTexView.h"
 #include "TacitImage.h"
+#include "MetaCatalog.h"
+#include "SequencePlayer.h"
+#include "SingleInstance.h"
 #include "Dialogs.h"
 #include "ContactSheet.h"
 #include "ContentView.h"
@@ -54,6 +57,29 @@ namespace TexView
 	tItList<TacitImage> ImagesLoadTimeSorted	(false);
 	tuint256 ImagesHash							= 0;
 	TacitImage* CurrImage						= nullptr;
+
+	// The catalog is for the directory being viewed. Images it knows nothing about are probed a few at a time starting
+	// from CatalogRefreshImage, and changes are saved once they have stopped coming for CatalogSaveDelay seconds.
+	MetaCatalog Catalog;
+	TacitImage* CatalogRefreshImage				= nullptr;
+	float CatalogDirtyTime						= -1.0f;
+	const float CatalogRefreshBudget			= 0.004f;
+	const float CatalogSaveDelay				= 2.0f;
+	const int MaxCatalogFiles					= 256;
+
+	// While a sequence plays SequenceImages holds the image of each frame. Frames are shown by loading their image
+	// from the already decoded picture. SequenceLoadedImage is the one the sequence loaded, and it is unloaded again
+	// when the next frame replaces it. Images that were already loaded are left alone.
+	SequencePlayer Sequence;
+	tArray<TacitImage*> SequenceImages;
+	TacitImage* SequenceLoadedImage				= nullptr;
+	int SequenceFrame							= 0;
+
+	// Instance listens for files from new launches when Config.SingleInstance is on. LaunchTime is when this process
+	// started, so a cold start can be compared with a handoff.
+	SingleInstance Instance;
+	const char* InstanceName					= "TacitViewer";
+	double LaunchTime							= 0.0;
 	TacitImage CursorImage;
 	TacitImage PrevImage;
 	TacitImage NextImage;
@@ -78,6 +104,8 @@ namespace TexView
 	GLFWwindow* Window							= nullptr;
 	double DisappearCountdown					= DisappearDuration;
 	double SlideshowCountdown					= 0.0;
+	double FrameCountdown						= 0.0;
+	bool AnimationPaused						= false;
 	bool SlideshowPlaying						= false;
 	bool FullscreenMode							= false;
 	bool WindowIconified						= false;
@@ -85,6 +113,7 @@ namespace TexView
 	bool ShowAbout								= false;
 	bool Request_SaveAsModal					= false;
 	bool Request_SaveAllModal					= false;
+	bool Request_ResizeImageModal				= false;
 	bool Request_DeleteFileModal				= false;
 	bool Request_DeleteFileNoRecycleModal		= false;
 	bool ContactDialog							= false;
@@ -137,6 +166,13 @@ namespace TexView
 		tFileInfo ib; tGetFileInfo(ib, b);
 		return ia.CreationTime < ib.CreationTime;
 	}
+	bool Compare_FileModTimeAscending(const tStringItem& a, const tStringItem& b)
+	{
+		tFileInfo ia; tGetFileInfo(ia, a);
+		tFileInfo ib; tGetFileInfo(ib, b);
+		return ia.ModificationTime < ib.ModificationTime;
+	}
+	typedef bool FileCompareFn(const tStringItem&, const tStringItem&);
 	bool Compare_ImageLoadTimeAscending(const TacitImage& a, const TacitImage& b)										{ return a.GetLoadedTime() < b.GetLoadedTime(); }
 	bool Compare_ImageFileNameAscending(const TacitImage& a, const TacitImage& b)										{ return tStricmp(a.Filename.Chars(), b.Filename.Chars()) < 0; }
 	bool Compare_ImageFileNameDescending(const TacitImage& a, const TacitImage& b)										{ return tStricmp(a.Filename.Chars(), b.Filename.Chars()) > 0; }
@@ -148,16 +184,24 @@ namespace TexView
 	bool Compare_ImageFileSizeDescending(const TacitImage& a, const TacitImage& b)										{ return a.FileSizeB > b.FileSizeB; }
 	typedef bool ImageCompareFn(const TacitImage&, const TacitImage&);
 
-	void SetWindowTitle();
 	bool OnPrevious(bool circ = false);
 	bool OnNext(bool circ = false);
 	bool OnSkipBegin();
 	bool OnSkipEnd();
+	bool OnUndo();
+	bool OnRedo();
+	bool OnRevertToSaved();
 	void ResetPan(bool resetX = true, bool resetY = true);
 	void ApplyZoomDelta(float zoomDelta, float roundTo, bool correctPan);
+	tString GetImagesDir();
 	void FindImageFiles(tList<tStringItem>& foundFiles);
+	void RefreshCatalog();
+	void UpdateSequence();
+	void UpdateInstance();
+	void ShowSequenceOverlay(float x, float y, float w);
 	tuint256 ComputeImagesHash(const tList<tStringItem>& files);
 	int RemoveOldCacheFiles(const tString& cacheDir);																	// Returns num removed.
+	int RemoveOldestFiles(tList<tStringItem>& files, int maxFiles, FileCompareFn oldestFirst);							// Returns num removed.
 
 	void Update(GLFWwindow* window, double dt, bool dopoll = true);
 	void WindowRefreshFun(GLFWwindow* window)																			{ Update(window, 0.0, false); }
@@ -177,6 +221,38 @@ tVector2 TexView::GetDialogOrigin(float index)
 }
 
 
+void TexView::ShowSequenceOverlay(float x, float y, float w)
+{
+	// Goes in the top corner the info overlay isn't using.
+	const float margin = 6.0f;
+	bool right = (Config.InfoOverlayShow && (Config.OverlayCorner == 0));
+	tVector2 windowPos = tVector2(right ? x + w - margin : x + margin, y + margin);
+	ImGui::SetNextWindowPos(windowPos, ImGuiCond_Always, tVector2(right ? 1.0f : 0.0f, 0.0f));
+	ImGui::SetNextWindowBgAlpha(0.6f);
+	ImGuiWindowFlags flags =
+		ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoTitleBar | ImGuiWindowFlags_NoResize |
+		ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoSavedSettings |
+		ImGuiWindowFlags_NoFocusOnAppearing | ImGuiWindowFlags_NoNav | ImGuiWindowFlags_NoScrollbar;
+
+	if (ImGui::Begin("SequenceOverlay", nullptr, flags))
+	{
+		SequencePlayer::Stats stats = Sequence.GetStats();
+		const char* paused = Sequence.IsPlaying() ? "" : " (Paused)";
+		ImGui::Text("Frame %d of %d%s", SequenceFrame+1, Sequence.GetNumFrames(), paused);
+		if (stats.TargetFPS > 0.0f)
+			ImGui::Text("FPS: %.1f of %.1f", stats.AchievedFPS, stats.TargetFPS);
+		else
+			ImGui::Text("FPS: %.1f", stats.AchievedFPS);
+		ImGui::Text("Dropped: %d", stats.NumDropped);
+		ImGui::Text("Buffered: %d", stats.NumBuffered);
+		ImGui::Text("Decode: %.1f fps on %d threads", stats.DecodeFPS, stats.NumThreads);
+		if (stats.TargetFPS > 0.0f)
+			ImGui::Text("Headroom: %.2fx", stats.Headroom);
+	}
+	ImGui::End();
+}
+
+
 void TexView::DrawTextureViewerLog(float x, float y, float w, float h)
 {
 	// We take advantage of the fact that multiple calls to Begin()/End() are appending to the same window.
@@ -189,17 +265,25 @@ void TexView::DrawTextureViewerLog(float x, float y, float w, float h)
 }
 
 
-void TexView::FindImageFiles(tList<tStringItem>& foundFiles)
+tString TexView::GetImagesDir()
 {
 	tString imagesDir = tSystem::tGetCurrentDir();
 	if (ImageFileParam.IsPresent() && tSystem::tIsAbsolutePath(ImageFileParam.Get()))
 		imagesDir = tSystem::tGetDir(ImageFileParam.Get());
 
+	return imagesDir;
+}
+
+
+void TexView::FindImageFiles(tList<tStringItem>& foundFiles)
+{
+	tString imagesDir = GetImagesDir();
 	tPrintf("Looking for image files in %s\n", imagesDir.Chars());
 	tSystem::tFindFilesInDir(foundFiles, imagesDir, "*.jpg");
 	tSystem::tFindFilesInDir(foundFiles, imagesDir, "*.gif");
 	tSystem::tFindFilesInDir(foundFiles, imagesDir, "*.tga");
 	tSystem::tFindFilesInDir(foundFiles, imagesDir, "*.png");
+	tSystem::tFindFilesInDir(foundFiles, imagesDir, "*.qoi");
 	tSystem::tFindFilesInDir(foundFiles, imagesDir, "*.tif");
 	tSystem::tFindFilesInDir(foundFiles, imagesDir, "*.tiff");
 	tSystem::tFindFilesInDir(foundFiles, imagesDir, "*.bmp");
@@ -219,9 +303,22 @@ tuint256 TexView::ComputeImagesHash(const tList<tStringItem>& files)
 
 void TexView::PopulateImages()
 {
+	StopSequence();
+	CatalogRefreshImage = nullptr;
 	Images.Clear();
 	ImagesLoadTimeSorted.Clear();
 
+	// Changing directory saves the old catalog before reading the new one. A save that is still running would make
+	// SaveAsync return without saving, and Load would then drop the unsaved records, so it is waited for first.
+	tString catalogFile = MetaCatalog::GetCatalogFile(TacitImage::ThumbCacheDir, GetImagesDir());
+	if (catalogFile != Catalog.GetFile())
+	{
+		Catalog.WaitForSave();
+		Catalog.SaveAsync();
+		Catalog.Load(catalogFile);
+		CatalogDirtyTime = -1.0f;
+	}
+
 	tList<tStringItem> foundFiles;
 	FindImageFiles(foundFiles);
 
@@ -234,6 +331,21 @@ void TexView::PopulateImages()
 		TacitImage* newImg = new TacitImage(*filename);
 		Images.Append(newImg);
 		ImagesLoadTimeSorted.Append(newImg);
+
+		// Stale records are not returned, so those images get probed again by RefreshCatalog.
+		const MetaRecord* record = Catalog.Find(tSystem::tGetFileName(*filename), newImg->FileSizeB, newImg->FileModTime);
+		if (record)
+		{
+			tImage::tImageInfo info;
+			record->GetInfo(info);
+			newImg->SetProbedInfo(info);
+			if (record->Flags & MetaRecord::Flag_Hash)
+			{
+				newImg->PerceptualHash.DHash = record->DHash;
+				newImg->PerceptualHash.PHash = record->PHash;
+				newImg->PerceptualHash.Valid = true;
+			}
+		}
 	}
 
 	SortImages(Settings::SortKeyEnum(Config.SortKey), Config.SortAscending);
@@ -264,6 +376,64 @@ void TexView::SortImages(Settings::SortKeyEnum key, bool ascending)
 	}
 
 	Images.Sort(sortFn);
+	CatalogRefreshImage = Images.First();
+}
+
+
+void TexView::UpdateCatalog(TacitImage* image)
+{
+	if (!image->IsProbed() && !image->IsThumbnailAvail())
+		return;
+
+	// Starting from the current record keeps whatever we don't know about this time, like a thumbnail that was cached
+	// in an earlier session.
+	tString name = tSystem::tGetFileName(image->Filename);
+	const MetaRecord* current = Catalog.Find(name, image->FileSizeB, image->FileModTime);
+	MetaRecord record = current ? *current : MetaRecord();
+	record.FileSize = image->FileSizeB;
+	record.ModTime = image->FileModTime;
+	if (image->IsProbed())
+		record.SetInfo(image->GetProbedInfo());
+
+	if (image->IsThumbnailAvail())
+		record.Flags |= MetaRecord::Flag_Thumbnail;
+
+	// The thumbnail worker writes the hash, so it can only be read once the worker is done.
+	if (!image->IsThumbnailWorkerActive() && image->PerceptualHash.IsValid())
+	{
+		record.Flags |= MetaRecord::Flag_Hash;
+		record.DHash = image->PerceptualHash.DHash;
+		record.PHash = image->PerceptualHash.PHash;
+	}
+
+	Catalog.Set(name, record);
+}
+
+
+void TexView::RefreshCatalog()
+{
+	// Probing only reads the header of each file but a large directory still has to be spread over many frames.
+	float startTime = tSystem::tGetTime();
+	while (CatalogRefreshImage && ((tSystem::tGetTime() - startTime) < CatalogRefreshBudget))
+	{
+		TacitImage* image = CatalogRefreshImage;
+		CatalogRefreshImage = image->Next();
+		if (image->IsProbed())
+			continue;
+
+		image->Probe();
+		UpdateCatalog(image);
+	}
+
+	if (!Catalog.IsDirty())
+		return;
+
+	float currTime = tSystem::tGetTime();
+	if (CatalogDirtyTime < 0.0f)
+		CatalogDirtyTime = currTime;
+
+	if (((currTime - CatalogDirtyTime) > CatalogSaveDelay) && Catalog.SaveAsync())
+		CatalogDirtyTime = -1.0f;
 }
 
 
@@ -301,10 +471,15 @@ void TexView::SetCurrentImage(const tString& currFilename)
 void TexView::LoadCurrImage()
 {
 	tAssert(CurrImage);
+	StopSequence();
 	bool imgJustLoaded = false;
 	if (!CurrImage->IsLoaded())
 		imgJustLoaded = CurrImage->Load();
 
+	// The countdown belongs to whatever was playing before, so animations start over with a full frame.
+	AnimationPaused = false;
+	FrameCountdown = CurrImage->GetFrameDuration(CurrImage->GetCurrFrame());
+
 	if (!SlideshowPlaying)
 		CurrImage->PrintInfo();
 	SetWindowTitle();
@@ -345,6 +520,161 @@ void TexView::LoadCurrImage()
 }
 
 
+bool TexView::StartSequence()
+{
+	StopSequence();
+	tString prefix, suffix;
+	int number = 0;
+	if (!CurrImage || (CurrImage->Filetype == tFileType::DDS))
+		return false;
+	if (!SequencePlayer::SplitFrameName(CurrImage->Filename, prefix, number, suffix))
+		return false;
+
+	// The frames play in number order whatever the images are sorted by. Unpadded numbers don't sort alphabetically.
+	struct FrameItem : public tLink<FrameItem>
+	{
+		FrameItem(int number, TacitImage* image)																		: Number(number), Image(image) { }
+		int Number;
+		TacitImage* Image;
+	};
+	tList<FrameItem> frames;
+	for (TacitImage* image = Images.First(); image; image = image->Next())
+	{
+		tString framePrefix, frameSuffix;
+		int frameNumber = 0;
+		if (!SequencePlayer::SplitFrameName(image->Filename, framePrefix, frameNumber, frameSuffix))
+			continue;
+
+		bool samePrefix = tStricmp(framePrefix.Chars(), prefix.Chars()) == 0;
+		bool sameSuffix = tStricmp(frameSuffix.Chars(), suffix.Chars()) == 0;
+		if (samePrefix && sameSuffix)
+			frames.Append(new FrameItem(frameNumber, image));
+	}
+	if (frames.GetNumItems() < 2)
+	{
+		tPrintf("No image sequence found for %s\n", tSystem::tGetFileName(CurrImage->Filename).Chars());
+		return false;
+	}
+	frames.Sort([](const FrameItem& a, const FrameItem& b) { return a.Number < b.Number; });
+
+	tArray<tString> files;
+	int startFrame = 0;
+	for (FrameItem* frame = frames.First(); frame; frame = frame->Next())
+	{
+		if (frame->Image == CurrImage)
+			startFrame = files.GetNumElements();
+		files.Append(frame->Image->Filename);
+		SequenceImages.Append(frame->Image);
+	}
+
+	// The decoded frames waiting in the buffer may use up to half the image memory.
+	int64 frameBytes = tMath::tMax(int64(CurrImage->Info.MemSizeBytes), int64(1));
+	int64 bufferBytes = (int64(Config.MaxImageMemMB) << 20) / 2;
+	int bufferFrames = int(tMath::tMin(int64(Config.SequenceBufferFrames), bufferBytes / frameBytes));
+	if (!Sequence.Start(files, startFrame, Config.SequenceFPS, tMath::tMax(bufferFrames, 2)))
+	{
+		SequenceImages.Clear();
+		return false;
+	}
+
+	tPrintf("Playing sequence of %d frames from %s\n", files.GetNumElements(), tSystem::tGetFileName(files[0]).Chars());
+	SequenceFrame = startFrame;
+	SlideshowPlaying = false;
+	Sequence.Play();
+	return true;
+}
+
+
+void TexView::StopSequence()
+{
+	if (!Sequence.IsActive())
+		return;
+
+	// The frame being shown stays loaded like any other image.
+	Sequence.Stop();
+	SequenceImages.Clear();
+	SequenceLoadedImage = nullptr;
+}
+
+
+void TexView::SetSequenceFPS(float fps)
+{
+	if (Sequence.IsActive())
+		Sequence.SetFPS(fps);
+}
+
+
+bool TexView::IsAnimationPlaying()
+{
+	return CurrImage && (CurrImage->GetNumFrames() > 1) && !AnimationPaused && !CurrImage->HasEdits();
+}
+
+
+void TexView::UpdateSequence()
+{
+	if (!Sequence.IsActive())
+		return;
+
+	tImage::tPicture picture;
+	int frame = 0;
+	if (!Sequence.Update(picture, frame))
+		return;
+
+	TacitImage* image = SequenceImages[frame];
+	if (SequenceLoadedImage && (SequenceLoadedImage != image))
+	{
+		SequenceLoadedImage->Unload();
+		SequenceLoadedImage = nullptr;
+	}
+
+	if (!image->IsLoaded())
+	{
+		if (!image->LoadDecoded(std::move(picture)))
+			return;
+		SequenceLoadedImage = image;
+	}
+
+	SequenceFrame = frame;
+	CurrImage = image;
+	SetWindowTitle();
+}
+
+
+bool TexView::EnableSingleInstance(bool enable)
+{
+	if (!enable)
+	{
+		Instance.Stop();
+		return true;
+	}
+
+	return Instance.IsListening() || Instance.Listen(InstanceName);
+}
+
+
+void TexView::UpdateInstance()
+{
+	SingleInstance::Request* request = Instance.Receive();
+	if (!request)
+		return;
+
+	// Only the first file is opened, the same as dropping files on the window. An empty list just brings us forward.
+	if (tStringItem* file = request->Files.First())
+	{
+		ImageFileParam.Param = *file;
+		PopulateImages();
+		SetCurrentImage(*file);
+		double latency = SingleInstance::GetClock() - request->LaunchTime;
+		tPrintf("Opened %s from another launch %.1fms after it started.\n", file->Chars(), latency*1000.0);
+	}
+	delete request;
+
+	if (WindowIconified)
+		glfwRestoreWindow(Window);
+	glfwFocusWindow(Window);
+}
+
+
 bool TexView::OnPrevious(bool circ)
 {
 	if (!CurrImage || (!circ && !CurrImage->Prev()))
@@ -389,6 +719,46 @@ bool TexView::OnSkipEnd()
 }
 
 
+bool TexView::OnUndo()
+{
+	if (!CurrImage || CurrImage->IsAltPictureEnabled() || !CurrImage->CanUndo())
+		return false;
+
+	CurrImage->Unbind();
+	CurrImage->Undo();
+	CurrImage->Bind();
+	SetWindowTitle();
+	return true;
+}
+
+
+bool TexView::OnRedo()
+{
+	if (!CurrImage || CurrImage->IsAltPictureEnabled() || !CurrImage->CanRedo())
+		return false;
+
+	CurrImage->Unbind();
+	CurrImage->Redo();
+	CurrImage->Bind();
+	SetWindowTitle();
+	return true;
+}
+
+
+bool TexView::OnRevertToSaved()
+{
+	if (!CurrImage || !CurrImage->IsModified())
+		return false;
+
+	// Reverting may reload the file, which also turns off the alt picture.
+	CurrImage->Unbind();
+	bool reverted = CurrImage->RevertToSaved();
+	CurrImage->Bind();
+	SetWindowTitle();
+	return reverted;
+}
+
+
 void TexView::ShowHelpMark(const char* desc)
 {
 	ImGui::TextDisabled("[?]");
@@ -425,7 +795,11 @@ void TexView::SetWindowTitle()
 
 	tString title = "Tacit Viewer";
 	if (CurrImage && !CurrImage->Filename.IsEmpty())
+	{
 		title = title + " - " + tGetFileName(CurrImage->Filename);
+		if (CurrImage->IsModified())
+			title = title + " *";
+	}
 
 	glfwSetWindowTitle(Window, title.Chars());
 }
@@ -544,6 +918,10 @@ void TexView::Update(GLFWwindow* window, double dt, bool dopoll)
 	if (dopoll)
 		glfwPollEvents();
 
+	// Picks up the newest decoded frame before anything is drawn.
+	UpdateSequence();
+	UpdateInstance();
+
 	glClearColor(ColourClear.x, ColourClear.y, ColourClear.z, ColourClear.w);
 	glClear(GL_COLOR_BUFFER_BIT);
 	int bottomUIHeight	= (FullscreenMode || !Config.ShowLog) ? 0 : 150;
@@ -850,8 +1228,10 @@ void TexView::Update(GLFWwindow* window, double dt, bool dopoll)
 		{
 			bool saveAsPressed = Request_SaveAsModal;
 			bool saveAllPressed = Request_SaveAllModal;
+			bool resizeImagePressed = Request_ResizeImageModal;
 			Request_SaveAsModal = false;
 			Request_SaveAllModal = false;
+			Request_ResizeImageModal = false;
 			if (ImGui::BeginMenu("File"))
 			{
 				// Show file menu items...
@@ -893,6 +1273,20 @@ void TexView::Update(GLFWwindow* window, double dt, bool dopoll)
 			if (ImGui::BeginMenu("Edit"))
 			{
 				ImGui::PushStyleVar(ImGuiStyleVar_FramePadding, tVector2(4,3));
+				bool editAvail = CurrImage && !CurrImage->IsAltPictureEnabled();
+				if (ImGui::MenuItem("Undo", "Ctrl-Z", false, editAvail && CurrImage->CanUndo()))
+					OnUndo();
+
+				if (ImGui::MenuItem("Redo", "Ctrl-Y", false, editAvail && CurrImage->CanRedo()))
+					OnRedo();
+
+				if (ImGui::MenuItem("Revert To Saved", "", false, CurrImage && CurrImage->IsModified()))
+					OnRevertToSaved();
+
+				if (ImGui::MenuItem("Resize Image...", "Ctrl-R", false, editAvail && CurrImage->CanCropOrResample()))
+					resizeImagePressed = true;
+
+				ImGui::Separator();
 				if (ImGui::MenuItem("Contact Sheet...", "C") && (Images.GetNumItems() > 1))
 				{
 					JustOpenedContactDialog = !ContactDialog;
@@ -906,6 +1300,14 @@ void TexView::Update(GLFWwindow* window, double dt, bool dopoll)
 				ImGui::EndMenu();
 			}
 			ImGui::PushStyleVar(ImGuiStyleVar_FramePadding, tVector2(4,3));
+			if (resizeImagePressed)
+				ImGui::OpenPopup("Resize Image");
+
+			// The unused isOpenResize bool is just so we get a close button in ImGui.
+			bool isOpenResize = true;
+			if (ImGui::BeginPopupModal("Resize Image", &isOpenResize, ImGuiWindowFlags_AlwaysAutoResize))
+				DoResizeImageModalDialog(resizeImagePressed);
+
 			if (ContactDialog)
 			{
 				ShowContactSheetDialog(&ContactDialog, JustOpenedContactDialog);
@@ -1002,6 +1404,7 @@ void TexView::Update(GLFWwindow* window, double dt, bool dopoll)
 				CurrImage->Unbind();
 				CurrImage->Flip(true);
 				CurrImage->Bind();
+				SetWindowTitle();
 			}
 			ShowToolTip("Flip Horizontally");
 
@@ -1014,6 +1417,7 @@ void TexView::Update(GLFWwindow* window, double dt, bool dopoll)
 				CurrImage->Unbind();
 				CurrImage->Flip(false);
 				CurrImage->Bind();
+				SetWindowTitle();
 			}
 			ShowToolTip("Flip Vertically");
 
@@ -1026,6 +1430,7 @@ void TexView::Update(GLFWwindow* window, double dt, bool dopoll)
 				CurrImage->Unbind();
 				CurrImage->Rotate90(true);
 				CurrImage->Bind();
+				SetWindowTitle();
 			}
 			ShowToolTip("Rotate 90 Anticlockwise");
 
@@ -1038,6 +1443,7 @@ void TexView::Update(GLFWwindow* window, double dt, bool dopoll)
 				CurrImage->Unbind();
 				CurrImage->Rotate90(false);
 				CurrImage->Bind();
+				SetWindowTitle();
 			}
 			ShowToolTip("Rotate 90 Clockwise");
 
@@ -1133,6 +1539,9 @@ void TexView::Update(GLFWwindow* window, double dt, bool dopoll)
 	if (Config.InfoOverlayShow)
 		ShowInfoOverlay(&Config.InfoOverlayShow, 0.0f, float(topUIHeight), float(dispw), float(disph - bottomUIHeight - topUIHeight), imgxi, imgyi, ZoomPercent);
 
+	if (Sequence.IsActive())
+		ShowSequenceOverlay(0.0f, float(topUIHeight), float(dispw));
+
 	if (Config.ContentViewShow)
 		ShowContentViewDialog(&Config.ContentViewShow);
 
@@ -1184,6 +1593,19 @@ void TexView::Update(GLFWwindow* window, double dt, bool dopoll)
 			SlideshowCountdown = Config.SlidehowFrameDuration;
 		}
 	}
+
+	if (IsAnimationPlaying())
+	{
+		FrameCountdown -= dt;
+		if (FrameCountdown <= 0.0)
+		{
+			int frame = (CurrImage->GetCurrFrame() + 1) % CurrImage->GetNumFrames();
+			CurrImage->SetFrame(frame);
+			FrameCountdown = CurrImage->GetFrameDuration(frame);
+		}
+	}
+
+	RefreshCatalog();
 }
 
 
@@ -1277,7 +1699,21 @@ void TexView::KeyCallback(GLFWwindow* window, int key, int scancode, int action,
 			break;
 
 		case GLFW_KEY_SPACE:
-			OnNext();
+			if (Sequence.IsActive())
+			{
+				if (Sequence.IsPlaying())
+					Sequence.Pause();
+				else
+					Sequence.Play();
+			}
+			else if (CurrImage && (CurrImage->GetNumFrames() > 1))
+			{
+				AnimationPaused = !AnimationPaused;
+			}
+			else
+			{
+				OnNext();
+			}
 			break;
 
 		case GLFW_KEY_EQUAL:
@@ -1353,11 +1789,31 @@ void TexView::KeyCallback(GLFWwindow* window, int key, int scancode, int action,
 			break;
 
 		case GLFW_KEY_Z:
+			if (modifiers == GLFW_MOD_CONTROL)
+			{
+				OnUndo();
+				break;
+			}
+			if (modifiers == (GLFW_MOD_CONTROL | GLFW_MOD_SHIFT))
+			{
+				OnRedo();
+				break;
+			}
 			ZoomPercent = 100.0f;
 			ResetPan();
 			CurrZoomMode = ZoomMode::OneToOne;
 			break;
 
+		case GLFW_KEY_Y:
+			if (modifiers == GLFW_MOD_CONTROL)
+				OnRedo();
+			break;
+
+		case GLFW_KEY_R:
+			if ((modifiers == GLFW_MOD_CONTROL) && CurrImage && !CurrImage->IsAltPictureEnabled())
+				Request_ResizeImageModal = CurrImage->CanCropOrResample();
+			break;
+
 		case GLFW_KEY_S:
 			if (CurrImage)
 			{
@@ -1379,6 +1835,13 @@ void TexView::KeyCallback(GLFWwindow* window, int key, int scancode, int action,
 		case GLFW_KEY_P:
 			PrefsDialog = !PrefsDialog;
 			break;
+
+		case GLFW_KEY_Q:
+			if (Sequence.IsActive())
+				StopSequence();
+			else
+				StartSequence();
+			break;
 	}
 }
 
@@ -1504,19 +1967,32 @@ int TexView::RemoveOldCacheFiles(const tString& cacheDir)
 {
 	tList<tStringItem> cacheFiles;
 	tSystem::tFindFilesInDir(cacheFiles, cacheDir, "*.bin");
-	int numFiles = cacheFiles.NumItems();
-	if (numFiles <= Config.MaxCacheFiles)
+	int deletedCount = RemoveOldestFiles(cacheFiles, Config.MaxCacheFiles, Compare_FileCreationTimeAscending);
+
+	// There is a catalog for every directory ever viewed. Saving one replaces the file, which on some systems keeps the
+	// creation time of the original, so they go by when they were last written instead.
+	tList<tStringItem> catalogFiles;
+	tSystem::tFindFilesInDir(catalogFiles, cacheDir, "*.cat");
+	deletedCount += RemoveOldestFiles(catalogFiles, MaxCatalogFiles, Compare_FileModTimeAscending);
+	return deletedCount;
+}
+
+
+int TexView::RemoveOldestFiles(tList<tStringItem>& files, int maxFiles, FileCompareFn oldestFirst)
+{
+	int numFiles = files.NumItems();
+	if (numFiles <= maxFiles)
 		return 0;
 
-	cacheFiles.Sort(Compare_FileCreationTimeAscending);
-	int targetCount = tClampMin(Config.MaxCacheFiles - 100, 0);
+	files.Sort(oldestFirst);
+	int targetCount = tClampMin(maxFiles - 100, 0);
 
 	int numToRemove = numFiles - targetCount;
 	tAssert(numToRemove >= 0);
 	int deletedCount = 0;
 	while (numToRemove)
 	{
-		tStringItem* head = cacheFiles.Remove();
+		tStringItem* head = files.Remove();
 		if (tDeleteFile(*head))
 			deletedCount++;
 		delete head;
@@ -1529,9 +2005,27 @@ int TexView::RemoveOldCacheFiles(const tString& cacheDir)
 
 int main(int argc, char** argv)
 {
+	TexView::LaunchTime = SingleInstance::GetClock();
 	tSystem::tSetStdoutRedirectCallback(TexView::PrintRedirectCallback);
 	tCommand::tParse(argc, argv);
 
+	tString dataDir = tSystem::tGetProgramDir() + "Data/";
+	tString cfgFile = dataDir + "Settings.cfg";
+
+	// A running viewer is asked to open the file before anything else is set up, so this launch can exit quickly. The
+	// settings are read again once the screen size is known. The path is made absolute since the running viewer has
+	// its own working dir. A viewer that has hung gets a second before this launch gives up and opens its own window.
+	Settings launchConfig;
+	launchConfig.Load(cfgFile, 0, 0);
+	if (launchConfig.SingleInstance)
+	{
+		tList<tStringItem> files;
+		if (TexView::ImageFileParam.IsPresent())
+			files.Append(new tStringItem(tSystem::tGetAbsolutePath(TexView::ImageFileParam.Get())));
+		if (SingleInstance::Handoff(TexView::InstanceName, files, TexView::LaunchTime))
+			return 0;
+	}
+
 	// Setup window
 	glfwSetErrorCallback(TexView::GlfwErrorCallback);
 	if (!glfwInit())
@@ -1549,13 +2043,13 @@ int main(int argc, char** argv)
 	GLFWmonitor* monitor = glfwGetPrimaryMonitor();
 	const GLFWvidmode* mode = glfwGetVideoMode(monitor);
 
-	tString dataDir = tSystem::tGetProgramDir() + "Data/";
 	TacitImage::ThumbCacheDir = dataDir + "Cache/";
 	if (!tSystem::tDirExists(TacitImage::ThumbCacheDir))
 		tSystem::tCreateDir(TacitImage::ThumbCacheDir);
 
-	tString cfgFile = dataDir + "Settings.cfg";
 	TexView::Config.Load(cfgFile, mode->width, mode->height);
+	TacitImage::DecodeCache.Init(TacitImage::ThumbCacheDir + "Pixels/", int64(TexView::Config.MaxDecodeCacheMB) << 20);
+	EditHistory::MaxBytes = int64(TexView::Config.MaxUndoMB) << 20;
 
 	// We start with window invisible as DwmSetWindowAttribute won't redraw properly otherwise.
 	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
@@ -1662,6 +2156,11 @@ int main(int argc, char** argv)
 	ShowWindow(hwnd, SW_SHOW);
 	glfwMakeContextCurrent(TexView::Window);
 	glfwSwapBuffers(TexView::Window);
+	tPrintf("Started in %.1fms.\n", (SingleInstance::GetClock() - TexView::LaunchTime)*1000.0);
+
+	// If another viewer is already listening this one runs on its own.
+	if (TexView::Config.SingleInstance && !TexView::EnableSingleInstance(true))
+		tPrintf("Another viewer is handling new launches.\n");
 
 	// Main loop.
 	static double lastUpdateTime = glfwGetTime();
@@ -1675,6 +2174,7 @@ int main(int argc, char** argv)
 	// This is important. We need the destructors to run BEFORE we shutdown GLFW. Deconstructing the images may block for a bit while shutting
 	// down worker threads. We could show a 'shutting down' popup here if we wanted -- if TacitImage::ThumbnailNumThreadsRunning is > 0.
 	TexView::Images.Clear();
+	TexView::Instance.Stop();
 
 	// Get current window geometry and set in config file if we're not in fullscreen mode or iconified.
 	if (!TexView::FullscreenMode && !TexView::WindowIconified)
@@ -1692,6 +2192,12 @@ int main(int argc, char** argv)
 	glfwDestroyWindow(TexView::Window);
 	glfwTerminate();
 
+	// The catalog must be written before we exit. Like changing directory, a save still running is finished first.
+	TexView::Catalog.WaitForSave();
+	TexView::Catalog.SaveAsync();
+	TexView::Catalog.WaitForSave();
+	TacitImage::DecodeCache.WaitForSave();
+
 	// Before we go, lets clear out any old cache files.
 	TexView::RemoveOldCacheFiles(TacitImage::ThumbCacheDir);
 	return 0;
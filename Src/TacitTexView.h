@@ -50,8 +50,25 @@ namespace TexView
 	void PopulateImages();
 	void SetCurrentImage(const tString& currFilename = tString());
 	void LoadCurrImage();
+	void SetWindowTitle();
 	bool ChangeScreenMode(bool fullscreeen, bool force = false);
 	void SortImages(Settings::SortKeyEnum, bool ascending);
+
+	// Records what is currently known about the image in the metadata catalog of the current directory.
+	void UpdateCatalog(TacitImage*);
+
+	// Plays the numbered sequence the current image belongs to, like render_0001.png, render_0002.png and so on. Frames
+	// are decoded ahead on worker threads. Returns false if there are fewer than two frames.
+	bool StartSequence();
+	void StopSequence();
+	void SetSequenceFPS(float fps);
+
+	// Animated images play unless paused with space. They also hold their frame while edited.
+	bool IsAnimationPlaying();
+
+	// Starts or stops listening for files from new launches of the viewer. Returns false if it couldn't start, usually
+	// because another viewer is already listening.
+	bool EnableSingleInstance(bool enable);
 	bool DeleteImageFile(const tString& imgFile, bool tryUseRecycleBin);
 	tMath::tVector2 GetDialogOrigin(float index);
 }
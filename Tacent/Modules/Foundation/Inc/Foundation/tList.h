@@ -436,7 +436,7 @@ template<typename T> inline T* tList<T>::Drop()
 	if (!TailItem)
 		return nullptr;
 
-	T* t = TailItem;
+	T* t = (T*)TailItem;
 
 	TailItem = TailItem->PrevItem;
 	if (!TailItem)
@@ -811,7 +811,7 @@ template<typename T> inline T* tListZ<T>::Drop()
 	if (!TailItem)
 		return nullptr;
 
-	T* t = TailItem;
+	T* t = (T*)TailItem;
 
 	TailItem = TailItem->PrevItem;
 	if (!TailItem)
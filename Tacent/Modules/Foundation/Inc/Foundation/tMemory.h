@@ -13,12 +13,13 @@
 // PERFORMANCE OF THIS SOFTWARE.
 
 #pragma once
+#include <stddef.h>
 namespace tMem
 {
 
 
 const int DefaultAlignment = 4;
-void* tMalloc(int size, int align = DefaultAlignment);		// Align must be a power of 2.
+void* tMalloc(size_t size, int align = DefaultAlignment);	// Align must be a power of 2. Returns nullptr on failure.
 void tFree(void* mem);
 
 
@@ -16,13 +16,18 @@
 #include "Foundation/tAssert.h"
 
 
-void* tMem::tMalloc(int size, int alignSize)
+void* tMem::tMalloc(size_t size, int alignSize)
 {
 	// This code works for both 32 and 64 bit pointers.
 	bool isPow2 = ((alignSize < 1) || (alignSize & (alignSize-1))) ? false : true;
 	tAssert(isPow2);
-		
-	uint8* rawAddr = (uint8*)malloc(size + alignSize + sizeof(int));
+
+	// The padding must not wrap the size around to something small.
+	size_t padding = size_t(alignSize) + sizeof(int);
+	if (size > size_t(-1) - padding)
+		return nullptr;
+
+	uint8* rawAddr = (uint8*)malloc(size + padding);
 	if (!rawAddr)
 		return nullptr;
 
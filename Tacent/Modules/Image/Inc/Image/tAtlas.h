@@ -0,0 +1,94 @@
+// tAtlas.h
+//
+// Packs a set of tPictures (sprites) into one or more atlas pages. Packing can use MaxRects or Skyline, with optional
+// rotation, padding, and edge extrusion. Pages may be fixed size, the smallest power-of-two that fits, or trimmed to
+// exactly what is used. The placement of every sprite can be saved as a tScript table.
+//
+// Copyright (c) 2020 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#pragma once
+#include <Foundation/tList.h>
+#include <Foundation/tArray.h>
+#include <Foundation/tString.h>
+#include "Image/tPicture.h"
+namespace tImage
+{
+
+
+enum class tAtlasMethod
+{
+	MaxRects,											// Best short side fit. Tighter packing.
+	Skyline												// Bottom left. Faster, but leaves gaps under overhangs.
+};
+
+enum class tAtlasPageSize
+{
+	Fixed,												// Every page is the maximum size.
+	PowerOfTwo,											// The smallest power-of-two width and height that fit.
+	Tight												// Trimmed to the used area.
+};
+
+struct tAtlasSettings
+{
+	tAtlasMethod Method					= tAtlasMethod::MaxRects;
+	tAtlasPageSize PageSize				= tAtlasPageSize::PowerOfTwo;
+	int MaxPageWidth					= 2048;
+	int MaxPageHeight					= 2048;
+	bool AllowRotation					= false;		// Sprites may be turned 90 degrees clockwise to fit better.
+	int Padding							= 0;			// Empty pixels between sprites, not counting extrusion.
+	int Extrude							= 0;			// Edge pixels repeated outwards around each sprite.
+};
+
+// Where a sprite ended up. X and Y are the lower-left pixel of the sprite in its page and the width and height are as
+// placed, so they are swapped for rotated sprites. Extrusion is outside this rectangle. A rotated sprite's bottom row
+// runs up the left column of its rectangle. Sprites that were not valid pictures have a Page of -1.
+struct tAtlasPlacement
+{
+	int Page;
+	int X, Y;
+	int Width, Height;
+	bool Rotated;
+	tString Name;										// The sprite's filename.
+};
+
+
+// Packing is deterministic. The same sprites and settings always give the same pages. Sprites are sorted largest
+// first. Each page tries sizes from small to large until everything left fits. If nothing up to the maximum holds
+// every remaining sprite, the maximum page is filled as well as it can be and the rest go on the next page.
+class tAtlas
+{
+public:
+	tAtlas()																											{ }
+	tAtlas(const tList<tPicture>& sprites, const tAtlasSettings& settings)												{ Build(sprites, settings); }
+
+	// Builds the pages. Placements are in the same order as the sprites. Returns false and leaves the atlas invalid if
+	// the settings are bad, there are no valid sprites, or a sprite is too big for the maximum page size. If
+	// numThreads <= 0 one thread per core is used to copy the sprites into the pages.
+	bool Build(const tList<tPicture>& sprites, const tAtlasSettings&, int numThreads = -1);
+
+	// Writes the placement table to a tScript file. It lists a [Page index width height] expression for each page and
+	// a [Sprite index page x y width height rotated name] expression for each sprite. The name is left off if the
+	// sprite has no filename. Returns false if the atlas is invalid or the file can't be written.
+	bool SaveScript(const tString& scriptFile) const;
+
+	void Clear()																										{ Pages.Empty(); Placements.Clear(); }
+	bool IsValid() const																								{ return !Pages.IsEmpty(); }
+	int GetNumPages() const																								{ return Pages.GetNumItems(); }
+
+	// The fraction of the page area covered by sprites, not counting padding or extrusion.
+	float GetOccupancy() const;
+
+	tList<tPicture> Pages;
+	tArray<tAtlasPlacement> Placements;
+};
+
+
+}
@@ -0,0 +1,352 @@
+// tBandPipeline.h
+//
+// A pull-based pipeline that processes an image a band of rows at a time so the whole image never needs to be in
+// memory. Sources produce rows top row first. Stages are sources that pull rows from the source before them and
+// transform them, and sinks write rows out as they arrive. tStream pumps a source into a sink. Each step only holds a
+// few bands, so converting and resizing an image far larger than memory takes about as much memory as a small one. A
+// tBandPrefetch stage runs everything before it on its own thread.
+//
+// Copyright (c) 2020 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#pragma once
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <Foundation/tString.h>
+#include <Math/tColour.h>
+#include "Image/tPicture.h"
+#include "Image/tPictureView.h"
+#include "Image/tPixelFormat.h"
+#include "Image/tFileTGA.h"
+#include "Image/tFilePNG.h"
+#include "Image/tFileQOI.h"
+namespace tImage
+{
+
+
+// Unlike a tPicture, rows in a band are ordered top to bottom. Bands are packed, with width pixels per row. Stages keep
+// a reference to the source before them, so the sources must outlive the stages built on them. Each source may only
+// be read through once.
+class tBandSource
+{
+public:
+	virtual ~tBandSource()																								{ }
+
+	// Reads the next numRows rows into dest. Returns false if there was an error or fewer than numRows rows are left.
+	bool Read(tPixel* dest, int numRows);
+
+	bool IsValid() const																								{ return (Width > 0) && (Height > 0); }
+	int GetWidth() const																								{ return Width; }
+	int GetHeight() const																								{ return Height; }
+	int GetRowsRead() const																								{ return RowsRead; }
+
+	// True if every pixel is known to be opaque. Sources that can't tell without reading all the pixels return false.
+	bool IsOpaque() const																								{ return Opaque; }
+
+protected:
+	// Only called with numRows > 0 and no more rows than are left.
+	virtual bool ReadRows(tPixel* dest, int numRows)																	= 0;
+
+	int Width = 0;
+	int Height = 0;
+	bool Opaque = false;
+
+private:
+	int RowsRead = 0;
+};
+
+
+// Reads the rows of a view. The pixels are not copied so they must stay valid until the rows are read.
+class tBandPictureSource : public tBandSource
+{
+public:
+	tBandPictureSource(const tPictureView&);
+
+protected:
+	bool ReadRows(tPixel* dest, int numRows) override;
+
+private:
+	tPictureView View;
+};
+
+
+// Streams a targa from disk. Invalid if the file can't be opened or isn't a supported targa.
+class tBandTGASource : public tBandSource
+{
+public:
+	tBandTGASource(const tString& tgaFile);
+
+protected:
+	bool ReadRows(tPixel* dest, int numRows) override;
+
+private:
+	tTGAReader Reader;
+};
+
+
+// Streams a qoi file from disk. Invalid if the file can't be opened or isn't a valid qoi.
+class tBandQOISource : public tBandSource
+{
+public:
+	tBandQOISource(const tString& qoiFile);
+
+protected:
+	bool ReadRows(tPixel* dest, int numRows) override;
+
+private:
+	tQOIReader Reader;
+};
+
+
+// The same as tPicture::Crop. The origin is where the bottom-left of the new image is in the source, measured from the
+// source's bottom-left. Pixels outside the source are transparent black. Rows above the crop are read and thrown away
+// and rows below it are never read.
+class tBandCrop : public tBandSource
+{
+public:
+	tBandCrop(tBandSource&, int newWidth, int newHeight, int originX, int originY);
+	virtual ~tBandCrop()																								{ delete[] Row; }
+
+protected:
+	bool ReadRows(tPixel* dest, int numRows) override;
+
+private:
+	tBandSource& Source;
+	int OriginX;
+	int SrcTop;											// The source row, counting from the top, of the first row.
+	tPixel* Row = nullptr;
+};
+
+
+// Resizes with a separable filter. Each source row is resampled horizontally as it is read and kept in a ring of
+// rows just tall enough for the vertical filter, so only a filter's height worth of rows is held. The filters are the
+// same kinds as tPicture::Resample but are computed here, so results differ slightly from the CxImage ones.
+class tBandResample : public tBandSource
+{
+public:
+	tBandResample(tBandSource&, int newWidth, int newHeight, tPicture::tFilter = tPicture::tFilter::Bilinear);
+	virtual ~tBandResample();
+
+protected:
+	bool ReadRows(tPixel* dest, int numRows) override;
+
+private:
+	// For each destination pixel along an axis, the first source pixel it uses and the weights of the pixels from
+	// there. Weights are packed MaxCount to a destination pixel.
+	struct Axis
+	{
+		void Set(int srcSize, int dstSize, tPicture::tFilter);
+		~Axis()																											{ delete[] First; delete[] Count; delete[] Weights; }
+		int* First = nullptr;
+		int* Count = nullptr;
+		float* Weights = nullptr;
+		int MaxCount = 0;
+	};
+
+	bool ReadSourceRow();
+
+	tBandSource& Source;
+	Axis AxisX;
+	Axis AxisY;
+
+	tPixel* SrcRow = nullptr;
+	// RingSize rows of Width RGBA floats, resampled horizontally. Source row y is at y % RingSize.
+	float* Ring = nullptr;
+	int RingSize = 0;
+	int SrcRowsRead = 0;
+	float* Accum = nullptr;
+};
+
+
+// Rotates by 90 degrees the same way as tPicture::Rotate90. Every row of the output needs a pixel from every row of
+// the source, so the source is first written to a scratch file as square tiles. Output rows are then made a column of
+// tiles at a time. The scratch file is deleted when the stage is destroyed.
+class tBandRotate90 : public tBandSource
+{
+public:
+	tBandRotate90(tBandSource&, bool antiClockwise, const tString& scratchFile);
+	virtual ~tBandRotate90();
+
+	const static int TileSize = 64;
+
+protected:
+	bool ReadRows(tPixel* dest, int numRows) override;
+
+private:
+	bool WriteTiles();
+	bool ReadStrip(int tileX);
+
+	tBandSource& Source;
+	bool AntiClockwise;
+	tString ScratchFile;
+	tFileHandle File = nullptr;
+	int64 FilePos = 0;
+	int NumTilesX = 0;
+	int NumTilesY = 0;
+
+	// A column of tiles. Since each tile is TileSize wide, pixel (x, y) of the strip is at Strip[y*TileSize + x].
+	tPixel* Strip = nullptr;
+	int StripTileX = -1;
+};
+
+
+// Passes the pixels through a pixel format and back, so they end up with the precision and channels of that format.
+// L8A8 makes the image greyscale, for example. Block compressed formats aren't supported.
+class tBandConvert : public tBandSource
+{
+public:
+	tBandConvert(tBandSource&, tPixelFormat);
+	virtual ~tBandConvert()																								{ delete[] Converted; }
+
+protected:
+	bool ReadRows(tPixel* dest, int numRows) override;
+
+private:
+	tBandSource& Source;
+	tPixelFormat Format;
+	uint8* Converted = nullptr;
+	int ConvertedRows = 0;
+};
+
+
+// Reads the source on a worker thread a band at a time and keeps up to maxBands bands ready. Everything before this
+// stage runs in parallel with everything after it. The thread is started by the first read.
+class tBandPrefetch : public tBandSource
+{
+public:
+	tBandPrefetch(tBandSource&, int bandRows = 64, int maxBands = 4);
+	virtual ~tBandPrefetch();
+
+protected:
+	bool ReadRows(tPixel* dest, int numRows) override;
+
+private:
+	void Work();
+
+	tBandSource& Source;
+	int BandRows;
+	int MaxBands;
+	tPixel* Bands = nullptr;							// A ring of MaxBands bands.
+	int* BandNumRows = nullptr;
+
+	// Bands from Head onwards are ready. The consumer has used HeadRowsUsed rows of the head band.
+	std::thread Worker;
+	std::mutex Mutex;
+	std::condition_variable Condition;
+	int Head = 0;
+	int NumReady = 0;
+	int HeadRowsUsed = 0;
+	bool Stop = false;
+	bool Failed = false;
+};
+
+
+// Sinks are given the rows top row first in bands of any size.
+class tBandSink
+{
+public:
+	virtual ~tBandSink()																								{ }
+
+	// If the source is opaque sinks with an Auto format drop the alpha channel.
+	virtual bool Begin(int width, int height, bool opaque)																= 0;
+	virtual bool Write(const tPixel* rows, int numRows)																	= 0;
+
+	// Returns false if there was an error or not all the rows were written.
+	virtual bool End()																									= 0;
+};
+
+
+// Assembles the rows into a tPicture. This is the only sink that holds the whole image.
+class tBandPictureSink : public tBandSink
+{
+public:
+	tBandPictureSink(tPicture& picture)																					: Picture(picture) { }
+	virtual ~tBandPictureSink()																							{ tPicture::FreePixels(Pixels); }
+
+	bool Begin(int width, int height, bool opaque) override;
+	bool Write(const tPixel* rows, int numRows) override;
+	bool End() override;
+
+private:
+	tPicture& Picture;
+	tPixel* Pixels = nullptr;
+	int Width = 0;
+	int Height = 0;
+	int RowsWritten = 0;
+};
+
+
+class tBandTGASink : public tBandSink
+{
+public:
+	tBandTGASink
+	(
+		const tString& tgaFile, tFileTGA::tFormat = tFileTGA::tFormat::Auto,
+		tFileTGA::tCompression = tFileTGA::tCompression::RLE
+	);
+
+	bool Begin(int width, int height, bool opaque) override;
+	bool Write(const tPixel* rows, int numRows) override;
+	bool End() override																									{ return Writer.End(); }
+
+private:
+	tString File;
+	tFileTGA::tFormat Format;
+	tFileTGA::tCompression Compression;
+	tTGAWriter Writer;
+	int Width = 0;
+};
+
+
+class tBandPNGSink : public tBandSink
+{
+public:
+	tBandPNGSink
+	(
+		const tString& pngFile, tFilePNG::tFormat = tFilePNG::tFormat::Auto,
+		tFilePNG::tLevel = tFilePNG::tLevel::Default
+	);
+
+	bool Begin(int width, int height, bool opaque) override;
+	bool Write(const tPixel* rows, int numRows) override;
+	bool End() override																									{ return Writer.End(); }
+
+private:
+	tString File;
+	tFilePNG::tFormat Format;
+	tFilePNG::tLevel Level;
+	tPNGWriter Writer;
+	int Width = 0;
+};
+
+
+class tBandQOISink : public tBandSink
+{
+public:
+	tBandQOISink(const tString& qoiFile, tFileQOI::tFormat format = tFileQOI::tFormat::Auto)							: File(qoiFile), Format(format) { }
+
+	bool Begin(int width, int height, bool opaque) override;
+	bool Write(const tPixel* rows, int numRows) override;
+	bool End() override																									{ return Writer.End(); }
+
+private:
+	tString File;
+	tFileQOI::tFormat Format;
+	tQOIWriter Writer;
+	int Width = 0;
+};
+
+
+// Reads all the rows of the source and writes them to the sink, bandRows rows at a time. Returns success.
+bool tStream(tBandSink&, tBandSource&, int bandRows = 64);
+
+
+}
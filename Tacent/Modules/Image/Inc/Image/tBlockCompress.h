@@ -0,0 +1,69 @@
+// tBlockCompress.h
+//
+// Native block compression (BCn) encoding and decoding. Encodes RGBA pixels into BC1, BC2, BC3, BC4, BC5, and BC7
+// blocks, and HDR pixels into BC6H blocks, without any external library. Any image size may be encoded. Blocks that
+// hang over the right or bottom edge are padded by repeating the last column and row. Rows of blocks are encoded in
+// parallel and the output does not depend on the number of threads. The decoder is mostly useful for measuring the
+// error of the encoder and for previewing block compressed data on the CPU.
+//
+// Copyright (c) 2020 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#pragma once
+#include <Math/tColour.h>
+#include "Image/tPixelFormat.h"
+namespace tImage
+{
+
+
+enum class tBCQuality
+{
+	Fast,												// Bounding box endpoints. BC6H and BC7 try a single mode.
+	Normal,												// Principal axis endpoints followed by a couple of least-squares refinement passes.
+	High												// More refinement passes, modes, and partitions, and a search of nearby endpoints.
+};
+
+
+// Returns the number of bytes needed to hold a width by height image in the supplied block format. Returns 0 if the
+// format is not a block format or the dimensions are not positive.
+int tGetBCEncodedSize(tPixelFormat, int width, int height);
+
+// Returns true if tEncodeBC and tDecodeBC support the pixel format.
+bool tCanEncodeBC(tPixelFormat);
+
+// Encodes width*height pixels into dest, which must have room for tGetBCEncodedSize bytes. The pixel rows are encoded
+// in the order they are in memory, so the first row of pixels ends up in the first row of blocks. BC1_DXT1 ignores the
+// alpha channel. BC1_DXT1BA makes pixels with alpha below 128 transparent. BC4 encodes the red channel and BC5 the red
+// and green channels. BC6H treats the pixels as linear values from 0 to 1 and ignores alpha. If numThreads <= 0 one
+// thread per core is used. Returns false if the format is not supported.
+bool tEncodeBC
+(
+	uint8* dest, const tPixel* pixels, int width, int height, tPixelFormat,
+	tBCQuality = tBCQuality::Normal, int numThreads = -1
+);
+
+// Encodes HDR pixels. Only BC6H is supported. BC6H is written as unsigned half floats (BC6H_UF16) so negative values
+// are clamped to zero and values above 65504 to 65504. Alpha is ignored.
+bool tEncodeBC
+(
+	uint8* dest, const tColourf* pixels, int width, int height, tPixelFormat,
+	tBCQuality = tBCQuality::Normal, int numThreads = -1
+);
+
+// Decodes blocks back into width*height pixels. BC4 decodes to red only and BC5 to red and green, with the other
+// colour channels zero and alpha opaque. BC6H is clamped to the 0 to 1 range. Returns false if the format is not
+// supported.
+bool tDecodeBC(tPixel* dest, const uint8* blocks, int width, int height, tPixelFormat);
+
+// Decodes BC6H blocks keeping the full HDR range. Alpha is set to 1. Returns false for any other format.
+bool tDecodeBC(tColourf* dest, const uint8* blocks, int width, int height, tPixelFormat);
+
+
+}
@@ -119,6 +119,10 @@ public:
 	void Save(tChunkWriter&) const;
 	void Load(const tChunk&);
 
+	// Saves to a dds cubemap file. All six sides must be valid and match in size, pixel format, and number of mipmaps.
+	// Returns false if a side is missing or the extension isn't dds. Throws a tDDSError if the file can't be written.
+	bool Save(const tString& ddsFile, bool reverseRowOrder = true) const;
+
 	// Cubemaps are considered equal if all their individual tTextures represent the same cubemap side and all the
 	// tTextures are equal. Invalid cubemaps are not equal to anything, including other invalids.
 	bool operator==(const tCubemap&) const;
@@ -0,0 +1,84 @@
+// tCubemapConvert.h
+//
+// Conversions between the six faces of a cubemap and single picture layouts. Supported layouts are equirectangular
+// (latitude-longitude) panoramas and horizontal and vertical crosses. Conversions run in both directions with bilinear
+// or bicubic filtering, and the filters blend across face seams and around the panorama wrap so there are no visible
+// edges. Rows of the output are processed in parallel.
+//
+// Copyright (c) 2020 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#pragma once
+#include "Image/tPicture.h"
+#include "Image/tCubemap.h"
+namespace tImage
+{
+
+
+// Faces are always passed as an array of six square pictures of the same size in tCubemap::tSide order, +x -x +y -y
+// +z -z, using the same left handed orientation as dds cubemaps. Like every tPicture the face rows go from bottom to
+// top in memory, which is what tCubemap gives you when loaded with the default reverseRowOrder.
+//
+// The equirectangular layout has +z in the centre column with +x a quarter of the way to the right, and +y at the top.
+// The horizontal cross is 4x3 faces with -x +z +x -z across the middle and +y above and -y below +z. The vertical
+// cross is 3x4 faces with -x +z +x across the second row, +y above +z, and -y then -z below it. The -z face is rotated
+// 180 degrees in the vertical cross so that it joins -y without a seam. Cells of a cross with no face are transparent.
+enum class tCubeFilter
+{
+	Bilinear,
+	Bicubic												// Catmull-Rom. Sharper, but may ring a little at hard edges.
+};
+
+enum class tCrossLayout
+{
+	Horizontal,
+	Vertical
+};
+
+// Fills the faces from the main layers of the cubemap sides. Compressed sides are decoded, so any format tDecodeBC
+// supports works, as do all the normal formats. Returns false if a side is missing, not square, not the same size as
+// the others, or in an unsupported format.
+bool tGetCubemapFaces(tPicture faces[int(tCubemap::tSide::NumSides)], tCubemap&);
+
+// Renders an equirectangular panorama. If width or height is <= 0 it defaults to 4 times or 2 times the face size.
+// Returns false if the faces are not all valid square pictures of the same size. If numThreads <= 0 one thread per
+// core is used.
+bool tCubeToEquirect
+(
+	tPicture& dest, const tPicture faces[int(tCubemap::tSide::NumSides)], int width = 0, int height = 0,
+	tCubeFilter = tCubeFilter::Bilinear, int numThreads = -1
+);
+
+// Renders the six faces from an equirectangular panorama. If faceSize <= 0 it defaults to a quarter of the panorama
+// width. No prefiltering is done, so making faces much smaller than the default will alias.
+bool tEquirectToCube
+(
+	tPicture faces[int(tCubemap::tSide::NumSides)], const tPicture& src, int faceSize = 0,
+	tCubeFilter = tCubeFilter::Bilinear, int numThreads = -1
+);
+
+// Lays the faces out in a cross. If faceSize is <= 0 or the same as the source faces the pixels are copied exactly,
+// otherwise the faces are resampled with the filter.
+bool tCubeToCross
+(
+	tPicture& dest, const tPicture faces[int(tCubemap::tSide::NumSides)], tCrossLayout = tCrossLayout::Horizontal,
+	int faceSize = 0, tCubeFilter = tCubeFilter::Bilinear, int numThreads = -1
+);
+
+// Extracts the faces from a cross. The layout is worked out from the aspect ratio, which must be exactly 4:3 or 3:4.
+// As above, faceSize <= 0 keeps the cell size and copies the pixels exactly.
+bool tCrossToCube
+(
+	tPicture faces[int(tCubemap::tSide::NumSides)], const tPicture& src, int faceSize = 0,
+	tCubeFilter = tCubeFilter::Bilinear, int numThreads = -1
+);
+
+
+}
@@ -0,0 +1,80 @@
+// tExportSet.h
+//
+// Makes several resized copies of one image, such as a thumbnail, a preview and a few web sizes, from a single decode.
+// The source is halved repeatedly with a box filter into a pyramid, and each output is resampled from the smallest
+// level that is still at least as big as it. Small outputs then only filter a small level instead of the full image.
+// Resampling uses tBandResample, so results differ slightly from tPicture::Resample. The outputs are resampled and
+// saved in parallel.
+//
+// Copyright (c) 2020 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#pragma once
+#include <Foundation/tArray.h>
+#include <Foundation/tString.h>
+#include "Image/tPicture.h"
+namespace tImage
+{
+
+
+// One image to make from the source. The file type comes from the extension and may be any type tPicture::Save
+// supports. A width or height of zero is worked out from the other so the source aspect ratio is kept. If both are
+// zero the output is the size of the source.
+struct tExportTarget
+{
+	tString File;
+	int Width							= 0;
+	int Height							= 0;
+	tPicture::tFilter Filter			= tPicture::tFilter::Bilinear;
+	tPicture::tColourFormat Format		= tPicture::tColourFormat::Auto;
+};
+
+// How a target went. Times are in seconds.
+struct tExportResult
+{
+	bool Saved							= false;
+	int Width							= 0;			// The size that was saved.
+	int Height							= 0;
+	int Level							= 0;			// The pyramid level it was resampled from. The source is 0.
+	float ResampleTime					= 0.0f;
+	float SaveTime						= 0.0f;
+};
+
+
+class tExportSet
+{
+public:
+	tExportSet()																										{ }
+	tExportSet(const tArray<tExportTarget>& targets)																	: Targets(targets) { }
+
+	void AddTarget(const tString& file, int width, int height, tPicture::tFilter = tPicture::tFilter::Bilinear);
+
+	// Loads the image once and makes every target from it. Returns the number of targets saved. Results has an entry
+	// for each target afterwards, in the same order. If numThreads <= 0 one thread per core is used.
+	int Export(const tString& imageFile, int numThreads = -1);
+
+	// Makes every target from a picture that is already loaded. The source is not modified.
+	int Export(const tPicture& source, int numThreads = -1);
+
+	// Prints the time taken by each step and each target.
+	void PrintTimings() const;
+
+	tArray<tExportTarget> Targets;
+	tArray<tExportResult> Results;
+
+	// From the last export. Times are in seconds.
+	int NumLevels						= 0;			// Including the source.
+	float LoadTime						= 0.0f;
+	float PyramidTime					= 0.0f;
+	float TotalTime						= 0.0f;
+};
+
+
+}
@@ -1,9 +1,9 @@
 // tFileDDS.h
 //
-// This class is a helper class. It should not be necessary to use this class directly. It knows how to load (but not
-// save) a Direct Draw Surface (.dds) file. It does zero processing of image data. It knows the details of the dds file
+// This class is a helper class. It should not be necessary to use this class directly. It knows how to load and save
+// a Direct Draw Surface (.dds) file. It does zero processing of image data. It knows the details of the dds file
 // format and loads the data into tLayers. This class does not compress or decompress the image data if it is
-// compressed (DXTn), it simply keeps it in the same format as the source file. The layers may be 'stolen' from a
+// compressed (BCn), it simply keeps it in the same format as the source file. The layers may be 'stolen' from a
 // tFileDDS so that excessive memcpys are avoided. After they are stolen the tFileDDS is invalid.
 //
 // A good viewer for dds files (and targas) is called ddsview. It is one of the few viewers that displays alphas
@@ -121,13 +121,53 @@ public:
 	// You do not own the returned pointer.
 	tLayer* GetLayer(int layerNum, int imageNum) const																	{ return MipmapLayers[layerNum][imageNum]; }
 
+	// Saves a texture to a dds file. The first layer is the main image and each one after it must be the next mipmap,
+	// half the size of the one before. All layers must have the same pixel format. Formats with a legacy dds
+	// description (BC1 to BC3 and the RGB formats) get the legacy header so that older tools can read them. BC4 to BC7
+	// get the DX10 extended header. The reverse row order flag undoes what the same flag does on load, so layers with
+	// their origin in the lower-left should leave it set to true. If the file can't be saved a tDDSError is thrown.
+	static void Save(const tString& ddsFile, const tList<tLayer>& layers, bool reverseRowOrder = true);
+
+	// Saves a cubemap. All six sides must be supplied and must have the same dimensions, pixel format, and number of
+	// mipmaps. Like on load, the sides are specified using a left-handed coord system.
+	static void Save(const tString& ddsFile, const tList<tLayer>* sides[tSurfIndex_NumSurfaces], bool reverseRowOrder = true);
+
+	// Saves the currently loaded layers. The object must be valid. Pass the same reverse row order flag that was used
+	// to load it to get the original file data back.
+	void Save(const tString& ddsFile, bool reverseRowOrder = true) const;
+
+	// Reads only the header of a dds file in memory without loading any pixel data and without throwing. numBytes only
+	// needs to cover the header, which is 128 bytes, or 148 with the DX10 extended header. Returns false if the data
+	// isn't a dds file or the pixel format isn't supported. Volume textures and texture arrays are not supported.
+	static bool ReadHeader
+	(
+		const uint8* ddsData, int numBytes, tPixelFormat&, int& width, int& height, int& numMipmaps,
+		bool& cubemap
+	);
+
+	// Loads a single mipmap layer without reading the rest of the file. The layer is the smallest one that is at least
+	// fitWidth wide or fitHeight high, which is the one to resample from when shrinking the image to fit inside a
+	// fitWidth by fitHeight box. If no layer is that big the main layer is used. For cubemaps the layer comes from the
+	// given side. BC1 layers with binary alpha blocks are returned as BC1_DXT1BA. Returns nullptr, and does not throw,
+	// if the file can't be read or the format isn't supported. The caller owns the returned layer.
+	static tLayer* LoadClosestLayer
+	(
+		const tString& ddsFile, int fitWidth, int fitHeight, tSurfIndex side = tSurfIndex_Default,
+		bool reverseRowOrder = true
+	);
+
 	// This is only for reporting the filename in case of errors.
 	tString Filename;
 
 private:
 	// This does not delete[] the ddsData. Neither does it clear the object. The caller is expected to have done that.
 	void LoadFromMemory(const uint8* ddsData, int ddsSizeBytes, bool reverseRowOrder);
-	bool DoDXT1BlocksHaveBinaryAlpha(tDXT1Block* blocks, int numBlocks);
+	static bool DoDXT1BlocksHaveBinaryAlpha(tDXT1Block* blocks, int numBlocks);
+
+	const static int MaxMipmapLayers = 16;
+	const static int MaxDimension = 32768;				// Bigger than any texture D3D supports.
+	const static int MaxImages = 6;
+	static void SaveLayers(const tString& ddsFile, const tLayer* layers[MaxMipmapLayers][MaxImages], int numMipmapLayers, int numImages, bool reverseRowOrder);
 
 	// The surface is only valid if this is not PixelFormat_Invalid.
 	tPixelFormat PixelFormat;
@@ -139,10 +179,8 @@ private:
 	// If this is 1, you can consider the texture(s) to NOT be mipmapped. If there is more than a single image (like
 	// with a cubemap), all images have the same number of mipmap layers.
 	int NumMipmapLayers;
-	const static int MaxMipmapLayers = 16;
 
 	// Cubemaps are always specified using a left-handed coord system even when using the OpenGL functions.
-	const static int MaxImages = 6;
 	tLayer* MipmapLayers[MaxMipmapLayers][MaxImages];
 };
 
@@ -172,6 +210,11 @@ struct tDDSError : public tError
 		LoaderSupportsPowerOfTwoDimsOnly,
 		MaxNumMipmapLevelsExceeded,
 		UnsuportedFloatingPointPixelFormat,
+		CannotReverseRowOrder,
+		UnsupportedDX10Resource,
+		UnsupportedSavePixelFormat,
+		InconsistentLayers,
+		FileWriteFailed,
 		NumCodes
 	};
 
@@ -0,0 +1,105 @@
+// tFileJPG.h
+//
+// This class is a helper class. It knows how to rotate and flip a jpg file without losing any quality. The quantized
+// DCT coefficients are read, the 8x8 blocks are moved to their new positions, and the coefficients inside each block are
+// transposed or have their signs flipped. Nothing is decoded or re-quantized, so the transform can be applied any
+// number of times without the image degrading. It can also just rewrite the exif orientation tag so viewers that
+// honour it reorient the image. Loading jpg files for display is still done by CxImage in tPicture.
+//
+// Copyright (c) 2020 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#pragma once
+#include <Foundation/tString.h>
+namespace tImage
+{
+
+
+// A jpg is stored in MCUs (minimum coded units) of 8x8, 16x8, or 16x16 pixels depending on the chroma subsampling.
+// Blocks can only be moved whole, so an image whose width or height isn't a multiple of the MCU size has a partial
+// MCU along its right or bottom edge. If a transform would move that edge to the left or top it must either be
+// trimmed off or padded out to a whole MCU. Padding keeps every pixel but adds a strip of whatever the encoder filled
+// the partial MCU with, usually repeated edge pixels.
+class tFileJPG
+{
+public:
+	// Loads the file into memory and reads its header. The pixels are not decoded.
+	tFileJPG(const tString& jpgFile);
+	virtual ~tFileJPG()																									{ delete[] Data; }
+
+	// The orientations are numbered as in the exif orientation tag. Each is the transform that takes the pixels as
+	// stored to the image as displayed. Flips are applied after the rotation.
+	enum class tOrientation
+	{
+		Invalid,										// Invalid must be 0.
+		Normal,
+		FlipH,
+		Rotate180,
+		FlipV,
+		Transpose,										// Mirrored across the top-left to bottom-right diagonal.
+		Rotate90CW,
+		Transverse,										// Mirrored across the top-right to bottom-left diagonal.
+		Rotate90ACW
+	};
+
+	// Returns the single transform that does the first and then the second. Invalid if either is invalid.
+	static tOrientation Combine(tOrientation first, tOrientation second);
+	static tOrientation Invert(tOrientation);
+
+	// True for the orientations that swap the width and height.
+	static bool IsTransposing(tOrientation);
+
+	enum class tEdge
+	{
+		Trim,
+		Pad
+	};
+
+	bool IsValid() const																								{ return Data ? true : false; }
+
+	// The sizes are of the image as displayed, so they are swapped from the stored ones if the exif orientation
+	// transposes. This matches tPicture::Load.
+	int GetWidth() const;
+	int GetHeight() const;
+	int GetMCUWidth() const;
+	int GetMCUHeight() const;
+	tOrientation GetOrientation() const																					{ return Orientation; }
+
+	// Gets the displayed size the image would have after SaveTransformed with the same arguments.
+	void GetTransformedSize(int& width, int& height, tOrientation transform, tEdge = tEdge::Trim) const;
+
+	// Applies the transform to the image as displayed and saves the result, which may be over the file that was loaded.
+	// The exif orientation is folded into the transform so the saved file is stored upright with its orientation tag
+	// reset to normal. All other markers are kept. Progressive files stay progressive. Returns success.
+	bool SaveTransformed(const tString& jpgFile, tOrientation transform, tEdge = tEdge::Trim) const;
+
+	// Saves the file with only its exif orientation changed, adding a minimal exif block if there is none. The pixels
+	// are copied as they are and nothing is trimmed. Returns false if the file has exif data without an orientation tag,
+	// since inserting a tag would mean rewriting the offsets of everything after it.
+	bool SaveReoriented(const tString& jpgFile, tOrientation transform) const;
+
+	// Reads the exif orientation from the start of a jpg file in memory. Returns Normal if there's no exif orientation,
+	// and Invalid if the data isn't a jpg or ends before the exif block does.
+	static tOrientation ReadOrientation(const uint8* jpgData, int numBytes);
+
+private:
+	uint8* Data = nullptr;
+	int NumBytes = 0;
+
+	// As stored in the file.
+	int StoredWidth = 0;
+	int StoredHeight = 0;
+	int StoredMCUWidth = 8;
+	int StoredMCUHeight = 8;
+	tOrientation Orientation = tOrientation::Normal;
+};
+
+
+}
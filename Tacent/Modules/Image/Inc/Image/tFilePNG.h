@@ -0,0 +1,120 @@
+// tFilePNG.h
+//
+// This class is a helper class. It should not be necessary to use this class directly. It knows how to save a png
+// file natively. Rows are read straight from a tPictureView, so no reordered or intermediate copy of the image is made.
+// Each row gets its own png filter and blocks of rows are deflated in parallel and stitched into a single zlib stream.
+// A row-at-a-time writer is also provided for images that are never fully in memory. Loading png files is still done
+// by CxImage in tPicture.
+//
+// Copyright (c) 2019 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#pragma once
+#include <Foundation/tString.h>
+#include <Math/tColour.h>
+#include <System/tFile.h>
+#include "Image/tPictureView.h"
+struct z_stream_s;
+namespace tImage
+{
+
+
+// The zlib stream is split into blocks of rows. Each block is compressed independently with the last 32KB of the block
+// before it as a preset dictionary, so almost nothing is lost compared to compressing the whole image in one go. Every
+// block except the last ends with a sync flush which byte-aligns it, so the compressed blocks can simply be
+// concatenated. The Adler-32 checksums of the blocks are combined for the stream trailer. Only a bounded batch of
+// blocks is held in memory at once, and each block is written out as its own IDAT chunk.
+class tFilePNG
+{
+public:
+	// Constructs from a view of the pixels to save. The pixels are not copied so they must stay valid until Save
+	// returns. The origin is the lower-left as with tPicture.
+	tFilePNG(const tPictureView& view)																					: View(view) { }
+
+	enum class tFormat
+	{
+		Invalid,										// Invalid must be 0.
+		Auto,											// Save function will decide format. Bit24 if all image pixels are opaque and Bit32 otherwise.
+		Bit24,											// 24 bit colour.
+		Bit32											// 24 bit colour with 8 bits opacity in the alpha channel.
+	};
+
+	// Trades speed for size. Fastest uses the Sub filter on every row. The others choose the filter per row by the
+	// minimum sum of absolute differences heuristic and use increasing zlib levels.
+	enum class tLevel
+	{
+		Fastest,
+		Fast,
+		Default,
+		Smallest
+	};
+
+	// Saves to the png file specified. The extension must be ".png". Returns the format the file was saved in, or
+	// tFormat::Invalid if there was a problem. If numThreads <= 0 one thread per core is used.
+	tFormat Save(const tString& pngFile, tFormat = tFormat::Auto, tLevel = tLevel::Default, int numThreads = -1) const;
+
+	bool IsValid() const																								{ return View.IsValid(); }
+	int GetWidth() const																								{ return View.GetWidth(); }
+	int GetHeight() const																								{ return View.GetHeight(); }
+
+private:
+	tPictureView View;
+};
+
+
+// Writes a png file one row at a time. Rows are supplied in file order, which is the top row first. Only the current
+// and previous rows and the output buffer are kept. The rows go through a single deflate stream on the calling thread,
+// so this is slower than tFilePNG::Save for images that fit in memory. The compressed data is written as IDAT chunks
+// whenever the output buffer fills.
+class tPNGWriter
+{
+public:
+	tPNGWriter()																										{ }
+	virtual ~tPNGWriter()																								{ Close(); }
+
+	// Creates the file and writes the header. The format must be Bit24 or Bit32 since the pixels aren't known yet. With
+	// Bit24 the alpha of the supplied pixels is ignored.
+	bool Begin
+	(
+		const tString& pngFile, int width, int height, tFilePNG::tFormat,
+		tFilePNG::tLevel = tFilePNG::tLevel::Default
+	);
+
+	// The row must have width pixels. Returns false if the file could not be written or all rows were already written.
+	bool WriteRow(const tPixel* row);
+
+	// Finishes the stream and closes the file. Returns false if there was a write error or if fewer than height rows
+	// were written, in which case the file is incomplete.
+	bool End();
+
+	bool IsActive() const																								{ return File ? true : false; }
+	int GetRowsWritten() const																							{ return RowsWritten; }
+
+private:
+	void Close();
+	bool Deflate(const uint8* data, int numBytes, int flush);
+
+	tFileHandle File = nullptr;
+	z_stream_s* Stream = nullptr;
+	int Width = 0;
+	int Height = 0;
+	int Bpp = 4;
+	bool Adaptive = true;
+	int RowsWritten = 0;
+	bool Error = false;
+
+	uint8* Rows = nullptr;								// The current and previous rows as png bytes.
+	uint8* Filtered = nullptr;							// Room for a filtered row per candidate filter.
+	uint8* Output = nullptr;
+	int OutputUsed = 0;
+};
+
+
+}
@@ -0,0 +1,176 @@
+// tFileQOI.h
+//
+// This class is a helper class. It should not be necessary to use this class directly. It knows how to load and save a
+// qoi (Quite OK Image) file natively. Qoi is a lossless format that is encoded and decoded in a single pass, making it
+// a good choice for caches and scratch files where png is too slow to write and an uncompressed tga is too large. Like
+// tFileTGA, the loaded tPixels may be 'stolen' by a tPicture. A row-at-a-time writer and reader are also provided so
+// that images can be streamed without ever holding all the pixels in memory.
+//
+// Copyright (c) 2019 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#pragma once
+#include <Foundation/tString.h>
+#include <Math/tColour.h>
+#include <System/tFile.h>
+#include "Image/tPictureView.h"
+namespace tImage
+{
+
+
+// Writes a qoi file one row at a time. Rows are supplied in file order, which is the top row first. Only the 64 entry
+// colour index and a small output buffer are kept, so the whole image never needs to be in memory at once.
+class tQOIWriter
+{
+public:
+	tQOIWriter()																										{ }
+	virtual ~tQOIWriter()																								{ Close(); }
+
+	// Creates the file and writes the header. Channels must be 3 or 4. With 3 channels the alpha of the supplied pixels
+	// is ignored and treated as 255.
+	bool Begin(const tString& qoiFile, int width, int height, int channels);
+
+	// The row must have width pixels. Returns false if the file could not be written or all rows were already written.
+	bool WriteRow(const tPixel* row);
+
+	// Writes the end marker and closes the file. Returns false if there was a write error or if fewer than height rows
+	// were written, in which case the file is incomplete.
+	bool End();
+
+	bool IsActive() const																								{ return File ? true : false; }
+	int GetRowsWritten() const																							{ return RowsWritten; }
+
+private:
+	void Close();
+	bool Flush();
+
+	tFileHandle File = nullptr;
+	int Width = 0;
+	int Height = 0;
+	int Channels = 4;
+	int RowsWritten = 0;
+	bool Error = false;
+
+	tPixel Index[64];
+	tPixel Prev;
+	int Run = 0;
+
+	uint8* Buffer = nullptr;
+	int BufferUsed = 0;
+};
+
+
+// Reads a qoi file one row at a time in file order, top row first. When reading from a file the compressed data is
+// also streamed through a small buffer.
+class tQOIReader
+{
+public:
+	tQOIReader()																										{ }
+	virtual ~tQOIReader()																								{ End(); }
+
+	// Reads and validates the header. Returns false and leaves the reader inactive if the file is not a valid qoi.
+	bool Begin(const tString& qoiFile);
+
+	// The data is not copied so it must stay valid until End is called.
+	bool Begin(const uint8* qoiFileInMemory, int numBytes);
+
+	// Decodes the next row into dest, which must have room for GetWidth pixels. Returns false if the data is corrupt,
+	// truncated, or all rows have already been read.
+	bool ReadRow(tPixel* dest);
+	void End();
+
+	bool IsActive() const																								{ return Data ? true : false; }
+	int GetWidth() const																								{ return Width; }
+	int GetHeight() const																								{ return Height; }
+	int GetChannels() const																								{ return Channels; }
+	int GetRowsRead() const																								{ return RowsRead; }
+
+private:
+	bool ReadHeader();
+
+	// Makes sure at least numBytes bytes are available at DataPos if the source has them.
+	bool Available(int numBytes);
+
+	tFileHandle File = nullptr;
+	uint8* Buffer = nullptr;
+	const uint8* Data = nullptr;
+	int DataSize = 0;
+	int DataPos = 0;
+
+	int Width = 0;
+	int Height = 0;
+	int Channels = 4;
+	int RowsRead = 0;
+
+	tPixel Index[64];
+	tPixel Prev;
+	int Run = 0;
+};
+
+
+class tFileQOI
+{
+public:
+	// Creates an invalid tFileQOI. You must call Load manually.
+	tFileQOI()																											{ }
+	tFileQOI(const tString& qoiFile)																					{ Load(qoiFile); }
+
+	// The data is copied out of qoiFileInMemory. Go ahead and delete after if you want.
+	tFileQOI(const uint8* qoiFileInMemory, int numBytes)																{ Set(qoiFileInMemory, numBytes); }
+
+	// This one sets from a supplied pixel array. If steal is true it takes ownership of the pixels pointer, which must
+	// have been allocated with tPicture::AllocPixels. Otherwise it just copies the data out.
+	tFileQOI(tPixel* pixels, int width, int height, bool steal = false)													{ Set(pixels, width, height, steal); }
+
+	virtual ~tFileQOI()																									{ Clear(); }
+
+	// Clears the current tFileQOI before loading. Returns success. If false returned, object is invalid.
+	bool Load(const tString& qoiFile);
+	bool Set(const uint8* qoiFileInMemory, int numBytes);
+	bool Set(tPixel* pixels, int width, int height, bool steal = false);
+
+	enum class tFormat
+	{
+		Invalid,										// Invalid must be 0.
+		Auto,											// Save function will decide format. Bit24 if all image pixels are opaque and Bit32 otherwise.
+		Bit24,											// 24 bit colour.
+		Bit32											// 24 bit colour with 8 bits opacity in the alpha channel.
+	};
+
+	// Saves to the qoi file specified. The extension must be ".qoi". Returns the format that the file was saved in, or
+	// tFormat::Invalid if there was a problem.
+	tFormat Save(const tString& qoiFile, tFormat = tFormat::Auto) const;
+
+	// Saves the pixels of a view directly. Rows are written straight from the view so no copy is made.
+	static tFormat Save(const tString& qoiFile, const tPictureView&, tFormat = tFormat::Auto);
+
+	// After this call no memory will be consumed by the object and it will be invalid.
+	void Clear();
+	bool IsValid() const																								{ return Pixels ? true : false; }
+
+	int GetWidth() const																								{ return Width; }
+	int GetHeight() const																								{ return Height; }
+
+	// After this call you are the owner of the pixels and must eventually free them with tPicture::FreePixels. This
+	// tFileQOI object is invalid afterwards.
+	tPixel* StealPixels();
+	tPixel* GetPixels() const																							{ return Pixels; }
+	int SrcFileBitDepth = 32;
+
+private:
+	bool Read(tQOIReader&);
+
+	int Width = 0;
+	int Height = 0;
+	tPixel* Pixels = nullptr;
+};
+
+
+}
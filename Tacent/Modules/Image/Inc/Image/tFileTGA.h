@@ -4,7 +4,8 @@
 // targa (.tga) file. It does zero processing of image data. It knows the details of the tga file format and loads the
 // data into a tPixel array. These tPixels may be 'stolen' by the tPicture's constructor if a targa file is specified.
 // After the array is stolen the tFileTGA is invalid. This is purely for performance. The tPicture class uses the
-// CxImage library for image files that are not targas.
+// CxImage library for image files that are not targas. A row-at-a-time writer and reader are also provided so that
+// targas can be streamed without ever holding all the pixels in memory.
 //
 // Copyright (c) 2006, 2017, 2019 Tristan Grimmer.
 // Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
@@ -19,6 +20,7 @@
 #pragma once
 #include <Foundation/tString.h>
 #include <Math/tColour.h>
+#include <System/tFile.h>
 namespace tImage
 {
 
@@ -33,8 +35,8 @@ public:
 	// The data is copied out of tgaFileInMemory. Go ahead and delete after if you want.
 	tFileTGA(const uint8* tgaFileInMemory, int numBytes)																{ Set(tgaFileInMemory, numBytes); }
 
-	// This one sets from a supplied pixel array. If steal is true it takes ownership of the pixels pointer. Otherwise
-	// it just copies the data out.
+	// This one sets from a supplied pixel array. If steal is true it takes ownership of the pixels pointer, which must
+	// have been allocated with tPicture::AllocPixels. Otherwise it just copies the data out.
 	tFileTGA(tPixel* pixels, int width, int height, bool steal = false)													{ Set(pixels, width, height, steal); }
 
 	virtual ~tFileTGA()																									{ Clear(); }
@@ -45,8 +47,8 @@ public:
 	bool Load(const tString& tgaFile);
 	bool Set(const uint8* tgaFileInMemory, int numBytes);
 
-	// This one sets from a supplied pixel array. If steal is true it takes ownership of the pixels pointer. Otherwise
-	// it just copies the data out.
+	// This one sets from a supplied pixel array. If steal is true it takes ownership of the pixels pointer, which must
+	// have been allocated with tPicture::AllocPixels. Otherwise it just copies the data out.
 	bool Set(tPixel* pixels, int width, int height, bool steal = false);
 
 	enum class tFormat
@@ -77,8 +79,8 @@ public:
 	// All pixels must be opaque (alpha = 1) for this to return true.
 	bool IsOpaque() const;
 
-	// After this call you are the owner of the pixels and must eventually delete[] them. This tFileTGA object is
-	// invalid afterwards.
+	// After this call you are the owner of the pixels and must eventually free them with tPicture::FreePixels. They
+	// may also be handed straight to a tPicture. This tFileTGA object is invalid afterwards.
 	tPixel* StealPixels();
 	tPixel* GetPixels() const																							{ return Pixels; }
 	int SrcFileBitDepth = 32;
@@ -86,7 +88,6 @@ public:
 private:
 	bool SaveUncompressed(const tString& tgaFile, tFormat) const;
 	bool SaveCompressed(const tString& tgaFile, tFormat) const;
-	void ReadColourBytes(tColouri& dest, const uint8* src, int bitDepth);
 
 	// So this is a neat C++11 feature. Allows simplified constructors.
 	int Width = 0;
@@ -95,16 +96,108 @@ private:
 };
 
 
-// Implementation blow this line.
+// Writes a targa one row at a time. Rows are supplied top row first and the file is marked as having a top-left origin
+// so they can be written in the order they arrive. With RLE compression packets never cross rows.
+class tTGAWriter
+{
+public:
+	tTGAWriter()																										{ }
+	virtual ~tTGAWriter()																								{ Close(); }
+
+	// Creates the file and writes the header. The format must be Bit24 or Bit32 since the pixels aren't known yet. With
+	// Bit24 the alpha of the supplied pixels is ignored. Targas can't be more than 65535 pixels on a side.
+	bool Begin
+	(
+		const tString& tgaFile, int width, int height, tFileTGA::tFormat,
+		tFileTGA::tCompression = tFileTGA::tCompression::RLE
+	);
+
+	// The row must have width pixels. Returns false if the file could not be written or all rows were already written.
+	bool WriteRow(const tPixel* row);
 
+	// Closes the file. Returns false if there was a write error or if fewer than height rows were written, in which
+	// case the file is incomplete.
+	bool End();
 
-inline void tFileTGA::Clear()
+	bool IsActive() const																								{ return File ? true : false; }
+	int GetRowsWritten() const																							{ return RowsWritten; }
+
+private:
+	void Close();
+	bool Flush();
+	void WriteColour(const tPixel&);
+
+	tFileHandle File = nullptr;
+	int Width = 0;
+	int Height = 0;
+	int BytesPerPixel = 4;
+	bool RLE = true;
+	int RowsWritten = 0;
+	bool Error = false;
+
+	uint8* Buffer = nullptr;
+	int BufferUsed = 0;
+};
+
+
+// Reads a targa one row at a time, top row first, whatever the row order in the file. The same files as tFileTGA are
+// supported. Files stored bottom row first are read by seeking back through the file. For RLE files that means the
+// packets are scanned once by Begin to find where each row starts.
+class tTGAReader
 {
-	Width = 0;
-	Height = 0;
-	delete[] Pixels;
-	Pixels = nullptr;
-}
+public:
+	tTGAReader()																										{ }
+	virtual ~tTGAReader()																								{ End(); }
+
+	// Reads and validates the header. Returns false and leaves the reader inactive if the file is not a supported tga.
+	bool Begin(const tString& tgaFile);
+
+	// Decodes the next row into dest, which must have room for GetWidth pixels. Returns false if the data is truncated
+	// or all rows have already been read.
+	bool ReadRow(tPixel* dest);
+	void End();
+
+	bool IsActive() const																								{ return File ? true : false; }
+	int GetWidth() const																								{ return Width; }
+	int GetHeight() const																								{ return Height; }
+	int GetBitDepth() const																								{ return BitDepth; }
+	int GetRowsRead() const																								{ return RowsRead; }
+
+private:
+	// Makes sure at least numBytes bytes are available at BufferPos if the file has them.
+	bool Available(int numBytes);
+
+	// Moves the read position to the offset, which is from the start of the file.
+	bool Seek(int64 offset);
+	bool BuildRowIndex();
+
+	// Decodes pixels from the read position, continuing any RLE packet that is part way through.
+	bool ReadPixels(tPixel* dest, int numPixels);
+	bool StartPacket();
+
+	tFileHandle File = nullptr;
+	uint8* Buffer = nullptr;
+	int64 BufferOffset = 0;								// Where in the file the buffer starts.
+	int BufferSize = 0;
+	int BufferPos = 0;
+
+	int Width = 0;
+	int Height = 0;
+	int BitDepth = 0;
+	bool Compressed = false;
+	bool TopDown = false;
+	int64 DataOffset = 0;
+	int RowsRead = 0;
+
+	bool PacketRun = false;
+	int PacketLeft = 0;
+	tPixel RunColour;
+
+	// Only for bottom-up RLE files. Where the packet holding the first pixel of each row is, and how many of the
+	// packet's pixels belong to the rows before. Indexed by the row's position in the file.
+	int64* RowOffsets = nullptr;
+	int* RowSkips = nullptr;
+};
 
 
 }
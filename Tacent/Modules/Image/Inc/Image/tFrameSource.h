@@ -0,0 +1,147 @@
+// tFrameSource.h
+//
+// A tFrameSource provides the frames of animated GIFs and multi-page images one at a time, decoding them on demand
+// rather than all up front. Animated GIFs are decoded natively so that frame disposal and compositing are correct and
+// so that playing forward only ever decodes one frame per step. A bounded ring of recently decoded frames and periodic
+// keyframe snapshots keep memory use fixed no matter how many frames the file has, while still allowing reasonably
+// fast seeking.
+//
+// Copyright (c) 2019 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#pragma once
+#include <Foundation/tString.h>
+#include <Math/tColour.h>
+#include <System/tFile.h>
+#include "Image/tPicture.h"
+namespace tImage
+{
+
+
+// Opening a GIF only indexes the frames, which is fast since no image data is decompressed. Durations are therefore
+// available immediately. Multi-page files other than GIFs (TIFFs) are loaded a page at a time through tPicture. Pages
+// are independent so no compositing or keyframes are needed for them. Any other loadable image is a single frame.
+// This class is not thread-safe. Frames use the same lower-left origin as tPicture.
+class tFrameSource
+{
+public:
+	const static int DefaultRingSize = 8;
+	const static int DefaultKeyframeInterval = 32;
+
+	// The keyframe interval is increased if needed so there are never more than this many keyframes.
+	const static int MaxKeyframes = 32;
+
+	// Used for frames that don't specify a duration. Also used for GIF delays below 2/100ths of a second, which is
+	// what browsers do since many GIFs rely on it.
+	const static float DefaultFrameDuration;
+
+	tFrameSource()																										{ }
+	tFrameSource(const tString& imageFile, int ringSize = DefaultRingSize, int keyframeInterval = DefaultKeyframeInterval)	{ Open(imageFile, ringSize, keyframeInterval); }
+	virtual ~tFrameSource()																								{ Close(); }
+
+	// Returns false and leaves the source invalid if the file can't be opened or has no frames. The ring size is the
+	// number of decoded frames kept and must be at least 1.
+	bool Open(const tString& imageFile, int ringSize = DefaultRingSize, int keyframeInterval = DefaultKeyframeInterval);
+
+	// Opens a GIF that is already in memory. The data is copied.
+	bool Open(const uint8* gifData, int numBytes, int ringSize = DefaultRingSize, int keyframeInterval = DefaultKeyframeInterval);
+
+	void Close();
+	bool IsValid() const																								{ return NumFrames > 0; }
+
+	int GetNumFrames() const																							{ return NumFrames; }
+	int GetWidth() const																								{ return Width; }
+	int GetHeight() const																								{ return Height; }
+
+	// Durations are in seconds.
+	float GetFrameDuration(int frame) const																				{ return ValidFrame(frame) ? Frames[frame].Duration : 0.0f; }
+	float GetTotalDuration() const																						{ return TotalDuration; }
+
+	// Returns the fully composited frame. The returned picture is owned by the frame source and is only valid until
+	// the next call to GetFrame or Close. Returns nullptr if the frame is out of range or can't be decoded.
+	const tPicture* GetFrame(int frame);
+
+	// Approximate bytes used by decoded frames, keyframes and the compressed file data.
+	int64 GetMemoryUsage() const;
+
+	// Total number of frames that have been decoded. Useful for checking that playback decodes once per frame.
+	int GetNumDecodes() const																							{ return NumDecodes; }
+
+private:
+	enum class tSourceType
+	{
+		None,
+		GIF,
+		Pages
+	};
+
+	// Everything needed to decode one GIF frame. Offsets are into FileData.
+	struct FrameInfo
+	{
+		int Left;
+		int Top;
+		int Width;
+		int Height;
+		bool Interlaced;
+		int TransparentIndex;							// -1 if none.
+		int Disposal;									// 0 or 1 leave, 2 clear to transparent, 3 restore previous.
+		int PaletteOffset;								// -1 to use the global palette.
+		int PaletteSize;
+		int DataOffset;									// The LZW minimum code size byte.
+		float Duration;
+	};
+
+	struct CachedFrame
+	{
+		int Frame = -1;
+		tPicture Picture;
+	};
+
+	bool ValidFrame(int frame) const																					{ return (frame >= 0) && (frame < NumFrames); }
+	bool IndexGIF();
+	void Init(int ringSize, int keyframeInterval);
+	tPicture* GetRingSlot(int frame);
+	bool DecodeGIFFrame(int frame, tPicture& canvas);
+	bool DecompressGIFFrame(const FrameInfo&, uint8* indices);
+
+	tSourceType SourceType = tSourceType::None;
+	tString Filename;
+	uint8* FileData = nullptr;
+	int FileSize = 0;
+
+	int Width = 0;
+	int Height = 0;
+	int NumFrames = 0;
+	float TotalDuration = 0.0f;
+	FrameInfo* Frames = nullptr;
+	int GlobalPaletteOffset = -1;
+	int GlobalPaletteSize = 0;
+
+	// Most recently decoded frames. RingNext is the slot that will be replaced next.
+	CachedFrame* Ring = nullptr;
+	int RingSize = 0;
+	int RingNext = 0;
+
+	// Keyframe k holds the canvas that frame k*KeyframeInterval is drawn on top of. Invalid until that frame has been
+	// reached at least once.
+	tPicture* Keyframes = nullptr;
+	int NumKeyframes = 0;
+	int KeyframeInterval = DefaultKeyframeInterval;
+
+	// The canvas that frame CanvasFrame will be drawn on top of. Decoding forward continues from here.
+	tPicture Canvas;
+	int CanvasFrame = -1;
+	uint8* Indices = nullptr;
+
+	int NumDecodes = 0;
+};
+
+
+}
@@ -0,0 +1,69 @@
+// tImageProbe.h
+//
+// Reads the metadata of an image file without decoding it. Only the start of the file is read and the format is
+// identified by its magic bytes, not its extension. Supports tga, png, jpg, bmp, gif, qoi, and dds files, including dds
+// files with the DX10 extended header. This is much faster than loading when all that's needed are the dimensions,
+// pixel format, bit depth, mipmap count, or frame count of a lot of files.
+//
+// Copyright (c) 2020 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#pragma once
+#include <Foundation/tString.h>
+#include <System/tFile.h>
+#include "Image/tPixelFormat.h"
+namespace tImage
+{
+
+
+struct tImageInfo
+{
+	bool IsValid() const																								{ return (FileType != tSystem::tFileType::Unknown) && (Width > 0) && (Height > 0); }
+
+	tSystem::tFileType FileType = tSystem::tFileType::Unknown;
+	int Width = 0;
+	int Height = 0;
+
+	// For dds files this is the format of the data in the file. Other files are decoded into tPictures, so this is
+	// R8G8B8 if the file has no alpha and R8G8B8A8 if it does.
+	tPixelFormat PixelFormat = tPixelFormat::Invalid;
+	int BitDepth = 0;									// Bits per pixel as stored in the file.
+	int NumMipmaps = 1;
+	int NumFrames = 1;									// Zero if unknown. See tProbeImage.
+	bool Cubemap = false;
+
+	// Taken from the header only. A file that can store alpha is considered not opaque even if all its alphas are
+	// full. The exception is BC1 in a dds file, which is assumed opaque since finding binary alpha means reading the
+	// blocks.
+	bool Opaque = true;
+};
+
+
+// Returns the type of image in the supplied data by looking at its magic bytes. Targa files have no magic, so they
+// are only recognized if nothing else matched and the header is one we would load. Returns Unknown if the type
+// isn't one the probe supports.
+tSystem::tFileType tIdentifyImage(const uint8* data, int numBytes);
+
+// Fills in the info from the start of a file already in memory. Returns false if the type isn't recognized or the
+// data ends before the needed header fields. In the second case, if needMore is supplied, it is set to true and
+// the probe may be tried again with more of the file. Most formats only need a couple of hundred bytes but the
+// start of frame in a jpg can come after large exif blocks. The number of frames in a gif can only be found by
+// walking the whole file, so NumFrames is 1 if data holds all of a single frame gif, the frame count if it holds
+// all of an animated one, and 0 (unknown) otherwise. For animated pngs the frame count comes from the header.
+bool tProbeImage(tImageInfo&, const uint8* data, int numBytes, bool* needMore = nullptr);
+
+// Probes a file reading only the first ProbeHeadSize bytes, unless the header runs past that. Returns false if the
+// file can't be read or isn't a supported type. If countGIFFrames is true, gifs are read entirely so their frames
+// can be counted.
+const int ProbeHeadSize = 4096;
+bool tProbeImage(tImageInfo&, const tString& imageFile, bool countGIFFrames = false);
+
+
+}
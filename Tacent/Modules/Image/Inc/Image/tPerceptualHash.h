@@ -0,0 +1,149 @@
+// tPerceptualHash.h
+//
+// Perceptual hashes of images and a Hamming-distance index for finding near-duplicates. Unlike a cryptographic hash,
+// images that look alike get hashes that differ in only a few bits, so re-saved, slightly cropped, rescaled or
+// re-encoded copies of the same image can be found by searching for hashes within a small Hamming distance.
+//
+// Copyright (c) 2019 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#pragma once
+#include <Foundation/tList.h>
+#include <Foundation/tArray.h>
+#include <Foundation/tString.h>
+#include <Math/tColour.h>
+#include <System/tChunk.h>
+#include "Image/tPicture.h"
+namespace tImage
+{
+
+
+// Both hashes are 64 bits and are computed from the luminance of an area-averaged downsample of the picture. Alpha is
+// ignored. The dHash compares horizontally adjacent cells of a 9x8 grid and is very cheap. The pHash thresholds the
+// low frequency 8x8 DCT coefficients (excluding the DC row and column) of a 32x32 grid against their median, and is
+// more robust to gamma, contrast and compression changes.
+struct tPerceptualHash
+{
+	enum class tKind
+	{
+		DHash,
+		PHash
+	};
+
+	tPerceptualHash()																									{ }
+	tPerceptualHash(const tPicture& picture)																			{ Set(picture); }
+
+	// Returns false and leaves the hash invalid if the picture is invalid.
+	bool Set(const tPicture&);
+	bool Set(const tPictureView&);
+	bool Set(const tPixel* pixels, int width, int height)																{ return Set(tPictureView(pixels, width, height)); }
+	void Clear()																										{ DHash = 0; PHash = 0; Valid = false; }
+	bool IsValid() const																								{ return Valid; }
+	uint64 Get(tKind kind) const																						{ return (kind == tKind::DHash) ? DHash : PHash; }
+
+	// Hashes are normally stored with the other cached per-file data.
+	void Save(tChunkWriter&) const;
+	void Load(const tChunk&);
+
+	uint64 DHash = 0;
+	uint64 PHash = 0;
+	bool Valid = false;
+};
+
+
+// Returns the number of differing bits. In [0, 64].
+int tHammingDistance(uint64 a, uint64 b);
+
+// Similarity in [0, 1] from a Hamming distance. 1 means the hashes are identical.
+inline float tHashSimilarity(int distance)																				{ return 1.0f - float(distance) / 64.0f; }
+
+
+// A single image in a near-duplicate cluster. Distance and Similarity are relative to the first member of the cluster.
+struct tDuplicate : public tLink<tDuplicate>
+{
+	tDuplicate(int id, int distance, const tString& filename = tString())												: ID(id), Distance(distance), Similarity(tHashSimilarity(distance)), Filename(filename) { }
+	int ID;
+	int Distance;
+	float Similarity;
+	tString Filename;									// Only set by tFindDuplicates.
+};
+
+
+struct tDuplicateCluster : public tLink<tDuplicateCluster>
+{
+	tList<tDuplicate> Members;							// Always at least 2. The first is the representative.
+	float MinSimilarity = 1.0f;							// Of any member against the representative.
+};
+
+
+// A multi-index hash table over 64-bit hashes using the Hamming metric. Each hash is split into four 16-bit blocks and
+// every block gets its own bucketed table. If two hashes are within distance r then, by the pigeonhole principle, at
+// least one of their blocks is within r/4, so a search only has to probe buckets near each query block instead of the
+// whole set. Unlike a BK-tree this stays fast for the large radii near-duplicate search needs. The tables are rebuilt
+// lazily on the first search after adding hashes. This class is not thread-safe. IDs are supplied by the caller and are
+// typically indexes into their own list of files.
+class tHashIndex
+{
+public:
+	tHashIndex()																										: Entries(0, 4096) { }
+	virtual ~tHashIndex()																								{ ClearTables(); }
+
+	void Clear()																										{ Entries.Clear(0); ClearTables(); }
+	int GetNumHashes() const																							{ return Entries.GetNumElements(); }
+	void Add(uint64 hash, int id)																						{ Entries.Append(Entry{hash, id}); TablesDirty = true; }
+
+	// Appends the IDs of all hashes within maxDistance of the supplied hash to foundIDs. Returns the number found.
+	int Find(tArray<int>& foundIDs, uint64 hash, int maxDistance) const;
+
+	// Groups all hashes into clusters where every member is connected to another member by a chain of hashes each
+	// within maxDistance. Only clusters with two or more members are appended. Returns the number of clusters appended.
+	// The searches are spread over numThreads threads. If numThreads <= 0 one thread per core is used.
+	int FindClusters(tList<tDuplicateCluster>& clusters, int maxDistance, int numThreads = -1) const;
+
+private:
+	const static int NumBlocks = 4;
+	const static int BlockBits = 16;
+	const static int NumBuckets = 1 << BlockBits;
+
+	struct Entry
+	{
+		uint64 Hash;
+		int ID;
+	};
+
+	static int GetBlock(uint64 hash, int block)																			{ return int((hash >> (block*BlockBits)) & (NumBuckets-1)); }
+	void BuildTables() const;
+	void ClearTables() const;
+
+	// Appends the entry indexes of all hashes within maxDistance. The neighbours buffer must hold NumBuckets ints.
+	void Search(tArray<int>& foundEntries, uint64 hash, int maxDistance, int* neighbours) const;
+
+	tArray<Entry> Entries;
+
+	// For each block, the entry indexes of bucket b are BucketEntries[BucketStarts[b], BucketStarts[b+1]). The hashes
+	// are duplicated in the same order in BucketHashes so probing a bucket reads contiguous memory.
+	mutable bool TablesDirty = false;
+	mutable int* BucketStarts[NumBlocks] = { nullptr, nullptr, nullptr, nullptr };
+	mutable int* BucketEntries[NumBlocks] = { nullptr, nullptr, nullptr, nullptr };
+	mutable uint64* BucketHashes[NumBlocks] = { nullptr, nullptr, nullptr, nullptr };
+};
+
+
+// Headless near-duplicate search over a set of image files. The files are loaded and hashed on multiple threads and
+// clustered with the given kind of hash. Files that can't be loaded are skipped. Member IDs are indexes into the files
+// list. Returns the number of clusters appended.
+int tFindDuplicates
+(
+	tList<tDuplicateCluster>& clusters, const tList<tStringItem>& files,
+	int maxDistance = 10, tPerceptualHash::tKind = tPerceptualHash::tKind::PHash, int numThreads = -1
+);
+
+
+}
@@ -17,18 +17,24 @@
 // PERFORMANCE OF THIS SOFTWARE.
 
 #pragma once
+#include <utility>
 #include <Foundation/tList.h>
+#include <Foundation/tMemory.h>
 #include <Math/tColour.h>
 #include <System/tFile.h>
 #include <System/tChunk.h>
 #include "Image/tFileTGA.h"
+#include "Image/tFilePNG.h"
+#include "Image/tFileQOI.h"
+#include "Image/tPictureView.h"
 namespace tImage
 {
 
 
 // A tPicture is a single 2D image. A rectangular collection of RGBA pixels (32bits per pixel). The origin is the lower
 // left, and the rows are ordered from bottom to top in memory. This matches the expectation of OpenGL texture
-// manipulation functions for the most part (there are cases when it is inconsistent with itself).
+// manipulation functions for the most part (there are cases when it is inconsistent with itself). The pixel buffer is
+// always PixelAlignment byte aligned so SIMD kernels can use aligned loads on the first pixel of a picture.
 class tPicture : public tLink<tPicture>
 {
 public:
@@ -41,7 +47,8 @@ public:
 
 	// This constructor allows you to specify an external buffer of pixels to use. If copyPixels is true, it simply
 	// copies the values from the buffer you supply. If copyPixels is false, it means you are giving the buffer to the
-	// tPicture. In this case the tPicture will delete[] the buffer for you when appropriate.
+	// tPicture. In this case the buffer must have been allocated with AllocPixels and the tPicture will free it for you
+	// when appropriate.
 	tPicture(int width, int height, tPixel* pixelBuffer, bool copyPixels = true)										{ Set(width, height, pixelBuffer, copyPixels); }
 
 	// Loads the supplied image file. If the image couldn't be loaded, IsValid will return false afterwards. Uses the
@@ -53,6 +60,12 @@ public:
 	// Copy constructor.
 	tPicture(const tPicture& src)																						: tPicture() { Set(src); }
 
+	// Move constructor. The pixel buffer is transferred rather than copied and src is left invalid.
+	tPicture(tPicture&& src)																							: tPicture() { Set(std::move(src)); }
+
+	// Copies the pixels out of a view into a new buffer. This is how to get a cropped tPicture from a view.
+	explicit tPicture(const tPictureView& view)																			: tPicture() { Set(view); }
+
 	virtual ~tPicture()																									{ Clear(); }
 	bool IsValid() const																								{ return Pixels ? true : false; }
 
@@ -66,11 +79,37 @@ public:
 	// Sets the image to the dimensions provided. Allows you to specify an external buffer of pixels to use. If
 	// copyPixels is true, it simply copies the values from the buffer you supply. In this case it will attempt to
 	// reuse it's existing buffer if it can. If copyPixels is false, it means you are giving the buffer to the
-	// tPicture. In this case the tPicture will delete[] the buffer for you when appropriate. In all cases, existing
-	// pixel data is lost.
+	// tPicture. In this case the buffer must come from AllocPixels and the tPicture will free it for you when
+	// appropriate. In all cases, existing pixel data is lost.
 	void Set(int width, int height, tPixel* pixelBuffer, bool copyPixels = true);
 	void Set(const tPicture& src)																						{ if (src.Pixels) { Set(src.Width, src.Height, src.Pixels); Filename = src.Filename; } }
 
+	// Takes the pixels of src without copying them. The current pixels are freed and src is left invalid.
+	void Set(tPicture&& src);
+
+	// Copies the pixels of the view. The view may refer to this picture's own pixels, so pic.Set(pic.GetView(...))
+	// crops in a single copy. If the view is invalid the picture is cleared.
+	void Set(const tPictureView&);
+
+	tPicture& operator=(const tPicture& src)																			{ if (&src != this) { if (src.Pixels) Set(src); else Clear(); } return *this; }
+	tPicture& operator=(tPicture&& src)																					{ Set(std::move(src)); return *this; }
+
+	// Gives up ownership of the pixel buffer and returns it. The tPicture is invalid afterwards. You must eventually
+	// call FreePixels on the returned buffer. Useful for handing pixels to something else without a copy.
+	tPixel* StealPixels();
+
+	// All pixel buffers owned by a tPicture are allocated and freed with these. The returned memory is uninitialized.
+	// Like new, AllocPixels throws std::bad_alloc if the memory can't be had. It never returns a short buffer.
+	const static int PixelAlignment = 64;
+	static tPixel* AllocPixels(int numPixels);
+	static void FreePixels(tPixel* pixels)																				{ if (pixels) tMem::tFree(pixels); }
+
+	// Non-owning views of the pixels. The views are only valid until the picture is next modified in a way that
+	// reallocates the pixels, such as Set, Crop, Rotate90, Resample or Load. A sub-rectangle view is clipped to the
+	// picture. Pass a view to the read-only operations instead of cropping a copy.
+	tPictureView GetView() const																						{ return tPictureView(Pixels, Width, Height); }
+	tPictureView GetView(int x, int y, int width, int height) const														{ return GetView().GetSubView(x, y, width, height); }
+
 	// Can this class save the the filetype supplied?
 	static bool CanSave(const tString& imageFile);
 	static bool CanSave(tSystem::tFileType);
@@ -87,9 +126,10 @@ public:
 		ColourAndAlpha
 	};
 
-	// Saves to the image file you specify and examines the extension to determine filetype. Supports tga, png, bmp, jpg,
-	// and gif. If tColourFormat is set to auto, the opacity/alpha channel will be excluded if all pixels are opaque.
-	// Alpha channels are not supported for gif and jpg files.
+	// Saves to the image file you specify and examines the extension to determine filetype. Supports tga, png, qoi, bmp,
+	// jpg, and gif. If tColourFormat is set to auto, the opacity/alpha channel will be excluded if all pixels are opaque.
+	// Alpha channels are not supported for gif and jpg files. Tga, png and qoi files are written natively. Png files are
+	// saved with the default level.
 	bool Save(const tString& imageFile, tColourFormat = tColourFormat::Auto);
 
 	bool SaveTGA
@@ -98,8 +138,21 @@ public:
 		tFileTGA::tCompression = tFileTGA::tCompression::RLE
 	) const;
 
-	// Always clears the current image before loading. If false returned, you will have an invalid tPicture.
-	bool Load(const tString& imageFile);
+	// Writes a png directly from the pixels. Blocks of rows are compressed on numThreads threads. If numThreads <= 0
+	// one thread per core is used.
+	bool SavePNG
+	(
+		const tString& pngFile, tFilePNG::tFormat = tFilePNG::tFormat::Auto,
+		tFilePNG::tLevel = tFilePNG::tLevel::Default, int numThreads = -1
+	) const;
+
+	// Writes a qoi directly from the pixels. Much faster than png and still lossless, though the files are larger.
+	bool SaveQOI(const tString& qoiFile, tFileQOI::tFormat = tFileQOI::tFormat::Auto) const;
+
+	// Always clears the current image before loading. If false returned, you will have an invalid tPicture. For
+	// multi-page files like TIFFs the frame number chooses the page. Frames of animated GIFs are not composited here,
+	// use a tFrameSource for those. Jpgs are turned upright according to their exif orientation.
+	bool Load(const tString& imageFile, int frameNumber = 0);
 
 	// Save and Load to tChunk format.
 	void Save(tChunkWriter&) const;
@@ -109,11 +162,19 @@ public:
 	// buffer every time it is called.
 	bool IsOpaque() const;
 
+	// Saves the pixels of a view without first copying them into a tPicture.
+	static bool SaveTGA
+	(
+		const tString& tgaFile, const tPictureView&, tFileTGA::tFormat = tFileTGA::tFormat::Auto,
+		tFileTGA::tCompression = tFileTGA::tCompression::RLE
+	);
+
 	// These functions allow reading and writing pixels.
 	tPixel& Pixel(int x, int y)																							{ return Pixels[ GetIndex(x, y) ]; }
 	tPixel* operator[](int i)						/* Syntax: image[y][x] = colour;  No bounds checking performed. */	{ return Pixels + GetIndex(0, i); }
 	tPixel GetPixel(int x, int y) const																					{ return Pixels[ GetIndex(x, y) ]; }
 	tPixel* GetPixelPointer(int x = 0, int y = 0)																		{ return &Pixels[ GetIndex(x, y) ]; }
+	const tPixel* GetPixels() const																						{ return Pixels; }
 
 	void SetPixel(int x, int y, const tColouri& c)																		{ Pixels[ GetIndex(x, y) ] = c; }
 	void SetPixel(int x, int y, uint8 r, uint8 g, uint8 b, uint8 a = 0xFF)												{ Pixels[ GetIndex(x, y) ] = tColouri(r, g, b, a); }
@@ -170,9 +231,14 @@ public:
 
 	tString Filename;
 	int SrcFileBitDepth = 32;
+	int SrcFileNumFrames = 1;							// Set by Load. Multi-page and animated files may have more than 1.
 
 private:
 	static int GetCxFormat(tSystem::tFileType);
+
+	// Turns a freshly loaded jpg upright according to its exif orientation tag.
+	void ApplyOrientation(const tString& jpgFile);
+
 	int GetIndex(int x, int y) const																					{ tAssert((x >= 0) && (y >= 0) && (x < Width) && (y < Height)); return y * Width + x; }
 	static int GetIndex(int x, int y, int w, int h)																		{ tAssert((x >= 0) && (y >= 0) && (x < w) && (y < h)); return y * w + x; }
 
@@ -188,13 +254,40 @@ private:
 inline void tPicture::Clear()
 {
 	Filename.Clear();
-	delete[] Pixels;
+	FreePixels(Pixels);
 	Pixels = nullptr;
 	Width = 0;
 	Height = 0;
 }
 
 
+inline void tPicture::Set(tPicture&& src)
+{
+	if (&src == this)
+		return;
+
+	Clear();
+	Filename = src.Filename;
+	SrcFileBitDepth = src.SrcFileBitDepth;
+	SrcFileNumFrames = src.SrcFileNumFrames;
+	Width = src.Width;
+	Height = src.Height;
+	Pixels = src.Pixels;
+
+	src.Pixels = nullptr;
+	src.Clear();
+}
+
+
+inline tPixel* tPicture::StealPixels()
+{
+	tPixel* pixels = Pixels;
+	Pixels = nullptr;
+	Clear();
+	return pixels;
+}
+
+
 inline bool tPicture::CanLoad(const tString& imageFile)
 {
 	return CanLoad( tSystem::tGetFileType(imageFile) );
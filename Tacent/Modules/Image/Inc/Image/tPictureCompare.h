@@ -0,0 +1,83 @@
+// tPictureCompare.h
+//
+// Compares two tPictures and computes error metrics between them. Per-channel mean squared error, PSNR, windowed
+// SSIM, maximum absolute error, and the number of differing pixels are all computed. Optionally a heat-map tPicture
+// showing where the differences are is generated. Useful for checking re-encoded or block-compressed images against
+// the originals.
+//
+// Copyright (c) 2019 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#pragma once
+#include <Math/tColour.h>
+#include "Image/tPicture.h"
+namespace tImage
+{
+
+
+// All metrics are computed on 8-bit channel values. The PSNR peak value is 255. SSIM uses 8x8 windows placed every 4
+// pixels with the standard constants C1 = (0.01*255)^2 and C2 = (0.03*255)^2. The 'All' channel is the average over
+// R, G, B and A. Work is split into bands of rows which are processed on multiple threads.
+class tPictureCompare
+{
+public:
+	enum tChannel
+	{
+		tChannel_R,
+		tChannel_G,
+		tChannel_B,
+		tChannel_A,
+		tChannel_All,
+		tChannel_NumChannels
+	};
+
+	// What to do when the two pictures are not the same size.
+	enum class tSizePolicy
+	{
+		Fail,											// Compute fails and returns false.
+		Overlap,										// Only the overlapping region anchored at the lower-left is compared.
+		Resample										// The second picture is resampled (bilinear) to the size of the first.
+	};
+
+	tPictureCompare()																									{ Clear(); }
+	tPictureCompare(const tPicture& a, const tPicture& b, tSizePolicy policy = tSizePolicy::Fail)						{ Compute(a, b, policy); }
+
+	// Compares a and b. If heatMap is non-null it is set to the size of the compared region and each pixel is coloured
+	// from black (no difference) through red and yellow to white based on the largest channel difference multiplied by
+	// heatGain. Returns false if either picture is invalid or the sizes differ and the policy is Fail. Views may be
+	// compared directly, so regions of larger pictures don't need to be cropped into copies first.
+	bool Compute
+	(
+		const tPictureView& a, const tPictureView& b, tSizePolicy = tSizePolicy::Fail,
+		tPicture* heatMap = nullptr, float heatGain = 1.0f, int numThreads = -1
+	);
+	bool Compute
+	(
+		const tPicture& a, const tPicture& b, tSizePolicy = tSizePolicy::Fail,
+		tPicture* heatMap = nullptr, float heatGain = 1.0f, int numThreads = -1
+	);
+
+	void Clear();
+	bool IsValid() const																								{ return NumPixels > 0; }
+	bool IsIdentical() const																							{ return IsValid() && (NumDiffPixels == 0); }
+
+	int Width;
+	int Height;
+	int NumPixels;
+	int NumDiffPixels;									// Pixels where any channel differs.
+
+	double MSE[tChannel_NumChannels];
+	double PSNR[tChannel_NumChannels];					// In dB. Positive infinity if the channel is identical.
+	double SSIM[tChannel_NumChannels];					// In [-1, 1]. 1 means structurally identical.
+	int MaxAbsError[tChannel_NumChannels];
+};
+
+
+}
@@ -0,0 +1,79 @@
+// tPictureStats.h
+//
+// Computes image statistics for a tPicture in a single multithreaded pass over the pixels. This includes per-channel
+// and luminance histograms, min/max/mean/standard-deviation, alpha coverage, and an approximate count of the number of
+// distinct colours.
+//
+// Copyright (c) 2019 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#pragma once
+#include <Math/tColour.h>
+#include "Image/tPicture.h"
+namespace tImage
+{
+
+
+// The statistics are all derived from the histograms, so the only per-pixel work is histogram binning and feeding the
+// distinct colour estimator. Each worker thread bins a contiguous range of pixels into its own histograms which are
+// summed at the end. Luminance uses the Rec. 709 weights.
+class tPictureStats
+{
+public:
+	enum tChannel
+	{
+		tChannel_R,
+		tChannel_G,
+		tChannel_B,
+		tChannel_A,
+		tChannel_L,										// Luminance.
+		tChannel_NumChannels
+	};
+
+	tPictureStats()																										{ Clear(); }
+	tPictureStats(const tPicture& picture, int numThreads = -1)															{ Compute(picture, numThreads); }
+
+	// Computes all the stats. If numThreads <= 0 one thread per core is used. Returns false and leaves the object
+	// invalid if the picture is invalid.
+	bool Compute(const tPicture&, int numThreads = -1);
+	bool Compute(const tPictureView&, int numThreads = -1);
+	bool Compute(const tPixel* pixels, int numPixels, int numThreads = -1)												{ return Compute(tPictureView(pixels, numPixels, 1), numThreads); }
+
+	void Clear();
+	bool IsValid() const																								{ return NumPixels > 0; }
+
+	// Histograms have 256 bins. The value in each bin is the number of pixels with that channel value.
+	const uint32* GetHistogram(tChannel channel) const																	{ return Histograms[channel]; }
+	uint32 GetMaxBinCount(tChannel channel) const																		{ return MaxBinCount[channel]; }
+
+	int NumPixels;
+
+	// Per-channel values are all in [0, 255].
+	int Min[tChannel_NumChannels];
+	int Max[tChannel_NumChannels];
+	float Mean[tChannel_NumChannels];
+	float StdDev[tChannel_NumChannels];
+
+	int NumOpaque;										// Pixels with alpha 255.
+	int NumTransparent;									// Pixels with alpha 0.
+	int NumTranslucent;									// Everything else.
+	float AlphaCoverage;								// Fraction of pixels that are not fully transparent.
+
+	// This is an estimate computed with a HyperLogLog sketch of the 32-bit RGBA values. It is typically within two
+	// percent of the true count and uses a fixed 4KB per thread no matter how many colours there are.
+	int NumDistinctColours;
+
+private:
+	uint32 Histograms[tChannel_NumChannels][256];
+	uint32 MaxBinCount[tChannel_NumChannels];
+};
+
+
+}
@@ -0,0 +1,154 @@
+// tPictureView.h
+//
+// A tPictureView is a non-owning read-only window onto a rectangle of tPixels. It stores a pointer to the first pixel,
+// a width and height, and a row stride. A sub-rectangle of a tPicture can therefore be handed to the read-only
+// operations like stats, comparison, hashing and saving without first copying it into a new buffer the way Crop does.
+//
+// Copyright (c) 2019 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#pragma once
+#include <Foundation/tAssert.h>
+#include <Foundation/tStandard.h>
+#include <Math/tFundamentals.h>
+#include <Math/tColour.h>
+namespace tImage
+{
+
+
+// Views follow the same conventions as tPicture. The origin is the lower-left and row y+1 starts Stride pixels after
+// row y in memory. The stride is in pixels, not bytes, and is never less than the width. A view does not keep the
+// pixels alive. It is only valid while the picture or buffer it refers to is not resized, reloaded or destroyed.
+class tPictureView
+{
+public:
+	// Constructs an invalid view.
+	tPictureView()																										{ }
+
+	// If stride is <= 0 the rows are packed and the stride is the same as the width.
+	tPictureView(const tPixel* pixels, int width, int height, int stride = 0)											{ Set(pixels, width, height, stride); }
+
+	void Set(const tPixel* pixels, int width, int height, int stride = 0);
+	void Clear()																										{ Pixels = nullptr; Width = 0; Height = 0; Stride = 0; }
+	bool IsValid() const																								{ return Pixels ? true : false; }
+
+	int GetWidth() const																								{ return Width; }
+	int GetHeight() const																								{ return Height; }
+	int GetStride() const																								{ return Stride; }
+	int GetNumPixels() const																							{ return Width*Height; }
+
+	// A packed view has no gaps between rows so its pixels may be treated as a single array of GetNumPixels pixels.
+	bool IsPacked() const																								{ return Stride == Width; }
+
+	const tPixel* GetPixels() const																						{ return Pixels; }
+	const tPixel* GetRow(int y) const																					{ tAssert((y >= 0) && (y < Height)); return Pixels + y*Stride; }
+	const tPixel* operator[](int y) const				/* Syntax: view[y][x]  No bounds checking performed. */			{ return Pixels + y*Stride; }
+	tPixel GetPixel(int x, int y) const																					{ tAssert((x >= 0) && (y >= 0) && (x < Width) && (y < Height)); return Pixels[y*Stride + x]; }
+
+	// Returns a view of a sub-rectangle. (x, y) is the lower-left corner relative to this view. The rectangle is
+	// clipped to this view. If nothing is left an invalid view is returned. No pixels are copied.
+	tPictureView GetSubView(int x, int y, int width, int height) const;
+
+	// Copies the pixels row by row into dest, which is packed and must have room for GetNumPixels pixels.
+	void CopyTo(tPixel* dest) const;
+
+	// Returns true if all pixels are completely opaque (an alpha of 255).
+	bool IsOpaque() const;
+
+	// Views are equal if they are the same size and all the pixels match. The strides may differ.
+	bool operator==(const tPictureView&) const;
+	bool operator!=(const tPictureView& src) const																		{ return !(*this == src); }
+
+private:
+	const tPixel* Pixels = nullptr;
+	int Width = 0;
+	int Height = 0;
+	int Stride = 0;
+};
+
+
+// Implementation below this line.
+
+
+inline void tPictureView::Set(const tPixel* pixels, int width, int height, int stride)
+{
+	if (stride <= 0)
+		stride = width;
+
+	if (!pixels || (width <= 0) || (height <= 0) || (stride < width))
+	{
+		Clear();
+		return;
+	}
+
+	Pixels = pixels;
+	Width = width;
+	Height = height;
+	Stride = stride;
+}
+
+
+inline tPictureView tPictureView::GetSubView(int x, int y, int width, int height) const
+{
+	int x0 = tMath::tMax(x, 0);
+	int y0 = tMath::tMax(y, 0);
+	int x1 = tMath::tMin(x + width, Width);
+	int y1 = tMath::tMin(y + height, Height);
+	if (!Pixels || (x1 <= x0) || (y1 <= y0))
+		return tPictureView();
+
+	return tPictureView(Pixels + y0*Stride + x0, x1 - x0, y1 - y0, Stride);
+}
+
+
+inline void tPictureView::CopyTo(tPixel* dest) const
+{
+	if (IsPacked())
+	{
+		tStd::tMemcpy(dest, Pixels, GetNumPixels()*sizeof(tPixel));
+		return;
+	}
+
+	for (int y = 0; y < Height; y++)
+		tStd::tMemcpy(dest + y*Width, Pixels + y*Stride, Width*sizeof(tPixel));
+}
+
+
+inline bool tPictureView::IsOpaque() const
+{
+	for (int y = 0; y < Height; y++)
+	{
+		const tPixel* row = Pixels + y*Stride;
+		for (int x = 0; x < Width; x++)
+			if (row[x].A < 255)
+				return false;
+	}
+
+	return true;
+}
+
+
+inline bool tPictureView::operator==(const tPictureView& src) const
+{
+	if (!Pixels || !src.Pixels)
+		return false;
+
+	if ((Width != src.Width) || (Height != src.Height))
+		return false;
+
+	for (int y = 0; y < Height; y++)
+		if (tStd::tMemcmp(Pixels + y*Stride, src.Pixels + y*src.Stride, Width*sizeof(tPixel)))
+			return false;
+
+	return true;
+}
+
+
+}
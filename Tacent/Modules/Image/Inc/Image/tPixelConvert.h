@@ -0,0 +1,52 @@
+// tPixelConvert.h
+//
+// Conversion of pixels between any two normal (non block) pixel formats. Every format is described by where its
+// channels sit in memory, and conversions are driven by those descriptions instead of being written by hand for each
+// pair. Swizzles and packing to or from the 16 bit formats use SSE2 kernels on x64. Formats with 3 byte pixels use a
+// byte copying kernel, and everything else, including the float formats, goes through a general path.
+//
+// Copyright (c) 2020 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#pragma once
+#include <Foundation/tPlatform.h>
+#include "Image/tPixelFormat.h"
+namespace tImage
+{
+
+
+// Describes the memory layout of a normal pixel format. A pixel is read as a little endian integer of BytesPerPixel
+// bytes and each channel is a bit field of it. The channel order is R, G, B, A.
+struct tPixelLayout
+{
+	int BytesPerPixel;
+	bool Float;											// 32 bit floats. Otherwise unsigned normalized.
+	bool Luminance;										// R, G, and B share a field that holds luminance.
+	int Shift[4];										// Lowest bit of each channel.
+	int Bits[4];										// Zero if the format does not have the channel.
+};
+
+
+// Returns nullptr if the format is not a normal format.
+const tPixelLayout* tGetPixelLayout(tPixelFormat);
+
+// Converts numPixels pixels from the source format to the destination format. Both must be normal formats and the
+// buffers must not overlap. Colour channels the source does not have become 0 and a missing alpha becomes opaque.
+// Integer channels are rounded to the nearest value when the number of bits changes. Floats are clamped to [0, 1] when
+// written to integer channels and are otherwise left alone. Writing a luminance format uses the Rec. 709 weights. If
+// numThreads <= 0 one thread per core is used. Returns false if either format is not a normal format.
+bool tConvertPixels
+(
+	void* dest, tPixelFormat destFormat, const void* src, tPixelFormat srcFormat,
+	int numPixels, int numThreads = -1
+);
+
+
+}
@@ -35,9 +35,9 @@ enum class tPixelFormat
 	G4B4A4R4,							// 16 bit. 12 colour. 4 bit alpha.
 	G3B5R5G3,							// 16 bit. No alpha. The first 3 green bits are the low order ones.
 	L8A8,								// 16 bit. Luminance and alpha.
-	R32F,
-	G32R32F,
-	A32B32G32R32F,
+	R32F,								// 32 bit. Red only. The float formats use D3D names so red is first in memory.
+	G32R32F,							// 64 bit. Red and green.
+	A32B32G32R32F,						// 128 bit. Full colour and alpha.
 	LastNormal			= A32B32G32R32F,
 
 	FirstBlock,
@@ -24,6 +24,7 @@
 
 #pragma once
 #include <Foundation/tList.h>
+#include <Foundation/tMemory.h>
 #include <Foundation/tString.h>
 #include <System/tChunk.h>
 #include "Image/tFileDDS.h"
@@ -113,7 +114,7 @@ public:
 		tQuality = tQuality::Production, int forceWidth = 0, int forceHeight = 0
 	);
 
-	void Clear()																										{ Layers.Clear(); Opaque = true; }
+	void Clear()																										{ Layers.Clear(); if (ChainData) tMem::tFree(ChainData); ChainData = nullptr; ChainSize = 0; Opaque = true; }
 
 	int GetWidth() const				/* Returns width of the main layer. */											{ return IsValid() ? Layers.First()->Width : 0; }
 	int GetHeight() const				/* Returns width of the main layer. */											{ return IsValid() ? Layers.First()->Height : 0; }
@@ -126,13 +127,34 @@ public:
 	tLayer* GetFirstLayer() const																						{ return Layers.First(); }
 	tLayer* GetMainLayer() const																						{ return Layers.First(); }
 	void StealLayers(tList<tLayer>&);																					// Leaves the object invalid.
-	const tList<tLayer>& GetLayers()																					{ return Layers; }
+	const tList<tLayer>& GetLayers() const																				{ return Layers; }
 	int GetTotalPixelDataSize() const;
 
-	// Save and Load to tChunk format.
+	// Makes this texture a copy of the source. If the source is contiguous the copy is too, and all the pixel data is
+	// copied with a single allocation and memcpy. Returns false and leaves the texture invalid if the source is.
+	bool Set(const tTexture& src);
+
+	// By default every layer owns its own pixel data. A contiguous texture instead keeps the whole mip chain in a single
+	// aligned block with the layers pointing into it. This means one allocation instead of one per layer, the levels
+	// sit next to each other in memory, and the chain can be copied, saved, and loaded in one go. Each level starts on
+	// a ChainAlignment byte boundary. MakeSeparate gives every layer its own data again. Both do nothing if the texture
+	// is invalid or already stored that way. Stealing the layers of a contiguous texture makes it separate first.
+	bool IsContiguous() const																							{ return ChainData ? true : false; }
+	void MakeContiguous();
+	void MakeSeparate();
+	int64 GetChainDataSize() const		/* Includes padding. Zero if not contiguous. */									{ return ChainSize; }
+	const static int ChainAlignment = 16;
+
+	// Save and Load to tChunk format. A contiguous texture saves its chain as a single data chunk, and loading that
+	// back gives a contiguous texture with a single read.
 	void Save(tChunkWriter&) const;
 	void Load(const tChunk&);
 
+	// Saves all the layers to a dds file. The pixel format and layers are written as they are with no compression or
+	// resampling. Use the same correctRowOrder as you would to load it back. Returns false if the texture is invalid
+	// or the extension isn't dds. Like the dds Load, it throws a tDDSError if the file could not be written.
+	bool Save(const tString& ddsFile, bool correctRowOrder = true) const;
+
 	// Returns 1 + log2( max(width, height) ). The returned number is how many mipmaps it would take to make the
 	// smallest a 1x1 square. Some pipelines may care about this and require all of them if mipmapping at all.
 	int ComputeMaxNumberOfMipmaps() const;
@@ -145,12 +167,18 @@ public:
 private:
 	tPixelFormat DeterminePixelFormat(const tPicture&);
 	tPicture::tFilter DetermineFilter(tQuality);
-	void ProcessImageTo_R8G8B8_Or_R8G8B8A8(tPicture&, tPixelFormat, bool generateMipmaps, tQuality);
-	void ProcessImageTo_G3B5R5G3(tPicture&, bool generateMipmaps, tQuality);
+	void ProcessImageTo_Normal(tPicture&, tPixelFormat, bool generateMipmaps, tQuality);
 	void ProcessImageTo_BCTC(tPicture&, tPixelFormat, bool generateMipmaps, tQuality);
+	void AppendChainLayer(tPixelFormat, int width, int height, int64 offset);
+	void LoadChain(const tChunk&);
+	static int64 AlignChainOffset(int64 offset)																		{ return (offset + ChainAlignment - 1) & ~int64(ChainAlignment - 1); }
+
+	// Returns the number of bytes a layer of the given format and size needs, or 0 if the format or size is invalid or
+	// the layer would be too big for a tLayer to describe. Used to check chain descriptors before any layer is made.
+	static int64 GetChainLayerSize(tPixelFormat, int width, int height);
 
-	// This is legacy code for using Squish directly instead of nVidia Texture Tools 2. Once the Texture Tools version
-	// is tested, this can be removed.
+	// This is legacy code for using Squish directly instead of the native encoder in tBlockCompress. Once the native
+	// encoder is tested, this can be removed.
 	#ifdef TEXTURE_USE_SQUISH_LIB
 	void ProcessImageTo_BCTC_Squish(tPicture&, tPixelFormat, bool generateMipmaps, tQuality);
 	#endif
@@ -160,6 +188,10 @@ private:
 	// The tTexture is only valid if there is at least one layer. The texture is considered to have mipmaps if the
 	// number of layers is > 1.
 	tList<tLayer> Layers;
+
+	// Only non-null if the texture is contiguous, in which case none of the layers own their data.
+	uint8* ChainData = nullptr;
+	int64 ChainSize = 0;
 };
 
 
@@ -204,6 +236,8 @@ inline void tTexture::RemoveMipmaps()
 	if (!IsMipmapped())
 		return;
 
+	// The main layer of a contiguous texture starts the chain block, so the block is simply kept. Its tail is wasted
+	// until the texture is cleared or made separate.
 	tLayer* main = Layers.Remove();
 	Layers.Empty();
 	Layers.Append(main);
@@ -212,6 +246,8 @@ inline void tTexture::RemoveMipmaps()
 
 inline void tTexture::StealLayers(tList<tLayer>& layers)
 {
+	// The caller can't own views into a block that Clear is about to free.
+	MakeSeparate();
 	while (!Layers.IsEmpty())
 		layers.Append(Layers.Remove());
 
@@ -0,0 +1,135 @@
+// tTiledPicture.h
+//
+// A tTiledPicture represents an arbitrarily large image as a grid of square tiles along with a lazily generated mipmap
+// pyramid. Unlike a tPicture it never holds the whole image in memory. Tiles are decoded on demand by a region
+// provider and are kept in a cache with a fixed memory budget. When the budget is exceeded the least recently used
+// tiles are evicted. This allows panning and zooming around images much larger than tLayer::MaxLayerDimension while
+// only touching the tiles that are visible at the level of detail needed.
+//
+// Copyright (c) 2019 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#pragma once
+#include <functional>
+#include <Foundation/tList.h>
+#include <Math/tColour.h>
+#include "Image/tPicture.h"
+namespace tImage
+{
+
+
+// Level 0 is the full resolution image. Each subsequent level is half the size (rounded up) of the previous one, and
+// the last level is the first one that fits entirely inside a single tile. Only level 0 tiles are ever requested from
+// the region provider. Tiles for all other levels are generated by box filtering the four tiles beneath them. This
+// class is not thread-safe. The origin is the lower left and rows are ordered bottom to top, same as a tPicture.
+class tTiledPicture
+{
+public:
+	const static int TileSize = 256;
+	const static int TileNumBytes = TileSize*TileSize*int(sizeof(tPixel));
+	const static int64 DefaultCacheBudget = 256*1024*1024;
+
+	// The region provider must fill in a w by h block of level 0 pixels starting at (x, y). The region never extends
+	// past the image edges. Rows are written to dest bottom to top with a stride of destStride pixels. This is where
+	// region-of-interest decoding happens, so the provider should only decode what was asked for. Return false if the
+	// region could not be decoded, in which case the tile is left transparent black.
+	typedef std::function<bool(int x, int y, int w, int h, tPixel* dest, int destStride)> tRegionProvider;
+
+	// Constructs an invalid tiled picture. Call Set later.
+	tTiledPicture()																										{ }
+	tTiledPicture(int width, int height, tRegionProvider provider, int64 cacheBudget = DefaultCacheBudget)				{ Set(width, height, provider, cacheBudget); }
+	virtual ~tTiledPicture()																							{ Clear(); }
+
+	// Any width and height > 0 is allowed, including sizes beyond tLayer::MaxLayerDimension. The cache budget is in
+	// bytes and is clamped so at least one tile may be cached. Returns success.
+	bool Set(int width, int height, tRegionProvider provider, int64 cacheBudget = DefaultCacheBudget);
+
+	// Convenience for viewing an existing tPicture through the tiled interface. The picture is not copied so it must
+	// outlive this object or until Clear is called.
+	bool Set(tPicture& src, int64 cacheBudget = DefaultCacheBudget);
+
+	void Clear();
+	bool IsValid() const																								{ return Levels ? true : false; }
+
+	int GetNumLevels() const																							{ return NumLevels; }
+	int GetWidth(int level = 0) const																					{ tAssert(ValidLevel(level)); return Levels[level].Width; }
+	int GetHeight(int level = 0) const																					{ tAssert(ValidLevel(level)); return Levels[level].Height; }
+	int GetNumTilesX(int level = 0) const																				{ tAssert(ValidLevel(level)); return Levels[level].NumTilesX; }
+	int GetNumTilesY(int level = 0) const																				{ tAssert(ValidLevel(level)); return Levels[level].NumTilesY; }
+
+	// Returns the most detailed level that is not more detailed than needed when drawing at the supplied scale. A
+	// scale of 1.0 is one screen pixel per image pixel (level 0). A scale of 0.25 would return level 2.
+	int GetLevelForScale(float scale) const;
+
+	// Returns TileSize*TileSize pixels for the requested tile, generating it (and any tiles it depends on) if necessary.
+	// Pixels of edge tiles that lie outside the level are undefined. The returned pointer is only valid until the next
+	// non-const call as the tile may be evicted. Returns nullptr if the tile coordinates are out of range.
+	const tPixel* GetTile(int level, int tileX, int tileY);
+
+	// Region-of-interest fetch. Copies the w by h rectangle at (x, y) of the specified level into dest, resizing dest
+	// as needed. Only the tiles overlapping the rectangle are touched. The rectangle is clipped to the level and false
+	// is returned if nothing remains after clipping.
+	bool GetRegion(tPicture& dest, int level, int x, int y, int w, int h);
+
+	// The budget may be changed at any time. Lowering it evicts tiles immediately.
+	void SetCacheBudget(int64 budgetBytes);
+	int64 GetCacheBudget() const																						{ return CacheBudget; }
+	int64 GetCacheNumBytes() const																						{ return int64(Cache.GetNumItems()) * TileNumBytes; }
+	int GetCacheNumTiles() const																						{ return Cache.GetNumItems(); }
+
+	// Empties the tile cache without invalidating the tiled picture.
+	void FlushCache();
+
+	// Statistics. Useful for verifying that panning does not decode more than it should.
+	int GetNumProviderCalls() const																						{ return NumProviderCalls; }
+	int GetNumCacheHits() const																							{ return NumCacheHits; }
+	int GetNumCacheMisses() const																						{ return NumCacheMisses; }
+
+private:
+	struct Tile : public tLink<Tile>
+	{
+		Tile(int level, int tileX, int tileY, tPixel* pixels)															: Level(level), TileX(tileX), TileY(tileY), Pixels(pixels) { }
+		~Tile()																											{ tPicture::FreePixels(Pixels); }
+
+		int Level;
+		int TileX;
+		int TileY;
+		tPixel* Pixels;
+	};
+
+	struct LevelInfo
+	{
+		int Width;
+		int Height;
+		int NumTilesX;
+		int NumTilesY;
+		Tile** Tiles;									// NumTilesX*NumTilesY lookup. Entries are null for uncached tiles.
+	};
+
+	bool ValidLevel(int level) const																					{ return (level >= 0) && (level < NumLevels); }
+	void GenerateTile(int level, int tileX, int tileY, tPixel* dest);
+	void Insert(Tile*);
+	void Evict(int numBytesNeeded);
+
+	tRegionProvider Provider;
+	int64 CacheBudget = DefaultCacheBudget;
+	int NumLevels = 0;
+	LevelInfo* Levels = nullptr;
+
+	// Most recently used tiles are at the head.
+	tList<Tile> Cache;
+
+	int NumProviderCalls = 0;
+	int NumCacheHits = 0;
+	int NumCacheMisses = 0;
+};
+
+
+}
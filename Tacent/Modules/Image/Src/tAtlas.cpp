@@ -0,0 +1,622 @@
+// tAtlas.cpp
+//
+// Packs a set of tPictures (sprites) into one or more atlas pages. Packing can use MaxRects or Skyline, with optional
+// rotation, padding, and edge extrusion. Pages may be fixed size, the smallest power-of-two that fits, or trimmed to
+// exactly what is used. The placement of every sprite can be saved as a tScript table.
+//
+// Copyright (c) 2020 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include "Foundation/tStandard.h"
+#include "Foundation/tSort.h"
+#include "Math/tFundamentals.h"
+#include "System/tMachine.h"
+#include "System/tScript.h"
+#include "Image/tAtlas.h"
+using namespace tImage;
+
+
+namespace tPack
+{
+	struct Rect
+	{
+		int X, Y, W, H;
+		bool Contains(const Rect& r) const																				{ return (r.X >= X) && (r.Y >= Y) && (r.X + r.W <= X + W) && (r.Y + r.H <= Y + H); }
+		bool Overlaps(const Rect& r) const																				{ return (r.X < X + W) && (r.X + r.W > X) && (r.Y < Y + H) && (r.Y + r.H > Y); }
+	};
+
+	// A growable array for the packers' working lists. Removal swaps in the last element, which keeps things
+	// deterministic as long as the same operations happen in the same order.
+	template<typename T> struct List
+	{
+		~List()																											{ delete[] Items; }
+		void Add(const T&);
+		void Insert(int index, const T&);
+		void RemoveSwap(int index)																						{ Items[index] = Items[--Count]; }
+		void RemoveOrdered(int index);
+		T& operator[](int index)																						{ return Items[index]; }
+		T* Items = nullptr;
+		int Count = 0;
+		int Capacity = 0;
+	};
+
+	// The size of an item includes the extrusion on both sides and the padding on one side. Bins are the page size
+	// plus the padding so the padding after the last column and row of sprites falls off the edge.
+	struct Item
+	{
+		int W, H;
+		int Index;										// Into the sprite list.
+	};
+	bool CompareItems(const Item& a, const Item& b);
+
+	// MaxRects keeps every maximal free rectangle. Items go in the free rectangle that leaves the smallest leftover
+	// on its shorter side, and then every free rectangle the item overlaps is split around it.
+	class MaxRectsPacker
+	{
+	public:
+		MaxRectsPacker(int binWidth, int binHeight)																		{ FreeRects.Add({ 0, 0, binWidth, binHeight }); }
+		bool Insert(Rect& placed, bool& rotated, int width, int height, bool allowRotation);
+
+	private:
+		void Place(const Rect&);
+		List<Rect> FreeRects;
+		List<Rect> NewRects;
+	};
+
+	// Skyline keeps the top edge of the packed area as a list of horizontal segments. Items go wherever their top
+	// ends up lowest, leftmost on a tie.
+	class SkylinePacker
+	{
+	public:
+		SkylinePacker(int binWidth, int binHeight);
+		bool Insert(Rect& placed, bool& rotated, int width, int height, bool allowRotation);
+
+	private:
+		struct Segment { int X, Y, W; };
+		bool Fit(int& y, int segment, int width, int height) const;
+		void AddLevel(int segment, int x, int y, int width);
+		int BinWidth, BinHeight;
+		List<Segment> Segments;
+	};
+
+	// Packs items into one bin in the order given. Placed items have their rect and rotation written and their flag
+	// set. Returns the number placed. If stopOnFail is set it gives up at the first item that doesn't fit.
+	int PackBin
+	(
+		Rect rects[], bool rotated[], bool placed[], const Item items[], int numItems,
+		int binWidth, int binHeight, const tAtlasSettings&, bool stopOnFail
+	);
+
+	int CeilPower2(int v)																								{ return tMath::tIsPower2(v) ? v : int(tMath::tNextHigherPower2(uint(v))); }
+	void CopySprite(tPicture& page, const tPicture& sprite, const tAtlasPlacement&, int extrude);
+}
+
+
+template<typename T> void tPack::List<T>::Add(const T& item)
+{
+	if (Count == Capacity)
+	{
+		Capacity = tMath::tMax(Capacity*2, 64);
+		T* items = new T[Capacity];
+		for (int i = 0; i < Count; i++)
+			items[i] = Items[i];
+		delete[] Items;
+		Items = items;
+	}
+	Items[Count++] = item;
+}
+
+
+template<typename T> void tPack::List<T>::Insert(int index, const T& item)
+{
+	Add(item);
+	for (int i = Count-1; i > index; i--)
+		Items[i] = Items[i-1];
+	Items[index] = item;
+}
+
+
+template<typename T> void tPack::List<T>::RemoveOrdered(int index)
+{
+	for (int i = index; i < Count-1; i++)
+		Items[i] = Items[i+1];
+	Count--;
+}
+
+
+bool tPack::CompareItems(const Item& a, const Item& b)
+{
+	// Longest side first, then the other side, then the input order so the sort is a total order.
+	int aMax = tMath::tMax(a.W, a.H); int bMax = tMath::tMax(b.W, b.H);
+	if (aMax != bMax)
+		return aMax > bMax;
+
+	int aMin = tMath::tMin(a.W, a.H); int bMin = tMath::tMin(b.W, b.H);
+	if (aMin != bMin)
+		return aMin > bMin;
+
+	return a.Index < b.Index;
+}
+
+
+bool tPack::MaxRectsPacker::Insert(Rect& placed, bool& rotated, int width, int height, bool allowRotation)
+{
+	int bestShort = 0x7FFFFFFF;
+	int bestLong = 0x7FFFFFFF;
+	for (int r = 0; r < FreeRects.Count; r++)
+	{
+		const Rect& free = FreeRects[r];
+		for (int turn = 0; turn < (allowRotation ? 2 : 1); turn++)
+		{
+			int w = turn ? height : width;
+			int h = turn ? width : height;
+			if ((w > free.W) || (h > free.H))
+				continue;
+
+			int leftoverW = free.W - w;
+			int leftoverH = free.H - h;
+			int shortSide = tMath::tMin(leftoverW, leftoverH);
+			int longSide = tMath::tMax(leftoverW, leftoverH);
+			if ((shortSide < bestShort) || ((shortSide == bestShort) && (longSide < bestLong)))
+			{
+				placed = { free.X, free.Y, w, h };
+				rotated = (turn == 1);
+				bestShort = shortSide;
+				bestLong = longSide;
+			}
+		}
+	}
+
+	if (bestShort == 0x7FFFFFFF)
+		return false;
+
+	Place(placed);
+	return true;
+}
+
+
+void tPack::MaxRectsPacker::Place(const Rect& used)
+{
+	// Split every free rectangle the used one overlaps into up to four maximal pieces around it.
+	NewRects.Count = 0;
+	for (int r = 0; r < FreeRects.Count; r++)
+	{
+		Rect free = FreeRects[r];
+		if (!free.Overlaps(used))
+			continue;
+
+		if (used.X > free.X)
+			NewRects.Add({ free.X, free.Y, used.X - free.X, free.H });
+		if (used.X + used.W < free.X + free.W)
+			NewRects.Add({ used.X + used.W, free.Y, free.X + free.W - used.X - used.W, free.H });
+		if (used.Y > free.Y)
+			NewRects.Add({ free.X, free.Y, free.W, used.Y - free.Y });
+		if (used.Y + used.H < free.Y + free.H)
+			NewRects.Add({ free.X, used.Y + used.H, free.W, free.Y + free.H - used.Y - used.H });
+
+		FreeRects.RemoveSwap(r--);
+	}
+
+	// The untouched free rectangles already don't contain each other, and none of them can be inside a new piece
+	// since every piece is inside a rectangle that was maximal. So only the new pieces need pruning.
+	for (int n = 0; n < NewRects.Count; n++)
+	{
+		bool redundant = false;
+		for (int m = 0; (m < NewRects.Count) && !redundant; m++)
+			if ((m != n) && NewRects[m].Contains(NewRects[n]))
+				redundant = !NewRects[n].Contains(NewRects[m]) || (m < n);
+
+		for (int r = 0; (r < FreeRects.Count) && !redundant; r++)
+			redundant = FreeRects[r].Contains(NewRects[n]);
+
+		if (redundant)
+			NewRects.RemoveOrdered(n--);
+	}
+
+	for (int n = 0; n < NewRects.Count; n++)
+		FreeRects.Add(NewRects[n]);
+}
+
+
+tPack::SkylinePacker::SkylinePacker(int binWidth, int binHeight) :
+	BinWidth(binWidth),
+	BinHeight(binHeight)
+{
+	Segments.Add({ 0, 0, binWidth });
+}
+
+
+bool tPack::SkylinePacker::Fit(int& y, int segment, int width, int height) const
+{
+	int x = Segments.Items[segment].X;
+	if (x + width > BinWidth)
+		return false;
+
+	// The item rests on the highest segment under it.
+	y = 0;
+	for (int s = segment; (s < Segments.Count) && (Segments.Items[s].X < x + width); s++)
+	{
+		y = tMath::tMax(y, Segments.Items[s].Y);
+		if (y + height > BinHeight)
+			return false;
+	}
+	return true;
+}
+
+
+bool tPack::SkylinePacker::Insert(Rect& placed, bool& rotated, int width, int height, bool allowRotation)
+{
+	int bestTop = 0x7FFFFFFF;
+	int bestSegment = -1;
+	for (int s = 0; s < Segments.Count; s++)
+	{
+		for (int turn = 0; turn < (allowRotation ? 2 : 1); turn++)
+		{
+			int w = turn ? height : width;
+			int h = turn ? width : height;
+			int y;
+			if (!Fit(y, s, w, h) || (y + h >= bestTop))
+				continue;
+
+			placed = { Segments[s].X, y, w, h };
+			rotated = (turn == 1);
+			bestTop = y + h;
+			bestSegment = s;
+		}
+	}
+
+	if (bestSegment < 0)
+		return false;
+
+	AddLevel(bestSegment, placed.X, placed.Y + placed.H, placed.W);
+	return true;
+}
+
+
+void tPack::SkylinePacker::AddLevel(int segment, int x, int y, int width)
+{
+	Segments.Insert(segment, { x, y, width });
+
+	// Cut back the segments the new one covers.
+	for (int s = segment+1; s < Segments.Count; s++)
+	{
+		Segment& prev = Segments[s-1];
+		Segment& curr = Segments[s];
+		int overlap = prev.X + prev.W - curr.X;
+		if (overlap <= 0)
+			break;
+
+		curr.X += overlap;
+		curr.W -= overlap;
+		if (curr.W > 0)
+			break;
+
+		Segments.RemoveOrdered(s--);
+	}
+
+	// Join neighbours at the same height.
+	for (int s = 0; s < Segments.Count-1; s++)
+	{
+		if (Segments[s].Y != Segments[s+1].Y)
+			continue;
+
+		Segments[s].W += Segments[s+1].W;
+		Segments.RemoveOrdered(s+1);
+		s--;
+	}
+}
+
+
+int tPack::PackBin
+(
+	Rect rects[], bool rotated[], bool placed[], const Item items[], int numItems,
+	int binWidth, int binHeight, const tAtlasSettings& settings, bool stopOnFail
+)
+{
+	MaxRectsPacker maxRects(binWidth, binHeight);
+	SkylinePacker skyline(binWidth, binHeight);
+	int numPlaced = 0;
+	for (int i = 0; i < numItems; i++)
+	{
+		placed[i] = (settings.Method == tAtlasMethod::Skyline) ?
+			skyline.Insert(rects[i], rotated[i], items[i].W, items[i].H, settings.AllowRotation) :
+			maxRects.Insert(rects[i], rotated[i], items[i].W, items[i].H, settings.AllowRotation);
+
+		if (placed[i])
+			numPlaced++;
+		else if (stopOnFail)
+			break;
+	}
+
+	return numPlaced;
+}
+
+
+void tPack::CopySprite(tPicture& page, const tPicture& sprite, const tAtlasPlacement& placement, int extrude)
+{
+	// A rotated sprite is turned clockwise, so each row of the placed rectangle is a column of the sprite read from
+	// the bottom up, starting at the rightmost column.
+	int w = placement.Width;
+	int h = placement.Height;
+	for (int y = 0; y < h; y++)
+	{
+		tPixel* dest = page.GetPixelPointer(placement.X, placement.Y + y);
+		if (!placement.Rotated)
+		{
+			tStd::tMemcpy(dest, sprite.GetPixels() + y*w, w*int(sizeof(tPixel)));
+			continue;
+		}
+
+		int column = sprite.GetWidth() - 1 - y;
+		for (int x = 0; x < w; x++)
+			dest[x] = sprite.GetPixel(column, x);
+	}
+
+	if (extrude <= 0)
+		return;
+
+	for (int y = 0; y < h; y++)
+	{
+		tPixel* row = page.GetPixelPointer(placement.X, placement.Y + y);
+		for (int e = 1; e <= extrude; e++)
+		{
+			row[-e] = row[0];
+			row[w-1+e] = row[w-1];
+		}
+	}
+
+	int rowBytes = (w + 2*extrude)*int(sizeof(tPixel));
+	const tPixel* bottom = page.GetPixelPointer(placement.X - extrude, placement.Y);
+	const tPixel* top = page.GetPixelPointer(placement.X - extrude, placement.Y + h - 1);
+	for (int e = 1; e <= extrude; e++)
+	{
+		tStd::tMemcpy(page.GetPixelPointer(placement.X - extrude, placement.Y - e), bottom, rowBytes);
+		tStd::tMemcpy(page.GetPixelPointer(placement.X - extrude, placement.Y + h - 1 + e), top, rowBytes);
+	}
+}
+
+
+bool tAtlas::Build(const tList<tPicture>& sprites, const tAtlasSettings& settings, int numThreads)
+{
+	Clear();
+	if ((settings.MaxPageWidth <= 0) || (settings.MaxPageHeight <= 0))
+		return false;
+	if ((settings.Padding < 0) || (settings.Extrude < 0))
+		return false;
+
+	int numSprites = sprites.GetNumItems();
+	const tPicture** spriteArray = new const tPicture*[numSprites];
+	tPack::Item* items = new tPack::Item[numSprites];
+	int numItems = 0;
+	int border = 2*settings.Extrude + settings.Padding;
+	int binWidth = settings.MaxPageWidth + settings.Padding;
+	int binHeight = settings.MaxPageHeight + settings.Padding;
+	bool fits = true;
+	int index = 0;
+	for (const tPicture* sprite = sprites.First(); sprite; sprite = sprite->Next(), index++)
+	{
+		spriteArray[index] = sprite;
+		tAtlasPlacement placement;
+		placement.Page = -1;
+		placement.X = placement.Y = placement.Width = placement.Height = 0;
+		placement.Rotated = false;
+		placement.Name = sprite->Filename;
+		Placements.Append(placement);
+		if (!sprite->IsValid())
+			continue;
+
+		tPack::Item& item = items[numItems++];
+		item.W = sprite->GetWidth() + border;
+		item.H = sprite->GetHeight() + border;
+		item.Index = index;
+		bool fitsUpright = (item.W <= binWidth) && (item.H <= binHeight);
+		bool fitsTurned = settings.AllowRotation && (item.H <= binWidth) && (item.W <= binHeight);
+		if (!fitsUpright && !fitsTurned)
+			fits = false;
+	}
+
+	if (!fits || !numItems)
+	{
+		delete[] spriteArray;
+		delete[] items;
+		Clear();
+		return false;
+	}
+
+	tSort::tQuick(items, numItems, tPack::CompareItems);
+	tPack::Rect* rects = new tPack::Rect[numItems];
+	bool* rotated = new bool[numItems];
+	bool* placed = new bool[numItems];
+	tPack::Item* remaining = new tPack::Item[numItems];
+	while (numItems > 0)
+	{
+		// Work out the smallest page that could hold all the remaining items. With rotation an item only needs its
+		// shorter side to fit.
+		int64 area = 0;
+		int minWidth = 1; int minHeight = 1;
+		for (int i = 0; i < numItems; i++)
+		{
+			area += int64(items[i].W)*int64(items[i].H);
+			int w = settings.AllowRotation ? tMath::tMin(items[i].W, items[i].H) : items[i].W;
+			int h = settings.AllowRotation ? tMath::tMin(items[i].W, items[i].H) : items[i].H;
+			minWidth = tMath::tMax(minWidth, w - settings.Padding);
+			minHeight = tMath::tMax(minHeight, h - settings.Padding);
+		}
+
+		// Try power-of-two sizes from there up, doubling the shorter side each time so pages stay close to square.
+		// Fixed pages only try the maximum. Whatever is tried last is always the maximum.
+		int pageWidth = settings.MaxPageWidth;
+		int pageHeight = settings.MaxPageHeight;
+		int tryWidth = tMath::tMin(tPack::CeilPower2(minWidth), settings.MaxPageWidth);
+		int tryHeight = tMath::tMin(tPack::CeilPower2(minHeight), settings.MaxPageHeight);
+		bool allPlaced = false;
+		while (settings.PageSize != tAtlasPageSize::Fixed)
+		{
+			bool isMax = (tryWidth == settings.MaxPageWidth) && (tryHeight == settings.MaxPageHeight);
+			int64 tryArea = int64(tryWidth + settings.Padding)*int64(tryHeight + settings.Padding);
+			if ((tryArea >= area) && (tPack::PackBin
+			(
+				rects, rotated, placed, items, numItems,
+				tryWidth + settings.Padding, tryHeight + settings.Padding, settings, true
+			) == numItems))
+			{
+				pageWidth = tryWidth;
+				pageHeight = tryHeight;
+				allPlaced = true;
+				break;
+			}
+
+			if (isMax)
+				break;
+
+			bool growWidth = (tryWidth <= tryHeight) && (tryWidth < settings.MaxPageWidth);
+			if (growWidth || (tryHeight == settings.MaxPageHeight))
+				tryWidth = tMath::tMin(tryWidth*2, settings.MaxPageWidth);
+			else
+				tryHeight = tMath::tMin(tryHeight*2, settings.MaxPageHeight);
+		}
+
+		// Fill the maximum page with as many as fit.
+		if (!allPlaced)
+			tPack::PackBin(rects, rotated, placed, items, numItems, binWidth, binHeight, settings, false);
+
+		int pageIndex = Pages.GetNumItems();
+		int usedWidth = 1; int usedHeight = 1;
+		int numRemaining = 0;
+		for (int i = 0; i < numItems; i++)
+		{
+			if (!placed[i])
+			{
+				remaining[numRemaining++] = items[i];
+				continue;
+			}
+
+			const tPicture* sprite = spriteArray[items[i].Index];
+			tAtlasPlacement& placement = Placements[items[i].Index];
+			placement.Page = pageIndex;
+			placement.X = rects[i].X + settings.Extrude;
+			placement.Y = rects[i].Y + settings.Extrude;
+			placement.Rotated = rotated[i];
+			placement.Width = rotated[i] ? sprite->GetHeight() : sprite->GetWidth();
+			placement.Height = rotated[i] ? sprite->GetWidth() : sprite->GetHeight();
+			usedWidth = tMath::tMax(usedWidth, rects[i].X + rects[i].W - settings.Padding);
+			usedHeight = tMath::tMax(usedHeight, rects[i].Y + rects[i].H - settings.Padding);
+		}
+		tAssert(numRemaining < numItems);
+
+		switch (settings.PageSize)
+		{
+			case tAtlasPageSize::PowerOfTwo:
+				pageWidth = tMath::tMin(tPack::CeilPower2(usedWidth), pageWidth);
+				pageHeight = tMath::tMin(tPack::CeilPower2(usedHeight), pageHeight);
+				break;
+
+			case tAtlasPageSize::Tight:
+				pageWidth = usedWidth;
+				pageHeight = usedHeight;
+				break;
+
+			default:
+				break;
+		}
+		tPicture* page = new tPicture;
+		page->Set(pageWidth, pageHeight, tPixel::transparent);
+		Pages.Append(page);
+
+		tStd::tSwap(items, remaining);
+		numItems = numRemaining;
+	}
+
+	// Each sprite writes its own part of a page, so they can all be copied at once.
+	tPicture** pageArray = new tPicture*[Pages.GetNumItems()];
+	index = 0;
+	for (tPicture* page = Pages.First(); page; page = page->Next())
+		pageArray[index++] = page;
+
+	tSystem::tParallelFor
+	(
+		numSprites,
+		[&](int s)
+		{
+			const tAtlasPlacement& placement = Placements[s];
+			if (placement.Page >= 0)
+				tPack::CopySprite(*pageArray[placement.Page], *spriteArray[s], placement, settings.Extrude);
+		},
+		numThreads
+	);
+
+	delete[] pageArray;
+	delete[] remaining;
+	delete[] placed;
+	delete[] rotated;
+	delete[] rects;
+	delete[] items;
+	delete[] spriteArray;
+	return true;
+}
+
+
+float tAtlas::GetOccupancy() const
+{
+	int64 pageArea = 0;
+	for (const tPicture* page = Pages.First(); page; page = page->Next())
+		pageArea += int64(page->GetWidth())*int64(page->GetHeight());
+
+	int64 spriteArea = 0;
+	for (int p = 0; p < Placements.GetNumElements(); p++)
+		if (Placements[p].Page >= 0)
+			spriteArea += int64(Placements[p].Width)*int64(Placements[p].Height);
+
+	return pageArea ? float(double(spriteArea) / double(pageArea)) : 0.0f;
+}
+
+
+bool tAtlas::SaveScript(const tString& scriptFile) const
+{
+	if (!IsValid())
+		return false;
+
+	try
+	{
+		tScriptWriter writer(scriptFile);
+		writer.Rem("Atlas placement table. Coordinates are in pixels from the lower-left of the page. Rotated sprites");
+		writer.Rem("are turned 90 degrees clockwise and their width and height are as placed.");
+		writer.CR();
+
+		int index = 0;
+		for (const tPicture* page = Pages.First(); page; page = page->Next(), index++)
+			writer.Comp("Page", index, page->GetWidth(), page->GetHeight());
+		writer.CR();
+
+		for (int s = 0; s < Placements.GetNumElements(); s++)
+		{
+			const tAtlasPlacement& placement = Placements[s];
+			writer.Begin();
+			writer.Atom("Sprite");
+			writer.Atom(s);
+			writer.Atom(placement.Page);
+			writer.Atom(placement.X);
+			writer.Atom(placement.Y);
+			writer.Atom(placement.Width);
+			writer.Atom(placement.Height);
+			writer.Atom(placement.Rotated);
+			if (!placement.Name.IsEmpty())
+				writer.Atom(placement.Name);
+			writer.End();
+			writer.CR();
+		}
+	}
+	catch (tScriptError&)
+	{
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,785 @@
+// tBandPipeline.cpp
+//
+// A pull-based pipeline that processes an image a band of rows at a time so the whole image never needs to be in
+// memory. Sources produce rows top row first. Stages are sources that pull rows from the source before them and
+// transform them, and sinks write rows out as they arrive. tStream pumps a source into a sink. Each step only holds a
+// few bands, so converting and resizing an image far larger than memory takes about as much memory as a small one. A
+// tBandPrefetch stage runs everything before it on its own thread.
+//
+// Copyright (c) 2020 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <Foundation/tStandard.h>
+#include <Math/tFundamentals.h>
+#include <Math/tConstants.h>
+#include <System/tFile.h>
+#include "Image/tBandPipeline.h"
+#include "Image/tPixelConvert.h"
+using namespace tImage;
+using namespace tSystem;
+
+
+namespace tBand
+{
+	// The filter kernels take the distance from the sample centre in source pixels. When shrinking, the kernels are
+	// stretched to cover all the source pixels under a destination pixel.
+	float GetRadius(tPicture::tFilter);
+	float Kernel(float x, tPicture::tFilter);
+
+	// Seeks relative to the current position. Large offsets are split up since tFileSeek only takes an int.
+	bool SeekRelative(tFileHandle, int64 offset);
+}
+
+
+float tBand::GetRadius(tPicture::tFilter filter)
+{
+	switch (filter)
+	{
+		case tPicture::tFilter::Box:			return 0.5f;
+		case tPicture::tFilter::Bilinear:		return 1.0f;
+		case tPicture::tFilter::Bicubic:		return 2.0f;
+		case tPicture::tFilter::Quadratic:		return 1.5f;
+		case tPicture::tFilter::Hamming:		return 1.0f;
+		default:								return 0.5f;
+	}
+}
+
+
+float tBand::Kernel(float x, tPicture::tFilter filter)
+{
+	x = tMath::tAbs(x);
+	switch (filter)
+	{
+		case tPicture::tFilter::Bilinear:
+			return (x < 1.0f) ? 1.0f - x : 0.0f;
+
+		// Catmull-Rom.
+		case tPicture::tFilter::Bicubic:
+			if (x < 1.0f)
+				return (1.5f*x - 2.5f)*x*x + 1.0f;
+			if (x < 2.0f)
+				return ((-0.5f*x + 2.5f)*x - 4.0f)*x + 2.0f;
+			return 0.0f;
+
+		// Quadratic B-spline.
+		case tPicture::tFilter::Quadratic:
+			if (x < 0.5f)
+				return 0.75f - x*x;
+			if (x < 1.5f)
+				return 0.5f*(x - 1.5f)*(x - 1.5f);
+			return 0.0f;
+
+		// Sinc with a Hamming window.
+		case tPicture::tFilter::Hamming:
+		{
+			if (x >= 1.0f)
+				return 0.0f;
+			if (x < 0.0001f)
+				return 1.0f;
+			float px = tMath::Pi*x;
+			return (tMath::tSin(px)/px) * (0.54f + 0.46f*tMath::tCos(px));
+		}
+
+		case tPicture::tFilter::Box:
+		default:
+			return (x <= 0.5f) ? 1.0f : 0.0f;
+	}
+}
+
+
+bool tBand::SeekRelative(tFileHandle file, int64 offset)
+{
+	const int64 maxStep = 1024*1024*1024;
+	while (offset != 0)
+	{
+		int64 step = tMath::tClamp(offset, -maxStep, maxStep);
+		if (tFileSeek(file, int(step), tSeekOrigin::Current) != 0)
+			return false;
+		offset -= step;
+	}
+	return true;
+}
+
+
+bool tBandSource::Read(tPixel* dest, int numRows)
+{
+	if (!IsValid() || !dest || (numRows <= 0) || (numRows > Height - RowsRead))
+		return false;
+
+	if (!ReadRows(dest, numRows))
+		return false;
+
+	RowsRead += numRows;
+	return true;
+}
+
+
+tBandPictureSource::tBandPictureSource(const tPictureView& view) :
+	View(view)
+{
+	if (!View.IsValid())
+		return;
+
+	Width = View.GetWidth();
+	Height = View.GetHeight();
+	Opaque = View.IsOpaque();
+}
+
+
+bool tBandPictureSource::ReadRows(tPixel* dest, int numRows)
+{
+	for (int r = 0; r < numRows; r++)
+		tStd::tMemcpy(dest + r*Width, View.GetRow(Height - 1 - GetRowsRead() - r), Width*sizeof(tPixel));
+
+	return true;
+}
+
+
+tBandTGASource::tBandTGASource(const tString& tgaFile)
+{
+	if (!Reader.Begin(tgaFile))
+		return;
+
+	Width = Reader.GetWidth();
+	Height = Reader.GetHeight();
+	Opaque = (Reader.GetBitDepth() == 24);
+}
+
+
+bool tBandTGASource::ReadRows(tPixel* dest, int numRows)
+{
+	for (int r = 0; r < numRows; r++)
+		if (!Reader.ReadRow(dest + r*Width))
+			return false;
+
+	return true;
+}
+
+
+tBandQOISource::tBandQOISource(const tString& qoiFile)
+{
+	if (!Reader.Begin(qoiFile))
+		return;
+
+	Width = Reader.GetWidth();
+	Height = Reader.GetHeight();
+	Opaque = (Reader.GetChannels() == 3);
+}
+
+
+bool tBandQOISource::ReadRows(tPixel* dest, int numRows)
+{
+	for (int r = 0; r < numRows; r++)
+		if (!Reader.ReadRow(dest + r*Width))
+			return false;
+
+	return true;
+}
+
+
+tBandCrop::tBandCrop(tBandSource& source, int newWidth, int newHeight, int originX, int originY) :
+	Source(source),
+	OriginX(originX)
+{
+	if (!Source.IsValid() || (newWidth <= 0) || (newHeight <= 0))
+		return;
+
+	int srcWidth = Source.GetWidth();
+	int srcHeight = Source.GetHeight();
+	Width = newWidth;
+	Height = newHeight;
+	SrcTop = srcHeight - originY - newHeight;
+	bool inside =
+		(originX >= 0) && (originY >= 0) && (originX + newWidth <= srcWidth) && (originY + newHeight <= srcHeight);
+	Opaque = inside && Source.IsOpaque();
+	Row = new tPixel[srcWidth];
+}
+
+
+bool tBandCrop::ReadRows(tPixel* dest, int numRows)
+{
+	int srcWidth = Source.GetWidth();
+	int srcHeight = Source.GetHeight();
+	int x0 = tMath::tMax(-OriginX, 0);
+	int x1 = tMath::tMin(srcWidth - OriginX, Width);
+	for (int r = 0; r < numRows; r++)
+	{
+		tPixel* out = dest + r*Width;
+		tStd::tMemset(out, 0, Width*sizeof(tPixel));
+		int srcY = SrcTop + GetRowsRead() + r;
+		if ((srcY < 0) || (srcY >= srcHeight))
+			continue;
+
+		while (Source.GetRowsRead() <= srcY)
+			if (!Source.Read(Row, 1))
+				return false;
+
+		if (x0 < x1)
+			tStd::tMemcpy(out + x0, Row + OriginX + x0, (x1 - x0)*sizeof(tPixel));
+	}
+
+	return true;
+}
+
+
+void tBandResample::Axis::Set(int srcSize, int dstSize, tPicture::tFilter filter)
+{
+	First = new int[dstSize];
+	Count = new int[dstSize];
+	float scale = float(srcSize) / float(dstSize);
+	if (filter == tPicture::tFilter::NearestNeighbour)
+	{
+		MaxCount = 1;
+		Weights = new float[dstSize];
+		for (int d = 0; d < dstSize; d++)
+		{
+			First[d] = tMath::tMin(int((float(d) + 0.5f)*scale), srcSize-1);
+			Count[d] = 1;
+			Weights[d] = 1.0f;
+		}
+		return;
+	}
+
+	// Pixel centres line up, so destination pixel d samples around source position (d + 0.5)*scale - 0.5. Taps that
+	// fall off the edge use the edge pixel.
+	float stretch = tMath::tMax(scale, 1.0f);
+	float radius = tBand::GetRadius(filter)*stretch;
+	MaxCount = int(tMath::tCeiling(2.0f*radius)) + 3;
+	Weights = new float[dstSize*MaxCount];
+	tStd::tMemset(Weights, 0, dstSize*MaxCount*sizeof(float));
+	for (int d = 0; d < dstSize; d++)
+	{
+		float centre = (float(d) + 0.5f)*scale - 0.5f;
+		int lo = int(tMath::tFloor(centre - radius));
+		int hi = int(tMath::tCeiling(centre + radius));
+		int first = tMath::tClamp(lo, 0, srcSize-1);
+		int last = tMath::tClamp(hi, 0, srcSize-1);
+		float* weights = Weights + d*MaxCount;
+		float sum = 0.0f;
+		for (int s = lo; s <= hi; s++)
+		{
+			float weight = tBand::Kernel((float(s) - centre) / stretch, filter);
+			weights[tMath::tClamp(s, 0, srcSize-1) - first] += weight;
+			sum += weight;
+		}
+
+		if (sum != 0.0f)
+		{
+			for (int i = 0; i <= last - first; i++)
+				weights[i] /= sum;
+		}
+		else
+		{
+			int nearest = tMath::tClamp(int(tMath::tRound(centre)), first, last);
+			weights[nearest - first] = 1.0f;
+		}
+
+		First[d] = first;
+		Count[d] = last - first + 1;
+	}
+}
+
+
+tBandResample::tBandResample(tBandSource& source, int newWidth, int newHeight, tPicture::tFilter filter) :
+	Source(source)
+{
+	if (!Source.IsValid() || (newWidth <= 0) || (newHeight <= 0))
+		return;
+
+	Width = newWidth;
+	Height = newHeight;
+	Opaque = Source.IsOpaque();
+	AxisX.Set(Source.GetWidth(), Width, filter);
+	AxisY.Set(Source.GetHeight(), Height, filter);
+
+	// The source rows a destination row needs always fit in MaxCount consecutive rows.
+	RingSize = AxisY.MaxCount;
+	SrcRow = new tPixel[Source.GetWidth()];
+	Ring = new float[RingSize*Width*4];
+	Accum = new float[Width*4];
+}
+
+
+tBandResample::~tBandResample()
+{
+	delete[] Accum;
+	delete[] Ring;
+	delete[] SrcRow;
+}
+
+
+bool tBandResample::ReadSourceRow()
+{
+	if (!Source.Read(SrcRow, 1))
+		return false;
+
+	float* out = Ring + (SrcRowsRead % RingSize)*Width*4;
+	for (int x = 0; x < Width; x++)
+	{
+		const tPixel* src = SrcRow + AxisX.First[x];
+		const float* weights = AxisX.Weights + x*AxisX.MaxCount;
+		float r = 0.0f, g = 0.0f, b = 0.0f, a = 0.0f;
+		for (int i = 0; i < AxisX.Count[x]; i++)
+		{
+			float w = weights[i];
+			r += w*float(src[i].R);
+			g += w*float(src[i].G);
+			b += w*float(src[i].B);
+			a += w*float(src[i].A);
+		}
+		out[4*x + 0] = r;	out[4*x + 1] = g;	out[4*x + 2] = b;	out[4*x + 3] = a;
+	}
+
+	SrcRowsRead++;
+	return true;
+}
+
+
+bool tBandResample::ReadRows(tPixel* dest, int numRows)
+{
+	for (int r = 0; r < numRows; r++)
+	{
+		int y = GetRowsRead() + r;
+		int first = AxisY.First[y];
+		int count = AxisY.Count[y];
+		while (SrcRowsRead < first + count)
+			if (!ReadSourceRow())
+				return false;
+
+		tStd::tMemset(Accum, 0, Width*4*sizeof(float));
+		const float* weights = AxisY.Weights + y*AxisY.MaxCount;
+		for (int i = 0; i < count; i++)
+		{
+			float w = weights[i];
+			const float* row = Ring + ((first + i) % RingSize)*Width*4;
+			for (int c = 0; c < Width*4; c++)
+				Accum[c] += w*row[c];
+		}
+
+		// Filters with negative lobes can overshoot.
+		uint8* out = (uint8*)(dest + r*Width);
+		for (int c = 0; c < Width*4; c++)
+			out[c] = uint8(tMath::tClamp(int(Accum[c] + 0.5f), 0, 255));
+	}
+
+	return true;
+}
+
+
+tBandRotate90::tBandRotate90(tBandSource& source, bool antiClockwise, const tString& scratchFile) :
+	Source(source),
+	AntiClockwise(antiClockwise),
+	ScratchFile(scratchFile)
+{
+	if (!Source.IsValid())
+		return;
+
+	Width = Source.GetHeight();
+	Height = Source.GetWidth();
+	Opaque = Source.IsOpaque();
+	const int tileSize = TileSize;
+	NumTilesX = (Source.GetWidth() + tileSize - 1) / tileSize;
+	NumTilesY = (Source.GetHeight() + tileSize - 1) / tileSize;
+}
+
+
+tBandRotate90::~tBandRotate90()
+{
+	delete[] Strip;
+	if (File)
+	{
+		tCloseFile(File);
+		tDeleteFile(ScratchFile);
+	}
+}
+
+
+bool tBandRotate90::WriteTiles()
+{
+	File = tOpenFile(ScratchFile.ConstText(), "w+b");
+	if (!File)
+		return false;
+
+	// The tiles of each band are written left to right, so the file is written in order. Edge tiles are padded.
+	const int tileSize = TileSize;
+	int srcWidth = Source.GetWidth();
+	int srcHeight = Source.GetHeight();
+	int tileBytes = tileSize*tileSize*sizeof(tPixel);
+	tPixel* band = new tPixel[srcWidth*tileSize];
+	tPixel* tile = new tPixel[tileSize*tileSize];
+	bool ok = true;
+	for (int ty = 0; ok && (ty < NumTilesY); ty++)
+	{
+		int numRows = tMath::tMin(tileSize, srcHeight - ty*tileSize);
+		ok = Source.Read(band, numRows);
+		for (int tx = 0; ok && (tx < NumTilesX); tx++)
+		{
+			int numCols = tMath::tMin(tileSize, srcWidth - tx*tileSize);
+			tStd::tMemset(tile, 0, tileBytes);
+			for (int y = 0; y < numRows; y++)
+				tStd::tMemcpy(tile + y*tileSize, band + y*srcWidth + tx*tileSize, numCols*sizeof(tPixel));
+			ok = (tWriteFile(File, tile, tileBytes) == tileBytes);
+		}
+	}
+	delete[] tile;
+	delete[] band;
+
+	// Seeking is needed between writing and reading anyway.
+	ok = ok && (tFileSeek(File, 0, tSeekOrigin::Beginning) == 0);
+	FilePos = 0;
+	if (!ok)
+		return false;
+
+	Strip = new tPixel[NumTilesY*tileSize*tileSize];
+	return true;
+}
+
+
+bool tBandRotate90::ReadStrip(int tileX)
+{
+	const int tileSize = TileSize;
+	int tileBytes = tileSize*tileSize*sizeof(tPixel);
+	for (int ty = 0; ty < NumTilesY; ty++)
+	{
+		int64 offset = (int64(ty)*NumTilesX + tileX)*tileBytes;
+		if (!tBand::SeekRelative(File, offset - FilePos))
+			return false;
+
+		FilePos = offset;
+		if (tReadFile(File, Strip + ty*tileSize*tileSize, tileBytes) != tileBytes)
+			return false;
+		FilePos += tileBytes;
+	}
+
+	StripTileX = tileX;
+	return true;
+}
+
+
+bool tBandRotate90::ReadRows(tPixel* dest, int numRows)
+{
+	if (!Strip && !WriteTiles())
+		return false;
+
+	// Going clockwise, output row y is source column y read bottom to top. Anticlockwise it is source column
+	// width-1-y read top to bottom.
+	const int tileSize = TileSize;
+	int srcWidth = Source.GetWidth();
+	int srcHeight = Source.GetHeight();
+	for (int r = 0; r < numRows; r++)
+	{
+		int y = GetRowsRead() + r;
+		int srcX = AntiClockwise ? srcWidth - 1 - y : y;
+		int tileX = srcX / tileSize;
+		if ((tileX != StripTileX) && !ReadStrip(tileX))
+			return false;
+
+		const tPixel* column = Strip + (srcX - tileX*tileSize);
+		tPixel* out = dest + r*Width;
+		if (AntiClockwise)
+		{
+			for (int x = 0; x < Width; x++)
+				out[x] = column[x*tileSize];
+		}
+		else
+		{
+			for (int x = 0; x < Width; x++)
+				out[x] = column[(srcHeight - 1 - x)*tileSize];
+		}
+	}
+
+	return true;
+}
+
+
+tBandConvert::tBandConvert(tBandSource& source, tPixelFormat format) :
+	Source(source),
+	Format(format)
+{
+	const tPixelLayout* layout = tGetPixelLayout(Format);
+	if (!Source.IsValid() || !layout)
+		return;
+
+	Width = Source.GetWidth();
+	Height = Source.GetHeight();
+	Opaque = Source.IsOpaque() || (layout->Bits[3] == 0);
+}
+
+
+bool tBandConvert::ReadRows(tPixel* dest, int numRows)
+{
+	if (!Source.Read(dest, numRows))
+		return false;
+
+	int numPixels = numRows*Width;
+	if (numRows > ConvertedRows)
+	{
+		delete[] Converted;
+		Converted = new uint8[numPixels*tGetPixelLayout(Format)->BytesPerPixel];
+		ConvertedRows = numRows;
+	}
+
+	return
+	(
+		tConvertPixels(Converted, Format, dest, tPixelFormat::R8G8B8A8, numPixels) &&
+		tConvertPixels(dest, tPixelFormat::R8G8B8A8, Converted, Format, numPixels)
+	);
+}
+
+
+tBandPrefetch::tBandPrefetch(tBandSource& source, int bandRows, int maxBands) :
+	Source(source),
+	BandRows(tMath::tMax(bandRows, 1)),
+	MaxBands(tMath::tMax(maxBands, 1))
+{
+	if (!Source.IsValid())
+		return;
+
+	Width = Source.GetWidth();
+	Height = Source.GetHeight();
+	Opaque = Source.IsOpaque();
+	Bands = new tPixel[MaxBands*BandRows*Width];
+	BandNumRows = new int[MaxBands];
+}
+
+
+tBandPrefetch::~tBandPrefetch()
+{
+	{
+		std::lock_guard<std::mutex> lock(Mutex);
+		Stop = true;
+	}
+	Condition.notify_all();
+	if (Worker.joinable())
+		Worker.join();
+
+	delete[] BandNumRows;
+	delete[] Bands;
+}
+
+
+void tBandPrefetch::Work()
+{
+	// Bands past the ready ones belong to this thread, so they are filled without holding the lock.
+	int rowsLeft = Height;
+	while (rowsLeft > 0)
+	{
+		int slot = 0;
+		{
+			std::unique_lock<std::mutex> lock(Mutex);
+			Condition.wait(lock, [this]{ return Stop || (NumReady < MaxBands); });
+			if (Stop)
+				return;
+			slot = (Head + NumReady) % MaxBands;
+		}
+
+		int numRows = tMath::tMin(BandRows, rowsLeft);
+		bool ok = Source.Read(Bands + slot*BandRows*Width, numRows);
+		{
+			std::lock_guard<std::mutex> lock(Mutex);
+			if (ok)
+			{
+				BandNumRows[slot] = numRows;
+				NumReady++;
+			}
+			else
+			{
+				Failed = true;
+			}
+		}
+		Condition.notify_all();
+		if (!ok)
+			return;
+
+		rowsLeft -= numRows;
+	}
+}
+
+
+bool tBandPrefetch::ReadRows(tPixel* dest, int numRows)
+{
+	if (!Worker.joinable())
+		Worker = std::thread(&tBandPrefetch::Work, this);
+
+	// The head band belongs to this thread until it is handed back.
+	int done = 0;
+	while (done < numRows)
+	{
+		{
+			std::unique_lock<std::mutex> lock(Mutex);
+			Condition.wait(lock, [this]{ return Failed || (NumReady > 0); });
+			if (NumReady == 0)
+				return false;
+		}
+
+		int count = tMath::tMin(BandNumRows[Head] - HeadRowsUsed, numRows - done);
+		const tPixel* src = Bands + (Head*BandRows + HeadRowsUsed)*Width;
+		tStd::tMemcpy(dest + done*Width, src, count*Width*sizeof(tPixel));
+		HeadRowsUsed += count;
+		done += count;
+		if (HeadRowsUsed < BandNumRows[Head])
+			continue;
+
+		{
+			std::lock_guard<std::mutex> lock(Mutex);
+			Head = (Head + 1) % MaxBands;
+			NumReady--;
+			HeadRowsUsed = 0;
+		}
+		Condition.notify_all();
+	}
+
+	return true;
+}
+
+
+bool tBandPictureSink::Begin(int width, int height, bool)
+{
+	tPicture::FreePixels(Pixels);
+	Pixels = nullptr;
+	if ((width <= 0) || (height <= 0))
+		return false;
+
+	Width = width;
+	Height = height;
+	RowsWritten = 0;
+	Pixels = tPicture::AllocPixels(Width*Height);
+	return true;
+}
+
+
+bool tBandPictureSink::Write(const tPixel* rows, int numRows)
+{
+	if (!Pixels || (numRows > Height - RowsWritten))
+		return false;
+
+	for (int r = 0; r < numRows; r++)
+		tStd::tMemcpy(Pixels + (Height - 1 - RowsWritten - r)*Width, rows + r*Width, Width*sizeof(tPixel));
+
+	RowsWritten += numRows;
+	return true;
+}
+
+
+bool tBandPictureSink::End()
+{
+	if (!Pixels || (RowsWritten != Height))
+		return false;
+
+	// The picture takes ownership of the pixels.
+	Picture.Set(Width, Height, Pixels, false);
+	Pixels = nullptr;
+	return true;
+}
+
+
+tBandTGASink::tBandTGASink(const tString& tgaFile, tFileTGA::tFormat format, tFileTGA::tCompression compression) :
+	File(tgaFile),
+	Format(format),
+	Compression(compression)
+{
+}
+
+
+bool tBandTGASink::Begin(int width, int height, bool opaque)
+{
+	tFileTGA::tFormat format = Format;
+	if (format == tFileTGA::tFormat::Auto)
+		format = opaque ? tFileTGA::tFormat::Bit24 : tFileTGA::tFormat::Bit32;
+
+	Width = width;
+	return Writer.Begin(File, width, height, format, Compression);
+}
+
+
+bool tBandTGASink::Write(const tPixel* rows, int numRows)
+{
+	for (int r = 0; r < numRows; r++)
+		if (!Writer.WriteRow(rows + r*Width))
+			return false;
+
+	return true;
+}
+
+
+tBandPNGSink::tBandPNGSink(const tString& pngFile, tFilePNG::tFormat format, tFilePNG::tLevel level) :
+	File(pngFile),
+	Format(format),
+	Level(level)
+{
+}
+
+
+bool tBandPNGSink::Begin(int width, int height, bool opaque)
+{
+	tFilePNG::tFormat format = Format;
+	if (format == tFilePNG::tFormat::Auto)
+		format = opaque ? tFilePNG::tFormat::Bit24 : tFilePNG::tFormat::Bit32;
+
+	Width = width;
+	return Writer.Begin(File, width, height, format, Level);
+}
+
+
+bool tBandPNGSink::Write(const tPixel* rows, int numRows)
+{
+	for (int r = 0; r < numRows; r++)
+		if (!Writer.WriteRow(rows + r*Width))
+			return false;
+
+	return true;
+}
+
+
+bool tBandQOISink::Begin(int width, int height, bool opaque)
+{
+	int channels = 4;
+	if ((Format == tFileQOI::tFormat::Bit24) || ((Format == tFileQOI::tFormat::Auto) && opaque))
+		channels = 3;
+
+	Width = width;
+	return Writer.Begin(File, width, height, channels);
+}
+
+
+bool tBandQOISink::Write(const tPixel* rows, int numRows)
+{
+	for (int r = 0; r < numRows; r++)
+		if (!Writer.WriteRow(rows + r*Width))
+			return false;
+
+	return true;
+}
+
+
+bool tImage::tStream(tBandSink& sink, tBandSource& source, int bandRows)
+{
+	if (!source.IsValid() || (source.GetRowsRead() != 0))
+		return false;
+
+	int width = source.GetWidth();
+	int height = source.GetHeight();
+	if (!sink.Begin(width, height, source.IsOpaque()))
+		return false;
+
+	bandRows = tMath::tMax(bandRows, 1);
+	tPixel* band = new tPixel[width*bandRows];
+	bool ok = true;
+	for (int row = 0; ok && (row < height); row += bandRows)
+	{
+		int numRows = tMath::tMin(bandRows, height - row);
+		ok = source.Read(band, numRows) && sink.Write(band, numRows);
+	}
+	delete[] band;
+
+	// End is always called so the sink closes its file.
+	bool ended = sink.End();
+	return ok && ended;
+}
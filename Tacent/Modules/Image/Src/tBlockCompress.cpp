@@ -0,0 +1,2819 @@
+// tBlockCompress.cpp
+//
+// Native block compression (BCn) encoding and decoding. Encodes RGBA pixels into BC1, BC2, BC3, BC4, and BC5 blocks
+// without any external library. Any image size may be encoded. Blocks that hang over the right or bottom edge are
+// padded by repeating the last column and row. Rows of blocks are encoded in parallel and the output does not depend
+// on the number of threads. The decoder is mostly useful for measuring the error of the encoder and for previewing
+// block compressed data on the CPU.
+//
+// Copyright (c) 2020 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <System/tMachine.h>
+#include "Image/tBlockCompress.h"
+
+// SSE2 is part of the x64 baseline so no runtime check is needed.
+#ifdef ARCHITECTURE_X64
+#include <emmintrin.h>
+#define BC_USE_SSE2
+#endif
+using namespace tImage;
+
+
+namespace tBC
+{
+	// The 64 bit colour part shared by BC1, BC2, and BC3. Index 0 of a pixel selects Colour0. Pixel 0 is in the two
+	// lowest bits of Indices.
+	struct ColourBlock
+	{
+		uint16 Colour0;									// R5G6B5 with red in the high bits.
+		uint16 Colour1;
+		uint32 Indices;
+	};
+
+	// The 64 bit interpolated block used for BC3 alpha and for each channel of BC4 and BC5. Each index is 3 bits.
+	struct AlphaBlock
+	{
+		uint8 Alpha0;
+		uint8 Alpha1;
+		uint8 Indices[6];
+	};
+
+	// For every 8 bit value these hold the pair of 5 or 6 bit endpoints whose two-thirds interpolation is closest.
+	// Used to encode blocks that are a single colour far more accurately than any line fit can.
+	struct SingleColourTables
+	{
+		SingleColourTables();
+		uint8 Match5[256][2];
+		uint8 Match6[256][2];
+	};
+	const SingleColourTables& GetSingleColourTables();
+
+	template<typename PixelType> void GetBlock
+	(
+		PixelType block[16], const PixelType* pixels, int width, int height, int blockX, int blockY
+	);
+	inline int Expand5(int v)																							{ return (v << 3) | (v >> 2); }
+	inline int Expand6(int v)																							{ return (v << 2) | (v >> 4); }
+	inline uint16 Pack565(const int c[3])																				{ return uint16((c[0] << 11) | (c[1] << 5) | c[2]); }
+	void Unpack565(int c[3], uint16 colour);
+	void ColourPalette(tPixel palette[4], uint16 colour0, uint16 colour1, bool fourColour);
+
+	// Finds the nearest of the first numColours palette entries for each pixel in RGB. Pixels whose bit is set in the
+	// transparent mask get index 3 and add nothing to the error. Returns the summed squared error.
+	int FindColourIndices
+	(
+		uint32& indices, const tPixel block[16], const tPixel palette[4], int numColours, uint32 transparentMask
+	);
+
+	// Packs and orders the quantized endpoints for the mode, then finds the indices. Returns the squared error.
+	int EvaluateColour
+	(
+		ColourBlock&, const int quant[2][3], const tPixel block[16], uint32 transparentMask, bool threeColour
+	);
+	void QuantizeColour(int quant[3], const float colour[3]);
+	bool SolveColourEndpoints
+	(
+		float endpoints[2][3], const tPixel block[16], uint32 indices, uint32 transparentMask, bool threeColour
+	);
+	void FitBoundingBox(float endpoints[2][3], const tPixel block[16], uint32 transparentMask);
+	void FitPrincipalAxis(float endpoints[2][3], const tPixel block[16], uint32 transparentMask);
+	int EncodeColourBlock(ColourBlock&, const tPixel block[16], tBCQuality, bool allowTransparency);
+
+	void AlphaPalette(uint8 palette[8], int alpha0, int alpha1);
+	int FindAlphaIndices(uint8 indices[16], const uint8 values[16], const uint8 palette[8]);
+	int EvaluateAlpha(AlphaBlock&, int alpha0, int alpha1, const uint8 values[16]);
+	int EncodeAlphaBlock(AlphaBlock&, const uint8 values[16], tBCQuality);
+	void EncodeExplicitAlpha(uint8 dest[8], const tPixel block[16]);
+
+	void DecodeColourBlock(tPixel block[16], const uint8* src, bool forceFourColour);
+	void DecodeAlphaBlock(uint8 values[16], const uint8* src);
+
+	void EncodeBlock(uint8* dest, const tPixel block[16], tPixelFormat, tBCQuality);
+	void DecodeBlock(tPixel block[16], const uint8* src, tPixelFormat);
+
+	// The BC7 and BC6H partition tables. Each pixel has two bits giving its subset, with pixel 0 in the lowest bits.
+	// BC6H only uses the first 32 two-subset partitions. The anchor tables give the pixel of each subset after the
+	// first whose index is stored with its top bit implied to be zero. The first subset's anchor is always pixel 0.
+	extern const uint32 Partitions2[64];
+	extern const uint32 Partitions3[64];
+	extern const uint8 Anchors2[64];
+	extern const uint8 Anchors3[64][2];
+	extern const int Weights2[4];
+	extern const int Weights3[8];
+	extern const int Weights4[16];
+	inline const int* GetWeights(int indexBits)																			{ return (indexBits == 2) ? Weights2 : ((indexBits == 3) ? Weights3 : Weights4); }
+	inline int Interpolate(int e0, int e1, int weight)																	{ return ((64 - weight)*e0 + weight*e1 + 32) >> 6; }
+	int GetSubset(int numSubsets, int partition, int pixel);
+	uint32 GetSubsetMask(int numSubsets, int partition, int subset);
+	int GetAnchor(int numSubsets, int partition, int subset);
+
+	// Reads and writes the bit fields of a 128 bit block. The first field goes in the lowest bits of the first byte.
+	struct BitWriter
+	{
+		BitWriter(uint8* dest)																							: Dest(dest) { tStd::tMemset(dest, 0, 16); }
+		void Write(uint32 value, int numBits);
+		uint8* Dest;
+		int Pos = 0;
+	};
+	struct BitReader
+	{
+		BitReader(const uint8* src)																						: Src(src) { }
+		uint32 Read(int numBits);
+		const uint8* Src;
+		int Pos = 0;
+	};
+
+	// Fits a line through the masked values along their principal axis. The endpoints are where the values project to
+	// the ends of the line, clamped to [0, maxValue]. Only channels in the range given are written.
+	void FitLine
+	(
+		float endpoints[2][4], const float values[16][4], uint32 mask, int firstChannel, int numChannels, float maxValue
+	);
+
+	// Solves for the endpoints that best reproduce the masked values given their index weights out of 64. Returns
+	// false and leaves the endpoints alone if every value uses the same weight.
+	bool SolveLine
+	(
+		float endpoints[2][4], const float values[16][4], uint32 mask, const uint8 indices[16], const int* weights,
+		int firstChannel, int numChannels, float maxValue
+	);
+
+	// Scores every partition by how far its subsets are from lying on lines. Lower is better. RankPartitions returns
+	// the best numRanked of the first numPartitions scores with ties going to the lower partition so the choice is
+	// deterministic.
+	template<int NumChannels> void ScorePartitions(float scores[64], const float values[16][4], int numSubsets);
+	void RankPartitions(int ranked[], int numRanked, const float scores[64], int numPartitions);
+
+	// Returns the error left after fitting a line to count values given their summed moments. The moments are each
+	// channel followed by the products of each pair of channels. The channel count is a template parameter so the
+	// loops unroll.
+	template<int NumChannels> float LineResidual(const double sums[14], int count);
+
+	// Describes one of the eight BC7 modes. The colour and alpha bits do not include the p-bit.
+	struct BC7Mode
+	{
+		int NumSubsets;
+		int PartitionBits;
+		int RotationBits;
+		int IndexSelectionBits;
+		int ColourBits;
+		int AlphaBits;
+		int EndpointPBits;								// One p-bit for each endpoint.
+		int SharedPBits;								// One p-bit for each subset.
+		int IndexBits;
+		int Index2Bits;									// Modes 4 and 5 have a second set of indices.
+	};
+	extern const BC7Mode BC7Modes[8];
+
+	// A BC7 block before packing. Indices2 holds the alpha indices of modes 4 and 5. For shared p-bits both ends of a
+	// subset hold the same value.
+	struct BC7Params
+	{
+		int Mode;
+		int Partition;
+		int Rotation;
+		int IndexSelection;
+		uint8 Endpoints[3][2][4];						// [subset][end][channel] quantized without the p-bit.
+		uint8 PBits[3][2];
+		uint8 Indices[16];
+		uint8 Indices2[16];
+	};
+
+	int BC7Unquantize(int value, int bits);
+	int BC7QuantizeChannel(float value, int bits, int pBit);
+	int BC7GetEndpoint(const BC7Params&, int subset, int end, int channel);
+	int BC7GetIndexBits(const BC7Params&, bool alphaIndices);
+
+	// Quantizes the float endpoints of one subset. With pBits < 0 the p-bits are picked to minimize the endpoint
+	// error, otherwise bit 0 is used for the first end and bit 1 for the second.
+	void BC7QuantizeEndpoints
+	(
+		BC7Params&, int subset, const float endpoints[2][4], int firstChannel, int numChannels, int pBits
+	);
+
+	// Finds the indices of the masked pixels for the channels given and returns the squared error.
+	int BC7Evaluate
+	(
+		BC7Params&, int subset, uint32 mask, const tPixel block[16], int firstChannel, int numChannels,
+		bool alphaIndices
+	);
+	int BC7QuantizeAndEvaluate
+	(
+		BC7Params&, int subset, uint32 mask, const float endpoints[2][4], const tPixel block[16], int firstChannel,
+		int numChannels, bool alphaIndices, bool allPBits
+	);
+	int BC7NudgeEndpoints
+	(
+		BC7Params&, int subset, uint32 mask, const tPixel block[16], int firstChannel, int numChannels,
+		bool alphaIndices, int error
+	);
+	int BC7EncodeSubset
+	(
+		BC7Params&, int subset, uint32 mask, const float values[16][4], const tPixel block[16], int firstChannel,
+		int numChannels, bool alphaIndices, tBCQuality
+	);
+
+	// Encodes the whole block with the mode, partition, rotation, and index selection already set in the params.
+	int BC7EncodeMode(BC7Params&, const float values[16][4], const tPixel block[16], tBCQuality);
+	void BC7FixAnchor(BC7Params&, int subset, uint32 mask, int firstChannel, int numChannels, bool alphaIndices);
+	void BC7Pack(uint8* dest, const BC7Params&);
+	void EncodeBC7Block(uint8* dest, const tPixel block[16], tBCQuality);
+	void DecodeBC7Block(tPixel block[16], const uint8* src);
+
+	// Describes one of the fourteen BC6H modes, listed in the order of the specification. Transformed modes store the
+	// first endpoint in full and the others as signed deltas from it. The layout string lists the header fields from
+	// the most significant bit down, the same way the specification does. An m is the mode, d the partition, and the
+	// endpoints are named by channel followed by w and x for the first region and y and z for the second.
+	struct BC6HMode
+	{
+		int ModeValue;
+		int NumModeBits;
+		int NumRegions;
+		bool Transformed;
+		int EndpointBits;
+		int DeltaBits[3];
+		const char* Layout;
+	};
+	extern const BC6HMode BC6HModes[14];
+
+	// The layout strings parsed into a field and a bit of that field for every header bit.
+	struct BC6HLayouts
+	{
+		BC6HLayouts();
+		uint8 Field[14][82];							// 0 is the mode, 1 the partition, and 2 + endpoint*3 + channel.
+		uint8 Bit[14][82];
+		int NumBits[14];
+	};
+	const BC6HLayouts& GetBC6HLayouts();
+
+	// BC6H is always encoded as unsigned half floats so negative values become zero.
+	uint16 FloatToHalf(float);
+	float HalfToFloat(uint16);
+
+	struct BC6HParams
+	{
+		int Mode;
+		int Partition;
+		int Endpoints[2][2][3];							// [region][end][channel] quantized to the mode's endpoint bits.
+		uint8 Indices[16];
+	};
+
+	// Quantized endpoints expand to 16 bits. The values being fit are halves scaled by 64/31 so that the final
+	// multiply by 31/64 in the decoder brings them back.
+	int BC6HUnquantize(int value, int bits);
+	int BC6HQuantize(float value, int bits);
+
+	// Finds the indices and returns the squared error measured on the half float bit patterns. When restrictAnchors is
+	// set the anchor pixels only use indices with the top bit clear.
+	int64 BC6HEvaluate(BC6HParams&, const int halves[16][3], bool restrictAnchors);
+
+	// Clamps the endpoints of transformed modes so the deltas fit. Returns true if anything changed.
+	bool BC6HFitDeltas(BC6HParams&);
+	int64 BC6HEncodeMode(BC6HParams&, const float endpoints[2][2][4], const int halves[16][3]);
+	int64 BC6HEncodeRefined
+	(
+		BC6HParams&, float endpoints[2][2][4], const float values[16][4], const int halves[16][3], int numPasses
+	);
+	void BC6HPack(uint8* dest, const BC6HParams&);
+	void EncodeBC6HBlock(uint8* dest, const tColourf block[16], tBCQuality);
+	void DecodeBC6HBlock(uint16 halves[16][3], const uint8* src);
+
+}
+
+
+tBC::SingleColourTables::SingleColourTables()
+{
+	for (int v = 0; v < 256; v++)
+	{
+		int bestError5 = 256*256; int bestError6 = 256*256;
+		for (int a = 0; a < 64; a++)
+		{
+			for (int b = 0; b < 64; b++)
+			{
+				// Ties go to the closest pair of endpoints which gives the most slack if the block is not quite flat.
+				if ((a < 32) && (b < 32))
+				{
+					int error = tMath::tAbs((2*Expand5(a) + Expand5(b))/3 - v)*100 + tMath::tAbs(a - b);
+					if (error < bestError5)
+					{
+						bestError5 = error;
+						Match5[v][0] = uint8(a); Match5[v][1] = uint8(b);
+					}
+				}
+
+				int error = tMath::tAbs((2*Expand6(a) + Expand6(b))/3 - v)*100 + tMath::tAbs(a - b);
+				if (error < bestError6)
+				{
+					bestError6 = error;
+					Match6[v][0] = uint8(a); Match6[v][1] = uint8(b);
+				}
+			}
+		}
+	}
+}
+
+
+const tBC::SingleColourTables& tBC::GetSingleColourTables()
+{
+	// Function statics are initialized once in a thread-safe way.
+	static SingleColourTables tables;
+	return tables;
+}
+
+
+template<typename PixelType> void tBC::GetBlock
+(
+	PixelType block[16], const PixelType* pixels, int width, int height, int blockX, int blockY
+)
+{
+	for (int y = 0; y < 4; y++)
+	{
+		const PixelType* row = pixels + tMath::tMin(blockY*4 + y, height-1)*width;
+		for (int x = 0; x < 4; x++)
+			block[y*4 + x] = row[tMath::tMin(blockX*4 + x, width-1)];
+	}
+}
+
+
+void tBC::Unpack565(int c[3], uint16 colour)
+{
+	c[0] = Expand5((colour >> 11) & 0x1F);
+	c[1] = Expand6((colour >> 5) & 0x3F);
+	c[2] = Expand5(colour & 0x1F);
+}
+
+
+void tBC::ColourPalette(tPixel palette[4], uint16 colour0, uint16 colour1, bool fourColour)
+{
+	int c0[3]; Unpack565(c0, colour0);
+	int c1[3]; Unpack565(c1, colour1);
+	palette[0].Set(c0[0], c0[1], c0[2], 255);
+	palette[1].Set(c1[0], c1[1], c1[2], 255);
+	if (fourColour)
+	{
+		palette[2].Set((2*c0[0] + c1[0])/3, (2*c0[1] + c1[1])/3, (2*c0[2] + c1[2])/3, 255);
+		palette[3].Set((c0[0] + 2*c1[0])/3, (c0[1] + 2*c1[1])/3, (c0[2] + 2*c1[2])/3, 255);
+	}
+	else
+	{
+		palette[2].Set((c0[0] + c1[0])/2, (c0[1] + c1[1])/2, (c0[2] + c1[2])/2, 255);
+		palette[3].Set(0, 0, 0, 0);
+	}
+}
+
+
+int tBC::FindColourIndices
+(
+	uint32& indices, const tPixel block[16], const tPixel palette[4], int numColours, uint32 transparentMask
+)
+{
+	int best[16];
+	int bestIndex[16];
+
+	#ifdef BC_USE_SSE2
+	// Four pixels at a time. Each pixel is widened to 16 bits a channel so madd can square and sum pairs of channels.
+	// Alpha is masked off so it doesn't contribute.
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i rgbMask = _mm_set1_epi32(0x00FFFFFF);
+	__m128i entries[4];
+	for (int c = 0; c < numColours; c++)
+		entries[c] = _mm_unpacklo_epi8(_mm_and_si128(_mm_set1_epi32(*(const int*)&palette[c]), rgbMask), zero);
+
+	for (int group = 0; group < 4; group++)
+	{
+		__m128i pixels = _mm_and_si128(_mm_loadu_si128((const __m128i*)(block + group*4)), rgbMask);
+		__m128i lo = _mm_unpacklo_epi8(pixels, zero);
+		__m128i hi = _mm_unpackhi_epi8(pixels, zero);
+		__m128i groupBest = _mm_set1_epi32(0x7FFFFFFF);
+		__m128i groupIndex = zero;
+		for (int c = 0; c < numColours; c++)
+		{
+			__m128i dlo = _mm_sub_epi16(lo, entries[c]);
+			__m128i dhi = _mm_sub_epi16(hi, entries[c]);
+			dlo = _mm_madd_epi16(dlo, dlo);
+			dhi = _mm_madd_epi16(dhi, dhi);
+
+			// Each pixel now has r*r+g*g and b*b in neighbouring lanes. Adding the even and odd lanes gives the four
+			// distances in pixel order.
+			__m128 a = _mm_castsi128_ps(dlo);
+			__m128 b = _mm_castsi128_ps(dhi);
+			__m128i dist = _mm_add_epi32
+			(
+				_mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0))),
+				_mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)))
+			);
+
+			__m128i less = _mm_cmplt_epi32(dist, groupBest);
+			groupBest = _mm_or_si128(_mm_and_si128(less, dist), _mm_andnot_si128(less, groupBest));
+			groupIndex = _mm_or_si128(_mm_and_si128(less, _mm_set1_epi32(c)), _mm_andnot_si128(less, groupIndex));
+		}
+		_mm_storeu_si128((__m128i*)(best + group*4), groupBest);
+		_mm_storeu_si128((__m128i*)(bestIndex + group*4), groupIndex);
+	}
+
+	#else
+	for (int p = 0; p < 16; p++)
+	{
+		best[p] = 0x7FFFFFFF;
+		bestIndex[p] = 0;
+		for (int c = 0; c < numColours; c++)
+		{
+			int dr = int(block[p].R) - int(palette[c].R);
+			int dg = int(block[p].G) - int(palette[c].G);
+			int db = int(block[p].B) - int(palette[c].B);
+			int dist = dr*dr + dg*dg + db*db;
+			if (dist < best[p])
+			{
+				best[p] = dist;
+				bestIndex[p] = c;
+			}
+		}
+	}
+	#endif
+
+	int error = 0;
+	indices = 0;
+	for (int p = 0; p < 16; p++)
+	{
+		if (transparentMask & (1 << p))
+		{
+			indices |= 3 << (p*2);
+			continue;
+		}
+		indices |= uint32(bestIndex[p]) << (p*2);
+		error += best[p];
+	}
+
+	return error;
+}
+
+
+int tBC::EvaluateColour
+(
+	ColourBlock& block, const int quant[2][3], const tPixel pixels[16], uint32 transparentMask, bool threeColour
+)
+{
+	uint16 colour0 = Pack565(quant[0]);
+	uint16 colour1 = Pack565(quant[1]);
+
+	// Four colour mode needs Colour0 > Colour1 and three colour mode needs Colour0 <= Colour1. Swapping the endpoints
+	// doesn't change which colours are available, only the order. If both endpoints are equal in four colour mode
+	// the block decodes in three colour mode and index 3 would be black, so only the first three are searched.
+	if (threeColour ? (colour0 > colour1) : (colour0 < colour1))
+		tStd::tSwap(colour0, colour1);
+
+	tPixel palette[4];
+	bool fourColour = !threeColour && (colour0 != colour1);
+	ColourPalette(palette, colour0, colour1, fourColour);
+
+	block.Colour0 = colour0;
+	block.Colour1 = colour1;
+	return FindColourIndices(block.Indices, pixels, palette, fourColour ? 4 : 3, transparentMask);
+}
+
+
+void tBC::QuantizeColour(int quant[3], const float colour[3])
+{
+	quant[0] = tMath::tClamp(int(colour[0]*31.0f/255.0f + 0.5f), 0, 31);
+	quant[1] = tMath::tClamp(int(colour[1]*63.0f/255.0f + 0.5f), 0, 63);
+	quant[2] = tMath::tClamp(int(colour[2]*31.0f/255.0f + 0.5f), 0, 31);
+}
+
+
+bool tBC::SolveColourEndpoints
+(
+	float endpoints[2][3], const tPixel block[16], uint32 indices, uint32 transparentMask, bool threeColour
+)
+{
+	// Least squares fit of both endpoints given the indices. Each pixel is modelled as w*e0 + (1-w)*e1 where the
+	// weight w comes from its index.
+	const float weights4[4] = { 1.0f, 0.0f, 2.0f/3.0f, 1.0f/3.0f };
+	const float weights3[4] = { 1.0f, 0.0f, 0.5f, 0.0f };
+	const float* weights = threeColour ? weights3 : weights4;
+
+	float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+	float ax[3] = { 0.0f, 0.0f, 0.0f };
+	float bx[3] = { 0.0f, 0.0f, 0.0f };
+	for (int p = 0; p < 16; p++)
+	{
+		if (transparentMask & (1 << p))
+			continue;
+
+		float a = weights[(indices >> (p*2)) & 3];
+		float b = 1.0f - a;
+		aa += a*a; ab += a*b; bb += b*b;
+		const uint8* c = &block[p].R;
+		for (int ch = 0; ch < 3; ch++)
+		{
+			ax[ch] += a*float(c[ch]);
+			bx[ch] += b*float(c[ch]);
+		}
+	}
+
+	float det = aa*bb - ab*ab;
+	if (tMath::tAbs(det) < 1.0e-6f)
+		return false;
+
+	float invDet = 1.0f / det;
+	for (int ch = 0; ch < 3; ch++)
+	{
+		endpoints[0][ch] = tMath::tClamp((bb*ax[ch] - ab*bx[ch]) * invDet, 0.0f, 255.0f);
+		endpoints[1][ch] = tMath::tClamp((aa*bx[ch] - ab*ax[ch]) * invDet, 0.0f, 255.0f);
+	}
+	return true;
+}
+
+
+void tBC::FitBoundingBox(float endpoints[2][3], const tPixel block[16], uint32 transparentMask)
+{
+	int mn[3] = { 255, 255, 255 };
+	int mx[3] = { 0, 0, 0 };
+	int sum[3] = { 0, 0, 0 };
+	int count = 0;
+	for (int p = 0; p < 16; p++)
+	{
+		if (transparentMask & (1 << p))
+			continue;
+
+		const uint8* c = &block[p].R;
+		for (int ch = 0; ch < 3; ch++)
+		{
+			mn[ch] = tMath::tMin(mn[ch], int(c[ch]));
+			mx[ch] = tMath::tMax(mx[ch], int(c[ch]));
+			sum[ch] += c[ch];
+		}
+		count++;
+	}
+
+	// The box has four diagonals. The sign of the covariance of green and blue with red picks the one the colours
+	// actually lie along. Red is assumed to be increasing.
+	int cov[3] = { 0, 0, 0 };
+	for (int p = 0; p < 16; p++)
+	{
+		if (transparentMask & (1 << p))
+			continue;
+
+		const uint8* c = &block[p].R;
+		int dr = int(c[0])*count - sum[0];
+		cov[1] += dr * (int(c[1])*count - sum[1]) / 16;
+		cov[2] += dr * (int(c[2])*count - sum[2]) / 16;
+	}
+
+	for (int ch = 0; ch < 3; ch++)
+	{
+		float hi = float(mx[ch]);
+		float lo = float(mn[ch]);
+		if ((ch > 0) && (cov[ch] < 0))
+			tStd::tSwap(hi, lo);
+
+		// Inset the endpoints a little. The extremes are usually outliers and the interpolated colours land closer to
+		// where most of the pixels are.
+		float inset = (hi - lo) / 16.0f;
+		endpoints[0][ch] = hi - inset;
+		endpoints[1][ch] = lo + inset;
+	}
+}
+
+
+void tBC::FitPrincipalAxis(float endpoints[2][3], const tPixel block[16], uint32 transparentMask)
+{
+	float mean[3] = { 0.0f, 0.0f, 0.0f };
+	int count = 0;
+	for (int p = 0; p < 16; p++)
+	{
+		if (transparentMask & (1 << p))
+			continue;
+
+		mean[0] += block[p].R; mean[1] += block[p].G; mean[2] += block[p].B;
+		count++;
+	}
+	for (int ch = 0; ch < 3; ch++)
+		mean[ch] /= float(count);
+
+	// Covariance matrix. Symmetric so only 6 entries are needed.
+	float cov[6] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+	for (int p = 0; p < 16; p++)
+	{
+		if (transparentMask & (1 << p))
+			continue;
+
+		float r = block[p].R - mean[0];
+		float g = block[p].G - mean[1];
+		float b = block[p].B - mean[2];
+		cov[0] += r*r; cov[1] += r*g; cov[2] += r*b;
+		cov[3] += g*g; cov[4] += g*b; cov[5] += b*b;
+	}
+
+	// Power iteration for the eigenvector with the largest eigenvalue. It converges quickly enough for our purposes.
+	float axis[3] = { 1.0f, 1.0f, 1.0f };
+	for (int iter = 0; iter < 8; iter++)
+	{
+		float x = cov[0]*axis[0] + cov[1]*axis[1] + cov[2]*axis[2];
+		float y = cov[1]*axis[0] + cov[3]*axis[1] + cov[4]*axis[2];
+		float z = cov[2]*axis[0] + cov[4]*axis[1] + cov[5]*axis[2];
+		float len = tMath::tMax(tMath::tMax(tMath::tAbs(x), tMath::tAbs(y)), tMath::tAbs(z));
+		if (len < 1.0e-6f)
+			break;
+
+		axis[0] = x/len; axis[1] = y/len; axis[2] = z/len;
+	}
+
+	float lenSq = axis[0]*axis[0] + axis[1]*axis[1] + axis[2]*axis[2];
+	float tmin = 0.0f, tmax = 0.0f;
+	for (int p = 0; p < 16; p++)
+	{
+		if (transparentMask & (1 << p))
+			continue;
+
+		float t = ((block[p].R - mean[0])*axis[0] + (block[p].G - mean[1])*axis[1] + (block[p].B - mean[2])*axis[2]) / lenSq;
+		tmin = tMath::tMin(tmin, t);
+		tmax = tMath::tMax(tmax, t);
+	}
+
+	for (int ch = 0; ch < 3; ch++)
+	{
+		endpoints[0][ch] = tMath::tClamp(mean[ch] + axis[ch]*tmax, 0.0f, 255.0f);
+		endpoints[1][ch] = tMath::tClamp(mean[ch] + axis[ch]*tmin, 0.0f, 255.0f);
+	}
+}
+
+
+int tBC::EncodeColourBlock(ColourBlock& block, const tPixel pixels[16], tBCQuality quality, bool allowTransparency)
+{
+	uint32 transparentMask = 0;
+	if (allowTransparency)
+	{
+		for (int p = 0; p < 16; p++)
+			if (pixels[p].A < 128)
+				transparentMask |= 1 << p;
+	}
+
+	// Three colour mode with every index 3 is fully transparent.
+	if (transparentMask == 0xFFFF)
+	{
+		block.Colour0 = 0;
+		block.Colour1 = 0;
+		block.Indices = 0xFFFFFFFF;
+		return 0;
+	}
+	bool threeColour = (transparentMask != 0);
+
+	bool singleColour = true;
+	int first = -1;
+	for (int p = 0; p < 16; p++)
+	{
+		if (transparentMask & (1 << p))
+			continue;
+
+		if (first == -1)
+			first = p;
+		else if ((pixels[p].R != pixels[first].R) || (pixels[p].G != pixels[first].G) || (pixels[p].B != pixels[first].B))
+			singleColour = false;
+	}
+
+	int quant[2][3];
+	if (singleColour && !threeColour)
+	{
+		const SingleColourTables& tables = GetSingleColourTables();
+		const tPixel& c = pixels[first];
+		quant[0][0] = tables.Match5[c.R][0];	quant[1][0] = tables.Match5[c.R][1];
+		quant[0][1] = tables.Match6[c.G][0];	quant[1][1] = tables.Match6[c.G][1];
+		quant[0][2] = tables.Match5[c.B][0];	quant[1][2] = tables.Match5[c.B][1];
+		return EvaluateColour(block, quant, pixels, transparentMask, threeColour);
+	}
+
+	float endpoints[2][3];
+	if (quality == tBCQuality::Fast)
+		FitBoundingBox(endpoints, pixels, transparentMask);
+	else
+		FitPrincipalAxis(endpoints, pixels, transparentMask);
+
+	QuantizeColour(quant[0], endpoints[0]);
+	QuantizeColour(quant[1], endpoints[1]);
+	int bestError = EvaluateColour(block, quant, pixels, transparentMask, threeColour);
+	if ((quality == tBCQuality::Fast) || (bestError == 0))
+		return bestError;
+
+	// Refine the endpoints by fitting them to the current indices and repeating while it keeps getting better.
+	int numRefines = (quality == tBCQuality::High) ? 8 : 2;
+	for (int iter = 0; iter < numRefines; iter++)
+	{
+		if (!SolveColourEndpoints(endpoints, pixels, block.Indices, transparentMask, threeColour))
+			break;
+
+		int trial[2][3];
+		QuantizeColour(trial[0], endpoints[0]);
+		QuantizeColour(trial[1], endpoints[1]);
+
+		ColourBlock trialBlock;
+		int error = EvaluateColour(trialBlock, trial, pixels, transparentMask, threeColour);
+		if (error >= bestError)
+			break;
+
+		bestError = error;
+		block = trialBlock;
+		tStd::tMemcpy(quant, trial, sizeof(quant));
+	}
+
+	if (quality != tBCQuality::High)
+		return bestError;
+
+	// Greedy search of the neighbouring quantized endpoints. Each of the six components is nudged up and down by one
+	// and kept if it helps. This mostly fixes the rounding in QuantizeColour.
+	const int maxValue[3] = { 31, 63, 31 };
+	for (int round = 0; (round < 16) && bestError; round++)
+	{
+		bool improved = false;
+		for (int e = 0; e < 2; e++)
+		{
+			for (int ch = 0; ch < 3; ch++)
+			{
+				for (int delta = -1; delta <= 1; delta += 2)
+				{
+					int v = quant[e][ch] + delta;
+					if ((v < 0) || (v > maxValue[ch]))
+						continue;
+
+					int trial[2][3];
+					tStd::tMemcpy(trial, quant, sizeof(trial));
+					trial[e][ch] = v;
+
+					ColourBlock trialBlock;
+					int error = EvaluateColour(trialBlock, trial, pixels, transparentMask, threeColour);
+					if (error < bestError)
+					{
+						bestError = error;
+						block = trialBlock;
+						tStd::tMemcpy(quant, trial, sizeof(quant));
+						improved = true;
+					}
+				}
+			}
+		}
+
+		if (!improved)
+			break;
+	}
+
+	return bestError;
+}
+
+
+void tBC::AlphaPalette(uint8 palette[8], int alpha0, int alpha1)
+{
+	palette[0] = uint8(alpha0);
+	palette[1] = uint8(alpha1);
+	if (alpha0 > alpha1)
+	{
+		for (int i = 1; i < 7; i++)
+			palette[1+i] = uint8(((7-i)*alpha0 + i*alpha1) / 7);
+	}
+	else
+	{
+		for (int i = 1; i < 5; i++)
+			palette[1+i] = uint8(((5-i)*alpha0 + i*alpha1) / 5);
+		palette[6] = 0;
+		palette[7] = 255;
+	}
+}
+
+
+int tBC::FindAlphaIndices(uint8 indices[16], const uint8 values[16], const uint8 palette[8])
+{
+	#ifdef BC_USE_SSE2
+	// All 16 values fit in one register. Absolute differences are done with saturating subtracts both ways.
+	const __m128i zero = _mm_setzero_si128();
+	__m128i v = _mm_loadu_si128((const __m128i*)values);
+	__m128i best = _mm_set1_epi8(char(0xFF));
+	__m128i bestIndex = zero;
+	for (int i = 0; i < 8; i++)
+	{
+		__m128i p = _mm_set1_epi8(char(palette[i]));
+		__m128i diff = _mm_or_si128(_mm_subs_epu8(v, p), _mm_subs_epu8(p, v));
+
+		// diff < best exactly when best - diff doesn't saturate to zero.
+		__m128i notLess = _mm_cmpeq_epi8(_mm_subs_epu8(best, diff), zero);
+		best = _mm_min_epu8(best, diff);
+		bestIndex = _mm_or_si128(_mm_andnot_si128(notLess, _mm_set1_epi8(char(i))), _mm_and_si128(notLess, bestIndex));
+	}
+	_mm_storeu_si128((__m128i*)indices, bestIndex);
+
+	__m128i lo = _mm_unpacklo_epi8(best, zero);
+	__m128i hi = _mm_unpackhi_epi8(best, zero);
+	__m128i sq = _mm_add_epi32(_mm_madd_epi16(lo, lo), _mm_madd_epi16(hi, hi));
+	sq = _mm_add_epi32(sq, _mm_shuffle_epi32(sq, _MM_SHUFFLE(1, 0, 3, 2)));
+	sq = _mm_add_epi32(sq, _mm_shuffle_epi32(sq, _MM_SHUFFLE(2, 3, 0, 1)));
+	return _mm_cvtsi128_si32(sq);
+
+	#else
+	int error = 0;
+	for (int p = 0; p < 16; p++)
+	{
+		int best = 256;
+		indices[p] = 0;
+		for (int i = 0; i < 8; i++)
+		{
+			int diff = tMath::tAbs(int(values[p]) - int(palette[i]));
+			if (diff < best)
+			{
+				best = diff;
+				indices[p] = uint8(i);
+			}
+		}
+		error += best*best;
+	}
+	return error;
+	#endif
+}
+
+
+int tBC::EvaluateAlpha(AlphaBlock& block, int alpha0, int alpha1, const uint8 values[16])
+{
+	uint8 palette[8];
+	AlphaPalette(palette, alpha0, alpha1);
+
+	uint8 indices[16];
+	int error = FindAlphaIndices(indices, values, palette);
+
+	block.Alpha0 = uint8(alpha0);
+	block.Alpha1 = uint8(alpha1);
+	uint64 bits = 0;
+	for (int p = 0; p < 16; p++)
+		bits |= uint64(indices[p]) << (p*3);
+	for (int b = 0; b < 6; b++)
+		block.Indices[b] = uint8(bits >> (b*8));
+
+	return error;
+}
+
+
+int tBC::EncodeAlphaBlock(AlphaBlock& block, const uint8 values[16], tBCQuality quality)
+{
+	int mn = 255, mx = 0;
+	int innerMin = 255, innerMax = 0;
+	for (int p = 0; p < 16; p++)
+	{
+		int v = values[p];
+		mn = tMath::tMin(mn, v);
+		mx = tMath::tMax(mx, v);
+		if ((v != 0) && (v != 255))
+		{
+			innerMin = tMath::tMin(innerMin, v);
+			innerMax = tMath::tMax(innerMax, v);
+		}
+	}
+
+	// A flat block. Equal endpoints select the six value mode and index 0 is exact.
+	if (mn == mx)
+		return EvaluateAlpha(block, mn, mn, values);
+
+	int bestError = EvaluateAlpha(block, mx, mn, values);
+	if ((quality == tBCQuality::Fast) || (bestError == 0))
+		return bestError;
+
+	// Least-squares refinement of the eight value endpoints. Each pass fits the endpoints to the indices of the best
+	// block so far and finds the indices again. Index 0 is the first endpoint, 1 the second, and 2 to 7 step from the
+	// first to the second in sevenths.
+	AlphaBlock trial;
+	int numPasses = (quality == tBCQuality::High) ? 3 : 2;
+	for (int pass = 0; pass < numPasses; pass++)
+	{
+		if (block.Alpha0 <= block.Alpha1)
+			break;
+
+		uint64 bits = 0;
+		for (int b = 0; b < 6; b++)
+			bits |= uint64(block.Indices[b]) << (b*8);
+
+		float sumAA = 0.0f, sumAB = 0.0f, sumBB = 0.0f, sumAV = 0.0f, sumBV = 0.0f;
+		for (int p = 0; p < 16; p++)
+		{
+			int index = int(bits >> (p*3)) & 7;
+			float b = (index == 0) ? 0.0f : ((index == 1) ? 1.0f : float(index - 1) / 7.0f);
+			float a = 1.0f - b;
+			sumAA += a*a;
+			sumAB += a*b;
+			sumBB += b*b;
+			sumAV += a*float(values[p]);
+			sumBV += b*float(values[p]);
+		}
+		float det = sumAA*sumBB - sumAB*sumAB;
+		if (tMath::tAbs(det) < 1.0e-6f)
+			break;
+
+		int alpha0 = tMath::tClamp(int((sumAV*sumBB - sumAB*sumBV) / det + 0.5f), 0, 255);
+		int alpha1 = tMath::tClamp(int((sumAA*sumBV - sumAB*sumAV) / det + 0.5f), 0, 255);
+		if (alpha0 < alpha1)
+			tStd::tSwap(alpha0, alpha1);
+		if ((alpha0 == alpha1) || ((alpha0 == block.Alpha0) && (alpha1 == block.Alpha1)))
+			break;
+
+		int error = EvaluateAlpha(trial, alpha0, alpha1, values);
+		if (error >= bestError)
+			break;
+
+		bestError = error;
+		block = trial;
+	}
+
+	// The six value mode has exact 0 and 255 so the endpoints only need to span the values in between.
+	if ((mn == 0) || (mx == 255))
+	{
+		if (innerMin > innerMax)
+			innerMin = innerMax = mn;
+
+		int error = EvaluateAlpha(trial, innerMin, innerMax, values);
+		if (error < bestError)
+		{
+			bestError = error;
+			block = trial;
+		}
+	}
+
+	// Search endpoints just inside the range. The extremes are often better served by moving the interpolated
+	// values onto the bulk of the block.
+	int range = (quality == tBCQuality::High) ? 8 : 2;
+	for (int hi = mx; hi >= tMath::tMax(mx - range, mn + 1); hi--)
+	{
+		for (int lo = mn; lo <= tMath::tMin(mn + range, hi - 1); lo++)
+		{
+			if ((hi == mx) && (lo == mn))
+				continue;
+
+			int error = EvaluateAlpha(trial, hi, lo, values);
+			if (error < bestError)
+			{
+				bestError = error;
+				block = trial;
+			}
+		}
+	}
+
+	return bestError;
+}
+
+
+void tBC::EncodeExplicitAlpha(uint8 dest[8], const tPixel block[16])
+{
+	for (int p = 0; p < 16; p += 2)
+	{
+		int a0 = (block[p].A*15 + 127) / 255;
+		int a1 = (block[p+1].A*15 + 127) / 255;
+		dest[p/2] = uint8(a0 | (a1 << 4));
+	}
+}
+
+
+void tBC::EncodeBlock(uint8* dest, const tPixel block[16], tPixelFormat format, tBCQuality quality)
+{
+	switch (format)
+	{
+		case tPixelFormat::BC1_DXT1:
+			EncodeColourBlock(*(ColourBlock*)dest, block, quality, false);
+			break;
+
+		case tPixelFormat::BC1_DXT1BA:
+			EncodeColourBlock(*(ColourBlock*)dest, block, quality, true);
+			break;
+
+		case tPixelFormat::BC2_DXT3:
+			EncodeExplicitAlpha(dest, block);
+			EncodeColourBlock(*(ColourBlock*)(dest+8), block, quality, false);
+			break;
+
+		case tPixelFormat::BC3_DXT5:
+		case tPixelFormat::BC4_ATI1:
+		case tPixelFormat::BC5_ATI2:
+		{
+			// BC3 alpha comes from alpha. BC4 and BC5 encode red, and then green.
+			int channel = (format == tPixelFormat::BC3_DXT5) ? 3 : 0;
+			uint8 values[16];
+			for (int p = 0; p < 16; p++)
+				values[p] = (&block[p].R)[channel];
+			EncodeAlphaBlock(*(AlphaBlock*)dest, values, quality);
+
+			if (format == tPixelFormat::BC3_DXT5)
+			{
+				EncodeColourBlock(*(ColourBlock*)(dest+8), block, quality, false);
+			}
+			else if (format == tPixelFormat::BC5_ATI2)
+			{
+				for (int p = 0; p < 16; p++)
+					values[p] = block[p].G;
+				EncodeAlphaBlock(*(AlphaBlock*)(dest+8), values, quality);
+			}
+			break;
+		}
+
+		case tPixelFormat::BC6H:
+		{
+			// LDR pixels are treated as linear values from 0 to 1.
+			tColourf hdrBlock[16];
+			for (int p = 0; p < 16; p++)
+				hdrBlock[p].Set(block[p]);
+			EncodeBC6HBlock(dest, hdrBlock, quality);
+			break;
+		}
+
+		case tPixelFormat::BC7:
+			EncodeBC7Block(dest, block, quality);
+			break;
+
+		default:
+			break;
+	}
+}
+
+
+void tBC::DecodeColourBlock(tPixel block[16], const uint8* src, bool forceFourColour)
+{
+	const ColourBlock& colour = *(const ColourBlock*)src;
+	tPixel palette[4];
+	ColourPalette(palette, colour.Colour0, colour.Colour1, forceFourColour || (colour.Colour0 > colour.Colour1));
+	for (int p = 0; p < 16; p++)
+		block[p] = palette[(colour.Indices >> (p*2)) & 3];
+}
+
+
+void tBC::DecodeAlphaBlock(uint8 values[16], const uint8* src)
+{
+	const AlphaBlock& alpha = *(const AlphaBlock*)src;
+	uint8 palette[8];
+	AlphaPalette(palette, alpha.Alpha0, alpha.Alpha1);
+
+	uint64 bits = 0;
+	for (int b = 0; b < 6; b++)
+		bits |= uint64(alpha.Indices[b]) << (b*8);
+	for (int p = 0; p < 16; p++)
+		values[p] = palette[(bits >> (p*3)) & 7];
+}
+
+
+void tBC::DecodeBlock(tPixel block[16], const uint8* src, tPixelFormat format)
+{
+	uint8 values[16];
+	switch (format)
+	{
+		case tPixelFormat::BC1_DXT1:
+		case tPixelFormat::BC1_DXT1BA:
+			DecodeColourBlock(block, src, false);
+			break;
+
+		case tPixelFormat::BC2_DXT3:
+			DecodeColourBlock(block, src+8, true);
+			for (int p = 0; p < 16; p++)
+				block[p].A = ((src[p/2] >> ((p & 1)*4)) & 0x0F) * 17;
+			break;
+
+		case tPixelFormat::BC3_DXT5:
+			DecodeColourBlock(block, src+8, true);
+			DecodeAlphaBlock(values, src);
+			for (int p = 0; p < 16; p++)
+				block[p].A = values[p];
+			break;
+
+		case tPixelFormat::BC4_ATI1:
+			DecodeAlphaBlock(values, src);
+			for (int p = 0; p < 16; p++)
+				block[p].Set(values[p], 0, 0, 255);
+			break;
+
+		case tPixelFormat::BC5_ATI2:
+			DecodeAlphaBlock(values, src);
+			for (int p = 0; p < 16; p++)
+				block[p].Set(values[p], 0, 0, 255);
+			DecodeAlphaBlock(values, src+8);
+			for (int p = 0; p < 16; p++)
+				block[p].G = values[p];
+			break;
+
+		case tPixelFormat::BC6H:
+		{
+			// Values above 1 are clamped. Use the tColourf version of tDecodeBC to keep the full range.
+			uint16 halves[16][3];
+			DecodeBC6HBlock(halves, src);
+			for (int p = 0; p < 16; p++)
+			{
+				for (int c = 0; c < 3; c++)
+					block[p].E[c] = uint8(tMath::tClamp(HalfToFloat(halves[p][c]), 0.0f, 1.0f)*255.0f + 0.5f);
+				block[p].A = 255;
+			}
+			break;
+		}
+
+		case tPixelFormat::BC7:
+			DecodeBC7Block(block, src);
+			break;
+
+		default:
+			break;
+	}
+}
+
+
+const uint32 tBC::Partitions2[64] =
+{
+	0x50505050, 0x40404040, 0x54545454, 0x54505040, 0x50404000, 0x55545450, 0x55545040, 0x54504000,
+	0x50400000, 0x55555450, 0x55544000, 0x54400000, 0x55555440, 0x55550000, 0x55555500, 0x55000000,
+	0x55150100, 0x00004054, 0x15010000, 0x00405054, 0x00004050, 0x15050100, 0x05010000, 0x40505054,
+	0x00404050, 0x05010100, 0x14141414, 0x05141450, 0x01155440, 0x00555500, 0x15014054, 0x05414150,
+	0x44444444, 0x55005500, 0x11441144, 0x05055050, 0x05500550, 0x11114444, 0x41144114, 0x44111144,
+	0x15055054, 0x01055040, 0x05041050, 0x05455150, 0x14414114, 0x50050550, 0x41411414, 0x00141400,
+	0x00041504, 0x00105410, 0x10541000, 0x04150400, 0x50410514, 0x41051450, 0x05415014, 0x14054150,
+	0x41050514, 0x41505014, 0x40011554, 0x54150140, 0x50505500, 0x00555050, 0x15151010, 0x54540404
+};
+
+
+const uint32 tBC::Partitions3[64] =
+{
+	0xAA685050, 0x6A5A5040, 0x5A5A4200, 0x5450A0A8, 0xA5A50000, 0xA0A05050, 0x5555A0A0, 0x5A5A5050,
+	0xAA550000, 0xAA555500, 0xAAAA5500, 0x90909090, 0x94949494, 0xA4A4A4A4, 0xA9A59450, 0x2A0A4250,
+	0xA5945040, 0x0A425054, 0xA5A5A500, 0x55A0A0A0, 0xA8A85454, 0x6A6A4040, 0xA4A45000, 0x1A1A0500,
+	0x0050A4A4, 0xAAA59090, 0x14696914, 0x69691400, 0xA08585A0, 0xAA821414, 0x50A4A450, 0x6A5A0200,
+	0xA9A58000, 0x5090A0A8, 0xA8A09050, 0x24242424, 0x00AA5500, 0x24924924, 0x24499224, 0x50A50A50,
+	0x500AA550, 0xAAAA4444, 0x66660000, 0xA5A0A5A0, 0x50A050A0, 0x69286928, 0x44AAAA44, 0x66666600,
+	0xAA444444, 0x54A854A8, 0x95809580, 0x96969600, 0xA85454A8, 0x80959580, 0xAA141414, 0x96960000,
+	0xAAAA1414, 0xA05050A0, 0xA0A5A5A0, 0x96000000, 0x40804080, 0xA9A8A9A8, 0xAAAAAA44, 0x2A4A5254
+};
+
+
+const uint8 tBC::Anchors2[64] =
+{
+	15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+	15, 2, 8, 2, 2, 8, 8, 15, 2, 8, 2, 2, 8, 8, 2, 2,
+	15, 15, 6, 8, 2, 8, 15, 15, 2, 8, 2, 2, 2, 15, 15, 6,
+	6, 2, 6, 8, 15, 15, 2, 2, 15, 15, 15, 15, 15, 2, 2, 15
+};
+
+
+const uint8 tBC::Anchors3[64][2] =
+{
+	{ 3, 15 }, { 3, 8 }, { 15, 8 }, { 15, 3 }, { 8, 15 }, { 3, 15 }, { 15, 3 }, { 15, 8 },
+	{ 8, 15 }, { 8, 15 }, { 6, 15 }, { 6, 15 }, { 6, 15 }, { 5, 15 }, { 3, 15 }, { 3, 8 },
+	{ 3, 15 }, { 3, 8 }, { 8, 15 }, { 15, 3 }, { 3, 15 }, { 3, 8 }, { 6, 15 }, { 10, 8 },
+	{ 5, 3 }, { 8, 15 }, { 8, 6 }, { 6, 10 }, { 8, 15 }, { 5, 15 }, { 15, 10 }, { 15, 8 },
+	{ 8, 15 }, { 15, 3 }, { 3, 15 }, { 5, 10 }, { 6, 10 }, { 10, 8 }, { 8, 9 }, { 15, 10 },
+	{ 15, 6 }, { 3, 15 }, { 15, 8 }, { 5, 15 }, { 15, 3 }, { 15, 6 }, { 15, 6 }, { 15, 8 },
+	{ 3, 15 }, { 15, 3 }, { 5, 15 }, { 5, 15 }, { 5, 15 }, { 8, 15 }, { 5, 15 }, { 10, 15 },
+	{ 5, 15 }, { 10, 15 }, { 8, 15 }, { 13, 15 }, { 15, 3 }, { 12, 15 }, { 3, 15 }, { 3, 8 }
+};
+
+
+const int tBC::Weights2[4]		= { 0, 21, 43, 64 };
+const int tBC::Weights3[8]		= { 0, 9, 18, 27, 37, 46, 55, 64 };
+const int tBC::Weights4[16]		= { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+
+uint32 tBC::GetSubsetMask(int numSubsets, int partition, int subset)
+{
+	if (numSubsets == 1)
+		return 0xFFFF;
+
+	// Pixels whose two partition bits equal the subset have a bit set at the even position. These are then gathered
+	// into the low 16 bits.
+	uint32 partitionBits = (numSubsets == 2) ? Partitions2[partition] : Partitions3[partition];
+	uint32 low = partitionBits & 0x55555555;
+	uint32 high = (partitionBits >> 1) & 0x55555555;
+	uint32 match = ((subset & 1) ? low : (~low & 0x55555555)) & ((subset & 2) ? high : (~high & 0x55555555));
+	match = (match | (match >> 1)) & 0x33333333;
+	match = (match | (match >> 2)) & 0x0F0F0F0F;
+	match = (match | (match >> 4)) & 0x00FF00FF;
+	match = (match | (match >> 8)) & 0x0000FFFF;
+	return match;
+}
+
+
+int tBC::GetSubset(int numSubsets, int partition, int pixel)
+{
+	if (numSubsets == 1)
+		return 0;
+
+	uint32 partitionBits = (numSubsets == 2) ? Partitions2[partition] : Partitions3[partition];
+	return (partitionBits >> (pixel*2)) & 3;
+}
+
+
+int tBC::GetAnchor(int numSubsets, int partition, int subset)
+{
+	if (subset == 0)
+		return 0;
+
+	return (numSubsets == 2) ? Anchors2[partition] : Anchors3[partition][subset-1];
+}
+
+
+void tBC::BitWriter::Write(uint32 value, int numBits)
+{
+	for (int b = 0; b < numBits; b++, Pos++)
+		if (value & (1 << b))
+			Dest[Pos >> 3] |= 1 << (Pos & 7);
+}
+
+
+uint32 tBC::BitReader::Read(int numBits)
+{
+	uint32 value = 0;
+	for (int b = 0; b < numBits; b++, Pos++)
+		value |= uint32((Src[Pos >> 3] >> (Pos & 7)) & 1) << b;
+
+	return value;
+}
+
+
+void tBC::FitLine
+(
+	float endpoints[2][4], const float values[16][4], uint32 mask, int firstChannel, int numChannels, float maxValue
+)
+{
+	int lastChannel = firstChannel + numChannels;
+	float mean[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	int count = 0;
+	for (int p = 0; p < 16; p++)
+	{
+		if (!(mask & (1 << p)))
+			continue;
+		for (int c = firstChannel; c < lastChannel; c++)
+			mean[c] += values[p][c];
+		count++;
+	}
+	for (int c = firstChannel; c < lastChannel; c++)
+		mean[c] /= float(tMath::tMax(count, 1));
+
+	float covariance[4][4] = { };
+	for (int p = 0; p < 16; p++)
+	{
+		if (!(mask & (1 << p)))
+			continue;
+		for (int i = firstChannel; i < lastChannel; i++)
+			for (int j = i; j < lastChannel; j++)
+				covariance[i][j] += (values[p][i] - mean[i]) * (values[p][j] - mean[j]);
+	}
+	for (int i = firstChannel; i < lastChannel; i++)
+		for (int j = firstChannel; j < i; j++)
+			covariance[i][j] = covariance[j][i];
+
+	// The power iteration starts on the channel with the most variance. A flat block has no axis.
+	int start = firstChannel;
+	for (int c = firstChannel; c < lastChannel; c++)
+		if (covariance[c][c] > covariance[start][start])
+			start = c;
+
+	float axis[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	if (covariance[start][start] > 0.0f)
+	{
+		for (int c = firstChannel; c < lastChannel; c++)
+			axis[c] = covariance[start][c];
+
+		for (int iter = 0; iter < 8; iter++)
+		{
+			float next[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+			float largest = 0.0f;
+			for (int i = firstChannel; i < lastChannel; i++)
+			{
+				for (int j = firstChannel; j < lastChannel; j++)
+					next[i] += covariance[i][j] * axis[j];
+				largest = tMath::tMax(largest, tMath::tAbs(next[i]));
+			}
+			if (largest <= 0.0f)
+				break;
+			for (int c = firstChannel; c < lastChannel; c++)
+				axis[c] = next[c] / largest;
+		}
+	}
+
+	float lengthSq = 0.0f;
+	for (int c = firstChannel; c < lastChannel; c++)
+		lengthSq += axis[c]*axis[c];
+
+	float minT = 0.0f; float maxT = 0.0f;
+	if (lengthSq > 0.0f)
+	{
+		minT = 1.0e30f; maxT = -1.0e30f;
+		for (int p = 0; p < 16; p++)
+		{
+			if (!(mask & (1 << p)))
+				continue;
+			float t = 0.0f;
+			for (int c = firstChannel; c < lastChannel; c++)
+				t += (values[p][c] - mean[c]) * axis[c];
+			minT = tMath::tMin(minT, t);
+			maxT = tMath::tMax(maxT, t);
+		}
+		minT /= lengthSq;
+		maxT /= lengthSq;
+	}
+
+	for (int c = firstChannel; c < lastChannel; c++)
+	{
+		endpoints[0][c] = tMath::tClamp(mean[c] + axis[c]*minT, 0.0f, maxValue);
+		endpoints[1][c] = tMath::tClamp(mean[c] + axis[c]*maxT, 0.0f, maxValue);
+	}
+}
+
+
+bool tBC::SolveLine
+(
+	float endpoints[2][4], const float values[16][4], uint32 mask, const uint8 indices[16], const int* weights,
+	int firstChannel, int numChannels, float maxValue
+)
+{
+	int lastChannel = firstChannel + numChannels;
+	float aa = 0.0f; float ab = 0.0f; float bb = 0.0f;
+	float ax[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	float bx[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	for (int p = 0; p < 16; p++)
+	{
+		if (!(mask & (1 << p)))
+			continue;
+
+		float b = float(weights[indices[p]]) / 64.0f;
+		float a = 1.0f - b;
+		aa += a*a; ab += a*b; bb += b*b;
+		for (int c = firstChannel; c < lastChannel; c++)
+		{
+			ax[c] += a*values[p][c];
+			bx[c] += b*values[p][c];
+		}
+	}
+
+	float det = aa*bb - ab*ab;
+	if (tMath::tAbs(det) < 1.0e-6f)
+		return false;
+
+	float invDet = 1.0f / det;
+	for (int c = firstChannel; c < lastChannel; c++)
+	{
+		endpoints[0][c] = tMath::tClamp((bb*ax[c] - ab*bx[c]) * invDet, 0.0f, maxValue);
+		endpoints[1][c] = tMath::tClamp((aa*bx[c] - ab*ax[c]) * invDet, 0.0f, maxValue);
+	}
+	return true;
+}
+
+
+template<int NumChannels> float tBC::LineResidual(const double sums[14], int count)
+{
+	// The error left after fitting a line is the total variance less the variance along the principal axis. Once the
+	// covariance is found in doubles it is scaled by the trace so the power iteration can run in floats.
+	if (count <= 2)
+		return 0.0f;
+
+	double covariance[4][4];
+	double trace = 0.0;
+	double invCount = 1.0 / double(count);
+	int start = 0;
+	for (int i = 0, m = NumChannels; i < NumChannels; i++)
+	{
+		for (int j = i; j < NumChannels; j++, m++)
+			covariance[i][j] = covariance[j][i] = sums[m] - sums[i]*sums[j]*invCount;
+		trace += covariance[i][i];
+		if (covariance[i][i] > covariance[start][start])
+			start = i;
+	}
+	if (trace <= 0.0)
+		return 0.0f;
+
+	float scaled[4][4];
+	float invTrace = float(1.0 / trace);
+	for (int i = 0; i < NumChannels; i++)
+		for (int j = 0; j < NumChannels; j++)
+			scaled[i][j] = float(covariance[i][j]) * invTrace;
+
+	float axis[4];
+	for (int c = 0; c < NumChannels; c++)
+		axis[c] = scaled[start][c];
+
+	for (int iter = 0; iter < 2; iter++)
+	{
+		float next[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		for (int i = 0; i < NumChannels; i++)
+			for (int j = 0; j < NumChannels; j++)
+				next[i] += scaled[i][j] * axis[j];
+		for (int c = 0; c < NumChannels; c++)
+			axis[c] = next[c];
+	}
+
+	// The Rayleigh quotient never overestimates the largest eigenvalue.
+	float dot = 0.0f; float lengthSq = 0.0f;
+	for (int i = 0; i < NumChannels; i++)
+	{
+		float next = 0.0f;
+		for (int j = 0; j < NumChannels; j++)
+			next += scaled[i][j] * axis[j];
+		dot += next*axis[i];
+		lengthSq += axis[i]*axis[i];
+	}
+	if (lengthSq <= 0.0f)
+		return float(trace);
+
+	return float(trace) * tMath::tMax(1.0f - dot/lengthSq, 0.0f);
+}
+
+
+template<int NumChannels> void tBC::ScorePartitions(float scores[64], const float values[16][4], int numSubsets)
+{
+	// Doubles are used because the BC6H values are large enough that the covariance would lose too much precision in
+	// floats. The moments are summed for every combination of pixels within each row so the sums for any subset only
+	// take four lookups. The last subset's sums are whatever the other subsets leave of the total.
+	const int numMoments = NumChannels + NumChannels*(NumChannels+1)/2;
+	double rowSums[4][16][numMoments];
+	const int rowCounts[16] = { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
+	for (int row = 0; row < 4; row++)
+	{
+		for (int m = 0; m < numMoments; m++)
+			rowSums[row][0][m] = 0.0;
+
+		for (int pattern = 1; pattern < 16; pattern++)
+		{
+			int lowest = 0;
+			while (!(pattern & (1 << lowest)))
+				lowest++;
+
+			const float* value = values[row*4 + lowest];
+			const double* rest = rowSums[row][pattern & (pattern - 1)];
+			double* sums = rowSums[row][pattern];
+			int m = 0;
+			for (int c = 0; c < NumChannels; c++, m++)
+				sums[m] = rest[m] + value[c];
+			for (int a = 0; a < NumChannels; a++)
+				for (int b = a; b < NumChannels; b++, m++)
+					sums[m] = rest[m] + double(value[a])*double(value[b]);
+		}
+	}
+
+	double total[numMoments];
+	for (int m = 0; m < numMoments; m++)
+		total[m] = rowSums[0][15][m] + rowSums[1][15][m] + rowSums[2][15][m] + rowSums[3][15][m];
+
+	for (int partition = 0; partition < 64; partition++)
+	{
+		double remaining[numMoments];
+		for (int m = 0; m < numMoments; m++)
+			remaining[m] = total[m];
+		int remainingCount = 16;
+		scores[partition] = 0.0f;
+		for (int subset = 0; subset < numSubsets - 1; subset++)
+		{
+			uint32 mask = GetSubsetMask(numSubsets, partition, subset);
+			const double* row0 = rowSums[0][mask & 0xF];
+			const double* row1 = rowSums[1][(mask >> 4) & 0xF];
+			const double* row2 = rowSums[2][(mask >> 8) & 0xF];
+			const double* row3 = rowSums[3][(mask >> 12) & 0xF];
+			double sums[14];
+			for (int m = 0; m < numMoments; m++)
+			{
+				sums[m] = row0[m] + row1[m] + row2[m] + row3[m];
+				remaining[m] -= sums[m];
+			}
+
+			int count =
+				rowCounts[mask & 0xF] + rowCounts[(mask >> 4) & 0xF] +
+				rowCounts[(mask >> 8) & 0xF] + rowCounts[(mask >> 12) & 0xF];
+			remainingCount -= count;
+			scores[partition] += LineResidual<NumChannels>(sums, count);
+		}
+		scores[partition] += LineResidual<NumChannels>(remaining, remainingCount);
+	}
+}
+
+
+void tBC::RankPartitions(int ranked[], int numRanked, const float scores[64], int numPartitions)
+{
+	uint64 taken = 0;
+	for (int r = 0; r < numRanked; r++)
+	{
+		int best = -1;
+		for (int partition = 0; partition < numPartitions; partition++)
+			if (!(taken & (uint64(1) << partition)) && ((best < 0) || (scores[partition] < scores[best])))
+				best = partition;
+
+		ranked[r] = best;
+		taken |= uint64(1) << best;
+	}
+}
+
+
+const tBC::BC7Mode tBC::BC7Modes[8] =
+{
+	//	Subsets	Part	Rot	ISel	Colour	Alpha	EPBits	SPBits	Index	Index2
+	{	3,		4,		0,	0,		4,		0,		1,		0,		3,		0 },
+	{	2,		6,		0,	0,		6,		0,		0,		1,		3,		0 },
+	{	3,		6,		0,	0,		5,		0,		0,		0,		2,		0 },
+	{	2,		6,		0,	0,		7,		0,		1,		0,		2,		0 },
+	{	1,		0,		2,	1,		5,		6,		0,		0,		2,		3 },
+	{	1,		0,		2,	0,		7,		8,		0,		0,		2,		2 },
+	{	1,		0,		0,	0,		7,		7,		1,		0,		4,		0 },
+	{	2,		6,		0,	0,		5,		5,		1,		0,		2,		0 }
+};
+
+
+int tBC::BC7Unquantize(int value, int bits)
+{
+	value <<= (8 - bits);
+	return value | (value >> bits);
+}
+
+
+int tBC::BC7QuantizeChannel(float value, int bits, int pBit)
+{
+	// The expansion to 8 bits is not quite linear so the neighbours of the first guess are checked too.
+	int maxQuant = (1 << bits) - 1;
+	int guess = (pBit < 0) ?
+		int(value * float(maxQuant) / 255.0f + 0.5f) :
+		int((value * float((2 << bits) - 1) / 255.0f - float(pBit)) * 0.5f + 0.5f);
+
+	int best = 0;
+	float bestError = 1.0e30f;
+	for (int q = tMath::tMax(guess - 1, 0); q <= tMath::tMin(guess + 1, maxQuant); q++)
+	{
+		int expanded = (pBit < 0) ? BC7Unquantize(q, bits) : BC7Unquantize((q << 1) | pBit, bits + 1);
+		float error = tMath::tAbs(float(expanded) - value);
+		if (error < bestError)
+		{
+			bestError = error;
+			best = q;
+		}
+	}
+	return best;
+}
+
+
+int tBC::BC7GetEndpoint(const BC7Params& params, int subset, int end, int channel)
+{
+	const BC7Mode& mode = BC7Modes[params.Mode];
+	int bits = (channel < 3) ? mode.ColourBits : mode.AlphaBits;
+	if (!bits)
+		return 255;
+
+	int value = params.Endpoints[subset][end][channel];
+	if (mode.EndpointPBits || mode.SharedPBits)
+	{
+		value = (value << 1) | params.PBits[subset][end];
+		bits++;
+	}
+	return BC7Unquantize(value, bits);
+}
+
+
+int tBC::BC7GetIndexBits(const BC7Params& params, bool alphaIndices)
+{
+	// The index selection bit of mode 4 swaps which set of indices the colour and alpha use.
+	const BC7Mode& mode = BC7Modes[params.Mode];
+	bool second = (alphaIndices != (params.IndexSelection != 0));
+	return second ? mode.Index2Bits : mode.IndexBits;
+}
+
+
+void tBC::BC7QuantizeEndpoints
+(
+	BC7Params& params, int subset, const float endpoints[2][4], int firstChannel, int numChannels, int pBits
+)
+{
+	const BC7Mode& mode = BC7Modes[params.Mode];
+	int lastChannel = firstChannel + numChannels;
+	if (!mode.EndpointPBits && !mode.SharedPBits)
+	{
+		for (int end = 0; end < 2; end++)
+		{
+			for (int c = firstChannel; c < lastChannel; c++)
+			{
+				int bits = (c < 3) ? mode.ColourBits : mode.AlphaBits;
+				params.Endpoints[subset][end][c] = uint8(BC7QuantizeChannel(endpoints[end][c], bits, -1));
+			}
+			params.PBits[subset][end] = 0;
+		}
+		return;
+	}
+
+	// Unless told which to use, the p-bits are picked to land the channels closest. A shared p-bit has to suit both
+	// ends.
+	int quant[2][2][4];
+	float errors[2][2] = { };
+	for (int end = 0; end < 2; end++)
+	{
+		for (int p = 0; p < 2; p++)
+		{
+			for (int c = firstChannel; c < lastChannel; c++)
+			{
+				int bits = (c < 3) ? mode.ColourBits : mode.AlphaBits;
+				quant[end][p][c] = BC7QuantizeChannel(endpoints[end][c], bits, p);
+				float diff = float(BC7Unquantize((quant[end][p][c] << 1) | p, bits + 1)) - endpoints[end][c];
+				errors[end][p] += diff*diff;
+			}
+		}
+	}
+
+	int chosen[2];
+	if (pBits >= 0)
+	{
+		chosen[0] = pBits & 1;
+		chosen[1] = mode.SharedPBits ? (pBits & 1) : ((pBits >> 1) & 1);
+	}
+	else if (mode.SharedPBits)
+	{
+		chosen[0] = chosen[1] = ((errors[0][0] + errors[1][0]) <= (errors[0][1] + errors[1][1])) ? 0 : 1;
+	}
+	else
+	{
+		for (int end = 0; end < 2; end++)
+			chosen[end] = (errors[end][0] <= errors[end][1]) ? 0 : 1;
+	}
+
+	for (int end = 0; end < 2; end++)
+	{
+		for (int c = firstChannel; c < lastChannel; c++)
+			params.Endpoints[subset][end][c] = uint8(quant[end][chosen[end]][c]);
+		params.PBits[subset][end] = uint8(chosen[end]);
+	}
+}
+
+
+int tBC::BC7Evaluate
+(
+	BC7Params& params, int subset, uint32 mask, const tPixel block[16], int firstChannel, int numChannels,
+	bool alphaIndices
+)
+{
+	int indexBits = BC7GetIndexBits(params, alphaIndices);
+	uint8* indices = alphaIndices ? params.Indices2 : params.Indices;
+	const int* weights = GetWeights(indexBits);
+	int numEntries = 1 << indexBits;
+	int lastChannel = firstChannel + numChannels;
+
+	int palette[16][4];
+	for (int c = firstChannel; c < lastChannel; c++)
+	{
+		int e0 = BC7GetEndpoint(params, subset, 0, c);
+		int e1 = BC7GetEndpoint(params, subset, 1, c);
+		for (int i = 0; i < numEntries; i++)
+			palette[i][c] = Interpolate(e0, e1, weights[i]);
+	}
+
+	// The palette lies along a line so each pixel is projected onto it and only the nearest entries are checked.
+	float direction[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	float lengthSq = 0.0f;
+	for (int c = firstChannel; c < lastChannel; c++)
+	{
+		direction[c] = float(palette[numEntries-1][c] - palette[0][c]);
+		lengthSq += direction[c]*direction[c];
+	}
+	float scale = (lengthSq > 0.0f) ? float(numEntries-1) / lengthSq : 0.0f;
+
+	int error = 0;
+	for (int p = 0; p < 16; p++)
+	{
+		if (!(mask & (1 << p)))
+			continue;
+
+		float t = 0.0f;
+		for (int c = firstChannel; c < lastChannel; c++)
+			t += float(int(block[p].E[c]) - palette[0][c]) * direction[c];
+		int guess = tMath::tClamp(int(t*scale + 0.5f), 0, numEntries-1);
+
+		int bestError = 0x7FFFFFFF;
+		int bestIndex = 0;
+		for (int i = tMath::tMax(guess-1, 0); i <= tMath::tMin(guess+1, numEntries-1); i++)
+		{
+			int pixelError = 0;
+			for (int c = firstChannel; c < lastChannel; c++)
+			{
+				int diff = palette[i][c] - int(block[p].E[c]);
+				pixelError += diff*diff;
+			}
+			if (pixelError < bestError)
+			{
+				bestError = pixelError;
+				bestIndex = i;
+			}
+		}
+		indices[p] = uint8(bestIndex);
+		error += bestError;
+	}
+	return error;
+}
+
+
+int tBC::BC7QuantizeAndEvaluate
+(
+	BC7Params& params, int subset, uint32 mask, const float endpoints[2][4], const tPixel block[16], int firstChannel,
+	int numChannels, bool alphaIndices, bool allPBits
+)
+{
+	const BC7Mode& mode = BC7Modes[params.Mode];
+	int numCombinations = mode.EndpointPBits ? 4 : (mode.SharedPBits ? 2 : 0);
+	if (!allPBits || !numCombinations)
+	{
+		BC7QuantizeEndpoints(params, subset, endpoints, firstChannel, numChannels, -1);
+		return BC7Evaluate(params, subset, mask, block, firstChannel, numChannels, alphaIndices);
+	}
+
+	BC7Params best = params;
+	int bestError = 0x7FFFFFFF;
+	for (int pBits = 0; pBits < numCombinations; pBits++)
+	{
+		BC7Params trial = params;
+		BC7QuantizeEndpoints(trial, subset, endpoints, firstChannel, numChannels, pBits);
+		int error = BC7Evaluate(trial, subset, mask, block, firstChannel, numChannels, alphaIndices);
+		if (error < bestError)
+		{
+			bestError = error;
+			best = trial;
+		}
+	}
+	params = best;
+	return bestError;
+}
+
+
+int tBC::BC7NudgeEndpoints
+(
+	BC7Params& params, int subset, uint32 mask, const tPixel block[16], int firstChannel, int numChannels,
+	bool alphaIndices, int error
+)
+{
+	// Tries moving each quantized endpoint component up and down by one step and keeps any change that helps.
+	const BC7Mode& mode = BC7Modes[params.Mode];
+	for (int end = 0; end < 2; end++)
+	{
+		for (int c = firstChannel; c < firstChannel + numChannels; c++)
+		{
+			int maxQuant = (1 << ((c < 3) ? mode.ColourBits : mode.AlphaBits)) - 1;
+			for (int step = -1; step <= 1; step += 2)
+			{
+				int value = params.Endpoints[subset][end][c] + step;
+				if ((value < 0) || (value > maxQuant))
+					continue;
+
+				BC7Params trial = params;
+				trial.Endpoints[subset][end][c] = uint8(value);
+				int trialError = BC7Evaluate(trial, subset, mask, block, firstChannel, numChannels, alphaIndices);
+				if (trialError < error)
+				{
+					error = trialError;
+					params = trial;
+				}
+			}
+		}
+	}
+	return error;
+}
+
+
+int tBC::BC7EncodeSubset
+(
+	BC7Params& params, int subset, uint32 mask, const float values[16][4], const tPixel block[16], int firstChannel,
+	int numChannels, bool alphaIndices, tBCQuality quality
+)
+{
+	bool high = (quality == tBCQuality::High);
+	float endpoints[2][4];
+	FitLine(endpoints, values, mask, firstChannel, numChannels, 255.0f);
+	int error = BC7QuantizeAndEvaluate
+	(
+		params, subset, mask, endpoints, block, firstChannel, numChannels, alphaIndices, high
+	);
+
+	// Least-squares refinement. Each pass refits the endpoints to the indices just chosen.
+	int numPasses = (quality == tBCQuality::Fast) ? 1 : (high ? 4 : 2);
+	const int* weights = GetWeights(BC7GetIndexBits(params, alphaIndices));
+	for (int pass = 0; (pass < numPasses) && (error > 0); pass++)
+	{
+		const uint8* indices = alphaIndices ? params.Indices2 : params.Indices;
+		if (!SolveLine(endpoints, values, mask, indices, weights, firstChannel, numChannels, 255.0f))
+			break;
+
+		BC7Params trial = params;
+		int trialError = BC7QuantizeAndEvaluate
+		(
+			trial, subset, mask, endpoints, block, firstChannel, numChannels, alphaIndices, high
+		);
+		if (trialError >= error)
+			break;
+
+		error = trialError;
+		params = trial;
+	}
+
+	if (high && (error > 0))
+		error = BC7NudgeEndpoints(params, subset, mask, block, firstChannel, numChannels, alphaIndices, error);
+
+	return error;
+}
+
+
+int tBC::BC7EncodeMode(BC7Params& params, const float values[16][4], const tPixel block[16], tBCQuality quality)
+{
+	const BC7Mode& mode = BC7Modes[params.Mode];
+	if (!mode.Index2Bits)
+	{
+		int numChannels = mode.AlphaBits ? 4 : 3;
+		int error = 0;
+		for (int subset = 0; subset < mode.NumSubsets; subset++)
+		{
+			uint32 mask = GetSubsetMask(mode.NumSubsets, params.Partition, subset);
+			error += BC7EncodeSubset(params, subset, mask, values, block, 0, numChannels, false, quality);
+		}
+		return error;
+	}
+
+	// Modes 4 and 5 give alpha its own indices. A rotation swaps alpha with one of the colour channels first so that
+	// channel gets the separate indices instead.
+	if (!params.Rotation)
+		return
+			BC7EncodeSubset(params, 0, 0xFFFF, values, block, 0, 3, false, quality) +
+			BC7EncodeSubset(params, 0, 0xFFFF, values, block, 3, 1, true, quality);
+
+	float rotatedValues[16][4];
+	tPixel rotatedBlock[16];
+	int swap = params.Rotation - 1;
+	for (int p = 0; p < 16; p++)
+	{
+		rotatedBlock[p] = block[p];
+		tStd::tSwap(rotatedBlock[p].E[swap], rotatedBlock[p].A);
+		for (int c = 0; c < 4; c++)
+			rotatedValues[p][c] = float(rotatedBlock[p].E[c]);
+	}
+
+	return
+		BC7EncodeSubset(params, 0, 0xFFFF, rotatedValues, rotatedBlock, 0, 3, false, quality) +
+		BC7EncodeSubset(params, 0, 0xFFFF, rotatedValues, rotatedBlock, 3, 1, true, quality);
+}
+
+
+void tBC::BC7FixAnchor(BC7Params& params, int subset, uint32 mask, int firstChannel, int numChannels, bool alphaIndices)
+{
+	// The anchor index is stored without its top bit. If that bit is set, swapping the endpoints and inverting the
+	// indices gives exactly the same colours with the bit clear.
+	const BC7Mode& mode = BC7Modes[params.Mode];
+	int indexBits = BC7GetIndexBits(params, alphaIndices);
+	uint8* indices = alphaIndices ? params.Indices2 : params.Indices;
+	int anchor = GetAnchor(mode.NumSubsets, params.Partition, subset);
+	if (!(indices[anchor] & (1 << (indexBits - 1))))
+		return;
+
+	for (int c = firstChannel; c < firstChannel + numChannels; c++)
+		tStd::tSwap(params.Endpoints[subset][0][c], params.Endpoints[subset][1][c]);
+	if (!mode.Index2Bits)
+		tStd::tSwap(params.PBits[subset][0], params.PBits[subset][1]);
+
+	int maxIndex = (1 << indexBits) - 1;
+	for (int p = 0; p < 16; p++)
+		if (mask & (1 << p))
+			indices[p] = uint8(maxIndex - indices[p]);
+}
+
+
+void tBC::BC7Pack(uint8* dest, const BC7Params& src)
+{
+	BC7Params params = src;
+	const BC7Mode& mode = BC7Modes[params.Mode];
+	if (mode.Index2Bits)
+	{
+		BC7FixAnchor(params, 0, 0xFFFF, 0, 3, false);
+		BC7FixAnchor(params, 0, 0xFFFF, 3, 1, true);
+	}
+	else
+	{
+		for (int subset = 0; subset < mode.NumSubsets; subset++)
+			BC7FixAnchor(params, subset, GetSubsetMask(mode.NumSubsets, params.Partition, subset), 0, 4, false);
+	}
+
+	BitWriter writer(dest);
+	writer.Write(1 << params.Mode, params.Mode + 1);
+	writer.Write(params.Partition, mode.PartitionBits);
+	writer.Write(params.Rotation, mode.RotationBits);
+	writer.Write(params.IndexSelection, mode.IndexSelectionBits);
+
+	for (int c = 0; c < 4; c++)
+	{
+		int bits = (c < 3) ? mode.ColourBits : mode.AlphaBits;
+		for (int subset = 0; subset < mode.NumSubsets; subset++)
+			for (int end = 0; end < 2; end++)
+				writer.Write(params.Endpoints[subset][end][c], bits);
+	}
+
+	for (int subset = 0; subset < mode.NumSubsets; subset++)
+	{
+		if (mode.EndpointPBits)
+		{
+			writer.Write(params.PBits[subset][0], 1);
+			writer.Write(params.PBits[subset][1], 1);
+		}
+		else if (mode.SharedPBits)
+		{
+			writer.Write(params.PBits[subset][0], 1);
+		}
+	}
+
+	if (mode.Index2Bits)
+	{
+		// The first set of indices in the block is always the one with IndexBits.
+		const uint8* first = params.IndexSelection ? params.Indices2 : params.Indices;
+		const uint8* second = params.IndexSelection ? params.Indices : params.Indices2;
+		for (int p = 0; p < 16; p++)
+			writer.Write(first[p], mode.IndexBits - (p ? 0 : 1));
+		for (int p = 0; p < 16; p++)
+			writer.Write(second[p], mode.Index2Bits - (p ? 0 : 1));
+	}
+	else
+	{
+		for (int p = 0; p < 16; p++)
+		{
+			int subset = GetSubset(mode.NumSubsets, params.Partition, p);
+			bool anchor = (p == GetAnchor(mode.NumSubsets, params.Partition, subset));
+			writer.Write(params.Indices[p], mode.IndexBits - (anchor ? 1 : 0));
+		}
+	}
+}
+
+
+void tBC::EncodeBC7Block(uint8* dest, const tPixel block[16], tBCQuality quality)
+{
+	float values[16][4];
+	bool opaque = true;
+	for (int p = 0; p < 16; p++)
+	{
+		for (int c = 0; c < 4; c++)
+			values[p][c] = float(block[p].E[c]);
+		if (block[p].A != 255)
+			opaque = false;
+	}
+
+	BC7Params best;
+	int bestError = 0x7FFFFFFF;
+	auto tryMode = [&](int modeIndex, int partition, int rotation, int indexSelection)
+	{
+		BC7Params params;
+		tStd::tMemset(&params, 0, sizeof(params));
+		params.Mode = modeIndex;
+		params.Partition = partition;
+		params.Rotation = rotation;
+		params.IndexSelection = indexSelection;
+		int error = BC7EncodeMode(params, values, block, quality);
+		if (error < bestError)
+		{
+			bestError = error;
+			best = params;
+		}
+	};
+
+	// Mode 6 has a single subset with 7 bit RGBA endpoints and 4 bit indices. It does well on smooth blocks and is the
+	// only mode fast quality tries.
+	tryMode(6, 0, 0, 0);
+	if ((quality != tBCQuality::Fast) && (bestError > 0))
+	{
+		bool high = (quality == tBCQuality::High);
+		int ranked[8];
+		float scores[64];
+		if (opaque)
+		{
+			// The opaque modes. Alpha is implied to be 255 so all the bits go to colour. Mode 0 can only use the
+			// first 16 of the three subset partitions.
+			int numRanked = high ? 8 : 2;
+			ScorePartitions<3>(scores, values, 2);
+			RankPartitions(ranked, numRanked, scores, 64);
+			for (int r = 0; r < numRanked; r++)
+			{
+				tryMode(1, ranked[r], 0, 0);
+				tryMode(3, ranked[r], 0, 0);
+			}
+
+			numRanked = high ? 4 : 1;
+			ScorePartitions<3>(scores, values, 3);
+			RankPartitions(ranked, numRanked, scores, 64);
+			for (int r = 0; r < numRanked; r++)
+				tryMode(2, ranked[r], 0, 0);
+
+			RankPartitions(ranked, numRanked, scores, 16);
+			for (int r = 0; r < numRanked; r++)
+				tryMode(0, ranked[r], 0, 0);
+		}
+		else
+		{
+			int numRanked = high ? 8 : 2;
+			ScorePartitions<4>(scores, values, 2);
+			RankPartitions(ranked, numRanked, scores, 64);
+			for (int r = 0; r < numRanked; r++)
+				tryMode(7, ranked[r], 0, 0);
+		}
+
+		// Modes 4 and 5. Opaque blocks only benefit when a rotation moves a colour channel into the alpha slot.
+		if (!opaque || high)
+		{
+			for (int rotation = opaque ? 1 : 0; rotation < (high ? 4 : 1); rotation++)
+			{
+				tryMode(5, 0, rotation, 0);
+				tryMode(4, 0, rotation, 0);
+				if (high)
+					tryMode(4, 0, rotation, 1);
+			}
+		}
+	}
+
+	BC7Pack(dest, best);
+}
+
+
+void tBC::DecodeBC7Block(tPixel block[16], const uint8* src)
+{
+	int modeIndex = 0;
+	while ((modeIndex < 8) && !(src[0] & (1 << modeIndex)))
+		modeIndex++;
+
+	// The reserved mode decodes to transparent black.
+	if (modeIndex == 8)
+	{
+		for (int p = 0; p < 16; p++)
+			block[p].Set(0, 0, 0, 0);
+		return;
+	}
+
+	const BC7Mode& mode = BC7Modes[modeIndex];
+	BC7Params params;
+	tStd::tMemset(&params, 0, sizeof(params));
+	params.Mode = modeIndex;
+
+	BitReader reader(src);
+	reader.Read(modeIndex + 1);
+	params.Partition = reader.Read(mode.PartitionBits);
+	params.Rotation = reader.Read(mode.RotationBits);
+	params.IndexSelection = reader.Read(mode.IndexSelectionBits);
+
+	for (int c = 0; c < 4; c++)
+	{
+		int bits = (c < 3) ? mode.ColourBits : mode.AlphaBits;
+		for (int subset = 0; subset < mode.NumSubsets; subset++)
+			for (int end = 0; end < 2; end++)
+				params.Endpoints[subset][end][c] = uint8(reader.Read(bits));
+	}
+
+	for (int subset = 0; subset < mode.NumSubsets; subset++)
+	{
+		if (mode.EndpointPBits)
+		{
+			params.PBits[subset][0] = uint8(reader.Read(1));
+			params.PBits[subset][1] = uint8(reader.Read(1));
+		}
+		else if (mode.SharedPBits)
+		{
+			params.PBits[subset][0] = params.PBits[subset][1] = uint8(reader.Read(1));
+		}
+	}
+
+	int subsets[16];
+	for (int p = 0; p < 16; p++)
+		subsets[p] = GetSubset(mode.NumSubsets, params.Partition, p);
+
+	if (mode.Index2Bits)
+	{
+		uint8* first = params.IndexSelection ? params.Indices2 : params.Indices;
+		uint8* second = params.IndexSelection ? params.Indices : params.Indices2;
+		for (int p = 0; p < 16; p++)
+			first[p] = uint8(reader.Read(mode.IndexBits - (p ? 0 : 1)));
+		for (int p = 0; p < 16; p++)
+			second[p] = uint8(reader.Read(mode.Index2Bits - (p ? 0 : 1)));
+	}
+	else
+	{
+		for (int p = 0; p < 16; p++)
+		{
+			bool anchor = (p == GetAnchor(mode.NumSubsets, params.Partition, subsets[p]));
+			params.Indices[p] = uint8(reader.Read(mode.IndexBits - (anchor ? 1 : 0)));
+		}
+	}
+
+	const int* colourWeights = GetWeights(BC7GetIndexBits(params, false));
+	const int* alphaWeights = GetWeights(BC7GetIndexBits(params, true));
+	for (int p = 0; p < 16; p++)
+	{
+		int subset = subsets[p];
+		int colourWeight = colourWeights[params.Indices[p]];
+		int alphaWeight = mode.Index2Bits ? alphaWeights[params.Indices2[p]] : colourWeight;
+		for (int c = 0; c < 4; c++)
+		{
+			int e0 = BC7GetEndpoint(params, subset, 0, c);
+			int e1 = BC7GetEndpoint(params, subset, 1, c);
+			block[p].E[c] = uint8(Interpolate(e0, e1, (c < 3) ? colourWeight : alphaWeight));
+		}
+
+		if (params.Rotation)
+			tStd::tSwap(block[p].E[params.Rotation - 1], block[p].A);
+	}
+}
+
+
+const tBC::BC6HMode tBC::BC6HModes[14] =
+{
+	{
+		0x00, 2, 2, true, 10, { 5, 5, 5 },
+		"d[4:0],bz[3],rz[4:0],bz[2],ry[4:0],by[3:0],bz[1],bx[4:0],gz[3:0],bz[0],gx[4:0],gy[3:0],gz[4],rx[4:0],bw[9:0],"
+		"gw[9:0],rw[9:0],bz[4],by[4],gy[4],m[1:0]"
+	},
+	{
+		0x01, 2, 2, true, 7, { 6, 6, 6 },
+		"d[4:0],rz[5:0],ry[5:0],by[3:0],bx[5:0],gz[3:0],gx[5:0],gy[3:0],rx[5:0],bz[4],bz[5],bz[3],bw[6:0],gy[4],bz[2],"
+		"by[5],gw[6:0],by[4],bz[1:0],rw[6:0],gz[5:4],gy[5],m[1:0]"
+	},
+	{
+		0x02, 5, 2, true, 11, { 5, 4, 4 },
+		"d[4:0],bz[3],rz[4:0],bz[2],ry[4:0],by[3:0],bz[1],bw[10],bx[3:0],gz[3:0],bz[0],gw[10],gx[3:0],gy[3:0],rw[10],"
+		"rx[4:0],bw[9:0],gw[9:0],rw[9:0],m[4:0]"
+	},
+	{
+		0x06, 5, 2, true, 11, { 4, 5, 4 },
+		"d[4:0],bz[3],gy[4],rz[3:0],bz[2],bz[0],ry[3:0],by[3:0],bz[1],bw[10],bx[3:0],gz[3:0],gw[10],gx[4:0],gy[3:0],"
+		"gz[4],rw[10],rx[3:0],bw[9:0],gw[9:0],rw[9:0],m[4:0]"
+	},
+	{
+		0x0A, 5, 2, true, 11, { 4, 4, 5 },
+		"d[4:0],bz[3],bz[4],rz[3:0],bz[2:1],ry[3:0],by[3:0],bw[10],bx[4:0],gz[3:0],bz[0],gw[10],gx[3:0],gy[3:0],by[4],"
+		"rw[10],rx[3:0],bw[9:0],gw[9:0],rw[9:0],m[4:0]"
+	},
+	{
+		0x0E, 5, 2, true, 9, { 5, 5, 5 },
+		"d[4:0],bz[3],rz[4:0],bz[2],ry[4:0],by[3:0],bz[1],bx[4:0],gz[3:0],bz[0],gx[4:0],gy[3:0],gz[4],rx[4:0],bz[4],"
+		"bw[8:0],gy[4],gw[8:0],by[4],rw[8:0],m[4:0]"
+	},
+	{
+		0x12, 5, 2, true, 8, { 6, 5, 5 },
+		"d[4:0],rz[5:0],ry[5:0],by[3:0],bz[1],bx[4:0],gz[3:0],bz[0],gx[4:0],gy[3:0],rx[5:0],bz[4:3],bw[7:0],gy[4],"
+		"bz[2],gw[7:0],by[4],gz[4],rw[7:0],m[4:0]"
+	},
+	{
+		0x16, 5, 2, true, 8, { 5, 6, 5 },
+		"d[4:0],bz[3],rz[4:0],bz[2],ry[4:0],by[3:0],bz[1],bx[4:0],gz[3:0],gx[5:0],gy[3:0],gz[4],rx[4:0],bz[4],gz[5],"
+		"bw[7:0],gy[4],gy[5],gw[7:0],by[4],bz[0],rw[7:0],m[4:0]"
+	},
+	{
+		0x1A, 5, 2, true, 8, { 5, 5, 6 },
+		"d[4:0],bz[3],rz[4:0],bz[2],ry[4:0],by[3:0],bx[5:0],gz[3:0],bz[0],gx[4:0],gy[3:0],gz[4],rx[4:0],bz[4],bz[5],"
+		"bw[7:0],gy[4],by[5],gw[7:0],by[4],bz[1],rw[7:0],m[4:0]"
+	},
+	{
+		0x1E, 5, 2, false, 6, { 6, 6, 6 },
+		"d[4:0],rz[5:0],ry[5:0],by[3:0],bx[5:0],gz[3:0],gx[5:0],gy[3:0],rx[5:0],bz[4],bz[5],bz[3],gz[5],bw[5:0],gy[4],"
+		"bz[2],by[5],gy[5],gw[5:0],by[4],bz[1:0],gz[4],rw[5:0],m[4:0]"
+	},
+	{
+		0x03, 5, 1, false, 10, { 10, 10, 10 },
+		"bx[9:0],gx[9:0],rx[9:0],bw[9:0],gw[9:0],rw[9:0],m[4:0]"
+	},
+	{
+		0x07, 5, 1, true, 11, { 9, 9, 9 },
+		"bw[10],bx[8:0],gw[10],gx[8:0],rw[10],rx[8:0],bw[9:0],gw[9:0],rw[9:0],m[4:0]"
+	},
+	{
+		0x0B, 5, 1, true, 12, { 8, 8, 8 },
+		"bw[10],bw[11],bx[7:0],gw[10],gw[11],gx[7:0],rw[10],rw[11],rx[7:0],bw[9:0],gw[9:0],rw[9:0],m[4:0]"
+	},
+	{
+		0x0F, 5, 1, true, 16, { 4, 4, 4 },
+		"bw[10],bw[11],bw[12],bw[13],bw[14],bw[15],bx[3:0],gw[10],gw[11],gw[12],gw[13],gw[14],gw[15],gx[3:0],rw[10],"
+		"rw[11],rw[12],rw[13],rw[14],rw[15],rx[3:0],bw[9:0],gw[9:0],rw[9:0],m[4:0]"
+	}
+};
+
+
+tBC::BC6HLayouts::BC6HLayouts()
+{
+	for (int m = 0; m < 14; m++)
+	{
+		// Fields are listed from the most significant bit so the string is walked backwards. Within a field the bit
+		// range also runs high to low, so the low bit of each range lands first.
+		const char* layout = BC6HModes[m].Layout;
+		int pos = 0;
+		const char* end = layout + tStd::tStrlen(layout);
+		while (end > layout)
+		{
+			const char* start = end;
+			while ((start > layout) && (start[-1] != ','))
+				start--;
+
+			int field = 0;
+			if (start[0] == 'd')
+				field = 1;
+			else if (start[0] != 'm')
+				field = 2 + (start[1] - 'w')*3 + ((start[0] == 'r') ? 0 : ((start[0] == 'g') ? 1 : 2));
+
+			// Each field is a name followed by either [bit] or [high:low].
+			auto readNumber = [](const char*& c)
+			{
+				int value = 0;
+				for (; (*c >= '0') && (*c <= '9'); c++)
+					value = value*10 + (*c - '0');
+				return value;
+			};
+			const char* c = start;
+			while (*c != '[')
+				c++;
+			c++;
+			int high = readNumber(c);
+			int low = high;
+			if (*c == ':')
+			{
+				c++;
+				low = readNumber(c);
+			}
+
+			for (int b = low; b <= high; b++, pos++)
+			{
+				Field[m][pos] = uint8(field);
+				Bit[m][pos] = uint8(b);
+			}
+			end = (start > layout) ? start - 1 : layout;
+		}
+		NumBits[m] = pos;
+		tAssert(pos == ((BC6HModes[m].NumRegions == 2) ? 82 : 65));
+	}
+}
+
+
+const tBC::BC6HLayouts& tBC::GetBC6HLayouts()
+{
+	static BC6HLayouts layouts;
+	return layouts;
+}
+
+
+uint16 tBC::FloatToHalf(float value)
+{
+	// This also sends NaNs to zero. The largest finite half is 65504.
+	if (!(value > 0.0f))
+		return 0;
+	if (value >= 65504.0f)
+		return 0x7BFF;
+
+	uint32 bits;
+	tStd::tMemcpy(&bits, &value, 4);
+	int exponent = int(bits >> 23) - 127 + 15;
+	uint32 mantissa = (bits & 0x007FFFFF) | 0x00800000;
+
+	// Denormal halves shift the mantissa further. Rounding is to nearest even in both cases.
+	int shift = (exponent > 0) ? 13 : (14 - exponent);
+	if (shift > 24)
+		return 0;
+
+	uint32 half = (exponent > 0) ? ((uint32(exponent) << 10) | ((mantissa >> 13) & 0x3FF)) : (mantissa >> shift);
+	uint32 remainder = mantissa & ((1 << shift) - 1);
+	uint32 halfway = 1 << (shift - 1);
+	if ((remainder > halfway) || ((remainder == halfway) && (half & 1)))
+		half++;
+
+	return uint16(tMath::tMin(half, uint32(0x7BFF)));
+}
+
+
+float tBC::HalfToFloat(uint16 half)
+{
+	int exponent = (half >> 10) & 0x1F;
+	int mantissa = half & 0x3FF;
+	if (!exponent)
+		return float(mantissa) / 16777216.0f;
+
+	uint32 bits = (uint32(exponent - 15 + 127) << 23) | (uint32(mantissa) << 13);
+	float value;
+	tStd::tMemcpy(&value, &bits, 4);
+	return value;
+}
+
+
+int tBC::BC6HUnquantize(int value, int bits)
+{
+	if (bits >= 15)
+		return value;
+	if (value == 0)
+		return 0;
+	if (value == ((1 << bits) - 1))
+		return 0xFFFF;
+
+	return ((value << 16) + 0x8000) >> bits;
+}
+
+
+int tBC::BC6HQuantize(float value, int bits)
+{
+	int maxQuant = (1 << bits) - 1;
+	if (bits >= 15)
+		return tMath::tClamp(int(value + 0.5f), 0, maxQuant);
+
+	int guess = tMath::tClamp(int(value * float(1 << bits) / 65536.0f), 0, maxQuant);
+	int best = guess;
+	float bestError = 1.0e30f;
+	for (int q = tMath::tMax(guess - 1, 0); q <= tMath::tMin(guess + 1, maxQuant); q++)
+	{
+		float error = tMath::tAbs(float(BC6HUnquantize(q, bits)) - value);
+		if (error < bestError)
+		{
+			bestError = error;
+			best = q;
+		}
+	}
+	return best;
+}
+
+
+int64 tBC::BC6HEvaluate(BC6HParams& params, const int halves[16][3], bool restrictAnchors)
+{
+	const BC6HMode& mode = BC6HModes[params.Mode];
+	int indexBits = (mode.NumRegions == 1) ? 4 : 3;
+	const int* weights = GetWeights(indexBits);
+	int numEntries = 1 << indexBits;
+
+	int64 error = 0;
+	for (int region = 0; region < mode.NumRegions; region++)
+	{
+		int palette[16][3];
+		for (int c = 0; c < 3; c++)
+		{
+			int e0 = BC6HUnquantize(params.Endpoints[region][0][c], mode.EndpointBits);
+			int e1 = BC6HUnquantize(params.Endpoints[region][1][c], mode.EndpointBits);
+			for (int i = 0; i < numEntries; i++)
+				palette[i][c] = (Interpolate(e0, e1, weights[i]) * 31) >> 6;
+		}
+
+		// As with BC7 the pixels are projected onto the palette line and only the nearest entries are checked.
+		float direction[3];
+		float lengthSq = 0.0f;
+		for (int c = 0; c < 3; c++)
+		{
+			direction[c] = float(palette[numEntries-1][c] - palette[0][c]);
+			lengthSq += direction[c]*direction[c];
+		}
+		float scale = (lengthSq > 0.0f) ? float(numEntries-1) / lengthSq : 0.0f;
+
+		uint32 mask = GetSubsetMask(mode.NumRegions, params.Partition, region);
+		int anchor = GetAnchor(mode.NumRegions, params.Partition, region);
+		for (int p = 0; p < 16; p++)
+		{
+			if (!(mask & (1 << p)))
+				continue;
+
+			int maxIndex = ((restrictAnchors && (p == anchor)) ? (numEntries >> 1) : numEntries) - 1;
+			float t = 0.0f;
+			for (int c = 0; c < 3; c++)
+				t += float(halves[p][c] - palette[0][c]) * direction[c];
+			int guess = tMath::tClamp(int(t*scale + 0.5f), 0, maxIndex);
+
+			int64 bestError = 0x7FFFFFFFFFFFFFFFll;
+			int bestIndex = 0;
+			for (int i = tMath::tMax(guess-1, 0); i <= tMath::tMin(guess+1, maxIndex); i++)
+			{
+				int64 pixelError = 0;
+				for (int c = 0; c < 3; c++)
+				{
+					int64 diff = palette[i][c] - halves[p][c];
+					pixelError += diff*diff;
+				}
+				if (pixelError < bestError)
+				{
+					bestError = pixelError;
+					bestIndex = i;
+				}
+			}
+			params.Indices[p] = uint8(bestIndex);
+			error += bestError;
+		}
+	}
+	return error;
+}
+
+
+bool tBC::BC6HFitDeltas(BC6HParams& params)
+{
+	const BC6HMode& mode = BC6HModes[params.Mode];
+	if (!mode.Transformed)
+		return false;
+
+	bool changed = false;
+	for (int region = 0; region < mode.NumRegions; region++)
+	{
+		for (int end = 0; end < 2; end++)
+		{
+			if (!region && !end)
+				continue;
+
+			for (int c = 0; c < 3; c++)
+			{
+				int base = params.Endpoints[0][0][c];
+				int low = base - (1 << (mode.DeltaBits[c] - 1));
+				int high = base + (1 << (mode.DeltaBits[c] - 1)) - 1;
+				low = tMath::tMax(low, 0);
+				high = tMath::tMin(high, (1 << mode.EndpointBits) - 1);
+				int clamped = tMath::tClamp(params.Endpoints[region][end][c], low, high);
+				if (clamped != params.Endpoints[region][end][c])
+				{
+					params.Endpoints[region][end][c] = clamped;
+					changed = true;
+				}
+			}
+		}
+	}
+	return changed;
+}
+
+
+int64 tBC::BC6HEncodeMode(BC6HParams& params, const float endpoints[2][2][4], const int halves[16][3])
+{
+	const BC6HMode& mode = BC6HModes[params.Mode];
+	for (int region = 0; region < mode.NumRegions; region++)
+		for (int end = 0; end < 2; end++)
+			for (int c = 0; c < 3; c++)
+				params.Endpoints[region][end][c] = BC6HQuantize(endpoints[region][end][c], mode.EndpointBits);
+
+	int64 error = BC6HEvaluate(params, halves, false);
+
+	// The anchor index of each region is stored without its top bit. Swapping the endpoints and inverting the indices
+	// clears it without changing the colours. This has to happen before the deltas are taken because it can change
+	// which endpoint is the base.
+	int indexBits = (mode.NumRegions == 1) ? 4 : 3;
+	int maxIndex = (1 << indexBits) - 1;
+	for (int region = 0; region < mode.NumRegions; region++)
+	{
+		int anchor = GetAnchor(mode.NumRegions, params.Partition, region);
+		if (!(params.Indices[anchor] & (1 << (indexBits - 1))))
+			continue;
+
+		for (int c = 0; c < 3; c++)
+			tStd::tSwap(params.Endpoints[region][0][c], params.Endpoints[region][1][c]);
+
+		uint32 mask = GetSubsetMask(mode.NumRegions, params.Partition, region);
+		for (int p = 0; p < 16; p++)
+			if (mask & (1 << p))
+				params.Indices[p] = uint8(maxIndex - params.Indices[p]);
+	}
+
+	// If the deltas had to be clamped the indices are found again, this time keeping the anchors valid.
+	if (BC6HFitDeltas(params))
+		error = BC6HEvaluate(params, halves, true);
+
+	return error;
+}
+
+
+int64 tBC::BC6HEncodeRefined
+(
+	BC6HParams& params, float endpoints[2][2][4], const float values[16][4], const int halves[16][3], int numPasses
+)
+{
+	const BC6HMode& mode = BC6HModes[params.Mode];
+	int64 error = BC6HEncodeMode(params, endpoints, halves);
+	const int* weights = GetWeights((mode.NumRegions == 1) ? 4 : 3);
+	for (int pass = 0; (pass < numPasses) && (error > 0); pass++)
+	{
+		bool solved = false;
+		for (int region = 0; region < mode.NumRegions; region++)
+		{
+			uint32 mask = GetSubsetMask(mode.NumRegions, params.Partition, region);
+			if (SolveLine(endpoints[region], values, mask, params.Indices, weights, 0, 3, 65535.0f))
+				solved = true;
+		}
+		if (!solved)
+			break;
+
+		BC6HParams trial = params;
+		int64 trialError = BC6HEncodeMode(trial, endpoints, halves);
+		if (trialError >= error)
+			break;
+
+		error = trialError;
+		params = trial;
+	}
+	return error;
+}
+
+
+void tBC::BC6HPack(uint8* dest, const BC6HParams& params)
+{
+	const BC6HMode& mode = BC6HModes[params.Mode];
+	const BC6HLayouts& layouts = GetBC6HLayouts();
+
+	int fields[14];
+	fields[0] = mode.ModeValue;
+	fields[1] = params.Partition;
+	for (int region = 0; region < 2; region++)
+	{
+		for (int end = 0; end < 2; end++)
+		{
+			for (int c = 0; c < 3; c++)
+			{
+				int value = params.Endpoints[region][end][c];
+				bool delta = mode.Transformed && (region || end);
+				if (delta)
+					value = (value - params.Endpoints[0][0][c]) & ((1 << mode.DeltaBits[c]) - 1);
+				fields[2 + (region*2 + end)*3 + c] = value;
+			}
+		}
+	}
+
+	BitWriter writer(dest);
+	int m = params.Mode;
+	for (int b = 0; b < layouts.NumBits[m]; b++)
+		writer.Write((fields[layouts.Field[m][b]] >> layouts.Bit[m][b]) & 1, 1);
+
+	int indexBits = (mode.NumRegions == 1) ? 4 : 3;
+	int anchor = (mode.NumRegions == 2) ? Anchors2[params.Partition] : 0;
+	for (int p = 0; p < 16; p++)
+		writer.Write(params.Indices[p], indexBits - (((p == 0) || (p == anchor)) ? 1 : 0));
+}
+
+
+void tBC::EncodeBC6HBlock(uint8* dest, const tColourf block[16], tBCQuality quality)
+{
+	int halves[16][3];
+	float values[16][4];
+	for (int p = 0; p < 16; p++)
+	{
+		for (int c = 0; c < 3; c++)
+		{
+			halves[p][c] = FloatToHalf(block[p].E[c]);
+			values[p][c] = float(halves[p][c]) * 64.0f / 31.0f;
+		}
+		values[p][3] = 0.0f;
+	}
+
+	int numPasses = (quality == tBCQuality::Fast) ? 0 : ((quality == tBCQuality::High) ? 3 : 1);
+	BC6HParams best;
+	int64 bestError = 0x7FFFFFFFFFFFFFFFll;
+
+	// The single region modes share one line fit and differ only in how precisely the endpoints are stored.
+	float lineFit[2][2][4];
+	FitLine(lineFit[0], values, 0xFFFF, 0, 3, 65535.0f);
+	for (int m = 10; m < 14; m++)
+	{
+		BC6HParams params;
+		tStd::tMemset(&params, 0, sizeof(params));
+		params.Mode = m;
+		float endpoints[2][2][4];
+		tStd::tMemcpy(endpoints, lineFit, sizeof(endpoints));
+		int64 error = BC6HEncodeRefined(params, endpoints, values, halves, numPasses);
+		if (error < bestError)
+		{
+			bestError = error;
+			best = params;
+		}
+	}
+
+	// The two region modes use the first 32 partitions and 3 bit indices.
+	if ((quality != tBCQuality::Fast) && (bestError > 0))
+	{
+		int ranked[8];
+		int numRanked = (quality == tBCQuality::High) ? 8 : 2;
+		float scores[64];
+		ScorePartitions<3>(scores, values, 2);
+		RankPartitions(ranked, numRanked, scores, 32);
+		for (int r = 0; r < numRanked; r++)
+		{
+			for (int region = 0; region < 2; region++)
+				FitLine(lineFit[region], values, GetSubsetMask(2, ranked[r], region), 0, 3, 65535.0f);
+
+			for (int m = 0; m < 10; m++)
+			{
+				BC6HParams params;
+				tStd::tMemset(&params, 0, sizeof(params));
+				params.Mode = m;
+				params.Partition = ranked[r];
+				float endpoints[2][2][4];
+				tStd::tMemcpy(endpoints, lineFit, sizeof(endpoints));
+				int64 error = BC6HEncodeRefined(params, endpoints, values, halves, numPasses);
+				if (error < bestError)
+				{
+					bestError = error;
+					best = params;
+				}
+			}
+		}
+	}
+
+	BC6HPack(dest, best);
+}
+
+
+void tBC::DecodeBC6HBlock(uint16 halves[16][3], const uint8* src)
+{
+	BitReader modeReader(src);
+	int modeValue = modeReader.Read(2);
+	if (modeValue >= 2)
+		modeValue |= modeReader.Read(3) << 2;
+
+	int m = 0;
+	while ((m < 14) && (BC6HModes[m].ModeValue != modeValue))
+		m++;
+
+	// Reserved modes decode to black.
+	if (m == 14)
+	{
+		tStd::tMemset(halves, 0, 16*3*sizeof(uint16));
+		return;
+	}
+
+	const BC6HMode& mode = BC6HModes[m];
+	const BC6HLayouts& layouts = GetBC6HLayouts();
+	int fields[14] = { };
+	BitReader reader(src);
+	for (int b = 0; b < layouts.NumBits[m]; b++)
+		fields[layouts.Field[m][b]] |= reader.Read(1) << layouts.Bit[m][b];
+
+	BC6HParams params;
+	params.Mode = m;
+	params.Partition = fields[1];
+	int endpointMask = (1 << mode.EndpointBits) - 1;
+	for (int region = 0; region < 2; region++)
+	{
+		for (int end = 0; end < 2; end++)
+		{
+			for (int c = 0; c < 3; c++)
+			{
+				int value = fields[2 + (region*2 + end)*3 + c];
+				if (mode.Transformed && (region || end))
+				{
+					// Deltas are signed and wrap around within the endpoint bits.
+					int signBit = 1 << (mode.DeltaBits[c] - 1);
+					int delta = (value ^ signBit) - signBit;
+					value = (fields[2 + c] + delta) & endpointMask;
+				}
+				params.Endpoints[region][end][c] = value;
+			}
+		}
+	}
+
+	int indexBits = (mode.NumRegions == 1) ? 4 : 3;
+	int anchor = (mode.NumRegions == 2) ? Anchors2[params.Partition] : 0;
+	for (int p = 0; p < 16; p++)
+		params.Indices[p] = uint8(reader.Read(indexBits - (((p == 0) || (p == anchor)) ? 1 : 0)));
+
+	const int* weights = GetWeights(indexBits);
+	for (int p = 0; p < 16; p++)
+	{
+		int region = GetSubset(mode.NumRegions, params.Partition, p);
+		for (int c = 0; c < 3; c++)
+		{
+			int e0 = BC6HUnquantize(params.Endpoints[region][0][c], mode.EndpointBits);
+			int e1 = BC6HUnquantize(params.Endpoints[region][1][c], mode.EndpointBits);
+			halves[p][c] = uint16((Interpolate(e0, e1, weights[params.Indices[p]]) * 31) >> 6);
+		}
+	}
+}
+
+
+int tImage::tGetBCEncodedSize(tPixelFormat format, int width, int height)
+{
+	if (!tIsBlockFormat(format) || (width <= 0) || (height <= 0))
+		return 0;
+
+	return ((width + 3) / 4) * ((height + 3) / 4) * tGetBytesPer4x4PixelBlock(format);
+}
+
+
+bool tImage::tCanEncodeBC(tPixelFormat format)
+{
+	switch (format)
+	{
+		case tPixelFormat::BC1_DXT1:
+		case tPixelFormat::BC1_DXT1BA:
+		case tPixelFormat::BC2_DXT3:
+		case tPixelFormat::BC3_DXT5:
+		case tPixelFormat::BC4_ATI1:
+		case tPixelFormat::BC5_ATI2:
+		case tPixelFormat::BC6H:
+		case tPixelFormat::BC7:
+			return true;
+
+		default:
+			return false;
+	}
+}
+
+
+bool tImage::tEncodeBC
+(
+	uint8* dest, const tPixel* pixels, int width, int height, tPixelFormat format, tBCQuality quality, int numThreads
+)
+{
+	if (!dest || !pixels || (width <= 0) || (height <= 0) || !tCanEncodeBC(format))
+		return false;
+
+	// Make sure the tables are built before the threads start. Not strictly needed but it keeps the first blocks
+	// from all waiting on the same initialization.
+	tBC::GetSingleColourTables();
+	tBC::GetBC6HLayouts();
+
+	int blocksW = (width + 3) / 4;
+	int blocksH = (height + 3) / 4;
+	int blockBytes = tGetBytesPer4x4PixelBlock(format);
+	tSystem::tParallelFor
+	(
+		blocksH,
+		[&](int blockY)
+		{
+			tPixel block[16];
+			uint8* out = dest + blockY*blocksW*blockBytes;
+			for (int blockX = 0; blockX < blocksW; blockX++, out += blockBytes)
+			{
+				tBC::GetBlock(block, pixels, width, height, blockX, blockY);
+				tBC::EncodeBlock(out, block, format, quality);
+			}
+		},
+		numThreads
+	);
+
+	return true;
+}
+
+
+bool tImage::tEncodeBC
+(
+	uint8* dest, const tColourf* pixels, int width, int height, tPixelFormat format, tBCQuality quality, int numThreads
+)
+{
+	if (!dest || !pixels || (width <= 0) || (height <= 0) || (format != tPixelFormat::BC6H))
+		return false;
+
+	tBC::GetBC6HLayouts();
+	int blocksW = (width + 3) / 4;
+	int blocksH = (height + 3) / 4;
+	int blockBytes = tGetBytesPer4x4PixelBlock(format);
+	tSystem::tParallelFor
+	(
+		blocksH,
+		[&](int blockY)
+		{
+			tColourf block[16];
+			uint8* out = dest + blockY*blocksW*blockBytes;
+			for (int blockX = 0; blockX < blocksW; blockX++, out += blockBytes)
+			{
+				tBC::GetBlock(block, pixels, width, height, blockX, blockY);
+				tBC::EncodeBC6HBlock(out, block, quality);
+			}
+		},
+		numThreads
+	);
+
+	return true;
+}
+
+
+bool tImage::tDecodeBC(tPixel* dest, const uint8* blocks, int width, int height, tPixelFormat format)
+{
+	if (!dest || !blocks || (width <= 0) || (height <= 0) || !tCanEncodeBC(format))
+		return false;
+
+	int blocksW = (width + 3) / 4;
+	int blocksH = (height + 3) / 4;
+	int blockBytes = tGetBytesPer4x4PixelBlock(format);
+	tPixel block[16];
+	for (int blockY = 0; blockY < blocksH; blockY++)
+	{
+		for (int blockX = 0; blockX < blocksW; blockX++, blocks += blockBytes)
+		{
+			tBC::DecodeBlock(block, blocks, format);
+			int numRows = tMath::tMin(4, height - blockY*4);
+			int numCols = tMath::tMin(4, width - blockX*4);
+			for (int y = 0; y < numRows; y++)
+				for (int x = 0; x < numCols; x++)
+					dest[(blockY*4 + y)*width + blockX*4 + x] = block[y*4 + x];
+		}
+	}
+
+	return true;
+}
+
+
+bool tImage::tDecodeBC(tColourf* dest, const uint8* blocks, int width, int height, tPixelFormat format)
+{
+	if (!dest || !blocks || (width <= 0) || (height <= 0) || (format != tPixelFormat::BC6H))
+		return false;
+
+	int blocksW = (width + 3) / 4;
+	int blocksH = (height + 3) / 4;
+	int blockBytes = tGetBytesPer4x4PixelBlock(format);
+	uint16 halves[16][3];
+	for (int blockY = 0; blockY < blocksH; blockY++)
+	{
+		for (int blockX = 0; blockX < blocksW; blockX++, blocks += blockBytes)
+		{
+			tBC::DecodeBC6HBlock(halves, blocks);
+			int numRows = tMath::tMin(4, height - blockY*4);
+			int numCols = tMath::tMin(4, width - blockX*4);
+			for (int y = 0; y < numRows; y++)
+			{
+				for (int x = 0; x < numCols; x++)
+				{
+					const uint16* half = halves[y*4 + x];
+					dest[(blockY*4 + y)*width + blockX*4 + x].Set
+					(
+						tBC::HalfToFloat(half[0]), tBC::HalfToFloat(half[1]), tBC::HalfToFloat(half[2]), 1.0f
+					);
+				}
+			}
+		}
+	}
+
+	return true;
+}
@@ -78,6 +78,25 @@ bool tCubemap::Load(const tString& ddsFile, bool reverseRowOrder)
 }
 
 
+bool tCubemap::Save(const tString& ddsFile, bool reverseRowOrder) const
+{
+	if (tSystem::tGetFileType(ddsFile) != tSystem::tFileType::DDS)
+		return false;
+
+	const tList<tLayer>* sides[tFileDDS::tSurfIndex_NumSurfaces];
+	tStaticAssert(int(tSide::NumSides) == tFileDDS::tSurfIndex_NumSurfaces);
+	for (int side = 0; side < int(tSide::NumSides); side++)
+	{
+		if ((Sides[side].Side == tSide::Invalid) || !Sides[side].Texture.IsValid())
+			return false;
+		sides[side] = &Sides[side].Texture.GetLayers();
+	}
+
+	tFileDDS::Save(ddsFile, sides, reverseRowOrder);
+	return true;
+}
+
+
 bool tCubemap::Set(tFileDDS& dds)
 {
 	Clear();
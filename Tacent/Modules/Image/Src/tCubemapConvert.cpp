@@ -0,0 +1,671 @@
+// tCubemapConvert.cpp
+//
+// Conversions between the six faces of a cubemap and single picture layouts. Supported layouts are equirectangular
+// (latitude-longitude) panoramas and horizontal and vertical crosses. Conversions run in both directions with bilinear
+// or bicubic filtering, and the filters blend across face seams and around the panorama wrap so there are no visible
+// edges. Rows of the output are processed in parallel.
+//
+// Copyright (c) 2020 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <math.h>
+#include "Foundation/tStandard.h"
+#include "Math/tFundamentals.h"
+#include "Math/tVector3.h"
+#include "System/tMachine.h"
+#include "Image/tBlockCompress.h"
+#include "Image/tCubemapConvert.h"
+#include "Image/tPixelConvert.h"
+
+// SSE2 is part of the x64 baseline so no runtime check is needed.
+#ifdef ARCHITECTURE_X64
+#include <emmintrin.h>
+#define CUBE_USE_SSE2
+#endif
+using namespace tImage;
+
+
+namespace tCube
+{
+	const int NumFaces = int(tCubemap::tSide::NumSides);
+
+	// The samplers read from a copy of the source with a border on every side holding the pixels that lie beyond each
+	// edge. For faces that is the neighbouring face, and for a panorama it is the other side of the wrap or pole. The
+	// bicubic filter reaches two pixels out. With the border in place no sample needs an edge check.
+	const int BorderSize = 2;
+	struct PaddedImage
+	{
+		PaddedImage()																									: Width(0), Height(0), Stride(0), Pixels(nullptr) { }
+		~PaddedImage()																									{ delete[] Pixels; }
+		void Set(int width, int height);
+
+		// The coordinates may be up to BorderSize outside the image.
+		tPixel& Get(int x, int y)																						{ return Pixels[(y + BorderSize)*Stride + x + BorderSize]; }
+		const tPixel& Get(int x, int y) const																			{ return Pixels[(y + BorderSize)*Stride + x + BorderSize]; }
+
+		int Width, Height, Stride;
+		tPixel* Pixels;
+	};
+
+	// Pixel centres are at integer coordinates so the image spans -0.5 to Width-0.5 in x and the same for y. Samples
+	// are clamped to that range.
+	tPixel SampleBilinear(const PaddedImage&, float x, float y);
+	tPixel SampleBicubic(const PaddedImage&, float x, float y);
+	tPixel Sample(const PaddedImage&, float x, float y, tCubeFilter);
+	void CubicWeights(float weights[4], float t);
+
+	// The face coordinates s and t go from 0 to 1 across a face, left to right and bottom to top. FaceToDir accepts
+	// coordinates outside that range and returns a direction through the extended plane of the face. Directions need
+	// not be normalized.
+	tMath::tVector3 FaceToDir(int face, float s, float t);
+	int DirToFace(float& s, float& t, const tMath::tVector3& dir);
+	void DirToEquirect(float& u, float& v, const tMath::tVector3& dir);
+
+	// Returns the size of the faces, or 0 if they are not all valid, square, and the same size.
+	int GetFaceSize(const tPicture faces[NumFaces]);
+	void PadFaces(PaddedImage padded[NumFaces], const tPicture faces[NumFaces]);
+	void PadEquirect(PaddedImage&, const tPicture&);
+
+	// Samples with coordinates that go from 0 to 1 across the image.
+	tPixel SampleUV(const PaddedImage&, float u, float v, tCubeFilter);
+
+	// Calls sample(face, s, t) for the centre of every pixel of every face.
+	template<typename SampleFn> void RenderFaces(tPicture faces[NumFaces], int faceSize, SampleFn, int numThreads);
+
+	// The cell each face occupies in a cross with cell rows counted from the bottom. Only -z in the vertical cross is
+	// rotated.
+	extern const int CrossCells[2][NumFaces][2];
+	int GetCrossFace(tCrossLayout, int cellX, int cellY);
+	bool IsCrossRotated(tCrossLayout, int face);
+
+	bool DecodeLayer(tPicture&, const tLayer&);
+
+	#ifdef CUBE_USE_SSE2
+	__m128 LoadPixel(const tPixel*);
+	tPixel StorePixel(__m128);
+	#endif
+}
+
+
+void tCube::PaddedImage::Set(int width, int height)
+{
+	delete[] Pixels;
+	Width = width;
+	Height = height;
+	Stride = width + 2*BorderSize;
+	Pixels = new tPixel[Stride*(height + 2*BorderSize)];
+}
+
+
+#ifdef CUBE_USE_SSE2
+inline __m128 tCube::LoadPixel(const tPixel* pixel)
+{
+	__m128i zero = _mm_setzero_si128();
+	__m128i bytes = _mm_cvtsi32_si128(int(pixel->BP));
+	return _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(bytes, zero), zero));
+}
+
+
+inline tPixel tCube::StorePixel(__m128 value)
+{
+	// The packs saturate, which clamps any bicubic overshoot.
+	__m128i ints = _mm_cvtps_epi32(value);
+	ints = _mm_packs_epi32(ints, ints);
+	ints = _mm_packus_epi16(ints, ints);
+	return tPixel(uint32(_mm_cvtsi128_si32(ints)));
+}
+#endif
+
+
+tPixel tCube::SampleBilinear(const PaddedImage& image, float x, float y)
+{
+	int x0 = int(tMath::tFloor(x));
+	int y0 = int(tMath::tFloor(y));
+	float fx = x - float(x0);
+	float fy = y - float(y0);
+	const tPixel* bottom = &image.Get(x0, y0);
+	const tPixel* top = bottom + image.Stride;
+
+	#ifdef CUBE_USE_SSE2
+	__m128 wx = _mm_set1_ps(fx);
+	__m128 b0 = LoadPixel(bottom);
+	__m128 t0 = LoadPixel(top);
+	__m128 b = _mm_add_ps(b0, _mm_mul_ps(_mm_sub_ps(LoadPixel(bottom+1), b0), wx));
+	__m128 t = _mm_add_ps(t0, _mm_mul_ps(_mm_sub_ps(LoadPixel(top+1), t0), wx));
+	return StorePixel(_mm_add_ps(b, _mm_mul_ps(_mm_sub_ps(t, b), _mm_set1_ps(fy))));
+
+	#else
+	int result[4];
+	for (int c = 0; c < 4; c++)
+	{
+		float b = float(bottom[0].E[c]) + (float(bottom[1].E[c]) - float(bottom[0].E[c]))*fx;
+		float t = float(top[0].E[c]) + (float(top[1].E[c]) - float(top[0].E[c]))*fx;
+		result[c] = int(b + (t - b)*fy + 0.5f);
+	}
+	return tPixel(result[0], result[1], result[2], result[3]);
+	#endif
+}
+
+
+void tCube::CubicWeights(float weights[4], float t)
+{
+	float t2 = t*t;
+	float t3 = t2*t;
+	weights[0] = -0.5f*t3 + t2 - 0.5f*t;
+	weights[1] = 1.5f*t3 - 2.5f*t2 + 1.0f;
+	weights[2] = -1.5f*t3 + 2.0f*t2 + 0.5f*t;
+	weights[3] = 0.5f*t3 - 0.5f*t2;
+}
+
+
+tPixel tCube::SampleBicubic(const PaddedImage& image, float x, float y)
+{
+	int x0 = int(tMath::tFloor(x));
+	int y0 = int(tMath::tFloor(y));
+	float wx[4]; float wy[4];
+	CubicWeights(wx, x - float(x0));
+	CubicWeights(wy, y - float(y0));
+	const tPixel* row = &image.Get(x0 - 1, y0 - 1);
+
+	#ifdef CUBE_USE_SSE2
+	__m128 wx0 = _mm_set1_ps(wx[0]); __m128 wx1 = _mm_set1_ps(wx[1]);
+	__m128 wx2 = _mm_set1_ps(wx[2]); __m128 wx3 = _mm_set1_ps(wx[3]);
+	__m128 sum = _mm_setzero_ps();
+	for (int r = 0; r < 4; r++, row += image.Stride)
+	{
+		__m128 rowSum = _mm_add_ps
+		(
+			_mm_add_ps(_mm_mul_ps(LoadPixel(row+0), wx0), _mm_mul_ps(LoadPixel(row+1), wx1)),
+			_mm_add_ps(_mm_mul_ps(LoadPixel(row+2), wx2), _mm_mul_ps(LoadPixel(row+3), wx3))
+		);
+		sum = _mm_add_ps(sum, _mm_mul_ps(rowSum, _mm_set1_ps(wy[r])));
+	}
+	return StorePixel(sum);
+
+	#else
+	float sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	for (int r = 0; r < 4; r++, row += image.Stride)
+	{
+		for (int c = 0; c < 4; c++)
+		{
+			float rowSum = 0.0f;
+			for (int k = 0; k < 4; k++)
+				rowSum += float(row[k].E[c]) * wx[k];
+			sum[c] += rowSum * wy[r];
+		}
+	}
+
+	// The int constructor clamps.
+	return tPixel
+	(
+		int(tMath::tFloor(sum[0] + 0.5f)), int(tMath::tFloor(sum[1] + 0.5f)),
+		int(tMath::tFloor(sum[2] + 0.5f)), int(tMath::tFloor(sum[3] + 0.5f))
+	);
+	#endif
+}
+
+
+tPixel tCube::Sample(const PaddedImage& image, float x, float y, tCubeFilter filter)
+{
+	x = tMath::tClamp(x, -0.5f, float(image.Width) - 0.5f);
+	y = tMath::tClamp(y, -0.5f, float(image.Height) - 0.5f);
+	if (filter == tCubeFilter::Bicubic)
+		return SampleBicubic(image, x, y);
+
+	return SampleBilinear(image, x, y);
+}
+
+
+tMath::tVector3 tCube::FaceToDir(int face, float s, float t)
+{
+	float sc = 2.0f*s - 1.0f;
+	float tc = 2.0f*t - 1.0f;
+	switch (tCubemap::tSide(face))
+	{
+		case tCubemap::tSide::PosX:		return tMath::tVector3( 1.0f,  tc,    -sc   );
+		case tCubemap::tSide::NegX:		return tMath::tVector3(-1.0f,  tc,     sc   );
+		case tCubemap::tSide::PosY:		return tMath::tVector3( sc,    1.0f,  -tc   );
+		case tCubemap::tSide::NegY:		return tMath::tVector3( sc,   -1.0f,   tc   );
+		case tCubemap::tSide::PosZ:		return tMath::tVector3( sc,    tc,     1.0f );
+		default:						return tMath::tVector3(-sc,    tc,    -1.0f );
+	}
+}
+
+
+int tCube::DirToFace(float& s, float& t, const tMath::tVector3& dir)
+{
+	float ax = tMath::tAbs(dir.x);
+	float ay = tMath::tAbs(dir.y);
+	float az = tMath::tAbs(dir.z);
+	tCubemap::tSide face;
+	float major, sc, tc;
+	if ((ax >= ay) && (ax >= az))
+	{
+		major = ax;
+		face = (dir.x > 0.0f) ? tCubemap::tSide::PosX : tCubemap::tSide::NegX;
+		sc = (dir.x > 0.0f) ? -dir.z : dir.z;
+		tc = dir.y;
+	}
+	else if (ay >= az)
+	{
+		major = ay;
+		face = (dir.y > 0.0f) ? tCubemap::tSide::PosY : tCubemap::tSide::NegY;
+		sc = dir.x;
+		tc = (dir.y > 0.0f) ? -dir.z : dir.z;
+	}
+	else
+	{
+		major = az;
+		face = (dir.z > 0.0f) ? tCubemap::tSide::PosZ : tCubemap::tSide::NegZ;
+		sc = (dir.z > 0.0f) ? dir.x : -dir.x;
+		tc = dir.y;
+	}
+
+	// A zero direction has no face. The centre of +z is as good as anywhere.
+	if (major <= 0.0f)
+	{
+		s = t = 0.5f;
+		return int(tCubemap::tSide::PosZ);
+	}
+
+	s = 0.5f*(sc/major + 1.0f);
+	t = 0.5f*(tc/major + 1.0f);
+	return int(face);
+}
+
+
+void tCube::DirToEquirect(float& u, float& v, const tMath::tVector3& dir)
+{
+	float longitude = tMath::tArcTan(dir.x, dir.z);
+	float latitude = tMath::tArcTan(dir.y, tMath::tSqrt(dir.x*dir.x + dir.z*dir.z));
+	u = longitude/tMath::TwoPi + 0.5f;
+	v = latitude/tMath::Pi + 0.5f;
+}
+
+
+int tCube::GetFaceSize(const tPicture faces[NumFaces])
+{
+	int size = faces[0].GetWidth();
+	for (int face = 0; face < NumFaces; face++)
+		if (!faces[face].IsValid() || (faces[face].GetWidth() != size) || (faces[face].GetHeight() != size))
+			return 0;
+
+	return size;
+}
+
+
+void tCube::PadFaces(PaddedImage padded[NumFaces], const tPicture faces[NumFaces])
+{
+	// Border pixels take the nearest pixel of whichever face the direction through them hits. Along an edge that is
+	// the neighbouring face. The corners have no true neighbour and end up with a pixel from one of the two faces
+	// that meet there.
+	int size = faces[0].GetWidth();
+	float invSize = 1.0f / float(size);
+	for (int face = 0; face < NumFaces; face++)
+	{
+		PaddedImage& image = padded[face];
+		image.Set(size, size);
+		for (int y = -BorderSize; y < size + BorderSize; y++)
+		{
+			bool insideY = (y >= 0) && (y < size);
+			for (int x = -BorderSize; x < size + BorderSize; x++)
+			{
+				if (insideY && (x >= 0) && (x < size))
+				{
+					image.Get(x, y) = faces[face].GetPixel(x, y);
+					continue;
+				}
+
+				float s, t;
+				tMath::tVector3 dir = FaceToDir(face, (float(x) + 0.5f)*invSize, (float(y) + 0.5f)*invSize);
+				int neighbour = DirToFace(s, t, dir);
+				int nx = tMath::tClamp(int(s*float(size)), 0, size-1);
+				int ny = tMath::tClamp(int(t*float(size)), 0, size-1);
+				image.Get(x, y) = faces[neighbour].GetPixel(nx, ny);
+			}
+		}
+	}
+}
+
+
+void tCube::PadEquirect(PaddedImage& image, const tPicture& src)
+{
+	// Columns wrap around. Rows beyond a pole come back down the other side, half way around.
+	int width = src.GetWidth();
+	int height = src.GetHeight();
+	image.Set(width, height);
+	for (int y = -BorderSize; y < height + BorderSize; y++)
+	{
+		int sy = y;
+		int shift = 0;
+		if (sy >= height)
+		{
+			sy = 2*height - 1 - sy;
+			shift = width/2;
+		}
+		else if (sy < 0)
+		{
+			sy = -1 - sy;
+			shift = width/2;
+		}
+		sy = tMath::tClamp(sy, 0, height-1);
+
+		for (int x = -BorderSize; x < width + BorderSize; x++)
+		{
+			int sx = ((x + shift) % width + width) % width;
+			image.Get(x, y) = src.GetPixel(sx, sy);
+		}
+	}
+}
+
+
+inline tPixel tCube::SampleUV(const PaddedImage& image, float u, float v, tCubeFilter filter)
+{
+	return Sample(image, u*float(image.Width) - 0.5f, v*float(image.Height) - 0.5f, filter);
+}
+
+
+template<typename SampleFn> void tCube::RenderFaces
+(
+	tPicture faces[NumFaces], int faceSize, SampleFn sample, int numThreads
+)
+{
+	for (int face = 0; face < NumFaces; face++)
+		faces[face].Set(faceSize, faceSize, tPicture::AllocPixels(faceSize*faceSize), false);
+
+	float invSize = 1.0f / float(faceSize);
+	tSystem::tParallelFor
+	(
+		NumFaces*faceSize,
+		[&](int row)
+		{
+			int face = row / faceSize;
+			int y = row % faceSize;
+			float t = (float(y) + 0.5f)*invSize;
+			tPixel* dest = faces[face].GetPixelPointer(0, y);
+			for (int x = 0; x < faceSize; x++)
+				dest[x] = sample(face, (float(x) + 0.5f)*invSize, t);
+		},
+		numThreads
+	);
+}
+
+
+const int tCube::CrossCells[2][tCube::NumFaces][2] =
+{
+	// Horizontal. 4x3 cells.
+	{ { 2, 1 }, { 0, 1 }, { 1, 2 }, { 1, 0 }, { 1, 1 }, { 3, 1 } },
+
+	// Vertical. 3x4 cells.
+	{ { 2, 2 }, { 0, 2 }, { 1, 3 }, { 1, 1 }, { 1, 2 }, { 1, 0 } }
+};
+
+
+int tCube::GetCrossFace(tCrossLayout layout, int cellX, int cellY)
+{
+	for (int face = 0; face < NumFaces; face++)
+		if ((CrossCells[int(layout)][face][0] == cellX) && (CrossCells[int(layout)][face][1] == cellY))
+			return face;
+
+	return -1;
+}
+
+
+bool tCube::IsCrossRotated(tCrossLayout layout, int face)
+{
+	return (layout == tCrossLayout::Vertical) && (face == int(tCubemap::tSide::NegZ));
+}
+
+
+bool tCube::DecodeLayer(tPicture& picture, const tLayer& layer)
+{
+	int width = layer.Width;
+	int height = layer.Height;
+	int numPixels = width*height;
+	const uint8* src = layer.Data;
+	tPixel* pixels = tPicture::AllocPixels(numPixels);
+	bool decoded = tIsNormalFormat(layer.PixelFormat) ?
+		tConvertPixels(pixels, tPixelFormat::R8G8B8A8, src, layer.PixelFormat, numPixels) :
+		tDecodeBC(pixels, src, width, height, layer.PixelFormat);
+
+	if (!decoded)
+	{
+		tMem::tFree(pixels);
+		return false;
+	}
+
+	picture.Set(width, height, pixels, false);
+	return true;
+}
+
+
+bool tImage::tGetCubemapFaces(tPicture faces[tCube::NumFaces], tCubemap& cubemap)
+{
+	int size = 0;
+	for (int face = 0; face < tCube::NumFaces; face++)
+	{
+		faces[face].Clear();
+		tTexture* texture = cubemap.GetSide(tCubemap::tSide(face));
+		tLayer* layer = (texture && texture->IsValid()) ? texture->GetMainLayer() : nullptr;
+		if (!layer || (layer->Width != layer->Height) || (face && (layer->Width != size)))
+			return false;
+
+		size = layer->Width;
+		if (!tCube::DecodeLayer(faces[face], *layer))
+			return false;
+	}
+
+	return true;
+}
+
+
+bool tImage::tCubeToEquirect
+(
+	tPicture& dest, const tPicture faces[tCube::NumFaces], int width, int height,
+	tCubeFilter filter, int numThreads
+)
+{
+	int faceSize = tCube::GetFaceSize(faces);
+	if (!faceSize)
+		return false;
+
+	if (width <= 0)
+		width = 4*faceSize;
+	if (height <= 0)
+		height = 2*faceSize;
+
+	tCube::PaddedImage padded[tCube::NumFaces];
+	tCube::PadFaces(padded, faces);
+
+	// The longitude of each column is the same for every row, so its sine and cosine are worked out once.
+	float* sinLon = new float[2*width];
+	float* cosLon = sinLon + width;
+	for (int x = 0; x < width; x++)
+	{
+		float longitude = ((float(x) + 0.5f)/float(width) - 0.5f) * tMath::TwoPi;
+		sinLon[x] = tMath::tSin(longitude);
+		cosLon[x] = tMath::tCos(longitude);
+	}
+
+	dest.Set(width, height, tPicture::AllocPixels(width*height), false);
+	tSystem::tParallelFor
+	(
+		height,
+		[&](int y)
+		{
+			float latitude = ((float(y) + 0.5f)/float(height) - 0.5f) * tMath::Pi;
+			float sinLat = tMath::tSin(latitude);
+			float cosLat = tMath::tCos(latitude);
+			tPixel* row = dest.GetPixelPointer(0, y);
+			for (int x = 0; x < width; x++)
+			{
+				float s, t;
+				int face = tCube::DirToFace(s, t, tMath::tVector3(cosLat*sinLon[x], sinLat, cosLat*cosLon[x]));
+				row[x] = tCube::SampleUV(padded[face], s, t, filter);
+			}
+		},
+		numThreads
+	);
+
+	delete[] sinLon;
+	return true;
+}
+
+
+bool tImage::tEquirectToCube
+(
+	tPicture faces[tCube::NumFaces], const tPicture& src, int faceSize,
+	tCubeFilter filter, int numThreads
+)
+{
+	if (!src.IsValid())
+		return false;
+
+	if (faceSize <= 0)
+		faceSize = tMath::tMax(src.GetWidth()/4, 1);
+
+	tCube::PaddedImage padded;
+	tCube::PadEquirect(padded, src);
+	tCube::RenderFaces
+	(
+		faces, faceSize,
+		[&](int face, float s, float t)
+		{
+			float u, v;
+			tCube::DirToEquirect(u, v, tCube::FaceToDir(face, s, t));
+			return tCube::SampleUV(padded, u, v, filter);
+		},
+		numThreads
+	);
+
+	return true;
+}
+
+
+bool tImage::tCubeToCross
+(
+	tPicture& dest, const tPicture faces[tCube::NumFaces], tCrossLayout layout,
+	int faceSize, tCubeFilter filter, int numThreads
+)
+{
+	int srcSize = tCube::GetFaceSize(faces);
+	if (!srcSize)
+		return false;
+
+	if (faceSize <= 0)
+		faceSize = srcSize;
+
+	// Same-sized faces are copied. Anything else is resampled from padded faces so the filter blends across seams.
+	bool resample = (faceSize != srcSize);
+	tCube::PaddedImage padded[tCube::NumFaces];
+	if (resample)
+		tCube::PadFaces(padded, faces);
+
+	int numCellsX = (layout == tCrossLayout::Horizontal) ? 4 : 3;
+	int numCellsY = (layout == tCrossLayout::Horizontal) ? 3 : 4;
+	int width = numCellsX*faceSize;
+	int height = numCellsY*faceSize;
+	float invSize = 1.0f / float(faceSize);
+	dest.Set(width, height, tPicture::AllocPixels(width*height), false);
+	tSystem::tParallelFor
+	(
+		height,
+		[&](int y)
+		{
+			tPixel* row = dest.GetPixelPointer(0, y);
+			for (int cellX = 0; cellX < numCellsX; cellX++)
+			{
+				tPixel* cell = row + cellX*faceSize;
+				int face = tCube::GetCrossFace(layout, cellX, y / faceSize);
+				if (face < 0)
+				{
+					for (int x = 0; x < faceSize; x++)
+						cell[x] = tPixel::transparent;
+					continue;
+				}
+
+				bool rotated = tCube::IsCrossRotated(layout, face);
+				int fy = rotated ? (faceSize - 1 - y % faceSize) : (y % faceSize);
+				float t = (float(fy) + 0.5f)*invSize;
+				for (int x = 0; x < faceSize; x++)
+				{
+					int fx = rotated ? (faceSize - 1 - x) : x;
+					if (resample)
+						cell[x] = tCube::SampleUV(padded[face], (float(fx) + 0.5f)*invSize, t, filter);
+					else
+						cell[x] = faces[face].GetPixel(fx, fy);
+				}
+			}
+		},
+		numThreads
+	);
+
+	return true;
+}
+
+
+bool tImage::tCrossToCube
+(
+	tPicture faces[tCube::NumFaces], const tPicture& src, int faceSize,
+	tCubeFilter filter, int numThreads
+)
+{
+	int width = src.GetWidth();
+	int height = src.GetHeight();
+	if (!src.IsValid() || ((width*3 != height*4) && (width*4 != height*3)))
+		return false;
+
+	tCrossLayout layout = (width > height) ? tCrossLayout::Horizontal : tCrossLayout::Vertical;
+	int cellSize = (layout == tCrossLayout::Horizontal) ? width/4 : width/3;
+	if (faceSize <= 0)
+		faceSize = cellSize;
+
+	// The cells are always copied out at their own size first. Resampling, if needed, happens on the whole cube so
+	// the filter reads across the seams rather than into the neighbouring cells of the cross.
+	tPicture cells[tCube::NumFaces];
+	tPicture* copyTo = (faceSize == cellSize) ? faces : cells;
+	for (int face = 0; face < tCube::NumFaces; face++)
+		copyTo[face].Set(cellSize, cellSize, tPicture::AllocPixels(cellSize*cellSize), false);
+
+	tSystem::tParallelFor
+	(
+		tCube::NumFaces*cellSize,
+		[&](int row)
+		{
+			int face = row / cellSize;
+			int y = row % cellSize;
+			bool rotated = tCube::IsCrossRotated(layout, face);
+			int originX = tCube::CrossCells[int(layout)][face][0]*cellSize;
+			int originY = tCube::CrossCells[int(layout)][face][1]*cellSize;
+			int sy = originY + (rotated ? (cellSize - 1 - y) : y);
+			tPixel* dest = copyTo[face].GetPixelPointer(0, y);
+			for (int x = 0; x < cellSize; x++)
+				dest[x] = src.GetPixel(originX + (rotated ? (cellSize - 1 - x) : x), sy);
+		},
+		numThreads
+	);
+
+	if (copyTo == faces)
+		return true;
+
+	tCube::PaddedImage padded[tCube::NumFaces];
+	tCube::PadFaces(padded, cells);
+	tCube::RenderFaces
+	(
+		faces, faceSize,
+		[&](int face, float s, float t)
+		{
+			return tCube::SampleUV(padded[face], s, t, filter);
+		},
+		numThreads
+	);
+
+	return true;
+}
@@ -0,0 +1,321 @@
+// tExportSet.cpp
+//
+// Makes several resized copies of one image, such as a thumbnail, a preview and a few web sizes, from a single decode.
+// The source is halved repeatedly with a box filter into a pyramid, and each output is resampled from the smallest
+// level that is still at least as big as it. Small outputs then only filter a small level instead of the full image.
+// Resampling uses tBandResample, so results differ slightly from tPicture::Resample. The outputs are resampled and
+// saved in parallel.
+//
+// Copyright (c) 2020 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include "Foundation/tStandard.h"
+#include "Foundation/tSort.h"
+#include "Math/tFundamentals.h"
+#include "System/tFile.h"
+#include "System/tTime.h"
+#include "System/tMachine.h"
+#include "Image/tExportSet.h"
+#include "Image/tBandPipeline.h"
+using namespace tSystem;
+namespace tImage
+{
+
+
+namespace tExport
+{
+	// For each destination pixel along an axis, the first of the three source pixels it averages and their weights.
+	// An even size halves to pairs with the third weight zero. An odd size 2n+1 has no pairs, so each of the n outputs
+	// covers 2+1/n source pixels, and the weights are how much of each source pixel it covers. That way no row or
+	// column is dropped and the image doesn't shift.
+	struct HalfAxis
+	{
+		HalfAxis(int srcSize);
+		~HalfAxis()																										{ delete[] First; delete[] Weights; }
+		int DstSize;
+		int* First;
+		float* Weights;
+	};
+
+	// Makes dst half the size of src. Rows are done in bands spread over the threads.
+	void Halve(tPicture& dst, const tPicture& src, int numThreads);
+
+	void GetTargetSize(int& width, int& height, const tExportTarget&, int srcWidth, int srcHeight);
+
+	struct Job
+	{
+		int Index;
+		int64 Area;
+	};
+	bool CompareJobs(const Job& a, const Job& b)																		{ return a.Area > b.Area; }
+}
+
+
+tExport::HalfAxis::HalfAxis(int srcSize)
+{
+	tAssert(srcSize > 0);
+	DstSize = tMath::tMax(srcSize / 2, 1);
+	First = new int[DstSize];
+	Weights = new float[DstSize*3];
+	for (int d = 0; d < DstSize; d++)
+	{
+		float* weights = Weights + d*3;
+		if (srcSize == 1)
+		{
+			First[d] = 0;
+			weights[0] = 1.0f;	weights[1] = 0.0f;	weights[2] = 0.0f;
+		}
+		else if ((srcSize & 1) == 0)
+		{
+			First[d] = d*2;
+			weights[0] = 0.5f;	weights[1] = 0.5f;	weights[2] = 0.0f;
+		}
+		else
+		{
+			int n = DstSize;
+			float scale = 1.0f / float(srcSize);
+			First[d] = d*2;
+			weights[0] = float(n-d) * scale;
+			weights[1] = float(n) * scale;
+			weights[2] = float(d+1) * scale;
+		}
+	}
+}
+
+
+void tExport::Halve(tPicture& dst, const tPicture& src, int numThreads)
+{
+	int srcW = src.GetWidth();
+	int srcH = src.GetHeight();
+	HalfAxis axisX(srcW);
+	HalfAxis axisY(srcH);
+	int dstW = axisX.DstSize;
+	int dstH = axisY.DstSize;
+	const tPixel* srcPixels = src.GetPixels();
+	tPixel* dstPixels = tPicture::AllocPixels(dstW*dstH);
+	const int bandRows = 32;
+	int numBands = (dstH + bandRows - 1) / bandRows;
+	tSystem::tParallelFor
+	(
+		numBands,
+		[&](int band)
+		{
+			// The source rows are first averaged into a row of RGBA floats, which is then halved across.
+			float* row = new float[srcW*4];
+			int endY = tMath::tMin((band+1)*bandRows, dstH);
+			for (int y = band*bandRows; y < endY; y++)
+			{
+				const float* weightsY = axisY.Weights + y*3;
+				for (int i = 0; i < srcW*4; i++)
+					row[i] = 0.0f;
+
+				for (int j = 0; j < 3; j++)
+				{
+					if (weightsY[j] == 0.0f)
+						continue;
+					const tPixel* srcRow = srcPixels + (axisY.First[y] + j)*srcW;
+					for (int x = 0; x < srcW; x++)
+					{
+						row[x*4 + 0] += weightsY[j] * float(srcRow[x].R);
+						row[x*4 + 1] += weightsY[j] * float(srcRow[x].G);
+						row[x*4 + 2] += weightsY[j] * float(srcRow[x].B);
+						row[x*4 + 3] += weightsY[j] * float(srcRow[x].A);
+					}
+				}
+
+				tPixel* dstRow = dstPixels + y*dstW;
+				for (int x = 0; x < dstW; x++)
+				{
+					const float* weightsX = axisX.Weights + x*3;
+					const float* srcPixel = row + axisX.First[x]*4;
+					float r = 0.0f; float g = 0.0f; float b = 0.0f; float a = 0.0f;
+					for (int i = 0; i < 3; i++)
+					{
+						if (weightsX[i] == 0.0f)
+							continue;
+						r += weightsX[i] * srcPixel[i*4 + 0];
+						g += weightsX[i] * srcPixel[i*4 + 1];
+						b += weightsX[i] * srcPixel[i*4 + 2];
+						a += weightsX[i] * srcPixel[i*4 + 3];
+					}
+					dstRow[x].R = uint8(tMath::tClamp(tMath::tFloatToInt(r), 0, 255));
+					dstRow[x].G = uint8(tMath::tClamp(tMath::tFloatToInt(g), 0, 255));
+					dstRow[x].B = uint8(tMath::tClamp(tMath::tFloatToInt(b), 0, 255));
+					dstRow[x].A = uint8(tMath::tClamp(tMath::tFloatToInt(a), 0, 255));
+				}
+			}
+			delete[] row;
+		},
+		numThreads
+	);
+
+	dst.Set(dstW, dstH, dstPixels, false);
+}
+
+
+void tExport::GetTargetSize(int& width, int& height, const tExportTarget& target, int srcWidth, int srcHeight)
+{
+	width = target.Width;
+	height = target.Height;
+	if ((width <= 0) && (height <= 0))
+	{
+		width = srcWidth;
+		height = srcHeight;
+	}
+	else if (width <= 0)
+	{
+		width = tMath::tMax(tMath::tFloatToInt(float(height) * float(srcWidth) / float(srcHeight)), 1);
+	}
+	else if (height <= 0)
+	{
+		height = tMath::tMax(tMath::tFloatToInt(float(width) * float(srcHeight) / float(srcWidth)), 1);
+	}
+}
+
+
+void tExportSet::AddTarget(const tString& file, int width, int height, tPicture::tFilter filter)
+{
+	tExportTarget target;
+	target.File = file;
+	target.Width = width;
+	target.Height = height;
+	target.Filter = filter;
+	Targets.Append(target);
+}
+
+
+int tExportSet::Export(const tString& imageFile, int numThreads)
+{
+	double start = tGetTimeDouble();
+	tPicture source;
+	source.Load(imageFile);
+	float loadTime = float(tGetTimeDouble() - start);
+
+	int numSaved = Export(source, numThreads);
+	LoadTime = loadTime;
+	TotalTime = float(tGetTimeDouble() - start);
+	return numSaved;
+}
+
+
+int tExportSet::Export(const tPicture& source, int numThreads)
+{
+	double start = tGetTimeDouble();
+	int numTargets = Targets.GetNumElements();
+	Results.Clear(numTargets);
+	for (int t = 0; t < numTargets; t++)
+		Results.Append(tExportResult());
+
+	NumLevels = 0;
+	LoadTime = 0.0f;
+	PyramidTime = 0.0f;
+	TotalTime = 0.0f;
+	if (!source.IsValid() || (numTargets <= 0))
+		return 0;
+
+	// Each target uses the smallest level it doesn't have to be enlarged from. Only the levels that are used get made.
+	int srcW = source.GetWidth();
+	int srcH = source.GetHeight();
+	tExport::Job* jobs = new tExport::Job[numTargets];
+	for (int t = 0; t < numTargets; t++)
+	{
+		tExportResult& result = Results[t];
+		tExport::GetTargetSize(result.Width, result.Height, Targets[t], srcW, srcH);
+
+		int levelW = srcW;
+		int levelH = srcH;
+		result.Level = 0;
+		while ((levelW > 1) || (levelH > 1))
+		{
+			levelW = tMath::tMax(levelW / 2, 1);
+			levelH = tMath::tMax(levelH / 2, 1);
+			if ((levelW < result.Width) || (levelH < result.Height))
+				break;
+			result.Level++;
+		}
+		NumLevels = tMath::tMax(NumLevels, result.Level + 1);
+
+		jobs[t].Index = t;
+		jobs[t].Area = int64(result.Width) * int64(result.Height);
+	}
+
+	// Each level is made from the one before it, so only the rows within a level can be done in parallel.
+	tPicture* levels = new tPicture[NumLevels];
+	for (int level = 1; level < NumLevels; level++)
+		tExport::Halve(levels[level], (level == 1) ? source : levels[level-1], numThreads);
+	PyramidTime = float(tGetTimeDouble() - start);
+
+	// The biggest targets are started first so a big one isn't left running on its own at the end.
+	tSort::tInsertion(jobs, numTargets, tExport::CompareJobs);
+	tSystem::tParallelFor
+	(
+		numTargets,
+		[&](int j)
+		{
+			int t = jobs[j].Index;
+			const tExportTarget& target = Targets[t];
+			tExportResult& result = Results[t];
+
+			double resampleStart = tGetTimeDouble();
+			const tPicture& level = result.Level ? levels[result.Level] : source;
+			tPicture picture;
+			bool ok = true;
+			if ((level.GetWidth() == result.Width) && (level.GetHeight() == result.Height))
+			{
+				picture.Set(level);
+			}
+			else
+			{
+				tBandPictureSource levelSource(level.GetView());
+				tBandResample resample(levelSource, result.Width, result.Height, target.Filter);
+				tBandPictureSink sink(picture);
+				ok = tStream(sink, resample);
+			}
+			double saveStart = tGetTimeDouble();
+			if (ok)
+				result.Saved = picture.Save(target.File, target.Format);
+			result.ResampleTime = float(saveStart - resampleStart);
+			result.SaveTime = float(tGetTimeDouble() - saveStart);
+		},
+		numThreads
+	);
+
+	delete[] levels;
+	delete[] jobs;
+
+	int numSaved = 0;
+	for (int t = 0; t < numTargets; t++)
+		if (Results[t].Saved)
+			numSaved++;
+
+	TotalTime = float(tGetTimeDouble() - start);
+	return numSaved;
+}
+
+
+void tExportSet::PrintTimings() const
+{
+	tPrintf("Loaded in %.3fs. %d pyramid levels in %.3fs. ", LoadTime, NumLevels, PyramidTime);
+	tPrintf("%d targets in %.3fs total.\n", Results.GetNumElements(), TotalTime);
+	for (int t = 0; t < Results.GetNumElements(); t++)
+	{
+		tExportResult result = Results[t];
+		tString name = tGetFileName(Targets[t].File);
+		tPrintf
+		(
+			"  %-20s %5dx%-5d from level %d  resample %.3fs  save %.3fs%s\n",
+			name.Chars(), result.Width, result.Height, result.Level, result.ResampleTime, result.SaveTime,
+			result.Saved ? "" : "  FAILED"
+		);
+	}
+}
+
+
+}
@@ -1,9 +1,9 @@
 // tFileDDS.cpp
 //
-// This class is a helper class. It should not be necessary to use this class directly. It knows how to load (but not
-// save) a Direct Draw Surface (.dds) file. It does zero processing of image data. It knows the details of the dds file
+// This class is a helper class. It should not be necessary to use this class directly. It knows how to load and save
+// a Direct Draw Surface (.dds) file. It does zero processing of image data. It knows the details of the dds file
 // format and loads the data into tLayers. This class does not compress or decompress the image data if it is
-// compressed (DXTn), it simply keeps it in the same format as the source file. The layers may be 'stolen' from a
+// compressed (BCn), it simply keeps it in the same format as the source file. The layers may be 'stolen' from a
 // tFileDDS so that excessive memcpys are avoided. After they are stolen the tFileDDS is invalid.
 //
 // A good viewer for dds files (and targas) is called ddsview. It is one of the few viewers that displays alphas
@@ -144,6 +144,10 @@ int tFileDDS::StealCubemapLayers(tList<tLayer> layerLists[tSurfIndex_NumSurfaces
 }
 
 
+// Every dds file starts with this.
+const uint32 tDDSMagic = FourCC('D', 'D', 'S', ' ');
+
+
 enum tDDSPixelFormatFlag
 {
 	// May be used in the DDSPixelFormat struct to indicate alphas present for RGB formats.
@@ -153,7 +157,10 @@ enum tDDSPixelFormatFlag
 	tDDSPixelFormatFlag_FourCC	= 0x00000004,
 
 	// A DDS file may contain this type of data (pixel format). eg. A8R8G8B8
-	tDDSPixelFormatFlag_RGB		= 0x00000040
+	tDDSPixelFormatFlag_RGB		= 0x00000040,
+
+	// Like RGB but only the red mask is used, for the luminance. eg. A8L8
+	tDDSPixelFormatFlag_Luminance	= 0x00020000
 };
 
 
@@ -322,6 +329,48 @@ enum tD3DFORMAT
 };
 
 
+// The subset of DXGI_FORMAT values that we read and write in the DX10 extended header.
+enum tDXGIFormat
+{
+	tDXGIFormat_Unknown			= 0,
+	tDXGIFormat_R8G8B8A8_UNORM	= 28,
+	tDXGIFormat_BC1_UNORM		= 71,
+	tDXGIFormat_BC2_UNORM		= 74,
+	tDXGIFormat_BC3_UNORM		= 77,
+	tDXGIFormat_BC4_UNORM		= 80,
+	tDXGIFormat_BC5_UNORM		= 83,
+	tDXGIFormat_B8G8R8A8_UNORM	= 87,
+	tDXGIFormat_BC6H_UF16		= 95,
+	tDXGIFormat_BC7_UNORM		= 98
+};
+
+
+enum tDDSResourceDimension
+{
+	tDDSResourceDimension_Texture2D		= 3
+};
+
+
+enum tDDSMiscFlag
+{
+	tDDSMiscFlag_TextureCube	= 0x00000004
+};
+
+
+// Follows the main header when the pixel format FourCC is "DX10". It is needed for the formats that have no legacy
+// FourCC or mask description, like BC6H and BC7.
+#pragma pack(push, 4)
+struct tDDSHeaderDX10
+{
+	uint32 DxgiFormat;							// See tDXGIFormat.
+	uint32 ResourceDimension;					// See tDDSResourceDimension.
+	uint32 MiscFlag;							// See tDDSMiscFlag.
+	uint32 ArraySize;							// For cubemaps this is the number of cubes, not faces.
+	uint32 MiscFlags2;							// Alpha mode. 0 is unknown.
+};
+#pragma pack(pop)
+
+
 // Default packing is 8 bytes but the header is 128 bytes (mult of 4), so we make it all work here.
 #pragma pack(push, 4)
 struct tDDSHeader
@@ -369,13 +418,13 @@ struct tDXT3Block
 };
 
 
-// This one is the same for DXT4 and 5, although we don't support 4 (premultiplied alpha). Size is 128 bits.
-struct tDXT5Block
+// The interpolated alpha part of a DXT5 block. A BC4 block is exactly one of these and a BC5 block is two, one for
+// each channel. Size is 64 bits.
+struct tDXT5AlphaBlock
 {
 	uint8 Alpha0;
 	uint8 Alpha1;
 	uint8 AlphaTable[6];						// Each of the 4x4 pixel entries is 3 bits.
-	tDXT1Block ColourBlock;
 
 	// These accessors are needed because of the unusual alignment of the 3bit alpha indexes. They each return or set a
 	// value in [0, 2^12) which represents a single row. The row variable should be in [0, 3]
@@ -426,10 +475,496 @@ struct tDXT5Block
 				break;
 		}
 	}
+
+	void ReverseRows()
+	{
+		uint16 orig0 = GetAlphaRow(0);
+		SetAlphaRow(0, GetAlphaRow(3));
+		SetAlphaRow(3, orig0);
+
+		uint16 orig1 = GetAlphaRow(1);
+		SetAlphaRow(1, GetAlphaRow(2));
+		SetAlphaRow(2, orig1);
+	}
+};
+
+
+// This one is the same for DXT4 and 5, although we don't support 4 (premultiplied alpha). Size is 128 bits.
+struct tDXT5Block
+{
+	tDXT5AlphaBlock AlphaBlock;
+	tDXT1Block ColourBlock;
+};
+
+
+// BC5 (ATI2) stores two independent channels. Size is 128 bits.
+struct tBC5Block
+{
+	tDXT5AlphaBlock RedBlock;
+	tDXT5AlphaBlock GreenBlock;
 };
 #pragma pack(pop)
 
 
+namespace tDDS
+{
+	// Copies the pixel data of a single layer into dest with the order of the rows reversed. DDS files store their rows
+	// top to bottom while we go bottom to top. BC blocks are reordered and then their lookup tables are flipped so no
+	// decode or re-encode is needed. Returns false if the pixel format can't be flipped this way. BC6H and BC7 can't as
+	// their index layouts depend on the block mode and partition.
+	bool ReverseRows(uint8* dest, const uint8* src, tPixelFormat, int width, int height);
+	void ReverseBlockRows(uint8* blocks, tPixelFormat, int numBlocks);
+
+	// Return the pixel format described by a dds pixel format or DX10 header, or Invalid if it isn't supported. The
+	// first returns Invalid for the DX10 FourCC since the format is in the extended header.
+	tPixelFormat GetPixelFormat(const tDDSPixelFormat&);
+	tPixelFormat GetPixelFormat(const tDDSHeaderDX10&);
+}
+
+
+bool tDDS::ReverseRows(uint8* dest, const uint8* src, tPixelFormat format, int width, int height)
+{
+	if (tIsNormalFormat(format))
+	{
+		int bytesPerRow = width*tGetBytesPerPixel(format);
+		for (int y = 0; y < height; y++)
+			tStd::tMemcpy(dest + y*bytesPerRow, src + (height-1-y)*bytesPerRow, bytesPerRow);
+
+		return true;
+	}
+
+	if (!tIsBlockFormat(format) || (format == tPixelFormat::BC6H) || (format == tPixelFormat::BC7))
+		return false;
+
+	// Each block row is 4 pixel rows. First the block rows are swapped around, then the rows inside each block.
+	int bytesPerBlock = tGetBytesPer4x4PixelBlock(format);
+	int numBlocksW = (width + 3) / 4;
+	int numBlocksH = (height + 3) / 4;
+	int bytesPerBlockRow = numBlocksW*bytesPerBlock;
+	for (int y = 0; y < numBlocksH; y++)
+		tStd::tMemcpy(dest + y*bytesPerBlockRow, src + (numBlocksH-1-y)*bytesPerBlockRow, bytesPerBlockRow);
+
+	ReverseBlockRows(dest, format, numBlocksW*numBlocksH);
+	return true;
+}
+
+
+void tDDS::ReverseBlockRows(uint8* blocks, tPixelFormat format, int numBlocks)
+{
+	// The 2-bit colour lookups are a byte per row so the rows just get swapped. The alpha tables are a little more
+	// work. Note that rows are swapped even for blocks smaller than 4x4 (the smallest mips). The unused rows are
+	// expected to hold copies of the used ones so it makes no difference.
+	switch (format)
+	{
+		case tPixelFormat::BC1_DXT1:
+		case tPixelFormat::BC1_DXT1BA:
+		{
+			tDXT1Block* block = (tDXT1Block*)blocks;
+			for (int b = 0; b < numBlocks; b++, block++)
+			{
+				tStd::tSwap(block->LookupTableRows[0], block->LookupTableRows[3]);
+				tStd::tSwap(block->LookupTableRows[1], block->LookupTableRows[2]);
+			}
+			break;
+		}
+
+		case tPixelFormat::BC2_DXT3:
+		{
+			tDXT3Block* block = (tDXT3Block*)blocks;
+			for (int b = 0; b < numBlocks; b++, block++)
+			{
+				tStd::tSwap(block->AlphaTableRows[0], block->AlphaTableRows[3]);
+				tStd::tSwap(block->AlphaTableRows[1], block->AlphaTableRows[2]);
+				tStd::tSwap(block->ColourBlock.LookupTableRows[0], block->ColourBlock.LookupTableRows[3]);
+				tStd::tSwap(block->ColourBlock.LookupTableRows[1], block->ColourBlock.LookupTableRows[2]);
+			}
+			break;
+		}
+
+		case tPixelFormat::BC3_DXT5:
+		{
+			tDXT5Block* block = (tDXT5Block*)blocks;
+			for (int b = 0; b < numBlocks; b++, block++)
+			{
+				block->AlphaBlock.ReverseRows();
+				tStd::tSwap(block->ColourBlock.LookupTableRows[0], block->ColourBlock.LookupTableRows[3]);
+				tStd::tSwap(block->ColourBlock.LookupTableRows[1], block->ColourBlock.LookupTableRows[2]);
+			}
+			break;
+		}
+
+		case tPixelFormat::BC4_ATI1:
+		{
+			tDXT5AlphaBlock* block = (tDXT5AlphaBlock*)blocks;
+			for (int b = 0; b < numBlocks; b++, block++)
+				block->ReverseRows();
+			break;
+		}
+
+		case tPixelFormat::BC5_ATI2:
+		{
+			tBC5Block* block = (tBC5Block*)blocks;
+			for (int b = 0; b < numBlocks; b++, block++)
+			{
+				block->RedBlock.ReverseRows();
+				block->GreenBlock.ReverseRows();
+			}
+			break;
+		}
+
+		default:
+			break;
+	}
+}
+
+
+tPixelFormat tDDS::GetPixelFormat(const tDDSPixelFormat& format)
+{
+	// Has alpha should be true if the pixel format is uncompressed (RGB) and there is an alpha channel.
+	bool rgbHasAlpha = (format.Flags & tDDSPixelFormatFlag_Alpha) ? true : false;
+	bool rgbFormat = (format.Flags & (tDDSPixelFormatFlag_RGB | tDDSPixelFormatFlag_Luminance)) ? true : false;
+	bool luminanceFormat = (format.Flags & tDDSPixelFormatFlag_Luminance) ? true : false;
+	bool fourCCFormat = (format.Flags & tDDSPixelFormatFlag_FourCC) ? true : false;
+	if ((!rgbFormat && !fourCCFormat) || (rgbFormat && fourCCFormat))
+		return tPixelFormat::Invalid;
+
+	if (fourCCFormat)
+	{
+		switch (format.FourCC)
+		{
+			case FourCC('D','X','T','1'):
+				// Note that during inspecition of the individual layer data, the DXT1 pixel format might be modified
+				// to DXT1BA (binary alpha).
+				return tPixelFormat::BC1_DXT1;
+
+			case FourCC('D','X','T','3'):
+				return tPixelFormat::BC2_DXT3;
+
+			case FourCC('D','X','T','5'):
+				return tPixelFormat::BC3_DXT5;
+
+			case FourCC('A','T','I','1'):
+			case FourCC('B','C','4','U'):
+				return tPixelFormat::BC4_ATI1;
+
+			case FourCC('A','T','I','2'):
+			case FourCC('B','C','5','U'):
+				return tPixelFormat::BC5_ATI2;
+
+			case tD3DFMT_R32F:
+				return tPixelFormat::R32F;
+
+			case tD3DFMT_G32R32F:
+				return tPixelFormat::G32R32F;
+
+			case tD3DFMT_A32B32G32R32F:
+				return tPixelFormat::A32B32G32R32F;
+
+			default:
+				return tPixelFormat::Invalid;
+		}
+	}
+
+	// It must be an RGB format.
+	else
+	{
+		// Remember this is a little endian machine, so the masks are lying. Eg. 0xFF0000 in memory is 00 00 FF, so the red
+		// is last.
+		switch (format.RGBBitCount)
+		{
+			case 16:
+				// Supports L8A8, G3B5A1R5G2, G4B4A4R4, and G3B5R5G3.
+				if
+				(
+					luminanceFormat && rgbHasAlpha &&
+					(format.MaskAlpha	== 0xFF00) &&
+					(format.MaskRed		== 0x00FF)
+				)
+				{
+					return tPixelFormat::L8A8;
+				}
+
+				else if
+				(
+					rgbHasAlpha &&
+					(format.MaskAlpha	== 0x8000) &&
+					(format.MaskRed		== 0x7C00) &&
+					(format.MaskGreen	== 0x03E0) &&
+					(format.MaskBlue	== 0x001F)
+				)
+				{
+					return tPixelFormat::G3B5A1R5G2;
+				}
+
+				else if
+				(
+					rgbHasAlpha &&
+					(format.MaskAlpha	== 0xF000) &&
+					(format.MaskRed		== 0x0F00) &&
+					(format.MaskGreen	== 0x00F0) &&
+					(format.MaskBlue	== 0x000F)
+				)
+				{
+					return tPixelFormat::G4B4A4R4;
+				}
+
+				else if
+				(
+					!rgbHasAlpha &&
+					(format.MaskRed		== 0xF800) &&
+					(format.MaskGreen	== 0x07E0) &&
+					(format.MaskBlue	== 0x001F)
+				)
+				{
+					return tPixelFormat::G3B5R5G3;
+				}
+
+				else
+				{
+					return tPixelFormat::Invalid;
+				}
+
+			case 24:
+				// Supports B8G8R8 and R8G8B8.
+				if
+				(
+					!rgbHasAlpha &&
+					(format.MaskRed		== 0xFF0000) &&
+					(format.MaskGreen	== 0x00FF00) &&
+					(format.MaskBlue	== 0x0000FF)
+				)
+				{
+					return tPixelFormat::B8G8R8;
+				}
+
+				// Red first in memory.
+				else if
+				(
+					!rgbHasAlpha &&
+					(format.MaskRed		== 0x0000FF) &&
+					(format.MaskGreen	== 0x00FF00) &&
+					(format.MaskBlue	== 0xFF0000)
+				)
+				{
+					return tPixelFormat::R8G8B8;
+				}
+
+				else
+				{
+					return tPixelFormat::Invalid;
+				}
+
+			case 32:
+				// Supports B8G8R8A8 and R8G8B8A8. This is a little endian machine so the masks are lying. 0xFF000000 in memory is
+				// 00 00 00 FF with alpha last.
+				if
+				(
+					rgbHasAlpha &&
+					(format.MaskAlpha	== 0xFF000000) &&
+					(format.MaskRed		== 0x00FF0000) &&
+					(format.MaskGreen	== 0x0000FF00) &&
+					(format.MaskBlue	== 0x000000FF)
+				)
+				{
+					return tPixelFormat::B8G8R8A8;
+				}
+				else if
+				(
+					rgbHasAlpha &&
+					(format.MaskAlpha	== 0xFF000000) &&
+					(format.MaskRed		== 0x000000FF) &&
+					(format.MaskGreen	== 0x0000FF00) &&
+					(format.MaskBlue	== 0x00FF0000)
+				)
+				{
+					return tPixelFormat::R8G8B8A8;
+				}
+				else
+				{
+					return tPixelFormat::Invalid;
+				}
+
+			default:
+				return tPixelFormat::Invalid;
+		}
+	}
+
+	return tPixelFormat::Invalid;
+}
+
+
+tPixelFormat tDDS::GetPixelFormat(const tDDSHeaderDX10& header)
+{
+	switch (header.DxgiFormat)
+	{
+		case tDXGIFormat_BC1_UNORM:			return tPixelFormat::BC1_DXT1;
+		case tDXGIFormat_BC2_UNORM:			return tPixelFormat::BC2_DXT3;
+		case tDXGIFormat_BC3_UNORM:			return tPixelFormat::BC3_DXT5;
+		case tDXGIFormat_BC4_UNORM:			return tPixelFormat::BC4_ATI1;
+		case tDXGIFormat_BC5_UNORM:			return tPixelFormat::BC5_ATI2;
+		case tDXGIFormat_BC6H_UF16:			return tPixelFormat::BC6H;
+		case tDXGIFormat_BC7_UNORM:			return tPixelFormat::BC7;
+
+		case tDXGIFormat_R8G8B8A8_UNORM:	return tPixelFormat::R8G8B8A8;
+		case tDXGIFormat_B8G8R8A8_UNORM:	return tPixelFormat::B8G8R8A8;
+	}
+
+	return tPixelFormat::Invalid;
+}
+
+
+bool tFileDDS::ReadHeader
+(
+	const uint8* ddsData, int numBytes, tPixelFormat& pixelFormat, int& width, int& height, int& numMipmaps,
+	bool& cubemap
+)
+{
+	if (!ddsData || (numBytes < int(sizeof(uint32) + sizeof(tDDSHeader))))
+		return false;
+	if (*((const uint32*)ddsData) != tDDSMagic)
+		return false;
+
+	const tDDSHeader& header = *((const tDDSHeader*)(ddsData + sizeof(uint32)));
+	if ((header.Size != 124) || (header.PixelFormat.Size != 32) || (header.Flags & tDDSFlag_Depth))
+		return false;
+
+	width = header.Width;
+	height = header.Height;
+	numMipmaps = 1;
+	bool hasMipmaps = (header.Capabilities.FlagsCapsBasic & tDDSCapsBasic_Mipmap) ? true : false;
+	if ((header.Flags & tDDSFlag_MipmapCount) && hasMipmaps && (header.MipmapCount > 1))
+		numMipmaps = header.MipmapCount;
+
+	cubemap = (header.Capabilities.FlagsCapsExtra & tDDSCapsExtra_CubeMap) ? true : false;
+	const tDDSPixelFormat& format = header.PixelFormat;
+	if ((format.Flags & tDDSPixelFormatFlag_FourCC) && (format.FourCC == FourCC('D','X','1','0')))
+	{
+		if (numBytes < int(sizeof(uint32) + sizeof(tDDSHeader) + sizeof(tDDSHeaderDX10)))
+			return false;
+
+		const tDDSHeaderDX10& headerDX10 = *((const tDDSHeaderDX10*)(ddsData + sizeof(uint32) + sizeof(tDDSHeader)));
+		if ((headerDX10.ResourceDimension != tDDSResourceDimension_Texture2D) || (headerDX10.ArraySize > 1))
+			return false;
+
+		if (headerDX10.MiscFlag & tDDSMiscFlag_TextureCube)
+			cubemap = true;
+
+		pixelFormat = tDDS::GetPixelFormat(headerDX10);
+	}
+	else
+	{
+		pixelFormat = tDDS::GetPixelFormat(format);
+	}
+
+	return (pixelFormat != tPixelFormat::Invalid) && (width > 0) && (height > 0);
+}
+
+
+tLayer* tFileDDS::LoadClosestLayer
+(
+	const tString& ddsFile, int fitWidth, int fitHeight, tSurfIndex side, bool reverseRowOrder
+)
+{
+	tFileHandle file = tSystem::tOpenFile(ddsFile.ConstText(), "rb");
+	if (!file)
+		return nullptr;
+
+	const int maxHeaderSize = sizeof(uint32) + sizeof(tDDSHeader) + sizeof(tDDSHeaderDX10);
+	uint8 headerData[maxHeaderSize];
+	int fileSize = tSystem::tGetFileSize(file);
+	int headerSize = tSystem::tReadFile(file, headerData, maxHeaderSize);
+
+	tPixelFormat format;
+	int width, height, numMipmaps;
+	bool cubemap;
+	if
+	(
+		!ReadHeader(headerData, headerSize, format, width, height, numMipmaps, cubemap) ||
+		(numMipmaps > MaxMipmapLayers) || (width > MaxDimension) || (height > MaxDimension) ||
+		(!tIsNormalFormat(format) && !tIsBlockFormat(format)) || (tIsBlockFormat(format) && ((width%4) || (height%4)))
+	)
+	{
+		tSystem::tCloseFile(file);
+		return nullptr;
+	}
+
+	// The pixel data starts right after the header, which includes the extended header if there is one.
+	const tDDSPixelFormat& ddsFormat = ((const tDDSHeader*)(headerData + sizeof(uint32)))->PixelFormat;
+	bool dx10 = (ddsFormat.Flags & tDDSPixelFormatFlag_FourCC) && (ddsFormat.FourCC == FourCC('D','X','1','0'));
+	int64 offset = sizeof(uint32) + sizeof(tDDSHeader) + (dx10 ? sizeof(tDDSHeaderDX10) : 0);
+
+	// Same layout as LoadFromMemory. Each image (cubemap side) holds all its mipmaps, largest first. Partial blocks are
+	// rounded up, which is the same for the power-of-two sizes LoadFromMemory supports.
+	int64 layerSizes[MaxMipmapLayers];
+	int64 imageSize = 0;
+	int w = width;
+	int h = height;
+	for (int layer = 0; layer < numMipmaps; layer++)
+	{
+		if (tIsNormalFormat(format))
+			layerSizes[layer] = int64(w*h) * tGetBytesPerPixel(format);
+		else
+			layerSizes[layer] = int64((w+3)/4) * ((h+3)/4) * tGetBytesPer4x4PixelBlock(format);
+		imageSize += layerSizes[layer];
+		w = tMath::tMax(1, w/2);
+		h = tMath::tMax(1, h/2);
+	}
+
+	if (cubemap)
+		offset += int64(side)*imageSize;
+
+	// Step down while the next layer is still big enough.
+	int layer = 0;
+	w = width;
+	h = height;
+	while ((layer+1 < numMipmaps) && ((w/2 >= fitWidth) || (h/2 >= fitHeight)))
+	{
+		offset += layerSizes[layer++];
+		w = tMath::tMax(1, w/2);
+		h = tMath::tMax(1, h/2);
+	}
+
+	int64 layerSize = layerSizes[layer];
+	if ((layerSize <= 0) || (offset + layerSize > fileSize) || (tSystem::tFileSeek(file, int(offset)) != 0))
+	{
+		tSystem::tCloseFile(file);
+		return nullptr;
+	}
+
+	int numBytes = int(layerSize);
+	uint8* layerData = new uint8[numBytes];
+	int numRead = tSystem::tReadFile(file, layerData, numBytes);
+	tSystem::tCloseFile(file);
+	if (numRead != numBytes)
+	{
+		delete[] layerData;
+		return nullptr;
+	}
+
+	if (format == tPixelFormat::BC1_DXT1)
+	{
+		int numBlocks = numBytes / int(sizeof(tDXT1Block));
+		if (DoDXT1BlocksHaveBinaryAlpha((tDXT1Block*)layerData, numBlocks))
+			format = tPixelFormat::BC1_DXT1BA;
+	}
+
+	if (reverseRowOrder)
+	{
+		uint8* reversedData = new uint8[numBytes];
+		bool reversed = tDDS::ReverseRows(reversedData, layerData, format, w, h);
+		delete[] layerData;
+		if (!reversed)
+		{
+			delete[] reversedData;
+			return nullptr;
+		}
+		layerData = reversedData;
+	}
+
+	return new tLayer(format, w, h, layerData, true);
+}
+
+
 void tFileDDS::Load(const tString& ddsFile, bool reverseRowOrder)
 {
 	Clear();
@@ -468,7 +1003,7 @@ void tFileDDS::LoadFromMemory(const uint8* ddsData, int ddsSizeBytes, bool rever
 	const uint8* ddsCurr = ddsData;
 	uint32& magic = *((uint32*)ddsCurr); ddsCurr += sizeof(uint32);
 
-	if (magic != ' SDD')
+	if (magic != tDDSMagic)
 	{
 		delete[] ddsData;
 		throw tDDSError(tDDSError::tCode::Magic);
@@ -557,9 +1092,7 @@ void tFileDDS::LoadFromMemory(const uint8* ddsData, int ddsSizeBytes, bool rever
 		throw tDDSError(tDDSError::tCode::IncorrectPixelFormatSize, baseName);
 	}
 
-	// Has alpha should be true if the pixel format is uncompressed (RGB) and there is an alpha channel.
-	bool rgbHasAlpha = (format.Flags & tDDSPixelFormatFlag_Alpha) ? true : false;
-	bool rgbFormat = (format.Flags & tDDSPixelFormatFlag_RGB) ? true : false;
+	bool rgbFormat = (format.Flags & (tDDSPixelFormatFlag_RGB | tDDSPixelFormatFlag_Luminance)) ? true : false;
 	bool fourCCFormat = (format.Flags & tDDSPixelFormatFlag_FourCC) ? true : false;
 
 	if ((!rgbFormat && !fourCCFormat) || (rgbFormat && fourCCFormat))
@@ -568,140 +1101,48 @@ void tFileDDS::LoadFromMemory(const uint8* ddsData, int ddsSizeBytes, bool rever
 		throw tDDSError(tDDSError::tCode::InconsistentPixelFormat, baseName);
 	}
 
-	if (fourCCFormat)
+	if (fourCCFormat && (format.FourCC == FourCC('D','X','1','0')))
 	{
-		switch (format.FourCC)
+		// The extended header sits between the main header and the pixel data.
+		if (ddsSizeBytes < int(sizeof(uint32) + sizeof(tDDSHeader) + sizeof(tDDSHeaderDX10)))
 		{
-			case FourCC('D','X','T','1'):
-				// Note that during inspecition of the individual layer data, the DXT1 pixel format might be modified
-				// to DXT1BA (binary alpha).
-				PixelFormat = tPixelFormat::BC1_DXT1;
-				break;
-
-			case FourCC('D','X','T','3'):
-				PixelFormat = tPixelFormat::BC2_DXT3;
-				break;
-
-			case FourCC('D','X','T','5'):
-				PixelFormat = tPixelFormat::BC3_DXT5;
-				break;
+			delete[] ddsData;
+			throw tDDSError(tDDSError::tCode::IncorrectFileSize, baseName);
+		}
 
-			case tD3DFMT_R32F:
-				PixelFormat = tPixelFormat::R32F;
-				break;
+		const tDDSHeaderDX10& headerDX10 = *((const tDDSHeaderDX10*)pixelData);
+		pixelData += sizeof(tDDSHeaderDX10);
 
-			case tD3DFMT_G32R32F:
-				PixelFormat = tPixelFormat::G32R32F;
-				break;
+		// Texture arrays are not supported. An array size of 1 for a cubemap means a single cube.
+		if ((headerDX10.ResourceDimension != tDDSResourceDimension_Texture2D) || (headerDX10.ArraySize > 1))
+		{
+			delete[] ddsData;
+			throw tDDSError(tDDSError::tCode::UnsupportedDX10Resource, baseName);
+		}
 
-			case tD3DFMT_A32B32G32R32F:
-				PixelFormat = tPixelFormat::A32B32G32R32F;
-				break;
+		if (headerDX10.MiscFlag & tDDSMiscFlag_TextureCube)
+		{
+			IsCubeMap = true;
+			NumImages = 6;
+		}
 
-			case FourCC('D','X','1','0'):
-			default:
-				delete[] ddsData;
-				throw tDDSError(tDDSError::tCode::UnsupportedFourCCPixelFormat, baseName);
+		PixelFormat = tDDS::GetPixelFormat(headerDX10);
+		if (PixelFormat == tPixelFormat::Invalid)
+		{
+			delete[] ddsData;
+			throw tDDSError(tDDSError::tCode::UnsupportedFourCCPixelFormat, baseName);
 		}
-	}
 
-	// It must be an RGB format.
+		rgbFormat = tIsNormalFormat(PixelFormat);
+	}
 	else
 	{
-		// Remember this is a little endian machine, so the masks are lying. Eg. 0xFF0000 in memory is 00 00 FF, so the red
-		// is last.
-		switch (format.RGBBitCount)
+		PixelFormat = tDDS::GetPixelFormat(format);
+		if (PixelFormat == tPixelFormat::Invalid)
 		{
-			case 16:
-				// Supports G3B5A1R5G2, G4B4A4R4, and G3B5R5G3.
-				if
-				(
-					rgbHasAlpha &&
-					(format.MaskAlpha	== 0x8000) &&
-					(format.MaskRed		== 0x7C00) &&
-					(format.MaskGreen	== 0x03E0) &&
-					(format.MaskBlue	== 0x001F)
-				)
-				{
-					PixelFormat = tPixelFormat::G3B5A1R5G2;
-				}
-
-				else if
-				(
-					rgbHasAlpha &&
-					(format.MaskAlpha	== 0xF000) &&
-					(format.MaskRed		== 0x0F00) &&
-					(format.MaskGreen	== 0x00F0) &&
-					(format.MaskBlue	== 0x000F)
-				)
-				{
-					PixelFormat = tPixelFormat::G4B4A4R4;
-				}
-
-				else if
-				(
-					!rgbHasAlpha &&
-					(format.MaskRed		== 0xF800) &&
-					(format.MaskGreen	== 0x07E0) &&
-					(format.MaskBlue	== 0x001F)
-				)
-				{
-					PixelFormat = tPixelFormat::G3B5R5G3;
-				}
-
-				else
-				{
-					delete[] ddsData;
-					throw tDDSError(tDDSError::tCode::UnsupportedRGBPixelFormat, baseName);
-				}
-
-				break;
-
-			case 24:
-				// Supports B8G8R8.
-				if
-				(
-					!rgbHasAlpha &&
-					(format.MaskRed		== 0xFF0000) &&
-					(format.MaskGreen	== 0x00FF00) &&
-					(format.MaskBlue	== 0x0000FF)
-				)
-				{
-					PixelFormat = tPixelFormat::B8G8R8;
-				}
-
-				else
-				{
-					delete[] ddsData;
-					throw tDDSError(tDDSError::tCode::UnsupportedRGBPixelFormat, baseName);
-				}
-
-				break;
-
-			case 32:
-				// Supports B8G8R8A8. This is a little endian machine so the masks are lying. 0xFF000000 in memory is
-				// 00 00 00 FF with alpha last.
-				if
-				(
-					rgbHasAlpha &&
-					(format.MaskAlpha	== 0xFF000000) &&
-					(format.MaskRed		== 0x00FF0000) &&
-					(format.MaskGreen	== 0x0000FF00) &&
-					(format.MaskBlue	== 0x000000FF)
-				)
-				{
-					PixelFormat = tPixelFormat::B8G8R8A8;
-				}
-				else
-				{
-					delete[] ddsData;
-					throw tDDSError(tDDSError::tCode::UnsupportedRGBPixelFormat, baseName);
-				}
-				break;
-
-			default:
-				delete[] ddsData;
-				throw tDDSError(tDDSError::tCode::UnsupportedRGBPixelFormat, baseName);
+			delete[] ddsData;
+			tDDSError::tCode code = fourCCFormat ? tDDSError::tCode::UnsupportedFourCCPixelFormat : tDDSError::tCode::UnsupportedRGBPixelFormat;
+			throw tDDSError(code, baseName);
 		}
 	}
 
@@ -729,160 +1170,49 @@ void tFileDDS::LoadFromMemory(const uint8* ddsData, int ddsSizeBytes, bool rever
 			int numBytes;
 			if (rgbFormat)
 			{
-				numBytes = width*height*format.RGBBitCount/8;
-
-				// Deal with the reverseRowOrder for these RGB formats as well.
-				if (reverseRowOrder)
-				{
-					uint8* reversedPixelData = new uint8[numBytes];
-					uint8* dstData = reversedPixelData;
-
-					// We only support pixel formats that contain a whole number of bytes per pixel. That will cover
-					// all reasonable formats.
-					int bytesPerPixel = format.RGBBitCount/8;
-
-					for (int row = height-1; row >= 0; row--)
-					{
-						for (int col = 0; col < width; col++)
-						{
-							const uint8* srcData = pixelData + row*bytesPerPixel*width + col*bytesPerPixel;
-							for (int byte = 0; byte < bytesPerPixel; byte++, dstData++, srcData++)
-								*dstData = *srcData;
-						}
-					}
-
-					// We can simply get the layer to steal the memory (the last true arg).
-					MipmapLayers[layer][image] = new tLayer(PixelFormat, width, height, reversedPixelData, true);
-				}
-				else
-				{
-					MipmapLayers[layer][image] = new tLayer(PixelFormat, width, height, (uint8*)pixelData);
-				}
-				tAssert(MipmapLayers[layer][image]->GetDataSize() == numBytes);
+				numBytes = width*height*tGetBytesPerPixel(PixelFormat);
 			}
 			else
 			{
-				// Otherwise it's a FourCC DXTn format.  Each block encodes a 4x4 square of pixels.  DXT2,3,4,5 use 128
-				// bits per block.  DXT1 and DXT1BA use 64bits per block.
-				int dxtBlockSize = 16;
-				if ((PixelFormat == tPixelFormat::BC1_DXT1BA) || (PixelFormat == tPixelFormat::BC1_DXT1))
-					dxtBlockSize = 8;
-
+				// Otherwise it's a block format. Each block encodes a 4x4 square of pixels. Width and height will go
+				// down to 1x1, which will still use a whole block.
 				int numBlocks = tMath::tMax(1, width/4) * tMath::tMax(1, height/4);
-				numBytes = numBlocks * dxtBlockSize;
+				numBytes = numBlocks * tGetBytesPer4x4PixelBlock(PixelFormat);
 
 				// Here's where we possibly modify the opaque DXT1 texture to be DXT1BA if there are blocks with binary
 				// transparency. We only bother checking the main layer. If it's opaque we assume all the others are too.
 				if ((layer == 0) && (PixelFormat == tPixelFormat::BC1_DXT1) && DoDXT1BlocksHaveBinaryAlpha((tDXT1Block*)pixelData, numBlocks))
 					PixelFormat = tPixelFormat::BC1_DXT1BA;
+			}
 
-				// DDS files store textures upside down. In the OpenGL RH coord system, the lower left of the texture
-				// is the origin and consecutive rows go up. For this reason we need to read each row of blocks from
-				// the top to the bottom row. We also need to flip the rows within the 4x4 block by flipping the lookup
-				// tables. This should be fairly fast as there is no encoding or encoding going on. Width and height
-				// will go down to 1x1, which will still use a 4x4 DXT pixel-block.
-				if (reverseRowOrder)
-				{
-					int heightBlocks = height / 4;
-					if (height % 4)
-						heightBlocks++;
-
-					int widthBlocks = width / 4;
-					if (width % 4)
-						widthBlocks++;
-
-					uint8* reversedPixelData = new uint8[numBytes];
-					uint8* dstData = reversedPixelData;
-
-					for (int row = heightBlocks-1; row >= 0; row--)
-					{
-						for (int col = 0; col < widthBlocks; col++)
-						{
-							const uint8* srcData = pixelData + row*dxtBlockSize*widthBlocks + col*dxtBlockSize;
-							for (int byte = 0; byte < dxtBlockSize; byte++, dstData++, srcData++)
-								*dstData = *srcData;
-						}
-					}
-
-					// Now we flip the inter-block rows by messing with the block's lookup-table.  We need to handle all
-					// three types of blocks: 1) DXT1, DXT1BA  2) DXT2, DXT3  3) DXT4, DXT5
-					int totalBlocks = widthBlocks * heightBlocks;
-
-					switch (PixelFormat)
-					{
-						case tPixelFormat::BC1_DXT1BA:
-						case tPixelFormat::BC1_DXT1:
-						{
-							tDXT1Block* block = (tDXT1Block*)reversedPixelData;
-							for (int b = 0; b < totalBlocks; b++, block++)
-							{
-								// Reorder each row's colour indexes.
-								tStd::tSwap(block->LookupTableRows[0], block->LookupTableRows[3]);
-								tStd::tSwap(block->LookupTableRows[1], block->LookupTableRows[2]);
-							}
-							break;
-						}
-
-						case tPixelFormat::BC2_DXT3:
-						{
-							tDXT3Block* block = (tDXT3Block*)reversedPixelData;
-							for (int b = 0; b < totalBlocks; b++, block++)
-							{
-								// Reorder the explicit alphas AND the colour indexes.
-								tStd::tSwap(block->AlphaTableRows[0], block->AlphaTableRows[3]);
-								tStd::tSwap(block->AlphaTableRows[1], block->AlphaTableRows[2]);
-								tStd::tSwap(block->ColourBlock.LookupTableRows[0], block->ColourBlock.LookupTableRows[3]);
-								tStd::tSwap(block->ColourBlock.LookupTableRows[1], block->ColourBlock.LookupTableRows[2]);
-							}
-							break;
-						}
-
-						case tPixelFormat::BC3_DXT5:
-						{
-							tDXT5Block* block = (tDXT5Block*)reversedPixelData;
-							for (int b = 0; b < totalBlocks; b++, block++)
-							{
-								// Reorder the alpha indexes AND the colour indexes.
-								uint16 orig0 = block->GetAlphaRow(0);
-								block->SetAlphaRow(0, block->GetAlphaRow(3));
-								block->SetAlphaRow(3, orig0);
-
-								uint16 orig1 = block->GetAlphaRow(1);
-								block->SetAlphaRow(1, block->GetAlphaRow(2));
-								block->SetAlphaRow(2, orig1);
-
-								tStd::tSwap(block->ColourBlock.LookupTableRows[0], block->ColourBlock.LookupTableRows[3]);
-								tStd::tSwap(block->ColourBlock.LookupTableRows[1], block->ColourBlock.LookupTableRows[2]);
-							}
-							break;
-						}
-
-						case tPixelFormat::R32F:
-						case tPixelFormat::G32R32F:
-						case tPixelFormat::A32B32G32R32F:
-						{
-							delete[] ddsData;
-							throw tDDSError(tDDSError::tCode::UnsuportedFloatingPointPixelFormat, baseName);
-						}
-
-						default:
-						{
-							delete[] ddsData;
-							throw tDDSError(tDDSError::tCode::UnsupportedFourCCPixelFormat, baseName);
-						}
-					}
-
-					// Finally we can append a layer with the massaged dxt data. We can simply get the layer to steal the memory (the
-					// last true arg).
-					MipmapLayers[layer][image] = new tLayer(PixelFormat, width, height, reversedPixelData, true);
-				}
-				else
+			if (pixelData + numBytes > ddsData + ddsSizeBytes)
+			{
+				delete[] ddsData;
+				throw tDDSError(tDDSError::tCode::IncorrectFileSize, baseName);
+			}
+
+			// DDS files store textures upside down. In the OpenGL RH coord system, the lower left of the texture is
+			// the origin and consecutive rows go up. This should be fairly fast as there is no decoding or encoding
+			// going on, even for BC formats.
+			if (reverseRowOrder)
+			{
+				uint8* reversedPixelData = new uint8[numBytes];
+				if (!tDDS::ReverseRows(reversedPixelData, pixelData, PixelFormat, width, height))
 				{
-					// If reverseRowOrder is false we want the data to go straight in so we use the pixelData directly.
-					MipmapLayers[layer][image] = new tLayer(PixelFormat, width, height, (uint8*)pixelData);
+					delete[] reversedPixelData;
+					delete[] ddsData;
+					throw tDDSError(tDDSError::tCode::CannotReverseRowOrder, baseName);
 				}
-				tAssert(MipmapLayers[layer][image]->GetDataSize() == numBytes);
+
+				// We can simply get the layer to steal the memory (the last true arg).
+				MipmapLayers[layer][image] = new tLayer(PixelFormat, width, height, reversedPixelData, true);
+			}
+			else
+			{
+				// If reverseRowOrder is false we want the data to go straight in so we use the pixelData directly.
+				MipmapLayers[layer][image] = new tLayer(PixelFormat, width, height, (uint8*)pixelData);
 			}
+			tAssert(MipmapLayers[layer][image]->GetDataSize() == numBytes);
 
 			pixelData += numBytes;
 
@@ -930,6 +1260,265 @@ bool tFileDDS::DoDXT1BlocksHaveBinaryAlpha(tDXT1Block* block, int numBlocks)
 	return false;
 }
 
+void tFileDDS::Save(const tString& ddsFile, const tList<tLayer>& layerList, bool reverseRowOrder)
+{
+	const tLayer* layers[MaxMipmapLayers][MaxImages];
+	int numMipmapLayers = 0;
+	for (const tLayer* layer = layerList.First(); layer; layer = layer->Next())
+	{
+		if (numMipmapLayers >= MaxMipmapLayers)
+			throw tDDSError(tDDSError::tCode::MaxNumMipmapLevelsExceeded, tSystem::tGetFileName(ddsFile));
+		layers[numMipmapLayers++][0] = layer;
+	}
+
+	SaveLayers(ddsFile, layers, numMipmapLayers, 1, reverseRowOrder);
+}
+
+
+void tFileDDS::Save(const tString& ddsFile, const tList<tLayer>* sides[tSurfIndex_NumSurfaces], bool reverseRowOrder)
+{
+	const tLayer* layers[MaxMipmapLayers][MaxImages];
+	int numMipmapLayers = -1;
+	for (int side = 0; side < tSurfIndex_NumSurfaces; side++)
+	{
+		if (!sides[side])
+			throw tDDSError(tDDSError::tCode::InconsistentLayers, tSystem::tGetFileName(ddsFile));
+
+		int mip = 0;
+		for (const tLayer* layer = sides[side]->First(); layer; layer = layer->Next())
+		{
+			if (mip >= MaxMipmapLayers)
+				throw tDDSError(tDDSError::tCode::MaxNumMipmapLevelsExceeded, tSystem::tGetFileName(ddsFile));
+			layers[mip++][side] = layer;
+		}
+
+		// Every side needs the same number of mipmaps.
+		if ((numMipmapLayers != -1) && (mip != numMipmapLayers))
+			throw tDDSError(tDDSError::tCode::InconsistentLayers, tSystem::tGetFileName(ddsFile));
+		numMipmapLayers = mip;
+	}
+
+	SaveLayers(ddsFile, layers, numMipmapLayers, tSurfIndex_NumSurfaces, reverseRowOrder);
+}
+
+
+void tFileDDS::Save(const tString& ddsFile, bool reverseRowOrder) const
+{
+	if (!IsValid())
+		throw tDDSError(tDDSError::tCode::InconsistentLayers, tSystem::tGetFileName(ddsFile));
+
+	const tLayer* layers[MaxMipmapLayers][MaxImages];
+	for (int layer = 0; layer < NumMipmapLayers; layer++)
+		for (int image = 0; image < NumImages; image++)
+			layers[layer][image] = MipmapLayers[layer][image];
+
+	SaveLayers(ddsFile, layers, NumMipmapLayers, NumImages, reverseRowOrder);
+}
+
+
+void tFileDDS::SaveLayers(const tString& ddsFile, const tLayer* layers[MaxMipmapLayers][MaxImages], int numMipmapLayers, int numImages, bool reverseRowOrder)
+{
+	tString baseName = tSystem::tGetFileName(ddsFile);
+	if (tSystem::tGetFileType(ddsFile) != tSystem::tFileType::DDS)
+		throw tDDSError(tDDSError::tCode::IncorrectExtension, baseName);
+
+	if ((numMipmapLayers <= 0) || (numImages <= 0))
+		throw tDDSError(tDDSError::tCode::InconsistentLayers, baseName);
+
+	// All layers must be valid and share the pixel format. Each mipmap is half the size of the one before it, and
+	// every image (cubemap side) must have the same dimensions.
+	const tLayer* main = layers[0][0];
+	if (!main || !main->IsValid())
+		throw tDDSError(tDDSError::tCode::InconsistentLayers, baseName);
+
+	tPixelFormat pixelFormat = main->PixelFormat;
+	for (int image = 0; image < numImages; image++)
+	{
+		int width = main->Width;
+		int height = main->Height;
+		for (int layer = 0; layer < numMipmapLayers; layer++)
+		{
+			const tLayer* curr = layers[layer][image];
+			if
+			(
+				!curr || !curr->IsValid() || (curr->PixelFormat != pixelFormat) ||
+				(curr->Width != width) || (curr->Height != height)
+			)
+				throw tDDSError(tDDSError::tCode::InconsistentLayers, baseName);
+
+			width = tMath::tMax(1, width/2);
+			height = tMath::tMax(1, height/2);
+		}
+	}
+
+	// Only BC6H and BC7 can't be flipped without re-encoding. If the caller doesn't need the flip they can be saved.
+	if (reverseRowOrder && ((pixelFormat == tPixelFormat::BC6H) || (pixelFormat == tPixelFormat::BC7)))
+		throw tDDSError(tDDSError::tCode::CannotReverseRowOrder, baseName);
+
+	bool blockFormat = tIsBlockFormat(pixelFormat);
+	tDDSHeader header;
+	tStd::tMemset(&header, 0, sizeof(header));
+	header.Size = sizeof(tDDSHeader);
+	header.Flags = tDDSFlag_Caps | tDDSFlag_Height | tDDSFlag_Width | tDDSFlag_PixelFormat;
+	header.Height = main->Height;
+	header.Width = main->Width;
+	if (blockFormat)
+	{
+		header.Flags |= tDDSFlag_LinearSize;
+		header.PitchLinearSize = main->GetDataSize();
+	}
+	else
+	{
+		header.Flags |= tDDSFlag_Pitch;
+		header.PitchLinearSize = main->Width * tGetBytesPerPixel(pixelFormat);
+	}
+
+	header.Capabilities.FlagsCapsBasic = tDDSCapsBasic_Texture;
+	if (numMipmapLayers > 1)
+	{
+		header.Flags |= tDDSFlag_MipmapCount;
+		header.MipmapCount = numMipmapLayers;
+		header.Capabilities.FlagsCapsBasic |= tDDSCapsBasic_Complex | tDDSCapsBasic_Mipmap;
+	}
+
+	bool cubemap = (numImages == tSurfIndex_NumSurfaces);
+	if (cubemap)
+	{
+		header.Capabilities.FlagsCapsBasic |= tDDSCapsBasic_Complex;
+		header.Capabilities.FlagsCapsExtra =
+			tDDSCapsExtra_CubeMap |
+			tDDSCapsExtra_CubeMapPosX | tDDSCapsExtra_CubeMapNegX |
+			tDDSCapsExtra_CubeMapPosY | tDDSCapsExtra_CubeMapNegY |
+			tDDSCapsExtra_CubeMapPosZ | tDDSCapsExtra_CubeMapNegZ;
+	}
+
+	// Legacy pixel formats are described with a FourCC or with channel masks. Remember the masks are little endian
+	// so the lowest byte of the mask is the first in memory.
+	tDDSPixelFormat& format = header.PixelFormat;
+	format.Size = sizeof(tDDSPixelFormat);
+	uint32 dxgiFormat = tDXGIFormat_Unknown;
+	switch (pixelFormat)
+	{
+		case tPixelFormat::BC1_DXT1:
+		case tPixelFormat::BC1_DXT1BA:
+			format.Flags = tDDSPixelFormatFlag_FourCC;
+			format.FourCC = FourCC('D','X','T','1');
+			break;
+
+		case tPixelFormat::BC2_DXT3:
+			format.Flags = tDDSPixelFormatFlag_FourCC;
+			format.FourCC = FourCC('D','X','T','3');
+			break;
+
+		case tPixelFormat::BC3_DXT5:
+			format.Flags = tDDSPixelFormatFlag_FourCC;
+			format.FourCC = FourCC('D','X','T','5');
+			break;
+
+		case tPixelFormat::BC4_ATI1:	dxgiFormat = tDXGIFormat_BC4_UNORM;		break;
+		case tPixelFormat::BC5_ATI2:	dxgiFormat = tDXGIFormat_BC5_UNORM;		break;
+		case tPixelFormat::BC6H:		dxgiFormat = tDXGIFormat_BC6H_UF16;		break;
+		case tPixelFormat::BC7:			dxgiFormat = tDXGIFormat_BC7_UNORM;		break;
+
+		case tPixelFormat::R8G8B8:
+			format.Flags = tDDSPixelFormatFlag_RGB;
+			format.RGBBitCount = 24;
+			format.MaskRed = 0x0000FF;	format.MaskGreen = 0x00FF00;	format.MaskBlue = 0xFF0000;
+			break;
+
+		case tPixelFormat::B8G8R8:
+			format.Flags = tDDSPixelFormatFlag_RGB;
+			format.RGBBitCount = 24;
+			format.MaskRed = 0xFF0000;	format.MaskGreen = 0x00FF00;	format.MaskBlue = 0x0000FF;
+			break;
+
+		case tPixelFormat::R8G8B8A8:
+			format.Flags = tDDSPixelFormatFlag_RGB | tDDSPixelFormatFlag_Alpha;
+			format.RGBBitCount = 32;
+			format.MaskRed = 0x000000FF;	format.MaskGreen = 0x0000FF00;	format.MaskBlue = 0x00FF0000;	format.MaskAlpha = 0xFF000000;
+			break;
+
+		case tPixelFormat::B8G8R8A8:
+			format.Flags = tDDSPixelFormatFlag_RGB | tDDSPixelFormatFlag_Alpha;
+			format.RGBBitCount = 32;
+			format.MaskRed = 0x00FF0000;	format.MaskGreen = 0x0000FF00;	format.MaskBlue = 0x000000FF;	format.MaskAlpha = 0xFF000000;
+			break;
+
+		case tPixelFormat::G3B5A1R5G2:
+			format.Flags = tDDSPixelFormatFlag_RGB | tDDSPixelFormatFlag_Alpha;
+			format.RGBBitCount = 16;
+			format.MaskRed = 0x7C00;	format.MaskGreen = 0x03E0;	format.MaskBlue = 0x001F;	format.MaskAlpha = 0x8000;
+			break;
+
+		case tPixelFormat::G4B4A4R4:
+			format.Flags = tDDSPixelFormatFlag_RGB | tDDSPixelFormatFlag_Alpha;
+			format.RGBBitCount = 16;
+			format.MaskRed = 0x0F00;	format.MaskGreen = 0x00F0;	format.MaskBlue = 0x000F;	format.MaskAlpha = 0xF000;
+			break;
+
+		case tPixelFormat::G3B5R5G3:
+			format.Flags = tDDSPixelFormatFlag_RGB;
+			format.RGBBitCount = 16;
+			format.MaskRed = 0xF800;	format.MaskGreen = 0x07E0;	format.MaskBlue = 0x001F;
+			break;
+
+		case tPixelFormat::L8A8:
+			format.Flags = tDDSPixelFormatFlag_Luminance | tDDSPixelFormatFlag_Alpha;
+			format.RGBBitCount = 16;
+			format.MaskRed = 0x00FF;	format.MaskAlpha = 0xFF00;
+			break;
+
+		default:
+			throw tDDSError(tDDSError::tCode::UnsupportedSavePixelFormat, baseName);
+	}
+
+	tDDSHeaderDX10 headerDX10;
+	tStd::tMemset(&headerDX10, 0, sizeof(headerDX10));
+	if (dxgiFormat != tDXGIFormat_Unknown)
+	{
+		format.Flags = tDDSPixelFormatFlag_FourCC;
+		format.FourCC = FourCC('D','X','1','0');
+		headerDX10.DxgiFormat = dxgiFormat;
+		headerDX10.ResourceDimension = tDDSResourceDimension_Texture2D;
+		headerDX10.MiscFlag = cubemap ? tDDSMiscFlag_TextureCube : 0;
+		headerDX10.ArraySize = 1;
+	}
+
+	tFileHandle file = tSystem::tOpenFile(ddsFile.ConstText(), "wb");
+	if (!file)
+		throw tDDSError(tDDSError::tCode::FileWriteFailed, baseName);
+
+	uint32 magic = tDDSMagic;
+	bool ok = (tSystem::tWriteFile(file, &magic, sizeof(magic)) == sizeof(magic));
+	ok = ok && (tSystem::tWriteFile(file, &header, sizeof(header)) == sizeof(header));
+	if (dxgiFormat != tDXGIFormat_Unknown)
+		ok = ok && (tSystem::tWriteFile(file, &headerDX10, sizeof(headerDX10)) == sizeof(headerDX10));
+
+	// The images are written one after the other, each with its full mipmap chain. The largest layer is big enough to
+	// hold any of the reversed ones.
+	uint8* reversed = reverseRowOrder ? new uint8[main->GetDataSize()] : nullptr;
+	for (int image = 0; ok && (image < numImages); image++)
+	{
+		for (int layer = 0; ok && (layer < numMipmapLayers); layer++)
+		{
+			const tLayer* curr = layers[layer][image];
+			int numBytes = curr->GetDataSize();
+			const uint8* data = curr->Data;
+			if (reverseRowOrder)
+			{
+				ok = tDDS::ReverseRows(reversed, curr->Data, pixelFormat, curr->Width, curr->Height);
+				data = reversed;
+			}
+			ok = ok && (tSystem::tWriteFile(file, data, numBytes) == numBytes);
+		}
+	}
+
+	delete[] reversed;
+	tSystem::tCloseFile(file);
+	if (!ok)
+		throw tDDSError(tDDSError::tCode::FileWriteFailed, baseName);
+}
+
 
 }
 
@@ -946,11 +1535,16 @@ const char* tDDSError::CodeStrings[tCode::NumCodes] =
 	"Volume textures unsupported.",
 	"Pixel format size incorrect.",
 	"Pixel format must be either an RGB format or a FourCC format.",
-	"Unsupported FourCC pixel format. Supported FourCC formats include DXT1, DXT3, DXT5.",
-	"Unsupported RGB pixel format. Supported formats include A1R5G5B5, A4R4G4B4, R5G6B5, R8G8B8, and A8R8G8B8.",
+	"Unsupported FourCC pixel format. Supported FourCC formats include DXT1, DXT3, DXT5, ATI1, ATI2, and DX10 BC1 to BC7.",
+	"Unsupported RGB pixel format. Supported formats include A1R5G5B5, A4R4G4B4, R5G6B5, R8G8B8, B8G8R8, A8R8G8B8, A8B8G8R8, and A8L8.",
 	"Incorrect DXT pixel data size.",
 	"DXT Texture dimensions must be divisible by 4.",
 	"Current DDS loader only supports power-of-2 dimensions.",
 	"Maximum number of mipmap levels exceeded.",
-	"Floating point pixel formats not supported yet."
+	"Floating point pixel formats not supported yet.",
+	"Row order can't be reversed for this pixel format. Try loading with reverseRowOrder false.",
+	"Unsupported DX10 resource. Only 2D textures and single cubemaps are supported.",
+	"Pixel format can't be saved to a dds file.",
+	"Layers must share a pixel format, each mipmap must be half the size of the one before, and cubemap sides must match.",
+	"Could not write to file."
 };
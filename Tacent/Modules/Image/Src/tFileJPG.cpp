@@ -0,0 +1,783 @@
+// tFileJPG.cpp
+//
+// This class is a helper class. It knows how to rotate and flip a jpg file without losing any quality. The quantized
+// DCT coefficients are read, the 8x8 blocks are moved to their new positions, and the coefficients inside each block are
+// transposed or have their signs flipped. Nothing is decoded or re-quantized, so the transform can be applied any
+// number of times without the image degrading. It can also just rewrite the exif orientation tag so viewers that
+// honour it reorient the image. Loading jpg files for display is still done by CxImage in tPicture.
+//
+// Copyright (c) 2020 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <setjmp.h>
+#include <Foundation/tStandard.h>
+#include <Math/tFundamentals.h>
+#include <System/tFile.h>
+extern "C"
+{
+	#include <jpeg/jpeglib.h>
+	#include <jpeg/jerror.h>
+}
+#include "Image/tFileJPG.h"
+using namespace tImage;
+using namespace tSystem;
+
+
+namespace tJPG
+{
+	// An orientation as three bits. The image is transposed first, then flipped horizontally, then vertically. Any
+	// combination of 90 degree rotations and flips comes down to one of these eight.
+	const int BitTranspose = 4;
+	const int BitFlipH = 2;
+	const int BitFlipV = 1;
+	const int OrientationBits[] =
+	{
+		0,												// Invalid.
+		0,												// Normal.
+		BitFlipH,										// FlipH.
+		BitFlipH | BitFlipV,							// Rotate180.
+		BitFlipV,										// FlipV.
+		BitTranspose,									// Transpose.
+		BitTranspose | BitFlipH,						// Rotate90CW.
+		BitTranspose | BitFlipH | BitFlipV,				// Transverse.
+		BitTranspose | BitFlipV							// Rotate90ACW.
+	};
+	tFileJPG::tOrientation GetOrientation(int bits);
+
+	const uint8 MarkerSOI = 0xD8;
+	const uint8 MarkerEOI = 0xD9;
+	const uint8 MarkerSOS = 0xDA;
+	const uint8 MarkerAPP0 = 0xE0;
+	const uint8 MarkerAPP1 = 0xE1;
+
+	// The exif tags that get rewritten.
+	const uint16 TagOrientation = 0x0112;
+	const uint16 TagExifIFD = 0x8769;
+	const uint16 TagExifWidth = 0xA002;
+	const uint16 TagExifHeight = 0xA003;
+	const uint16 TypeShort = 3;
+	const uint16 TypeLong = 4;
+
+	// The exif block starts with this and is followed by a tiff header and its IFDs.
+	const char ExifID[] = "Exif\0";
+	const int ExifIDSize = 6;
+
+	inline uint16 Get16BE(const uint8* p)																				{ return uint16((p[0] << 8) | p[1]); }
+	inline uint16 Get16(const uint8* p, bool bigEndian)																	{ return bigEndian ? uint16((p[0] << 8) | p[1]) : uint16(p[0] | (p[1] << 8)); }
+	inline uint32 Get32(const uint8* p, bool bigEndian)																	{ return bigEndian ? uint32((uint32(p[0]) << 24) | (p[1] << 16) | (p[2] << 8) | p[3]) : uint32(p[0] | (p[1] << 8) | (p[2] << 16) | (uint32(p[3]) << 24)); }
+	void Set16(uint8* p, uint16 value, bool bigEndian);
+	void Set32(uint8* p, uint32 value, bool bigEndian);
+
+	// Starting at offset, skips any fill bytes and returns the offset of the next marker, or -1 if the data ends or
+	// doesn't hold a marker. The length is that of the segment including the length bytes, or zero for markers that
+	// stand alone.
+	int FindMarker(const uint8* data, int numBytes, int offset, uint8& marker, int& length);
+
+	// Returns the offset of the tiff header of the exif block before the first scan, or -1 if there isn't one. Sets
+	// truncated if the data ends before the exif block does or before the first scan was reached.
+	int FindExif(const uint8* data, int numBytes, int& tiffBytes, bool& truncated);
+
+	// Returns the offset in the tiff data of the IFD entry with the tag, or -1 if there isn't one. IFD0 is searched
+	// unless exifIFD is true, in which case the exif IFD that IFD0 points to is searched.
+	int FindEntry(const uint8* tiff, int tiffBytes, uint16 tag, bool exifIFD, bool& bigEndian);
+	void SetEntryValue(uint8* tiff, int entry, uint32 value, bool bigEndian);
+
+	// Trim rounds the size down to a whole number of MCUs and pad rounds it up.
+	int RoundToMCU(int size, int mcuSize, tFileJPG::tEdge);
+
+	// Errors from libjpeg jump back out to the setjmp in Transform. All the libjpeg state lives in the coder, which is
+	// plain data, so nothing with a destructor is skipped over.
+	struct ErrorManager
+	{
+		jpeg_error_mgr Manager;
+		jmp_buf Jump;
+	};
+	void ErrorExit(j_common_ptr);
+	void OutputMessage(j_common_ptr)																					{ }
+
+	struct Coder
+	{
+		jpeg_decompress_struct Src;
+		jpeg_compress_struct Dst;
+		ErrorManager Error;
+		jvirt_barray_ptr DstCoefficients[MAX_COMPONENTS];
+
+		// Allocated by libjpeg with malloc.
+		unsigned char* Output;
+		unsigned long OutputBytes;
+	};
+
+	// Transforms the stored pixels of the jpg by the orientation bits. On success output is allocated with malloc and
+	// must be freed by the caller.
+	bool Transform(uint8*& output, int& outputBytes, const uint8* data, int numBytes, int bits, tFileJPG::tEdge);
+	bool TransformCoefficients(Coder&, const uint8* data, int numBytes, int bits, tFileJPG::tEdge);
+	void TransformBlocks
+	(
+		Coder&, jvirt_barray_ptr* srcCoefficients, int bits, const int* hSamp, const int* vSamp, int mcuCols, int mcuRows
+	);
+	void CopyMarkers(Coder&);
+}
+
+
+tFileJPG::tOrientation tJPG::GetOrientation(int bits)
+{
+	for (int o = int(tFileJPG::tOrientation::Normal); o <= int(tFileJPG::tOrientation::Rotate90ACW); o++)
+		if (OrientationBits[o] == bits)
+			return tFileJPG::tOrientation(o);
+
+	return tFileJPG::tOrientation::Invalid;
+}
+
+
+void tJPG::Set16(uint8* p, uint16 value, bool bigEndian)
+{
+	p[bigEndian ? 0 : 1] = uint8(value >> 8);
+	p[bigEndian ? 1 : 0] = uint8(value);
+}
+
+
+void tJPG::Set32(uint8* p, uint32 value, bool bigEndian)
+{
+	for (int b = 0; b < 4; b++)
+		p[bigEndian ? 3-b : b] = uint8(value >> (b*8));
+}
+
+
+int tJPG::FindMarker(const uint8* data, int numBytes, int offset, uint8& marker, int& length)
+{
+	// Any number of 0xFF fill bytes may come before a marker.
+	while ((offset+2 < numBytes) && (data[offset] == 0xFF) && (data[offset+1] == 0xFF))
+		offset++;
+
+	if ((offset+2 > numBytes) || (data[offset] != 0xFF))
+		return -1;
+
+	marker = data[offset+1];
+	if ((marker == 0x01) || ((marker >= 0xD0) && (marker <= MarkerEOI)))
+	{
+		length = 0;
+		return offset;
+	}
+
+	if (offset+4 > numBytes)
+		return -1;
+
+	length = Get16BE(data + offset + 2);
+	return (length >= 2) ? offset : -1;
+}
+
+
+int tJPG::FindExif(const uint8* data, int numBytes, int& tiffBytes, bool& truncated)
+{
+	truncated = false;
+	if ((numBytes < 2) || (data[0] != 0xFF) || (data[1] != MarkerSOI))
+		return -1;
+
+	int offset = 2;
+	while (true)
+	{
+		uint8 marker = 0;
+		int length = 0;
+		offset = FindMarker(data, numBytes, offset, marker, length);
+		if (offset < 0)
+		{
+			truncated = true;
+			return -1;
+		}
+
+		if ((marker == MarkerSOS) || (marker == MarkerEOI))
+			return -1;
+
+		int payload = offset + 4;
+		int payloadBytes = length - 2;
+		if (length && (payload + payloadBytes > numBytes))
+		{
+			truncated = true;
+			return -1;
+		}
+
+		if ((marker == MarkerAPP1) && (payloadBytes > ExifIDSize) && !tStd::tMemcmp(data + payload, ExifID, ExifIDSize))
+		{
+			tiffBytes = payloadBytes - ExifIDSize;
+			return payload + ExifIDSize;
+		}
+
+		offset += 2 + length;
+	}
+
+	return -1;
+}
+
+
+int tJPG::FindEntry(const uint8* tiff, int tiffBytes, uint16 tag, bool exifIFD, bool& bigEndian)
+{
+	if (tiffBytes < 8)
+		return -1;
+
+	if ((tiff[0] == 'M') && (tiff[1] == 'M'))
+		bigEndian = true;
+	else if ((tiff[0] == 'I') && (tiff[1] == 'I'))
+		bigEndian = false;
+	else
+		return -1;
+
+	if (Get16(tiff+2, bigEndian) != 42)
+		return -1;
+
+	uint32 ifd = Get32(tiff+4, bigEndian);
+	if (exifIFD)
+	{
+		int pointer = FindEntry(tiff, tiffBytes, TagExifIFD, false, bigEndian);
+		if (pointer < 0)
+			return -1;
+		ifd = Get32(tiff + pointer + 8, bigEndian);
+	}
+
+	if (ifd + 2 > uint32(tiffBytes))
+		return -1;
+
+	int numEntries = Get16(tiff + ifd, bigEndian);
+	for (int e = 0; e < numEntries; e++)
+	{
+		uint32 entry = ifd + 2 + e*12;
+		if (entry + 12 > uint32(tiffBytes))
+			return -1;
+
+		if (Get16(tiff + entry, bigEndian) == tag)
+			return int(entry);
+	}
+
+	return -1;
+}
+
+
+void tJPG::SetEntryValue(uint8* tiff, int entry, uint32 value, bool bigEndian)
+{
+	// Values of four bytes or less are stored in the entry itself, left-aligned.
+	uint16 type = Get16(tiff + entry + 2, bigEndian);
+	if (type == TypeShort)
+		Set16(tiff + entry + 8, uint16(value), bigEndian);
+	else if (type == TypeLong)
+		Set32(tiff + entry + 8, value, bigEndian);
+}
+
+
+int tJPG::RoundToMCU(int size, int mcuSize, tFileJPG::tEdge edge)
+{
+	if (edge == tFileJPG::tEdge::Pad)
+		size += mcuSize - 1;
+	return (size / mcuSize) * mcuSize;
+}
+
+
+void tJPG::ErrorExit(j_common_ptr info)
+{
+	ErrorManager* error = (ErrorManager*)info->err;
+	longjmp(error->Jump, 1);
+}
+
+
+bool tJPG::Transform
+(
+	uint8*& output, int& outputBytes, const uint8* data, int numBytes, int bits, tFileJPG::tEdge edge
+)
+{
+	Coder* coder = new Coder;
+	tStd::tMemset(coder, 0, sizeof(Coder));
+	coder->Src.err = jpeg_std_error(&coder->Error.Manager);
+	coder->Dst.err = &coder->Error.Manager;
+	coder->Error.Manager.error_exit = ErrorExit;
+	coder->Error.Manager.output_message = OutputMessage;
+
+	bool success = false;
+	if (!setjmp(coder->Error.Jump))
+	{
+		jpeg_create_decompress(&coder->Src);
+		jpeg_create_compress(&coder->Dst);
+		success = TransformCoefficients(*coder, data, numBytes, bits, edge);
+	}
+
+	// The destination coefficients belong to the source's memory pools so the destination goes first. Destroying a
+	// struct that was never created is safe since it was zeroed.
+	jpeg_destroy_compress(&coder->Dst);
+	jpeg_destroy_decompress(&coder->Src);
+	if (success)
+	{
+		output = coder->Output;
+		outputBytes = int(coder->OutputBytes);
+	}
+	else
+	{
+		free(coder->Output);
+	}
+
+	delete coder;
+	return success;
+}
+
+
+bool tJPG::TransformCoefficients(Coder& coder, const uint8* data, int numBytes, int bits, tFileJPG::tEdge edge)
+{
+	jpeg_decompress_struct& src = coder.Src;
+	jpeg_compress_struct& dst = coder.Dst;
+
+	jpeg_mem_src(&src, (unsigned char*)data, (unsigned long)numBytes);
+	jpeg_save_markers(&src, JPEG_COM, 0xFFFF);
+	for (int m = 0; m < 16; m++)
+		jpeg_save_markers(&src, JPEG_APP0 + m, 0xFFFF);
+	if (jpeg_read_header(&src, TRUE) != JPEG_HEADER_OK)
+		return false;
+
+	// Files with scaled DCT blocks can't be handled the same way.
+	if ((src.min_DCT_h_scaled_size != DCTSIZE) || (src.min_DCT_v_scaled_size != DCTSIZE))
+		return false;
+
+	// All sizes from here on are in the orientation of the destination. Greyscale images are always written with 1x1
+	// sampling since some decoders have trouble with anything else, and their blocks are laid out as if it were 1x1 in
+	// any case.
+	bool transpose = (bits & BitTranspose) ? true : false;
+	bool grey = (src.num_components == 1);
+	int hSamp[MAX_COMPONENTS];
+	int vSamp[MAX_COMPONENTS];
+	int maxHSamp = 1;
+	int maxVSamp = 1;
+	for (int c = 0; c < src.num_components; c++)
+	{
+		jpeg_component_info& comp = src.comp_info[c];
+		hSamp[c] = grey ? 1 : (transpose ? comp.v_samp_factor : comp.h_samp_factor);
+		vSamp[c] = grey ? 1 : (transpose ? comp.h_samp_factor : comp.v_samp_factor);
+		maxHSamp = tMath::tMax(maxHSamp, hSamp[c]);
+		maxVSamp = tMath::tMax(maxVSamp, vSamp[c]);
+	}
+
+	// Only an edge that gets mirrored moves its partial MCU to the left or top.
+	int mcuWidth = DCTSIZE * maxHSamp;
+	int mcuHeight = DCTSIZE * maxVSamp;
+	int width = transpose ? src.image_height : src.image_width;
+	int height = transpose ? src.image_width : src.image_height;
+	if (bits & BitFlipH)
+		width = RoundToMCU(width, mcuWidth, edge);
+	if (bits & BitFlipV)
+		height = RoundToMCU(height, mcuHeight, edge);
+	if ((width <= 0) || (height <= 0))
+		return false;
+
+	// The destination arrays must be requested before the source coefficients are read since that is when all the
+	// arrays get allocated. They are whole MCUs so the blocks at the edges need no special handling.
+	int mcuCols = (width + mcuWidth - 1) / mcuWidth;
+	int mcuRows = (height + mcuHeight - 1) / mcuHeight;
+	for (int c = 0; c < src.num_components; c++)
+	{
+		coder.DstCoefficients[c] = (*src.mem->request_virt_barray)
+		(
+			(j_common_ptr)&src, JPOOL_IMAGE, FALSE,
+			JDIMENSION(mcuCols * hSamp[c]), JDIMENSION(mcuRows * vSamp[c]), JDIMENSION(vSamp[c])
+		);
+	}
+
+	jvirt_barray_ptr* srcCoefficients = jpeg_read_coefficients(&src);
+	if (!srcCoefficients)
+		return false;
+
+	TransformBlocks(coder, srcCoefficients, bits, hSamp, vSamp, mcuCols, mcuRows);
+
+	// The tables and component ids are kept. Transposed blocks need transposed quantization tables.
+	jpeg_copy_critical_parameters(&src, &dst);
+	dst.image_width = JDIMENSION(width);
+	dst.image_height = JDIMENSION(height);
+	dst.jpeg_width = JDIMENSION(width);
+	dst.jpeg_height = JDIMENSION(height);
+	for (int c = 0; c < dst.num_components; c++)
+	{
+		dst.comp_info[c].h_samp_factor = hSamp[c];
+		dst.comp_info[c].v_samp_factor = vSamp[c];
+	}
+
+	for (int t = 0; transpose && (t < NUM_QUANT_TBLS); t++)
+	{
+		JQUANT_TBL* table = dst.quant_tbl_ptrs[t];
+		if (!table)
+			continue;
+		for (int v = 0; v < DCTSIZE; v++)
+			for (int u = 0; u < v; u++)
+				tStd::tSwap(table->quantval[v*DCTSIZE + u], table->quantval[u*DCTSIZE + v]);
+	}
+
+	// The huffman tables are rebuilt for the new block order, which usually makes the file a little smaller.
+	dst.optimize_coding = TRUE;
+	dst.arith_code = src.arith_code;
+	if (src.progressive_mode)
+		jpeg_simple_progression(&dst);
+
+	jpeg_mem_dest(&dst, &coder.Output, &coder.OutputBytes);
+	jpeg_write_coefficients(&dst, coder.DstCoefficients);
+	CopyMarkers(coder);
+	jpeg_finish_compress(&dst);
+	jpeg_finish_decompress(&src);
+	return true;
+}
+
+
+void tJPG::TransformBlocks
+(
+	Coder& coder, jvirt_barray_ptr* srcCoefficients, int bits, const int* hSamp, const int* vSamp, int mcuCols, int mcuRows
+)
+{
+	jpeg_decompress_struct& src = coder.Src;
+	bool transpose = (bits & BitTranspose) ? true : false;
+	bool flipH = (bits & BitFlipH) ? true : false;
+	bool flipV = (bits & BitFlipV) ? true : false;
+
+	// Where each coefficient of a destination block comes from in its source block. Mirroring a block negates the
+	// coefficients of the odd frequencies along the mirrored axis, and transposing it transposes the coefficients.
+	int srcIndex[DCTSIZE2];
+	bool negate[DCTSIZE2];
+	for (int v = 0; v < DCTSIZE; v++)
+	{
+		for (int u = 0; u < DCTSIZE; u++)
+		{
+			srcIndex[v*DCTSIZE + u] = transpose ? (u*DCTSIZE + v) : (v*DCTSIZE + u);
+			negate[v*DCTSIZE + u] = (flipH && (u & 1)) != (flipV && (v & 1));
+		}
+	}
+
+	for (int c = 0; c < src.num_components; c++)
+	{
+		// The source arrays are padded to whole MCUs too, but only the blocks inside the image are dependable. Blocks
+		// past the edge of the source, which only padding asks for, get the DC of the nearest edge block so they're a
+		// flat continuation of it.
+		int srcCols = int(src.comp_info[c].width_in_blocks);
+		int srcRows = int(src.comp_info[c].height_in_blocks);
+		int dstCols = mcuCols * hSamp[c];
+		int dstRows = mcuRows * vSamp[c];
+		for (int rowGroup = 0; rowGroup < dstRows; rowGroup += vSamp[c])
+		{
+			JBLOCKARRAY dstBlockRows = (*src.mem->access_virt_barray)
+			(
+				(j_common_ptr)&src, coder.DstCoefficients[c], JDIMENSION(rowGroup), JDIMENSION(vSamp[c]), TRUE
+			);
+
+			for (int r = 0; r < vSamp[c]; r++)
+			{
+				int y = flipV ? (dstRows - 1 - (rowGroup + r)) : (rowGroup + r);
+				JBLOCKROW srcRow = nullptr;
+				int srcRowIndex = -1;
+				for (int dx = 0; dx < dstCols; dx++)
+				{
+					int x = flipH ? (dstCols - 1 - dx) : dx;
+					int srcX = transpose ? y : x;
+					int srcY = transpose ? x : y;
+					bool inside = (srcX < srcCols) && (srcY < srcRows);
+					srcX = tMath::tMin(srcX, srcCols-1);
+					srcY = tMath::tMin(srcY, srcRows-1);
+					if (srcY != srcRowIndex)
+					{
+						srcRow = (*src.mem->access_virt_barray)
+						(
+							(j_common_ptr)&src, srcCoefficients[c], JDIMENSION(srcY), 1, FALSE
+						)[0];
+						srcRowIndex = srcY;
+					}
+
+					JCOEFPTR srcBlock = srcRow[srcX];
+					JCOEFPTR dstBlock = dstBlockRows[r][dx];
+					if (!inside)
+					{
+						tStd::tMemset(dstBlock, 0, sizeof(JBLOCK));
+						dstBlock[0] = srcBlock[0];
+						continue;
+					}
+
+					for (int i = 0; i < DCTSIZE2; i++)
+						dstBlock[i] = negate[i] ? JCOEF(-srcBlock[srcIndex[i]]) : srcBlock[srcIndex[i]];
+				}
+			}
+		}
+	}
+}
+
+
+void tJPG::CopyMarkers(Coder& coder)
+{
+	jpeg_decompress_struct& src = coder.Src;
+	jpeg_compress_struct& dst = coder.Dst;
+	for (jpeg_saved_marker_ptr marker = src.marker_list; marker; marker = marker->next)
+	{
+		// The encoder writes its own JFIF and Adobe markers.
+		int length = int(marker->data_length);
+		const char* data = (const char*)marker->data;
+		if (dst.write_JFIF_header && (marker->marker == JPEG_APP0) && (length >= 5) && !tStd::tMemcmp(data, "JFIF", 5))
+			continue;
+		if (dst.write_Adobe_marker && (marker->marker == JPEG_APP0+14) && (length >= 5) && !tStd::tMemcmp(data, "Adobe", 5))
+			continue;
+
+		// The pixels are stored upright now, so the exif orientation goes back to normal and the exif size is updated.
+		// The exif thumbnail is left as it is.
+		if ((marker->marker == JPEG_APP0+1) && (length > ExifIDSize) && !tStd::tMemcmp(data, ExifID, ExifIDSize))
+		{
+			uint8* tiff = (uint8*)marker->data + ExifIDSize;
+			int tiffBytes = length - ExifIDSize;
+			bool bigEndian = false;
+			int entry = FindEntry(tiff, tiffBytes, TagOrientation, false, bigEndian);
+			if (entry >= 0)
+				SetEntryValue(tiff, entry, 1, bigEndian);
+
+			entry = FindEntry(tiff, tiffBytes, TagExifWidth, true, bigEndian);
+			if (entry >= 0)
+				SetEntryValue(tiff, entry, dst.image_width, bigEndian);
+
+			entry = FindEntry(tiff, tiffBytes, TagExifHeight, true, bigEndian);
+			if (entry >= 0)
+				SetEntryValue(tiff, entry, dst.image_height, bigEndian);
+		}
+
+		jpeg_write_marker(&dst, marker->marker, marker->data, marker->data_length);
+	}
+}
+
+
+tFileJPG::tOrientation tFileJPG::Combine(tOrientation first, tOrientation second)
+{
+	if ((first == tOrientation::Invalid) || (second == tOrientation::Invalid))
+		return tOrientation::Invalid;
+
+	// Transposing after a flip is the same as transposing first and flipping the other axis.
+	int a = tJPG::OrientationBits[int(first)];
+	int b = tJPG::OrientationBits[int(second)];
+	if (b & tJPG::BitTranspose)
+		a = (a & tJPG::BitTranspose) | ((a & tJPG::BitFlipH) ? tJPG::BitFlipV : 0) | ((a & tJPG::BitFlipV) ? tJPG::BitFlipH : 0);
+
+	return tJPG::GetOrientation(a ^ b);
+}
+
+
+tFileJPG::tOrientation tFileJPG::Invert(tOrientation orientation)
+{
+	if (orientation == tOrientation::Invalid)
+		return tOrientation::Invalid;
+
+	// Flips and the half turn undo themselves. Only the quarter turns need swapping.
+	if (orientation == tOrientation::Rotate90CW)
+		return tOrientation::Rotate90ACW;
+	if (orientation == tOrientation::Rotate90ACW)
+		return tOrientation::Rotate90CW;
+	return orientation;
+}
+
+
+bool tFileJPG::IsTransposing(tOrientation orientation)
+{
+	return (tJPG::OrientationBits[int(orientation)] & tJPG::BitTranspose) ? true : false;
+}
+
+
+tFileJPG::tFileJPG(const tString& jpgFile)
+{
+	// tLoadFile asserts the file exists.
+	if ((tGetFileType(jpgFile) != tFileType::JPG) || !tFileExists(jpgFile))
+		return;
+
+	int numBytes = 0;
+	uint8* data = tLoadFile(jpgFile, nullptr, &numBytes);
+	if (!data)
+		return;
+
+	// Only the sequential and progressive DCT frames can be transformed.
+	int offset = 2;
+	bool found = false;
+	bool soi = (numBytes > 2) && (data[0] == 0xFF) && (data[1] == tJPG::MarkerSOI);
+	while (soi)
+	{
+		uint8 marker = 0;
+		int length = 0;
+		offset = tJPG::FindMarker(data, numBytes, offset, marker, length);
+		if ((offset < 0) || (marker == tJPG::MarkerSOS) || (marker == tJPG::MarkerEOI))
+			break;
+
+		bool dctFrame = (marker == 0xC0) || (marker == 0xC1) || (marker == 0xC2) || (marker == 0xC9) || (marker == 0xCA);
+		bool otherFrame = (marker >= 0xC3) && (marker <= 0xCF) && (marker != 0xC4) && (marker != 0xC8) && (marker != 0xCC);
+		if (otherFrame && !dctFrame)
+			break;
+
+		if (dctFrame)
+		{
+			int numComponents = (offset + 10 <= numBytes) ? data[offset+9] : 0;
+			if ((numComponents <= 0) || (offset + 10 + numComponents*3 > numBytes))
+				break;
+
+			StoredHeight = tJPG::Get16BE(data + offset + 5);
+			StoredWidth = tJPG::Get16BE(data + offset + 7);
+			int maxH = 1;
+			int maxV = 1;
+			for (int c = 0; (c < numComponents) && (numComponents > 1); c++)
+			{
+				uint8 sampling = data[offset + 10 + c*3 + 1];
+				maxH = tMath::tMax(maxH, sampling >> 4);
+				maxV = tMath::tMax(maxV, sampling & 0x0F);
+			}
+			StoredMCUWidth = 8 * maxH;
+			StoredMCUHeight = 8 * maxV;
+			found = (StoredWidth > 0) && (StoredHeight > 0);
+			break;
+		}
+
+		offset += 2 + length;
+	}
+
+	if (!found)
+	{
+		delete[] data;
+		return;
+	}
+
+	Data = data;
+	NumBytes = numBytes;
+	Orientation = ReadOrientation(Data, NumBytes);
+	if (Orientation == tOrientation::Invalid)
+		Orientation = tOrientation::Normal;
+}
+
+
+int tFileJPG::GetWidth() const
+{
+	return IsTransposing(Orientation) ? StoredHeight : StoredWidth;
+}
+
+
+int tFileJPG::GetHeight() const
+{
+	return IsTransposing(Orientation) ? StoredWidth : StoredHeight;
+}
+
+
+int tFileJPG::GetMCUWidth() const
+{
+	return IsTransposing(Orientation) ? StoredMCUHeight : StoredMCUWidth;
+}
+
+
+int tFileJPG::GetMCUHeight() const
+{
+	return IsTransposing(Orientation) ? StoredMCUWidth : StoredMCUHeight;
+}
+
+
+void tFileJPG::GetTransformedSize(int& width, int& height, tOrientation transform, tEdge edge) const
+{
+	tOrientation total = Combine(Orientation, transform);
+	if (!IsValid() || (total == tOrientation::Invalid))
+	{
+		width = 0;
+		height = 0;
+		return;
+	}
+
+	// Same as tJPG::TransformCoefficients.
+	int bits = tJPG::OrientationBits[int(total)];
+	bool transpose = (bits & tJPG::BitTranspose) ? true : false;
+	width = transpose ? StoredHeight : StoredWidth;
+	height = transpose ? StoredWidth : StoredHeight;
+	if (bits & tJPG::BitFlipH)
+		width = tJPG::RoundToMCU(width, transpose ? StoredMCUHeight : StoredMCUWidth, edge);
+	if (bits & tJPG::BitFlipV)
+		height = tJPG::RoundToMCU(height, transpose ? StoredMCUWidth : StoredMCUHeight, edge);
+}
+
+
+bool tFileJPG::SaveTransformed(const tString& jpgFile, tOrientation transform, tEdge edge) const
+{
+	tOrientation total = Combine(Orientation, transform);
+	if (!IsValid() || (total == tOrientation::Invalid) || (tGetFileType(jpgFile) != tFileType::JPG))
+		return false;
+
+	uint8* output = nullptr;
+	int outputBytes = 0;
+	if (!tJPG::Transform(output, outputBytes, Data, NumBytes, tJPG::OrientationBits[int(total)], edge))
+		return false;
+
+	bool success = tCreateFile(jpgFile, output, outputBytes);
+	free(output);
+	return success;
+}
+
+
+bool tFileJPG::SaveReoriented(const tString& jpgFile, tOrientation transform) const
+{
+	tOrientation orientation = Combine(Orientation, transform);
+	if (!IsValid() || (orientation == tOrientation::Invalid) || (tGetFileType(jpgFile) != tFileType::JPG))
+		return false;
+
+	int tiffBytes = 0;
+	bool truncated = false;
+	int tiff = tJPG::FindExif(Data, NumBytes, tiffBytes, truncated);
+	if (tiff >= 0)
+	{
+		bool bigEndian = false;
+		int entry = tJPG::FindEntry(Data + tiff, tiffBytes, tJPG::TagOrientation, false, bigEndian);
+		if (entry < 0)
+			return false;
+
+		uint8* data = new uint8[NumBytes];
+		tStd::tMemcpy(data, Data, NumBytes);
+		tJPG::SetEntryValue(data + tiff, entry, uint32(orientation), bigEndian);
+		bool success = tCreateFile(jpgFile, data, NumBytes);
+		delete[] data;
+		return success;
+	}
+
+	// With no exif block we add one after the JFIF segment, holding a tiff header and an IFD0 with a single entry.
+	const int exifSegmentBytes = 2 + 2 + tJPG::ExifIDSize + 8 + 2 + 12 + 4;
+	int insertAt = 2;
+	uint8 marker = 0;
+	int length = 0;
+	while ((tJPG::FindMarker(Data, NumBytes, insertAt, marker, length) == insertAt) && (marker == tJPG::MarkerAPP0))
+		insertAt += 2 + length;
+
+	uint8 exif[exifSegmentBytes] =
+	{
+		0xFF, tJPG::MarkerAPP1, 0, exifSegmentBytes - 2,
+		'E', 'x', 'i', 'f', 0, 0,
+		'M', 'M', 0, 42, 0, 0, 0, 8,
+		0, 1,
+		0x01, 0x12, 0, tJPG::TypeShort, 0, 0, 0, 1, 0, uint8(orientation), 0, 0,
+		0, 0, 0, 0
+	};
+
+	uint8* data = new uint8[NumBytes + exifSegmentBytes];
+	tStd::tMemcpy(data, Data, insertAt);
+	tStd::tMemcpy(data + insertAt, exif, exifSegmentBytes);
+	tStd::tMemcpy(data + insertAt + exifSegmentBytes, Data + insertAt, NumBytes - insertAt);
+	bool success = tCreateFile(jpgFile, data, NumBytes + exifSegmentBytes);
+	delete[] data;
+	return success;
+}
+
+
+tFileJPG::tOrientation tFileJPG::ReadOrientation(const uint8* jpgData, int numBytes)
+{
+	int tiffBytes = 0;
+	bool truncated = false;
+	int tiff = tJPG::FindExif(jpgData, numBytes, tiffBytes, truncated);
+	if (tiff < 0)
+		return truncated ? tOrientation::Invalid : tOrientation::Normal;
+
+	bool bigEndian = false;
+	int entry = tJPG::FindEntry(jpgData + tiff, tiffBytes, tJPG::TagOrientation, false, bigEndian);
+	if (entry < 0)
+		return tOrientation::Normal;
+
+	int value = tJPG::Get16(jpgData + tiff + entry + 8, bigEndian);
+	if ((value < int(tOrientation::Normal)) || (value > int(tOrientation::Rotate90ACW)))
+		return tOrientation::Normal;
+
+	return tOrientation(value);
+}
@@ -0,0 +1,628 @@
+// tFilePNG.cpp
+//
+// This class is a helper class. It should not be necessary to use this class directly. It knows how to save a png
+// file natively. Rows are read straight from a tPictureView, so no reordered or intermediate copy of the image is made.
+// Each row gets its own png filter and blocks of rows are deflated in parallel and stitched into a single zlib stream.
+// A row-at-a-time writer is also provided for images that are never fully in memory. Loading png files is still done
+// by CxImage in tPicture.
+//
+// Copyright (c) 2019 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <Foundation/tStandard.h>
+#include <Math/tFundamentals.h>
+#include <System/tFile.h>
+#include <System/tMachine.h>
+#include <zlib/zlib.h>
+#include "Image/tFilePNG.h"
+using namespace tImage;
+using namespace tSystem;
+
+
+namespace tPNG
+{
+	// Rows are grouped into blocks of roughly this many filtered bytes. Big enough that the cost of restarting the
+	// compressor each block is negligible and small enough that there are plenty of blocks to spread over the threads.
+	const int TargetBlockBytes = 256*1024;
+
+	// The deflate window. Each block is primed with this much of the filtered data before it.
+	const int DictionaryBytes = 32*1024;
+
+	// At most this many blocks per thread are compressed before being written, which bounds the memory used.
+	const int BlocksPerThread = 4;
+
+	// Each block's output has room for the zlib header in front and the Adler-32 trailer at the end.
+	const int HeaderBytes = 2;
+	const int TrailerBytes = 4;
+
+	// The row writer emits an IDAT chunk each time this much compressed data has built up.
+	const int ChunkBytes = 256*1024;
+
+	enum Filter
+	{
+		Filter_None,
+		Filter_Sub,
+		Filter_Up,
+		Filter_Average,
+		Filter_Paeth,
+		Filter_NumFilters
+	};
+
+	struct Block
+	{
+		int FirstRow;
+		int NumRows;
+		bool Last;
+
+		uint8* Data;									// Compressed data starts at Data + HeaderBytes.
+		int NumBytes;									// Compressed bytes, not including header or trailer space.
+		uLong Adler;									// Of the filtered bytes of this block alone.
+		int NumFilteredBytes;
+	};
+
+	void GetZlibSettings(int& zlibLevel, int& zlibFlags, tFilePNG::tLevel);
+	void WriteUint32(uint8* dest, uint32 value);
+	bool WriteChunk(tFileHandle, const char* type, const uint8* data, int numBytes);
+	bool WriteHeader(tFileHandle, int width, int height, int bpp);
+	const uint8* GetRow(uint8* dest, const tPictureView&, int row, int bpp);
+	int Paeth(int a, int b, int c);
+	void FilterRow(uint8* dest, Filter, const uint8* row, const uint8* prev, int rowBytes, int bpp);
+
+	// Filters the row with every filter into candidates, which has room for Filter_NumFilters filtered rows, and
+	// returns the one that should compress best.
+	const uint8* ChooseFilter(uint8* candidates, const uint8* row, const uint8* prev, int rowBytes, int bpp);
+	void FilterRows(uint8* dest, const tPictureView&, int firstRow, int numRows, int bpp, bool adaptive);
+	bool CompressBlock(Block&, const tPictureView&, int bpp, int zlibLevel, bool adaptive);
+}
+
+
+void tPNG::GetZlibSettings(int& zlibLevel, int& zlibFlags, tFilePNG::tLevel level)
+{
+	// The flags are the compression level hint in the zlib header.
+	zlibLevel = 6;
+	zlibFlags = 2;
+	switch (level)
+	{
+		case tFilePNG::tLevel::Fastest:		zlibLevel = 1;	zlibFlags = 0;	break;
+		case tFilePNG::tLevel::Fast:		zlibLevel = 3;	zlibFlags = 1;	break;
+		case tFilePNG::tLevel::Default:		zlibLevel = 6;	zlibFlags = 2;	break;
+		case tFilePNG::tLevel::Smallest:	zlibLevel = 9;	zlibFlags = 3;	break;
+	}
+}
+
+
+void tPNG::WriteUint32(uint8* dest, uint32 value)
+{
+	// Everything in a png is big-endian.
+	dest[0] = uint8(value >> 24);
+	dest[1] = uint8(value >> 16);
+	dest[2] = uint8(value >> 8);
+	dest[3] = uint8(value);
+}
+
+
+bool tPNG::WriteChunk(tFileHandle file, const char* type, const uint8* data, int numBytes)
+{
+	uint8 length[4];
+	WriteUint32(length, uint32(numBytes));
+
+	// The CRC covers the chunk type and data but not the length.
+	uLong crc = crc32(0, Z_NULL, 0);
+	crc = crc32(crc, (const Bytef*)type, 4);
+	if (numBytes > 0)
+		crc = crc32(crc, data, numBytes);
+
+	uint8 crcBytes[4];
+	WriteUint32(crcBytes, uint32(crc));
+
+	bool ok = (tWriteFile(file, length, 4) == 4);
+	ok = ok && (tWriteFile(file, type, 4) == 4);
+	if (numBytes > 0)
+		ok = ok && (tWriteFile(file, data, numBytes) == numBytes);
+	ok = ok && (tWriteFile(file, crcBytes, 4) == 4);
+	return ok;
+}
+
+
+bool tPNG::WriteHeader(tFileHandle file, int width, int height, int bpp)
+{
+	const uint8 signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	bool ok = (tWriteFile(file, signature, 8) == 8);
+
+	uint8 header[13];
+	WriteUint32(header + 0, uint32(width));
+	WriteUint32(header + 4, uint32(height));
+	header[8] = 8;										// Bits per channel.
+	header[9] = (bpp == 3) ? 2 : 6;						// Colour type. 2 is RGB and 6 is RGBA.
+	header[10] = 0;										// Compression method. Deflate.
+	header[11] = 0;										// Filter method. Adaptive with the 5 basic filters.
+	header[12] = 0;										// No interlacing.
+	return ok && WriteChunk(file, "IHDR", header, 13);
+}
+
+
+const uint8* tPNG::GetRow(uint8* dest, const tPictureView& view, int row, int bpp)
+{
+	// Png rows go from top to bottom. A tPixel is already laid out as RGBA bytes so 32 bit rows are read in place.
+	const tPixel* pixels = view.GetRow(view.GetHeight() - 1 - row);
+	if (bpp == 4)
+		return (const uint8*)pixels;
+
+	int width = view.GetWidth();
+	for (int x = 0; x < width; x++)
+	{
+		dest[3*x + 0] = pixels[x].R;
+		dest[3*x + 1] = pixels[x].G;
+		dest[3*x + 2] = pixels[x].B;
+	}
+	return dest;
+}
+
+
+inline int tPNG::Paeth(int a, int b, int c)
+{
+	int p = a + b - c;
+	int pa = tMath::tAbs(p - a);
+	int pb = tMath::tAbs(p - b);
+	int pc = tMath::tAbs(p - c);
+	if ((pa <= pb) && (pa <= pc))
+		return a;
+	if (pb <= pc)
+		return b;
+	return c;
+}
+
+
+void tPNG::FilterRow(uint8* dest, Filter filter, const uint8* row, const uint8* prev, int rowBytes, int bpp)
+{
+	// The first byte is the filter type. For the left-most pixel the bytes to the left are treated as zero.
+	dest[0] = uint8(filter);
+	uint8* out = dest + 1;
+	switch (filter)
+	{
+		case Filter_None:
+			tStd::tMemcpy(out, row, rowBytes);
+			break;
+
+		case Filter_Sub:
+			for (int i = 0; i < bpp; i++)
+				out[i] = row[i];
+			for (int i = bpp; i < rowBytes; i++)
+				out[i] = uint8(row[i] - row[i-bpp]);
+			break;
+
+		case Filter_Up:
+			for (int i = 0; i < rowBytes; i++)
+				out[i] = uint8(row[i] - prev[i]);
+			break;
+
+		case Filter_Average:
+			for (int i = 0; i < bpp; i++)
+				out[i] = uint8(row[i] - (prev[i] >> 1));
+			for (int i = bpp; i < rowBytes; i++)
+				out[i] = uint8(row[i] - ((int(row[i-bpp]) + int(prev[i])) >> 1));
+			break;
+
+		case Filter_Paeth:
+			for (int i = 0; i < bpp; i++)
+				out[i] = uint8(row[i] - prev[i]);
+			for (int i = bpp; i < rowBytes; i++)
+				out[i] = uint8(row[i] - Paeth(row[i-bpp], prev[i], prev[i-bpp]));
+			break;
+
+		default:
+			tAssert(!"Invalid png filter.");
+			break;
+	}
+}
+
+
+const uint8* tPNG::ChooseFilter(uint8* candidates, const uint8* row, const uint8* prev, int rowBytes, int bpp)
+{
+	// Choose the filter that minimizes the sum of the filtered bytes taken as signed values. This is the heuristic
+	// recommended by the png specification and gives most of the benefit of a full search.
+	int stride = rowBytes + 1;
+	int bestFilter = Filter_None;
+	uint64 bestSum = 0xFFFFFFFFFFFFFFFFULL;
+	for (int f = 0; f < Filter_NumFilters; f++)
+	{
+		uint8* candidate = candidates + f*stride;
+		FilterRow(candidate, Filter(f), row, prev, rowBytes, bpp);
+
+		uint64 sum = 0;
+		for (int i = 1; (i <= rowBytes) && (sum < bestSum); i++)
+			sum += uint64(tMath::tAbs(int(int8(candidate[i]))));
+
+		if (sum < bestSum)
+		{
+			bestSum = sum;
+			bestFilter = f;
+		}
+	}
+
+	return candidates + bestFilter*stride;
+}
+
+
+void tPNG::FilterRows(uint8* dest, const tPictureView& view, int firstRow, int numRows, int bpp, bool adaptive)
+{
+	int rowBytes = view.GetWidth()*bpp;
+	int stride = rowBytes + 1;
+
+	// For 24 bit rows alternate between two buffers so the previous row is still around.
+	uint8* rowBuffers = new uint8[2*rowBytes];
+	uint8* zeroRow = new uint8[rowBytes];
+	tStd::tMemset(zeroRow, 0, rowBytes);
+	uint8* candidates = adaptive ? new uint8[Filter_NumFilters*stride] : nullptr;
+
+	const uint8* prev = (firstRow > 0) ? GetRow(rowBuffers + ((firstRow-1) & 1)*rowBytes, view, firstRow-1, bpp) : zeroRow;
+	for (int r = 0; r < numRows; r++)
+	{
+		int row = firstRow + r;
+		const uint8* curr = GetRow(rowBuffers + (row & 1)*rowBytes, view, row, bpp);
+		uint8* out = dest + r*stride;
+		if (!adaptive)
+		{
+			FilterRow(out, Filter_Sub, curr, prev, rowBytes, bpp);
+			prev = curr;
+			continue;
+		}
+
+		tStd::tMemcpy(out, ChooseFilter(candidates, curr, prev, rowBytes, bpp), stride);
+		prev = curr;
+	}
+
+	delete[] candidates;
+	delete[] zeroRow;
+	delete[] rowBuffers;
+}
+
+
+bool tPNG::CompressBlock(Block& block, const tPictureView& view, int bpp, int zlibLevel, bool adaptive)
+{
+	block.Data = nullptr;
+	block.NumBytes = 0;
+	int stride = view.GetWidth()*bpp + 1;
+
+	// The rows just before the block are filtered again so their bytes can prime the compressor. Filtering only depends
+	// on the source pixels so these bytes are identical to the ones the previous block compressed.
+	int dictRows = tMath::tMin(block.FirstRow, (DictionaryBytes + stride - 1) / stride);
+	int numFiltered = (dictRows + block.NumRows)*stride;
+	uint8* filtered = new uint8[numFiltered];
+	FilterRows(filtered, view, block.FirstRow - dictRows, dictRows + block.NumRows, bpp, adaptive);
+
+	uint8* input = filtered + dictRows*stride;
+	block.NumFilteredBytes = block.NumRows*stride;
+	block.Adler = adler32(adler32(0, Z_NULL, 0), input, block.NumFilteredBytes);
+
+	// Raw deflate (negative window bits) since the zlib header and trailer are written for the whole stream.
+	z_stream strm;
+	tStd::tMemset(&strm, 0, sizeof(strm));
+	if (deflateInit2(&strm, zlibLevel, Z_DEFLATED, -15, 8, Z_FILTERED) != Z_OK)
+	{
+		delete[] filtered;
+		return false;
+	}
+
+	if (dictRows > 0)
+	{
+		int dictBytes = tMath::tMin(dictRows*stride, DictionaryBytes);
+		deflateSetDictionary(&strm, input - dictBytes, dictBytes);
+	}
+
+	// The bound is for a finished stream, and a sync flush adds a few bytes, so the buffer grows if it ever needs to.
+	int capacity = int(deflateBound(&strm, block.NumFilteredBytes)) + 64;
+	uint8* out = new uint8[HeaderBytes + capacity + TrailerBytes];
+	strm.next_in = input;
+	strm.avail_in = block.NumFilteredBytes;
+	strm.next_out = out + HeaderBytes;
+	strm.avail_out = capacity;
+
+	// Every block but the last ends with a sync flush. This byte-aligns the output and ends on an empty stored block
+	// with the final bit unset, so the next block's data can follow directly.
+	int flush = block.Last ? Z_FINISH : Z_SYNC_FLUSH;
+	bool ok = true;
+	while (true)
+	{
+		int result = deflate(&strm, flush);
+		if ((result != Z_OK) && (result != Z_STREAM_END) && (result != Z_BUF_ERROR))
+		{
+			ok = false;
+			break;
+		}
+
+		bool done = block.Last ? (result == Z_STREAM_END) : ((strm.avail_in == 0) && (strm.avail_out > 0));
+		if (done)
+			break;
+
+		int used = capacity - int(strm.avail_out);
+		int newCapacity = capacity*2;
+		uint8* newOut = new uint8[HeaderBytes + newCapacity + TrailerBytes];
+		tStd::tMemcpy(newOut, out, HeaderBytes + used);
+		delete[] out;
+		out = newOut;
+		strm.next_out = out + HeaderBytes + used;
+		strm.avail_out = newCapacity - used;
+		capacity = newCapacity;
+	}
+
+	block.NumBytes = capacity - int(strm.avail_out);
+	deflateEnd(&strm);
+	delete[] filtered;
+	if (!ok)
+	{
+		delete[] out;
+		return false;
+	}
+
+	block.Data = out;
+	return true;
+}
+
+
+tFilePNG::tFormat tFilePNG::Save(const tString& pngFile, tFormat format, tLevel level, int numThreads) const
+{
+	if (!IsValid() || (format == tFormat::Invalid))
+		return tFormat::Invalid;
+
+	if (tSystem::tGetFileType(pngFile) != tSystem::tFileType::PNG)
+		return tFormat::Invalid;
+
+	if (format == tFormat::Auto)
+	{
+		if (View.IsOpaque())
+			format = tFormat::Bit24;
+		else
+			format = tFormat::Bit32;
+	}
+
+	if (numThreads <= 0)
+		numThreads = tSystem::tGetNumCores();
+
+	int zlibLevel, zlibFlags;
+	tPNG::GetZlibSettings(zlibLevel, zlibFlags, level);
+	bool adaptive = (level != tLevel::Fastest);
+
+	int width = View.GetWidth();
+	int height = View.GetHeight();
+	int bpp = (format == tFormat::Bit24) ? 3 : 4;
+	int stride = width*bpp + 1;
+	int rowsPerBlock = tMath::tMax(tPNG::TargetBlockBytes / stride, 1);
+	int numBlocks = (height + rowsPerBlock - 1) / rowsPerBlock;
+
+	tFileHandle file = tOpenFile(pngFile.ConstText(), "wb");
+	if (!file)
+		return tFormat::Invalid;
+
+	bool ok = tPNG::WriteHeader(file, width, height, bpp);
+
+	// Deflate with a 32KB window. The check bits make the 16 bit header a multiple of 31.
+	uint8 cmf = 0x78;
+	uint8 flg = uint8(zlibFlags << 6);
+	flg += uint8(31 - ((int(cmf)*256 + int(flg)) % 31));
+
+	// Blocks are compressed a batch at a time and written in order, so the stream is simply their concatenation.
+	uLong adler = adler32(0, Z_NULL, 0);
+	int batchSize = numThreads*tPNG::BlocksPerThread;
+	tPNG::Block* blocks = new tPNG::Block[batchSize];
+	for (int batchStart = 0; ok && (batchStart < numBlocks); batchStart += batchSize)
+	{
+		int count = tMath::tMin(batchSize, numBlocks - batchStart);
+		tSystem::tParallelFor
+		(
+			count,
+			[&](int b)
+			{
+				tPNG::Block& block = blocks[b];
+				int index = batchStart + b;
+				block.FirstRow = index*rowsPerBlock;
+				block.NumRows = tMath::tMin(rowsPerBlock, height - block.FirstRow);
+				block.Last = (index == numBlocks-1);
+				tPNG::CompressBlock(block, View, bpp, zlibLevel, adaptive);
+			},
+			numThreads
+		);
+
+		for (int b = 0; b < count; b++)
+		{
+			tPNG::Block& block = blocks[b];
+			ok = ok && block.Data;
+			if (ok)
+			{
+				adler = adler32_combine(adler, block.Adler, block.NumFilteredBytes);
+				uint8* data = block.Data + tPNG::HeaderBytes;
+				int numBytes = block.NumBytes;
+				if (batchStart + b == 0)
+				{
+					block.Data[0] = cmf;
+					block.Data[1] = flg;
+					data = block.Data;
+					numBytes += tPNG::HeaderBytes;
+				}
+
+				if (block.Last)
+				{
+					tPNG::WriteUint32(block.Data + tPNG::HeaderBytes + block.NumBytes, uint32(adler));
+					numBytes += tPNG::TrailerBytes;
+				}
+				ok = tPNG::WriteChunk(file, "IDAT", data, numBytes);
+			}
+			delete[] block.Data;
+		}
+	}
+	delete[] blocks;
+
+	ok = ok && tPNG::WriteChunk(file, "IEND", nullptr, 0);
+	tCloseFile(file);
+	if (!ok)
+		return tFormat::Invalid;
+
+	return format;
+}
+
+
+bool tPNGWriter::Begin(const tString& pngFile, int width, int height, tFilePNG::tFormat format, tFilePNG::tLevel level)
+{
+	Close();
+	if ((width <= 0) || (height <= 0) || ((format != tFilePNG::tFormat::Bit24) && (format != tFilePNG::tFormat::Bit32)))
+		return false;
+
+	File = tOpenFile(pngFile.ConstText(), "wb");
+	if (!File)
+		return false;
+
+	Width = width;
+	Height = height;
+	Bpp = (format == tFilePNG::tFormat::Bit24) ? 3 : 4;
+	Adaptive = (level != tFilePNG::tLevel::Fastest);
+	RowsWritten = 0;
+	Error = false;
+
+	// The previous row starts out as zeros, which is what the filters expect above the first row.
+	int rowBytes = Width*Bpp;
+	Rows = new uint8[2*rowBytes];
+	tStd::tMemset(Rows, 0, 2*rowBytes);
+	Filtered = new uint8[(Adaptive ? tPNG::Filter_NumFilters : 1)*(rowBytes + 1)];
+	Output = new uint8[tPNG::ChunkBytes];
+	OutputUsed = 0;
+
+	// A normal zlib stream this time since it is a single stream. Zlib writes the header and Adler-32 trailer itself.
+	int zlibLevel, zlibFlags;
+	tPNG::GetZlibSettings(zlibLevel, zlibFlags, level);
+	Stream = new z_stream;
+	tStd::tMemset(Stream, 0, sizeof(z_stream));
+	if (deflateInit2(Stream, zlibLevel, Z_DEFLATED, 15, 8, Z_FILTERED) != Z_OK)
+	{
+		delete Stream;
+		Stream = nullptr;
+		Close();
+		return false;
+	}
+
+	if (!tPNG::WriteHeader(File, Width, Height, Bpp))
+	{
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+
+bool tPNGWriter::WriteRow(const tPixel* row)
+{
+	if (!File || Error || (RowsWritten >= Height) || !row)
+		return false;
+
+	// The rows alternate between the two halves of the buffer so the previous one is still around.
+	int rowBytes = Width*Bpp;
+	uint8* curr = Rows + (RowsWritten & 1)*rowBytes;
+	const uint8* prev = Rows + ((RowsWritten + 1) & 1)*rowBytes;
+	if (Bpp == 4)
+	{
+		tStd::tMemcpy(curr, row, rowBytes);
+	}
+	else
+	{
+		for (int x = 0; x < Width; x++)
+		{
+			curr[3*x + 0] = row[x].R;
+			curr[3*x + 1] = row[x].G;
+			curr[3*x + 2] = row[x].B;
+		}
+	}
+
+	const uint8* filtered = Filtered;
+	if (Adaptive)
+		filtered = tPNG::ChooseFilter(Filtered, curr, prev, rowBytes, Bpp);
+	else
+		tPNG::FilterRow(Filtered, tPNG::Filter_Sub, curr, prev, rowBytes, Bpp);
+
+	if (!Deflate(filtered, rowBytes + 1, Z_NO_FLUSH))
+		return false;
+
+	RowsWritten++;
+	return true;
+}
+
+
+bool tPNGWriter::Deflate(const uint8* data, int numBytes, int flush)
+{
+	Stream->next_in = (Bytef*)data;
+	Stream->avail_in = numBytes;
+	while (true)
+	{
+		Stream->next_out = Output + OutputUsed;
+		Stream->avail_out = tPNG::ChunkBytes - OutputUsed;
+		int result = deflate(Stream, flush);
+		if ((result != Z_OK) && (result != Z_STREAM_END) && (result != Z_BUF_ERROR))
+		{
+			Error = true;
+			return false;
+		}
+		OutputUsed = tPNG::ChunkBytes - int(Stream->avail_out);
+
+		// A full buffer becomes an IDAT chunk. The last chunk is written by End.
+		bool full = (OutputUsed == tPNG::ChunkBytes);
+		if (full)
+		{
+			if (!tPNG::WriteChunk(File, "IDAT", Output, OutputUsed))
+			{
+				Error = true;
+				return false;
+			}
+			OutputUsed = 0;
+		}
+
+		bool done = (flush == Z_FINISH) ? (result == Z_STREAM_END) : ((Stream->avail_in == 0) && !full);
+		if (done)
+			return true;
+	}
+}
+
+
+bool tPNGWriter::End()
+{
+	if (!File)
+		return false;
+
+	bool ok = !Error && (RowsWritten == Height) && Deflate(nullptr, 0, Z_FINISH);
+	if (ok && (OutputUsed > 0))
+		ok = tPNG::WriteChunk(File, "IDAT", Output, OutputUsed);
+
+	ok = ok && tPNG::WriteChunk(File, "IEND", nullptr, 0);
+	Close();
+	return ok;
+}
+
+
+void tPNGWriter::Close()
+{
+	if (Stream)
+	{
+		deflateEnd(Stream);
+		delete Stream;
+		Stream = nullptr;
+	}
+
+	if (File)
+	{
+		tCloseFile(File);
+		File = nullptr;
+	}
+
+	delete[] Rows;
+	Rows = nullptr;
+	delete[] Filtered;
+	Filtered = nullptr;
+	delete[] Output;
+	Output = nullptr;
+	OutputUsed = 0;
+}
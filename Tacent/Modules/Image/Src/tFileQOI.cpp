@@ -0,0 +1,583 @@
+// tFileQOI.cpp
+//
+// This class is a helper class. It should not be necessary to use this class directly. It knows how to load and save a
+// qoi (Quite OK Image) file natively. Qoi is a lossless format that is encoded and decoded in a single pass, making it
+// a good choice for caches and scratch files where png is too slow to write and an uncompressed tga is too large. Like
+// tFileTGA, the loaded tPixels may be 'stolen' by a tPicture. A row-at-a-time writer and reader are also provided so
+// that images can be streamed without ever holding all the pixels in memory.
+//
+// Copyright (c) 2019 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <Foundation/tStandard.h>
+#include <System/tFile.h>
+#include "Image/tFileQOI.h"
+#include "Image/tPicture.h"
+using namespace tSystem;
+namespace tImage
+{
+
+
+namespace tQOI
+{
+	const int HeaderBytes = 14;
+	const int EndMarkerBytes = 8;
+	const uint8 EndMarker[EndMarkerBytes] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+
+	// The largest single op is OpRGBA at 5 bytes.
+	const int MaxOpBytes = 5;
+	const int BufferBytes = 64*1024;
+
+	// Same limit as the reference implementation. Keeps width*height*4 well inside an int.
+	const int MaxPixels = 400000000;
+
+	enum Op
+	{
+		Op_Index	= 0x00,								// 00xxxxxx
+		Op_Diff		= 0x40,								// 01xxxxxx
+		Op_Luma		= 0x80,								// 10xxxxxx
+		Op_Run		= 0xC0,								// 11xxxxxx
+		Op_RGB		= 0xFE,								// 11111110
+		Op_RGBA		= 0xFF,								// 11111111
+		Op_Mask		= 0xC0
+	};
+
+	const int MaxRun = 62;
+
+	inline int Hash(const tPixel& p)																					{ return (p.R*3 + p.G*5 + p.B*7 + p.A*11) & 63; }
+	void WriteUint32(uint8* dest, uint32 value);
+	uint32 ReadUint32(const uint8* src);
+}
+
+
+void tQOI::WriteUint32(uint8* dest, uint32 value)
+{
+	// Qoi is big-endian.
+	dest[0] = uint8(value >> 24);
+	dest[1] = uint8(value >> 16);
+	dest[2] = uint8(value >> 8);
+	dest[3] = uint8(value);
+}
+
+
+uint32 tQOI::ReadUint32(const uint8* src)
+{
+	return (uint32(src[0]) << 24) | (uint32(src[1]) << 16) | (uint32(src[2]) << 8) | uint32(src[3]);
+}
+
+
+bool tQOIWriter::Begin(const tString& qoiFile, int width, int height, int channels)
+{
+	Close();
+	if ((width <= 0) || (height <= 0) || (int64(width)*int64(height) > tQOI::MaxPixels))
+		return false;
+
+	if ((channels != 3) && (channels != 4))
+		return false;
+
+	File = tOpenFile(qoiFile.ConstText(), "wb");
+	if (!File)
+		return false;
+
+	Width = width;
+	Height = height;
+	Channels = channels;
+	RowsWritten = 0;
+	Error = false;
+	tStd::tMemset(Index, 0, sizeof(Index));
+	Prev = tColouri(0, 0, 0, 255);
+	Run = 0;
+	Buffer = new uint8[tQOI::BufferBytes];
+	BufferUsed = 0;
+
+	uint8* header = Buffer;
+	header[0] = 'q'; header[1] = 'o'; header[2] = 'i'; header[3] = 'f';
+	tQOI::WriteUint32(header + 4, uint32(width));
+	tQOI::WriteUint32(header + 8, uint32(height));
+	header[12] = uint8(channels);
+	header[13] = 0;										// sRGB with linear alpha.
+	BufferUsed = tQOI::HeaderBytes;
+	return true;
+}
+
+
+bool tQOIWriter::Flush()
+{
+	if (BufferUsed > 0)
+	{
+		if (tWriteFile(File, Buffer, BufferUsed) != BufferUsed)
+			Error = true;
+		BufferUsed = 0;
+	}
+	return !Error;
+}
+
+
+bool tQOIWriter::WriteRow(const tPixel* row)
+{
+	if (!File || Error || (RowsWritten >= Height) || !row)
+		return false;
+
+	// Locals so the compiler can keep the state in registers for the inner loop. Writes through out could otherwise
+	// alias the members.
+	tPixel prev = Prev;
+	int run = Run;
+	int width = Width;
+	tPixel* index = Index;
+	uint8* out = Buffer + BufferUsed;
+	const uint8* flushPoint = Buffer + tQOI::BufferBytes - tQOI::MaxOpBytes;
+	uint8 alphaMask = (Channels == 4) ? 0x00 : 0xFF;
+
+	for (int x = 0; x < width; x++)
+	{
+		if (out >= flushPoint)
+		{
+			BufferUsed = int(out - Buffer);
+			if (!Flush())
+				return false;
+			out = Buffer;
+		}
+
+		tPixel px = row[x];
+		px.A |= alphaMask;
+		if (px == prev)
+		{
+			run++;
+			if (run == tQOI::MaxRun)
+			{
+				*out++ = uint8(tQOI::Op_Run | (run - 1));
+				run = 0;
+			}
+			continue;
+		}
+
+		if (run > 0)
+		{
+			*out++ = uint8(tQOI::Op_Run | (run - 1));
+			run = 0;
+		}
+
+		int hash = tQOI::Hash(px);
+		if (index[hash] == px)
+		{
+			*out++ = uint8(tQOI::Op_Index | hash);
+		}
+		else
+		{
+			index[hash] = px;
+			if (px.A == prev.A)
+			{
+				// The differences wrap around, so they are computed as signed bytes.
+				int dr = int8(px.R - prev.R);
+				int dg = int8(px.G - prev.G);
+				int db = int8(px.B - prev.B);
+				int drg = dr - dg;
+				int dbg = db - dg;
+				if ((dr >= -2) && (dr <= 1) && (dg >= -2) && (dg <= 1) && (db >= -2) && (db <= 1))
+				{
+					*out++ = uint8(tQOI::Op_Diff | ((dr + 2) << 4) | ((dg + 2) << 2) | (db + 2));
+				}
+				else if ((dg >= -32) && (dg <= 31) && (drg >= -8) && (drg <= 7) && (dbg >= -8) && (dbg <= 7))
+				{
+					*out++ = uint8(tQOI::Op_Luma | (dg + 32));
+					*out++ = uint8(((drg + 8) << 4) | (dbg + 8));
+				}
+				else
+				{
+					*out++ = tQOI::Op_RGB;
+					*out++ = px.R;
+					*out++ = px.G;
+					*out++ = px.B;
+				}
+			}
+			else
+			{
+				*out++ = tQOI::Op_RGBA;
+				*out++ = px.R;
+				*out++ = px.G;
+				*out++ = px.B;
+				*out++ = px.A;
+			}
+		}
+		prev = px;
+	}
+
+	BufferUsed = int(out - Buffer);
+	Prev = prev;
+	Run = run;
+	RowsWritten++;
+	return true;
+}
+
+
+bool tQOIWriter::End()
+{
+	if (!File)
+		return false;
+
+	// A run may still be pending from the last row. Runs are allowed to span rows.
+	if (Run > 0)
+	{
+		Buffer[BufferUsed++] = uint8(tQOI::Op_Run | (Run - 1));
+		Run = 0;
+	}
+
+	if (BufferUsed + tQOI::EndMarkerBytes > tQOI::BufferBytes)
+		Flush();
+	tStd::tMemcpy(Buffer + BufferUsed, tQOI::EndMarker, tQOI::EndMarkerBytes);
+	BufferUsed += tQOI::EndMarkerBytes;
+	Flush();
+
+	bool success = !Error && (RowsWritten == Height);
+	Close();
+	return success;
+}
+
+
+void tQOIWriter::Close()
+{
+	if (File)
+		tCloseFile(File);
+	File = nullptr;
+	delete[] Buffer;
+	Buffer = nullptr;
+	BufferUsed = 0;
+}
+
+
+bool tQOIReader::Begin(const tString& qoiFile)
+{
+	End();
+	if (!tFileExists(qoiFile))
+		return false;
+
+	File = tOpenFile(qoiFile.ConstText(), "rb");
+	if (!File)
+		return false;
+
+	Buffer = new uint8[tQOI::BufferBytes];
+	Data = Buffer;
+	DataSize = 0;
+	DataPos = 0;
+	if (!ReadHeader())
+	{
+		End();
+		return false;
+	}
+
+	return true;
+}
+
+
+bool tQOIReader::Begin(const uint8* qoiFileInMemory, int numBytes)
+{
+	End();
+	if (!qoiFileInMemory || (numBytes <= 0))
+		return false;
+
+	Data = qoiFileInMemory;
+	DataSize = numBytes;
+	DataPos = 0;
+	if (!ReadHeader())
+	{
+		End();
+		return false;
+	}
+
+	return true;
+}
+
+
+bool tQOIReader::ReadHeader()
+{
+	if (!Available(tQOI::HeaderBytes))
+		return false;
+
+	const uint8* header = Data + DataPos;
+	if ((header[0] != 'q') || (header[1] != 'o') || (header[2] != 'i') || (header[3] != 'f'))
+		return false;
+
+	uint32 width = tQOI::ReadUint32(header + 4);
+	uint32 height = tQOI::ReadUint32(header + 8);
+	int channels = header[12];
+	int colourSpace = header[13];
+	if ((width == 0) || (height == 0) || (uint64(width)*uint64(height) > uint64(tQOI::MaxPixels)))
+		return false;
+
+	if (((channels != 3) && (channels != 4)) || (colourSpace > 1))
+		return false;
+
+	DataPos += tQOI::HeaderBytes;
+	Width = int(width);
+	Height = int(height);
+	Channels = channels;
+	RowsRead = 0;
+	tStd::tMemset(Index, 0, sizeof(Index));
+	Prev = tColouri(0, 0, 0, 255);
+	Run = 0;
+	return true;
+}
+
+
+bool tQOIReader::Available(int numBytes)
+{
+	if (DataSize - DataPos >= numBytes)
+		return true;
+
+	if (!File)
+		return false;
+
+	// Move what's left to the front of the buffer and top it up.
+	int remaining = DataSize - DataPos;
+	if (remaining > 0)
+		tStd::tMemmove(Buffer, Buffer + DataPos, remaining);
+
+	DataPos = 0;
+	DataSize = remaining;
+	int numRead = tReadFile(File, Buffer + remaining, tQOI::BufferBytes - remaining);
+	if (numRead > 0)
+		DataSize += numRead;
+
+	return (DataSize >= numBytes);
+}
+
+
+bool tQOIReader::ReadRow(tPixel* dest)
+{
+	if (!Data || (RowsRead >= Height) || !dest)
+		return false;
+
+	tPixel px = Prev;
+	int run = Run;
+	for (int x = 0; x < Width; x++)
+	{
+		if (run > 0)
+		{
+			run--;
+			dest[x] = px;
+			continue;
+		}
+
+		// Only the last few ops of a file can be shorter than the maximum, so a short read is only an error if the op
+		// actually needs the missing bytes.
+		Available(tQOI::MaxOpBytes);
+		int left = DataSize - DataPos;
+		if (left < 1)
+			return false;
+
+		const uint8* in = Data + DataPos;
+		uint8 b1 = in[0];
+		if (b1 == tQOI::Op_RGB)
+		{
+			if (left < 4)
+				return false;
+			px.R = in[1];
+			px.G = in[2];
+			px.B = in[3];
+			DataPos += 4;
+		}
+		else if (b1 == tQOI::Op_RGBA)
+		{
+			if (left < 5)
+				return false;
+			px.R = in[1];
+			px.G = in[2];
+			px.B = in[3];
+			px.A = in[4];
+			DataPos += 5;
+		}
+		else
+		{
+			switch (b1 & tQOI::Op_Mask)
+			{
+				case tQOI::Op_Index:
+					px = Index[b1];
+					DataPos += 1;
+					break;
+
+				case tQOI::Op_Diff:
+					px.R += ((b1 >> 4) & 0x03) - 2;
+					px.G += ((b1 >> 2) & 0x03) - 2;
+					px.B += (b1 & 0x03) - 2;
+					DataPos += 1;
+					break;
+
+				case tQOI::Op_Luma:
+				{
+					if (left < 2)
+						return false;
+					uint8 b2 = in[1];
+					int dg = (b1 & 0x3F) - 32;
+					px.R += dg - 8 + ((b2 >> 4) & 0x0F);
+					px.G += dg;
+					px.B += dg - 8 + (b2 & 0x0F);
+					DataPos += 2;
+					break;
+				}
+
+				case tQOI::Op_Run:
+					run = b1 & 0x3F;
+					DataPos += 1;
+					break;
+			}
+		}
+
+		Index[tQOI::Hash(px)] = px;
+		dest[x] = px;
+	}
+
+	Prev = px;
+	Run = run;
+	RowsRead++;
+	return true;
+}
+
+
+void tQOIReader::End()
+{
+	if (File)
+		tCloseFile(File);
+	File = nullptr;
+	delete[] Buffer;
+	Buffer = nullptr;
+	Data = nullptr;
+	DataSize = 0;
+	DataPos = 0;
+	Width = 0;
+	Height = 0;
+	RowsRead = 0;
+}
+
+
+bool tFileQOI::Load(const tString& qoiFile)
+{
+	Clear();
+
+	if (tSystem::tGetFileType(qoiFile) != tSystem::tFileType::QOI)
+		return false;
+
+	tQOIReader reader;
+	if (!reader.Begin(qoiFile))
+		return false;
+
+	return Read(reader);
+}
+
+
+bool tFileQOI::Set(const uint8* qoiFileInMemory, int numBytes)
+{
+	Clear();
+
+	tQOIReader reader;
+	if (!reader.Begin(qoiFileInMemory, numBytes))
+		return false;
+
+	return Read(reader);
+}
+
+
+bool tFileQOI::Read(tQOIReader& reader)
+{
+	Width = reader.GetWidth();
+	Height = reader.GetHeight();
+	SrcFileBitDepth = reader.GetChannels()*8;
+	Pixels = tPicture::AllocPixels(Width*Height);
+
+	// Qoi rows go from top to bottom and ours from bottom to top.
+	for (int y = Height-1; y >= 0; y--)
+	{
+		if (!reader.ReadRow(Pixels + y*Width))
+		{
+			Clear();
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+bool tFileQOI::Set(tPixel* pixels, int width, int height, bool steal)
+{
+	Clear();
+	if (!pixels || (width <= 0) || (height <= 0))
+		return false;
+
+	Width = width;
+	Height = height;
+	if (steal)
+	{
+		Pixels = pixels;
+	}
+	else
+	{
+		Pixels = tPicture::AllocPixels(Width*Height);
+		tStd::tMemcpy(Pixels, pixels, Width*Height*sizeof(tPixel));
+	}
+
+	return true;
+}
+
+
+tFileQOI::tFormat tFileQOI::Save(const tString& qoiFile, tFormat format) const
+{
+	if (!IsValid())
+		return tFormat::Invalid;
+
+	return Save(qoiFile, tPictureView(Pixels, Width, Height), format);
+}
+
+
+tFileQOI::tFormat tFileQOI::Save(const tString& qoiFile, const tPictureView& view, tFormat format)
+{
+	if (!view.IsValid() || (format == tFormat::Invalid))
+		return tFormat::Invalid;
+
+	if (tSystem::tGetFileType(qoiFile) != tSystem::tFileType::QOI)
+		return tFormat::Invalid;
+
+	if (format == tFormat::Auto)
+		format = view.IsOpaque() ? tFormat::Bit24 : tFormat::Bit32;
+
+	tQOIWriter writer;
+	if (!writer.Begin(qoiFile, view.GetWidth(), view.GetHeight(), (format == tFormat::Bit24) ? 3 : 4))
+		return tFormat::Invalid;
+
+	for (int y = view.GetHeight()-1; y >= 0; y--)
+		if (!writer.WriteRow(view.GetRow(y)))
+			break;
+
+	if (!writer.End())
+		return tFormat::Invalid;
+
+	return format;
+}
+
+
+void tFileQOI::Clear()
+{
+	tPicture::FreePixels(Pixels);
+	Pixels = nullptr;
+	Width = 0;
+	Height = 0;
+}
+
+
+tPixel* tFileQOI::StealPixels()
+{
+	tPixel* pixels = Pixels;
+	Pixels = nullptr;
+	Width = 0;
+	Height = 0;
+	return pixels;
+}
+
+
+}
@@ -4,7 +4,8 @@
 // targa (.tga) file. It does zero processing of image data. It knows the details of the tga file format and loads the
 // data into a tPixel array. These tPixels may be 'stolen' by the tPicture's constructor if a targa file is specified.
 // After the array is stolen the tFileTGA is invalid. This is purely for performance. The tPicture class uses the
-// CxImage library for image files that are not targas.
+// CxImage library for image files that are not targas. A row-at-a-time writer and reader are also provided so that
+// targas can be streamed without ever holding all the pixels in memory.
 //
 // Copyright (c) 2006, 2017 Tristan Grimmer.
 // Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
@@ -18,11 +19,91 @@
 
 #include <System/tFile.h>
 #include "Image/tFileTGA.h"
+#include "Image/tPicture.h"
 using namespace tSystem;
 namespace tImage
 {
 
 
+namespace tTGA
+{
+	#pragma pack(push, r1, 1)
+	struct Header
+	{
+		int8 IDLength;
+		int8 ColourMapType;
+		int8 DataTypeCode;
+		int16 ColourMapOrigin;
+		int16 ColourMapLength;
+		int8 ColourMapDepth;
+		int16 OriginX;
+		int16 OriginY;
+
+		uint16 Width;
+		uint16 Height;
+		int8 BitDepth;
+
+		// Bits 0-3 are the number of alpha bits. If bit 5 is set the top row is first in the file, otherwise the
+		// bottom row is first like a tPicture.
+		int8 Orientation;
+	};
+	#pragma pack(pop, r1)
+	tStaticAssert(sizeof(Header) == 18);
+
+	// The streaming reader and writer go through a buffer this big.
+	const int BufferBytes = 64*1024;
+
+	// The largest RLE packet. A header byte and 128 pixels of 4 bytes.
+	const int MaxPacketBytes = 1 + 128*4;
+
+	bool IsSupported(const Header&);
+	int GetColourMapBytes(const Header&);
+	void ReadColour(tColouri& dest, const uint8* src, int bytesPerPixel);
+
+	// Seeks relative to the current position. Large offsets are split up since tFileSeek only takes an int.
+	bool SeekRelative(tFileHandle, int64 offset);
+}
+
+
+bool tTGA::IsSupported(const Header& header)
+{
+	// We support 16, 24, and 32 bit depths. We support data type mode 2 (uncompressed RGB) and mode 10 (Run-length
+	// encoded RLE RGB). We allow a colour map to be present, but don't use it.
+	int bitDepth = header.BitDepth;
+	int dataType = header.DataTypeCode;
+	return
+	(
+		((bitDepth == 16) || (bitDepth == 24) || (bitDepth == 32)) &&
+		((dataType == 2) || (dataType == 10)) &&
+		((header.ColourMapType == 0) || (header.ColourMapType == 1)) &&
+		(header.Width > 0) && (header.Height > 0)
+	);
+}
+
+
+int tTGA::GetColourMapBytes(const Header& header)
+{
+	if (!header.ColourMapType)
+		return 0;
+
+	return int(uint16(header.ColourMapLength)) * ((int(uint8(header.ColourMapDepth)) + 7) / 8);
+}
+
+
+bool tTGA::SeekRelative(tFileHandle file, int64 offset)
+{
+	const int64 maxStep = 1024*1024*1024;
+	while (offset != 0)
+	{
+		int64 step = tMath::tClamp(offset, -maxStep, maxStep);
+		if (tFileSeek(file, int(step), tSeekOrigin::Current) != 0)
+			return false;
+		offset -= step;
+	}
+	return true;
+}
+
+
 bool tFileTGA::Load(const tString& tgaFile)
 {
 	Clear();
@@ -48,56 +129,26 @@ bool tFileTGA::Set(const uint8* tgaFileInMemory, int numBytes)
 	if ((numBytes <= 0) || !tgaFileInMemory)
 		return false;
 
-	#pragma pack(push, r1, 1)
-	struct TGAHeader
-	{
-		int8 IDLength;
-		int8 ColourMapType;
-		int8 DataTypeCode;
-		int16 ColourMapOrigin;
-		int16 ColourMapLength;
-		int8 ColourMapDepth;
-		int16 OriginX;
-		int16 OriginY;
-
-		int16 Width;
-		int16 Height;
-		int8 BitDepth;
+	if (numBytes < int(sizeof(tTGA::Header)))
+		return false;
 
-		// If Bit 5 of orientation is set the image will be upside down (like BMP).
-		int8 Orientation;
-	};
-	#pragma pack(pop, r1)
-	tStaticAssert(sizeof(TGAHeader) == 18);
+	tTGA::Header* header = (tTGA::Header*)tgaFileInMemory;
+	if (!tTGA::IsSupported(*header))
+		return false;
 
-	TGAHeader* header = (TGAHeader*)tgaFileInMemory;
 	Width = header->Width;
 	Height = header->Height;
 	int bitDepth = header->BitDepth;
 	int dataType = header->DataTypeCode;
-
-	// We support 16, 24, and 32 bit depths. We support data type mode 2 (uncompressed RGB) and mode 10 (Run-length
-	// encoded RLE RGB). We allow a colour map to be present, but don't use it.
-	if
-	(
-		((bitDepth != 16) && (bitDepth != 24) && (bitDepth != 32)) ||
-		((dataType != 2) && (dataType != 10)) ||
-		((header->ColourMapType != 0) && (header->ColourMapType != 1))
-	)
-	{
-		Clear();
-		return false;
-	}
 	SrcFileBitDepth = bitDepth;
 	uint8* srcData = (uint8*)(header + 1);
 
-	// These usually are zero. In most cases the pixel data will follow directly after the header. iColourMapType is a
-	// boolean 0 or 1.
-	srcData += header->IDLength;
-	srcData += header->ColourMapType * header->ColourMapLength;
+	// These usually are zero. In most cases the pixel data will follow directly after the header.
+	srcData += uint8(header->IDLength);
+	srcData += tTGA::GetColourMapBytes(*header);
 
 	int numPixels = Width * Height;
-	Pixels = new tPixel[numPixels];
+	Pixels = tPicture::AllocPixels(numPixels);
 
 	// Read the image data.
 	int bytesPerPixel = bitDepth >> 3;
@@ -114,8 +165,8 @@ bool tFileTGA::Set(const uint8* tgaFileInMemory, int numBytes)
 				uint8 rleChunk = srcData[0] & 0x80;
 
 				tColouri firstColour;
-				ReadColourBytes(firstColour, srcData+1, bytesPerPixel);
-				ReadColourBytes(Pixels[pixel], srcData+1, bytesPerPixel);
+				tTGA::ReadColour(firstColour, srcData+1, bytesPerPixel);
+				tTGA::ReadColour(Pixels[pixel], srcData+1, bytesPerPixel);
 				pixel++;
 				srcData += bytesPerPixel+1;
 
@@ -133,7 +184,7 @@ bool tFileTGA::Set(const uint8* tgaFileInMemory, int numBytes)
 					// Chunk is normal.
 					for (int i = 0; i < j; i++)
 					{
-						ReadColourBytes(Pixels[pixel], srcData, bytesPerPixel);
+						tTGA::ReadColour(Pixels[pixel], srcData, bytesPerPixel);
 						pixel++;
 						srcData += bytesPerPixel;
 					}
@@ -145,7 +196,7 @@ bool tFileTGA::Set(const uint8* tgaFileInMemory, int numBytes)
 			default:
 			{
 				// Not compressed.
-				ReadColourBytes(Pixels[pixel], srcData, bytesPerPixel);
+				tTGA::ReadColour(Pixels[pixel], srcData, bytesPerPixel);
 				pixel++;
 				srcData += bytesPerPixel;
 				break;
@@ -153,11 +204,27 @@ bool tFileTGA::Set(const uint8* tgaFileInMemory, int numBytes)
 		}
 	}
 
+	// Pixels are stored bottom row first so files with a top-left origin are flipped.
+	if (header->Orientation & 0x20)
+	{
+		tPixel* row = new tPixel[Width];
+		int rowBytes = Width*sizeof(tPixel);
+		for (int y = 0; y < Height/2; y++)
+		{
+			tPixel* top = Pixels + (Height-1-y)*Width;
+			tPixel* bottom = Pixels + y*Width;
+			tStd::tMemcpy(row, top, rowBytes);
+			tStd::tMemcpy(top, bottom, rowBytes);
+			tStd::tMemcpy(bottom, row, rowBytes);
+		}
+		delete[] row;
+	}
+
 	return true;
 }
 
 
-void tFileTGA::ReadColourBytes(tColouri& dest, const uint8* src, int bytesPerPixel)
+void tTGA::ReadColour(tColouri& dest, const uint8* src, int bytesPerPixel)
 {
 	switch (bytesPerPixel)
 	{
@@ -204,7 +271,7 @@ bool tFileTGA::Set(tPixel* pixels, int width, int height, bool steal)
 	}
 	else
 	{
-		Pixels = new tPixel[Width*Height];
+		Pixels = tPicture::AllocPixels(Width*Height);
 		tStd::tMemcpy(Pixels, pixels, Width*Height*sizeof(tPixel));
 	}
 	return true;
@@ -260,7 +327,7 @@ bool tFileTGA::SaveUncompressed(const tString& tgaFile, tFormat format) const
 	// imageDesc has the following important fields:
 	// Bits 0-3:	Number of attribute bits associated with each pixel. For a 16bit image, this would be 0 or 1. For a
 	//				24-bit image, it should be 0. For a 32-bit image, it should be 8.
-	// Bit 5:		Orientation. If set, the image is upside down.
+	// Bit 5:		Orientation. If set, the top row is first. Left clear since the pixels are stored bottom row first.
 	uint8 imageDesc = 0x00;
 	imageDesc |= (bitDepth == 24) ? 0 : 8;
 
@@ -316,7 +383,7 @@ bool tFileTGA::SaveCompressed(const tString& tgaFile, tFormat format) const
 	// imageDesc has the following important fields:
 	// Bits 0-3:	Number of attribute bits associated with each pixel. For a 16bit image, this would be 0 or 1. For a
 	//				24-bit image, it should be 0. For a 32-bit image, it should be 8.
-	// Bit 5:		Orientation. If set, the image is upside down.
+	// Bit 5:		Orientation. If set, the top row is first. Left clear since the pixels are stored bottom row first.
 	uint8 imageDesc = 0;
 	imageDesc |= (bitDepth == 24) ? 0 : 8;
 
@@ -432,6 +499,15 @@ bool tFileTGA::IsOpaque() const
 }
 
 
+void tFileTGA::Clear()
+{
+	Width = 0;
+	Height = 0;
+	tPicture::FreePixels(Pixels);
+	Pixels = nullptr;
+}
+
+
 tPixel* tFileTGA::StealPixels()
 {
 	tPixel* pixels = Pixels;
@@ -442,4 +518,392 @@ tPixel* tFileTGA::StealPixels()
 }
 
 
+bool tTGAWriter::Begin
+(
+	const tString& tgaFile, int width, int height, tFileTGA::tFormat format, tFileTGA::tCompression compression
+)
+{
+	Close();
+	if ((width <= 0) || (height <= 0) || (width > 0xFFFF) || (height > 0xFFFF))
+		return false;
+
+	if ((format != tFileTGA::tFormat::Bit24) && (format != tFileTGA::tFormat::Bit32))
+		return false;
+
+	File = tOpenFile(tgaFile.ConstText(), "wb");
+	if (!File)
+		return false;
+
+	Width = width;
+	Height = height;
+	BytesPerPixel = (format == tFileTGA::tFormat::Bit24) ? 3 : 4;
+	RLE = (compression == tFileTGA::tCompression::RLE);
+	RowsWritten = 0;
+	Error = false;
+	Buffer = new uint8[tTGA::BufferBytes];
+
+	// The same header as tFileTGA::Save writes except for the top-left origin.
+	tTGA::Header header;
+	tStd::tMemset(&header, 0, sizeof(header));
+	header.DataTypeCode = RLE ? 10 : 2;
+	header.Width = uint16(width);
+	header.Height = uint16(height);
+	header.BitDepth = int8(BytesPerPixel*8);
+	header.Orientation = int8(0x20 | ((BytesPerPixel == 4) ? 8 : 0));
+	tStd::tMemcpy(Buffer, &header, sizeof(header));
+	BufferUsed = sizeof(header);
+	return true;
+}
+
+
+bool tTGAWriter::Flush()
+{
+	if (BufferUsed > 0)
+	{
+		if (tWriteFile(File, Buffer, BufferUsed) != BufferUsed)
+			Error = true;
+		BufferUsed = 0;
+	}
+	return !Error;
+}
+
+
+inline void tTGAWriter::WriteColour(const tPixel& pixel)
+{
+	uint8* dest = Buffer + BufferUsed;
+	dest[0] = pixel.B;
+	dest[1] = pixel.G;
+	dest[2] = pixel.R;
+	if (BytesPerPixel == 4)
+		dest[3] = pixel.A;
+	BufferUsed += BytesPerPixel;
+}
+
+
+bool tTGAWriter::WriteRow(const tPixel* row)
+{
+	if (!File || Error || (RowsWritten >= Height) || !row)
+		return false;
+
+	// With 24 bits the alpha is not written, so it is ignored when looking for runs.
+	uint32 mask = (BytesPerPixel == 4) ? 0xFFFFFFFF : 0x00FFFFFF;
+	int x = 0;
+	while (x < Width)
+	{
+		if (BufferUsed + tTGA::MaxPacketBytes > tTGA::BufferBytes)
+			if (!Flush())
+				return false;
+
+		if (!RLE)
+		{
+			WriteColour(row[x++]);
+			continue;
+		}
+
+		// A run packet for two or more of the same colour. Otherwise a raw packet that stops where a run starts.
+		uint32 colour = row[x].BP & mask;
+		int run = 1;
+		while ((x + run < Width) && (run < 128) && ((row[x + run].BP & mask) == colour))
+			run++;
+
+		if (run > 1)
+		{
+			Buffer[BufferUsed++] = uint8(0x80 | (run - 1));
+			WriteColour(row[x]);
+			x += run;
+			continue;
+		}
+
+		int count = 1;
+		while ((x + count < Width) && (count < 128))
+		{
+			bool runStarts = (x + count + 1 < Width) && ((row[x + count].BP & mask) == (row[x + count + 1].BP & mask));
+			if (runStarts)
+				break;
+			count++;
+		}
+
+		Buffer[BufferUsed++] = uint8(count - 1);
+		for (int i = 0; i < count; i++)
+			WriteColour(row[x + i]);
+		x += count;
+	}
+
+	RowsWritten++;
+	return true;
+}
+
+
+bool tTGAWriter::End()
+{
+	if (!File)
+		return false;
+
+	bool ok = Flush() && (RowsWritten == Height);
+	Close();
+	return ok;
+}
+
+
+void tTGAWriter::Close()
+{
+	if (File)
+	{
+		tCloseFile(File);
+		File = nullptr;
+	}
+	delete[] Buffer;
+	Buffer = nullptr;
+	BufferUsed = 0;
+}
+
+
+bool tTGAReader::Begin(const tString& tgaFile)
+{
+	End();
+	File = tOpenFile(tgaFile.ConstText(), "rb");
+	if (!File)
+		return false;
+
+	Buffer = new uint8[tTGA::BufferBytes];
+	BufferOffset = 0;
+	BufferSize = 0;
+	BufferPos = 0;
+	if (!Available(sizeof(tTGA::Header)))
+	{
+		End();
+		return false;
+	}
+
+	tTGA::Header header;
+	tStd::tMemcpy(&header, Buffer, sizeof(header));
+	if (!tTGA::IsSupported(header))
+	{
+		End();
+		return false;
+	}
+
+	Width = header.Width;
+	Height = header.Height;
+	BitDepth = header.BitDepth;
+	Compressed = (header.DataTypeCode == 10);
+	TopDown = (header.Orientation & 0x20) ? true : false;
+	DataOffset = sizeof(header) + uint8(header.IDLength) + tTGA::GetColourMapBytes(header);
+	RowsRead = 0;
+	PacketLeft = 0;
+
+	bool ok = Seek(DataOffset);
+	if (ok && Compressed && !TopDown)
+		ok = BuildRowIndex();
+
+	if (!ok)
+	{
+		End();
+		return false;
+	}
+
+	return true;
+}
+
+
+bool tTGAReader::Available(int numBytes)
+{
+	if (BufferSize - BufferPos >= numBytes)
+		return true;
+
+	// Move what is left to the front and top up the buffer.
+	int remaining = BufferSize - BufferPos;
+	if (remaining > 0)
+		tStd::tMemmove(Buffer, Buffer + BufferPos, remaining);
+	BufferOffset += BufferPos;
+	BufferPos = 0;
+	BufferSize = remaining;
+
+	int numRead = tReadFile(File, Buffer + remaining, tTGA::BufferBytes - remaining);
+	if (numRead > 0)
+		BufferSize += numRead;
+
+	return BufferSize >= numBytes;
+}
+
+
+bool tTGAReader::Seek(int64 offset)
+{
+	// Seeks within the buffer don't touch the file.
+	int64 bufferEnd = BufferOffset + BufferSize;
+	if ((offset >= BufferOffset) && (offset <= bufferEnd))
+	{
+		BufferPos = int(offset - BufferOffset);
+		return true;
+	}
+
+	// The file position is always at the end of the buffer.
+	if (!tTGA::SeekRelative(File, offset - bufferEnd))
+		return false;
+
+	BufferOffset = offset;
+	BufferSize = 0;
+	BufferPos = 0;
+	return true;
+}
+
+
+bool tTGAReader::BuildRowIndex()
+{
+	RowOffsets = new int64[Height];
+	RowSkips = new int[Height];
+	int bytesPerPixel = BitDepth / 8;
+	int64 numPixels = int64(Width)*int64(Height);
+	int64 pixel = 0;
+	int row = 0;
+	while (pixel < numPixels)
+	{
+		int64 packetOffset = BufferOffset + BufferPos;
+		if (!Available(1))
+			return false;
+
+		int header = Buffer[BufferPos];
+		int count = (header & 0x7F) + 1;
+		int packetBytes = 1 + ((header & 0x80) ? 1 : count)*bytesPerPixel;
+
+		// Every row that starts inside this packet.
+		while ((row < Height) && (int64(row)*Width < pixel + count))
+		{
+			RowOffsets[row] = packetOffset;
+			RowSkips[row] = int(int64(row)*Width - pixel);
+			row++;
+		}
+
+		pixel += count;
+		if (!Seek(packetOffset + packetBytes))
+			return false;
+	}
+
+	return Seek(DataOffset);
+}
+
+
+bool tTGAReader::StartPacket()
+{
+	int bytesPerPixel = BitDepth / 8;
+	if (!Available(1 + bytesPerPixel))
+		return false;
+
+	int header = Buffer[BufferPos++];
+	PacketRun = (header & 0x80) ? true : false;
+	PacketLeft = (header & 0x7F) + 1;
+	if (PacketRun)
+	{
+		tTGA::ReadColour(RunColour, Buffer + BufferPos, bytesPerPixel);
+		BufferPos += bytesPerPixel;
+	}
+	return true;
+}
+
+
+bool tTGAReader::ReadPixels(tPixel* dest, int numPixels)
+{
+	int bytesPerPixel = BitDepth / 8;
+	if (!Compressed)
+	{
+		for (int p = 0; p < numPixels; p++)
+		{
+			if (!Available(bytesPerPixel))
+				return false;
+			tTGA::ReadColour(dest[p], Buffer + BufferPos, bytesPerPixel);
+			BufferPos += bytesPerPixel;
+		}
+		return true;
+	}
+
+	// Packets may carry on from one row to the next.
+	int p = 0;
+	while (p < numPixels)
+	{
+		if ((PacketLeft == 0) && !StartPacket())
+			return false;
+
+		int count = tMath::tMin(PacketLeft, numPixels - p);
+		if (PacketRun)
+		{
+			for (int i = 0; i < count; i++)
+				dest[p + i] = RunColour;
+		}
+		else
+		{
+			if (!Available(count*bytesPerPixel))
+				return false;
+			for (int i = 0; i < count; i++)
+				tTGA::ReadColour(dest[p + i], Buffer + BufferPos + i*bytesPerPixel, bytesPerPixel);
+			BufferPos += count*bytesPerPixel;
+		}
+
+		PacketLeft -= count;
+		p += count;
+	}
+	return true;
+}
+
+
+bool tTGAReader::ReadRow(tPixel* dest)
+{
+	if (!File || (RowsRead >= Height) || !dest)
+		return false;
+
+	// Bottom-up files seek to the row first. Top-down files just carry on from where the last row ended.
+	if (!TopDown)
+	{
+		int fileRow = Height - 1 - RowsRead;
+		int bytesPerPixel = BitDepth / 8;
+		if (!Compressed)
+		{
+			if (!Seek(DataOffset + int64(fileRow)*Width*bytesPerPixel))
+				return false;
+		}
+		else
+		{
+			// Skip the part of the packet that belongs to the row before.
+			PacketLeft = 0;
+			int skip = RowSkips[fileRow];
+			if (!Seek(RowOffsets[fileRow]) || !StartPacket())
+				return false;
+
+			PacketLeft -= skip;
+			if (!PacketRun && !Seek(BufferOffset + BufferPos + int64(skip)*bytesPerPixel))
+				return false;
+		}
+	}
+
+	if (!ReadPixels(dest, Width))
+		return false;
+
+	RowsRead++;
+	return true;
+}
+
+
+void tTGAReader::End()
+{
+	if (File)
+	{
+		tCloseFile(File);
+		File = nullptr;
+	}
+
+	delete[] Buffer;
+	Buffer = nullptr;
+	delete[] RowOffsets;
+	RowOffsets = nullptr;
+	delete[] RowSkips;
+	RowSkips = nullptr;
+	BufferOffset = 0;
+	BufferSize = 0;
+	BufferPos = 0;
+	Width = 0;
+	Height = 0;
+	RowsRead = 0;
+	PacketLeft = 0;
+}
+
+
 }
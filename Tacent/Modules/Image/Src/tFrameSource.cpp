@@ -0,0 +1,576 @@
+// tFrameSource.cpp
+//
+// A tFrameSource provides the frames of animated GIFs and multi-page images one at a time, decoding them on demand
+// rather than all up front. Animated GIFs are decoded natively so that frame disposal and compositing are correct and
+// so that playing forward only ever decodes one frame per step. A bounded ring of recently decoded frames and periodic
+// keyframe snapshots keep memory use fixed no matter how many frames the file has, while still allowing reasonably
+// fast seeking.
+//
+// Copyright (c) 2019 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include "Foundation/tStandard.h"
+#include "Math/tFundamentals.h"
+#include "Image/tFrameSource.h"
+using namespace tImage;
+using namespace tSystem;
+
+
+const float tFrameSource::DefaultFrameDuration = 0.1f;
+
+
+namespace tGIF
+{
+	// Frames larger than this many pixels are rejected. GIF dimensions are 16 bit so this only guards against
+	// corrupt headers asking for gigabytes.
+	const int64 MaxFramePixels = 1 << 28;
+
+	const int MaxCodes = 4096;
+
+	// Skips a sequence of data sub-blocks. Returns the offset after the terminator or -1 if the data runs out.
+	int SkipSubBlocks(const uint8* data, int size, int offset);
+	int ReadU16(const uint8* data)																						{ return data[0] | (data[1] << 8); }
+}
+
+
+int tGIF::SkipSubBlocks(const uint8* data, int size, int offset)
+{
+	while (offset < size)
+	{
+		int blockSize = data[offset++];
+		if (blockSize == 0)
+			return offset;
+		offset += blockSize;
+	}
+
+	return -1;
+}
+
+
+bool tFrameSource::Open(const tString& imageFile, int ringSize, int keyframeInterval)
+{
+	Close();
+	if (!tFileExists(imageFile))
+		return false;
+
+	Filename = imageFile;
+	if (tGetFileType(imageFile) == tFileType::GIF)
+	{
+		FileData = tLoadFile(imageFile, nullptr, &FileSize);
+		SourceType = tSourceType::GIF;
+		if (!FileData || !IndexGIF())
+		{
+			Close();
+			return false;
+		}
+
+		Init(ringSize, keyframeInterval);
+		return true;
+	}
+
+	// Everything else goes through tPicture one page at a time. We load the first page now so we know how many there
+	// are and so the first frame is ready right away.
+	tPicture* first = new tPicture;
+	if (!first->Load(imageFile, 0))
+	{
+		delete first;
+		Close();
+		return false;
+	}
+
+	SourceType = tSourceType::Pages;
+	Width = first->GetWidth();
+	Height = first->GetHeight();
+	NumFrames = first->SrcFileNumFrames;
+	Frames = new FrameInfo[NumFrames];
+	tStd::tMemset(Frames, 0, NumFrames*int(sizeof(FrameInfo)));
+	for (int f = 0; f < NumFrames; f++)
+		Frames[f].Duration = DefaultFrameDuration;
+	TotalDuration = float(NumFrames) * DefaultFrameDuration;
+
+	Init(ringSize, keyframeInterval);
+	tPicture* slot = GetRingSlot(0);
+	slot->Set(std::move(*first));
+	delete first;
+	NumDecodes++;
+	return true;
+}
+
+
+bool tFrameSource::Open(const uint8* gifData, int numBytes, int ringSize, int keyframeInterval)
+{
+	Close();
+	if (!gifData || (numBytes <= 0))
+		return false;
+
+	FileData = new uint8[numBytes];
+	FileSize = numBytes;
+	tStd::tMemcpy(FileData, gifData, numBytes);
+	SourceType = tSourceType::GIF;
+	if (!IndexGIF())
+	{
+		Close();
+		return false;
+	}
+
+	Init(ringSize, keyframeInterval);
+	return true;
+}
+
+
+void tFrameSource::Init(int ringSize, int keyframeInterval)
+{
+	RingSize = tMath::tMax(ringSize, 1);
+	Ring = new CachedFrame[RingSize];
+	RingNext = 0;
+
+	// Pages are independent so they never need keyframes.
+	if (SourceType == tSourceType::GIF)
+	{
+		KeyframeInterval = tMath::tMax(keyframeInterval, 1);
+		KeyframeInterval = tMath::tMax(KeyframeInterval, (NumFrames + MaxKeyframes - 1) / MaxKeyframes);
+		NumKeyframes = (NumFrames + KeyframeInterval - 1) / KeyframeInterval;
+		Keyframes = new tPicture[NumKeyframes];
+	}
+
+	CanvasFrame = -1;
+	NumDecodes = 0;
+}
+
+
+void tFrameSource::Close()
+{
+	delete[] FileData;
+	FileData = nullptr;
+	FileSize = 0;
+	Filename.Clear();
+	SourceType = tSourceType::None;
+
+	delete[] Frames;
+	Frames = nullptr;
+	NumFrames = 0;
+	Width = 0;
+	Height = 0;
+	TotalDuration = 0.0f;
+	GlobalPaletteOffset = -1;
+	GlobalPaletteSize = 0;
+
+	delete[] Ring;
+	Ring = nullptr;
+	RingSize = 0;
+	RingNext = 0;
+
+	delete[] Keyframes;
+	Keyframes = nullptr;
+	NumKeyframes = 0;
+
+	Canvas.Clear();
+	CanvasFrame = -1;
+	delete[] Indices;
+	Indices = nullptr;
+}
+
+
+bool tFrameSource::IndexGIF()
+{
+	const uint8* data = FileData;
+	int size = FileSize;
+	if ((size < 13) || tStd::tStrncmp((const char*)data, "GIF8", 4))
+		return false;
+
+	Width = tGIF::ReadU16(data + 6);
+	Height = tGIF::ReadU16(data + 8);
+	int flags = data[10];
+	int offset = 13;
+	if ((Width <= 0) || (Height <= 0))
+		return false;
+
+	if (flags & 0x80)
+	{
+		GlobalPaletteOffset = offset;
+		GlobalPaletteSize = 1 << ((flags & 0x07) + 1);
+		offset += 3*GlobalPaletteSize;
+	}
+
+	// First pass counts the frames so the frame array can be allocated exactly. The second fills it in.
+	int64 maxFramePixels = 0;
+	for (int pass = 0; pass < 2; pass++)
+	{
+		int pos = offset;
+		int numFrames = 0;
+
+		// Graphic control extension values apply to the next image only.
+		int transparentIndex = -1;
+		int disposal = 0;
+		int delay = -1;
+		while ((pos > 0) && (pos < size))
+		{
+			int blockType = data[pos++];
+			if (blockType == 0x3B)
+				break;
+
+			if (blockType == 0x21)
+			{
+				if (pos >= size)
+					break;
+
+				int label = data[pos++];
+				if ((label == 0xF9) && (pos + 5 < size) && (data[pos] >= 4))
+				{
+					int gceFlags = data[pos+1];
+					delay = tGIF::ReadU16(data + pos + 2);
+					transparentIndex = (gceFlags & 0x01) ? data[pos+4] : -1;
+					disposal = (gceFlags >> 2) & 0x07;
+				}
+				pos = tGIF::SkipSubBlocks(data, size, pos);
+				continue;
+			}
+
+			if ((blockType != 0x2C) || (pos + 9 > size))
+				break;
+
+			FrameInfo info;
+			info.Left = tGIF::ReadU16(data + pos);
+			info.Top = tGIF::ReadU16(data + pos + 2);
+			info.Width = tGIF::ReadU16(data + pos + 4);
+			info.Height = tGIF::ReadU16(data + pos + 6);
+			int imageFlags = data[pos+8];
+			pos += 9;
+
+			info.Interlaced = (imageFlags & 0x40) ? true : false;
+			info.TransparentIndex = transparentIndex;
+			info.Disposal = disposal;
+			info.PaletteOffset = -1;
+			info.PaletteSize = 0;
+			if (imageFlags & 0x80)
+			{
+				info.PaletteOffset = pos;
+				info.PaletteSize = 1 << ((imageFlags & 0x07) + 1);
+				pos += 3*info.PaletteSize;
+			}
+			info.DataOffset = pos;
+			info.Duration = (delay >= 2) ? float(delay) / 100.0f : DefaultFrameDuration;
+
+			if ((pos >= size) || ((info.PaletteOffset == -1) && (GlobalPaletteOffset == -1)))
+				break;
+
+			pos = tGIF::SkipSubBlocks(data, size, pos + 1);
+			int64 numPixels = int64(info.Width) * int64(info.Height);
+			if ((pos < 0) || (numPixels <= 0) || (numPixels > tGIF::MaxFramePixels))
+				break;
+
+			if (pass == 1)
+				Frames[numFrames] = info;
+			maxFramePixels = tMath::tMax(maxFramePixels, numPixels);
+			numFrames++;
+
+			transparentIndex = -1;
+			disposal = 0;
+			delay = -1;
+		}
+
+		if (numFrames == 0)
+			return false;
+
+		if (pass == 0)
+		{
+			NumFrames = numFrames;
+			Frames = new FrameInfo[NumFrames];
+		}
+	}
+
+	TotalDuration = 0.0f;
+	for (int f = 0; f < NumFrames; f++)
+		TotalDuration += Frames[f].Duration;
+
+	Indices = new uint8[maxFramePixels];
+	return true;
+}
+
+
+tPicture* tFrameSource::GetRingSlot(int frame)
+{
+	CachedFrame& slot = Ring[RingNext];
+	RingNext = (RingNext + 1) % RingSize;
+	slot.Frame = frame;
+	return &slot.Picture;
+}
+
+
+const tPicture* tFrameSource::GetFrame(int frame)
+{
+	if (!ValidFrame(frame))
+		return nullptr;
+
+	for (int r = 0; r < RingSize; r++)
+		if (Ring[r].Frame == frame)
+			return &Ring[r].Picture;
+
+	if (SourceType == tSourceType::Pages)
+	{
+		tPicture* slot = GetRingSlot(frame);
+		NumDecodes++;
+		if (!slot->Load(Filename, frame))
+		{
+			Ring[(RingNext + RingSize - 1) % RingSize].Frame = -1;
+			return nullptr;
+		}
+		return slot;
+	}
+
+	// Start from the closest keyframe at or before the frame unless we can just keep decoding forward from the current
+	// canvas. Keyframe 0 is always the blank canvas so it is never stored.
+	int key = tMath::tMin(frame / KeyframeInterval, NumKeyframes - 1);
+	while ((key > 0) && !Keyframes[key].IsValid())
+		key--;
+
+	int keyFrame = key*KeyframeInterval;
+	if ((CanvasFrame == -1) || (CanvasFrame > frame) || (CanvasFrame < keyFrame))
+	{
+		if (key == 0)
+			Canvas.Set(Width, Height, tPixel::transparent);
+		else
+			Canvas.Set(Keyframes[key]);
+		CanvasFrame = keyFrame;
+	}
+
+	tPicture* result = nullptr;
+	while (CanvasFrame <= frame)
+	{
+		int f = CanvasFrame;
+		int k = f / KeyframeInterval;
+		if ((k > 0) && (f == k*KeyframeInterval) && !Keyframes[k].IsValid())
+			Keyframes[k].Set(Canvas);
+
+		const FrameInfo& info = Frames[f];
+		if (info.Disposal == 3)
+		{
+			// Restore-to-previous leaves the canvas as it was, so intermediate frames of this type needn't be decoded.
+			if (f == frame)
+			{
+				result = GetRingSlot(f);
+				result->Set(Canvas);
+				DecodeGIFFrame(f, *result);
+			}
+		}
+		else
+		{
+			DecodeGIFFrame(f, Canvas);
+			if (f == frame)
+			{
+				result = GetRingSlot(f);
+				result->Set(Canvas);
+			}
+
+			// Restore-to-background. Browsers clear to transparent rather than the background colour and so do we.
+			if (info.Disposal == 2)
+			{
+				for (int y = tMath::tMax(info.Top, 0); y < tMath::tMin(info.Top + info.Height, Height); y++)
+					for (int x = tMath::tMax(info.Left, 0); x < tMath::tMin(info.Left + info.Width, Width); x++)
+						Canvas.SetPixel(x, Height - 1 - y, tPixel::transparent);
+			}
+		}
+
+		CanvasFrame++;
+	}
+
+	return result;
+}
+
+
+bool tFrameSource::DecodeGIFFrame(int frame, tPicture& canvas)
+{
+	const FrameInfo& info = Frames[frame];
+	NumDecodes++;
+
+	int numPixels = info.Width * info.Height;
+	tStd::tMemset(Indices, 0, numPixels);
+	bool success = DecompressGIFFrame(info, Indices);
+
+	int paletteOffset = (info.PaletteOffset != -1) ? info.PaletteOffset : GlobalPaletteOffset;
+	int paletteSize = (info.PaletteOffset != -1) ? info.PaletteSize : GlobalPaletteSize;
+	const uint8* palette = FileData + paletteOffset;
+	if (paletteOffset + 3*paletteSize > FileSize)
+		return false;
+
+	// Interlaced images store every 8th row starting at 0, then every 8th from 4, every 4th from 2, and every 2nd
+	// from 1. The decode row is mapped back to the frame row here.
+	const int passStart[4] = { 0, 4, 2, 1 };
+	const int passStep[4] = { 8, 8, 4, 2 };
+	int pass = 0;
+	int frameRow = 0;
+	for (int row = 0; row < info.Height; row++)
+	{
+		if (info.Interlaced)
+		{
+			while ((pass < 4) && (frameRow >= info.Height))
+			{
+				pass++;
+				frameRow = (pass < 4) ? passStart[pass] : info.Height;
+			}
+		}
+		else
+		{
+			frameRow = row;
+		}
+
+		// GIF rows go top to bottom and tPicture rows bottom to top.
+		int y = info.Top + frameRow;
+		if ((y >= 0) && (y < Height))
+		{
+			const uint8* src = Indices + row*info.Width;
+			tPixel* dest = canvas.GetPixelPointer(0, Height - 1 - y);
+			int x0 = tMath::tMax(info.Left, 0);
+			int x1 = tMath::tMin(info.Left + info.Width, Width);
+			for (int x = x0; x < x1; x++)
+			{
+				int index = src[x - info.Left];
+				if ((index == info.TransparentIndex) || (index >= paletteSize))
+					continue;
+
+				const uint8* entry = palette + 3*index;
+				dest[x] = tPixel(entry[0], entry[1], entry[2], uint8(0xFF));
+			}
+		}
+
+		if (info.Interlaced)
+			frameRow += passStep[pass];
+	}
+
+	return success;
+}
+
+
+bool tFrameSource::DecompressGIFFrame(const FrameInfo& info, uint8* indices)
+{
+	const uint8* data = FileData;
+	int pos = info.DataOffset;
+	int minCodeSize = data[pos++];
+	if ((minCodeSize < 1) || (minCodeSize > 11))
+		return false;
+
+	uint16 prefix[tGIF::MaxCodes];
+	uint8 suffix[tGIF::MaxCodes];
+	uint8 stack[tGIF::MaxCodes + 1];
+	int clearCode = 1 << minCodeSize;
+	int endCode = clearCode + 1;
+	for (int c = 0; c < clearCode; c++)
+	{
+		prefix[c] = 0;
+		suffix[c] = uint8(c);
+	}
+
+	int codeSize = minCodeSize + 1;
+	int nextCode = clearCode + 2;
+	int prevCode = -1;
+	int firstChar = 0;
+
+	// The code stream is split across sub-blocks of up to 255 bytes.
+	uint32 bitBuffer = 0;
+	int numBits = 0;
+	int blockRemaining = 0;
+
+	int numPixels = info.Width * info.Height;
+	int outIndex = 0;
+	while (outIndex < numPixels)
+	{
+		while (numBits < codeSize)
+		{
+			if (blockRemaining == 0)
+			{
+				if (pos >= FileSize)
+					return false;
+				blockRemaining = data[pos++];
+				if (blockRemaining == 0)
+					return false;
+			}
+			if (pos >= FileSize)
+				return false;
+
+			bitBuffer |= uint32(data[pos++]) << numBits;
+			numBits += 8;
+			blockRemaining--;
+		}
+
+		int code = bitBuffer & ((1 << codeSize) - 1);
+		bitBuffer >>= codeSize;
+		numBits -= codeSize;
+
+		if (code == clearCode)
+		{
+			codeSize = minCodeSize + 1;
+			nextCode = clearCode + 2;
+			prevCode = -1;
+			continue;
+		}
+
+		if (code == endCode)
+			break;
+
+		if (prevCode == -1)
+		{
+			if (code > clearCode)
+				return false;
+			indices[outIndex++] = uint8(code);
+			prevCode = code;
+			firstChar = code;
+			continue;
+		}
+
+		// The code not yet in the table case (KwKwK) is the previous string plus its own first character.
+		int inCode = code;
+		int stackSize = 0;
+		if (code >= nextCode)
+		{
+			if (code > nextCode)
+				return false;
+			stack[stackSize++] = uint8(firstChar);
+			code = prevCode;
+		}
+
+		while (code > endCode)
+		{
+			stack[stackSize++] = suffix[code];
+			code = prefix[code];
+		}
+		firstChar = suffix[code];
+		stack[stackSize++] = uint8(firstChar);
+
+		if (nextCode < tGIF::MaxCodes)
+		{
+			prefix[nextCode] = uint16(prevCode);
+			suffix[nextCode] = uint8(firstChar);
+			nextCode++;
+			if ((nextCode == (1 << codeSize)) && (codeSize < 12))
+				codeSize++;
+		}
+
+		while ((stackSize > 0) && (outIndex < numPixels))
+			indices[outIndex++] = stack[--stackSize];
+
+		prevCode = inCode;
+	}
+
+	return true;
+}
+
+
+int64 tFrameSource::GetMemoryUsage() const
+{
+	int64 numBytes = FileSize;
+	for (int r = 0; r < RingSize; r++)
+		numBytes += int64(Ring[r].Picture.GetNumPixels()) * int64(sizeof(tPixel));
+
+	for (int k = 0; k < NumKeyframes; k++)
+		numBytes += int64(Keyframes[k].GetNumPixels()) * int64(sizeof(tPixel));
+
+	numBytes += int64(Canvas.GetNumPixels()) * int64(sizeof(tPixel));
+	return numBytes;
+}
@@ -0,0 +1,539 @@
+// tImageProbe.cpp
+//
+// Reads the metadata of an image file without decoding it. Only the start of the file is read and the format is
+// identified by its magic bytes, not its extension. Supports tga, png, jpg, bmp, gif, qoi, and dds files, including dds
+// files with the DX10 extended header. This is much faster than loading when all that's needed are the dimensions,
+// pixel format, bit depth, mipmap count, or frame count of a lot of files.
+//
+// Copyright (c) 2020 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <Foundation/tStandard.h>
+#include "Image/tImageProbe.h"
+#include "Image/tFileDDS.h"
+#include "Image/tFileJPG.h"
+#include "Image/tLayer.h"
+using namespace tSystem;
+namespace tImage
+{
+
+
+namespace tProbe
+{
+	// The most of a file that will be read when a header runs past the first ProbeHeadSize bytes.
+	const int MaxHeadSize = 256*1024;
+
+	inline uint16 Get16LE(const uint8* p)																				{ return uint16(p[0] | (p[1] << 8)); }
+	inline uint32 Get32LE(const uint8* p)																				{ return uint32(p[0] | (p[1] << 8) | (p[2] << 16) | (uint32(p[3]) << 24)); }
+	inline uint16 Get16BE(const uint8* p)																				{ return uint16((p[0] << 8) | p[1]); }
+	inline uint32 Get32BE(const uint8* p)																				{ return uint32((uint32(p[0]) << 24) | (p[1] << 16) | (p[2] << 8) | p[3]); }
+
+	bool IsTGA(const uint8* data, int numBytes);
+	bool IsJPGStartOfFrame(uint8 marker);
+
+	// Each of these returns false if the header isn't valid or is cut short, setting needMore in the second case. They
+	// may also set needMore while returning true if an optional part, like the png transparency chunk, was cut short.
+	bool ProbeTGA(tImageInfo&, const uint8* data, int numBytes, bool& needMore);
+	bool ProbePNG(tImageInfo&, const uint8* data, int numBytes, bool& needMore);
+	bool ProbeJPG(tImageInfo&, const uint8* data, int numBytes, bool& needMore);
+	bool ProbeBMP(tImageInfo&, const uint8* data, int numBytes, bool& needMore);
+	bool ProbeGIF(tImageInfo&, const uint8* data, int numBytes, bool& needMore);
+	bool ProbeQOI(tImageInfo&, const uint8* data, int numBytes, bool& needMore);
+	bool ProbeDDS(tImageInfo&, const uint8* data, int numBytes, bool& needMore);
+}
+
+
+bool tProbe::IsTGA(const uint8* data, int numBytes)
+{
+	if (numBytes < 18)
+		return false;
+
+	int colourMapType = data[1];
+	int imageType = data[2];
+	int width = Get16LE(data + 12);
+	int height = Get16LE(data + 14);
+	int bitDepth = data[16];
+	int descriptor = data[17];
+	if ((colourMapType != 0) && (colourMapType != 1))
+		return false;
+
+	// Colour mapped, true colour, and greyscale, each either raw or run length encoded.
+	switch (imageType)
+	{
+		case 1: case 2: case 3: case 9: case 10: case 11:
+			break;
+
+		default:
+			return false;
+	}
+
+	if ((bitDepth != 8) && (bitDepth != 15) && (bitDepth != 16) && (bitDepth != 24) && (bitDepth != 32))
+		return false;
+
+	// The top two descriptor bits are for interleaving, which nobody uses, so a set bit means this isn't a tga.
+	return (width > 0) && (height > 0) && !(descriptor & 0xC0);
+}
+
+
+bool tProbe::IsJPGStartOfFrame(uint8 marker)
+{
+	// C4 is a huffman table, C8 is reserved, and CC is an arithmetic coding table.
+	return (marker >= 0xC0) && (marker <= 0xCF) && (marker != 0xC4) && (marker != 0xC8) && (marker != 0xCC);
+}
+
+
+bool tProbe::ProbeTGA(tImageInfo& info, const uint8* data, int numBytes, bool& needMore)
+{
+	if (numBytes < 18)
+	{
+		needMore = true;
+		return false;
+	}
+
+	info.Width = Get16LE(data + 12);
+	info.Height = Get16LE(data + 14);
+	info.BitDepth = data[16];
+
+	// The low descriptor bits are the number of alpha bits. Plenty of 32 bit files leave them at zero.
+	int alphaBits = data[17] & 0x0F;
+	info.Opaque = !alphaBits && (info.BitDepth != 32);
+	return true;
+}
+
+
+bool tProbe::ProbePNG(tImageInfo& info, const uint8* data, int numBytes, bool& needMore)
+{
+	// The IHDR chunk must come first.
+	if (numBytes < 33)
+	{
+		needMore = true;
+		return false;
+	}
+
+	if ((Get32BE(data + 8) != 13) || tStd::tMemcmp(data + 12, "IHDR", 4))
+		return false;
+
+	info.Width = int(Get32BE(data + 16));
+	info.Height = int(Get32BE(data + 20));
+	int bitDepth = data[24];
+	int colourType = data[25];
+	int channels = 0;
+	switch (colourType)
+	{
+		case 0:	channels = 1;	break;					// Grey.
+		case 2:	channels = 3;	break;					// RGB.
+		case 3:	channels = 1;	break;					// Palette.
+		case 4:	channels = 2;	break;					// Grey and alpha.
+		case 6:	channels = 4;	break;					// RGBA.
+		default:
+			return false;
+	}
+	info.BitDepth = bitDepth * channels;
+	info.Opaque = (colourType != 4) && (colourType != 6);
+
+	// The transparency and animation control chunks must come before the image data, so we walk the chunks up to it.
+	int offset = 33;
+	while (true)
+	{
+		if (offset + 8 > numBytes)
+		{
+			needMore = true;
+			break;
+		}
+
+		uint32 length = Get32BE(data + offset);
+		const uint8* type = data + offset + 4;
+		if (!tStd::tMemcmp(type, "IDAT", 4) || !tStd::tMemcmp(type, "IEND", 4))
+			break;
+
+		if (!tStd::tMemcmp(type, "tRNS", 4))
+			info.Opaque = false;
+
+		if (!tStd::tMemcmp(type, "acTL", 4))
+		{
+			if (offset + 12 > numBytes)
+			{
+				needMore = true;
+				break;
+			}
+			info.NumFrames = int(Get32BE(data + offset + 8));
+		}
+
+		if (length > uint32(0x7FFFFFFF - 12 - offset))
+			break;
+		offset += 12 + int(length);
+	}
+
+	return true;
+}
+
+
+bool tProbe::ProbeJPG(tImageInfo& info, const uint8* data, int numBytes, bool& needMore)
+{
+	// We walk the segments until the start of frame, which has the dimensions.
+	int offset = 2;
+	while (true)
+	{
+		// Any number of 0xFF fill bytes may come before a marker.
+		while ((offset < numBytes) && (data[offset] == 0xFF) && (offset+1 < numBytes) && (data[offset+1] == 0xFF))
+			offset++;
+
+		if (offset + 4 > numBytes)
+		{
+			needMore = true;
+			return false;
+		}
+
+		if (data[offset] != 0xFF)
+			return false;
+
+		uint8 marker = data[offset+1];
+
+		// These markers have no length.
+		if ((marker == 0x01) || ((marker >= 0xD0) && (marker <= 0xD8)))
+		{
+			offset += 2;
+			continue;
+		}
+
+		// If we reach the scan or the end of the image there was no start of frame.
+		if ((marker == 0xDA) || (marker == 0xD9))
+			return false;
+
+		int length = Get16BE(data + offset + 2);
+		if (IsJPGStartOfFrame(marker))
+		{
+			if (offset + 10 > numBytes)
+			{
+				needMore = true;
+				return false;
+			}
+
+			// The exif block comes before the start of frame, so all of it has been read. The size is reported the way
+			// tPicture::Load turns the image.
+			int precision = data[offset+4];
+			info.Height = Get16BE(data + offset + 5);
+			info.Width = Get16BE(data + offset + 7);
+			if (tFileJPG::IsTransposing(tFileJPG::ReadOrientation(data, offset)))
+				tStd::tSwap(info.Width, info.Height);
+			info.BitDepth = precision * data[offset+9];
+			info.Opaque = true;
+			return true;
+		}
+
+		if (length < 2)
+			return false;
+		offset += 2 + length;
+	}
+
+	return false;
+}
+
+
+bool tProbe::ProbeBMP(tImageInfo& info, const uint8* data, int numBytes, bool& needMore)
+{
+	if (numBytes < 26)
+	{
+		needMore = true;
+		return false;
+	}
+
+	int dibSize = int(Get32LE(data + 14));
+	if (dibSize == 12)
+	{
+		// The old OS/2 core header uses 16 bit dimensions.
+		info.Width = Get16LE(data + 18);
+		info.Height = Get16LE(data + 20);
+		info.BitDepth = Get16LE(data + 24);
+		info.Opaque = true;
+		return true;
+	}
+
+	if (dibSize < 40)
+		return false;
+
+	if (numBytes < 14 + 40)
+	{
+		needMore = true;
+		return false;
+	}
+
+	// A negative height means the rows are stored top to bottom.
+	info.Width = int(Get32LE(data + 18));
+	info.Height = tMath::tAbs(int(Get32LE(data + 22)));
+	info.BitDepth = Get16LE(data + 28);
+
+	// Only the V3 and later headers have an alpha mask.
+	info.Opaque = true;
+	if ((dibSize >= 56) && ((info.BitDepth == 16) || (info.BitDepth == 32)))
+	{
+		if (numBytes < 14 + 56)
+		{
+			needMore = true;
+			return true;
+		}
+		info.Opaque = Get32LE(data + 14 + 52) ? false : true;
+	}
+
+	return true;
+}
+
+
+bool tProbe::ProbeGIF(tImageInfo& info, const uint8* data, int numBytes, bool& needMore)
+{
+	if (numBytes < 13)
+	{
+		needMore = true;
+		return false;
+	}
+
+	info.Width = Get16LE(data + 6);
+	info.Height = Get16LE(data + 8);
+	uint8 packed = data[10];
+	info.BitDepth = (packed & 0x07) + 1;
+	info.Opaque = true;
+	info.NumFrames = 0;
+
+	int offset = 13;
+	if (packed & 0x80)
+		offset += 3 * (1 << info.BitDepth);
+
+	// Walk the blocks counting frames and looking for transparency in the graphic control extensions. Each block ends
+	// with a chain of sub-blocks that we skip.
+	int numFrames = 0;
+	while (true)
+	{
+		if (offset >= numBytes)
+			break;
+
+		uint8 introducer = data[offset];
+		if (introducer == 0x3B)
+		{
+			info.NumFrames = numFrames;
+			return true;
+		}
+
+		if (introducer == 0x21)
+		{
+			if (offset + 2 > numBytes)
+				break;
+
+			uint8 label = data[offset+1];
+			if ((label == 0xF9) && (offset + 4 <= numBytes) && (data[offset+3] & 0x01))
+				info.Opaque = false;
+			offset += 2;
+		}
+		else if (introducer == 0x2C)
+		{
+			if (offset + 11 > numBytes)
+				break;
+
+			uint8 localPacked = data[offset+9];
+			offset += 10;
+			if (localPacked & 0x80)
+				offset += 3 * (1 << ((localPacked & 0x07) + 1));
+
+			// The LZW minimum code size.
+			offset++;
+			numFrames++;
+		}
+		else
+		{
+			// Anything else means the file is corrupt, but we already have the screen size.
+			return true;
+		}
+
+		// Skip the sub-blocks.
+		while ((offset < numBytes) && data[offset])
+			offset += data[offset] + 1;
+		offset++;
+	}
+
+	// If the data ends before the first frame we haven't seen its transparency. The frame count needs the whole file
+	// so we don't ask for more just for that.
+	if (numFrames == 0)
+		needMore = true;
+	return true;
+}
+
+
+bool tProbe::ProbeQOI(tImageInfo& info, const uint8* data, int numBytes, bool& needMore)
+{
+	if (numBytes < 14)
+	{
+		needMore = true;
+		return false;
+	}
+
+	info.Width = int(Get32BE(data + 4));
+	info.Height = int(Get32BE(data + 8));
+	int channels = data[12];
+	if ((channels != 3) && (channels != 4))
+		return false;
+
+	info.BitDepth = channels * 8;
+	info.Opaque = (channels == 3);
+	return true;
+}
+
+
+bool tProbe::ProbeDDS(tImageInfo& info, const uint8* data, int numBytes, bool& needMore)
+{
+	// The DX10 extended header makes the whole header 148 bytes.
+	if (numBytes < 148)
+	{
+		needMore = true;
+		if (numBytes < 128)
+			return false;
+	}
+
+	tPixelFormat format = tPixelFormat::Invalid;
+	if (!tFileDDS::ReadHeader(data, numBytes, format, info.Width, info.Height, info.NumMipmaps, info.Cubemap))
+		return false;
+
+	needMore = false;
+	info.PixelFormat = format;
+	if (tIsNormalFormat(format))
+		info.BitDepth = tGetBytesPerPixel(format) * 8;
+	else if (tIsBlockFormat(format))
+		info.BitDepth = tGetBytesPer4x4PixelBlock(format) / 2;
+
+	// Same rule a tTexture uses.
+	tLayer layer;
+	layer.PixelFormat = format;
+	info.Opaque = layer.IsOpaqueFormat();
+	return true;
+}
+
+
+tFileType tIdentifyImage(const uint8* data, int numBytes)
+{
+	if (!data || (numBytes < 2))
+		return tFileType::Unknown;
+
+	const uint8 pngMagic[] = { 0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A };
+	if ((numBytes >= 8) && !tStd::tMemcmp(data, pngMagic, 8))
+		return tFileType::PNG;
+
+	if ((numBytes >= 3) && (data[0] == 0xFF) && (data[1] == 0xD8) && (data[2] == 0xFF))
+		return tFileType::JPG;
+
+	if ((numBytes >= 6) && (!tStd::tMemcmp(data, "GIF87a", 6) || !tStd::tMemcmp(data, "GIF89a", 6)))
+		return tFileType::GIF;
+
+	if ((numBytes >= 4) && !tStd::tMemcmp(data, "DDS ", 4))
+		return tFileType::DDS;
+
+	if ((numBytes >= 4) && !tStd::tMemcmp(data, "qoif", 4))
+		return tFileType::QOI;
+
+	// Two letters is a weak magic, so the rest of the file header needs to look right too.
+	if ((numBytes >= 14) && (data[0] == 'B') && (data[1] == 'M') && !tProbe::Get32LE(data + 6))
+		return tFileType::BMP;
+
+	if (tProbe::IsTGA(data, numBytes))
+		return tFileType::TGA;
+
+	return tFileType::Unknown;
+}
+
+
+bool tProbeImage(tImageInfo& info, const uint8* data, int numBytes, bool* needMore)
+{
+	info = tImageInfo();
+	if (needMore)
+		*needMore = false;
+
+	tFileType fileType = tIdentifyImage(data, numBytes);
+	bool more = false;
+	bool success = false;
+	switch (fileType)
+	{
+		case tFileType::TGA:	success = tProbe::ProbeTGA(info, data, numBytes, more);		break;
+		case tFileType::PNG:	success = tProbe::ProbePNG(info, data, numBytes, more);		break;
+		case tFileType::JPG:	success = tProbe::ProbeJPG(info, data, numBytes, more);		break;
+		case tFileType::BMP:	success = tProbe::ProbeBMP(info, data, numBytes, more);		break;
+		case tFileType::GIF:	success = tProbe::ProbeGIF(info, data, numBytes, more);		break;
+		case tFileType::QOI:	success = tProbe::ProbeQOI(info, data, numBytes, more);		break;
+		case tFileType::DDS:	success = tProbe::ProbeDDS(info, data, numBytes, more);		break;
+		default:
+			break;
+	}
+
+	if (needMore)
+		*needMore = more;
+
+	if (!success || (info.Width <= 0) || (info.Height <= 0))
+	{
+		info = tImageInfo();
+		return false;
+	}
+
+	info.FileType = fileType;
+	if (fileType != tFileType::DDS)
+		info.PixelFormat = info.Opaque ? tPixelFormat::R8G8B8 : tPixelFormat::R8G8B8A8;
+
+	return true;
+}
+
+
+bool tProbeImage(tImageInfo& info, const tString& imageFile, bool countGIFFrames)
+{
+	info = tImageInfo();
+
+	// We read more of the file, up to a limit, only if the header runs past what we have. If the optional parts of a
+	// header still don't fit, the last successful probe is used.
+	uint8 headBuffer[ProbeHeadSize];
+	uint8* head = headBuffer;
+	int headSize = ProbeHeadSize;
+	bool success = false;
+	while (true)
+	{
+		int numRead = headSize;
+		if (!tLoadFileHead(imageFile, numRead, head) || (numRead <= 0))
+			break;
+
+		tImageInfo probed;
+		bool needMore = false;
+		if (tProbeImage(probed, head, numRead, &needMore))
+		{
+			info = probed;
+			success = true;
+		}
+
+		// Reading fewer bytes than asked for means we have the whole file.
+		if (!needMore || (numRead < headSize) || (headSize >= tProbe::MaxHeadSize))
+			break;
+
+		if (head != headBuffer)
+			delete[] head;
+		headSize = tMath::tMin(headSize * 4, tProbe::MaxHeadSize);
+		head = new uint8[headSize];
+	}
+
+	if (head != headBuffer)
+		delete[] head;
+
+	// Gif frames can only be counted by walking the whole file.
+	if (success && countGIFFrames && (info.FileType == tFileType::GIF) && (info.NumFrames == 0))
+	{
+		int numBytes = 0;
+		uint8* data = tLoadFile(imageFile, nullptr, &numBytes);
+		tImageInfo probed;
+		if (data && tProbeImage(probed, data, numBytes))
+			info = probed;
+		delete[] data;
+	}
+
+	return success;
+}
+
+
+}
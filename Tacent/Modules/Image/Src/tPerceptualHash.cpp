@@ -0,0 +1,466 @@
+// tPerceptualHash.cpp
+//
+// Perceptual hashes of images and a Hamming-distance index for finding near-duplicates. Unlike a cryptographic hash,
+// images that look alike get hashes that differ in only a few bits, so re-saved, slightly cropped, rescaled or
+// re-encoded copies of the same image can be found by searching for hashes within a small Hamming distance.
+//
+// Copyright (c) 2019 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <math.h>
+#include "Foundation/tStandard.h"
+#include "Foundation/tSort.h"
+#include "Math/tFundamentals.h"
+#include "System/tMachine.h"
+#include "Image/tPerceptualHash.h"
+using namespace tImage;
+
+
+namespace tPHash
+{
+	const int DCTSize = 32;
+	const int DCTKeep = 8;
+
+	// Fills a gw by gh grid with the average luminance of the source pixels that fall in each cell. Every source pixel
+	// contributes to exactly one cell, so the cost is one pass over the image no matter how large it is. If the source
+	// is smaller than the grid, cells repeat the nearest pixel.
+	void Downsample(float* grid, int gw, int gh, const tPictureView&);
+	uint64 ComputeDHash(const tPictureView&);
+	uint64 ComputePHash(const tPictureView&);
+
+	// Appends value and every value that differs from it in at most flipsLeft of the bits at or above firstBit. Each
+	// value is produced once. With firstBit 0 and 16-bit values this is at most 65536 values.
+	void EnumerateNeighbours(int* values, int& count, int value, int firstBit, int flipsLeft);
+
+	// Union-find with path halving. Used to merge chains of near matches into clusters.
+	int FindRoot(int* parents, int i);
+}
+
+
+void tPHash::Downsample(float* grid, int gw, int gh, const tPictureView& view)
+{
+	int width = view.GetWidth();
+	int height = view.GetHeight();
+	for (int cy = 0; cy < gh; cy++)
+	{
+		int y0 = cy*height / gh;
+		int y1 = tMath::tMax((cy+1)*height / gh, y0+1);
+		for (int cx = 0; cx < gw; cx++)
+		{
+			int x0 = cx*width / gw;
+			int x1 = tMath::tMax((cx+1)*width / gw, x0+1);
+
+			// Same Rec. 709 integer weights as tPictureStats.
+			uint64 sum = 0;
+			for (int y = y0; y < y1; y++)
+			{
+				const tPixel* row = view.GetRow(y);
+				for (int x = x0; x < x1; x++)
+					sum += 54*row[x].R + 183*row[x].G + 19*row[x].B;
+			}
+
+			grid[cy*gw + cx] = float(double(sum) / (256.0 * double((x1-x0)*(y1-y0))));
+		}
+	}
+}
+
+
+uint64 tPHash::ComputeDHash(const tPictureView& view)
+{
+	float grid[9*8];
+	Downsample(grid, 9, 8, view);
+
+	uint64 hash = 0;
+	for (int y = 0; y < 8; y++)
+		for (int x = 0; x < 8; x++)
+			if (grid[y*9 + x + 1] > grid[y*9 + x])
+				hash |= 1ULL << (y*8 + x);
+
+	return hash;
+}
+
+
+uint64 tPHash::ComputePHash(const tPictureView& view)
+{
+	float grid[DCTSize*DCTSize];
+	Downsample(grid, DCTSize, DCTSize, view);
+
+	// Separable DCT-II. We only need the first DCTKeep+1 frequencies in each direction.
+	const int numFreq = DCTKeep + 1;
+	float cosTable[numFreq][DCTSize];
+	for (int u = 0; u < numFreq; u++)
+		for (int x = 0; x < DCTSize; x++)
+			cosTable[u][x] = float(cos(double((2*x + 1)*u) * tMath::Pi / double(2*DCTSize)));
+
+	float rows[DCTSize][numFreq];
+	for (int y = 0; y < DCTSize; y++)
+	{
+		for (int u = 0; u < numFreq; u++)
+		{
+			float sum = 0.0f;
+			for (int x = 0; x < DCTSize; x++)
+				sum += grid[y*DCTSize + x] * cosTable[u][x];
+			rows[y][u] = sum;
+		}
+	}
+
+	// The DC row and column only carry average brightness and are skipped.
+	float coeffs[DCTKeep*DCTKeep];
+	for (int v = 1; v < numFreq; v++)
+	{
+		for (int u = 1; u < numFreq; u++)
+		{
+			float sum = 0.0f;
+			for (int y = 0; y < DCTSize; y++)
+				sum += rows[y][u] * cosTable[v][y];
+			coeffs[(v-1)*DCTKeep + (u-1)] = sum;
+		}
+	}
+
+	float sorted[DCTKeep*DCTKeep];
+	tStd::tMemcpy(sorted, coeffs, int(sizeof(coeffs)));
+	tSort::tInsertion(sorted, DCTKeep*DCTKeep);
+	float median = 0.5f * (sorted[DCTKeep*DCTKeep/2 - 1] + sorted[DCTKeep*DCTKeep/2]);
+
+	uint64 hash = 0;
+	for (int c = 0; c < DCTKeep*DCTKeep; c++)
+		if (coeffs[c] > median)
+			hash |= 1ULL << c;
+
+	return hash;
+}
+
+
+void tPHash::EnumerateNeighbours(int* values, int& count, int value, int firstBit, int flipsLeft)
+{
+	values[count++] = value;
+	if (flipsLeft <= 0)
+		return;
+
+	for (int bit = firstBit; bit < 16; bit++)
+		EnumerateNeighbours(values, count, value ^ (1 << bit), bit+1, flipsLeft-1);
+}
+
+
+int tPHash::FindRoot(int* parents, int i)
+{
+	while (parents[i] != i)
+	{
+		parents[i] = parents[parents[i]];
+		i = parents[i];
+	}
+	return i;
+}
+
+
+bool tPerceptualHash::Set(const tPicture& picture)
+{
+	if (!picture.IsValid())
+	{
+		Clear();
+		return false;
+	}
+
+	return Set(picture.GetView());
+}
+
+
+bool tPerceptualHash::Set(const tPictureView& view)
+{
+	Clear();
+	if (!view.IsValid())
+		return false;
+
+	DHash = tPHash::ComputeDHash(view);
+	PHash = tPHash::ComputePHash(view);
+	Valid = true;
+	return true;
+}
+
+
+void tPerceptualHash::Save(tChunkWriter& chunk) const
+{
+	chunk.Begin(tChunkID::Image_PerceptualHash);
+	{
+		chunk.Write(DHash);
+		chunk.Write(PHash);
+	}
+	chunk.End();
+}
+
+
+void tPerceptualHash::Load(const tChunk& chunk)
+{
+	Clear();
+	if (chunk.ID() != tChunkID::Image_PerceptualHash)
+		return;
+
+	chunk.GetItem(DHash);
+	chunk.GetItem(PHash);
+	Valid = true;
+}
+
+
+int tImage::tHammingDistance(uint64 a, uint64 b)
+{
+	// Portable population count of the differing bits.
+	uint64 v = a ^ b;
+	v = v - ((v >> 1) & 0x5555555555555555ULL);
+	v = (v & 0x3333333333333333ULL) + ((v >> 2) & 0x3333333333333333ULL);
+	v = (v + (v >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+	return int((v * 0x0101010101010101ULL) >> 56);
+}
+
+
+void tHashIndex::ClearTables() const
+{
+	for (int b = 0; b < NumBlocks; b++)
+	{
+		delete[] BucketStarts[b];
+		delete[] BucketEntries[b];
+		delete[] BucketHashes[b];
+		BucketStarts[b] = nullptr;
+		BucketEntries[b] = nullptr;
+		BucketHashes[b] = nullptr;
+	}
+	TablesDirty = false;
+}
+
+
+void tHashIndex::BuildTables() const
+{
+	ClearTables();
+	int numEntries = Entries.GetNumElements();
+	const Entry* entries = Entries.GetElements();
+
+	// A counting sort of the entries by block value, done once for each block.
+	for (int b = 0; b < NumBlocks; b++)
+	{
+		int* starts = new int[NumBuckets+1];
+		int* bucketEntries = new int[tMath::tMax(numEntries, 1)];
+		uint64* bucketHashes = new uint64[tMath::tMax(numEntries, 1)];
+		tStd::tMemset(starts, 0, (NumBuckets+1)*int(sizeof(int)));
+		for (int e = 0; e < numEntries; e++)
+			starts[GetBlock(entries[e].Hash, b) + 1]++;
+
+		for (int v = 0; v < NumBuckets; v++)
+			starts[v+1] += starts[v];
+
+		int* fill = new int[NumBuckets];
+		tStd::tMemcpy(fill, starts, NumBuckets*int(sizeof(int)));
+		for (int e = 0; e < numEntries; e++)
+		{
+			int index = fill[GetBlock(entries[e].Hash, b)]++;
+			bucketEntries[index] = e;
+			bucketHashes[index] = entries[e].Hash;
+		}
+		delete[] fill;
+
+		BucketStarts[b] = starts;
+		BucketEntries[b] = bucketEntries;
+		BucketHashes[b] = bucketHashes;
+	}
+}
+
+
+void tHashIndex::Search(tArray<int>& foundEntries, uint64 hash, int maxDistance, int* neighbours) const
+{
+	if (TablesDirty)
+		BuildTables();
+
+	int blockRadius = tMath::tMin(maxDistance / NumBlocks, BlockBits);
+	for (int b = 0; b < NumBlocks; b++)
+	{
+		int numNeighbours = 0;
+		tPHash::EnumerateNeighbours(neighbours, numNeighbours, GetBlock(hash, b), 0, blockRadius);
+		for (int n = 0; n < numNeighbours; n++)
+		{
+			int bucket = neighbours[n];
+			for (int i = BucketStarts[b][bucket]; i < BucketStarts[b][bucket+1]; i++)
+			{
+				uint64 candidate = BucketHashes[b][i];
+
+				// If an earlier block was also within the block radius this entry was already considered there.
+				bool seen = false;
+				for (int prev = 0; (prev < b) && !seen; prev++)
+					seen = tHammingDistance(uint64(GetBlock(hash, prev)), uint64(GetBlock(candidate, prev))) <= blockRadius;
+
+				if (!seen && (tHammingDistance(hash, candidate) <= maxDistance))
+					foundEntries.Append(BucketEntries[b][i]);
+			}
+		}
+	}
+}
+
+
+int tHashIndex::Find(tArray<int>& foundIDs, uint64 hash, int maxDistance) const
+{
+	if (Entries.GetNumElements() == 0)
+		return 0;
+
+	int* neighbours = new int[NumBuckets];
+	tArray<int> found;
+	Search(found, hash, maxDistance, neighbours);
+	delete[] neighbours;
+
+	const Entry* entries = Entries.GetElements();
+	for (int f = 0; f < found.GetNumElements(); f++)
+		foundIDs.Append(entries[found[f]].ID);
+
+	return found.GetNumElements();
+}
+
+
+int tHashIndex::FindClusters(tList<tDuplicateCluster>& clusters, int maxDistance, int numThreads) const
+{
+	int numEntries = Entries.GetNumElements();
+	if (numEntries < 2)
+		return 0;
+
+	if (numThreads <= 0)
+		numThreads = tSystem::tGetNumCores();
+
+	// The tables must be built before the worker threads start searching.
+	if (TablesDirty)
+		BuildTables();
+
+	// Every entry searches for its neighbours. Each chunk of entries records the matching pairs (a, b) with a < b
+	// into its own array. The merging is cheap and done afterwards on this thread.
+	const Entry* entries = Entries.GetElements();
+	int numChunks = tMath::tClamp(numEntries / 1024, 1, numThreads*8);
+	int chunkEntries = (numEntries + numChunks - 1) / numChunks;
+	tArray<int>* pairs = new tArray<int>[numChunks];
+	tSystem::tParallelFor
+	(
+		numChunks,
+		[&](int c)
+		{
+			int* neighbours = new int[NumBuckets];
+			tArray<int> found;
+			int start = c*chunkEntries;
+			int end = tMath::tMin(start + chunkEntries, numEntries);
+			for (int e = start; e < end; e++)
+			{
+				found.Clear(0);
+				Search(found, entries[e].Hash, maxDistance, neighbours);
+				for (int f = 0; f < found.GetNumElements(); f++)
+				{
+					if (found[f] <= e)
+						continue;
+					pairs[c].Append(e);
+					pairs[c].Append(found[f]);
+				}
+			}
+			delete[] neighbours;
+		},
+		numThreads
+	);
+
+	// Entry indexes are the union-find elements.
+	int* parents = new int[numEntries];
+	for (int e = 0; e < numEntries; e++)
+		parents[e] = e;
+
+	for (int c = 0; c < numChunks; c++)
+	{
+		const int* chunkPairs = pairs[c].GetElements();
+		for (int p = 0; p < pairs[c].GetNumElements(); p += 2)
+		{
+			int rootA = tPHash::FindRoot(parents, chunkPairs[p]);
+			int rootB = tPHash::FindRoot(parents, chunkPairs[p+1]);
+			if (rootA != rootB)
+				parents[tMath::tMax(rootA, rootB)] = tMath::tMin(rootA, rootB);
+		}
+	}
+	delete[] pairs;
+
+	// Roots are always the lowest entry index in their set, so the representative is the earliest added hash. We count
+	// first so that singletons never get a cluster.
+	int* counts = new int[numEntries];
+	tStd::tMemset(counts, 0, numEntries*int(sizeof(int)));
+	for (int e = 0; e < numEntries; e++)
+		counts[tPHash::FindRoot(parents, e)]++;
+
+	tDuplicateCluster** rootClusters = new tDuplicateCluster*[numEntries];
+	int numClusters = 0;
+	for (int e = 0; e < numEntries; e++)
+	{
+		int root = tPHash::FindRoot(parents, e);
+		if (counts[root] < 2)
+			continue;
+
+		if (root == e)
+		{
+			rootClusters[root] = new tDuplicateCluster;
+			clusters.Append(rootClusters[root]);
+			numClusters++;
+		}
+
+		tDuplicateCluster* cluster = rootClusters[root];
+		int distance = tHammingDistance(entries[e].Hash, entries[root].Hash);
+		tDuplicate* member = new tDuplicate(entries[e].ID, distance);
+		cluster->Members.Append(member);
+		cluster->MinSimilarity = tMath::tMin(cluster->MinSimilarity, member->Similarity);
+	}
+
+	delete[] rootClusters;
+	delete[] counts;
+	delete[] parents;
+	return numClusters;
+}
+
+
+int tImage::tFindDuplicates
+(
+	tList<tDuplicateCluster>& clusters, const tList<tStringItem>& files,
+	int maxDistance, tPerceptualHash::tKind kind, int numThreads
+)
+{
+	int numFiles = files.GetNumItems();
+	if (numFiles <= 0)
+		return 0;
+
+	const tStringItem** filenames = new const tStringItem*[numFiles];
+	int f = 0;
+	for (const tStringItem* file = files.First(); file; file = file->Next())
+		filenames[f++] = file;
+
+	// Loading dominates, so each file is its own work item.
+	tPerceptualHash* hashes = new tPerceptualHash[numFiles];
+	tSystem::tParallelFor
+	(
+		numFiles,
+		[&](int index)
+		{
+			tPicture picture;
+			if (picture.Load(*filenames[index]))
+				hashes[index].Set(picture);
+		},
+		numThreads
+	);
+
+	tHashIndex index;
+	for (int i = 0; i < numFiles; i++)
+		if (hashes[i].IsValid())
+			index.Add(hashes[i].Get(kind), i);
+
+	tList<tDuplicateCluster> found;
+	int numClusters = index.FindClusters(found, maxDistance, numThreads);
+	while (tDuplicateCluster* cluster = found.Remove())
+	{
+		for (tDuplicate* member = cluster->Members.First(); member; member = member->Next())
+			member->Filename = *filenames[member->ID];
+		clusters.Append(cluster);
+	}
+
+	delete[] hashes;
+	delete[] filenames;
+	return numClusters;
+}
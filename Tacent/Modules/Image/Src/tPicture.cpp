@@ -16,14 +16,32 @@
 // AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
 // PERFORMANCE OF THIS SOFTWARE.
 
+#include <new>
 #include "Foundation/tStandard.h"
 #include "Image/tPicture.h"
 #include "Image/tFileTGA.h"
+#include "Image/tFileJPG.h"
+#include "Image/tPixelConvert.h"
 #include <CxImage/ximage.h>
 using namespace tImage;
 using namespace tSystem;
 
 
+tPixel* tPicture::AllocPixels(int numPixels)
+{
+	// The byte count is worked out in size_t since a 32768x32768 picture is already 4GB. A negative count usually
+	// means width*height overflowed in the caller.
+	if ((numPixels < 0) || (size_t(numPixels) > size_t(-1) / sizeof(tPixel)))
+		throw std::bad_alloc();
+
+	tPixel* pixels = (tPixel*)tMem::tMalloc(size_t(numPixels) * sizeof(tPixel), PixelAlignment);
+	if (!pixels)
+		throw std::bad_alloc();
+
+	return pixels;
+}
+
+
 void tPicture::Set(int width, int height, const tPixel& colour)
 {
 	tAssert((width > 0) && (height > 0));
@@ -31,8 +49,8 @@ void tPicture::Set(int width, int height, const tPixel& colour)
 	// Reuse the existing buffer if possible.
 	if (width*height != Width*Height)
 	{
-		delete[] Pixels;
-		Pixels = new tPixel[width*height];
+		FreePixels(Pixels);
+		Pixels = AllocPixels(width*height);
 	}
 	Width = width;
 	Height = height;
@@ -51,13 +69,13 @@ void tPicture::Set(int width, int height, tPixel* pixelBuffer, bool copyPixels)
 	{
 		if (width*height != Width*Height)
 		{
-			delete[] Pixels;
-			Pixels = new tPixel[width*height];
+			FreePixels(Pixels);
+			Pixels = AllocPixels(width*height);
 		}
 	}
 	else
 	{
-		delete[] Pixels;
+		FreePixels(Pixels);
 		Pixels = pixelBuffer;
 	}
 	Width = width;
@@ -68,6 +86,21 @@ void tPicture::Set(int width, int height, tPixel* pixelBuffer, bool copyPixels)
 }
 
 
+void tPicture::Set(const tPictureView& view)
+{
+	if (!view.IsValid())
+	{
+		Clear();
+		return;
+	}
+
+	// The view may be of our own pixels so they can only be freed once the copy is made.
+	tPixel* pixels = AllocPixels(view.GetNumPixels());
+	view.CopyTo(pixels);
+	Set(view.GetWidth(), view.GetHeight(), pixels, false);
+}
+
+
 bool tPicture::CanSave(tFileType fileType)
 {
 	switch (fileType)
@@ -77,6 +110,7 @@ bool tPicture::CanSave(tFileType fileType)
 		case tFileType::GIF:
 		case tFileType::JPG:
 		case tFileType::PNG:
+		case tFileType::QOI:				// Qoi handled natively.
 			return true;
 	}
 
@@ -86,8 +120,8 @@ bool tPicture::CanSave(tFileType fileType)
 
 bool tPicture::CanLoad(tFileType fileType)
 {
-	// Targas are handled natively.
-	if (fileType == tFileType::TGA)
+	// Targas and qois are handled natively.
+	if ((fileType == tFileType::TGA) || (fileType == tFileType::QOI))
 		return true;
 
 	// The rest are handled by CxImage.
@@ -110,17 +144,19 @@ bool tPicture::Save(const tString& imageFile, tPicture::tColourFormat colourFmt)
 	if (fileType == tFileType::TGA)
 		return SaveTGA(imageFile, tImage::tFileTGA::tFormat(colourFmt), tImage::tFileTGA::tCompression::None);
 
-	tPixel* reorderedPixelArray = new tPixel[Width*Height];
-	for (int p = 0; p < Width*Height; p++)
-	{
-		tPixel pixel = Pixels[p];
-		tStd::tSwap(pixel.R, pixel.B);
-		reorderedPixelArray[p] = pixel;
-	}
+	if (fileType == tFileType::PNG)
+		return SavePNG(imageFile, tImage::tFilePNG::tFormat(colourFmt));
+
+	if (fileType == tFileType::QOI)
+		return SaveQOI(imageFile, tImage::tFileQOI::tFormat(colourFmt));
+
+	// CxImage wants BGRA.
+	tPixel* reorderedPixelArray = AllocPixels(Width*Height);
+	tConvertPixels(reorderedPixelArray, tPixelFormat::B8G8R8A8, Pixels, tPixelFormat::R8G8B8A8, Width*Height);
 
 	CxImage image;
 	image.CreateFromArray((uint8*)reorderedPixelArray, Width, Height, 32, Width*4, false);
-	delete[] reorderedPixelArray;
+	FreePixels(reorderedPixelArray);
 
 	uint32 cxImgFormat = CXIMAGE_FORMAT_PNG;
 	switch (fileType)
@@ -146,8 +182,38 @@ bool tPicture::SaveTGA(const tString& tgaFile, tFileTGA::tFormat format, tFileTG
 	if (!IsValid() || (fileType != tFileType::TGA))
 		return false;
 
-	tFileTGA targa(Pixels, Width, Height);
+	return SaveTGA(tgaFile, GetView(), format, compression);
+}
+
+
+bool tPicture::SaveTGA
+(
+	const tString& tgaFile, const tPictureView& view,
+	tFileTGA::tFormat format, tFileTGA::tCompression compression
+)
+{
+	tFileType fileType = tGetFileType(tgaFile);
+	if (!view.IsValid() || (fileType != tFileType::TGA))
+		return false;
+
+	// Saving only reads the pixels, so a packed view is lent to the tFileTGA and taken back afterwards instead of being
+	// copied. Views with a stride need their rows gathered first.
+	tFileTGA targa;
+	if (view.IsPacked())
+	{
+		targa.Set((tPixel*)view.GetPixels(), view.GetWidth(), view.GetHeight(), true);
+	}
+	else
+	{
+		tPixel* pixels = AllocPixels(view.GetNumPixels());
+		view.CopyTo(pixels);
+		targa.Set(pixels, view.GetWidth(), view.GetHeight(), true);
+	}
+
 	tFileTGA::tFormat savedFormat = targa.Save(tgaFile, format, compression);
+	if (view.IsPacked())
+		targa.StealPixels();
+
 	if (savedFormat == tFileTGA::tFormat::Invalid)
 		return false;
 
@@ -155,9 +221,39 @@ bool tPicture::SaveTGA(const tString& tgaFile, tFileTGA::tFormat format, tFileTG
 }
 
 
-bool tPicture::Load(const tString& imageFile)
+bool tPicture::SavePNG(const tString& pngFile, tFilePNG::tFormat format, tFilePNG::tLevel level, int numThreads) const
+{
+	tFileType fileType = tGetFileType(pngFile);
+	if (!IsValid() || (fileType != tFileType::PNG))
+		return false;
+
+	tFilePNG png(GetView());
+	tFilePNG::tFormat savedFormat = png.Save(pngFile, format, level, numThreads);
+	if (savedFormat == tFilePNG::tFormat::Invalid)
+		return false;
+
+	return true;
+}
+
+
+bool tPicture::SaveQOI(const tString& qoiFile, tFileQOI::tFormat format) const
+{
+	tFileType fileType = tGetFileType(qoiFile);
+	if (!IsValid() || (fileType != tFileType::QOI))
+		return false;
+
+	tFileQOI::tFormat savedFormat = tFileQOI::Save(qoiFile, GetView(), format);
+	if (savedFormat == tFileQOI::tFormat::Invalid)
+		return false;
+
+	return true;
+}
+
+
+bool tPicture::Load(const tString& imageFile, int frameNumber)
 {
 	Clear();
+	SrcFileNumFrames = 1;
 	if (!tFileExists(imageFile))
 		return false;
 
@@ -168,6 +264,9 @@ bool tPicture::Load(const tString& imageFile)
 	// We handle tga files natively.
 	if (fileType == tFileType::TGA)
 	{
+		if (frameNumber != 0)
+			return false;
+
 		tFileTGA targa(imageFile);
 		if (!targa.IsValid())
 			return false;
@@ -179,12 +278,29 @@ bool tPicture::Load(const tString& imageFile)
 		return true;
 	}
 
+	if (fileType == tFileType::QOI)
+	{
+		if (frameNumber != 0)
+			return false;
+
+		tFileQOI qoi(imageFile);
+		if (!qoi.IsValid())
+			return false;
+
+		Width = qoi.GetWidth();
+		Height = qoi.GetHeight();
+		Pixels = qoi.StealPixels();
+		SrcFileBitDepth = qoi.SrcFileBitDepth;
+		return true;
+	}
+
 	// For everything else we use the CxImage library for loading.
 	ENUM_CXIMAGE_FORMATS cxFormat = ENUM_CXIMAGE_FORMATS(GetCxFormat(fileType));
 	if (cxFormat == CXIMAGE_FORMAT_UNKNOWN)
 		return false;
 
 	CxImage image;
+	image.SetFrame(frameNumber);
 	image.Load(imageFile.ConstText(), cxFormat);
 	int width = image.GetWidth();
 	int height = image.GetHeight();
@@ -193,7 +309,8 @@ bool tPicture::Load(const tString& imageFile)
 
 	Width = width;
 	Height = height;
-	Pixels = new tPixel[Width*Height];
+	Pixels = AllocPixels(Width*Height);
+	SrcFileNumFrames = tMath::tMax(image.GetNumFrames(), 1);
 
 	// CxImage alpha oddness. If we request the alpha using GetPixelColor and there is no alpha channel, it returns 0
 	// for the alpha, which is incorrect as alpha is normally interpreted as opacity, not transparency. It should be
@@ -220,11 +337,66 @@ bool tPicture::Load(const tString& imageFile)
 			Pixels[index++] = colour;
 		}
 	}
+
+	// Jpgs from cameras and phones are often stored sideways with an exif tag saying how to turn them upright.
+	if (fileType == tFileType::JPG)
+		ApplyOrientation(imageFile);
+
 	Filename = imageFile;
 	return true;
 }
 
 
+void tPicture::ApplyOrientation(const tString& jpgFile)
+{
+	// The exif block comes straight after the start of the file and is at most 64KB.
+	const int maxHeadSize = 128*1024;
+	int numRead = maxHeadSize;
+	uint8* head = tLoadFileHead(jpgFile, numRead);
+	if (!head)
+		return;
+
+	tFileJPG::tOrientation orientation = tFileJPG::ReadOrientation(head, numRead);
+	delete[] head;
+	switch (orientation)
+	{
+		case tFileJPG::tOrientation::FlipH:
+			Flip(true);
+			break;
+
+		case tFileJPG::tOrientation::Rotate180:
+			Flip(true);
+			Flip(false);
+			break;
+
+		case tFileJPG::tOrientation::FlipV:
+			Flip(false);
+			break;
+
+		case tFileJPG::tOrientation::Transpose:
+			Rotate90(false);
+			Flip(true);
+			break;
+
+		case tFileJPG::tOrientation::Rotate90CW:
+			Rotate90(false);
+			break;
+
+		case tFileJPG::tOrientation::Transverse:
+			Rotate90(false);
+			Flip(false);
+			break;
+
+		case tFileJPG::tOrientation::Rotate90ACW:
+			Rotate90(true);
+			break;
+
+		default:
+			break;
+	}
+}
+
+
 void tPicture::Save(tChunkWriter& chunk) const
 {
 	chunk.Begin(tChunkID::Image_Picture);
@@ -266,7 +438,7 @@ void tPicture::Load(const tChunk& chunk)
 			case tChunkID::Image_PicturePixels:
 			{
 				tAssert(!Pixels && (GetNumPixels() > 0));
-				Pixels = new tPixel[GetNumPixels()];
+				Pixels = AllocPixels(GetNumPixels());
 				ch.GetItems(Pixels, GetNumPixels());
 				break;
 			}
@@ -305,7 +477,7 @@ void tPicture::Crop(int newW, int newH, int originX, int originY)
 	if ((newW == Width) && (newH == Height) && (originX == 0) && (originY == 0))
 		return;
 
-	tPixel* newPixels = new tPixel[newW * newH];
+	tPixel* newPixels = AllocPixels(newW * newH);
 
 	// Set the new pixel colours.
 	for (int y = 0; y < newH; y++)
@@ -334,7 +506,7 @@ void tPicture::Rotate90(bool antiClockwise)
 	tAssert((Width > 0) && (Height > 0) && Pixels);
 	int newW = Height;
 	int newH = Width;
-	tPixel* newPixels = new tPixel[newW * newH];
+	tPixel* newPixels = AllocPixels(newW * newH);
 
 	for (int y = 0; y < Height; y++)
 		for (int x = 0; x < Width; x++)
@@ -352,7 +524,7 @@ void tPicture::Flip(bool horizontal)
 	tAssert((Width > 0) && (Height > 0) && Pixels);
 	int newW = Width;
 	int newH = Height;
-	tPixel* newPixels = new tPixel[newW * newH];
+	tPixel* newPixels = AllocPixels(newW * newH);
 
 	for (int y = 0; y < Height; y++)
 		for (int x = 0; x < Width; x++)
@@ -386,7 +558,7 @@ bool tPicture::ScaleHalf()
 		newHeight = 1;
 
 	int numNewPixels = newWidth*newHeight;
-	tPixel* newPixels = new tPixel[numNewPixels];
+	tPixel* newPixels = AllocPixels(numNewPixels);
 
 	// Deal with case where src height is 1 and src width is divisible by 2 OR where src width is 1 and src height is
 	// divisible by 2. Image is either a row or column vector in this case.
@@ -528,7 +700,7 @@ bool tPicture::Resample(int width, int height, tFilter filter)
 	Clear();
 	Width = width;
 	Height = height;
-	Pixels = new tPixel[Width*Height];
+	Pixels = AllocPixels(Width*Height);
 
 	// Now we just pull the pixels from the CxImage.
 	int index = 0;
@@ -587,6 +759,11 @@ int tPicture::GetCxFormat(tFileType fileType)
 
 		case tFileType::JPC:
 			return CXIMAGE_FORMAT_JPC;
+
+		// Qoi files are loaded natively by tFileQOI and never go through CxImage.
+		case tFileType::QOI:
+		default:
+			break;
 	}
 
 	return CXIMAGE_FORMAT_UNKNOWN;
@@ -0,0 +1,286 @@
+// tPictureCompare.cpp
+//
+// Compares two tPictures and computes error metrics between them. Per-channel mean squared error, PSNR, windowed
+// SSIM, maximum absolute error, and the number of differing pixels are all computed. Optionally a heat-map tPicture
+// showing where the differences are is generated. Useful for checking re-encoded or block-compressed images against
+// the originals.
+//
+// Copyright (c) 2019 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <math.h>
+#include "Foundation/tStandard.h"
+#include "Math/tFundamentals.h"
+#include "System/tMachine.h"
+#include "Image/tPictureCompare.h"
+using namespace tImage;
+
+
+namespace tCompare
+{
+	const int BandRows = 16;
+	const int SSIMWindow = 8;
+	const int SSIMStep = 4;
+	const double SSIMC1 = (0.01*255.0)*(0.01*255.0);
+	const double SSIMC2 = (0.03*255.0)*(0.03*255.0);
+
+	// The two pictures may have different widths when only the overlap is compared, so each has its own stride.
+	struct Region
+	{
+		const tPixel* A;
+		int StrideA;
+		const tPixel* B;
+		int StrideB;
+		int Width;
+		int Height;
+	};
+
+	// Each band of rows accumulates into its own results so no locking is needed. The integer sums are exact.
+	struct Band
+	{
+		uint64 SumSq[4];
+		int MaxAbs[4];
+		int NumDiff;
+		double SSIMSum[4];
+		int NumWindows;
+	};
+
+	void ErrorRows(Band&, const Region&, int y0, int y1, tPixel* heatMap, float heatGain);
+	void SSIMRow(Band&, const Region&, int y, int winW, int winH);
+	tPixel HeatColour(int diff, float gain);
+}
+
+
+tPixel tCompare::HeatColour(int diff, float gain)
+{
+	// Black to red to yellow to white. A zero difference is always exactly black.
+	float t = tMath::tClamp(float(diff) * gain / 255.0f, 0.0f, 1.0f);
+	int r = int(tMath::tClamp(3.0f*t, 0.0f, 1.0f)*255.0f + 0.5f);
+	int g = int(tMath::tClamp(3.0f*t - 1.0f, 0.0f, 1.0f)*255.0f + 0.5f);
+	int b = int(tMath::tClamp(3.0f*t - 2.0f, 0.0f, 1.0f)*255.0f + 0.5f);
+	return tPixel(r, g, b, 255);
+}
+
+
+void tCompare::ErrorRows(Band& band, const Region& region, int y0, int y1, tPixel* heatMap, float heatGain)
+{
+	for (int y = y0; y < y1; y++)
+	{
+		const tPixel* rowA = region.A + y*region.StrideA;
+		const tPixel* rowB = region.B + y*region.StrideB;
+		tPixel* heatRow = heatMap ? heatMap + y*region.Width : nullptr;
+		for (int x = 0; x < region.Width; x++)
+		{
+			int pixelMax = 0;
+			for (int c = 0; c < 4; c++)
+			{
+				int diff = tMath::tAbs(int(rowA[x].E[c]) - int(rowB[x].E[c]));
+				band.SumSq[c] += uint64(diff*diff);
+				band.MaxAbs[c] = tMath::tMax(band.MaxAbs[c], diff);
+				pixelMax = tMath::tMax(pixelMax, diff);
+			}
+
+			if (pixelMax)
+				band.NumDiff++;
+
+			if (heatRow)
+				heatRow[x] = HeatColour(pixelMax, heatGain);
+		}
+	}
+}
+
+
+void tCompare::SSIMRow(Band& band, const Region& region, int y, int winW, int winH)
+{
+	int numWindowsX = (region.Width - winW) / SSIMStep + 1;
+	double n = double(winW*winH);
+	for (int wx = 0; wx < numWindowsX; wx++)
+	{
+		int x0 = wx*SSIMStep;
+
+		// A full 8x8 window of 8-bit values can't overflow these.
+		int sumA[4] = { 0, 0, 0, 0 };
+		int sumB[4] = { 0, 0, 0, 0 };
+		int sumAA[4] = { 0, 0, 0, 0 };
+		int sumBB[4] = { 0, 0, 0, 0 };
+		int sumAB[4] = { 0, 0, 0, 0 };
+		for (int j = 0; j < winH; j++)
+		{
+			const tPixel* rowA = region.A + (y+j)*region.StrideA + x0;
+			const tPixel* rowB = region.B + (y+j)*region.StrideB + x0;
+			for (int i = 0; i < winW; i++)
+			{
+				for (int c = 0; c < 4; c++)
+				{
+					int a = rowA[i].E[c];
+					int b = rowB[i].E[c];
+					sumA[c] += a;
+					sumB[c] += b;
+					sumAA[c] += a*a;
+					sumBB[c] += b*b;
+					sumAB[c] += a*b;
+				}
+			}
+		}
+
+		for (int c = 0; c < 4; c++)
+		{
+			double meanA = double(sumA[c]) / n;
+			double meanB = double(sumB[c]) / n;
+			double varA = double(sumAA[c]) / n - meanA*meanA;
+			double varB = double(sumBB[c]) / n - meanB*meanB;
+			double covar = double(sumAB[c]) / n - meanA*meanB;
+			double num = (2.0*meanA*meanB + SSIMC1) * (2.0*covar + SSIMC2);
+			double den = (meanA*meanA + meanB*meanB + SSIMC1) * (varA + varB + SSIMC2);
+			band.SSIMSum[c] += num / den;
+		}
+		band.NumWindows++;
+	}
+}
+
+
+void tPictureCompare::Clear()
+{
+	Width = 0;
+	Height = 0;
+	NumPixels = 0;
+	NumDiffPixels = 0;
+	for (int c = 0; c < tChannel_NumChannels; c++)
+	{
+		MSE[c] = 0.0;
+		PSNR[c] = 0.0;
+		SSIM[c] = 0.0;
+		MaxAbsError[c] = 0;
+	}
+}
+
+
+bool tPictureCompare::Compute
+(
+	const tPicture& a, const tPicture& b, tSizePolicy policy,
+	tPicture* heatMap, float heatGain, int numThreads
+)
+{
+	return Compute(a.GetView(), b.GetView(), policy, heatMap, heatGain, numThreads);
+}
+
+
+bool tPictureCompare::Compute
+(
+	const tPictureView& a, const tPictureView& b, tSizePolicy policy,
+	tPicture* heatMap, float heatGain, int numThreads
+)
+{
+	Clear();
+	if (!a.IsValid() || !b.IsValid())
+		return false;
+
+	// Resampling needs a copy of b. The region always refers to pixels owned by a, b, or the copy.
+	tPicture resampled;
+	tCompare::Region region;
+	region.A = a.GetPixels();
+	region.StrideA = a.GetStride();
+	region.B = b.GetPixels();
+	region.StrideB = b.GetStride();
+	region.Width = a.GetWidth();
+	region.Height = a.GetHeight();
+	if ((a.GetWidth() != b.GetWidth()) || (a.GetHeight() != b.GetHeight()))
+	{
+		switch (policy)
+		{
+			case tSizePolicy::Overlap:
+				region.Width = tMath::tMin(a.GetWidth(), b.GetWidth());
+				region.Height = tMath::tMin(a.GetHeight(), b.GetHeight());
+				break;
+
+			case tSizePolicy::Resample:
+				resampled.Set(b);
+				if (!resampled.Resample(a.GetWidth(), a.GetHeight(), tPicture::tFilter::Bilinear))
+					return false;
+				region.B = resampled.GetPixels();
+				region.StrideB = resampled.GetWidth();
+				break;
+
+			case tSizePolicy::Fail:
+			default:
+				return false;
+		}
+	}
+
+	if (numThreads <= 0)
+		numThreads = tSystem::tGetNumCores();
+
+	tPixel* heatPixels = nullptr;
+	if (heatMap)
+	{
+		heatMap->Set(region.Width, region.Height);
+		heatPixels = heatMap->GetPixelPointer();
+	}
+
+	// Images smaller than the SSIM window use a single window covering the whole dimension.
+	int winW = tMath::tMin(tCompare::SSIMWindow, region.Width);
+	int winH = tMath::tMin(tCompare::SSIMWindow, region.Height);
+	int numWindowRows = (region.Height - winH) / tCompare::SSIMStep + 1;
+
+	// Band b covers pixel rows [b*BandRows, (b+1)*BandRows) and every SSIM window row whose first row lies in that range.
+	// Since BandRows is a multiple of SSIMStep each window row is owned by exactly one band.
+	int numBands = (region.Height + tCompare::BandRows - 1) / tCompare::BandRows;
+	tCompare::Band* bands = new tCompare::Band[numBands];
+	tStd::tMemset(bands, 0, numBands*int(sizeof(tCompare::Band)));
+	tSystem::tParallelFor
+	(
+		numBands,
+		[&](int bandIndex)
+		{
+			tCompare::Band& band = bands[bandIndex];
+			int y0 = bandIndex*tCompare::BandRows;
+			int y1 = tMath::tMin(y0 + tCompare::BandRows, region.Height);
+			tCompare::ErrorRows(band, region, y0, y1, heatPixels, heatGain);
+
+			for (int w = y0 / tCompare::SSIMStep; (w < numWindowRows) && (w*tCompare::SSIMStep < y1); w++)
+				tCompare::SSIMRow(band, region, w*tCompare::SSIMStep, winW, winH);
+		},
+		numThreads
+	);
+
+	uint64 sumSq[4] = { 0, 0, 0, 0 };
+	double ssimSum[4] = { 0.0, 0.0, 0.0, 0.0 };
+	int numWindows = 0;
+	for (int bandIndex = 0; bandIndex < numBands; bandIndex++)
+	{
+		const tCompare::Band& band = bands[bandIndex];
+		for (int c = 0; c < 4; c++)
+		{
+			sumSq[c] += band.SumSq[c];
+			ssimSum[c] += band.SSIMSum[c];
+			MaxAbsError[c] = tMath::tMax(MaxAbsError[c], band.MaxAbs[c]);
+		}
+		NumDiffPixels += band.NumDiff;
+		numWindows += band.NumWindows;
+	}
+	delete[] bands;
+
+	Width = region.Width;
+	Height = region.Height;
+	NumPixels = Width*Height;
+	for (int c = 0; c < 4; c++)
+	{
+		MSE[c] = double(sumSq[c]) / double(NumPixels);
+		SSIM[c] = ssimSum[c] / double(numWindows);
+		MSE[tChannel_All] += MSE[c] / 4.0;
+		SSIM[tChannel_All] += SSIM[c] / 4.0;
+		MaxAbsError[tChannel_All] = tMath::tMax(MaxAbsError[tChannel_All], MaxAbsError[c]);
+	}
+
+	for (int c = 0; c < tChannel_NumChannels; c++)
+		PSNR[c] = (MSE[c] > 0.0) ? 10.0*log10(255.0*255.0 / MSE[c]) : tStd::tDoublePINF();
+
+	return true;
+}
@@ -0,0 +1,244 @@
+// tPictureStats.cpp
+//
+// Computes image statistics for a tPicture in a single multithreaded pass over the pixels. This includes per-channel
+// and luminance histograms, min/max/mean/standard-deviation, alpha coverage, and an approximate count of the number of
+// distinct colours.
+//
+// Copyright (c) 2019 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <math.h>
+#include "Foundation/tStandard.h"
+#include "Math/tFundamentals.h"
+#include "System/tMachine.h"
+#include "Image/tPictureStats.h"
+using namespace tImage;
+
+
+namespace tStats
+{
+	// 2^12 HyperLogLog registers gives a standard error of about 1.04/sqrt(4096) = 1.6%.
+	const int HLLBits = 12;
+	const int HLLNumRegisters = 1 << HLLBits;
+
+	// Pixels are processed in chunks, each with its own histograms and registers, so no locking is needed.
+	const int MinChunkPixels = 64*1024;
+	struct Chunk
+	{
+		uint32 Histograms[tPictureStats::tChannel_NumChannels][256];
+		uint8 Registers[HLLNumRegisters];
+	};
+
+	uint64 Mix64(uint64 v);
+	void ProcessPixels(Chunk&, const tPixel* pixels, int numPixels);
+	double EstimateCardinality(const uint8* registers);
+}
+
+
+inline uint64 tStats::Mix64(uint64 v)
+{
+	// SplitMix64 finalizer. Every input bit affects every output bit, which HyperLogLog depends on.
+	v += 0x9E3779B97F4A7C15ULL;
+	v = (v ^ (v >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	v = (v ^ (v >> 27)) * 0x94D049BB133111EBULL;
+	return v ^ (v >> 31);
+}
+
+
+void tStats::ProcessPixels(Chunk& chunk, const tPixel* pixels, int numPixels)
+{
+	uint32* histR = chunk.Histograms[tPictureStats::tChannel_R];
+	uint32* histG = chunk.Histograms[tPictureStats::tChannel_G];
+	uint32* histB = chunk.Histograms[tPictureStats::tChannel_B];
+	uint32* histA = chunk.Histograms[tPictureStats::tChannel_A];
+	uint32* histL = chunk.Histograms[tPictureStats::tChannel_L];
+
+	uint32 prevBP = 0;
+	bool havePrev = false;
+	for (int p = 0; p < numPixels; p++)
+	{
+		const tPixel& pixel = pixels[p];
+		histR[pixel.R]++;
+		histG[pixel.G]++;
+		histB[pixel.B]++;
+		histA[pixel.A]++;
+
+		// Rec. 709 weights scaled to sum to 256 so the result is always in [0, 255].
+		histL[(54*pixel.R + 183*pixel.G + 19*pixel.B) >> 8]++;
+
+		// Runs of identical pixels are very common and can't change the registers, so we skip the hash for them.
+		if (havePrev && (pixel.BP == prevBP))
+			continue;
+		prevBP = pixel.BP;
+		havePrev = true;
+
+		// The top HLLBits select the register. The rank is the position of the first set bit in the remaining bits.
+		uint64 hash = Mix64(pixel.BP);
+		int reg = int(hash >> (64 - HLLBits));
+		uint64 rest = (hash << HLLBits) | (1ULL << (HLLBits - 1));
+		uint8 rank = 1;
+		while (!(rest & 0x8000000000000000ULL))
+		{
+			rest <<= 1;
+			rank++;
+		}
+
+		if (rank > chunk.Registers[reg])
+			chunk.Registers[reg] = rank;
+	}
+}
+
+
+double tStats::EstimateCardinality(const uint8* registers)
+{
+	double sum = 0.0;
+	int numZero = 0;
+	for (int r = 0; r < HLLNumRegisters; r++)
+	{
+		sum += ldexp(1.0, -int(registers[r]));
+		if (registers[r] == 0)
+			numZero++;
+	}
+
+	double m = double(HLLNumRegisters);
+	double alpha = 0.7213 / (1.0 + 1.079/m);
+	double estimate = alpha * m * m / sum;
+
+	// Small range correction. Linear counting is more accurate while some registers are still empty.
+	if ((estimate <= 2.5*m) && (numZero > 0))
+		estimate = m * log(m / double(numZero));
+
+	return estimate;
+}
+
+
+void tPictureStats::Clear()
+{
+	NumPixels = 0;
+	for (int c = 0; c < tChannel_NumChannels; c++)
+	{
+		Min[c] = 0;
+		Max[c] = 0;
+		Mean[c] = 0.0f;
+		StdDev[c] = 0.0f;
+		MaxBinCount[c] = 0;
+	}
+	tStd::tMemset(Histograms, 0, sizeof(Histograms));
+
+	NumOpaque = 0;
+	NumTransparent = 0;
+	NumTranslucent = 0;
+	AlphaCoverage = 0.0f;
+	NumDistinctColours = 0;
+}
+
+
+bool tPictureStats::Compute(const tPicture& picture, int numThreads)
+{
+	if (!picture.IsValid())
+	{
+		Clear();
+		return false;
+	}
+
+	return Compute(picture.GetView(), numThreads);
+}
+
+
+bool tPictureStats::Compute(const tPictureView& view, int numThreads)
+{
+	Clear();
+	if (!view.IsValid())
+		return false;
+
+	if (numThreads <= 0)
+		numThreads = tSystem::tGetNumCores();
+
+	// A packed view is split into chunks of pixels. Otherwise each chunk is a range of rows. A few chunks per thread
+	// helps balance the load. Small images just get one.
+	int numPixels = view.GetNumPixels();
+	bool packed = view.IsPacked();
+	int numUnits = packed ? numPixels : view.GetHeight();
+	int numChunks = tMath::tClamp(numPixels / tStats::MinChunkPixels, 1, tMath::tMin(numThreads*4, numUnits));
+	int chunkUnits = (numUnits + numChunks - 1) / numChunks;
+	tStats::Chunk* chunks = new tStats::Chunk[numChunks];
+
+	tSystem::tParallelFor
+	(
+		numChunks,
+		[&](int c)
+		{
+			tStats::Chunk& chunk = chunks[c];
+			tStd::tMemset(&chunk, 0, sizeof(tStats::Chunk));
+			int start = c*chunkUnits;
+			int count = tMath::tMin(chunkUnits, numUnits - start);
+			if (packed)
+			{
+				tStats::ProcessPixels(chunk, view.GetPixels() + start, count);
+				return;
+			}
+
+			for (int y = start; y < start + count; y++)
+				tStats::ProcessPixels(chunk, view.GetRow(y), view.GetWidth());
+		},
+		numThreads
+	);
+
+	// Merge the chunks.
+	uint8 registers[tStats::HLLNumRegisters];
+	tStd::tMemset(registers, 0, sizeof(registers));
+	for (int c = 0; c < numChunks; c++)
+	{
+		for (int ch = 0; ch < tChannel_NumChannels; ch++)
+			for (int v = 0; v < 256; v++)
+				Histograms[ch][v] += chunks[c].Histograms[ch][v];
+
+		for (int r = 0; r < tStats::HLLNumRegisters; r++)
+			registers[r] = tMath::tMax(registers[r], chunks[c].Registers[r]);
+	}
+	delete[] chunks;
+
+	// Everything else comes from the histograms.
+	NumPixels = numPixels;
+	for (int ch = 0; ch < tChannel_NumChannels; ch++)
+	{
+		const uint32* hist = Histograms[ch];
+		Min[ch] = 0;
+		while (!hist[Min[ch]])
+			Min[ch]++;
+
+		Max[ch] = 255;
+		while (!hist[Max[ch]])
+			Max[ch]--;
+
+		double sum = 0.0;
+		double sumSq = 0.0;
+		for (int v = 0; v < 256; v++)
+		{
+			sum += double(v) * double(hist[v]);
+			sumSq += double(v) * double(v) * double(hist[v]);
+			MaxBinCount[ch] = tMath::tMax(MaxBinCount[ch], hist[v]);
+		}
+
+		double mean = sum / double(numPixels);
+		double variance = tMath::tMax(sumSq / double(numPixels) - mean*mean, 0.0);
+		Mean[ch] = float(mean);
+		StdDev[ch] = float(sqrt(variance));
+	}
+
+	NumOpaque = Histograms[tChannel_A][255];
+	NumTransparent = Histograms[tChannel_A][0];
+	NumTranslucent = NumPixels - NumOpaque - NumTransparent;
+	AlphaCoverage = float(NumPixels - NumTransparent) / float(NumPixels);
+
+	double distinct = tStats::EstimateCardinality(registers);
+	NumDistinctColours = tMath::tClamp(int(distinct + 0.5), 1, NumPixels);
+	return true;
+}
@@ -0,0 +1,532 @@
+// tPixelConvert.cpp
+//
+// Conversion of pixels between any two normal (non block) pixel formats. Every format is described by where its
+// channels sit in memory, and conversions are driven by those descriptions instead of being written by hand for each
+// pair. Swizzles and packing to or from the 16 bit formats use SSE2 kernels on x64. Formats with 3 byte pixels use a
+// byte copying kernel, and everything else, including the float formats, goes through a general path.
+//
+// Copyright (c) 2020 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include "Foundation/tStandard.h"
+#include "Math/tFundamentals.h"
+#include "System/tMachine.h"
+#include "Image/tPixelConvert.h"
+
+// SSE2 is part of the x64 baseline so no runtime check is needed.
+#ifdef ARCHITECTURE_X64
+#include <emmintrin.h>
+#define CONVERT_USE_SSE2
+#endif
+using namespace tImage;
+
+
+namespace tConvert
+{
+	// Indexed by format - FirstNormal. The float formats are named after their D3D equivalents so red comes first in
+	// memory even though the names list it last.
+	extern const tPixelLayout Layouts[int(tPixelFormat::NumNormalFormats)];
+
+	// Rec. 709 luma weights. Used when writing a luminance format.
+	const float LumR = 0.2126f;
+	const float LumG = 0.7152f;
+	const float LumB = 0.0722f;
+
+	enum class Kernel
+	{
+		Copy,											// Same format.
+		Bytes,											// Whole byte channels. Output bytes are copies or constants.
+		Packed,											// Integer channels. SSE2 for 2 and 4 byte pixels.
+		General											// Anything with floats.
+	};
+
+	// Everything a kernel needs that depends only on the two formats. Built once per conversion.
+	struct Plan
+	{
+		Plan(const tPixelLayout& dest, const tPixelLayout& src);
+		void Run(uint8* dest, const uint8* src, int numPixels) const;
+
+		const tPixelLayout& Dest;
+		const tPixelLayout& Src;
+		Kernel Type;
+
+		// For the byte kernel. Output byte b is Input[ByteMap[b]] where the input holds the source bytes at 0 to 3, a
+		// zero at 4, and 255 at 5.
+		int ByteMap[4];
+
+		// For the packed kernel. Channels not in the source are filled with Fill. Channels whose size changes are
+		// rescaled by Ratio and rounded.
+		uint32 SrcMask[4];
+		uint32 Fill[4];
+		bool Rescale[4];
+		float Ratio[4];
+		float SrcScale[4];								// 1/SrcMask. Only used to compute luminance.
+		float LumMax;									// The destination luminance mask as a float.
+	};
+
+	bool IsByteFormat(const tPixelLayout&);
+	void ConvertBytes(uint8* dest, const uint8* src, int numPixels, const Plan&);
+	template<int SrcBytes, int DestBytes>
+	void ConvertBytes(uint8* dest, const uint8* src, int numPixels, const int map[4]);
+	void ConvertPacked(uint8* dest, const uint8* src, int numPixels, const Plan&);
+	uint32 ConvertPackedPixel(uint32 word, const Plan&);
+	void ConvertGeneral(uint8* dest, const uint8* src, int numPixels, const Plan&);
+
+	// The general path goes through floats with R, G, B, A order.
+	void ReadPixel(float colour[4], const uint8* src, const tPixelLayout&);
+	void WritePixel(uint8* dest, const float colour[4], const tPixelLayout&);
+
+	// Pixels are little endian. Only the low BytesPerPixel bytes of a word are read or written, which must be from 2 to
+	// 4 bytes. The bytes are assembled by hand because a memcpy of a variable size is a function call.
+	uint32 ReadWord(const uint8* src, int numBytes);
+	void WriteWord(uint8* dest, uint32 word, int numBytes);
+	uint32 GetMask(int bits)																							{ return (bits >= 32) ? 0xFFFFFFFF : ((1u << bits) - 1); }
+	float Saturate(float v)																								{ return (v > 0.0f) ? ((v < 1.0f) ? v : 1.0f) : 0.0f; }
+
+	#ifdef CONVERT_USE_SSE2
+	// Extracts a channel field from four pixels and scales it to [0, 1].
+	__m128 GetChannel(__m128i words, __m128i shift, __m128i mask, __m128 scale);
+	#endif
+
+	// Chunks are big enough that the threading overhead is small and small enough to balance.
+	const int ChunkSize = 1 << 16;
+}
+
+
+const tPixelLayout tConvert::Layouts[int(tPixelFormat::NumNormalFormats)] =
+{
+	//	Bytes	Float	Lum		Shift R, G, B, A		Bits R, G, B, A
+	{	3,		false,	false,	{ 0, 8, 16, 0 },		{ 8, 8, 8, 0 }		},	// R8G8B8
+	{	4,		false,	false,	{ 0, 8, 16, 24 },		{ 8, 8, 8, 8 }		},	// R8G8B8A8
+	{	3,		false,	false,	{ 16, 8, 0, 0 },		{ 8, 8, 8, 0 }		},	// B8G8R8
+	{	4,		false,	false,	{ 16, 8, 0, 24 },		{ 8, 8, 8, 8 }		},	// B8G8R8A8
+	{	2,		false,	false,	{ 10, 5, 0, 15 },		{ 5, 5, 5, 1 }		},	// G3B5A1R5G2
+	{	2,		false,	false,	{ 8, 4, 0, 12 },		{ 4, 4, 4, 4 }		},	// G4B4A4R4
+	{	2,		false,	false,	{ 11, 5, 0, 0 },		{ 5, 6, 5, 0 }		},	// G3B5R5G3
+	{	2,		false,	true,	{ 0, 0, 0, 8 },			{ 8, 8, 8, 8 }		},	// L8A8
+	{	4,		true,	false,	{ 0, 0, 0, 0 },			{ 32, 0, 0, 0 }		},	// R32F
+	{	8,		true,	false,	{ 0, 32, 0, 0 },		{ 32, 32, 0, 0 }	},	// G32R32F
+	{	16,		true,	false,	{ 0, 32, 64, 96 },		{ 32, 32, 32, 32 }	}	// A32B32G32R32F
+};
+
+
+inline uint32 tConvert::ReadWord(const uint8* src, int numBytes)
+{
+	uint32 word = uint32(src[0]) | (uint32(src[1]) << 8);
+	if (numBytes > 2)
+		word |= uint32(src[2]) << 16;
+	if (numBytes > 3)
+		word |= uint32(src[3]) << 24;
+	return word;
+}
+
+
+inline void tConvert::WriteWord(uint8* dest, uint32 word, int numBytes)
+{
+	dest[0] = uint8(word);
+	dest[1] = uint8(word >> 8);
+	if (numBytes > 2)
+		dest[2] = uint8(word >> 16);
+	if (numBytes > 3)
+		dest[3] = uint8(word >> 24);
+}
+
+
+bool tConvert::IsByteFormat(const tPixelLayout& layout)
+{
+	if (layout.Float || layout.Luminance)
+		return false;
+
+	for (int c = 0; c < 4; c++)
+		if (layout.Bits[c] && ((layout.Bits[c] != 8) || (layout.Shift[c] % 8)))
+			return false;
+
+	return true;
+}
+
+
+tConvert::Plan::Plan(const tPixelLayout& dest, const tPixelLayout& src) :
+	Dest(dest),
+	Src(src),
+	Type(Kernel::General)
+{
+	if (&dest == &src)
+	{
+		Type = Kernel::Copy;
+		return;
+	}
+
+	if (dest.Float || src.Float)
+		return;
+
+	// A luminance source is fine for the byte kernel because its colour channels all point at the same byte.
+	bool bytes = IsByteFormat(dest) && (IsByteFormat(src) || (src.Luminance && (src.BytesPerPixel == 2)));
+	#ifdef CONVERT_USE_SSE2
+	// The packed kernel is faster when both sides have 2 or 4 byte pixels.
+	if ((dest.BytesPerPixel != 3) && (src.BytesPerPixel != 3))
+		bytes = false;
+	#endif
+
+	if (bytes)
+	{
+		Type = Kernel::Bytes;
+		for (int b = 0; b < 4; b++)
+			ByteMap[b] = 4;
+		for (int c = 0; c < 4; c++)
+		{
+			if (!dest.Bits[c])
+				continue;
+			int b = dest.Shift[c] / 8;
+			if (src.Bits[c])
+				ByteMap[b] = src.Shift[c] / 8;
+			else
+				ByteMap[b] = (c == 3) ? 5 : 4;
+		}
+		return;
+	}
+
+	Type = Kernel::Packed;
+	for (int c = 0; c < 4; c++)
+	{
+		SrcMask[c] = GetMask(src.Bits[c]);
+		SrcScale[c] = src.Bits[c] ? 1.0f / float(SrcMask[c]) : 0.0f;
+		Fill[c] = (c == 3) ? GetMask(dest.Bits[c]) : 0;
+		Rescale[c] = src.Bits[c] && (src.Bits[c] != dest.Bits[c]);
+		Ratio[c] = src.Bits[c] ? float(GetMask(dest.Bits[c])) / float(SrcMask[c]) : 0.0f;
+	}
+	LumMax = float(GetMask(dest.Bits[0]));
+}
+
+
+void tConvert::Plan::Run(uint8* dest, const uint8* src, int numPixels) const
+{
+	switch (Type)
+	{
+		case Kernel::Copy:
+			tStd::tMemcpy(dest, src, numPixels*Src.BytesPerPixel);
+			break;
+
+		case Kernel::Bytes:
+			ConvertBytes(dest, src, numPixels, *this);
+			break;
+
+		case Kernel::Packed:
+			ConvertPacked(dest, src, numPixels, *this);
+			break;
+
+		case Kernel::General:
+			ConvertGeneral(dest, src, numPixels, *this);
+			break;
+	}
+}
+
+
+template<int SrcBytes, int DestBytes>
+void tConvert::ConvertBytes(uint8* dest, const uint8* src, int numPixels, const int map[4])
+{
+	uint8 input[6] = { 0, 0, 0, 0, 0, 255 };
+	for (int p = 0; p < numPixels; p++, src += SrcBytes, dest += DestBytes)
+	{
+		for (int b = 0; b < SrcBytes; b++)
+			input[b] = src[b];
+		for (int b = 0; b < DestBytes; b++)
+			dest[b] = input[map[b]];
+	}
+}
+
+
+void tConvert::ConvertBytes(uint8* dest, const uint8* src, int numPixels, const Plan& plan)
+{
+	// Instantiating each size pair lets the compiler unroll the byte loops.
+	const int* map = plan.ByteMap;
+	switch (plan.Src.BytesPerPixel*8 + plan.Dest.BytesPerPixel)
+	{
+		case 2*8 + 3:	ConvertBytes<2, 3>(dest, src, numPixels, map);	break;
+		case 2*8 + 4:	ConvertBytes<2, 4>(dest, src, numPixels, map);	break;
+		case 3*8 + 3:	ConvertBytes<3, 3>(dest, src, numPixels, map);	break;
+		case 3*8 + 4:	ConvertBytes<3, 4>(dest, src, numPixels, map);	break;
+		case 4*8 + 3:	ConvertBytes<4, 3>(dest, src, numPixels, map);	break;
+		case 4*8 + 4:	ConvertBytes<4, 4>(dest, src, numPixels, map);	break;
+		default:		tAssert(!"Unsupported byte conversion.");		break;
+	}
+}
+
+
+uint32 tConvert::ConvertPackedPixel(uint32 word, const Plan& plan)
+{
+	const tPixelLayout& dest = plan.Dest;
+	const tPixelLayout& src = plan.Src;
+	uint32 out = 0;
+	int first = 0;
+	if (dest.Luminance)
+	{
+		float rgb[3];
+		for (int c = 0; c < 3; c++)
+			rgb[c] = float((word >> src.Shift[c]) & plan.SrcMask[c]) * plan.SrcScale[c];
+		float lum = (rgb[0]*LumR + rgb[1]*LumG) + rgb[2]*LumB;
+		lum = tMath::tMin(lum*plan.LumMax + 0.5f, plan.LumMax);
+		out = uint32(lum) << dest.Shift[0];
+		first = 3;
+	}
+
+	for (int c = first; c < 4; c++)
+	{
+		if (!dest.Bits[c])
+			continue;
+
+		uint32 value = plan.Fill[c];
+		if (src.Bits[c])
+		{
+			value = (word >> src.Shift[c]) & plan.SrcMask[c];
+			if (plan.Rescale[c])
+				value = uint32(float(value)*plan.Ratio[c] + 0.5f);
+		}
+		out |= value << dest.Shift[c];
+	}
+
+	return out;
+}
+
+
+#ifdef CONVERT_USE_SSE2
+inline __m128 tConvert::GetChannel(__m128i words, __m128i shift, __m128i mask, __m128 scale)
+{
+	return _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srl_epi32(words, shift), mask)), scale);
+}
+#endif
+
+
+void tConvert::ConvertPacked(uint8* dest, const uint8* src, int numPixels, const Plan& plan)
+{
+	int srcBytes = plan.Src.BytesPerPixel;
+	int destBytes = plan.Dest.BytesPerPixel;
+	int p = 0;
+
+	#ifdef CONVERT_USE_SSE2
+	// Four pixels at a time, one per 32 bit lane. This does exactly the same float operations as ConvertPackedPixel
+	// so the results match the scalar path. Pixels of 3 bytes are moved through a staging buffer.
+	{
+		const tPixelLayout& dl = plan.Dest;
+		const tPixelLayout& sl = plan.Src;
+		__m128i zero = _mm_setzero_si128();
+		__m128 half = _mm_set1_ps(0.5f);
+		__m128i srcShift[4], destShift[4], srcMask[4], fill[4];
+		__m128 ratio[4], srcScale[4];
+		for (int c = 0; c < 4; c++)
+		{
+			srcShift[c] = _mm_cvtsi32_si128(sl.Shift[c]);
+			destShift[c] = _mm_cvtsi32_si128(dl.Shift[c]);
+			srcMask[c] = _mm_set1_epi32(int(plan.SrcMask[c]));
+			fill[c] = _mm_set1_epi32(int(plan.Fill[c]));
+			ratio[c] = _mm_set1_ps(plan.Ratio[c]);
+			srcScale[c] = _mm_set1_ps(plan.SrcScale[c]);
+		}
+		__m128 lumR = _mm_set1_ps(LumR);
+		__m128 lumG = _mm_set1_ps(LumG);
+		__m128 lumB = _mm_set1_ps(LumB);
+		__m128 lumMax = _mm_set1_ps(plan.LumMax);
+		int first = dl.Luminance ? 3 : 0;
+
+		for (; p + 4 <= numPixels; p += 4)
+		{
+			__m128i words;
+			if (srcBytes == 4)
+			{
+				words = _mm_loadu_si128((const __m128i*)(src + p*4));
+			}
+			else if (srcBytes == 2)
+			{
+				words = _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)(src + p*2)), zero);
+			}
+			else
+			{
+				const uint8* s = src + p*srcBytes;
+				words = _mm_setr_epi32
+				(
+					int(ReadWord(s, 3)), int(ReadWord(s + 3, 3)), int(ReadWord(s + 6, 3)), int(ReadWord(s + 9, 3))
+				);
+			}
+
+			__m128i out = zero;
+			if (dl.Luminance)
+			{
+				__m128 r = GetChannel(words, srcShift[0], srcMask[0], srcScale[0]);
+				__m128 g = GetChannel(words, srcShift[1], srcMask[1], srcScale[1]);
+				__m128 b = GetChannel(words, srcShift[2], srcMask[2], srcScale[2]);
+				__m128 lum = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r, lumR), _mm_mul_ps(g, lumG)), _mm_mul_ps(b, lumB));
+				lum = _mm_min_ps(_mm_add_ps(_mm_mul_ps(lum, lumMax), half), lumMax);
+				out = _mm_sll_epi32(_mm_cvttps_epi32(lum), destShift[0]);
+			}
+
+			for (int c = first; c < 4; c++)
+			{
+				if (!dl.Bits[c])
+					continue;
+
+				__m128i value = fill[c];
+				if (sl.Bits[c])
+				{
+					value = _mm_and_si128(_mm_srl_epi32(words, srcShift[c]), srcMask[c]);
+					if (plan.Rescale[c])
+						value = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(value), ratio[c]), half));
+				}
+				out = _mm_or_si128(out, _mm_sll_epi32(value, destShift[c]));
+			}
+
+			if (destBytes == 4)
+			{
+				_mm_storeu_si128((__m128i*)(dest + p*4), out);
+			}
+			else if (destBytes == 2)
+			{
+				// Sign extending the low halves first stops packs from saturating values of 0x8000 and up.
+				out = _mm_srai_epi32(_mm_slli_epi32(out, 16), 16);
+				_mm_storel_epi64((__m128i*)(dest + p*2), _mm_packs_epi32(out, out));
+			}
+			else
+			{
+				uint32 staged[4];
+				_mm_storeu_si128((__m128i*)staged, out);
+				for (int i = 0; i < 4; i++)
+					WriteWord(dest + (p + i)*3, staged[i], 3);
+			}
+		}
+	}
+	#endif
+
+	src += p*srcBytes;
+	dest += p*destBytes;
+	for (; p < numPixels; p++, src += srcBytes, dest += destBytes)
+		WriteWord(dest, ConvertPackedPixel(ReadWord(src, srcBytes), plan), destBytes);
+}
+
+
+void tConvert::ReadPixel(float colour[4], const uint8* src, const tPixelLayout& layout)
+{
+	if (layout.Float)
+	{
+		for (int c = 0; c < 4; c++)
+		{
+			if (layout.Bits[c])
+				tStd::tMemcpy(&colour[c], src + layout.Shift[c]/8, sizeof(float));
+			else
+				colour[c] = (c == 3) ? 1.0f : 0.0f;
+		}
+		return;
+	}
+
+	uint32 word = ReadWord(src, layout.BytesPerPixel);
+	for (int c = 0; c < 4; c++)
+	{
+		if (layout.Bits[c])
+		{
+			uint32 mask = GetMask(layout.Bits[c]);
+			colour[c] = float((word >> layout.Shift[c]) & mask) / float(mask);
+		}
+		else
+		{
+			colour[c] = (c == 3) ? 1.0f : 0.0f;
+		}
+	}
+}
+
+
+void tConvert::WritePixel(uint8* dest, const float colour[4], const tPixelLayout& layout)
+{
+	if (layout.Float)
+	{
+		for (int c = 0; c < 4; c++)
+			if (layout.Bits[c])
+				tStd::tMemcpy(dest + layout.Shift[c]/8, &colour[c], sizeof(float));
+		return;
+	}
+
+	float values[4] = { Saturate(colour[0]), Saturate(colour[1]), Saturate(colour[2]), Saturate(colour[3]) };
+	int first = 0;
+	uint32 word = 0;
+	if (layout.Luminance)
+	{
+		float lumMax = float(GetMask(layout.Bits[0]));
+		float lum = (values[0]*LumR + values[1]*LumG) + values[2]*LumB;
+		word = uint32(tMath::tMin(lum*lumMax + 0.5f, lumMax)) << layout.Shift[0];
+		first = 3;
+	}
+
+	for (int c = first; c < 4; c++)
+	{
+		if (!layout.Bits[c])
+			continue;
+
+		// Done in double so the product is exact and values that are really halfway round up.
+		uint32 mask = GetMask(layout.Bits[c]);
+		word |= uint32(double(values[c])*double(mask) + 0.5) << layout.Shift[c];
+	}
+
+	WriteWord(dest, word, layout.BytesPerPixel);
+}
+
+
+void tConvert::ConvertGeneral(uint8* dest, const uint8* src, int numPixels, const Plan& plan)
+{
+	int srcBytes = plan.Src.BytesPerPixel;
+	int destBytes = plan.Dest.BytesPerPixel;
+	float colour[4];
+	for (int p = 0; p < numPixels; p++, src += srcBytes, dest += destBytes)
+	{
+		ReadPixel(colour, src, plan.Src);
+		WritePixel(dest, colour, plan.Dest);
+	}
+}
+
+
+const tPixelLayout* tImage::tGetPixelLayout(tPixelFormat format)
+{
+	if (!tIsNormalFormat(format))
+		return nullptr;
+
+	return &tConvert::Layouts[int(format) - int(tPixelFormat::FirstNormal)];
+}
+
+
+bool tImage::tConvertPixels
+(
+	void* dest, tPixelFormat destFormat, const void* src, tPixelFormat srcFormat,
+	int numPixels, int numThreads
+)
+{
+	const tPixelLayout* destLayout = tGetPixelLayout(destFormat);
+	const tPixelLayout* srcLayout = tGetPixelLayout(srcFormat);
+	if (!destLayout || !srcLayout || !dest || !src || (numPixels < 0))
+		return false;
+
+	tConvert::Plan plan(*destLayout, *srcLayout);
+	uint8* destBytes = (uint8*)dest;
+	const uint8* srcBytes = (const uint8*)src;
+	int numChunks = (numPixels + tConvert::ChunkSize - 1) / tConvert::ChunkSize;
+	if (numChunks <= 1)
+	{
+		plan.Run(destBytes, srcBytes, numPixels);
+		return true;
+	}
+
+	tSystem::tParallelFor
+	(
+		numChunks,
+		[&](int chunk)
+		{
+			int first = chunk*tConvert::ChunkSize;
+			int count = tMath::tMin(tConvert::ChunkSize, numPixels - first);
+			plan.Run(destBytes + first*destLayout->BytesPerPixel, srcBytes + first*srcLayout->BytesPerPixel, count);
+		},
+		numThreads
+	);
+
+	return true;
+}
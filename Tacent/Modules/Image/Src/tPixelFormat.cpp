@@ -28,7 +28,10 @@ int NormalFormat_BytesPerPixel[tPixelFormat::NumNormalFormats] =
 	2,				// G3B5A1R5G2
 	2,				// G4B4A4R4
 	2,				// G3B5R5G3
-	2				// L8A8
+	2,				// L8A8
+	4,				// R32F
+	8,				// G32R32F
+	16				// A32B32G32R32F
 };
 
 
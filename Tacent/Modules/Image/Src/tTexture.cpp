@@ -23,7 +23,8 @@
 // PERFORMANCE OF THIS SOFTWARE.
 
 #include <Image/tTexture.h>
-#include <nvtt/nvtt.h>
+#include "Image/tBlockCompress.h"
+#include "Image/tPixelConvert.h"
 namespace tImage
 {
 
@@ -56,6 +57,16 @@ bool tTexture::Load(const tString& ddsFile, tFileDDS::tSurfIndex surface, bool c
 }
 
 
+bool tTexture::Save(const tString& ddsFile, bool correctRowOrder) const
+{
+	if (!IsValid() || (tSystem::tGetFileType(ddsFile) != tSystem::tFileType::DDS))
+		return false;
+
+	tFileDDS::Save(ddsFile, Layers, correctRowOrder);
+	return true;
+}
+
+
 bool tTexture::Set(tFileDDS& dds, tFileDDS::tSurfIndex surface)
 {
 	Clear();
@@ -182,17 +193,26 @@ bool tTexture::Set(tPicture& image, bool generateMipmaps, tPixelFormat pixelForm
 	{
 		case tPixelFormat::R8G8B8:
 		case tPixelFormat::R8G8B8A8:
-			ProcessImageTo_R8G8B8_Or_R8G8B8A8(image, pixelFormat, generateMipmaps, quality);
-			break;
-
+		case tPixelFormat::B8G8R8:
+		case tPixelFormat::B8G8R8A8:
+		case tPixelFormat::G3B5A1R5G2:
+		case tPixelFormat::G4B4A4R4:
 		case tPixelFormat::G3B5R5G3:
-			ProcessImageTo_G3B5R5G3(image, generateMipmaps, quality);
+		case tPixelFormat::L8A8:
+		case tPixelFormat::R32F:
+		case tPixelFormat::G32R32F:
+		case tPixelFormat::A32B32G32R32F:
+			ProcessImageTo_Normal(image, pixelFormat, generateMipmaps, quality);
 			break;
 
 		case tPixelFormat::BC1_DXT1BA:
 		case tPixelFormat::BC1_DXT1:
 		case tPixelFormat::BC2_DXT3:
 		case tPixelFormat::BC3_DXT5:
+		case tPixelFormat::BC4_ATI1:
+		case tPixelFormat::BC5_ATI2:
+		case tPixelFormat::BC6H:
+		case tPixelFormat::BC7:
 			ProcessImageTo_BCTC(image, pixelFormat, generateMipmaps, quality);
 			break;
 
@@ -206,12 +226,12 @@ bool tTexture::Set(tPicture& image, bool generateMipmaps, tPixelFormat pixelForm
 }
 
 
-void tTexture::ProcessImageTo_R8G8B8_Or_R8G8B8A8(tPicture& image, tPixelFormat format, bool generateMipmaps, tQuality quality)
+void tTexture::ProcessImageTo_Normal(tPicture& image, tPixelFormat format, bool generateMipmaps, tQuality quality)
 {
-	tAssert((format == tPixelFormat::R8G8B8) || (format == tPixelFormat::R8G8B8A8));
+	tAssert(tIsNormalFormat(format));
 	int width = image.GetWidth();
 	int height = image.GetHeight();
-	int bytesPerPixel = (format == tPixelFormat::R8G8B8) ? 3 : 4;
+	int bytesPerPixel = tGetBytesPerPixel(format);
 	tPicture::tFilter filter = DetermineFilter(quality);
 
 	// This loop resamples (reduces) the image multiple times for mipmap generation. In general we should start with
@@ -225,15 +245,8 @@ void tTexture::ProcessImageTo_R8G8B8_Or_R8G8B8A8(tPicture& image, tPixelFormat f
 		int numDataBytes = width*height*bytesPerPixel;
 		uint8* layerData = new uint8[numDataBytes];
 
-		// We can just extract the data out directly from RGBA to either RGB or RGBA.
-		uint8* srcPixel = (uint8*)image.GetPixelPointer();
-		uint8* dstPixel = layerData;
-		for (int p = 0; p < width*height; p++)
-		{
-			tStd::tMemcpy(dstPixel, srcPixel, bytesPerPixel);
-			srcPixel += 4;									// Src is always RGBA.
-			dstPixel += bytesPerPixel;						// Dst is RGB or RGBA.
-		}
+		// The picture's pixels are always R8G8B8A8.
+		tConvertPixels(layerData, format, image.GetPixelPointer(), tPixelFormat::R8G8B8A8, width*height);
 
 		tLayer* layer = new tLayer(format, width, height, layerData, true);
 		tAssert(numDataBytes == layer->GetDataSize());
@@ -256,158 +269,23 @@ void tTexture::ProcessImageTo_R8G8B8_Or_R8G8B8A8(tPicture& image, tPixelFormat f
 }
 
 
-void tTexture::ProcessImageTo_G3B5R5G3(tPicture& image, bool generateMipmaps, tQuality quality)
-{
-	int width = image.GetWidth();
-	int height = image.GetHeight();
-	int bytesPerPixel = 2;
-	tPicture::tFilter filter = DetermineFilter(quality);
-
-	// This loop resamples (reduces) the image multiple times for mipmap generation. In general we should start with
-	// the original image every time so that we're not applying interpolations to interpolations (better quality).
-	// However, since we are only using a box-filter (pixel averaging) there is no benefit to having a fresh src
-	// image each time. The math is equivalent: (a+b/2 + c+d/2)/2 = (a+b+c+d)/4. For now we are saving the extra
-	// effort to start with an original every time. If we ever use a more advanced filter we'll need to change this
-	// behaviour. Note: we're now using bilinear as the lower quality filter. Should probably make the change.
-	while (1)
-	{
-		int numDataBytes = width*height*bytesPerPixel;
-		uint8* layerData = new uint8[numDataBytes];
-
-		// We need to change the src data (RGBA) into 16bits.
-		tPixel* srcPixel = image.GetPixelPointer();
-		uint8* dstPixel = layerData;
-		for (int p = 0; p < width*height; p++)
-		{
-			// In memory. Each letter a bit: GGGBBBBB RRRRRGGG
-			dstPixel[0] = (srcPixel->G & 0x1C << 3) | (srcPixel->B >> 3);
-			dstPixel[1] = (srcPixel->R & 0xF8) | (srcPixel->G >> 5);
-			srcPixel++;
-			dstPixel += bytesPerPixel;
-		}
-
-		tLayer* layer = new tLayer(tPixelFormat::G3B5R5G3, width, height, layerData, true);
-		tAssert(numDataBytes == layer->GetDataSize());
-		Layers.Append(layer);
-
-		// Was this the last one?
-		if (((width == 1) && (height == 1)) || !generateMipmaps)
-			break;
-
-		// Remember, width and height are not necessarily the same. As soon as one reaches 1 it needs to stay there until
-		// the other gets there too.
-		if (width != 1)
-			width >>= 1;
-
-		if (height != 1)
-			height >>= 1;
-
-		image.Resize(width, height, filter);
-	}
-}
-
-
-struct tOutputHandler : public nvtt::OutputHandler
-{
-	tOutputHandler()																					{ }
-	virtual ~tOutputHandler()																			{ }
-	void SetReceiveBuffer(uint8* buffer, int bufferSize)												{ Buffer = buffer; BufferSize = bufferSize; BufferWriteIndex = 0; }
-	void beginImage(int size, int width, int height, int depth, int face, int miplevel) override		{ }
-	void endImage() override																			{ }
-	bool writeData(const void* data, int size) override
-	{
-		if (!data || (size <= 0))
-			return true;
-
-		// This may not be all the data at one go.
-		tPrintf("Compressed data size: %d\n", size);
-		tAssert(Buffer);
-		tAssert(size <= (BufferSize - BufferWriteIndex));
-		tStd::tMemcpy(Buffer+BufferWriteIndex, data, size);
-		BufferWriteIndex += size;
-		return true;
-	}
-
-	int BufferWriteIndex = 0;
-	int BufferSize = 0;
-	uint8* Buffer = nullptr;
-};
-
-
-struct tErrorHandler : public nvtt::ErrorHandler
-{
-	void error(nvtt::Error e) override
-	{
-		tPrintf("Error: '%s'\n", nvtt::errorString(e));
-	}
-};
-
-
 void tTexture::ProcessImageTo_BCTC(tPicture& image, tPixelFormat pixelFormat, bool generateMipmaps, tQuality quality)
 {
+	if (!tCanEncodeBC(pixelFormat))
+		throw tError("Unsupported BC pixel format %d.", int(pixelFormat));
+
 	int width = image.GetWidth();
 	int height = image.GetHeight();
 	tPicture::tFilter filter = DetermineFilter(quality);
-	if (!tMath::tIsPower2(width) || !tMath::tIsPower2(height))
-		throw tError("Texture must be power-of-2 to be compressed to a BC format.");
+	tBCQuality bcQuality = (quality == tQuality::Fast) ? tBCQuality::Fast : tBCQuality::High;
 
-	nvtt::Format format = nvtt::Format_BC1;
-	switch (pixelFormat)
-	{
-		case tPixelFormat::BC1_DXT1:	format = nvtt::Format_BC1;	break;
-		case tPixelFormat::BC1_DXT1BA:	format = nvtt::Format_BC1a;	break;
-		case tPixelFormat::BC2_DXT3:	format = nvtt::Format_BC2;	break;
-		case tPixelFormat::BC3_DXT5:	format = nvtt::Format_BC3;	break;
-		case tPixelFormat::BC4_ATI1:	format = nvtt::Format_BC4;	break;
-		case tPixelFormat::BC5_ATI2:	format = nvtt::Format_BC5;	break;
-		default:
-			throw tError("Unsupported BC pixel format %d.", int(pixelFormat));
-	}
-
-	// This loop resamples (reduces) the image multiple times for mipmap generation. In general we should start with
-	// the original image every time so that we're not applying interpolations to interpolations (better quality).
-	// However, since we are only using a box-filter (pixel averaging) there is no benefit to having a fresh src
-	// image each time. The math is equivalent: (a+b/2 + c+d/2)/2 = (a+b+c+d)/4. For now we are saving the extra
-	// effort to start with an original every time. If we ever use a more advanced filter we'll need to change this
-	// behaviour. Note: we're now using bilinear as the lower quality filter. Should probably make the change.
+	// The encoder pads partial blocks itself, so each mipmap is resampled to its true size all the way down to 1x1.
+	// The pixels are encoded in the order they are in memory, the same as the uncompressed formats.
 	while (1)
 	{
-		// We're ready to create the layer.
-		nvtt::InputOptions inputOptions;
-		inputOptions.setMipmapGeneration(false);
-		inputOptions.setAlphaMode(Opaque ? nvtt::AlphaMode_None : nvtt::AlphaMode_Transparency);
-		inputOptions.setWrapMode(nvtt::WrapMode_Clamp);
-		inputOptions.setFormat(nvtt::InputFormat_BGRA_8UB);
-		inputOptions.setTextureLayout(nvtt::TextureType_2D, tMath::tMax(width, 4), tMath::tMax(height, 4));
-		inputOptions.setMipmapData(image.GetPixelPointer(), tMath::tMax(width, 4), tMath::tMax(height, 4));
-
-		nvtt::CompressionOptions compressionOptions;
-		compressionOptions.setFormat(format);
-		if (format == nvtt::Format_BC2)
-			compressionOptions.setQuantization(false, true, false);			// Dither alpha when using BC2.
-		else if (format == nvtt::Format_BC1a)
-			compressionOptions.setQuantization(false, true, true, 127);		// Binary alpha when using BC1a.
-		compressionOptions.setQuality((quality == tQuality::Fast) ? nvtt::Quality_Fastest : nvtt::Quality_Normal);
-
-		tErrorHandler errorHandler;
-		tOutputHandler outputHandler;
-
-		nvtt::OutputOptions outputOptions;
-		outputOptions.setOutputHandler(&outputHandler);
-		outputOptions.setErrorHandler(&errorHandler);
-		outputOptions.setOutputHeader(false);
-
-		nvtt::Context context;
-		context.enableCudaAcceleration(false);
-
-		// Setup the layer data to receive the compressed data.
-		int outputSize = context.estimateSize(inputOptions, compressionOptions);
+		int outputSize = tGetBCEncodedSize(pixelFormat, width, height);
 		uint8* outputData = new uint8[outputSize];
-		outputHandler.SetReceiveBuffer(outputData, outputSize);
-
-		// This is the compress call where it all happens.
-		bool success = context.process(inputOptions, compressionOptions, outputOptions);
-		tAssert(outputHandler.BufferWriteIndex == outputSize);
+		tEncodeBC(outputData, image.GetPixelPointer(), width, height, pixelFormat, bcQuality);
 
 		// The last true in this call allows the layer constructor to steal the outputData pointer. Avoids extra memcpys.
 		tLayer* layer = new tLayer(pixelFormat, width, height, outputData, true);
@@ -424,27 +302,14 @@ void tTexture::ProcessImageTo_BCTC(tPicture& image, tPixelFormat pixelFormat, bo
 		if (height != 1)
 			height >>= 1;
 
-		// When using BC compression we don't ever want to scale lower than 4x4 as that is the individual block size.
-		// we need at least that much data so the compressor can do it's job. Consider a 128x4 texture: Ideally we want
-		// that to rescale to 64x4, rather than 64x2. So it's reasonable to just stop once either dimension reaches 4
-		// because otherwise non-uniform scale issues come into play. In short, we either have to deal with this
-		// distortion, or the cropping issue of just stopping. We do the latter because it's just easier.
-		//
-		// Just because we stop downscaling doesn't mean that we don't generate all the mipmap levels! we still
-		// generate all the way to 1x1. It's only the src data that stops being down-sampled.
-		if ((image.GetWidth() >= 8) && (image.GetHeight() >= 8))
-		{
-			// This code scales by half using the correct quality filter.
-			int newWidth = image.GetWidth() / 2;
-			int newHeight = image.GetHeight() / 2;
-			image.Resize(newWidth, newHeight, filter);
-		}
+		if (!image.Resize(width, height, filter))
+			throw tError("Problem resampling mipmap to %dx%d.", width, height);
 	}
 }
 
 
-// This is legacy code for using Squish directly instead of nVidia Texture Tools 2. Once the Texture Tools version is
-// tested, this can be removed.
+// This is legacy code for using Squish directly instead of the native encoder in tBlockCompress. Once the native
+// encoder is tested, this can be removed.
 #ifdef TEXTURE_USE_SQUISH_LIB
 #include "../../../SDKs/Squish/squish.h"
 
@@ -558,6 +423,114 @@ int tTexture::ComputeMaxNumberOfMipmaps() const
 }
 
 
+bool tTexture::Set(const tTexture& src)
+{
+	if (&src == this)
+		return IsValid();
+
+	Clear();
+	if (!src.IsValid())
+		return false;
+
+	Opaque = src.Opaque;
+	if (src.IsContiguous())
+	{
+		ChainSize = src.ChainSize;
+		ChainData = (uint8*)tMem::tMalloc(size_t(ChainSize), ChainAlignment);
+		tStd::tMemcpy(ChainData, src.ChainData, size_t(ChainSize));
+		for (tLayer* layer = src.Layers.First(); layer; layer = layer->Next())
+			AppendChainLayer(layer->PixelFormat, layer->Width, layer->Height, int64(layer->Data - src.ChainData));
+	}
+	else
+	{
+		for (tLayer* layer = src.Layers.First(); layer; layer = layer->Next())
+			Layers.Append(new tLayer(*layer));
+	}
+
+	return true;
+}
+
+
+void tTexture::MakeContiguous()
+{
+	if (!IsValid() || IsContiguous())
+		return;
+
+	int64 chainSize = 0;
+	for (tLayer* layer = Layers.First(); layer; layer = layer->Next())
+		chainSize = AlignChainOffset(chainSize) + layer->GetDataSize();
+
+	// If the block can't be had the layers are left as they are.
+	ChainData = (uint8*)tMem::tMalloc(size_t(chainSize), ChainAlignment);
+	if (!ChainData)
+		return;
+
+	ChainSize = chainSize;
+	int64 offset = 0;
+	for (tLayer* layer = Layers.First(); layer; layer = layer->Next())
+	{
+		offset = AlignChainOffset(offset);
+		int dataSize = layer->GetDataSize();
+		tStd::tMemcpy(ChainData + offset, layer->Data, dataSize);
+		if (layer->OwnsData)
+			delete[] layer->Data;
+
+		layer->Data = ChainData + offset;
+		layer->OwnsData = false;
+		offset += dataSize;
+	}
+}
+
+
+void tTexture::MakeSeparate()
+{
+	if (!IsContiguous())
+		return;
+
+	for (tLayer* layer = Layers.First(); layer; layer = layer->Next())
+	{
+		int dataSize = layer->GetDataSize();
+		uint8* data = new uint8[dataSize];
+		tStd::tMemcpy(data, layer->Data, dataSize);
+		layer->Data = data;
+		layer->OwnsData = true;
+	}
+
+	tMem::tFree(ChainData);
+	ChainData = nullptr;
+	ChainSize = 0;
+}
+
+
+void tTexture::AppendChainLayer(tPixelFormat format, int width, int height, int64 offset)
+{
+	tLayer* layer = new tLayer();
+	layer->PixelFormat = format;
+	layer->Width = width;
+	layer->Height = height;
+	layer->Data = ChainData + offset;
+	layer->OwnsData = false;
+	Layers.Append(layer);
+}
+
+
+int64 tTexture::GetChainLayerSize(tPixelFormat format, int width, int height)
+{
+	if ((width <= 0) || (height <= 0))
+		return 0;
+
+	int64 numBytes = 0;
+	if (tIsBlockFormat(format))
+		numBytes = int64((width + 3) >> 2) * int64((height + 3) >> 2) * tGetBytesPer4x4PixelBlock(format);
+	else if (tIsNormalFormat(format))
+		numBytes = int64(width) * int64(height) * tGetBytesPerPixel(format);
+
+	// tLayer keeps its data size in an int.
+	const int64 maxLayerSize = 0x7FFFFFFF;
+	return (numBytes <= maxLayerSize) ? numBytes : 0;
+}
+
+
 void tTexture::Save(tChunkWriter& chunk) const
 {
 	chunk.Begin(tChunkID::Image_Texture);
@@ -568,12 +541,45 @@ void tTexture::Save(tChunkWriter& chunk) const
 		}
 		chunk.End();
 
-		chunk.Begin(tChunkID::Image_TextureLayers);
+		// A chunk holds at most an int's worth of bytes. A bigger chain is saved a layer at a time, which loads back
+		// as a separate texture.
+		const int64 maxChainChunkSize = 0x7FFFFFFF;
+		if (IsContiguous() && (ChainSize <= maxChainChunkSize))
 		{
-			for (tLayer* layer = Layers.First(); layer; layer = layer->Next())
-				layer->Save(chunk);
+			chunk.Begin(tChunkID::Image_TextureChain);
+			{
+				// This chunk must be saved first.
+				chunk.Begin(tChunkID::Image_TextureChainProperties);
+				{
+					chunk.Write(Layers.GetNumItems());
+					for (tLayer* layer = Layers.First(); layer; layer = layer->Next())
+					{
+						chunk.Write(layer->PixelFormat);
+						chunk.Write(layer->Width);
+						chunk.Write(layer->Height);
+						chunk.Write(int(layer->Data - ChainData));
+					}
+				}
+				chunk.End();
+
+				// Aligned the same as ChainAlignment so the levels stay aligned in a loaded file buffer.
+				chunk.Begin(tChunkID::Image_TextureChainData, tChunkWriter::Alignment::B16);
+				{
+					chunk.Write(ChainData, int(ChainSize));
+				}
+				chunk.End();
+			}
+			chunk.End();
+		}
+		else
+		{
+			chunk.Begin(tChunkID::Image_TextureLayers);
+			{
+				for (tLayer* layer = Layers.First(); layer; layer = layer->Next())
+					layer->Save(chunk);
+			}
+			chunk.End();
 		}
-		chunk.End();
 	}
 	chunk.End();
 }
@@ -602,6 +608,74 @@ void tTexture::Load(const tChunk& chunk)
 					Layers.Append(new tLayer(layerChunk));
 				break;
 			}
+
+			case tChunkID::Image_TextureChain:
+			{
+				LoadChain(ch);
+				break;
+			}
+		}
+	}
+}
+
+
+void tTexture::LoadChain(const tChunk& chunk)
+{
+	int numLayers = 0;
+	tChunk propChunk;
+	for (tChunk ch = chunk.First(); ch.IsValid(); ch = ch.Next())
+	{
+		switch (ch.ID())
+		{
+			// This chunk must be loaded first. The layer descriptions are read once the data is in place.
+			case tChunkID::Image_TextureChainProperties:
+			{
+				// The count must agree with the number of descriptors actually in the chunk.
+				const int descSize = int(sizeof(tPixelFormat) + 3*sizeof(int));
+				int propSize = ch.GetDataSize();
+				if (propSize < int(sizeof(int)))
+					return;
+
+				ch.GetItem(numLayers);
+				if ((numLayers <= 0) || (numLayers > (propSize - int(sizeof(int))) / descSize))
+					return;
+
+				propChunk = ch;
+				break;
+			}
+
+			case tChunkID::Image_TextureChainData:
+			{
+				int64 dataSize = ch.GetDataSize();
+				if ((numLayers <= 0) || (dataSize <= 0) || ChainData)
+					return;
+
+				// Every descriptor is checked against the chain size before any layer points into the data.
+				struct Desc { tPixelFormat Format; int Width, Height, Offset; };
+				Desc* descs = new Desc[numLayers];
+				bool valid = true;
+				for (int l = 0; (l < numLayers) && valid; l++)
+				{
+					Desc& desc = descs[l];
+					propChunk.GetItem(desc.Format);
+					propChunk.GetItem(desc.Width);
+					propChunk.GetItem(desc.Height);
+					propChunk.GetItem(desc.Offset);
+					int64 layerSize = GetChainLayerSize(desc.Format, desc.Width, desc.Height);
+					valid = (layerSize > 0) && (desc.Offset >= 0) && (int64(desc.Offset) + layerSize <= dataSize);
+				}
+
+				ChainData = valid ? (uint8*)tMem::tMalloc(size_t(dataSize), ChainAlignment) : nullptr;
+				if (ChainData)
+				{
+					ChainSize = dataSize;
+					tStd::tMemcpy(ChainData, ch.Data(), size_t(ChainSize));
+					for (int l = 0; l < numLayers; l++)
+						AppendChainLayer(descs[l].Format, descs[l].Width, descs[l].Height, descs[l].Offset);
+				}
+				delete[] descs;
+				break;
+			}
 		}
 	}
 }
@@ -615,10 +689,10 @@ bool tTexture::operator==(const tTexture& src) const
 	if (Opaque != src.Opaque)
 		return false;
 
-	if (Layers.GetNumItems() != Layers.GetNumItems())
+	if (Layers.GetNumItems() != src.Layers.GetNumItems())
 		return false;
 
-	tLayer* srcLayer = Layers.First();
+	tLayer* srcLayer = src.Layers.First();
 	for (tLayer* layer = Layers.First(); layer; layer = layer->Next(), srcLayer = srcLayer->Next())
 		if (*layer != *srcLayer)
 			return false;
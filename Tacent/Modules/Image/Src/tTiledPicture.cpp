@@ -0,0 +1,278 @@
+// tTiledPicture.cpp
+//
+// A tTiledPicture represents an arbitrarily large image as a grid of square tiles along with a lazily generated mipmap
+// pyramid. Unlike a tPicture it never holds the whole image in memory. Tiles are decoded on demand by a region
+// provider and are kept in a cache with a fixed memory budget. When the budget is exceeded the least recently used
+// tiles are evicted. This allows panning and zooming around images much larger than tLayer::MaxLayerDimension while
+// only touching the tiles that are visible at the level of detail needed.
+//
+// Copyright (c) 2019 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include "Foundation/tStandard.h"
+#include "Math/tFundamentals.h"
+#include "Image/tTiledPicture.h"
+using namespace tImage;
+
+
+bool tTiledPicture::Set(int width, int height, tRegionProvider provider, int64 cacheBudget)
+{
+	Clear();
+	if ((width <= 0) || (height <= 0) || !provider)
+		return false;
+
+	// Count the levels. We stop at the first level that fits in a single tile.
+	NumLevels = 1;
+	for (int w = width, h = height; (w > TileSize) || (h > TileSize); NumLevels++)
+	{
+		w = (w + 1) >> 1;
+		h = (h + 1) >> 1;
+	}
+
+	Levels = new LevelInfo[NumLevels];
+	int w = width;
+	int h = height;
+	for (int l = 0; l < NumLevels; l++)
+	{
+		LevelInfo& level = Levels[l];
+		level.Width = w;
+		level.Height = h;
+		level.NumTilesX = (w + TileSize - 1) / TileSize;
+		level.NumTilesY = (h + TileSize - 1) / TileSize;
+
+		int numTiles = level.NumTilesX * level.NumTilesY;
+		level.Tiles = new Tile*[numTiles];
+		tStd::tMemset(level.Tiles, 0, int(numTiles*sizeof(Tile*)));
+
+		w = tMath::tMax((w + 1) >> 1, 1);
+		h = tMath::tMax((h + 1) >> 1, 1);
+	}
+
+	Provider = provider;
+	CacheBudget = tMath::tMax(cacheBudget, int64(TileNumBytes));
+	NumProviderCalls = 0;
+	NumCacheHits = 0;
+	NumCacheMisses = 0;
+	return true;
+}
+
+
+bool tTiledPicture::Set(tPicture& src, int64 cacheBudget)
+{
+	if (!src.IsValid())
+	{
+		Clear();
+		return false;
+	}
+
+	auto provider = [&src](int x, int y, int w, int h, tPixel* dest, int destStride) -> bool
+	{
+		for (int row = 0; row < h; row++)
+			tStd::tMemcpy(dest + row*destStride, src.GetPixelPointer(x, y + row), w*int(sizeof(tPixel)));
+		return true;
+	};
+
+	return Set(src.GetWidth(), src.GetHeight(), provider, cacheBudget);
+}
+
+
+void tTiledPicture::Clear()
+{
+	FlushCache();
+	for (int l = 0; l < NumLevels; l++)
+		delete[] Levels[l].Tiles;
+
+	delete[] Levels;
+	Levels = nullptr;
+	NumLevels = 0;
+	Provider = nullptr;
+}
+
+
+void tTiledPicture::FlushCache()
+{
+	while (!Cache.IsEmpty())
+	{
+		Tile* tile = Cache.Drop();
+		LevelInfo& level = Levels[tile->Level];
+		level.Tiles[tile->TileY*level.NumTilesX + tile->TileX] = nullptr;
+		delete tile;
+	}
+}
+
+
+void tTiledPicture::SetCacheBudget(int64 budgetBytes)
+{
+	CacheBudget = tMath::tMax(budgetBytes, int64(TileNumBytes));
+	Evict(0);
+}
+
+
+int tTiledPicture::GetLevelForScale(float scale) const
+{
+	int level = 0;
+	float levelScale = 1.0f;
+	while ((level < NumLevels-1) && (levelScale*0.5f >= scale))
+	{
+		levelScale *= 0.5f;
+		level++;
+	}
+
+	return level;
+}
+
+
+const tPixel* tTiledPicture::GetTile(int level, int tileX, int tileY)
+{
+	if (!ValidLevel(level))
+		return nullptr;
+
+	LevelInfo& info = Levels[level];
+	if ((tileX < 0) || (tileY < 0) || (tileX >= info.NumTilesX) || (tileY >= info.NumTilesY))
+		return nullptr;
+
+	int index = tileY*info.NumTilesX + tileX;
+	Tile* tile = info.Tiles[index];
+	if (tile)
+	{
+		// Move to the head so it becomes the most recently used.
+		NumCacheHits++;
+		Cache.Remove(tile);
+		Cache.Insert(tile);
+		return tile->Pixels;
+	}
+
+	// The new tile isn't in the cache while it is being generated, so any recursive GetTile calls for the level below
+	// can't evict it.
+	NumCacheMisses++;
+	tPixel* pixels = tPicture::AllocPixels(TileSize*TileSize);
+	GenerateTile(level, tileX, tileY, pixels);
+
+	tile = new Tile(level, tileX, tileY, pixels);
+	Insert(tile);
+	return tile->Pixels;
+}
+
+
+void tTiledPicture::GenerateTile(int level, int tileX, int tileY, tPixel* dest)
+{
+	tStd::tMemset(dest, 0, TileNumBytes);
+	if (level == 0)
+	{
+		int x = tileX*TileSize;
+		int y = tileY*TileSize;
+		int w = tMath::tMin(TileSize, Levels[0].Width - x);
+		int h = tMath::tMin(TileSize, Levels[0].Height - y);
+
+		NumProviderCalls++;
+		if (!Provider(x, y, w, h, dest, TileSize))
+			tStd::tMemset(dest, 0, TileNumBytes);
+		return;
+	}
+
+	// Each of the (up to) four tiles below this one contributes a quarter of the pixels. We fetch and filter them one at
+	// a time so that only a single child tile pointer is ever held. At the right and top edges the child may have an odd
+	// number of valid pixels, in which case the last row or column is duplicated.
+	const LevelInfo& src = Levels[level-1];
+	const int halfTile = TileSize >> 1;
+	for (int cy = 0; cy < 2; cy++)
+	{
+		for (int cx = 0; cx < 2; cx++)
+		{
+			int childX = 2*tileX + cx;
+			int childY = 2*tileY + cy;
+			if ((childX >= src.NumTilesX) || (childY >= src.NumTilesY))
+				continue;
+
+			const tPixel* child = GetTile(level-1, childX, childY);
+			int childW = tMath::tMin(TileSize, src.Width - childX*TileSize);
+			int childH = tMath::tMin(TileSize, src.Height - childY*TileSize);
+			int destW = (childW + 1) >> 1;
+			int destH = (childH + 1) >> 1;
+
+			for (int y = 0; y < destH; y++)
+			{
+				const tPixel* row0 = child + (2*y)*TileSize;
+				const tPixel* row1 = child + tMath::tMin(2*y + 1, childH - 1)*TileSize;
+				tPixel* destRow = dest + (cy*halfTile + y)*TileSize + cx*halfTile;
+				for (int x = 0; x < destW; x++)
+				{
+					int x0 = 2*x;
+					int x1 = tMath::tMin(2*x + 1, childW - 1);
+					for (int c = 0; c < 4; c++)
+					{
+						int sum = row0[x0].E[c] + row0[x1].E[c] + row1[x0].E[c] + row1[x1].E[c];
+						destRow[x].E[c] = uint8((sum + 2) >> 2);
+					}
+				}
+			}
+		}
+	}
+}
+
+
+void tTiledPicture::Insert(Tile* tile)
+{
+	Evict(TileNumBytes);
+	Cache.Insert(tile);
+
+	LevelInfo& level = Levels[tile->Level];
+	level.Tiles[tile->TileY*level.NumTilesX + tile->TileX] = tile;
+}
+
+
+void tTiledPicture::Evict(int numBytesNeeded)
+{
+	while (!Cache.IsEmpty() && (GetCacheNumBytes() + numBytesNeeded > CacheBudget))
+	{
+		Tile* tile = Cache.Drop();
+		LevelInfo& level = Levels[tile->Level];
+		level.Tiles[tile->TileY*level.NumTilesX + tile->TileX] = nullptr;
+		delete tile;
+	}
+}
+
+
+bool tTiledPicture::GetRegion(tPicture& dest, int level, int x, int y, int w, int h)
+{
+	if (!ValidLevel(level))
+		return false;
+
+	const LevelInfo& info = Levels[level];
+	int x0 = tMath::tMax(x, 0);
+	int y0 = tMath::tMax(y, 0);
+	int x1 = tMath::tMin(x + w, info.Width);
+	int y1 = tMath::tMin(y + h, info.Height);
+	if ((x1 <= x0) || (y1 <= y0))
+		return false;
+
+	dest.Set(x1 - x0, y1 - y0);
+	for (int tileY = y0 / TileSize; tileY <= (y1 - 1) / TileSize; tileY++)
+	{
+		for (int tileX = x0 / TileSize; tileX <= (x1 - 1) / TileSize; tileX++)
+		{
+			const tPixel* tile = GetTile(level, tileX, tileY);
+			tAssert(tile);
+
+			// Overlap of this tile with the requested region in level coordinates.
+			int ox0 = tMath::tMax(x0, tileX*TileSize);
+			int oy0 = tMath::tMax(y0, tileY*TileSize);
+			int ox1 = tMath::tMin(x1, (tileX+1)*TileSize);
+			int oy1 = tMath::tMin(y1, (tileY+1)*TileSize);
+			for (int row = oy0; row < oy1; row++)
+			{
+				const tPixel* src = tile + (row - tileY*TileSize)*TileSize + (ox0 - tileX*TileSize);
+				tStd::tMemcpy(dest.GetPixelPointer(ox0 - x0, row - y0), src, (ox1 - ox0)*int(sizeof(tPixel)));
+			}
+		}
+	}
+
+	return true;
+}
@@ -569,6 +569,9 @@ namespace tChunkID
 			Image_TextureProperties																= 0x01040110,			// Opaque.
 			Image_TextureLayers																	= 0x81040120,
 				Previous(Image_Layer)
+			Image_TextureChain																	= 0x81040130,
+				Image_TextureChainProperties													= 0x01040140,			// Num layers. Pixel format, width, height, offset of each.
+				Image_TextureChainData															= 0x01040150,
 
 		Image_Cubemap																			= 0x81040200,
 			Image_CubemapProperties																= 0x01040208,			// All opaque.
@@ -576,6 +579,8 @@ namespace tChunkID
 				Image_CubemapSide																= 0x01040220,
 					Image_CubemapSideProperties													= 0x01040230,			// tSide.
 					Previous(Image_Texture)
+
+		Image_PerceptualHash																	= 0x01040300,			// dHash, pHash.
 	};
 
 	// Rendering chunk IDs.
@@ -86,6 +86,7 @@ enum class tFileType
 	WMF,							// Image.
 	JP2,							// Image.
 	JPC,							// Image.
+	QOI,							// Image.
 
 	TEX,							// TextureMap.
 	IMG,							// TextureMap.
@@ -288,6 +289,11 @@ bool tCopyFile(const tString& dest, const tString& src, bool overWriteReadOnly =
 // rename is located.
 bool tRenameFile(const tString& dir, const tString& oldName, const tString& newName);
 
+// Replaces dest with src in one step, so a reader sees either the old file or the new one and never a partial write.
+// Write to a temporary file in the same directory and then call this. Dest does not need to exist. Returns true on
+// success.
+bool tReplaceFile(const tString& dest, const tString& src);
+
 // fileMask may contain stuff like 'c:/Scenes/Art*.max'. The foundfiles list is always appended to. You must clear it
 // first if that's what you intend. If no second argument, the contents of the current directory are returned. The
 // filenames in foundFiles are absolute. Use GetFileName if you only care about the filename. If you're looking for
@@ -14,6 +14,7 @@
 // PERFORMANCE OF THIS SOFTWARE.
 
 #pragma once
+#include <functional>
 #include <Foundation/tString.h>
 #include "System/tThrow.h"
 #include "System/tPrint.h"
@@ -34,6 +35,11 @@ tString tGetIPAddress();
 // Returns the number of cores (processors) the current machine has.
 int tGetNumCores();
 
+// Calls work(index) for every index in [0, count). The calls are spread over numThreads threads, one of which is the
+// calling thread. Threads pull indices from a shared counter so uneven workloads balance out. If numThreads <= 0, one
+// thread per core is used. Returns after all calls have completed. The work function must be thread-safe.
+void tParallelFor(int count, std::function<void(int index)> work, int numThreads = -1);
+
 // Opens the Os's file explorer for the folder and file specified. If file doesn't exist, no file will be selected.
 // If dir doesn't exist, an explorer window is opened at a location decided by the system.
 bool tOpenSystemFileExplorer(const tString& dir, const tString& file);
@@ -173,6 +173,7 @@ tSystem::tFileType tSystem::tGetFileTypeFromExtension(const tString& e)
 		{ "wmf",		tFileType::WMF				},
 		{ "jp2",		tFileType::JP2				},
 		{ "jpc",		tFileType::JPC				},
+		{ "qoi",		tFileType::QOI				},
 		{ "tex",		tFileType::TEX				},
 		{ "img",		tFileType::IMG				},
 		{ "cub",		tFileType::CUB				},
@@ -1542,6 +1543,19 @@ bool tSystem::tRenameFile(const tString& dir, const tString& oldName, const tStr
 }
 
 
+bool tSystem::tReplaceFile(const tString& dest, const tString& src)
+{
+	tString destName = dest;
+	destName.Replace('/', '\\');
+
+	tString srcName = src;
+	srcName.Replace('/', '\\');
+
+	int success = ::MoveFileEx(srcName, destName, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+	return success ? true : false;
+}
+
+
 void tSystem::tFindDirs(tList<tStringItem>& foundDirs, const tString& dirMask, bool includeHidden)
 {
 	// First lets massage fileName a little.
@@ -17,6 +17,8 @@
 #include <Windows.h>
 #include <intrin.h>
 #endif
+#include <thread>
+#include <atomic>
 #include "Foundation/tStandard.h"
 #include "System/tFile.h"
 #include "System/tMachine.h"
@@ -130,3 +132,39 @@ bool tSystem::tOpenSystemFileExplorer(const tString& fullFilename)
 
 
 #endif
+
+
+void tSystem::tParallelFor(int count, std::function<void(int index)> work, int numThreads)
+{
+	if (count <= 0)
+		return;
+
+	if (numThreads <= 0)
+		numThreads = tGetNumCores();
+	if (numThreads > count)
+		numThreads = count;
+
+	if (numThreads <= 1)
+	{
+		for (int i = 0; i < count; i++)
+			work(i);
+		return;
+	}
+
+	std::atomic<int> nextIndex(0);
+	auto worker = [&]()
+	{
+		for (int i = nextIndex++; i < count; i = nextIndex++)
+			work(i);
+	};
+
+	std::thread* threads = new std::thread[numThreads-1];
+	for (int t = 0; t < numThreads-1; t++)
+		threads[t] = std::thread(worker);
+
+	worker();
+	for (int t = 0; t < numThreads-1; t++)
+		threads[t].join();
+
+	delete[] threads;
+}
@@ -0,0 +1,164 @@
+// AtlasTest.cpp
+//
+// Packs thousands of generated sprites of mixed sizes and shapes with each atlas method, with and without rotation,
+// and prints the time, pages and occupancy of each. Checks that every sprite is placed inside its page without
+// overlapping another, that its pixels were copied there, and that building again gives the same placements.
+//
+// Copyright (c) 2020 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <Math/tFundamentals.h>
+#include <System/tTime.h>
+#include <System/tPrint.h>
+#include <Image/tAtlas.h>
+#include "Fixtures.h"
+#include "Tests.h"
+using namespace tImage;
+
+
+namespace
+{
+	const int NumBenchSprites = 4000;
+
+	// Returns a description of the first thing wrong with the placement of sprite s, or nullptr if it is fine.
+	const char* CheckPlacement
+	(
+		const tAtlas& atlas, const tAtlas& again, const tPicture* const* pages, int numPages,
+		const tPicture& sprite, int s, const tAtlasSettings& settings
+	)
+	{
+		const tAtlasPlacement& p = atlas.Placements[s];
+		const tAtlasPlacement& q = again.Placements[s];
+		const tPicture* page = ((p.Page >= 0) && (p.Page < numPages)) ? pages[p.Page] : nullptr;
+		int e = settings.Extrude;
+		bool rotated = (p.Width != sprite.GetWidth()) || (p.Height != sprite.GetHeight());
+
+		if ((p.Page != q.Page) || (p.X != q.X) || (p.Y != q.Y) || (p.Rotated != q.Rotated))
+			return "Building again gave different placements.";
+		if (!page)
+			return "A sprite was not placed.";
+		if ((p.X - e < 0) || (p.Y - e < 0))
+			return "A sprite is outside its page.";
+		if ((p.X + p.Width + e > page->GetWidth()) || (p.Y + p.Height + e > page->GetHeight()))
+			return "A sprite is outside its page.";
+		if (rotated != p.Rotated)
+			return "A sprite's size doesn't match its rotation.";
+		if (page->GetPixel(p.X + p.Width/2, p.Y + p.Height/2) != sprite.GetPixel(0, 0))
+			return "A sprite's pixels are not where it was placed.";
+
+		// Extruded rectangles must keep the padding between them.
+		int gap = settings.Padding + 2*e;
+		for (int o = 0; o < s; o++)
+		{
+			const tAtlasPlacement& other = atlas.Placements[o];
+			if
+			(
+				(other.Page == p.Page) && (other.X < p.X + p.Width + gap) && (p.X < other.X + other.Width + gap) &&
+				(other.Y < p.Y + p.Height + gap) && (p.Y < other.Y + other.Height + gap)
+			)
+				return "Two sprites overlap.";
+		}
+
+		return nullptr;
+	}
+}
+
+
+bool Test::AtlasBench()
+{
+	Checks check("AtlasBench");
+
+	// Mostly small icons, some larger pieces, and a few long thin ones that only pack well when rotated. Each sprite
+	// is a solid colour made from its index so the copy can be checked at any pixel.
+	tList<tPicture> sprites;
+	uint32 seed = 1;
+	for (int s = 0; s < NumBenchSprites; s++)
+	{
+		int kind = Random(seed, 100);
+		int width, height;
+		if (kind < 70)
+		{
+			width = 8 + Random(seed, 41);
+			height = tMath::tClamp(width + Random(seed, 17) - 8, 8, 48);
+		}
+		else if (kind < 95)
+		{
+			width = 16 + Random(seed, 113);
+			height = 16 + Random(seed, 113);
+		}
+		else
+		{
+			width = 64 + Random(seed, 193);
+			height = 4 + Random(seed, 13);
+		}
+		tPixel colour(uint8(s), uint8(s >> 8), uint8(0xA5), uint8(0xFF));
+		tPicture* sprite = new tPicture;
+		sprite->Set(width, height, colour);
+		sprites.Append(sprite);
+	}
+
+	struct Config { const char* Name; tAtlasMethod Method; bool Rotation; };
+	Config configs[] =
+	{
+		{ "MaxRects",						tAtlasMethod::MaxRects,	false },
+		{ "MaxRects with rotation",			tAtlasMethod::MaxRects,	true },
+		{ "Skyline",						tAtlasMethod::Skyline,	false },
+		{ "Skyline with rotation",			tAtlasMethod::Skyline,	true }
+	};
+
+	tPrintf
+	(
+		"Packing %d sprites into 2048x2048 power-of-two pages with 1 pixel padding and extrusion.\n", NumBenchSprites
+	);
+	for (const Config& config : configs)
+	{
+		tAtlasSettings settings;
+		settings.Method = config.Method;
+		settings.AllowRotation = config.Rotation;
+		settings.Padding = 1;
+		settings.Extrude = 1;
+
+		tAtlas atlas;
+		double start = tSystem::tGetTimeDouble();
+		bool built = atlas.Build(sprites, settings);
+		double buildTime = tSystem::tGetTimeDouble() - start;
+
+		tAtlas again;
+		again.Build(sprites, settings);
+
+		int numBad = 0;
+		const char* problem = "Build failed.";
+		tPicture** pages = new tPicture*[tMath::tMax(atlas.GetNumPages(), 1)];
+		int numPages = 0;
+		for (tPicture* page = atlas.Pages.First(); page; page = page->Next())
+			pages[numPages++] = page;
+
+		const tPicture* sprite = sprites.First();
+		for (int s = 0; built && (s < NumBenchSprites); s++, sprite = sprite->Next())
+		{
+			const char* error = CheckPlacement(atlas, again, pages, numPages, *sprite, s, settings);
+			if (error)
+			{
+				numBad++;
+				problem = error;
+			}
+		}
+		delete[] pages;
+
+		tPrintf
+		(
+			"%-24s %8.2fms %8.0f sprites/s %3d pages %5.1f%% occupancy\n", config.Name, buildTime*1000.0,
+			double(NumBenchSprites)/buildTime, atlas.GetNumPages(), atlas.GetOccupancy()*100.0f
+		);
+		check(built && !numBad, "%s: %d sprites. %s", config.Name, numBad, problem);
+	}
+
+	return check.Report();
+}
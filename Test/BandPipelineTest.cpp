@@ -0,0 +1,311 @@
+// BandPipelineTest.cpp
+//
+// Runs pictures of several sizes through each band stage and compares the result with doing the same thing to the
+// whole picture. Crops, rotates and conversions must match exactly. Resampling has its own filters, so it must give
+// the same pixels whatever the band size or prefetching and be close to tPicture::Resample. Checks the targa and qoi
+// sources and the targa, png and qoi sinks against whole file loads. The benchmark crops and halves a big targa into
+// a png both ways and prints the times.
+//
+// Copyright (c) 2020 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <Math/tFundamentals.h>
+#include <System/tFile.h>
+#include <System/tTime.h>
+#include <System/tPrint.h>
+#include <Image/tBandPipeline.h>
+#include <Image/tPixelConvert.h>
+#include <Image/tFileTGA.h>
+#include <Image/tFileQOI.h>
+#include <Image/tPicture.h>
+#include "Fixtures.h"
+#include "Tests.h"
+using namespace tImage;
+
+
+namespace
+{
+	// One row at a time, a band that doesn't divide any of the heights, the default, and more than the whole image.
+	const int NumBandSizes = 4;
+	const int BandSizes[NumBandSizes] = { 1, 7, 64, 4096 };
+
+	bool IsSame(const tPicture& a, const tPicture& b)
+	{
+		return
+			a.IsValid() && b.IsValid() && (a.GetWidth() == b.GetWidth()) && (a.GetHeight() == b.GetHeight()) &&
+			!Test::CountDifferences(a.GetPixels(), b.GetPixels(), a.GetNumPixels());
+	}
+
+	bool Stream(tPicture& result, tBandSource& source, int bandRows)
+	{
+		tBandPictureSink sink(result);
+		return tStream(sink, source, bandRows);
+	}
+
+	// Crops the whole picture and the bands the same way.
+	bool IsCropSame(const tPicture& picture, int newW, int newH, int originX, int originY, int bandRows)
+	{
+		tPicture whole(picture);
+		whole.Crop(newW, newH, originX, originY);
+
+		tBandPictureSource source(picture.GetView());
+		tBandCrop crop(source, newW, newH, originX, originY);
+		tPicture banded;
+		return Stream(banded, crop, bandRows) && IsSame(banded, whole);
+	}
+
+	bool IsRotateSame(const tPicture& picture, bool antiClockwise, const tString& scratchFile, int bandRows)
+	{
+		tPicture whole(picture);
+		whole.Rotate90(antiClockwise);
+
+		tBandPictureSource source(picture.GetView());
+		tBandRotate90 rotate(source, antiClockwise, scratchFile);
+		tPicture banded;
+		return Stream(banded, rotate, bandRows) && IsSame(banded, whole);
+	}
+
+	bool IsConvertSame(const tPicture& picture, tPixelFormat format, int bandRows)
+	{
+		int numPixels = picture.GetNumPixels();
+		uint8* converted = new uint8[numPixels*tGetPixelLayout(format)->BytesPerPixel];
+		tPicture whole(picture);
+		bool ok =
+			tConvertPixels(converted, format, picture.GetPixels(), tPixelFormat::R8G8B8A8, numPixels) &&
+			tConvertPixels(whole.GetPixelPointer(), tPixelFormat::R8G8B8A8, converted, format, numPixels);
+		delete[] converted;
+
+		tBandPictureSource source(picture.GetView());
+		tBandConvert convert(source, format);
+		tPicture banded;
+		return ok && Stream(banded, convert, bandRows) && IsSame(banded, whole);
+	}
+
+	// The band filters are computed separately so they are compared with each other exactly and with the whole
+	// picture resample by PSNR.
+	bool Resample(tPicture& result, const tPicture& picture, int newW, int newH, int bandRows, bool prefetch)
+	{
+		tBandPictureSource source(picture.GetView());
+		tBandPrefetch ahead(source, 16, 3);
+		tBandSource& input = prefetch ? (tBandSource&)ahead : (tBandSource&)source;
+		tBandResample resample(input, newW, newH, tPicture::tFilter::Bicubic);
+		return Stream(result, resample, bandRows);
+	}
+}
+
+
+bool Test::BandPipeline()
+{
+	Checks check("BandPipeline");
+	tString dir = GetDataDir("BandPipeline");
+	tString scratchFile = dir + "Scratch.tmp";
+
+	const int sizes[][2] = { { 1, 1 }, { 1, 37 }, { 67, 45 }, { 300, 211 } };
+	uint32 seed = 1;
+	for (int s = 0; s < tNumElements(sizes); s++)
+	{
+		int width = sizes[s][0];
+		int height = sizes[s][1];
+		tPicture picture(width, height);
+		MakePatternPixels(picture.GetPixelPointer(), width, height, NumPatterns-1, seed);
+
+		int numWrong = 0;
+		for (int b = 0; b < NumBandSizes; b++)
+		{
+			int bandRows = BandSizes[b];
+			tBandPictureSource source(picture.GetView());
+			tPicture copy;
+			if (!Stream(copy, source, bandRows) || !IsSame(copy, picture))
+				numWrong++;
+
+			// Inside, reaching past every edge, and a single pixel in the top right corner.
+			if (!IsCropSame(picture, tMath::tMax(1, width-10), tMath::tMax(1, height-7), width/4, height/3, bandRows))
+				numWrong++;
+			if (!IsCropSame(picture, width+9, height+4, -5, -2, bandRows))
+				numWrong++;
+			if (!IsCropSame(picture, 1, 1, width-1, height-1, bandRows))
+				numWrong++;
+
+			if (!IsRotateSame(picture, true, scratchFile, bandRows))
+				numWrong++;
+			if (!IsRotateSame(picture, false, scratchFile, bandRows))
+				numWrong++;
+
+			if (!IsConvertSame(picture, tPixelFormat::L8A8, bandRows))
+				numWrong++;
+			if (!IsConvertSame(picture, tPixelFormat::G3B5R5G3, bandRows))
+				numWrong++;
+		}
+		check(!numWrong, "%dx%d differs from the whole picture %d times.", width, height, numWrong);
+		check(!tSystem::tFileExists(scratchFile), "%dx%d left the rotate scratch file behind.", width, height);
+	}
+
+	// Resampling a smooth picture up and down. Every band size, with and without prefetching, gives the same pixels.
+	const int resampleW = 300;
+	const int resampleH = 211;
+	tPicture smooth(resampleW, resampleH);
+	MakePatternPixels(smooth.GetPixelPointer(), resampleW, resampleH, 1, seed);
+	const int newSizes[][2] = { { 150, 105 }, { 517, 333 }, { 97, 400 } };
+	for (int n = 0; n < tNumElements(newSizes); n++)
+	{
+		int newW = newSizes[n][0];
+		int newH = newSizes[n][1];
+		tPicture first;
+		bool ok = Resample(first, smooth, newW, newH, 64, false);
+		int numWrong = 0;
+		for (int b = 0; ok && (b < NumBandSizes); b++)
+		{
+			for (int prefetch = 0; prefetch < 2; prefetch++)
+			{
+				tPicture banded;
+				bool resampled = Resample(banded, smooth, newW, newH, BandSizes[b], prefetch ? true : false);
+				if (!resampled || !IsSame(banded, first))
+					numWrong++;
+			}
+		}
+		check(ok && !numWrong, "Resampling to %dx%d changed with the band size %d times.", newW, newH, numWrong);
+
+		tPicture whole(smooth);
+		whole.Resample(newW, newH, tPicture::tFilter::Bicubic);
+		bool sameSize = (whole.GetWidth() == newW) && (whole.GetHeight() == newH) && first.IsValid();
+		double psnr = sameSize ? GetPSNR(first.GetPixels(), whole.GetPixels(), whole.GetNumPixels()) : 0.0;
+		check(psnr >= 30.0, "Resampling to %dx%d is %.1f dB from the whole picture resample.", newW, newH, psnr);
+	}
+
+	// The file sources read what the whole file savers wrote, and the sinks write what the whole file loaders read.
+	const int fileW = 300;
+	const int fileH = 211;
+	tPicture picture(fileW, fileH);
+	MakePatternPixels(picture.GetPixelPointer(), fileW, fileH, NumPatterns-1, seed);
+	tString tgaFile = dir + "Band.tga";
+	tString qoiFile = dir + "Band.qoi";
+	tString pngFile = dir + "Band.png";
+
+	tFileTGA(picture.GetPixelPointer(), fileW, fileH).Save(tgaFile, tFileTGA::tFormat::Bit32);
+	tBandTGASource tgaSource(tgaFile);
+	tPicture fromTGA;
+	check(Stream(fromTGA, tgaSource, 7) && IsSame(fromTGA, picture), "The targa source differs from the picture.");
+
+	tFileQOI::Save(qoiFile, picture.GetView(), tFileQOI::tFormat::Bit32);
+	tBandQOISource qoiSource(qoiFile);
+	tPicture fromQOI;
+	check(Stream(fromQOI, qoiSource, 7) && IsSame(fromQOI, picture), "The qoi source differs from the picture.");
+
+	int numSinksWrong = 0;
+	for (int b = 0; b < NumBandSizes; b++)
+	{
+		tBandPictureSource tgaInput(picture.GetView());
+		tBandTGASink tgaSink(tgaFile, tFileTGA::tFormat::Bit32);
+		tFileTGA tga;
+		if (!tStream(tgaSink, tgaInput, BandSizes[b]) || !tga.Load(tgaFile))
+			numSinksWrong++;
+		else if (!IsSame(tPicture(fileW, fileH, tga.GetPixels()), picture))
+			numSinksWrong++;
+
+		tBandPictureSource qoiInput(picture.GetView());
+		tBandQOISink qoiSink(qoiFile, tFileQOI::tFormat::Bit32);
+		tFileQOI qoi;
+		if (!tStream(qoiSink, qoiInput, BandSizes[b]) || !qoi.Load(qoiFile))
+			numSinksWrong++;
+		else if (!IsSame(tPicture(fileW, fileH, qoi.GetPixels()), picture))
+			numSinksWrong++;
+
+		tBandPictureSource pngInput(picture.GetView());
+		tBandPNGSink pngSink(pngFile, tFilePNG::tFormat::Bit32, tFilePNG::tLevel::Fast);
+		tPicture fromPNG;
+		if (!tStream(pngSink, pngInput, BandSizes[b]) || !fromPNG.Load(pngFile) || !IsSame(fromPNG, picture))
+			numSinksWrong++;
+	}
+	check(!numSinksWrong, "The file sinks differ from the picture %d times.", numSinksWrong);
+
+	// A chain from a file to a file is the same as loading, editing and saving the whole picture.
+	tPicture whole(picture);
+	whole.Crop(250, 200, 20, 5);
+	whole.Rotate90(false);
+	tBandTGASource chainSource(tgaFile);
+	tBandCrop chainCrop(chainSource, 250, 200, 20, 5);
+	tBandPrefetch chainPrefetch(chainCrop);
+	tBandRotate90 chainRotate(chainPrefetch, false, scratchFile);
+	tBandQOISink chainSink(qoiFile, tFileQOI::tFormat::Bit32);
+	tFileQOI chained;
+	bool chainOk = tStream(chainSink, chainRotate) && chained.Load(qoiFile);
+	chainOk = chainOk && IsSame(tPicture(chained.GetWidth(), chained.GetHeight(), chained.GetPixels()), whole);
+	check(chainOk, "A targa to qoi chain differs from editing the whole picture.");
+
+	// Bad input gives invalid sources that stream nothing.
+	tBandTGASource missing(dir + "Missing.tga");
+	tPicture nothing;
+	check(!missing.IsValid() && !Stream(nothing, missing, 64) && !nothing.IsValid(), "A missing targa streamed.");
+
+	tSystem::tDeleteFile(tgaFile);
+	tSystem::tDeleteFile(qoiFile);
+	tSystem::tDeleteFile(pngFile);
+	return check.Report();
+}
+
+
+bool Test::BandPipelineBench()
+{
+	Checks check("BandPipelineBench");
+	tString dir = GetDataDir("BandPipeline");
+	tString tgaFile = dir + "Bench.tga";
+	tString wholeFile = dir + "Whole.png";
+	tString bandFile = dir + "Band.png";
+
+	const int benchSize = 4096;
+	const int cropSize = 4000;
+	const int outSize = cropSize/2;
+	uint32 seed = 1;
+	{
+		// The smooth pattern, since halving noise depends too much on the filter to compare the outputs.
+		tPicture source(benchSize, benchSize);
+		MakePatternPixels(source.GetPixelPointer(), benchSize, benchSize, 1, seed);
+		tFileTGA(source.GetPixelPointer(), benchSize, benchSize).Save(tgaFile, tFileTGA::tFormat::Bit32);
+	}
+
+	// The whole picture is loaded, cropped, resampled and saved. The pipeline holds a few bands at a time.
+	double start = tSystem::tGetTimeDouble();
+	tPicture whole;
+	bool wholeOk = whole.Load(tgaFile);
+	whole.Crop(cropSize, cropSize, 48, 48);
+	wholeOk = wholeOk && whole.Resample(outSize, outSize, tPicture::tFilter::Bilinear);
+	wholeOk = wholeOk && whole.SavePNG(wholeFile, tFilePNG::tFormat::Bit32, tFilePNG::tLevel::Fastest);
+	double wholeTime = tSystem::tGetTimeDouble() - start;
+	int64 wholeBytes = int64(benchSize)*benchSize*sizeof(tPixel) + int64(cropSize)*cropSize*sizeof(tPixel);
+
+	double bandTimes[2];
+	for (int prefetch = 0; prefetch < 2; prefetch++)
+	{
+		start = tSystem::tGetTimeDouble();
+		tBandTGASource source(tgaFile);
+		tBandPrefetch ahead(source);
+		tBandCrop crop(prefetch ? (tBandSource&)ahead : (tBandSource&)source, cropSize, cropSize, 48, 48);
+		tBandResample resample(crop, outSize, outSize, tPicture::tFilter::Bilinear);
+		tBandPNGSink sink(bandFile, tFilePNG::tFormat::Bit32, tFilePNG::tLevel::Fastest);
+		check(tStream(sink, resample), "The pipeline failed.");
+		bandTimes[prefetch] = tSystem::tGetTimeDouble() - start;
+	}
+
+	tPicture banded;
+	bool bandOk = banded.Load(bandFile) && (banded.GetWidth() == outSize) && (banded.GetHeight() == outSize);
+	double psnr = (wholeOk && bandOk) ? GetPSNR(banded.GetPixels(), whole.GetPixels(), whole.GetNumPixels()) : 0.0;
+	check(wholeOk && bandOk && (psnr >= 30.0), "The pipeline output is %.1f dB from the whole picture.", psnr);
+
+	tPrintf("%dx%d targa, crop to %d, resample to %d, png\n", benchSize, benchSize, cropSize, outSize);
+	double wholeMB = double(wholeBytes)/(1024.0*1024.0);
+	tPrintf("Whole picture      %8.1f ms  %6.1f MB of pixels held\n", wholeTime*1000.0, wholeMB);
+	tPrintf("Bands              %8.1f ms\n", bandTimes[0]*1000.0);
+	tPrintf("Bands prefetched   %8.1f ms\n", bandTimes[1]*1000.0);
+
+	tSystem::tDeleteFile(tgaFile);
+	tSystem::tDeleteFile(wholeFile);
+	tSystem::tDeleteFile(bandFile);
+	return check.Report();
+}
@@ -0,0 +1,603 @@
+// BlockCompressTest.cpp
+//
+// Encodes a synthetic 512x512 image in every BC format at every quality and prints the error and the megapixels per
+// second on one thread, next to Texture Tools at its fastest and normal settings. Checks only the output. Each quality
+// must be at least as accurate as the one below it, Normal must be within 5% of the error of Texture Tools at its
+// fastest and High within 5% of Texture Tools at normal. BC7 is measured in PSNR and must reach a floor at each
+// quality and come within 0.2 dB of Texture Tools on a 64x64 image, since Texture Tools is too slow at BC7 for the
+// whole one. BC6H is measured as the RMSE of log2(1 + value) on an HDR version of the image. Also checks that the
+// output does not depend on the thread count, that single colours come back near exact, and that odd sizes stay inside
+// their buffers. This is the only part of the project that uses Texture Tools.
+//
+// Copyright (c) 2020 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <math.h>
+#include <Math/tFundamentals.h>
+#include <System/tTime.h>
+#include <System/tPrint.h>
+#include <Image/tBlockCompress.h>
+#include <nvtt/nvtt.h>
+#include "Fixtures.h"
+#include "Tests.h"
+using namespace tImage;
+
+
+namespace
+{
+	const int ImageWidth = 512;
+	const int ImageHeight = 512;
+
+	const tPixelFormat Formats[] =
+	{
+		tPixelFormat::BC1_DXT1, tPixelFormat::BC1_DXT1BA, tPixelFormat::BC2_DXT3, tPixelFormat::BC3_DXT5,
+		tPixelFormat::BC4_ATI1, tPixelFormat::BC5_ATI2
+	};
+	const int NumFormats = tNumElements(Formats);
+
+	const tBCQuality Qualities[] = { tBCQuality::Fast, tBCQuality::Normal, tBCQuality::High };
+	const int NumQualities = tNumElements(Qualities);
+
+	// How much more error than Texture Tools is allowed. The small epsilon keeps the checks from depending on the last
+	// bit of the float maths.
+	const double Worse = 1.05;
+	const double Epsilon = 0.001;
+
+	// The BC7 floors leave some room below what each quality gets now on images of 256x256 and up.
+	const double MinBC7PSNR[NumQualities] = { 30.0, 36.0, 37.5 };
+	const int BC7RefSide = 64;
+	const double MaxBC7RefLoss = 0.2;
+
+	// The test image is smooth gradients with hard edged discs on top, a band of thin stripes along the bottom, and a
+	// little noise so no block is perfectly flat. Alpha ramps up from left to right and every other disc is a hole, so
+	// BC1 with binary alpha gets both kinds of pixel.
+	void MakeTestPixels(tPixel* pixels, int width, int height, uint32& seed)
+	{
+		const int numDiscs = 32;
+		int discs[numDiscs][3];
+		tPixel discColours[numDiscs];
+		int maxRadius = tMath::tMax(tMath::tMin(width, height)/8, 1);
+		for (int d = 0; d < numDiscs; d++)
+		{
+			discs[d][0] = Test::Random(seed) % width;
+			discs[d][1] = Test::Random(seed) % height;
+			discs[d][2] = 1 + Test::Random(seed) % maxRadius;
+			uint32 random = Test::Random(seed);
+			discColours[d].Set(int(random & 0xFF), int((random >> 8) & 0xFF), int(random >> 16));
+		}
+
+		for (int y = 0; y < height; y++)
+		{
+			for (int x = 0; x < width; x++)
+			{
+				float u = float(x) / float(width);
+				float v = float(y) / float(height);
+				int colour[3] =
+				{
+					int(128.0f + 96.0f*tMath::tSin(6.0f*u + 2.0f*v)),
+					int(128.0f + 96.0f*tMath::tSin(4.0f*v - 3.0f*u + 1.0f)),
+					int(128.0f + 96.0f*tMath::tSin(5.0f*(u + v) + 2.0f))
+				};
+				int alpha = int(255.0f*u);
+				for (int d = 0; d < numDiscs; d++)
+				{
+					int dx = x - discs[d][0];
+					int dy = y - discs[d][1];
+					if (dx*dx + dy*dy > discs[d][2]*discs[d][2])
+						continue;
+
+					for (int c = 0; c < 3; c++)
+						colour[c] = discColours[d].E[c];
+					if (d & 1)
+						alpha = 0;
+				}
+
+				// The stripes are two pixels wide so most blocks in the band hold both colours.
+				if ((y*4 >= height*3) && ((x + y/2) & 2))
+					for (int c = 0; c < 3; c++)
+						colour[c] = 255 - colour[c];
+
+				uint32 random = Test::Random(seed);
+				tPixel& pixel = pixels[y*width + x];
+				for (int c = 0; c < 3; c++)
+					pixel.E[c] = uint8(tMath::tClamp(colour[c] + int((random >> (c*4)) & 15) - 8, 0, 255));
+				pixel.A = uint8(alpha);
+			}
+		}
+	}
+
+	// The root mean squared error over the channels the format keeps. For BC1_DXT1BA alpha and the pixels that should
+	// be transparent are left out. Those are checked separately.
+	double MeasureRMSE(const tPixel* original, const tPixel* decoded, int numPixels, tPixelFormat format)
+	{
+		int numChannels = 4;
+		switch (format)
+		{
+			case tPixelFormat::BC1_DXT1:
+			case tPixelFormat::BC1_DXT1BA:	numChannels = 3;	break;
+			case tPixelFormat::BC4_ATI1:	numChannels = 1;	break;
+			case tPixelFormat::BC5_ATI2:	numChannels = 2;	break;
+			default:											break;
+		}
+
+		double sum = 0.0;
+		int64 count = 0;
+		for (int p = 0; p < numPixels; p++)
+		{
+			if ((format == tPixelFormat::BC1_DXT1BA) && (original[p].A < 128))
+				continue;
+
+			for (int c = 0; c < numChannels; c++)
+			{
+				int diff = int(original[p].E[c]) - int(decoded[p].E[c]);
+				sum += double(diff*diff);
+			}
+			count += numChannels;
+		}
+
+		return count ? sqrt(sum / double(count)) : 0.0;
+	}
+
+	// The RMSE of log2(1 + value) over the colour channels. An error counts the same for dark and bright pixels.
+	double MeasureLogRMSE(const tColourf* original, const tColourf* decoded, int numPixels)
+	{
+		double sum = 0.0;
+		for (int p = 0; p < numPixels; p++)
+		{
+			for (int c = 0; c < 3; c++)
+			{
+				double diff = log2(1.0 + tMath::tMax(original[p].E[c], 0.0f)) - log2(1.0 + decoded[p].E[c]);
+				sum += diff*diff;
+			}
+		}
+
+		return numPixels ? sqrt(sum / double(numPixels*3)) : 0.0;
+	}
+
+	double RMSEToPSNR(double rmse)
+	{
+		return (rmse > 0.0) ? 20.0*log10(255.0/rmse) : 99.0;
+	}
+
+	double GetRate(int numPixels, double start)
+	{
+		return double(numPixels) / 1000000.0 / tMath::tMax(tSystem::tGetTimeDouble() - start, 1.0e-6);
+	}
+
+	// Collects the blocks Texture Tools writes. They may arrive in several pieces.
+	struct ReferenceOutput : public nvtt::OutputHandler
+	{
+		ReferenceOutput(uint8* dest, int destSize)																		: Dest(dest), DestSize(destSize) { }
+		void beginImage(int size, int width, int height, int depth, int face, int miplevel) override					{ }
+		void endImage() override																						{ }
+		bool writeData(const void* data, int size) override
+		{
+			if (!data || (size <= 0))
+				return true;
+
+			if (size > (DestSize - NumWritten))
+				return false;
+
+			tStd::tMemcpy(Dest + NumWritten, data, size);
+			NumWritten += size;
+			return true;
+		}
+
+		uint8* Dest;
+		int DestSize;
+		int NumWritten = 0;
+	};
+
+	// Returns false if Texture Tools fails or doesn't write exactly destSize bytes.
+	bool RunReference
+	(
+		uint8* dest, int destSize, const nvtt::InputOptions& inputOptions,
+		const nvtt::CompressionOptions& compressionOptions
+	)
+	{
+		ReferenceOutput output(dest, destSize);
+		nvtt::OutputOptions outputOptions;
+		outputOptions.setOutputHandler(&output);
+		outputOptions.setOutputHeader(false);
+
+		nvtt::Context context;
+		context.enableCudaAcceleration(false);
+		bool success = context.process(inputOptions, compressionOptions, outputOptions);
+		return success && (output.NumWritten == destSize);
+	}
+
+	// Encodes with Texture Tools at its fastest or normal setting. Returns false if the format isn't one Texture Tools
+	// can encode, or if the encode fails.
+	bool EncodeReference
+	(
+		uint8* dest, int destSize, const tPixel* pixels, int width, int height, tPixelFormat format, bool fastest
+	)
+	{
+		nvtt::Format referenceFormat = nvtt::Format_BC1;
+		switch (format)
+		{
+			case tPixelFormat::BC1_DXT1:	referenceFormat = nvtt::Format_BC1;		break;
+			case tPixelFormat::BC1_DXT1BA:	referenceFormat = nvtt::Format_BC1a;	break;
+			case tPixelFormat::BC2_DXT3:	referenceFormat = nvtt::Format_BC2;		break;
+			case tPixelFormat::BC3_DXT5:	referenceFormat = nvtt::Format_BC3;		break;
+			case tPixelFormat::BC4_ATI1:	referenceFormat = nvtt::Format_BC4;		break;
+			case tPixelFormat::BC5_ATI2:	referenceFormat = nvtt::Format_BC5;		break;
+			case tPixelFormat::BC7:			referenceFormat = nvtt::Format_BC7;		break;
+			default:						return false;
+		}
+
+		// Texture Tools wants the channels in BGRA order.
+		int numPixels = width*height;
+		tPixel* swizzled = new tPixel[numPixels];
+		for (int p = 0; p < numPixels; p++)
+			swizzled[p].Set(pixels[p].B, pixels[p].G, pixels[p].R, pixels[p].A);
+
+		nvtt::InputOptions inputOptions;
+		inputOptions.setMipmapGeneration(false);
+		bool opaque = (format == tPixelFormat::BC1_DXT1);
+		inputOptions.setAlphaMode(opaque ? nvtt::AlphaMode_None : nvtt::AlphaMode_Transparency);
+		inputOptions.setWrapMode(nvtt::WrapMode_Clamp);
+		inputOptions.setFormat(nvtt::InputFormat_BGRA_8UB);
+		inputOptions.setTextureLayout(nvtt::TextureType_2D, width, height);
+		inputOptions.setMipmapData(swizzled, width, height);
+
+		// No dithering since that adds error. Binary alpha uses the same threshold as tEncodeBC.
+		nvtt::CompressionOptions compressionOptions;
+		compressionOptions.setFormat(referenceFormat);
+		if (referenceFormat == nvtt::Format_BC1a)
+			compressionOptions.setQuantization(false, false, true, 127);
+		compressionOptions.setQuality(fastest ? nvtt::Quality_Fastest : nvtt::Quality_Normal);
+
+		bool success = RunReference(dest, destSize, inputOptions, compressionOptions);
+		delete[] swizzled;
+		return success;
+	}
+
+	// The HDR version only encodes BC6H.
+	bool EncodeReference
+	(
+		uint8* dest, int destSize, const tColourf* pixels, int width, int height, tPixelFormat format, bool fastest
+	)
+	{
+		if (format != tPixelFormat::BC6H)
+			return false;
+
+		// tColourf is already in the RGBA order Texture Tools wants. The gamma is set to 1 so nothing is converted.
+		nvtt::InputOptions inputOptions;
+		inputOptions.setMipmapGeneration(false);
+		inputOptions.setAlphaMode(nvtt::AlphaMode_None);
+		inputOptions.setGamma(1.0f, 1.0f);
+		inputOptions.setFormat(nvtt::InputFormat_RGBA_32F);
+		inputOptions.setTextureLayout(nvtt::TextureType_2D, width, height);
+		inputOptions.setMipmapData(pixels, width, height);
+
+		nvtt::CompressionOptions compressionOptions;
+		compressionOptions.setFormat(nvtt::Format_BC6);
+		compressionOptions.setPixelType(nvtt::PixelType_UnsignedFloat);
+		compressionOptions.setQuality(fastest ? nvtt::Quality_Fastest : nvtt::Quality_Normal);
+
+		return RunReference(dest, destSize, inputOptions, compressionOptions);
+	}
+
+	// BC1 to BC5 against Texture Tools. Each encode is timed once on one thread. Texture Tools is given the same
+	// pixels and its blocks are decoded with tDecodeBC so both are measured the same way.
+	void CheckLowDynamicRange(Test::Checks& check, const tPixel* pixels, int width, int height)
+	{
+		int numPixels = width*height;
+		tPixel* decoded = new tPixel[numPixels];
+		tPrintf("%dx%d test image. RMSE @ megapixels per second on one thread.\n", width, height);
+		tPrintf
+		(
+			"%-10s %-14s %-14s %-14s %-14s %-14s\n", "Format", "Fast", "Normal", "High", "Ref Fastest", "Ref Normal"
+		);
+		for (int f = 0; f < NumFormats; f++)
+		{
+			tPixelFormat format = Formats[f];
+			const char* name = tGetPixelFormatName(format);
+			int size = tGetBCEncodedSize(format, width, height);
+			uint8* blocks = new uint8[size];
+			uint8* other = new uint8[size];
+
+			const int refFastest = NumQualities;
+			const int refNormal = NumQualities + 1;
+			double error[NumQualities + 2];
+			double rate[NumQualities + 2];
+			for (int q = 0; q < NumQualities + 2; q++)
+			{
+				bool encoded = true;
+				double start = tSystem::tGetTimeDouble();
+				if (q < NumQualities)
+					tEncodeBC(blocks, pixels, width, height, format, Qualities[q], 1);
+				else
+					encoded = EncodeReference(blocks, size, pixels, width, height, format, q == refFastest);
+				rate[q] = GetRate(numPixels, start);
+
+				error[q] = 0.0;
+				if (!check(encoded, "%s Texture Tools could not encode the test image.", name))
+					continue;
+
+				tDecodeBC(decoded, blocks, width, height, format);
+				error[q] = MeasureRMSE(pixels, decoded, numPixels, format);
+				if (q >= NumQualities)
+					continue;
+
+				// Every pixel that should be transparent must come back transparent and no others.
+				int numWrong = 0;
+				if (format == tPixelFormat::BC1_DXT1BA)
+					for (int p = 0; p < numPixels; p++)
+						if ((pixels[p].A < 128) != (decoded[p].A == 0))
+							numWrong++;
+				check(!numWrong, "%s quality %d got the transparency of %d pixels wrong.", name, q, numWrong);
+
+				// Three threads split the rows unevenly.
+				tEncodeBC(other, pixels, width, height, format, Qualities[q], 3);
+				bool same = !tStd::tMemcmp(other, blocks, size);
+				check(same, "%s quality %d changes with the number of threads.", name, q);
+			}
+
+			tPrintf("%-10s", name);
+			for (int q = 0; q < NumQualities + 2; q++)
+				tPrintf(" %5.3f @ %6.2f", error[q], rate[q]);
+			tPrintf("\n");
+
+			for (int q = 1; q < NumQualities; q++)
+				check(error[q] <= error[q-1] + Epsilon, "%s quality %d has more error than quality %d.", name, q, q-1);
+			check
+			(
+				error[1] <= error[refFastest]*Worse + Epsilon,
+				"%s Normal has over 5%% more error than Texture Tools at its fastest.", name
+			);
+			check
+			(
+				error[2] <= error[refNormal]*Worse + Epsilon,
+				"%s High has over 5%% more error than Texture Tools at normal.", name
+			);
+
+			delete[] blocks;
+			delete[] other;
+		}
+		delete[] decoded;
+	}
+
+	// BC7 is measured in PSNR over all four channels.
+	void CheckBC7(Test::Checks& check, const tPixel* pixels, int width, int height)
+	{
+		int numPixels = width*height;
+		tPixel* decoded = new tPixel[numPixels];
+		int size = tGetBCEncodedSize(tPixelFormat::BC7, width, height);
+		uint8* blocks = new uint8[size];
+		uint8* other = new uint8[size];
+		double psnr[NumQualities];
+		double rate[NumQualities];
+		for (int q = 0; q < NumQualities; q++)
+		{
+			double start = tSystem::tGetTimeDouble();
+			tEncodeBC(blocks, pixels, width, height, tPixelFormat::BC7, Qualities[q], 1);
+			rate[q] = GetRate(numPixels, start);
+			tDecodeBC(decoded, blocks, width, height, tPixelFormat::BC7);
+			psnr[q] = RMSEToPSNR(MeasureRMSE(pixels, decoded, numPixels, tPixelFormat::BC7));
+
+			tEncodeBC(other, pixels, width, height, tPixelFormat::BC7, Qualities[q], 3);
+			check(!tStd::tMemcmp(other, blocks, size), "BC7 quality %d changes with the number of threads.", q);
+			check
+			(
+				psnr[q] >= MinBC7PSNR[q],
+				"BC7 quality %d PSNR %.2f dB is below %.2f dB.", q, psnr[q], MinBC7PSNR[q]
+			);
+			if (q)
+				check(psnr[q] >= psnr[q-1] - Epsilon, "BC7 quality %d has a lower PSNR than quality %d.", q, q-1);
+		}
+		tPrintf("\nPSNR in dB @ megapixels per second on one thread.\n");
+		tPrintf("%-10s", "BC7");
+		for (int q = 0; q < NumQualities; q++)
+			tPrintf(" %5.2f @ %6.2f", psnr[q], rate[q]);
+		tPrintf("\n");
+		delete[] blocks;
+		delete[] other;
+		delete[] decoded;
+
+		// Texture Tools takes minutes to encode BC7 at any setting, so it is compared with High on a small image of its
+		// own.
+		const int numRefPixels = BC7RefSide*BC7RefSide;
+		tPixel* refPixels = new tPixel[numRefPixels];
+		tPixel* refDecoded = new tPixel[numRefPixels];
+		uint32 refSeed = 1;
+		MakeTestPixels(refPixels, BC7RefSide, BC7RefSide, refSeed);
+		size = tGetBCEncodedSize(tPixelFormat::BC7, BC7RefSide, BC7RefSide);
+		blocks = new uint8[size];
+		double refPSNR[2];
+		for (int r = 0; r < 2; r++)
+		{
+			bool encoded = true;
+			double start = tSystem::tGetTimeDouble();
+			if (r == 0)
+				tEncodeBC(blocks, refPixels, BC7RefSide, BC7RefSide, tPixelFormat::BC7, tBCQuality::High, 1);
+			else
+				encoded = EncodeReference(blocks, size, refPixels, BC7RefSide, BC7RefSide, tPixelFormat::BC7, false);
+			rate[r] = GetRate(numRefPixels, start);
+			tDecodeBC(refDecoded, blocks, BC7RefSide, BC7RefSide, tPixelFormat::BC7);
+			double rmse = MeasureRMSE(refPixels, refDecoded, numRefPixels, tPixelFormat::BC7);
+			refPSNR[r] = encoded ? RMSEToPSNR(rmse) : 0.0;
+		}
+		tPrintf
+		(
+			"BC7 %dx%d  High %5.2f @ %6.3f  Ref %5.2f @ %6.3f\n",
+			BC7RefSide, BC7RefSide, refPSNR[0], rate[0], refPSNR[1], rate[1]
+		);
+		check(refPSNR[1] > 0.0, "BC7 Texture Tools could not encode the test image.");
+		check(refPSNR[0] >= refPSNR[1] - MaxBC7RefLoss, "BC7 High is over %.1f dB below Texture Tools.", MaxBC7RefLoss);
+		delete[] blocks;
+		delete[] refPixels;
+		delete[] refDecoded;
+	}
+
+	// The HDR image is the test image made linear and scaled by a ramp from 1 to 64 across it, so the blocks span many
+	// exponents.
+	void CheckBC6H(Test::Checks& check, const tPixel* pixels, int width, int height)
+	{
+		int numPixels = width*height;
+		tColourf* hdr = new tColourf[numPixels];
+		tColourf* hdrDecoded = new tColourf[numPixels];
+		for (int y = 0; y < height; y++)
+		{
+			for (int x = 0; x < width; x++)
+			{
+				float scale = tMath::tPow(2.0f, 6.0f*float(x) / float(width));
+				const tPixel& pixel = pixels[y*width + x];
+				float colour[3];
+				for (int c = 0; c < 3; c++)
+					colour[c] = tMath::tPow(float(pixel.E[c]) / 255.0f, 2.2f) * scale;
+				hdr[y*width + x].Set(colour[0], colour[1], colour[2], 1.0f);
+			}
+		}
+
+		int size = tGetBCEncodedSize(tPixelFormat::BC6H, width, height);
+		uint8* blocks = new uint8[size];
+		uint8* other = new uint8[size];
+		const int refNormal = NumQualities;
+		double error[NumQualities + 1];
+		double rate[NumQualities + 1];
+		for (int q = 0; q < NumQualities + 1; q++)
+		{
+			bool encoded = true;
+			double start = tSystem::tGetTimeDouble();
+			if (q < NumQualities)
+				tEncodeBC(blocks, hdr, width, height, tPixelFormat::BC6H, Qualities[q], 1);
+			else
+				encoded = EncodeReference(blocks, size, hdr, width, height, tPixelFormat::BC6H, false);
+			rate[q] = GetRate(numPixels, start);
+
+			error[q] = 0.0;
+			if (!check(encoded, "BC6H Texture Tools could not encode the test image."))
+				continue;
+
+			tDecodeBC(hdrDecoded, blocks, width, height, tPixelFormat::BC6H);
+			error[q] = MeasureLogRMSE(hdr, hdrDecoded, numPixels);
+			if (q == refNormal)
+				continue;
+
+			tEncodeBC(other, hdr, width, height, tPixelFormat::BC6H, Qualities[q], 3);
+			check(!tStd::tMemcmp(other, blocks, size), "BC6H quality %d changes with the number of threads.", q);
+		}
+		tPrintf("\nLog RMSE @ megapixels per second on one thread.\n");
+		tPrintf("%-10s", "BC6H");
+		for (int q = 0; q < NumQualities + 1; q++)
+			tPrintf(" %5.3f @ %6.2f", error[q], rate[q]);
+		tPrintf("\n");
+
+		for (int q = 1; q < NumQualities; q++)
+			check(error[q] <= error[q-1] + Epsilon, "BC6H quality %d has more error than quality %d.", q, q-1);
+		check(error[1] <= error[refNormal]*Worse + Epsilon, "BC6H Normal has over 5%% more error than Texture Tools.");
+		check(error[2] <= error[refNormal]*Worse + Epsilon, "BC6H High has over 5%% more error than Texture Tools.");
+
+		delete[] blocks;
+		delete[] other;
+		delete[] hdr;
+		delete[] hdrDecoded;
+	}
+
+	// A block of one colour should come back within rounding. A single BC4 value is stored exactly.
+	void CheckSingleColours(Test::Checks& check)
+	{
+		tPixel block[16];
+		tPixel result[16];
+		uint8 encoded[16];
+		for (int v = 0; v < 256; v++)
+		{
+			for (int p = 0; p < 16; p++)
+				block[p].Set(v, 255 - v, (v*7) & 0xFF);
+
+			for (int q = 0; q < NumQualities; q++)
+			{
+				int maxDiff = 0;
+				tEncodeBC(encoded, block, 4, 4, tPixelFormat::BC1_DXT1, Qualities[q], 1);
+				tDecodeBC(result, encoded, 4, 4, tPixelFormat::BC1_DXT1);
+				for (int p = 0; p < 16; p++)
+					for (int c = 0; c < 3; c++)
+						maxDiff = tMath::tMax(maxDiff, tMath::tAbs(int(result[p].E[c]) - int(block[p].E[c])));
+
+				tEncodeBC(encoded, block, 4, 4, tPixelFormat::BC4_ATI1, Qualities[q], 1);
+				tDecodeBC(result, encoded, 4, 4, tPixelFormat::BC4_ATI1);
+				for (int p = 0; p < 16; p++)
+					if (result[p].R != v)
+						maxDiff = 256;
+
+				check(maxDiff <= 1, "Single colour %d at quality %d is off by %d.", v, q, maxDiff);
+			}
+		}
+	}
+
+	// Sizes that aren't multiples of 4. Nothing past the blocks or past the decoded pixels may be written.
+	void CheckOddSizes(Test::Checks& check, uint32& seed)
+	{
+		const int oddWidths[] = { 1, 2, 3, 5, 13 };
+		const int oddHeights[] = { 1, 3, 4, 7 };
+		const int maxOddPixels = 13*7;
+		const int maxOddBytes = 4*2*16;
+		const int numGuards = 16;
+		tPixel oddPixels[maxOddPixels];
+		tPixel oddDecoded[maxOddPixels + numGuards];
+		uint8 oddBlocks[maxOddBytes + numGuards];
+		for (int w = 0; w < tNumElements(oddWidths); w++)
+		{
+			for (int h = 0; h < tNumElements(oddHeights); h++)
+			{
+				int oddW = oddWidths[w];
+				int oddH = oddHeights[h];
+				MakeTestPixels(oddPixels, oddW, oddH, seed);
+				for (int f = 0; f < NumFormats; f++)
+				{
+					for (int q = 0; q < NumQualities; q++)
+					{
+						int size = tGetBCEncodedSize(Formats[f], oddW, oddH);
+						tStd::tMemset(oddBlocks, 0xCD, sizeof(oddBlocks));
+						for (int p = 0; p < maxOddPixels + numGuards; p++)
+							oddDecoded[p].Set(1, 2, 3, 4);
+
+						tEncodeBC(oddBlocks, oddPixels, oddW, oddH, Formats[f], Qualities[q], 1);
+						tDecodeBC(oddDecoded, oddBlocks, oddW, oddH, Formats[f]);
+						bool overrun = false;
+						for (int b = size; b < size + numGuards; b++)
+							if (oddBlocks[b] != 0xCD)
+								overrun = true;
+						for (int p = oddW*oddH; p < maxOddPixels + numGuards; p++)
+							if ((oddDecoded[p].R != 1) || (oddDecoded[p].A != 4))
+								overrun = true;
+
+						check
+						(
+							!overrun, "%s quality %d at %dx%d wrote too much.",
+							tGetPixelFormatName(Formats[f]), q, oddW, oddH
+						);
+					}
+				}
+			}
+		}
+	}
+}
+
+
+bool Test::BlockCompressBench()
+{
+	Checks check("BlockCompressBench");
+	tPixel* pixels = new tPixel[ImageWidth*ImageHeight];
+	uint32 seed = 1;
+	MakeTestPixels(pixels, ImageWidth, ImageHeight, seed);
+
+	CheckLowDynamicRange(check, pixels, ImageWidth, ImageHeight);
+	CheckBC7(check, pixels, ImageWidth, ImageHeight);
+	CheckBC6H(check, pixels, ImageWidth, ImageHeight);
+	delete[] pixels;
+
+	CheckSingleColours(check);
+	CheckOddSizes(check, seed);
+
+	return check.Report();
+}
@@ -0,0 +1,346 @@
+// CubemapTest.cpp
+//
+// Checks every cubemap conversion against patterns that colour each pixel by the direction through its centre. A
+// smooth pattern is tried with faces of 16, 64, and 256, and a high frequency one that makes any seam stand out with
+// faces of 64, both with each filter. With small faces the error next to face edges is also checked on its own. Also
+// checks that crosses at the face size round trip exactly, that the panorama wrap has no seam, that the output does
+// not depend on the thread count, and that bad input is turned down.
+//
+// Copyright (c) 2020 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <Math/tFundamentals.h>
+#include <Math/tVector3.h>
+#include <System/tPrint.h>
+#include <Image/tCubemapConvert.h>
+#include "Fixtures.h"
+#include "Tests.h"
+using namespace tImage;
+
+
+namespace
+{
+	const int NumFaces = int(tCubemap::tSide::NumSides);
+
+	// The test colour of a direction is its normalized components mapped from -1 to 1 onto 0 to 255. A frequency above
+	// 0 first replaces each component with the sine of frequency times it. The reference directions are written from
+	// the dds cubemap table and the usual panorama formula, not taken from the converter, so a mistake there shows up.
+	tPixel GetTestColour(const tMath::tVector3& dir, float frequency)
+	{
+		float length = tMath::tSqrt(dir.x*dir.x + dir.y*dir.y + dir.z*dir.z);
+		float components[3] = { dir.x/length, dir.y/length, dir.z/length };
+		int channels[3];
+		for (int c = 0; c < 3; c++)
+		{
+			float value = (frequency > 0.0f) ? tMath::tSin(frequency*components[c]) : components[c];
+			channels[c] = int(tMath::tFloor((value*0.5f + 0.5f)*255.0f + 0.5f));
+		}
+
+		return tPixel(channels[0], channels[1], channels[2], 255);
+	}
+
+
+	tMath::tVector3 ReferenceFaceDir(int face, float s, float t)
+	{
+		// The table has tc going down the face while t goes up.
+		float sc = 2.0f*s - 1.0f;
+		float tc = 1.0f - 2.0f*t;
+		switch (tCubemap::tSide(face))
+		{
+			case tCubemap::tSide::PosX:		return tMath::tVector3(1.0f, -tc, -sc);
+			case tCubemap::tSide::NegX:		return tMath::tVector3(-1.0f, -tc, sc);
+			case tCubemap::tSide::PosY:		return tMath::tVector3(sc, 1.0f, tc);
+			case tCubemap::tSide::NegY:		return tMath::tVector3(sc, -1.0f, -tc);
+			case tCubemap::tSide::PosZ:		return tMath::tVector3(sc, -tc, 1.0f);
+			default:						return tMath::tVector3(-sc, -tc, -1.0f);
+		}
+	}
+
+
+	tMath::tVector3 ReferenceEquirectDir(float u, float v)
+	{
+		float longitude = (u - 0.5f)*tMath::TwoPi;
+		float latitude = (v - 0.5f)*tMath::Pi;
+		float cosLatitude = tMath::tCos(latitude);
+		return tMath::tVector3
+		(
+			cosLatitude*tMath::tSin(longitude), tMath::tSin(latitude), cosLatitude*tMath::tCos(longitude)
+		);
+	}
+
+
+	// Fills the picture with the test colour of each pixel centre. Use a face of -1 for a panorama.
+	void MakeTestPattern(tPicture& picture, int width, int height, int face, float frequency)
+	{
+		picture.Set(width, height);
+		for (int y = 0; y < height; y++)
+		{
+			float t = (float(y) + 0.5f) / float(height);
+			for (int x = 0; x < width; x++)
+			{
+				float s = (float(x) + 0.5f) / float(width);
+				tMath::tVector3 dir = (face < 0) ? ReferenceEquirectDir(s, t) : ReferenceFaceDir(face, s, t);
+				picture.SetPixel(x, y, GetTestColour(dir, frequency));
+			}
+		}
+	}
+
+
+	// Measures the largest and the mean difference of any channel from the test pattern.
+	void MeasureTestError(int& maxError, double& meanError, const tPicture& picture, int face, float frequency)
+	{
+		tPicture pattern;
+		MakeTestPattern(pattern, picture.GetWidth(), picture.GetHeight(), face, frequency);
+
+		maxError = 0;
+		double sum = 0.0;
+		int numPixels = picture.GetWidth()*picture.GetHeight();
+		const tPixel* pixels = picture.GetPixels();
+		const tPixel* expected = pattern.GetPixels();
+		for (int p = 0; p < numPixels; p++)
+		{
+			for (int c = 0; c < 4; c++)
+			{
+				int error = tMath::tAbs(int(pixels[p].E[c]) - int(expected[p].E[c]));
+				maxError = tMath::tMax(maxError, error);
+				sum += double(error);
+			}
+		}
+		meanError = numPixels ? sum / double(numPixels*4) : 0.0;
+	}
+
+
+	// Like MeasureTestError for a panorama of the smooth pattern, but only counts pixels that sample within a texel of
+	// a face edge of a cube of the given face size. Errors in the seam handling show up here well before the overall
+	// error moves.
+	void MeasureSeamError(int& maxError, double& meanError, const tPicture& equirect, int faceSize)
+	{
+		int width = equirect.GetWidth();
+		int height = equirect.GetHeight();
+		float edge = 1.0f - 2.0f/float(faceSize);
+		maxError = 0;
+		double sum = 0.0;
+		int numSamples = 0;
+		for (int y = 0; y < height; y++)
+		{
+			float t = (float(y) + 0.5f) / float(height);
+			for (int x = 0; x < width; x++)
+			{
+				// On the face the direction points at, the other two components over the largest give the face coords.
+				tMath::tVector3 dir = ReferenceEquirectDir((float(x) + 0.5f) / float(width), t);
+				float ax = tMath::tAbs(dir.x);
+				float ay = tMath::tAbs(dir.y);
+				float az = tMath::tAbs(dir.z);
+				float major = tMath::tMax(ax, tMath::tMax(ay, az));
+				float minor = (ax == major) ? tMath::tMax(ay, az) :
+					((ay == major) ? tMath::tMax(ax, az) : tMath::tMax(ax, ay));
+				if (minor < edge*major)
+					continue;
+
+				tPixel expected = GetTestColour(dir, 0.0f);
+				tPixel actual = equirect.GetPixel(x, y);
+				for (int c = 0; c < 3; c++)
+				{
+					int error = tMath::tAbs(int(actual.E[c]) - int(expected.E[c]));
+					maxError = tMath::tMax(maxError, error);
+					sum += double(error);
+				}
+				numSamples += 3;
+			}
+		}
+		meanError = numSamples ? sum / double(numSamples) : 0.0;
+	}
+}
+
+
+bool Test::CubemapConvert()
+{
+	Checks check("CubemapConvert");
+	const char* filterNames[] = { "Bilinear", "Bicubic" };
+	const int sizes[] = { 16, 64, 256 };
+	tString label;
+
+	int maxError = 0;
+	double meanError = 0.0;
+	for (int f = 0; f < tNumElements(filterNames); f++)
+	{
+		tCubeFilter filter = tCubeFilter(f);
+		for (int s = 0; s < tNumElements(sizes); s++)
+		{
+			// The smooth pattern. Every sample should be within a few levels of it, and most within rounding.
+			int size = sizes[s];
+			const int maxAllowed = 3;
+			const double meanAllowed = 0.3;
+			tsPrintf(label, "%s %d", filterNames[f], size);
+
+			tPicture faces[NumFaces];
+			for (int face = 0; face < NumFaces; face++)
+				MakeTestPattern(faces[face], size, size, face, 0.0f);
+
+			tPicture equirect;
+			bool converted = tCubeToEquirect(equirect, faces, 0, 0, filter);
+			MeasureTestError(maxError, meanError, equirect, -1, 0.0f);
+			tPrintf("%s faces to equirect: max %d mean %.3f\n", label.Chars(), maxError, meanError);
+			check
+			(
+				converted && (equirect.GetWidth() == 4*size) && (equirect.GetHeight() == 2*size),
+				"%s equirect size.", label.Chars()
+			);
+			check
+			(
+				(maxError <= maxAllowed) && (meanError < meanAllowed),
+				"%s faces to equirect is off the pattern.", label.Chars()
+			);
+			int seamMax = 0;
+			double seamMean = 0.0;
+			MeasureSeamError(seamMax, seamMean, equirect, size);
+			tPrintf("%s faces to equirect at seams: max %d mean %.3f\n", label.Chars(), seamMax, seamMean);
+
+			// With small faces the seams take up enough of the panorama that reading the wrong texels across an edge,
+			// even ones close in colour such as the clamped edge of the same face, lifts the error there.
+			if (size <= 16)
+				check
+				(
+					(seamMax <= 2) && (seamMean < 0.4),
+					"%s faces to equirect is off the pattern at the seams.", label.Chars()
+				);
+
+			tPicture oddEquirect;
+			converted = tCubeToEquirect(oddEquirect, faces, 3*size + 1, size + 3, filter);
+			MeasureTestError(maxError, meanError, oddEquirect, -1, 0.0f);
+			converted = converted && (maxError <= maxAllowed) && (meanError < meanAllowed);
+			check(converted, "%s odd equirect is off the pattern.", label.Chars());
+
+			// The two ends of each row meet at the back, so they should be no further apart than neighbouring pixels.
+			int wrapStep = 0;
+			for (int y = 0; y < equirect.GetHeight(); y++)
+			{
+				tPixel left = equirect.GetPixel(0, y);
+				tPixel right = equirect.GetPixel(equirect.GetWidth() - 1, y);
+				for (int c = 0; c < 3; c++)
+					wrapStep = tMath::tMax(wrapStep, tMath::tAbs(int(left.E[c]) - int(right.E[c])));
+			}
+			check(wrapStep <= 2 + 1024/size, "%s equirect has a seam at the wrap.", label.Chars());
+
+			tPicture single;
+			tPicture several;
+			tCubeToEquirect(single, faces, 0, 0, filter, 1);
+			tCubeToEquirect(several, faces, 0, 0, filter, 3);
+			int numPixels = equirect.GetWidth()*equirect.GetHeight();
+			bool same = !CountDifferences(single.GetPixels(), equirect.GetPixels(), numPixels);
+			same = same && !CountDifferences(several.GetPixels(), equirect.GetPixels(), numPixels);
+			check(same, "%s equirect changes with the number of threads.", label.Chars());
+
+			// A panorama twice the default size keeps the sampling error down so the faces should be close.
+			tPicture source;
+			MakeTestPattern(source, 8*size, 4*size, -1, 0.0f);
+			tPicture fromEquirect[NumFaces];
+			converted = tEquirectToCube(fromEquirect, source, size, filter);
+			int worstMax = 0;
+			double worstMean = 0.0;
+			for (int face = 0; face < NumFaces; face++)
+			{
+				MeasureTestError(maxError, meanError, fromEquirect[face], face, 0.0f);
+				worstMax = tMath::tMax(worstMax, maxError);
+				worstMean = tMath::tMax(worstMean, meanError);
+			}
+			tPrintf("%s equirect to faces: max %d mean %.3f\n", label.Chars(), worstMax, worstMean);
+			converted = converted && (worstMax <= maxAllowed) && (worstMean < meanAllowed);
+			check(converted, "%s equirect to faces is off the pattern.", label.Chars());
+
+			// Crosses at the face size are copies and must come back exactly. Resampled ones are filtered both ways.
+			for (int l = 0; l < 2; l++)
+			{
+				tCrossLayout layout = tCrossLayout(l);
+				const char* layoutName = l ? "vertical" : "horizontal";
+				tPicture cross;
+				tPicture back[NumFaces];
+				bool exact = tCubeToCross(cross, faces, layout, 0, filter) && tCrossToCube(back, cross, 0, filter);
+				for (int face = 0; (face < NumFaces) && exact; face++)
+				{
+					exact = (back[face].GetWidth() == size) && (back[face].GetHeight() == size);
+					exact = exact && !CountDifferences(back[face].GetPixels(), faces[face].GetPixels(), size*size);
+				}
+				check(exact, "%s %s cross does not round trip.", label.Chars(), layoutName);
+
+				converted = tCubeToCross(cross, faces, layout, size + size/2, filter);
+				converted = converted && tCrossToCube(back, cross, size, filter);
+				worstMax = 0;
+				for (int face = 0; face < NumFaces; face++)
+				{
+					MeasureTestError(maxError, meanError, back[face], face, 0.0f);
+					worstMax = tMath::tMax(worstMax, maxError);
+				}
+				check
+				(
+					converted && (worstMax <= maxAllowed),
+					"%s resampled %s cross is off the pattern.", label.Chars(), layoutName
+				);
+			}
+		}
+
+		// The high frequency pattern changes quickly everywhere, so a mistake at a face seam or at the wrap is far
+		// larger than the error anywhere else.
+		const int size = 64;
+		const float frequency = 12.0f;
+		const int maxAllowed = 6;
+		tsPrintf(label, "%s %d high frequency", filterNames[f], size);
+		tPicture faces[NumFaces];
+		for (int face = 0; face < NumFaces; face++)
+			MakeTestPattern(faces[face], size, size, face, frequency);
+
+		tPicture equirect;
+		tCubeToEquirect(equirect, faces, 0, 0, filter);
+		MeasureTestError(maxError, meanError, equirect, -1, frequency);
+		tPrintf("%s faces to equirect: max %d mean %.3f\n", label.Chars(), maxError, meanError);
+		check(maxError <= maxAllowed, "%s faces to equirect is off the pattern.", label.Chars());
+
+		tPicture source;
+		MakeTestPattern(source, 8*size, 4*size, -1, frequency);
+		tPicture back[NumFaces];
+		tEquirectToCube(back, source, size, filter);
+		int worstMax = 0;
+		for (int face = 0; face < NumFaces; face++)
+		{
+			MeasureTestError(maxError, meanError, back[face], face, frequency);
+			worstMax = tMath::tMax(worstMax, maxError);
+		}
+		tPrintf("%s equirect to faces: max %d\n", label.Chars(), worstMax);
+		check(worstMax <= maxAllowed, "%s equirect to faces is off the pattern.", label.Chars());
+
+		tPicture cross;
+		tCubeToCross(cross, faces, tCrossLayout::Horizontal, size + size/2, filter);
+		tCrossToCube(back, cross, size, filter);
+		worstMax = 0;
+		for (int face = 0; face < NumFaces; face++)
+		{
+			MeasureTestError(maxError, meanError, back[face], face, frequency);
+			worstMax = tMath::tMax(worstMax, maxError);
+		}
+		check(worstMax <= maxAllowed, "%s resampled cross is off the pattern.", label.Chars());
+	}
+
+	// Bad input must be turned down.
+	tPicture faces[NumFaces];
+	tPicture result;
+	tPicture resultFaces[NumFaces];
+	for (int face = 0; face < NumFaces; face++)
+		MakeTestPattern(faces[face], 8, 8, face, 0.0f);
+	faces[3].Set(8, 9);
+	check(!tCubeToEquirect(result, faces), "Non-square face accepted.");
+	faces[3].Clear();
+	check(!tCubeToCross(result, faces), "Missing face accepted.");
+	tPicture square(10, 10);
+	check(!tCrossToCube(resultFaces, square), "Square cross accepted.");
+	tPicture empty;
+	check(!tEquirectToCube(resultFaces, empty), "Empty panorama accepted.");
+
+	return check.Report();
+}
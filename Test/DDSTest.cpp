@@ -0,0 +1,229 @@
+// DDSTest.cpp
+//
+// Saves every pixel format tFileDDS can write as a mipmapped texture and as a cubemap, loads each file back, and checks
+// the layers are unchanged. Each one is saved and loaded with reverseRowOrder on and off. When the flags differ the
+// rows must come back flipped. BC6H and BC7 must fail when the flag is on.
+//
+// Copyright (c) 2020 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <System/tFile.h>
+#include <System/tPrint.h>
+#include <Image/tFileDDS.h>
+#include "Fixtures.h"
+#include "Tests.h"
+using namespace tImage;
+
+
+namespace
+{
+	// Reverses the rows of 3-bit indices in a BC3 alpha, BC4 or BC5 channel block. The two endpoints come first and
+	// then 12 bits of indices per row, little-endian.
+	void FlipAlphaBlock(uint8* block)
+	{
+		uint64 indices = 0;
+		for (int b = 0; b < 6; b++)
+			indices |= uint64(block[2+b]) << (8*b);
+
+		uint64 flipped = 0;
+		for (int row = 0; row < 4; row++)
+			flipped |= ((indices >> (12*row)) & 0xFFF) << (12*(3-row));
+
+		for (int b = 0; b < 6; b++)
+			block[2+b] = uint8(flipped >> (8*b));
+	}
+
+	// Reverses the rows of 2-bit colour indices in a BC1 block or the colour half of a BC2 or BC3 block. Each row is a
+	// byte after the two colours.
+	void FlipColourBlock(uint8* block)
+	{
+		tStd::tSwap(block[4], block[7]);
+		tStd::tSwap(block[5], block[6]);
+	}
+
+	// Flips the rows inside each block. This is written from the block layouts in the D3D docs rather than shared with
+	// the loader, so a mistake there can't hide itself.
+	void FlipBlocks(uint8* blocks, tPixelFormat format, int numBytes)
+	{
+		int blockBytes = tGetBytesPer4x4PixelBlock(format);
+		for (uint8* block = blocks; block < blocks + numBytes; block += blockBytes)
+		{
+			switch (format)
+			{
+				case tPixelFormat::BC1_DXT1:
+				case tPixelFormat::BC1_DXT1BA:
+					FlipColourBlock(block);
+					break;
+
+				case tPixelFormat::BC2_DXT3:
+					// Four bits of alpha per pixel, a little-endian uint16 per row.
+					tStd::tSwap(block[0], block[6]);
+					tStd::tSwap(block[1], block[7]);
+					tStd::tSwap(block[2], block[4]);
+					tStd::tSwap(block[3], block[5]);
+					FlipColourBlock(block+8);
+					break;
+
+				case tPixelFormat::BC3_DXT5:
+					FlipAlphaBlock(block);
+					FlipColourBlock(block+8);
+					break;
+
+				case tPixelFormat::BC4_ATI1:
+					FlipAlphaBlock(block);
+					break;
+
+				case tPixelFormat::BC5_ATI2:
+					FlipAlphaBlock(block);
+					FlipAlphaBlock(block+8);
+					break;
+
+				default:
+					break;
+			}
+		}
+	}
+
+	// Saves a texture, or a cubemap if there are six sides, loads it back and compares it to the originals. Returns a
+	// description of the first difference or nullptr if there were none.
+	const char* RoundTrip
+	(
+		const tString& ddsFile, const tList<tLayer>* sides, int numSides, bool saveReversed, bool loadReversed
+	)
+	{
+		tFileDDS dds;
+		try
+		{
+			if (numSides == tFileDDS::tSurfIndex_NumSurfaces)
+			{
+				const tList<tLayer>* sidePtrs[tFileDDS::tSurfIndex_NumSurfaces];
+				for (int side = 0; side < numSides; side++)
+					sidePtrs[side] = &sides[side];
+				tFileDDS::Save(ddsFile, sidePtrs, saveReversed);
+			}
+			else
+			{
+				tFileDDS::Save(ddsFile, sides[0], saveReversed);
+			}
+			dds.Load(ddsFile, loadReversed);
+		}
+		catch (tDDSError&)
+		{
+			return "Save or load threw.";
+		}
+
+		if (dds.IsCubemap() != (numSides == tFileDDS::tSurfIndex_NumSurfaces) || (dds.GetNumImages() != numSides))
+			return "Wrong number of images.";
+		if (dds.GetNumMipmapLevels() != sides[0].GetNumItems())
+			return "Wrong number of mipmaps.";
+
+		// If the flags differ the loaded layers are the originals with their rows reversed. For BC formats a row is a
+		// row of blocks, and the rows inside each block need flipping too.
+		const char* problem = nullptr;
+		uint8* flipped = new uint8[sides[0].First()->GetDataSize()];
+		for (int side = 0; (side < numSides) && !problem; side++)
+		{
+			int layerNum = 0;
+			for (const tLayer* orig = sides[side].First(); orig && !problem; orig = orig->Next(), layerNum++)
+			{
+				const tLayer* loaded = dds.GetLayer(layerNum, side);
+				if
+				(
+					(loaded->PixelFormat != orig->PixelFormat) ||
+					(loaded->Width != orig->Width) || (loaded->Height != orig->Height)
+				)
+				{
+					problem = "Pixel format or dimensions changed.";
+					break;
+				}
+
+				const uint8* expected = orig->Data;
+				if (saveReversed != loadReversed)
+				{
+					bool blocks = tIsBlockFormat(orig->PixelFormat);
+					int numRows = blocks ? (orig->Height + 3) / 4 : orig->Height;
+					int rowBytes = orig->GetDataSize() / numRows;
+					for (int row = 0; row < numRows; row++)
+						tStd::tMemcpy(flipped + row*rowBytes, orig->Data + (numRows-1-row)*rowBytes, rowBytes);
+					if (blocks)
+						FlipBlocks(flipped, orig->PixelFormat, orig->GetDataSize());
+					expected = flipped;
+				}
+
+				if (tStd::tMemcmp(loaded->Data, expected, orig->GetDataSize()))
+					problem = (saveReversed != loadReversed) ? "Rows were not reversed." : "Pixel data changed.";
+			}
+		}
+
+		delete[] flipped;
+		return problem;
+	}
+}
+
+
+bool Test::DDS()
+{
+	Checks check("DDS");
+
+	// These are all the formats tFileDDS writes. The 32x16 main layer gives mipmaps with one dimension smaller than a
+	// BC block and mipmaps smaller than a block in both.
+	tPixelFormat formats[] =
+	{
+		tPixelFormat::BC1_DXT1,		tPixelFormat::BC1_DXT1BA,	tPixelFormat::BC2_DXT3,		tPixelFormat::BC3_DXT5,
+		tPixelFormat::BC4_ATI1,		tPixelFormat::BC5_ATI2,		tPixelFormat::BC6H,			tPixelFormat::BC7,
+		tPixelFormat::R8G8B8,		tPixelFormat::B8G8R8,		tPixelFormat::R8G8B8A8,		tPixelFormat::B8G8R8A8,
+		tPixelFormat::G3B5A1R5G2,	tPixelFormat::G4B4A4R4,		tPixelFormat::G3B5R5G3,		tPixelFormat::L8A8
+	};
+	const int width = 32;
+	const int height = 16;
+
+	tString ddsFile = GetDataDir("DDS") + "RoundTrip.dds";
+	uint32 seed = 1;
+	for (int f = 0; f < tNumElements(formats); f++)
+	{
+		tPixelFormat format = formats[f];
+		bool flippable = (format != tPixelFormat::BC6H) && (format != tPixelFormat::BC7);
+		for (int cubemap = 0; cubemap < 2; cubemap++)
+		{
+			int numSides = cubemap ? int(tFileDDS::tSurfIndex_NumSurfaces) : 1;
+			tList<tLayer> sides[tFileDDS::tSurfIndex_NumSurfaces];
+			for (int side = 0; side < numSides; side++)
+				MakeRandomLayers(sides[side], format, width, height, seed);
+
+			for (int flags = 0; flags < 4; flags++)
+			{
+				bool saveReversed = (flags & 1) ? true : false;
+				bool loadReversed = (flags & 2) ? true : false;
+				const char* problem = nullptr;
+
+				// BC6H and BC7 can't be flipped. Saving or loading them with the flag set has to throw.
+				if (!flippable && (saveReversed || loadReversed))
+				{
+					if (!RoundTrip(ddsFile, sides, numSides, saveReversed, loadReversed))
+						problem = "Reversing rows did not throw.";
+				}
+				else
+				{
+					problem = RoundTrip(ddsFile, sides, numSides, saveReversed, loadReversed);
+				}
+
+				check
+				(
+					!problem, "%s %s saved %s loaded %s. %s",
+					tGetPixelFormatName(format), cubemap ? "cubemap" : "texture",
+					saveReversed ? "reversed" : "unreversed", loadReversed ? "reversed" : "unreversed", problem
+				);
+			}
+		}
+	}
+
+	tSystem::tDeleteFile(ddsFile);
+	return check.Report();
+}
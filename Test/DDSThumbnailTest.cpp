@@ -0,0 +1,333 @@
+// DDSThumbnailTest.cpp
+//
+// Saves dds files with full mipmap chains and checks the thumbnail loader picks the smallest mipmap that still covers
+// the thumbnail box, and that it reads that mipmap's data unchanged from 2D textures and from the right cubemap side,
+// with and without reversing the rows. Checks cut short, missing and non-dds files give nothing, and that a thumbnail
+// made from the closest mipmap looks like one made from the main image. The benchmark makes thumbnails of large files
+// both ways and prints the times.
+//
+// Copyright (c) 2020 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <Math/tFundamentals.h>
+#include <System/tFile.h>
+#include <System/tTime.h>
+#include <System/tPrint.h>
+#include <Image/tFileDDS.h>
+#include <Image/tPicture.h>
+#include <Image/tPixelConvert.h>
+#include <Image/tBlockCompress.h>
+#include "Fixtures.h"
+#include "Tests.h"
+using namespace tImage;
+
+
+namespace
+{
+	// The same box the viewer makes thumbnails for.
+	const int ThumbWidth = 256;
+	const int ThumbHeight = 144;
+
+	const int NumBenchFiles = 8;
+	const int BenchSize = 2048;
+
+	// Works out the level independently of the loader. A level covers the box if scaling it to fit the box does not
+	// make it bigger, which is when either side is at least as big as the box.
+	int GetExpectedLevel(int width, int height, int numLevels, int fitWidth, int fitHeight)
+	{
+		int expected = 0;
+		for (int level = 1; level < numLevels; level++)
+		{
+			int w = tMath::tMax(1, width >> level);
+			int h = tMath::tMax(1, height >> level);
+			float scale = tMath::tMin(float(fitWidth)/float(w), float(fitHeight)/float(h));
+			if (scale <= 1.0f)
+				expected = level;
+		}
+		return expected;
+	}
+
+	tLayer* GetLevel(const tList<tLayer>& layers, int level)
+	{
+		tLayer* layer = layers.First();
+		for (int l = 0; (l < level) && layer; l++)
+			layer = layer->Next();
+		return layer;
+	}
+
+	bool IsSameLayer(const tLayer* a, const tLayer* b)
+	{
+		if (!a || !b || (a->Width != b->Width) || (a->Height != b->Height) || (a->PixelFormat != b->PixelFormat))
+			return false;
+
+		int numBytes = a->GetDataSize();
+		return (numBytes == b->GetDataSize()) && !tStd::tMemcmp(a->Data, b->Data, numBytes);
+	}
+
+	// Decodes the layer to a picture the way the viewer does, leaving the rows in the order they are in the layer.
+	bool Decode(tPicture& picture, const tLayer* layer)
+	{
+		int numPixels = layer->Width*layer->Height;
+		tPixel* pixels = tPicture::AllocPixels(numPixels);
+		bool decoded = tIsNormalFormat(layer->PixelFormat) ?
+			tConvertPixels(pixels, tPixelFormat::R8G8B8A8, layer->Data, layer->PixelFormat, numPixels, 1) :
+			tDecodeBC(pixels, layer->Data, layer->Width, layer->Height, layer->PixelFormat);
+		if (!decoded)
+		{
+			tPicture::FreePixels(pixels);
+			return false;
+		}
+
+		picture.Set(layer->Width, layer->Height, pixels, false);
+		return true;
+	}
+
+	// Resamples the picture so it fits the thumbnail box and keeps its aspect.
+	void FitThumbnail(tPicture& picture)
+	{
+		float scale = tMath::tMin
+		(
+			float(ThumbWidth)/float(picture.GetWidth()), float(ThumbHeight)/float(picture.GetHeight())
+		);
+		int width = tMath::tMax(1, int(tMath::tRound(float(picture.GetWidth())*scale)));
+		int height = tMath::tMax(1, int(tMath::tRound(float(picture.GetHeight())*scale)));
+		picture.Resample(width, height, tPicture::tFilter::Bilinear);
+	}
+
+	// Smooth enough that the mipmaps look like the main image made smaller.
+	void MakeSmoothPixels(tPixel* pixels, int width, int height)
+	{
+		for (int y = 0; y < height; y++)
+		{
+			for (int x = 0; x < width; x++)
+			{
+				float fx = float(x) / float(width);
+				float fy = float(y) / float(height);
+				tPixel& pixel = pixels[y*width + x];
+				pixel.R = uint8(127.5f + 127.5f*tMath::tSin(fx*6.0f));
+				pixel.G = uint8(127.5f + 127.5f*tMath::tCos(fy*5.0f));
+				pixel.B = uint8(255.0f*fx*fy);
+				pixel.A = 255;
+			}
+		}
+	}
+}
+
+
+bool Test::DDSThumbnail()
+{
+	Checks check("DDSThumbnail");
+	tString dir = GetDataDir("DDSThumbnail");
+	tString file = dir + "Thumbnail.dds";
+
+	// BC1 with binary alpha is saved as BC1_DXT1 and has to come back as BC1_DXT1BA, like a full load. BC7 can't have
+	// its rows reversed so it's only loaded the way it was saved.
+	struct Texture { tPixelFormat Format; int Width; int Height; bool Reversible; };
+	const Texture textures[] =
+	{
+		{ tPixelFormat::BC1_DXT1,	512,	256,	true	},
+		{ tPixelFormat::BC1_DXT1BA,	512,	256,	true	},
+		{ tPixelFormat::BC3_DXT5,	64,		1024,	true	},
+		{ tPixelFormat::BC7,		512,	256,	false	},
+		{ tPixelFormat::R8G8B8A8,	64,		1024,	true	}
+	};
+	const int boxes[][2] = { { ThumbWidth, ThumbHeight }, { 1, 1 }, { 4096, 4096 }, { 100, 1000 }, { 33, 5 } };
+
+	uint32 seed = 1;
+	for (int t = 0; t < tNumElements(textures); t++)
+	{
+		const Texture& texture = textures[t];
+		const char* formatName = tGetPixelFormatName(texture.Format);
+		tList<tLayer> layers;
+		MakeRandomLayers(layers, texture.Format, texture.Width, texture.Height, seed);
+		int numLevels = layers.GetNumItems();
+		tFileDDS::Save(file, layers, false);
+
+		int numWrong = 0;
+		for (int b = 0; b < tNumElements(boxes); b++)
+		{
+			int fitW = boxes[b][0];
+			int fitH = boxes[b][1];
+			int level = GetExpectedLevel(texture.Width, texture.Height, numLevels, fitW, fitH);
+			tLayer* closest = tFileDDS::LoadClosestLayer(file, fitW, fitH, tFileDDS::tSurfIndex_Default, false);
+			if (!IsSameLayer(closest, GetLevel(layers, level)))
+				numWrong++;
+			delete closest;
+		}
+		check
+		(
+			!numWrong, "%s %dx%d read the wrong mipmap for %d boxes.",
+			formatName, texture.Width, texture.Height, numWrong
+		);
+
+		// Reversed rows must match what a full load with reversed rows gives for the same level.
+		tFileDDS::tSurfIndex surf = tFileDDS::tSurfIndex_Default;
+		tLayer* reversed = tFileDDS::LoadClosestLayer(file, ThumbWidth, ThumbHeight, surf, true);
+		if (texture.Reversible)
+		{
+			tFileDDS dds(file, true);
+			int level = GetExpectedLevel(texture.Width, texture.Height, numLevels, ThumbWidth, ThumbHeight);
+			bool same = dds.IsValid() && (level < dds.GetNumMipmapLevels());
+			same = same && IsSameLayer(reversed, dds.GetLayer(level, 0));
+			check(same, "%s reversed rows differ from a full load.", formatName);
+		}
+		else
+		{
+			check(!reversed, "%s had its rows reversed.", formatName);
+		}
+		delete reversed;
+	}
+
+	// Every side of the cubemap is different, so reading the wrong one is caught.
+	tList<tLayer> sides[tFileDDS::tSurfIndex_NumSurfaces];
+	const tList<tLayer>* sidePtrs[tFileDDS::tSurfIndex_NumSurfaces];
+	for (int side = 0; side < tFileDDS::tSurfIndex_NumSurfaces; side++)
+	{
+		MakeRandomLayers(sides[side], tPixelFormat::BC1_DXT1, 512, 512, seed);
+		sidePtrs[side] = &sides[side];
+	}
+	tFileDDS::Save(file, sidePtrs, false);
+	int numSidesWrong = 0;
+	int cubeLevel = GetExpectedLevel(512, 512, sides[0].GetNumItems(), ThumbWidth, ThumbHeight);
+	for (int side = 0; side < tFileDDS::tSurfIndex_NumSurfaces; side++)
+	{
+		tFileDDS::tSurfIndex surf = tFileDDS::tSurfIndex(side);
+		tLayer* closest = tFileDDS::LoadClosestLayer(file, ThumbWidth, ThumbHeight, surf, false);
+		if (!IsSameLayer(closest, GetLevel(sides[side], cubeLevel)))
+			numSidesWrong++;
+		delete closest;
+	}
+	check(!numSidesWrong, "%d cubemap sides read the wrong data.", numSidesWrong);
+
+	// A file cut short before the level it needs, a file that isn't a dds, and a missing file give nothing.
+	int numBytes = 0;
+	uint8* data = tSystem::tLoadFile(file, nullptr, &numBytes);
+	tFileHandle handle = tSystem::tOpenFile(file.Chars(), "wb");
+	tSystem::tWriteFile(handle, data, numBytes/2);
+	tSystem::tCloseFile(handle);
+	delete[] data;
+	tLayer* cut = tFileDDS::LoadClosestLayer(file, ThumbWidth, ThumbHeight, tFileDDS::tSurfIndex_PosZ, false);
+	check(!cut, "A cut short file gave a layer.");
+	delete cut;
+
+	tString notDDS = dir + "NotDDS.dds";
+	uint8 junkData[1024];
+	for (int b = 0; b < tNumElements(junkData); b++)
+		junkData[b] = uint8(Random(seed));
+	handle = tSystem::tOpenFile(notDDS.Chars(), "wb");
+	tSystem::tWriteFile(handle, junkData, tNumElements(junkData));
+	tSystem::tCloseFile(handle);
+	tLayer* junk = tFileDDS::LoadClosestLayer(notDDS, ThumbWidth, ThumbHeight);
+	check(!junk, "A file that isn't a dds gave a layer.");
+	delete junk;
+
+	tLayer* missing = tFileDDS::LoadClosestLayer(dir + "Missing.dds", ThumbWidth, ThumbHeight);
+	check(!missing, "A missing file gave a layer.");
+	delete missing;
+
+	// A thumbnail from the closest mipmap should look like one made by shrinking the main image.
+	const int smoothSize = 1024;
+	tPicture smooth(smoothSize, smoothSize);
+	MakeSmoothPixels(smooth.GetPixelPointer(), smoothSize, smoothSize);
+	tList<tLayer> chain;
+	while (1)
+	{
+		int w = smooth.GetWidth();
+		int h = smooth.GetHeight();
+		int size = tGetBCEncodedSize(tPixelFormat::BC1_DXT1, w, h);
+		uint8* blocks = new uint8[size];
+		tEncodeBC(blocks, smooth.GetPixels(), w, h, tPixelFormat::BC1_DXT1);
+		chain.Append(new tLayer(tPixelFormat::BC1_DXT1, w, h, blocks, true));
+		if ((w == 1) && (h == 1))
+			break;
+		smooth.ScaleHalf();
+	}
+	tFileDDS::Save(file, chain, false);
+
+	tPicture fromMain, fromClosest;
+	tFileDDS dds(file, false);
+	bool mainOk = dds.IsValid() && Decode(fromMain, dds.GetLayer(0, 0));
+	tLayer* closest = tFileDDS::LoadClosestLayer(file, ThumbWidth, ThumbHeight, tFileDDS::tSurfIndex_Default, false);
+	int closestWidth = closest ? closest->Width : 0;
+	bool closestOk = closest && Decode(fromClosest, closest);
+	delete closest;
+	check(mainOk && closestOk, "Could not decode the smooth texture.");
+	check(closestWidth == 256, "The smooth texture used a %d wide mipmap instead of 256.", closestWidth);
+	if (mainOk && closestOk)
+	{
+		FitThumbnail(fromMain);
+		FitThumbnail(fromClosest);
+		bool sameSize =
+			(fromMain.GetWidth() == fromClosest.GetWidth()) && (fromMain.GetHeight() == fromClosest.GetHeight());
+		double psnr = sameSize ? GetPSNR(fromMain.GetPixels(), fromClosest.GetPixels(), fromMain.GetNumPixels()) : 0.0;
+		check(psnr >= 30.0, "The thumbnail from the mipmap differs from the main image by %.1f dB.", psnr);
+	}
+
+	tSystem::tDeleteFile(file);
+	tSystem::tDeleteFile(notDDS);
+	return check.Report();
+}
+
+
+bool Test::DDSThumbnailBench()
+{
+	Checks check("DDSThumbnailBench");
+	tString dir = GetDataDir("DDSThumbnail");
+
+	// Half BC1 and half uncompressed. The data is random since only the reading and decoding is timed.
+	tString files[NumBenchFiles];
+	uint32 seed = 1;
+	for (int f = 0; f < NumBenchFiles; f++)
+	{
+		tsPrintf(files[f], "%sBench%d.dds", dir.Chars(), f);
+		tPixelFormat format = (f%2) ? tPixelFormat::R8G8B8A8 : tPixelFormat::BC1_DXT1;
+		tList<tLayer> layers;
+		MakeRandomLayers(layers, format, BenchSize, BenchSize, seed);
+		tFileDDS::Save(files[f], layers, false);
+	}
+
+	// Load everything and decode the main image, which is what thumbnails did before.
+	int numFailed = 0;
+	double start = tSystem::tGetTimeDouble();
+	for (int f = 0; f < NumBenchFiles; f++)
+	{
+		tFileDDS dds(files[f], false);
+		tPicture picture;
+		if (dds.IsValid() && Decode(picture, dds.GetLayer(0, 0)))
+			FitThumbnail(picture);
+		else
+			numFailed++;
+	}
+	double fullTime = tSystem::tGetTimeDouble() - start;
+
+	start = tSystem::tGetTimeDouble();
+	for (int f = 0; f < NumBenchFiles; f++)
+	{
+		tFileDDS::tSurfIndex surf = tFileDDS::tSurfIndex_Default;
+		tLayer* layer = tFileDDS::LoadClosestLayer(files[f], ThumbWidth, ThumbHeight, surf, false);
+		tPicture picture;
+		if (layer && Decode(picture, layer))
+			FitThumbnail(picture);
+		else
+			numFailed++;
+		delete layer;
+	}
+	double closestTime = tSystem::tGetTimeDouble() - start;
+	check(!numFailed, "%d thumbnails failed.", numFailed);
+
+	tPrintf("%d files of %dx%d, BC1 and R8G8B8A8\n", NumBenchFiles, BenchSize, BenchSize);
+	tPrintf("Main image      %7.2f ms per thumbnail\n", fullTime*1000.0/double(NumBenchFiles));
+	tPrintf("Closest mipmap  %7.2f ms per thumbnail\n", closestTime*1000.0/double(NumBenchFiles));
+	tPrintf("Speedup         %7.1fx\n", fullTime/tMath::tMax(closestTime, 1.0e-9));
+
+	for (int f = 0; f < NumBenchFiles; f++)
+		tSystem::tDeleteFile(files[f]);
+	return check.Report();
+}
@@ -0,0 +1,262 @@
+// DecodeCacheTest.cpp
+//
+// Saves decoded pictures to the pixel cache directly and on the worker thread and checks a hit gives back exactly the
+// pictures that were saved, including after the cache is reopened and after the caller changes its pictures. Checks
+// the keys follow the path, size and decode options of the file, that cut short entries and ones over budget are
+// dropped, and that the least recently used entries go first. The benchmark times a hit against decoding a big png.
+//
+// Copyright (c) 2020 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <Math/tFundamentals.h>
+#include <System/tFile.h>
+#include <System/tTime.h>
+#include <System/tPrint.h>
+#include <Image/tFilePNG.h>
+#include <Image/tPicture.h>
+#include "PixelCache.h"
+#include "Fixtures.h"
+#include "Tests.h"
+using namespace tImage;
+
+
+namespace
+{
+	const int64 CacheBytes = int64(64) << 20;
+
+	// Starts from an empty cache directory so entries left by an earlier run don't count.
+	void InitEmpty(PixelCache& cache, const tString& cacheDir)
+	{
+		cache.Init(cacheDir, 0);
+		cache.SetMaxBytes(CacheBytes);
+	}
+
+	// A main picture and two smaller ones, like an image with mipmaps. The odd sizes don't line up with anything.
+	void MakePictures(tList<tPicture>& pictures, int width, int height, uint32& seed)
+	{
+		for (int p = 0; p < 3; p++)
+		{
+			tPicture* picture = new tPicture(width, height);
+			Test::MakePatternPixels(picture->GetPixelPointer(), width, height, Test::NumPatterns-1, seed);
+			picture->SrcFileBitDepth = 24;
+			picture->SrcFileNumFrames = 1 + p;
+			pictures.Append(picture);
+			width = tMath::tMax(1, width/2);
+			height = tMath::tMax(1, height/2);
+		}
+	}
+
+	bool IsSame(const tList<tPicture>& a, const tList<tPicture>& b)
+	{
+		if (a.GetNumItems() != b.GetNumItems())
+			return false;
+
+		const tPicture* pb = b.First();
+		for (const tPicture* pa = a.First(); pa; pa = pa->Next(), pb = pb->Next())
+		{
+			if
+			(
+				(pa->GetWidth() != pb->GetWidth()) || (pa->GetHeight() != pb->GetHeight()) ||
+				(pa->SrcFileBitDepth != pb->SrcFileBitDepth) || (pa->SrcFileNumFrames != pb->SrcFileNumFrames) ||
+				Test::CountDifferences(pa->GetPixels(), pb->GetPixels(), pa->GetNumPixels())
+			)
+				return false;
+		}
+		return true;
+	}
+
+	bool WriteBytes(const tString& file, const uint8* data, int numBytes)
+	{
+		tFileHandle handle = tSystem::tOpenFile(file.Chars(), "wb");
+		if (!handle)
+			return false;
+		bool ok = tSystem::tWriteFile(handle, data, numBytes) == numBytes;
+		tSystem::tCloseFile(handle);
+		return ok;
+	}
+}
+
+
+bool Test::DecodeCache()
+{
+	Checks check("DecodeCache");
+	tString dir = GetDataDir("DecodeCache");
+	tString cacheDir = dir + "Pixels/";
+
+	PixelCache cache;
+	InitEmpty(cache, cacheDir);
+	check(cache.IsValid() && !cache.GetNumEntries() && !cache.GetTotalBytes(), "The cache did not start empty.");
+
+	uint32 seed = 1;
+	tList<tPicture> pictures;
+	MakePictures(pictures, 701, 467, seed);
+	const uint64 key = 0x0123456789ABCDEFull;
+	check(cache.Save(key, pictures) && (cache.GetNumEntries() == 1), "The pictures were not saved.");
+
+	tList<tPicture> loaded;
+	check(cache.Load(loaded, key) && IsSame(loaded, pictures), "A hit differs from the saved pictures.");
+	loaded.Empty();
+	check(!cache.Load(loaded, key+1) && loaded.IsEmpty(), "A missing key hit.");
+
+	// The worker saves copies, so changing the pictures straight after asking for the save changes nothing.
+	const uint64 asyncKey = key + 2;
+	tList<tPicture> original;
+	MakePictures(original, 701, 467, seed);
+	tList<tPicture> changing;
+	for (tPicture* picture = original.First(); picture; picture = picture->Next())
+	{
+		tPicture* copy = new tPicture(*picture);
+		copy->SrcFileBitDepth = picture->SrcFileBitDepth;
+		copy->SrcFileNumFrames = picture->SrcFileNumFrames;
+		changing.Append(copy);
+	}
+	bool started = cache.SaveAsync(asyncKey, changing);
+	for (tPicture* picture = changing.First(); picture; picture = picture->Next())
+		picture->GetPixelPointer()[0] = tPixel(1, 2, 3, 4);
+	changing.Empty();
+	cache.WaitForSave();
+	loaded.Empty();
+	check(started && cache.Load(loaded, asyncKey), "The worker did not save the pictures.");
+	check(IsSame(loaded, original), "The worker saved pictures that were changed after the call.");
+
+	// A reopened cache finds both entries.
+	PixelCache reopened;
+	reopened.Init(cacheDir, CacheBytes);
+	check(reopened.GetNumEntries() == 2, "The reopened cache has %d entries instead of 2.", reopened.GetNumEntries());
+	loaded.Empty();
+	check(reopened.Load(loaded, key) && IsSame(loaded, pictures), "A hit after reopening differs.");
+
+	// The key is made from the path, size and options and not the contents, so nothing is read to make it.
+	tString imageFile = dir + "Image.png";
+	tString otherFile = dir + "Other.png";
+	uint8 data[256];
+	for (int b = 0; b < tNumElements(data); b++)
+		data[b] = uint8(b);
+	WriteBytes(imageFile, data, 256);
+	WriteBytes(otherFile, data, 256);
+	uint64 imageKey = PixelCache::ComputeKey(imageFile, 1);
+	check(imageKey && (imageKey == PixelCache::ComputeKey(imageFile, 1)), "The key is not repeatable.");
+	check(imageKey != PixelCache::ComputeKey(imageFile, 2), "The decode options don't change the key.");
+	check(imageKey != PixelCache::ComputeKey(otherFile, 1), "A different path gave the same key.");
+	WriteBytes(imageFile, data, 255);
+	check(imageKey != PixelCache::ComputeKey(imageFile, 1), "A different size gave the same key.");
+	check(!PixelCache::ComputeKey(dir + "Missing.png", 1), "A missing file has a key.");
+	tSystem::tDeleteFile(imageFile);
+	tSystem::tDeleteFile(otherFile);
+
+	// A cut short entry misses and is removed.
+	tString entryFile;
+	tsPrintf(entryFile, "%s%016|64X.pix", cacheDir.Chars(), key);
+	int numBytes = 0;
+	uint8* entryData = tSystem::tLoadFile(entryFile, nullptr, &numBytes);
+	check(entryData && WriteBytes(entryFile, entryData, numBytes - 1), "Could not cut the entry short.");
+	delete[] entryData;
+	loaded.Empty();
+	bool hit = reopened.Load(loaded, key);
+	check(!hit && loaded.IsEmpty(), "A cut short entry hit.");
+	check((reopened.GetNumEntries() == 1) && !tSystem::tFileExists(entryFile), "The cut short entry was kept.");
+
+	// Entries over a quarter of the budget aren't stored, and aren't copied for the worker either.
+	tList<tPicture> big;
+	big.Append(new tPicture(2048, 2048+1));
+	check(!reopened.Save(key, big) && !reopened.SaveAsync(key, big), "An entry over budget was saved.");
+	check(reopened.GetNumEntries() == 1, "An entry over budget was added.");
+
+	// Each entry here is about 1.7 MB. With room for a few the oldest go first, unless they were used since. The one
+	// entry left is the same size as the ones being saved.
+	int64 entryBytes = reopened.GetTotalBytes();
+	reopened.SetMaxBytes(8 << 20);
+	for (int e = 0; e < 8; e++)
+	{
+		reopened.Save(key + 10 + e, pictures);
+		if (e >= 2)
+			reopened.Load(loaded, key + 10);
+		loaded.Empty();
+	}
+	int numEntries = reopened.GetNumEntries();
+	int expectedEntries = int(reopened.GetMaxBytes() / entryBytes);
+	check(reopened.GetTotalBytes() <= reopened.GetMaxBytes(), "The cache is over budget.");
+	check(numEntries == expectedEntries, "%d entries were kept instead of %d.", numEntries, expectedEntries);
+	check(reopened.Load(loaded, key + 10), "The most recently used entry was evicted.");
+	loaded.Empty();
+	check(!reopened.Load(loaded, key + 11), "The least recently used entry was kept.");
+	loaded.Empty();
+
+	reopened.SetMaxBytes(0);
+	check(!reopened.GetNumEntries() && !reopened.GetTotalBytes(), "A zero budget did not empty the cache.");
+	cache.Init(cacheDir, 0);
+	return check.Report();
+}
+
+
+bool Test::DecodeCacheBench()
+{
+	Checks check("DecodeCacheBench");
+	tString dir = GetDataDir("DecodeCache");
+	tString cacheDir = dir + "Bench/";
+	tString pngFile = dir + "Bench.png";
+
+	const int benchSize = 4096;
+	const int numRepeats = 3;
+	uint32 seed = 1;
+	tPicture source(benchSize, benchSize);
+	MakePatternPixels(source.GetPixelPointer(), benchSize, benchSize, NumPatterns-1, seed);
+	tFilePNG(source.GetView()).Save(pngFile, tFilePNG::tFormat::Bit32, tFilePNG::tLevel::Fast);
+
+	PixelCache cache;
+	cache.Init(cacheDir, 0);
+	cache.SetMaxBytes(int64(1) << 30);
+
+	// Best of a few for each so the disk cache is warm for all of them.
+	double decodeTime = 0.0, keyTime = 0.0, saveCallTime = 0.0, saveTime = 0.0, hitTime = 0.0;
+	bool ok = true;
+	for (int r = 0; r < numRepeats; r++)
+	{
+		double start = tSystem::tGetTimeDouble();
+		tList<tPicture> pictures;
+		tPicture* picture = new tPicture();
+		pictures.Append(picture);
+		ok = picture->Load(pngFile) && ok;
+		double decode = tSystem::tGetTimeDouble() - start;
+
+		start = tSystem::tGetTimeDouble();
+		uint64 key = PixelCache::ComputeKey(pngFile, 0);
+		double keyed = tSystem::tGetTimeDouble() - start;
+
+		start = tSystem::tGetTimeDouble();
+		ok = cache.SaveAsync(key, pictures) && ok;
+		double saveCall = tSystem::tGetTimeDouble() - start;
+		cache.WaitForSave();
+		double save = tSystem::tGetTimeDouble() - start;
+
+		start = tSystem::tGetTimeDouble();
+		tList<tPicture> loaded;
+		ok = cache.Load(loaded, key) && ok;
+		double hit = tSystem::tGetTimeDouble() - start;
+		ok = ok && IsSame(loaded, pictures);
+
+		decodeTime = r ? tMath::tMin(decodeTime, decode) : decode;
+		keyTime = r ? tMath::tMin(keyTime, keyed) : keyed;
+		saveCallTime = r ? tMath::tMin(saveCallTime, saveCall) : saveCall;
+		saveTime = r ? tMath::tMin(saveTime, save) : save;
+		hitTime = r ? tMath::tMin(hitTime, hit) : hit;
+	}
+	check(ok, "A hit did not match the decoded png.");
+
+	tPrintf("%dx%d png, %.1f MB file\n", benchSize, benchSize, double(tSystem::tGetFileSize(pngFile))/(1024.0*1024.0));
+	tPrintf("Decode   %8.2f ms\n", decodeTime*1000.0);
+	tPrintf("Key      %8.3f ms\n", keyTime*1000.0);
+	tPrintf("Save     %8.2f ms on the worker, %.2f ms on the caller\n", saveTime*1000.0, saveCallTime*1000.0);
+	tPrintf("Hit      %8.2f ms, %.1fx faster than decoding\n", hitTime*1000.0, decodeTime/tMath::tMax(hitTime, 1.0e-9));
+
+	cache.SetMaxBytes(0);
+	tSystem::tDeleteFile(pngFile);
+	return check.Report();
+}
@@ -0,0 +1,200 @@
+// EditHistoryTest.cpp
+//
+// Runs a long mix of crops, resamples, rotates and flips through the edit history and keeps a copy of every state the
+// picture goes through. Checks every undo and redo gives back exactly the pixels of the state it goes to and that
+// reverting finds the saved state. With a small budget it checks the history never goes over it while it drops old
+// steps, that the dropped saved state is reported, and that undoing to a later saved state is still exact.
+//
+// Copyright (c) 2020 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <Foundation/tArray.h>
+#include <Image/tPicture.h>
+#include "EditHistory.h"
+#include "Fixtures.h"
+#include "Tests.h"
+using namespace tImage;
+
+
+namespace
+{
+	// The crops cut across tile edges and the expanding one reaches outside the picture. Each resample undoes the size
+	// change of the crop before it, so the picture stays about the same size however many edits are made.
+	const int NumOps = 6;
+	Edit GetEdit(int index, const tPicture& picture)
+	{
+		int w = picture.GetWidth();
+		int h = picture.GetHeight();
+		Edit edit;
+		switch (index % NumOps)
+		{
+			case 0:
+				edit.Operation = Edit::Op::Crop;
+				edit.Width = w - 37;	edit.Height = h - 21;
+				edit.OriginX = 11;		edit.OriginY = 5;
+				break;
+
+			case 1:
+				edit.Operation = Edit::Op::Resample;
+				edit.Width = w + 37;	edit.Height = h + 21;
+				break;
+
+			case 2:
+				edit.Operation = Edit::Op::Rotate90CW;
+				break;
+
+			case 3:
+				edit.Operation = Edit::Op::Crop;
+				edit.Width = w + 30;	edit.Height = h + 20;
+				edit.OriginX = -9;		edit.OriginY = -13;
+				break;
+
+			case 4:
+				edit.Operation = Edit::Op::Resample;
+				edit.Width = w - 30;	edit.Height = h - 20;
+				edit.Filter = tPicture::tFilter::Bicubic;
+				break;
+
+			case 5:
+				edit.Operation = Edit::Op::FlipV;
+				break;
+		}
+		return edit;
+	}
+
+	bool IsState(const tList<tPicture>& pictures, const tPicture& state)
+	{
+		const tPicture* picture = pictures.First();
+		return
+			picture && (picture->GetWidth() == state.GetWidth()) && (picture->GetHeight() == state.GetHeight()) &&
+			!Test::CountDifferences(picture->GetPixels(), state.GetPixels(), state.GetNumPixels());
+	}
+
+	// Applies edits and appends a copy of the picture after each one to states. Returns the number that failed.
+	int ApplyEdits(EditHistory& history, tList<tPicture>& pictures, tArray<tPicture*>& states, int numEdits)
+	{
+		int numFailed = 0;
+		for (int e = 0; e < numEdits; e++)
+		{
+			Edit edit = GetEdit(states.GetNumElements()-1, *pictures.First());
+			if (history.Apply(pictures, edit))
+				states.Append(new tPicture(*pictures.First()));
+			else
+				numFailed++;
+		}
+		return numFailed;
+	}
+
+	// Undoes everything that can be and then redoes it all, checking each state on the way. Returns the number of
+	// states that were wrong and sets numUndone.
+	int CountWrongStates
+	(
+		EditHistory& history, tList<tPicture>& pictures, const tArray<tPicture*>& states, int& numUndone
+	)
+	{
+		int numWrong = 0;
+		int position = states.GetNumElements() - 1;
+		numUndone = 0;
+		while (history.Undo(pictures))
+		{
+			position--;
+			numUndone++;
+			if ((position < 0) || !IsState(pictures, *states[position]))
+				numWrong++;
+		}
+
+		while (history.Redo(pictures))
+		{
+			position++;
+			if ((position >= states.GetNumElements()) || !IsState(pictures, *states[position]))
+				numWrong++;
+		}
+		return numWrong;
+	}
+
+	void DeleteStates(tArray<tPicture*>& states)
+	{
+		for (int s = 0; s < states.GetNumElements(); s++)
+			delete states[s];
+		states.Clear();
+	}
+}
+
+
+bool Test::Undo()
+{
+	Checks check("Undo");
+	int64 maxBytes = EditHistory::MaxBytes;
+
+	const int width = 517;
+	const int height = 389;
+	const int pictureBytes = width*height*int(sizeof(tPixel));
+	uint32 seed = 1;
+	tList<tPicture> pictures;
+	tPicture* original = new tPicture(width, height);
+	MakePatternPixels(original->GetPixelPointer(), width, height, NumPatterns-1, seed);
+	pictures.Append(new tPicture(*original));
+
+	// With plenty of room everything can be undone, and reverting goes back to the picture that was loaded.
+	EditHistory history;
+	history.MarkSaved();
+	tArray<tPicture*> states;
+	states.Append(new tPicture(*original));
+	const int numEdits = 48;
+	int numFailed = ApplyEdits(history, pictures, states, numEdits);
+	check(!numFailed, "%d of %d edits failed.", numFailed, numEdits);
+	check(history.GetNumSteps() == numEdits, "%d steps were kept instead of %d.", history.GetNumSteps(), numEdits);
+
+	int numUndone = 0;
+	int numWrong = CountWrongStates(history, pictures, states, numUndone);
+	check(!numWrong && (numUndone == numEdits), "%d undo and redo states differ.", numWrong);
+	check(history.IsModified() && history.RevertToSaved(pictures), "Could not revert to the saved state.");
+	check(IsState(pictures, *original) && !history.IsModified(), "Reverting did not give back the loaded picture.");
+	int64 unboundedBytes = history.GetTotalBytes();
+
+	// A budget of a few pictures. Every step is smaller than it, so nothing is ever kept over it.
+	EditHistory::MaxBytes = 4*pictureBytes;
+	history.Clear();
+	pictures.Empty();
+	pictures.Append(new tPicture(*original));
+	history.MarkSaved();
+	DeleteStates(states);
+	states.Append(new tPicture(*original));
+	int numOverBudget = 0;
+	for (int e = 0; e < numEdits; e++)
+	{
+		ApplyEdits(history, pictures, states, 1);
+		if (history.GetTotalBytes() > EditHistory::MaxBytes)
+			numOverBudget++;
+	}
+	check(!numOverBudget, "The history was over budget after %d edits.", numOverBudget);
+	check(unboundedBytes > 2*EditHistory::MaxBytes, "The edits did not go far enough over budget to test it.");
+	int numSteps = history.GetNumSteps();
+	check((numSteps > 1) && (numSteps < numEdits), "%d of %d steps were kept under budget.", numSteps, numEdits);
+
+	// The steps that are left still undo exactly. The saved state was dropped so the file needs reloading.
+	numWrong = CountWrongStates(history, pictures, states, numUndone);
+	check(!numWrong && (numUndone == numSteps), "%d undo and redo states differ under budget.", numWrong);
+	check(history.IsModified() && !history.RevertToSaved(pictures), "Reverting to a dropped saved state worked.");
+
+	// Saving part way through, as if the file was written, makes a state that can be reverted to exactly.
+	history.MarkSaved();
+	tPicture* saved = new tPicture(*pictures.First());
+	ApplyEdits(history, pictures, states, 3);
+	numOverBudget = (history.GetTotalBytes() > EditHistory::MaxBytes) ? 1 : 0;
+	check(!numOverBudget && history.RevertToSaved(pictures), "Could not revert to the later saved state.");
+	check(IsState(pictures, *saved) && !history.IsModified(), "Reverting did not give back the saved picture.");
+
+	delete saved;
+	delete original;
+	DeleteStates(states);
+	EditHistory::MaxBytes = maxBytes;
+	return check.Report();
+}
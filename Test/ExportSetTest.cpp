@@ -0,0 +1,177 @@
+// ExportSetTest.cpp
+//
+// Saves a typical set of sizes from a synthetic 4000x3000 photo-like image both with an export set and with the loops
+// it replaces, which load or copy the source and resample it from full resolution for every target, and prints the
+// timings of each. Checks that every target is saved at the right size, that the export set writes the same files on
+// one thread as on all of them, and that its outputs are close to the full resolution resamples.
+//
+// Copyright (c) 2020 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <Math/tFundamentals.h>
+#include <System/tFile.h>
+#include <System/tTime.h>
+#include <System/tPrint.h>
+#include <Image/tExportSet.h>
+#include "Fixtures.h"
+#include "Tests.h"
+using namespace tImage;
+
+
+namespace
+{
+	// The pyramid box filters before the final resample, so it is a little softer than resampling from full size but
+	// should never be far off. The difference is largest for the icon, where bilinear from full size skips most of the
+	// source pixels and aliases the noise. It comes out around 32 dB there and near 40 dB for the larger targets.
+	const double MinPSNR = 28.0;
+
+	// Smooth gradients with a little noise and some hard edges so the encoders and filters have about as much work as
+	// they would with a photo.
+	void MakePhotoPicture(tPicture& picture, int width, int height)
+	{
+		tPixel* pixels = tPicture::AllocPixels(width*height);
+		uint32 seed = 1;
+		for (int y = 0; y < height; y++)
+		{
+			for (int x = 0; x < width; x++)
+			{
+				int noise = int(Test::Random(seed) >> 20) - 8;
+				bool stripe = ((x / 97) + (y / 61)) & 1;
+				int r = (x*255)/width + noise;
+				int g = (y*255)/height + noise;
+				int b = stripe ? 200 + noise : ((x+y)*255)/(width+height);
+				pixels[y*width + x] = tColouri
+				(
+					uint8(tMath::tClamp(r, 0, 255)), uint8(tMath::tClamp(g, 0, 255)),
+					uint8(tMath::tClamp(b, 0, 255)), uint8(255)
+				);
+			}
+		}
+		picture.Set(width, height, pixels, false);
+	}
+}
+
+
+bool Test::ExportSetBench()
+{
+	Checks check("ExportSetBench");
+	tString dir = GetDataDir("ExportSet");
+
+	// A tga loads quickly, so the loop that loads the source for every target isn't made to look worse than it is.
+	tPicture photo;
+	MakePhotoPicture(photo, 4000, 3000);
+	tString sourceFile = dir + "Source.tga";
+	bool written = photo.SaveTGA(sourceFile, tFileTGA::tFormat::Auto, tFileTGA::tCompression::None);
+	if (!check(written, "Could not write %s", sourceFile.Chars()))
+		return check.Report();
+
+	tExportSet set;
+	set.AddTarget(dir + "Large.jpg",	2560,	0);
+	set.AddTarget(dir + "Medium.jpg",	1600,	0);
+	set.AddTarget(dir + "Small.jpg",	1024,	0);
+	set.AddTarget(dir + "Preview.png",	800,	0);
+	set.AddTarget(dir + "Card.png",		480,	0);
+	set.AddTarget(dir + "Thumb.png",	256,	0);
+	set.AddTarget(dir + "Icon.png",		64,		64);
+	int numTargets = set.Targets.GetNumElements();
+
+	// The export set on one thread, which shows what the pyramid saves, and then on all of them. The files from the
+	// first run are kept to compare with the second.
+	uint8** firstFiles = new uint8*[numTargets];
+	int* firstSizes = new int[numTargets];
+	for (int pass = 0; pass < 2; pass++)
+	{
+		const char* threads = pass ? "all threads" : "one thread";
+		int numSaved = set.Export(sourceFile, pass ? -1 : 1);
+		tPrintf("Export set on %s: %.3fs\n", threads, set.TotalTime);
+		set.PrintTimings();
+		check(numSaved == numTargets, "Export set on %s saved %d targets.", threads, numSaved);
+
+		for (int t = 0; t < numTargets; t++)
+		{
+			const tExportTarget& target = set.Targets[t];
+			const tExportResult& result = set.Results[t];
+			int numBytes = 0;
+			uint8* data = result.Saved ? tSystem::tLoadFile(target.File, nullptr, &numBytes) : nullptr;
+			if (pass == 0)
+			{
+				firstFiles[t] = data;
+				firstSizes[t] = numBytes;
+				continue;
+			}
+
+			bool same = data && firstFiles[t] && (numBytes == firstSizes[t]);
+			same = same && !tStd::tMemcmp(data, firstFiles[t], numBytes);
+			check(same, "%s changes with the number of threads.", tSystem::tGetFileName(target.File).Chars());
+			delete[] data;
+			delete[] firstFiles[t];
+		}
+	}
+	delete[] firstSizes;
+	delete[] firstFiles;
+
+	tPicture* exported = new tPicture[numTargets];
+	for (int t = 0; t < numTargets; t++)
+	{
+		const tExportResult& result = set.Results[t];
+		exported[t].Load(set.Targets[t].File);
+		check
+		(
+			(exported[t].GetWidth() == result.Width) && (exported[t].GetHeight() == result.Height),
+			"%s did not load back at %dx%d.", tSystem::tGetFileName(set.Targets[t].File).Chars(),
+			result.Width, result.Height
+		);
+	}
+
+	// The first loop reloads the source for every target, as separate runs would. The second copies a loaded source
+	// and resamples it from full resolution every time. The sizes are the ones the export set worked out.
+	for (int pass = 0; pass < 2; pass++)
+	{
+		double start = tSystem::tGetTimeDouble();
+		tPicture source;
+		bool ok = true;
+		if (pass == 1)
+			ok = source.Load(sourceFile);
+		for (int t = 0; (t < numTargets) && ok; t++)
+		{
+			const tExportTarget& target = set.Targets[t];
+			const tExportResult& result = set.Results[t];
+			tPicture picture;
+			if (pass == 0)
+				ok = picture.Load(sourceFile);
+			else
+				picture.Set(source);
+
+			ok = ok && picture.Resample(result.Width, result.Height, target.Filter);
+			ok = ok && picture.Save(target.File, target.Format);
+
+			// The png outputs are lossless so they show how far the pyramid is from resampling the full image.
+			if (ok && (pass == 1) && (tSystem::tGetFileType(target.File) == tSystem::tFileType::PNG))
+			{
+				tString name = tSystem::tGetFileName(target.File);
+				double psnr = GetPSNR(picture.GetPixels(), exported[t].GetPixels(), result.Width*result.Height);
+				tPrintf("  %-20s %.1f dB from the full resolution resample\n", name.Chars(), psnr);
+				check(psnr >= MinPSNR, "%s is too far from the full resolution resample.", name.Chars());
+			}
+		}
+		tPrintf
+		(
+			"%s: %.3fs\n", pass ? "Copy and resample loop" : "Load and resample loop", tSystem::tGetTimeDouble() - start
+		);
+		check(ok, "The %s loop failed.", pass ? "copy" : "load");
+	}
+	delete[] exported;
+
+	for (int t = 0; t < numTargets; t++)
+		tSystem::tDeleteFile(set.Targets[t].File);
+	tSystem::tDeleteFile(sourceFile);
+
+	return check.Report();
+}
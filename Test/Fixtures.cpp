@@ -0,0 +1,166 @@
+// Fixtures.cpp
+//
+// Shared helpers for the TacitTest executable.
+//
+// Copyright (c) 2020 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <math.h>
+#include <stdarg.h>
+#include <Math/tFundamentals.h>
+#include <System/tFile.h>
+#include <System/tPrint.h>
+#include "Fixtures.h"
+using namespace tImage;
+
+
+bool Test::Checks::operator()(bool passed, const char* format, ...)
+{
+	NumChecks++;
+	if (passed)
+		return true;
+
+	NumFailed++;
+	va_list args;
+	va_start(args, format);
+	tString message;
+	tvsPrintf(message, format, args);
+	va_end(args);
+	tPrintf("FAIL %s: %s\n", Name.Chars(), message.Chars());
+	return false;
+}
+
+
+bool Test::Checks::Report() const
+{
+	tPrintf("%s: %d of %d checks failed.\n", Name.Chars(), NumFailed, NumChecks);
+	return NumFailed == 0;
+}
+
+
+tString Test::GetDataDir(const tString& name)
+{
+	tString dir = tSystem::tGetProgramDir() + "Data/Test/";
+	if (!tSystem::tDirExists(dir))
+		tSystem::tCreateDir(dir);
+
+	dir += name + "/";
+	if (!tSystem::tDirExists(dir))
+		tSystem::tCreateDir(dir);
+
+	return dir;
+}
+
+
+tPixel Test::GetCoordPixel(int x, int y)
+{
+	return tPixel(uint8(x), uint8(y), uint8((x >> 8) + 3*(y >> 8)), uint8(x ^ (y >> 3)));
+}
+
+
+void Test::MakePatternPixels(tPixel* pixels, int width, int height, int pattern, uint32& seed)
+{
+	const tPixel palette[] =
+	{
+		tPixel(255, 255, 255), tPixel(0, 0, 0), tPixel(200, 40, 40), tPixel(40, 200, 40),
+		tPixel(40, 40, 200), tPixel(230, 210, 20), tPixel(120, 120, 120), tPixel(20, 180, 220)
+	};
+
+	for (int y = 0; y < height; y++)
+	{
+		for (int x = 0; x < width; x++)
+		{
+			uint32 random = Random(seed);
+			int p = (pattern < NumPatterns-1) ? pattern : (((x >> 6)*7 + (y >> 6)*3) % (NumPatterns-1));
+			tPixel& pixel = pixels[y*width + x];
+			switch (p)
+			{
+				case 0:		pixel = palette[((x >> 7) + (y >> 2)) & 7];										break;
+				case 1:		pixel = tPixel(uint8(x + (random & 1)), uint8(x/2 + y), uint8(y*3 - x));			break;
+				case 2:		pixel = palette[random & 7];														break;
+				case 3:		pixel = tPixel(uint8(random), uint8(random >> 8), uint8(random >> 16));			break;
+				default:	pixel = tPixel(uint8(x), uint8(y), uint8(random), uint8(random >> 8));				break;
+			}
+		}
+	}
+}
+
+
+int Test::CountDifferences(const tPixel* a, const tPixel* b, int numPixels, bool opaque)
+{
+	int numDifferent = 0;
+	for (int p = 0; p < numPixels; p++)
+	{
+		bool same = (a[p].R == b[p].R) && (a[p].G == b[p].G) && (a[p].B == b[p].B);
+		same = same && (opaque ? (a[p].A == 255) : (a[p].A == b[p].A));
+		if (!same)
+			numDifferent++;
+	}
+
+	return numDifferent;
+}
+
+
+double Test::GetPSNR(const tPixel* a, const tPixel* b, int numPixels)
+{
+	double sum = 0.0;
+	for (int p = 0; p < numPixels; p++)
+	{
+		for (int c = 0; c < 3; c++)
+		{
+			double diff = double(a[p].E[c]) - double(b[p].E[c]);
+			sum += diff*diff;
+		}
+	}
+
+	if (sum == 0.0)
+		return 99.0;
+	double mse = sum / double(3*numPixels);
+	return 10.0*log10(255.0*255.0/mse);
+}
+
+
+void Test::MakeRandomLayers(tList<tLayer>& layers, tPixelFormat format, int width, int height, uint32& seed)
+{
+	while (1)
+	{
+		tLayer* layer = new tLayer(format, width, height, nullptr);
+		int numBytes = layer->GetDataSize();
+		layer->Data = new uint8[numBytes];
+		for (int b = 0; b < numBytes; b++)
+			layer->Data[b] = uint8(Random(seed) >> 16);
+
+		// A BC1 block starts with two little-endian R5G6B5 colours and then a byte of lookups per row. If the first
+		// colour is the larger the block is opaque, otherwise index 3 is transparent.
+		bool bc1 = (format == tPixelFormat::BC1_DXT1);
+		bool bc1BinaryAlpha = (format == tPixelFormat::BC1_DXT1BA);
+		for (int b = 0; (bc1 || bc1BinaryAlpha) && (b < numBytes); b += 8)
+		{
+			uint8* block = layer->Data + b;
+			if (bc1)
+			{
+				block[1] |= 0x80;
+				block[3] &= 0x7F;
+			}
+			else
+			{
+				block[1] &= 0x7F;
+				block[3] |= 0x80;
+				block[4] |= 0x03;
+			}
+		}
+		layers.Append(layer);
+
+		if ((width == 1) && (height == 1))
+			break;
+		width = tMath::tMax(1, width/2);
+		height = tMath::tMax(1, height/2);
+	}
+}
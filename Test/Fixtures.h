@@ -0,0 +1,77 @@
+// Fixtures.h
+//
+// Shared helpers for the TacitTest executable. Every test counts its checks with a Checks object so failures are
+// printed the same way and summarised at the end. Pseudo-random numbers all come from the same LCG so a failing seed
+// reproduces on any machine. The synthetic pictures and files the tests are run on are made here too, so no test
+// depends on image files being present.
+//
+// Copyright (c) 2020 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#pragma once
+#include <Foundation/tStandard.h>
+#include <Foundation/tString.h>
+#include <Math/tColour.h>
+#include <Foundation/tList.h>
+#include <Image/tPicture.h>
+#include <Image/tLayer.h>
+
+
+namespace Test
+{
+	// Counts the checks made by one test. A failed check prints a FAIL line straight away so it shows up next to any
+	// timings printed around it. Report prints the totals and returns true if nothing failed.
+	class Checks
+	{
+	public:
+		Checks(const char* name)																						: Name(name) { }
+
+		// Returns passed so a check can also guard the code after it. The format is only used if the check fails.
+		bool operator()(bool passed, const char* format, ...);
+
+		int GetNumChecks() const																						{ return NumChecks; }
+		int GetNumFailed() const																						{ return NumFailed; }
+		bool Report() const;
+
+	private:
+		tString Name;
+		int NumChecks = 0;
+		int NumFailed = 0;
+	};
+
+	// Steps the LCG and returns 24 random bits. Call with the same seed to get the same sequence.
+	inline uint32 Random(uint32& seed)																					{ seed = seed*1664525u + 1013904223u; return seed >> 8; }
+
+	// A random int in [0, range). Range must be > 0.
+	inline int Random(uint32& seed, int range)																			{ return int(Random(seed) % uint32(range)); }
+
+	// Returns Data/Test/name/ next to the executable, creating it if needed. Tests that write files put them here.
+	tString GetDataDir(const tString& name);
+
+	// A pixel computed from its coordinates, for pictures too big to hold. Every channel varies differently so a pixel
+	// that ends up in the wrong place is caught.
+	tPixel GetCoordPixel(int x, int y);
+
+	// Each pattern favours different encoder paths: long runs of a few colours, small differences between neighbours, a
+	// small palette in noise, rgb noise, and noisy alpha. The last pattern mixes all of them in 64x64 blocks and looks
+	// more like a real image.
+	const int NumPatterns = 6;
+	void MakePatternPixels(tPixel*, int width, int height, int pattern, uint32& seed);
+
+	// Returns the number of pixels that differ. If opaque is true the alphas of a must be 255 instead of matching b.
+	int CountDifferences(const tPixel* a, const tPixel* b, int numPixels, bool opaque = false);
+
+	// The peak signal to noise ratio of the rgb channels in dB with a peak of 255. Returns 99 if they are identical.
+	double GetPSNR(const tPixel* a, const tPixel* b, int numPixels);
+
+	// Appends a full mipmap chain of random data to layers. BC1 blocks get their colours ordered so a loader finds
+	// binary alpha in BC1_DXT1BA layers and none in BC1_DXT1 ones.
+	void MakeRandomLayers(tList<tImage::tLayer>& layers, tImage::tPixelFormat, int width, int height, uint32& seed);
+}
@@ -0,0 +1,275 @@
+// FrameSourceTest.cpp
+//
+// Builds a synthetic 2000 frame GIF in memory, using every disposal method, and plays it through a tFrameSource. Each
+// frame is checked against a composite made independently of the decoder, both when playing forward and when seeking.
+// Also checks that playing forward decodes each frame once and that memory stays within the ring and keyframe budget.
+// Prints the first frame latency and the decode and seek times.
+//
+// Copyright (c) 2019 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <Math/tFundamentals.h>
+#include <Math/tHash.h>
+#include <System/tTime.h>
+#include <System/tPrint.h>
+#include <Image/tFrameSource.h>
+#include "Fixtures.h"
+#include "Tests.h"
+using namespace tImage;
+
+
+namespace
+{
+	const int NumFrames = 2000;
+	const int FrameWidth = 320;
+	const int FrameHeight = 240;
+	const int NumSeeks = 200;
+
+	// Frame f of the synthetic GIF draws a rectangle that moves a little each frame. The disposal cycles through all
+	// four methods and every other frame has transparent pixels.
+	struct TestFrame
+	{
+		TestFrame(int frame, int width, int height)
+		{
+			Width = tMath::tMax(width / 4, 1);
+			Height = tMath::tMax(height / 4, 1);
+			Left = (frame*7) % (width - Width + 1);
+			Top = (frame*5) % (height - Height + 1);
+			Disposal = frame % 4;
+			TransparentIndex = (frame & 1) ? 0 : -1;
+		}
+
+		int GetIndex(int x, int y) const
+		{
+			// Index 0 is only used where it is transparent so the other frames fully cover their rectangle.
+			if ((TransparentIndex == 0) && (((x + y) % 5) == 0))
+				return 0;
+
+			return 1 + ((Left + x*3 + y) % 255);
+		}
+
+		int Left, Top, Width, Height;
+		int Disposal;
+		int TransparentIndex;
+	};
+
+	tPixel GetTestColour(int index)
+	{
+		return tPixel(uint8(index), uint8(255 - index), uint8(index*7), uint8(0xFF));
+	}
+
+	uint64 HashPicture(const tPicture& picture)
+	{
+		return tMath::tHashData64((const uint8*)picture.GetPixels(), picture.GetNumPixels()*int(sizeof(tPixel)));
+	}
+
+	uint8* MakeTestGIF(int& numBytes, int numFrames, int width, int height)
+	{
+		// Codes are 9 bits and a clear code is sent often enough that the decoder never widens them, so every pixel can
+		// be written as a literal. Each pixel takes at most 9/8ths of a byte plus sub-block lengths and clear codes.
+		TestFrame largest(0, width, height);
+		int maxFrameBytes = 64 + (largest.Width*largest.Height*2) + 3*256;
+		int capacity = 13 + 3*256 + numFrames*maxFrameBytes + 1;
+		uint8* data = new uint8[capacity];
+		int pos = 0;
+
+		tStd::tMemcpy(data, "GIF89a", 6);
+		pos = 6;
+		data[pos++] = uint8(width);		data[pos++] = uint8(width >> 8);
+		data[pos++] = uint8(height);	data[pos++] = uint8(height >> 8);
+		data[pos++] = 0xF7;				// Global palette of 256 colours.
+		data[pos++] = 0;
+		data[pos++] = 0;
+		for (int i = 0; i < 256; i++)
+		{
+			tPixel colour = GetTestColour(i);
+			data[pos++] = colour.R;
+			data[pos++] = colour.G;
+			data[pos++] = colour.B;
+		}
+
+		const int clearCode = 256;
+		const int endCode = 257;
+		const int codeSize = 9;
+		const int literalsPerClear = 250;
+		for (int f = 0; f < numFrames; f++)
+		{
+			TestFrame frame(f, width, height);
+			data[pos++] = 0x21;
+			data[pos++] = 0xF9;
+			data[pos++] = 4;
+			data[pos++] = uint8((frame.Disposal << 2) | ((frame.TransparentIndex >= 0) ? 1 : 0));
+			data[pos++] = 4;				// 40ms.
+			data[pos++] = 0;
+			data[pos++] = uint8(tMath::tMax(frame.TransparentIndex, 0));
+			data[pos++] = 0;
+
+			data[pos++] = 0x2C;
+			data[pos++] = uint8(frame.Left);	data[pos++] = uint8(frame.Left >> 8);
+			data[pos++] = uint8(frame.Top);		data[pos++] = uint8(frame.Top >> 8);
+			data[pos++] = uint8(frame.Width);	data[pos++] = uint8(frame.Width >> 8);
+			data[pos++] = uint8(frame.Height);	data[pos++] = uint8(frame.Height >> 8);
+			data[pos++] = 0;
+			data[pos++] = 8;
+
+			// Codes are packed least significant bit first into sub-blocks of up to 255 bytes.
+			int blockStart = pos++;
+			uint32 bitBuffer = 0;
+			int numBits = 0;
+			auto writeBits = [&](uint32 bits, int count)
+			{
+				bitBuffer |= bits << numBits;
+				numBits += count;
+				while (numBits >= 8)
+				{
+					data[pos++] = uint8(bitBuffer);
+					bitBuffer >>= 8;
+					numBits -= 8;
+					if ((pos - blockStart) == 256)
+					{
+						data[blockStart] = 255;
+						blockStart = pos++;
+					}
+				}
+			};
+
+			writeBits(clearCode, codeSize);
+			int numPixels = frame.Width*frame.Height;
+			for (int p = 0; p < numPixels; p++)
+			{
+				writeBits(frame.GetIndex(p % frame.Width, p / frame.Width), codeSize);
+				if (((p + 1) % literalsPerClear) == 0)
+					writeBits(clearCode, codeSize);
+			}
+			writeBits(endCode, codeSize);
+			writeBits(0, 7);
+
+			// The last sub-block may be empty, in which case its length byte is the terminator.
+			data[blockStart] = uint8(pos - blockStart - 1);
+			if (data[blockStart] != 0)
+				data[pos++] = 0;
+		}
+
+		data[pos++] = 0x3B;
+		tAssert(pos <= capacity);
+		numBytes = pos;
+		return data;
+	}
+
+	// The composite is made here straight from the frame rectangles, without the decoder. A hash of every frame is
+	// kept so seeks can be checked afterwards. The caller must delete[] the hashes.
+	uint64* MakeReferenceHashes(int numFrames, int width, int height)
+	{
+		tPicture reference;
+		reference.Set(width, height, tPixel::transparent);
+		tPicture previous;
+		uint64* hashes = new uint64[numFrames];
+		for (int f = 0; f < numFrames; f++)
+		{
+			TestFrame frame(f, width, height);
+			if (frame.Disposal == 3)
+				previous.Set(reference);
+
+			for (int y = 0; y < frame.Height; y++)
+			{
+				for (int x = 0; x < frame.Width; x++)
+				{
+					int index = frame.GetIndex(x, y);
+					if (index != frame.TransparentIndex)
+						reference.SetPixel(frame.Left + x, height - 1 - frame.Top - y, GetTestColour(index));
+				}
+			}
+			hashes[f] = HashPicture(reference);
+
+			if (frame.Disposal == 2)
+			{
+				for (int y = 0; y < frame.Height; y++)
+					for (int x = 0; x < frame.Width; x++)
+						reference.SetPixel(frame.Left + x, height - 1 - frame.Top - y, tPixel::transparent);
+			}
+			else if (frame.Disposal == 3)
+			{
+				reference.Set(previous);
+			}
+		}
+
+		return hashes;
+	}
+}
+
+
+bool Test::FrameSourceBench()
+{
+	Checks check("FrameSourceBench");
+	int numBytes = 0;
+	uint8* gifData = MakeTestGIF(numBytes, NumFrames, FrameWidth, FrameHeight);
+	uint64* hashes = MakeReferenceHashes(NumFrames, FrameWidth, FrameHeight);
+
+	double start = tSystem::tGetTimeDouble();
+	tFrameSource source;
+	const tPicture* picture = source.Open(gifData, numBytes) ? source.GetFrame(0) : nullptr;
+	double firstFrameTime = tSystem::tGetTimeDouble() - start;
+	delete[] gifData;
+	if (!check(picture && (source.GetNumFrames() == NumFrames), "Could not open the %d frame test GIF.", NumFrames))
+	{
+		delete[] hashes;
+		return check.Report();
+	}
+
+	// Nothing but the ring, the keyframes, the canvas and the file data may grow with the number of frames.
+	int64 frameBytes = int64(FrameWidth)*int64(FrameHeight)*int64(sizeof(tPixel));
+	int64 budget = int64(numBytes) + frameBytes*(tFrameSource::DefaultRingSize + tFrameSource::MaxKeyframes + 1);
+	int64 peakMemory = source.GetMemoryUsage();
+	double maxFrameTime = 0.0;
+	int numBad = 0;
+
+	start = tSystem::tGetTimeDouble();
+	for (int f = 0; f < NumFrames; f++)
+	{
+		double frameStart = tSystem::tGetTimeDouble();
+		picture = source.GetFrame(f);
+		maxFrameTime = tMath::tMax(maxFrameTime, tSystem::tGetTimeDouble() - frameStart);
+		peakMemory = tMath::tMax(peakMemory, source.GetMemoryUsage());
+		if (!picture || (HashPicture(*picture) != hashes[f]))
+			numBad++;
+	}
+	double playTime = tSystem::tGetTimeDouble() - start;
+	int numPlayDecodes = source.GetNumDecodes();
+
+	// Seeks jump around in a fixed pseudo-random order so they land both near and far from keyframes.
+	uint32 seed = 1;
+	start = tSystem::tGetTimeDouble();
+	for (int s = 0; s < NumSeeks; s++)
+	{
+		int f = Random(seed, NumFrames);
+		picture = source.GetFrame(f);
+		peakMemory = tMath::tMax(peakMemory, source.GetMemoryUsage());
+		if (!picture || (HashPicture(*picture) != hashes[f]))
+			numBad++;
+	}
+	double seekTime = tSystem::tGetTimeDouble() - start;
+	delete[] hashes;
+
+	tPrintf("%d frames of %dx%d. GIF is %d bytes.\n", NumFrames, FrameWidth, FrameHeight, numBytes);
+	tPrintf("Open and first frame: %.2fms\n", firstFrameTime*1000.0);
+	tPrintf
+	(
+		"Playing forward: %.3fms per frame on average, %.3fms worst, %d decodes\n",
+		playTime*1000.0/double(NumFrames), maxFrameTime*1000.0, numPlayDecodes
+	);
+	tPrintf("Seeking: %.3fms per seek on average\n", seekTime*1000.0/double(NumSeeks));
+	tPrintf("Peak memory: %.2fMB of a %.2fMB budget\n", double(peakMemory)/1048576.0, double(budget)/1048576.0);
+
+	check(!numBad, "%d frames did not match the reference.", numBad);
+	check(numPlayDecodes == NumFrames, "Playing forward took %d decodes for %d frames.", numPlayDecodes, NumFrames);
+	check(peakMemory <= budget, "Memory went over budget.");
+
+	return check.Report();
+}
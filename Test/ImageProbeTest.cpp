@@ -0,0 +1,393 @@
+// ImageProbeTest.cpp
+//
+// Probes tga, png, qoi and dds files made by the writers and checks the results against what the writers were given
+// and what a full load finds. Jpg, gif and bmp headers are built by hand, including a jpg whose start of frame comes
+// after a large exif block. Checks the type comes from the magic bytes and not the extension. The benchmark probes and
+// fully loads a folder of files and prints the throughput of each.
+//
+// Copyright (c) 2020 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <System/tFile.h>
+#include <System/tTime.h>
+#include <System/tPrint.h>
+#include <Image/tImageProbe.h>
+#include <Image/tFileDDS.h>
+#include <Image/tPicture.h>
+#include "Fixtures.h"
+#include "Tests.h"
+using namespace tImage;
+using tSystem::tFileType;
+
+
+namespace
+{
+	const int ExifSize = 20000;
+	const int NumBenchFiles = 24;
+
+	// The dds loader needs power of two sizes.
+	const int BenchWidth = 1024;
+	const int BenchHeight = 1024;
+
+	bool WriteBytes(const tString& file, const uint8* data, int numBytes)
+	{
+		tFileHandle handle = tSystem::tOpenFile(file.ConstText(), "wb");
+		if (!handle)
+			return false;
+		bool ok = tSystem::tWriteFile(handle, data, numBytes) == numBytes;
+		tSystem::tCloseFile(handle);
+		return ok;
+	}
+
+	void Put16BE(uint8* p, int v)																						{ p[0] = uint8(v >> 8); p[1] = uint8(v); }
+	void Put16LE(uint8* p, int v)																						{ p[0] = uint8(v); p[1] = uint8(v >> 8); }
+	void Put32LE(uint8* p, int v)																						{ Put16LE(p, v & 0xFFFF); Put16LE(p+2, (v >> 16) & 0xFFFF); }
+
+	// A baseline jpg header with a big APP1 block before the start of frame. There's no scan, so it can only be probed.
+	// Returns the number of bytes used.
+	int MakeJPGHeader(uint8* data, int width, int height)
+	{
+		int offset = 0;
+		data[offset++] = 0xFF; data[offset++] = 0xD8;
+		data[offset++] = 0xFF; data[offset++] = 0xE1;
+		Put16BE(data + offset, ExifSize + 2);
+		offset += 2;
+		tStd::tMemset(data + offset, 0, ExifSize);
+		offset += ExifSize;
+
+		data[offset++] = 0xFF; data[offset++] = 0xC0;
+		Put16BE(data + offset, 17);
+		data[offset+2] = 8;
+		Put16BE(data + offset + 3, height);
+		Put16BE(data + offset + 5, width);
+		data[offset+7] = 3;
+		tStd::tMemset(data + offset + 8, 0, 9);
+		offset += 17;
+
+		data[offset++] = 0xFF; data[offset++] = 0xD9;
+		return offset;
+	}
+
+	// A gif with a global palette of 4 colours and the supplied number of frames. The first frame has a graphic
+	// control extension marking a transparent colour. Returns the number of bytes used.
+	int MakeGIF(uint8* data, int width, int height, int numFrames)
+	{
+		int offset = 0;
+		tStd::tMemcpy(data, "GIF89a", 6);
+		offset += 6;
+		Put16LE(data + offset, width);
+		Put16LE(data + offset + 2, height);
+		data[offset+4] = 0x81;
+		data[offset+5] = 0;
+		data[offset+6] = 0;
+		offset += 7;
+		tStd::tMemset(data + offset, 0x40, 12);
+		offset += 12;
+
+		const uint8 control[] = { 0x21, 0xF9, 0x04, 0x01, 0x00, 0x00, 0x00, 0x00 };
+		tStd::tMemcpy(data + offset, control, sizeof(control));
+		offset += sizeof(control);
+		for (int f = 0; f < numFrames; f++)
+		{
+			data[offset] = 0x2C;
+			Put16LE(data + offset + 1, 0);
+			Put16LE(data + offset + 3, 0);
+			Put16LE(data + offset + 5, width);
+			Put16LE(data + offset + 7, height);
+			data[offset+9] = 0;
+			offset += 10;
+
+			// The minimum code size then one sub-block of junk and the terminator.
+			const uint8 image[] = { 0x02, 0x03, 0x11, 0x22, 0x33, 0x00 };
+			tStd::tMemcpy(data + offset, image, sizeof(image));
+			offset += sizeof(image);
+		}
+		data[offset++] = 0x3B;
+		return offset;
+	}
+
+	// A bmp file and info header for a bottom-up or top-down 24 bit image. Returns the number of bytes used.
+	int MakeBMPHeader(uint8* data, int width, int height)
+	{
+		tStd::tMemset(data, 0, 54);
+		data[0] = 'B'; data[1] = 'M';
+		Put32LE(data + 2, 54);
+		Put32LE(data + 10, 54);
+		Put32LE(data + 14, 40);
+		Put32LE(data + 18, width);
+		Put32LE(data + 22, height);
+		Put16LE(data + 26, 1);
+		Put16LE(data + 28, 24);
+		return 54;
+	}
+
+	// Returns a description of the first field that doesn't match, or nullptr.
+	const char* Mismatch
+	(
+		const tImageInfo& info, tFileType type, int width, int height, int bitDepth, bool opaque,
+		int numMipmaps = 1, bool cubemap = false
+	)
+	{
+		if (!info.IsValid())			return "invalid";
+		if (info.FileType != type)		return "type";
+		if (info.Width != width)		return "width";
+		if (info.Height != height)		return "height";
+		if (info.BitDepth != bitDepth)	return "bit depth";
+		if (info.Opaque != opaque)		return "opacity";
+		if (info.NumMipmaps != numMipmaps)
+			return "mipmaps";
+		if (info.Cubemap != cubemap)
+			return "cubemap";
+		return nullptr;
+	}
+
+	// Makes the bench folder of files. Each file is a different picture so the loads can't share any work.
+	void MakeBenchFiles(const tString& dir, tString* files, uint32& seed)
+	{
+		const char* exts[4] = { "png", "qoi", "tga", "dds" };
+		tPicture picture(BenchWidth, BenchHeight);
+		for (int f = 0; f < NumBenchFiles; f++)
+		{
+			tsPrintf(files[f], "%sBench%02d.%s", dir.ConstText(), f, exts[f%4]);
+			if ((f%4) == 3)
+			{
+				tList<tLayer> layers;
+				Test::MakeRandomLayers(layers, tPixelFormat::BC1_DXT1, BenchWidth, BenchHeight, seed);
+				tFileDDS::Save(files[f], layers);
+				continue;
+			}
+
+			Test::MakePatternPixels(picture.GetPixelPointer(), BenchWidth, BenchHeight, Test::NumPatterns-1, seed);
+			switch (f%4)
+			{
+				case 0:	picture.SavePNG(files[f], tFilePNG::tFormat::Auto, tFilePNG::tLevel::Fastest);	break;
+				case 1:	picture.SaveQOI(files[f]);														break;
+				case 2:	picture.SaveTGA(files[f]);														break;
+			}
+		}
+	}
+}
+
+
+bool Test::ImageProbe()
+{
+	Checks check("ImageProbe");
+	tString dir = GetDataDir("ImageProbe");
+	uint32 seed = 1;
+
+	// Files from the writers. Each is probed and loaded, and both must agree with what was written.
+	const int sizes[][2] = { { 1, 1 }, { 37, 19 }, { 300, 200 } };
+	for (int s = 0; s < tNumElements(sizes); s++)
+	{
+		int width = sizes[s][0];
+		int height = sizes[s][1];
+		tPicture picture(width, height);
+		MakePatternPixels(picture.GetPixelPointer(), width, height, 0, seed);
+		for (int alpha = 0; alpha < 2; alpha++)
+		{
+			picture.GetPixelPointer()[0].A = alpha ? 128 : 255;
+			int bitDepth = alpha ? 32 : 24;
+			struct { const char* Ext; tFileType Type; } kinds[] =
+			{
+				{ "png", tFileType::PNG }, { "qoi", tFileType::QOI }, { "tga", tFileType::TGA }
+			};
+			for (int k = 0; k < tNumElements(kinds); k++)
+			{
+				tString file = dir + "Probe." + kinds[k].Ext;
+				bool saved = false;
+				switch (kinds[k].Type)
+				{
+					case tFileType::PNG:	saved = picture.SavePNG(file);	break;
+					case tFileType::QOI:	saved = picture.SaveQOI(file);	break;
+					default:				saved = picture.SaveTGA(file);	break;
+				}
+
+				tImageInfo info;
+				bool probed = saved && tProbeImage(info, file);
+				const char* wrong = probed ? Mismatch(info, kinds[k].Type, width, height, bitDepth, !alpha) : "probe";
+				tPixelFormat format = alpha ? tPixelFormat::R8G8B8A8 : tPixelFormat::R8G8B8;
+				if (!wrong && (info.PixelFormat != format))
+					wrong = "pixel format";
+				check(!wrong, "%dx%d %s with alpha %d has the wrong %s.", width, height, kinds[k].Ext, alpha, wrong);
+
+				tPicture loaded;
+				bool same = loaded.Load(file) && (loaded.GetWidth() == info.Width);
+				same = same && (loaded.GetHeight() == info.Height) && (loaded.IsOpaque() == info.Opaque);
+				check(same, "%dx%d %s with alpha %d probes differently to a load.", width, height, kinds[k].Ext, alpha);
+			}
+		}
+	}
+
+	// Dds textures and cubemaps, with and without the DX10 header. BC7 can't be flipped, so rows are saved as they are.
+	struct { tPixelFormat Format; int Width, Height; bool Cubemap; int BitDepth; bool Opaque; } textures[] =
+	{
+		{ tPixelFormat::BC1_DXT1, 256, 64, false, 4, true },
+		{ tPixelFormat::BC3_DXT5, 64, 64, true, 8, false },
+		{ tPixelFormat::BC7, 32, 128, false, 8, true },
+		{ tPixelFormat::R8G8B8A8, 16, 8, false, 32, false }
+	};
+	tString ddsFile = dir + "Probe.dds";
+	for (int t = 0; t < tNumElements(textures); t++)
+	{
+		tList<tLayer> sides[tFileDDS::tSurfIndex_NumSurfaces];
+		int numSides = textures[t].Cubemap ? int(tFileDDS::tSurfIndex_NumSurfaces) : 1;
+		for (int side = 0; side < numSides; side++)
+			MakeRandomLayers(sides[side], textures[t].Format, textures[t].Width, textures[t].Height, seed);
+		int numMipmaps = sides[0].GetNumItems();
+
+		bool saved = true;
+		try
+		{
+			if (textures[t].Cubemap)
+			{
+				const tList<tLayer>* sidePtrs[tFileDDS::tSurfIndex_NumSurfaces];
+				for (int side = 0; side < numSides; side++)
+					sidePtrs[side] = &sides[side];
+				tFileDDS::Save(ddsFile, sidePtrs, false);
+			}
+			else
+			{
+				tFileDDS::Save(ddsFile, sides[0], false);
+			}
+		}
+		catch (tDDSError&)
+		{
+			saved = false;
+		}
+
+		tImageInfo info;
+		bool probed = saved && tProbeImage(info, ddsFile);
+		const char* wrong = probed ? Mismatch
+		(
+			info, tFileType::DDS, textures[t].Width, textures[t].Height, textures[t].BitDepth, textures[t].Opaque,
+			numMipmaps, textures[t].Cubemap
+		) : "probe";
+		if (!wrong && (info.PixelFormat != textures[t].Format))
+			wrong = "pixel format";
+		check(!wrong, "Dds %d has the wrong %s.", t, wrong);
+	}
+
+	// The type comes from the magic bytes. A png with a tga extension is still a png.
+	tPicture picture(40, 30);
+	MakePatternPixels(picture.GetPixelPointer(), 40, 30, 1, seed);
+	tString pngFile = dir + "Probe.png";
+	tString misnamedFile = dir + "Misnamed.tga";
+	picture.SavePNG(pngFile, tFilePNG::tFormat::Bit32);
+	int numBytes = 0;
+	uint8* data = tSystem::tLoadFile(pngFile, nullptr, &numBytes);
+	bool written = data && WriteBytes(misnamedFile, data, numBytes);
+	delete[] data;
+	tImageInfo info;
+	check(written && tProbeImage(info, misnamedFile) && (info.FileType == tFileType::PNG), "The extension was used.");
+
+	// The jpg start of frame is past the first ProbeHeadSize bytes, so a probe of the head asks for more.
+	uint8* jpg = new uint8[ExifSize + 64];
+	int jpgSize = MakeJPGHeader(jpg, 640, 480);
+	bool needMore = false;
+	check(!tProbeImage(info, jpg, ProbeHeadSize, &needMore) && needMore, "A cut short jpg didn't ask for more.");
+	const char* wrong = tProbeImage(info, jpg, jpgSize) ? Mismatch(info, tFileType::JPG, 640, 480, 24, true) : "probe";
+	check(!wrong, "The jpg header has the wrong %s.", wrong);
+	tString jpgFile = dir + "Probe.jpg";
+	bool probed = WriteBytes(jpgFile, jpg, jpgSize) && tProbeImage(info, jpgFile);
+	wrong = probed ? Mismatch(info, tFileType::JPG, 640, 480, 24, true) : "probe";
+	check(!wrong, "The jpg file was not read past the head. Wrong %s.", wrong);
+	delete[] jpg;
+
+	// Gif frames are counted when the whole file is there and unknown when it isn't.
+	uint8 gif[256];
+	int gifSize = MakeGIF(gif, 120, 90, 3);
+	wrong = tProbeImage(info, gif, gifSize) ? Mismatch(info, tFileType::GIF, 120, 90, 2, false) : "probe";
+	check(!wrong, "The gif has the wrong %s.", wrong);
+	check(info.NumFrames == 3, "The whole gif has %d frames instead of 3.", info.NumFrames);
+	check(tProbeImage(info, gif, gifSize - 10) && (info.NumFrames == 0), "A cut short gif counted its frames.");
+
+	uint8 bmp[54];
+	MakeBMPHeader(bmp, 333, -222);
+	wrong = tProbeImage(info, bmp, sizeof(bmp)) ? Mismatch(info, tFileType::BMP, 333, 222, 24, true) : "probe";
+	check(!wrong, "The top-down bmp has the wrong %s.", wrong);
+
+	// Nothing is recognized in noise or too little data.
+	uint8 noise[512];
+	for (int b = 0; b < int(sizeof(noise)); b++)
+		noise[b] = uint8(Random(seed));
+	noise[2] = 0xEE;
+	check(!tProbeImage(info, noise, sizeof(noise)) && !info.IsValid(), "Noise was recognized.");
+	check(!tProbeImage(info, gif, 1), "One byte was recognized.");
+	check(!tProbeImage(info, dir + "Missing.png"), "A missing file was probed.");
+
+	const tString* files[] = { &pngFile, &misnamedFile, &jpgFile, &ddsFile };
+	for (int f = 0; f < tNumElements(files); f++)
+		tSystem::tDeleteFile(*files[f]);
+	tSystem::tDeleteFile(dir + "Probe.qoi");
+	tSystem::tDeleteFile(dir + "Probe.tga");
+	return check.Report();
+}
+
+
+bool Test::ImageProbeBench()
+{
+	Checks check("ImageProbeBench");
+	tString dir = GetDataDir("ImageProbe");
+	uint32 seed = 1;
+	tString files[NumBenchFiles];
+	MakeBenchFiles(dir, files, seed);
+	int64 totalBytes = 0;
+	for (int f = 0; f < NumBenchFiles; f++)
+		totalBytes += tSystem::tGetFileSize(files[f]);
+	double megabytes = double(totalBytes) / (1024.0*1024.0);
+	tPrintf("%d files of %dx%d, %.1f MB, png qoi tga and dds\n", NumBenchFiles, BenchWidth, BenchHeight, megabytes);
+
+	// Probing is repeated so the time is long enough to measure.
+	const int numProbeRepeats = 100;
+	tImageInfo infos[NumBenchFiles];
+	int numProbeFailed = 0;
+	double start = tSystem::tGetTimeDouble();
+	for (int r = 0; r < numProbeRepeats; r++)
+		for (int f = 0; f < NumBenchFiles; f++)
+			if (!tProbeImage(infos[f], files[f]))
+				numProbeFailed++;
+	double probeTime = (tSystem::tGetTimeDouble() - start) / double(numProbeRepeats);
+	check(!numProbeFailed, "%d probes failed.", numProbeFailed);
+
+	int numWrong = 0;
+	start = tSystem::tGetTimeDouble();
+	for (int f = 0; f < NumBenchFiles; f++)
+	{
+		int width = 0, height = 0;
+		if ((f%4) == 3)
+		{
+			tFileDDS dds(files[f]);
+			width = dds.GetWidth();
+			height = dds.GetHeight();
+		}
+		else
+		{
+			tPicture picture;
+			picture.Load(files[f]);
+			width = picture.GetWidth();
+			height = picture.GetHeight();
+		}
+		if ((width != infos[f].Width) || (height != infos[f].Height))
+			numWrong++;
+	}
+	double loadTime = tSystem::tGetTimeDouble() - start;
+	check(!numWrong, "%d probes differ from the loaded sizes.", numWrong);
+
+	tPrintf
+	(
+		"Probe %8.3f ms  %8.0f files/s\nLoad  %8.3f ms  %8.0f files/s  %.0fx slower\n",
+		probeTime*1000.0, double(NumBenchFiles)/probeTime, loadTime*1000.0, double(NumBenchFiles)/loadTime,
+		loadTime/probeTime
+	);
+
+	for (int f = 0; f < NumBenchFiles; f++)
+		tSystem::tDeleteFile(files[f]);
+	return check.Report();
+}
@@ -0,0 +1,313 @@
+// JPGTest.cpp
+//
+// Saves jpgs and transforms them losslessly with every orientation. Checks the decoded result matches decoding the
+// original and transforming the whole picture, that a transform followed by its inverse gives back exactly the
+// original pixels, and that two transforms in a row are the same as their combination. Checks the sizes and pixels
+// of trimmed and padded images whose sizes aren't whole MCUs, and that an exif orientation is written, read back and
+// folded in. The benchmark rotates a big jpg losslessly and by decoding and encoding it again.
+//
+// Copyright (c) 2020 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <Math/tFundamentals.h>
+#include <System/tFile.h>
+#include <System/tTime.h>
+#include <System/tPrint.h>
+#include <Image/tFileJPG.h>
+#include <Image/tPicture.h>
+#include "Fixtures.h"
+#include "Tests.h"
+using namespace tImage;
+
+
+namespace
+{
+	const int NumOrientations = 8;
+	const tFileJPG::tOrientation Orientations[NumOrientations] =
+	{
+		tFileJPG::tOrientation::Normal,		tFileJPG::tOrientation::FlipH,		tFileJPG::tOrientation::Rotate180,
+		tFileJPG::tOrientation::FlipV,		tFileJPG::tOrientation::Transpose,	tFileJPG::tOrientation::Rotate90CW,
+		tFileJPG::tOrientation::Transverse,	tFileJPG::tOrientation::Rotate90ACW
+	};
+
+	// The decoder's inverse DCT rounds its row and column passes, so a transposed block can decode a step or two off.
+	const int MaxDCTDifference = 3;
+
+	// The same operations tPicture::Load uses to apply an exif orientation.
+	void Transform(tPicture& picture, tFileJPG::tOrientation orientation)
+	{
+		switch (orientation)
+		{
+			case tFileJPG::tOrientation::FlipH:			picture.Flip(true);							break;
+			case tFileJPG::tOrientation::Rotate180:		picture.Flip(true);	picture.Flip(false);	break;
+			case tFileJPG::tOrientation::FlipV:			picture.Flip(false);						break;
+			case tFileJPG::tOrientation::Transpose:		picture.Rotate90(false); picture.Flip(true);	break;
+			case tFileJPG::tOrientation::Rotate90CW:	picture.Rotate90(false);					break;
+			case tFileJPG::tOrientation::Transverse:	picture.Rotate90(false); picture.Flip(false);	break;
+			case tFileJPG::tOrientation::Rotate90ACW:	picture.Rotate90(true);						break;
+			default:																				break;
+		}
+	}
+
+	// Returns the largest difference of any colour channel, or 256 if the sizes differ.
+	int GetMaxDifference(const tPicture& a, const tPicture& b)
+	{
+		if (!a.IsValid() || !b.IsValid() || (a.GetWidth() != b.GetWidth()) || (a.GetHeight() != b.GetHeight()))
+			return 256;
+
+		int maxDiff = 0;
+		const tPixel* pa = a.GetPixels();
+		const tPixel* pb = b.GetPixels();
+		for (int p = 0; p < a.GetNumPixels(); p++)
+		{
+			maxDiff = tMath::tMax(maxDiff, tMath::tAbs(int(pa[p].R) - int(pb[p].R)));
+			maxDiff = tMath::tMax(maxDiff, tMath::tAbs(int(pa[p].G) - int(pb[p].G)));
+			maxDiff = tMath::tMax(maxDiff, tMath::tAbs(int(pa[p].B) - int(pb[p].B)));
+		}
+		return maxDiff;
+	}
+
+	bool Transformed(const tString& srcFile, const tString& dstFile, tFileJPG::tOrientation o, tFileJPG::tEdge edge)
+	{
+		tFileJPG jpg(srcFile);
+		return jpg.IsValid() && jpg.SaveTransformed(dstFile, o, edge);
+	}
+
+	// Smooth with some detail so the blocks aren't all flat but the decode stays close to the source.
+	void MakeJPGPixels(tPixel* pixels, int width, int height, uint32& seed)
+	{
+		Test::MakePatternPixels(pixels, width, height, 1, seed);
+		for (int p = 0; p < width*height; p++)
+			pixels[p].A = 255;
+	}
+}
+
+
+bool Test::JPG()
+{
+	Checks check("JPG");
+	tString dir = GetDataDir("JPG");
+	tString srcFile = dir + "Source.jpg";
+	tString dstFile = dir + "Transformed.jpg";
+	tString backFile = dir + "Back.jpg";
+
+	// A whole number of MCUs, so nothing is trimmed or padded.
+	uint32 seed = 1;
+	tPicture source(320, 240);
+	MakeJPGPixels(source.GetPixelPointer(), 320, 240, seed);
+	check(source.Save(srcFile), "Could not save the source jpg.");
+	tPicture decoded;
+	check(decoded.Load(srcFile), "Could not load the source jpg.");
+	tFileJPG srcJPG(srcFile);
+	check(srcJPG.IsValid() && (srcJPG.GetWidth() == 320) && (srcJPG.GetHeight() == 240), "The jpg header is wrong.");
+
+	int numWrong = 0, numNotBack = 0, numFailed = 0;
+	for (int o = 0; o < NumOrientations; o++)
+	{
+		tFileJPG::tOrientation orientation = Orientations[o];
+		tPicture whole(decoded);
+		Transform(whole, orientation);
+
+		tPicture result;
+		bool ok = Transformed(srcFile, dstFile, orientation, tFileJPG::tEdge::Trim) && result.Load(dstFile);
+		if (!ok)
+		{
+			numFailed++;
+			continue;
+		}
+		if (GetMaxDifference(result, whole) > MaxDCTDifference)
+			numWrong++;
+
+		// The coefficients are only moved, so undoing the transform gives back the same coefficients and pixels.
+		tPicture back;
+		tFileJPG::tOrientation inverse = tFileJPG::Invert(orientation);
+		ok = Transformed(dstFile, backFile, inverse, tFileJPG::tEdge::Trim) && back.Load(backFile);
+		if (!ok || (GetMaxDifference(back, decoded) != 0))
+			numNotBack++;
+	}
+	check(!numFailed, "%d transforms failed.", numFailed);
+	check(!numWrong, "%d transforms differ from transforming the decoded picture.", numWrong);
+	check(!numNotBack, "%d transforms did not come back exactly when inverted.", numNotBack);
+
+	// Two transforms in a row give the same file contents as their combination in one.
+	int numNotCombined = 0;
+	for (int a = 0; a < NumOrientations; a++)
+	{
+		for (int b = 0; b < NumOrientations; b++)
+		{
+			tFileJPG::tOrientation combined = tFileJPG::Combine(Orientations[a], Orientations[b]);
+			tPicture twice, once;
+			bool ok =
+				Transformed(srcFile, dstFile, Orientations[a], tFileJPG::tEdge::Trim) &&
+				Transformed(dstFile, backFile, Orientations[b], tFileJPG::tEdge::Trim) && twice.Load(backFile) &&
+				Transformed(srcFile, dstFile, combined, tFileJPG::tEdge::Trim) && once.Load(dstFile);
+			if (!ok || (GetMaxDifference(twice, once) != 0))
+				numNotCombined++;
+		}
+	}
+	check(!numNotCombined, "%d pairs of transforms differ from their combination.", numNotCombined);
+
+	// Not a whole number of MCUs. Trimming drops the partial MCUs on the edges that would move, which are on the
+	// right and bottom of the stored image. Padding keeps every pixel.
+	const int oddW = 333;
+	const int oddH = 250;
+	tPicture odd(oddW, oddH);
+	MakeJPGPixels(odd.GetPixelPointer(), oddW, oddH, seed);
+	odd.Save(srcFile);
+	tPicture oddDecoded;
+	oddDecoded.Load(srcFile);
+	tFileJPG oddJPG(srcFile);
+	int mcuW = oddJPG.GetMCUWidth();
+	int mcuH = oddJPG.GetMCUHeight();
+	check(oddJPG.IsValid() && (mcuW >= 8) && (mcuH >= 8), "The odd jpg has a bad MCU size.");
+	int numBadTrims = 0, numBadPads = 0;
+	for (int o = 0; oddJPG.IsValid() && (o < NumOrientations); o++)
+	{
+		tFileJPG::tOrientation orientation = Orientations[o];
+		bool transposing = tFileJPG::IsTransposing(orientation);
+		int trimW = 0, trimH = 0, padW = 0, padH = 0;
+		oddJPG.GetTransformedSize(trimW, trimH, orientation, tFileJPG::tEdge::Trim);
+		oddJPG.GetTransformedSize(padW, padH, orientation, tFileJPG::tEdge::Pad);
+
+		// The part of the source the trimmed image keeps, measured before the transform, anchored top left.
+		int keepW = transposing ? trimH : trimW;
+		int keepH = transposing ? trimW : trimH;
+		tPicture whole(oddDecoded);
+		whole.Crop(keepW, keepH, 0, oddH - keepH);
+		Transform(whole, orientation);
+
+		tPicture trimmed;
+		bool ok = Transformed(srcFile, dstFile, orientation, tFileJPG::tEdge::Trim) && trimmed.Load(dstFile);
+		ok = ok && (trimmed.GetWidth() == trimW) && (trimmed.GetHeight() == trimH);
+		ok = ok && (keepW <= oddW) && (keepH <= oddH) && (keepW > oddW - mcuW) && (keepH > oddH - mcuH);
+		if (!ok || (GetMaxDifference(trimmed, whole) > MaxDCTDifference))
+			numBadTrims++;
+
+		// A padded size is never smaller than the image and is at most a partial MCU bigger.
+		int srcW = transposing ? padH : padW;
+		int srcH = transposing ? padW : padH;
+		tPicture padded;
+		ok = Transformed(srcFile, dstFile, orientation, tFileJPG::tEdge::Pad) && padded.Load(dstFile);
+		ok = ok && (padded.GetWidth() == padW) && (padded.GetHeight() == padH);
+		ok = ok && (srcW >= oddW) && (srcH >= oddH) && (srcW < oddW + mcuW) && (srcH < oddH + mcuH);
+		if (!ok)
+			numBadPads++;
+	}
+	check(!numBadTrims, "%d trimmed transforms have the wrong size or pixels.", numBadTrims);
+	check(!numBadPads, "%d padded transforms have the wrong size.", numBadPads);
+
+	// An exif orientation is written and read back, and SaveTransformed folds it in and resets it.
+	source.Save(srcFile);
+	int numBadExif = 0;
+	for (int o = 0; o < NumOrientations; o++)
+	{
+		tFileJPG::tOrientation orientation = Orientations[o];
+		tFileJPG jpg(srcFile);
+		if (!jpg.SaveReoriented(dstFile, orientation))
+		{
+			numBadExif++;
+			continue;
+		}
+
+		int numBytes = 0;
+		uint8* data = tSystem::tLoadFile(dstFile, nullptr, &numBytes);
+		tFileJPG::tOrientation read = tFileJPG::ReadOrientation(data, numBytes);
+		delete[] data;
+		tFileJPG reoriented(dstFile);
+		bool transposing = tFileJPG::IsTransposing(orientation);
+		bool ok = (read == orientation) && (reoriented.GetOrientation() == orientation);
+		ok = ok && (reoriented.GetWidth() == (transposing ? 240 : 320));
+
+		tPicture whole(decoded);
+		Transform(whole, orientation);
+		tPicture upright;
+		ok = ok && Transformed(dstFile, backFile, tFileJPG::tOrientation::Normal, tFileJPG::tEdge::Trim);
+		ok = ok && (tFileJPG(backFile).GetOrientation() == tFileJPG::tOrientation::Normal) && upright.Load(backFile);
+		if (!ok || (GetMaxDifference(upright, whole) > MaxDCTDifference))
+			numBadExif++;
+	}
+	check(!numBadExif, "%d exif orientations were not written, read or folded in.", numBadExif);
+
+	// Combine and Invert agree with each other for every pair.
+	int numBadAlgebra = 0;
+	for (int a = 0; a < NumOrientations; a++)
+	{
+		tFileJPG::tOrientation o = Orientations[a];
+		if (tFileJPG::Combine(o, tFileJPG::Invert(o)) != tFileJPG::tOrientation::Normal)
+			numBadAlgebra++;
+		if (tFileJPG::Combine(o, tFileJPG::tOrientation::Invalid) != tFileJPG::tOrientation::Invalid)
+			numBadAlgebra++;
+	}
+	check(!numBadAlgebra, "Combine and Invert disagree %d times.", numBadAlgebra);
+
+	tFileJPG missing(dir + "Missing.jpg");
+	bool savedMissing = missing.SaveTransformed(dstFile, tFileJPG::tOrientation::FlipH);
+	check(!missing.IsValid() && !savedMissing, "A missing jpg was valid or saved.");
+
+	tSystem::tDeleteFile(srcFile);
+	tSystem::tDeleteFile(dstFile);
+	tSystem::tDeleteFile(backFile);
+	return check.Report();
+}
+
+
+bool Test::JPGBench()
+{
+	Checks check("JPGBench");
+	tString dir = GetDataDir("JPG");
+	tString srcFile = dir + "Bench.jpg";
+	tString losslessFile = dir + "Lossless.jpg";
+	tString reencodedFile = dir + "Reencoded.jpg";
+
+	const int benchW = 4000;
+	const int benchH = 3008;
+	const int numRepeats = 3;
+	uint32 seed = 1;
+	{
+		tPicture source(benchW, benchH);
+		MakeJPGPixels(source.GetPixelPointer(), benchW, benchH, seed);
+		check(source.Save(srcFile), "Could not save the source jpg.");
+	}
+
+	// Best of a few. Decoding and encoding again also loses a little more each time.
+	double losslessTime = 0.0, reencodeTime = 0.0;
+	bool ok = true;
+	for (int r = 0; r < numRepeats; r++)
+	{
+		double start = tSystem::tGetTimeDouble();
+		tFileJPG jpg(srcFile);
+		ok = jpg.SaveTransformed(losslessFile, tFileJPG::tOrientation::Rotate90CW) && ok;
+		double lossless = tSystem::tGetTimeDouble() - start;
+
+		start = tSystem::tGetTimeDouble();
+		tPicture picture;
+		ok = picture.Load(srcFile) && ok;
+		picture.Rotate90(false);
+		ok = picture.Save(reencodedFile) && ok;
+		double reencode = tSystem::tGetTimeDouble() - start;
+
+		losslessTime = r ? tMath::tMin(losslessTime, lossless) : lossless;
+		reencodeTime = r ? tMath::tMin(reencodeTime, reencode) : reencode;
+	}
+
+	tPicture lossless, reencoded;
+	ok = ok && lossless.Load(losslessFile) && reencoded.Load(reencodedFile);
+	double psnr = ok ? GetPSNR(lossless.GetPixels(), reencoded.GetPixels(), lossless.GetNumPixels()) : 0.0;
+	check(ok && (lossless.GetWidth() == benchH) && (psnr >= 30.0), "The two rotations differ by %.1f dB.", psnr);
+
+	tPrintf("%dx%d jpg, %.1f MB, rotated clockwise\n", benchW, benchH, double(tSystem::tGetFileSize(srcFile))/1.0e6);
+	tPrintf("Lossless           %8.1f ms\n", losslessTime*1000.0);
+	tPrintf("Decode and encode  %8.1f ms, %.1fx slower\n", reencodeTime*1000.0, reencodeTime/losslessTime);
+
+	tSystem::tDeleteFile(srcFile);
+	tSystem::tDeleteFile(losslessFile);
+	tSystem::tDeleteFile(reencodedFile);
+	return check.Report();
+}
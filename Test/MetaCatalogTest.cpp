@@ -0,0 +1,254 @@
+// MetaCatalogTest.cpp
+//
+// Fills a catalog, saves it on the worker thread, loads it back and checks every record comes back the same. Checks
+// that stale records aren't returned, that records for files that are gone drop out of the next save, and that a
+// corrupt or cut short catalog file is ignored while a temporary left by a crash during a save isn't used. The
+// benchmark reopens a catalog of fifty thousand files and looks them all up, and prints the time next to building it.
+//
+// Copyright (c) 2020 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <System/tFile.h>
+#include <System/tTime.h>
+#include <System/tPrint.h>
+#include "MetaCatalog.h"
+#include "Fixtures.h"
+#include "Tests.h"
+using namespace tImage;
+
+
+namespace
+{
+	const int NumRecords = 1000;
+	const int NumBenchRecords = 50000;
+
+	tString GetName(int index)
+	{
+		tString name;
+		tsPrintf(name, "Image_%05d.png", index);
+		return name;
+	}
+
+	// The file size and time are made from the index so a record can be checked without keeping the originals.
+	MetaRecord MakeRecord(int index)
+	{
+		tImageInfo info;
+		info.FileType = (index%2) ? tSystem::tFileType::PNG : tSystem::tFileType::DDS;
+		info.Width = 16 + index%1000;
+		info.Height = 8 + index%700;
+		info.PixelFormat = (index%2) ? tPixelFormat::R8G8B8A8 : tPixelFormat::BC1_DXT1;
+		info.BitDepth = (index%2) ? 32 : 4;
+		info.NumMipmaps = 1 + index%10;
+		info.NumFrames = 1;
+		info.Cubemap = !(index%7);
+		info.Opaque = !(index%2);
+
+		MetaRecord record;
+		record.SetInfo(info);
+		record.FileSize = 1000 + uint64(index)*37;
+		record.ModTime = 0x1D6000000000000ull + uint64(index);
+		record.DHash = 0x9E3779B97F4A7C15ull * uint64(index + 1);
+		record.PHash = ~record.DHash;
+		record.Flags |= MetaRecord::Flag_Hash;
+		if (index%3)
+			record.Flags |= MetaRecord::Flag_Thumbnail;
+		return record;
+	}
+
+	// Compares the stored fields. The name fields and the touched flag are the catalog's business.
+	bool SameRecord(const MetaRecord* found, const MetaRecord& expected)
+	{
+		if (!found)
+			return false;
+
+		tImageInfo a, b;
+		found->GetInfo(a);
+		expected.GetInfo(b);
+		uint8 flagMask = uint8(~MetaRecord::Flag_Touched);
+		return
+			(found->FileSize == expected.FileSize) && (found->ModTime == expected.ModTime) &&
+			(found->DHash == expected.DHash) && (found->PHash == expected.PHash) &&
+			((found->Flags & flagMask) == (expected.Flags & flagMask)) &&
+			(a.FileType == b.FileType) && (a.Width == b.Width) && (a.Height == b.Height) &&
+			(a.PixelFormat == b.PixelFormat) && (a.BitDepth == b.BitDepth) && (a.NumMipmaps == b.NumMipmaps) &&
+			(a.NumFrames == b.NumFrames) && (a.Cubemap == b.Cubemap) && (a.Opaque == b.Opaque);
+	}
+
+	// Looks up records first to last and returns how many weren't there or were different.
+	int CountWrong(MetaCatalog& catalog, int first, int last)
+	{
+		int numWrong = 0;
+		for (int r = first; r <= last; r++)
+		{
+			MetaRecord expected = MakeRecord(r);
+			if (!SameRecord(catalog.Find(GetName(r), expected.FileSize, expected.ModTime), expected))
+				numWrong++;
+		}
+		return numWrong;
+	}
+
+	bool SaveAndWait(MetaCatalog& catalog)
+	{
+		bool started = catalog.SaveAsync();
+		catalog.WaitForSave();
+		return started;
+	}
+
+	bool WriteBytes(const tString& file, const uint8* data, int numBytes)
+	{
+		tFileHandle handle = tSystem::tOpenFile(file.Chars(), "wb");
+		if (!handle)
+			return false;
+		bool ok = tSystem::tWriteFile(handle, data, numBytes) == numBytes;
+		tSystem::tCloseFile(handle);
+		return ok;
+	}
+}
+
+
+bool Test::Catalog()
+{
+	Checks check("Catalog");
+	tString dir = GetDataDir("MetaCatalog");
+	tString catalogFile = dir + "Test.cat";
+	tSystem::tDeleteFile(catalogFile);
+
+	MetaCatalog catalog;
+	check(!catalog.Load(catalogFile) && !catalog.GetNumRecords(), "A missing catalog loaded.");
+	for (int r = 0; r < NumRecords; r++)
+		catalog.Set(GetName(r), MakeRecord(r));
+	check(catalog.IsDirty() && (catalog.GetNumRecords() == NumRecords), "The records were not all added.");
+	check(!CountWrong(catalog, 0, NumRecords-1), "Records differ before saving.");
+
+	// A record is only returned while the size and time match.
+	MetaRecord record = MakeRecord(5);
+	check(!catalog.Find(GetName(5), record.FileSize + 1, record.ModTime), "A record with a stale size was returned.");
+	check(!catalog.Find(GetName(5), record.FileSize, record.ModTime + 1), "A record with a stale time was returned.");
+	check(!catalog.Find("Missing.png", record.FileSize, record.ModTime), "A missing file was found.");
+
+	check(SaveAndWait(catalog) && !catalog.IsDirty(), "The catalog did not save.");
+	catalog.Set(GetName(5), record);
+	check(!catalog.IsDirty(), "Setting an unchanged record made the catalog dirty.");
+	check(!catalog.SaveAsync(), "A clean catalog saved.");
+	check(!tSystem::tFileExists(catalogFile + ".tmp"), "The temporary file was left after a save.");
+
+	MetaCatalog loaded;
+	check(loaded.Load(catalogFile) && (loaded.GetNumRecords() == NumRecords), "The catalog did not load.");
+	check(!CountWrong(loaded, 0, NumRecords-1), "Records differ after loading.");
+
+	// Only the first half are looked up, and one is replaced. The rest are files that have gone away.
+	MetaCatalog pruned;
+	pruned.Load(catalogFile);
+	CountWrong(pruned, 0, NumRecords/2 - 1);
+	MetaRecord changed = MakeRecord(NumRecords + 1);
+	pruned.Set(GetName(0), changed);
+	check(SaveAndWait(pruned), "The changed catalog did not save.");
+	pruned.Load(catalogFile);
+	int numSaved = pruned.GetNumRecords();
+	check(numSaved == NumRecords/2, "%d records were saved instead of %d.", numSaved, NumRecords/2);
+	const MetaRecord* found = pruned.Find(GetName(0), changed.FileSize, changed.ModTime);
+	check(SameRecord(found, changed), "The replaced record differs.");
+	check(!CountWrong(pruned, 1, NumRecords/2 - 1), "The kept records differ.");
+
+	// A crash during a save leaves the old catalog and a temporary. The temporary is never read.
+	int numBytes = 0;
+	uint8* data = tSystem::tLoadFile(catalogFile, nullptr, &numBytes);
+	check(data && WriteBytes(catalogFile + ".tmp", data, numBytes/2), "Could not write the temporary.");
+	check(pruned.Load(catalogFile) && (pruned.GetNumRecords() == NumRecords/2), "A left over temporary was used.");
+	tSystem::tDeleteFile(catalogFile + ".tmp");
+
+	// A flipped byte anywhere, a cut short file, or a newer version are all rejected.
+	int numRejected = 0;
+	const int numCorruptions = 4;
+	for (int c = 0; c < numCorruptions; c++)
+	{
+		int size = numBytes;
+		int at = 0;
+		switch (c)
+		{
+			case 0:	at = numBytes - 1;			break;
+			case 1:	at = numBytes / 2;			break;
+			case 2:	at = 4;						break;
+			case 3:	size = numBytes - 64;		break;
+		}
+		uint8 saved = data[at];
+		if (c < 3)
+			data[at] ^= 0x10;
+		WriteBytes(catalogFile, data, size);
+		if (!pruned.Load(catalogFile) && !pruned.GetNumRecords())
+			numRejected++;
+		data[at] = saved;
+	}
+	int numLoaded = numCorruptions - numRejected;
+	check(!numLoaded, "%d of %d corrupt catalogs loaded.", numLoaded, numCorruptions);
+
+	WriteBytes(catalogFile, data, numBytes);
+	check(pruned.Load(catalogFile), "The restored catalog did not load.");
+	delete[] data;
+
+	tSystem::tDeleteFile(catalogFile);
+	return check.Report();
+}
+
+
+bool Test::CatalogBench()
+{
+	Checks check("CatalogBench");
+	tString dir = GetDataDir("MetaCatalog");
+	tString catalogFile = dir + "Bench.cat";
+	tSystem::tDeleteFile(catalogFile);
+
+	// The names and records are made up front so only the catalog is timed.
+	tString* names = new tString[NumBenchRecords];
+	MetaRecord* records = new MetaRecord[NumBenchRecords];
+	for (int r = 0; r < NumBenchRecords; r++)
+	{
+		names[r] = GetName(r);
+		records[r] = MakeRecord(r);
+	}
+
+	// A cold open has no catalog and sets a record for every file once it has been probed.
+	double start = tSystem::tGetTimeDouble();
+	MetaCatalog cold;
+	cold.Load(catalogFile);
+	for (int r = 0; r < NumBenchRecords; r++)
+		cold.Set(names[r], records[r]);
+	double buildTime = tSystem::tGetTimeDouble() - start;
+
+	start = tSystem::tGetTimeDouble();
+	check(cold.SaveAsync(), "The catalog did not start saving.");
+	double saveCallTime = tSystem::tGetTimeDouble() - start;
+	cold.WaitForSave();
+	double saveTime = tSystem::tGetTimeDouble() - start;
+
+	// A warm open loads the catalog and finds every file in it.
+	int numMissing = 0;
+	start = tSystem::tGetTimeDouble();
+	MetaCatalog warm;
+	bool loaded = warm.Load(catalogFile);
+	for (int r = 0; r < NumBenchRecords; r++)
+		if (!warm.Find(names[r], records[r].FileSize, records[r].ModTime))
+			numMissing++;
+	double warmTime = tSystem::tGetTimeDouble() - start;
+	check(loaded && !numMissing, "%d of %d records were not found in the warm catalog.", numMissing, NumBenchRecords);
+
+	tPrintf
+	(
+		"%d files, %.1f MB catalog\n", NumBenchRecords, double(tSystem::tGetFileSize(catalogFile))/(1024.0*1024.0)
+	);
+	tPrintf("Build    %7.2f ms\n", buildTime*1000.0);
+	tPrintf("Save     %7.2f ms on the worker, %.3f ms on the caller\n", saveTime*1000.0, saveCallTime*1000.0);
+	tPrintf("Reopen   %7.2f ms to load and look up every file\n", warmTime*1000.0);
+
+	delete[] records;
+	delete[] names;
+	tSystem::tDeleteFile(catalogFile);
+	return check.Report();
+}
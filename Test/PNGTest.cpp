@@ -0,0 +1,215 @@
+// PNGTest.cpp
+//
+// Round trips pictures of several sizes and kinds through the png writer and the existing loader at every level, with
+// 3 and 4 channels, from views as well as whole pictures, and through the row writer. Checks the files don't change
+// with the number of threads. The benchmark saves a large picture at every level on one thread and on all of them,
+// and with the row writer, and prints the times and file sizes.
+//
+// Copyright (c) 2020 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <Math/tFundamentals.h>
+#include <System/tFile.h>
+#include <System/tTime.h>
+#include <System/tPrint.h>
+#include <Image/tFilePNG.h>
+#include <Image/tPicture.h>
+#include "Fixtures.h"
+#include "Tests.h"
+using namespace tImage;
+
+
+namespace
+{
+	const int NumLevels = 4;
+	const tFilePNG::tLevel Levels[NumLevels] =
+	{
+		tFilePNG::tLevel::Fastest, tFilePNG::tLevel::Fast, tFilePNG::tLevel::Default, tFilePNG::tLevel::Smallest
+	};
+	const char* LevelNames[NumLevels] = { "Fastest", "Fast", "Default", "Smallest" };
+
+	// Returns true if the file loads back as the supplied pixels. With opaque the loaded alpha must be 255 instead.
+	bool LoadsBackAs(const tString& file, const tPixel* pixels, int width, int height, bool opaque)
+	{
+		tPicture picture;
+		if (!picture.Load(file) || (picture.GetWidth() != width) || (picture.GetHeight() != height))
+			return false;
+
+		return !Test::CountDifferences(picture.GetPixels(), pixels, width*height, opaque);
+	}
+
+	bool IsSameFile(const tString& a, const tString& b)
+	{
+		int numBytesA = 0, numBytesB = 0;
+		uint8* dataA = tSystem::tLoadFile(a, nullptr, &numBytesA);
+		uint8* dataB = tSystem::tLoadFile(b, nullptr, &numBytesB);
+		bool same = dataA && dataB && (numBytesA == numBytesB) && !tStd::tMemcmp(dataA, dataB, numBytesA);
+		delete[] dataA;
+		delete[] dataB;
+		return same;
+	}
+
+	// Writes the view with the row writer. Rows go in file order, which is the top row first.
+	bool SaveRows(const tString& file, const tPictureView& view, tFilePNG::tFormat format, tFilePNG::tLevel level)
+	{
+		tPNGWriter writer;
+		if (!writer.Begin(file, view.GetWidth(), view.GetHeight(), format, level))
+			return false;
+
+		bool ok = true;
+		for (int y = view.GetHeight()-1; (y >= 0) && ok; y--)
+			ok = writer.WriteRow(view.GetRow(y));
+
+		return writer.End() && ok;
+	}
+}
+
+
+bool Test::PNG()
+{
+	Checks check("PNG");
+	tString dir = GetDataDir("PNG");
+	tString file = dir + "RoundTrip.png";
+	tString otherFile = dir + "Other.png";
+
+	// The odd sizes make sure single pixel rows and columns work. The last two sizes are several blocks, so on one
+	// thread they take more than one batch, and the last has rows longer than the deflate window.
+	const int sizes[][2] = { { 1, 1 }, { 1, 37 }, { 63, 1 }, { 67, 45 }, { 300, 900 }, { 9000, 40 } };
+	uint32 seed = 1;
+	for (int s = 0; s < tNumElements(sizes); s++)
+	{
+		int width = sizes[s][0];
+		int height = sizes[s][1];
+		tPixel* pixels = tPicture::AllocPixels(width*height);
+		tPictureView view(pixels, width, height);
+		for (int pattern = 0; pattern < NumPatterns; pattern++)
+		{
+			MakePatternPixels(pixels, width, height, pattern, seed);
+			for (int channels = 3; channels <= 4; channels++)
+			{
+				tFilePNG::tFormat format = (channels == 3) ? tFilePNG::tFormat::Bit24 : tFilePNG::tFormat::Bit32;
+				int numFailed = 0;
+				for (int l = 0; l < NumLevels; l++)
+				{
+					if (tFilePNG(view).Save(file, format, Levels[l], -1) != format)
+						numFailed++;
+					else if (!LoadsBackAs(file, pixels, width, height, channels == 3))
+						numFailed++;
+				}
+				check
+				(
+					!numFailed, "%dx%d pattern %d with %d channels failed at %d levels.",
+					width, height, pattern, channels, numFailed
+				);
+			}
+		}
+
+		// The blocks are the same whatever the number of threads, so the files must be too.
+		tFilePNG(view).Save(file, tFilePNG::tFormat::Bit32, tFilePNG::tLevel::Default, 1);
+		tFilePNG(view).Save(otherFile, tFilePNG::tFormat::Bit32, tFilePNG::tLevel::Default, -1);
+		check(IsSameFile(file, otherFile), "%dx%d changes with the number of threads.", width, height);
+
+		bool rowsOk = SaveRows(file, view, tFilePNG::tFormat::Bit32, tFilePNG::tLevel::Default);
+		rowsOk = rowsOk && LoadsBackAs(file, pixels, width, height, false);
+		rowsOk = rowsOk && SaveRows(file, view, tFilePNG::tFormat::Bit24, tFilePNG::tLevel::Fastest);
+		rowsOk = rowsOk && LoadsBackAs(file, pixels, width, height, true);
+		check(rowsOk, "%dx%d did not round trip through the row writer.", width, height);
+		tPicture::FreePixels(pixels);
+	}
+
+	// Auto picks 3 channels only when every pixel is opaque.
+	tPicture picture(64, 48);
+	MakePatternPixels(picture.GetPixelPointer(), 64, 48, 0, seed);
+	picture.GetPixelPointer()[100].A = 128;
+	check(tFilePNG(picture.GetView()).Save(file) == tFilePNG::tFormat::Bit32, "Auto dropped alpha that was needed.");
+	for (int p = 0; p < picture.GetNumPixels(); p++)
+		picture.GetPixelPointer()[p].A = 255;
+	check(tFilePNG(picture.GetView()).Save(file) == tFilePNG::tFormat::Bit24, "Auto kept alpha that wasn't needed.");
+
+	// Saving a view of part of a picture gives the same pixels as saving a crop of it.
+	tPictureView sub = picture.GetView(5, 7, 41, 23);
+	tPicture crop(sub);
+	bool subOk = tFilePNG(sub).Save(file, tFilePNG::tFormat::Bit32) == tFilePNG::tFormat::Bit32;
+	check(subOk && LoadsBackAs(file, crop.GetPixels(), 41, 23, false), "A view did not save as its own pixels.");
+
+	check(tFilePNG(tPictureView()).Save(file) == tFilePNG::tFormat::Invalid, "An invalid view was saved.");
+	check(tFilePNG(sub).Save(dir + "Wrong.tga") == tFilePNG::tFormat::Invalid, "A png was saved with a tga name.");
+
+	// The row writer refuses extra rows and reports missing ones.
+	tPNGWriter writer;
+	bool begun = writer.Begin(file, 41, 2, tFilePNG::tFormat::Bit32);
+	bool extra = begun && writer.WriteRow(crop.GetPixels()) && writer.WriteRow(crop.GetPixels());
+	extra = extra && !writer.WriteRow(crop.GetPixels());
+	check(extra && writer.End(), "The row writer accepted a row too many.");
+	begun = writer.Begin(file, 41, 2, tFilePNG::tFormat::Bit32);
+	check(begun && writer.WriteRow(crop.GetPixels()) && !writer.End(), "The row writer accepted a missing row.");
+	check(!writer.Begin(file, 41, 2, tFilePNG::tFormat::Auto), "The row writer accepted the Auto format.");
+
+	tSystem::tDeleteFile(file);
+	tSystem::tDeleteFile(otherFile);
+	return check.Report();
+}
+
+
+bool Test::PNGBench()
+{
+	Checks check("PNGBench");
+	tString dir = GetDataDir("PNG");
+	tString file = dir + "Bench.png";
+
+	// The mixed pattern with alpha, so every save keeps 4 channels. Each save is timed a few times and the best kept.
+	const int benchW = 4096;
+	const int benchH = 4096;
+	const int numRepeats = 3;
+	uint32 seed = 1;
+	tPicture source(benchW, benchH);
+	MakePatternPixels(source.GetPixelPointer(), benchW, benchH, NumPatterns-1, seed);
+	double megabytes = double(benchW*benchH*4) / (1024.0*1024.0);
+	tPrintf("%dx%d with alpha, %.0f MB of pixels\n", benchW, benchH, megabytes);
+
+	for (int l = 0; l < NumLevels; l++)
+	{
+		for (int pass = 0; pass < 3; pass++)
+		{
+			const char* method = (pass == 0) ? "one thread" : ((pass == 1) ? "all threads" : "row writer");
+			double best = 0.0;
+			bool ok = true;
+			for (int r = 0; r < numRepeats; r++)
+			{
+				double start = tSystem::tGetTimeDouble();
+				bool saved = false;
+				if (pass < 2)
+				{
+					tFilePNG png(source.GetView());
+					int numThreads = pass ? -1 : 1;
+					saved = png.Save(file, tFilePNG::tFormat::Bit32, Levels[l], numThreads) == tFilePNG::tFormat::Bit32;
+				}
+				else
+				{
+					saved = SaveRows(file, source.GetView(), tFilePNG::tFormat::Bit32, Levels[l]);
+				}
+				ok = ok && saved;
+				double time = tSystem::tGetTimeDouble() - start;
+				best = (r == 0) ? time : tMath::tMin(best, time);
+			}
+
+			ok = ok && LoadsBackAs(file, source.GetPixels(), benchW, benchH, false);
+			tPrintf
+			(
+				"%-9s %-12s Save %7.1f ms  %6.1f MB/s  Size %6.2f MB\n", LevelNames[l], method, best*1000.0,
+				megabytes/best, double(tSystem::tGetFileSize(file))/(1024.0*1024.0)
+			);
+			check(ok, "The %s save on %s did not load back unchanged.", LevelNames[l], method);
+		}
+	}
+
+	tSystem::tDeleteFile(file);
+	return check.Report();
+}
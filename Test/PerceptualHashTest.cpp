@@ -0,0 +1,363 @@
+// PerceptualHashTest.cpp
+//
+// Checks that both perceptual hashes stay close when a synthetic scene is resized, brightened, gamma adjusted or made
+// noisy, and that different scenes stay far apart. The hash index is checked against a brute force search over
+// random hashes with planted near duplicates, both for single queries and for clustering. Also checks the Hamming
+// distance, hashing views, the chunk round trip, and finding duplicates in a set of files.
+//
+// Copyright (c) 2020 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <math.h>
+#include <Foundation/tStandard.h>
+#include <Foundation/tSort.h>
+#include <Math/tFundamentals.h>
+#include <System/tFile.h>
+#include <System/tChunk.h>
+#include <System/tPrint.h>
+#include <Image/tPerceptualHash.h>
+#include "Fixtures.h"
+#include "Tests.h"
+using namespace tImage;
+
+
+namespace
+{
+	const int NumScenes = 16;
+	const int SceneWidth = 640;
+	const int SceneHeight = 480;
+
+	// The pHash limit is the default distance tFindDuplicates uses. The dHash compares neighbouring cells directly, so
+	// cells in flat areas flip more easily and it gets a little more room. Different scenes must be outside both.
+	const int MaxPHashEditDistance = 10;
+	const int MaxDHashEditDistance = 14;
+
+	const int NumIndexHashes = 6000;
+	const int NumPlanted = 1500;
+	const int NumQueries = 300;
+	const int ClusterDistance = 10;
+
+	// A gradient background with filled circles and rectangles. Every seed gives a different layout.
+	void MakeScenePicture(tPicture& picture, uint32 seed)
+	{
+		tPixel* pixels = tPicture::AllocPixels(SceneWidth*SceneHeight);
+		int gx = Test::Random(seed, 256) - 128;
+		int gy = Test::Random(seed, 256) - 128;
+		for (int y = 0; y < SceneHeight; y++)
+		{
+			for (int x = 0; x < SceneWidth; x++)
+			{
+				int v = 128 + (gx*x)/SceneWidth + (gy*y)/SceneHeight;
+				pixels[y*SceneWidth + x] = tPixel(uint8(v), uint8(255-v), uint8(v/2 + 64), uint8(255));
+			}
+		}
+
+		for (int s = 0; s < 12; s++)
+		{
+			uint8 r = uint8(Test::Random(seed, 256));
+			uint8 g = uint8(Test::Random(seed, 256));
+			uint8 b = uint8(Test::Random(seed, 256));
+			tPixel colour(r, g, b);
+			int cx = Test::Random(seed, SceneWidth);
+			int cy = Test::Random(seed, SceneHeight);
+			int radius = 20 + Test::Random(seed, 120);
+			bool circle = Test::Random(seed, 2);
+			for (int y = tMath::tMax(cy-radius, 0); y < tMath::tMin(cy+radius, SceneHeight); y++)
+				for (int x = tMath::tMax(cx-radius, 0); x < tMath::tMin(cx+radius, SceneWidth); x++)
+					if (!circle || ((x-cx)*(x-cx) + (y-cy)*(y-cy) < radius*radius))
+						pixels[y*SceneWidth + x] = colour;
+		}
+
+		picture.Set(SceneWidth, SceneHeight, pixels, false);
+	}
+
+	// Edit 0 resizes, 1 brightens, 2 applies a gamma of 0.8 and 3 adds noise of up to 8 levels.
+	const int NumEdits = 4;
+	const char* EditNames[NumEdits] = { "resized", "brightened", "gamma adjusted", "noisy" };
+	void EditPicture(tPicture& picture, int edit, uint32& seed)
+	{
+		if (edit == 0)
+		{
+			picture.Resample(SceneWidth*3/5, SceneHeight*3/5, tPicture::tFilter::Bilinear);
+			return;
+		}
+
+		tPixel* pixels = picture.GetPixelPointer();
+		for (int p = 0; p < picture.GetNumPixels(); p++)
+		{
+			for (int c = 0; c < 3; c++)
+			{
+				int v = pixels[p].E[c];
+				if (edit == 1)
+					v += 25;
+				else if (edit == 2)
+					v = int(255.0*pow(double(v)/255.0, 0.8) + 0.5);
+				else
+					v += Test::Random(seed, 17) - 8;
+				pixels[p].E[c] = uint8(tMath::tClamp(v, 0, 255));
+			}
+		}
+	}
+
+	uint64 RandomHash(uint32& seed)
+	{
+		uint64 hash = Test::Random(seed);
+		hash = (hash << 24) | Test::Random(seed);
+		return (hash << 24) | Test::Random(seed);
+	}
+
+	uint64 FlipBits(uint64 hash, int numFlips, uint32& seed)
+	{
+		for (int f = 0; f < numFlips; f++)
+			hash ^= 1ULL << Test::Random(seed, 64);
+		return hash;
+	}
+
+	int CountBits(uint64 v)
+	{
+		int count = 0;
+		for (; v; v >>= 1)
+			count += int(v & 1);
+		return count;
+	}
+
+	// Compares the found IDs with a brute force search. The order doesn't matter.
+	bool MatchesBruteForce(tArray<int>& found, const uint64* hashes, int numHashes, uint64 query, int maxDistance)
+	{
+		tArray<int> expected;
+		for (int h = 0; h < numHashes; h++)
+			if (CountBits(hashes[h] ^ query) <= maxDistance)
+				expected.Append(h);
+
+		if (found.GetNumElements() != expected.GetNumElements())
+			return false;
+
+		tSort::tInsertion(found.GetElements(), found.GetNumElements());
+		for (int f = 0; f < found.GetNumElements(); f++)
+			if (found[f] != expected[f])
+				return false;
+
+		return true;
+	}
+
+	int FindRoot(int* parents, int i)
+	{
+		while (parents[i] != i)
+			i = parents[i];
+		return i;
+	}
+
+	// Returns the number of hashes whose cluster differs from a brute force union of every pair within maxDistance.
+	// Representatives must be the lowest ID of their cluster and distances must be to the representative.
+	int CountClusterErrors
+	(
+		const tList<tDuplicateCluster>& clusters, const uint64* hashes, int numHashes, int maxDistance
+	)
+	{
+		int* parents = new int[numHashes];
+		for (int h = 0; h < numHashes; h++)
+			parents[h] = h;
+		for (int a = 0; a < numHashes; a++)
+		{
+			for (int b = a+1; b < numHashes; b++)
+			{
+				if (CountBits(hashes[a] ^ hashes[b]) > maxDistance)
+					continue;
+				int rootA = FindRoot(parents, a);
+				int rootB = FindRoot(parents, b);
+				parents[tMath::tMax(rootA, rootB)] = tMath::tMin(rootA, rootB);
+			}
+		}
+
+		// Hashes not in a cluster are their own representative.
+		int* found = new int[numHashes];
+		for (int h = 0; h < numHashes; h++)
+			found[h] = h;
+
+		int numErrors = 0;
+		for (const tDuplicateCluster* cluster = clusters.First(); cluster; cluster = cluster->Next())
+		{
+			int rep = cluster->Members.First()->ID;
+			float minSimilarity = 1.0f;
+			for (const tDuplicate* member = cluster->Members.First(); member; member = member->Next())
+			{
+				found[member->ID] = rep;
+				if (member->Distance != CountBits(hashes[member->ID] ^ hashes[rep]))
+					numErrors++;
+				minSimilarity = tMath::tMin(minSimilarity, member->Similarity);
+			}
+			if ((cluster->Members.GetNumItems() < 2) || (cluster->MinSimilarity != minSimilarity))
+				numErrors++;
+		}
+
+		for (int h = 0; h < numHashes; h++)
+			if (found[h] != FindRoot(parents, h))
+				numErrors++;
+
+		delete[] found;
+		delete[] parents;
+		return numErrors;
+	}
+}
+
+
+bool Test::PerceptualHash()
+{
+	Checks check("PerceptualHash");
+	uint32 seed = 1;
+	int numDistanceErrors = 0;
+	for (int t = 0; t < 10000; t++)
+	{
+		uint64 a = RandomHash(seed);
+		uint64 b = FlipBits(a, Random(seed, 65), seed);
+		if (tHammingDistance(a, b) != CountBits(a ^ b))
+			numDistanceErrors++;
+	}
+	check(!numDistanceErrors, "%d Hamming distances were wrong.", numDistanceErrors);
+	check(tHammingDistance(0, ~0ULL) == 64, "Complementary hashes are not 64 apart.");
+
+	// Every edit of every scene against its original, and every scene against every other one.
+	tPerceptualHash sceneHashes[NumScenes];
+	for (int s = 0; s < NumScenes; s++)
+	{
+		tPicture scene;
+		MakeScenePicture(scene, 1000 + s);
+		check(sceneHashes[s].Set(scene), "Scene %d could not be hashed.", s);
+		for (int edit = 0; edit < NumEdits; edit++)
+		{
+			tPicture edited;
+			edited.Set(scene);
+			EditPicture(edited, edit, seed);
+			tPerceptualHash hash(edited);
+			int dDist = tHammingDistance(hash.DHash, sceneHashes[s].DHash);
+			int pDist = tHammingDistance(hash.PHash, sceneHashes[s].PHash);
+			check
+			(
+				(dDist <= MaxDHashEditDistance) && (pDist <= MaxPHashEditDistance),
+				"Scene %d %s is %d from the original with dHash and %d with pHash.", s, EditNames[edit], dDist, pDist
+			);
+		}
+	}
+
+	int minDHash = 64, minPHash = 64;
+	for (int a = 0; a < NumScenes; a++)
+	{
+		for (int b = a+1; b < NumScenes; b++)
+		{
+			minDHash = tMath::tMin(minDHash, tHammingDistance(sceneHashes[a].DHash, sceneHashes[b].DHash));
+			minPHash = tMath::tMin(minPHash, tHammingDistance(sceneHashes[a].PHash, sceneHashes[b].PHash));
+		}
+	}
+	tPrintf("Closest different scenes: %d with dHash, %d with pHash\n", minDHash, minPHash);
+	check
+	(
+		(minDHash > MaxDHashEditDistance) && (minPHash > MaxPHashEditDistance),
+		"Different scenes hashed too close together."
+	);
+
+	// A view must hash the same as a copy of its pixels.
+	tPicture scene, crop;
+	MakeScenePicture(scene, 1000);
+	tPictureView view = scene.GetView(37, 22, 301, 257);
+	crop.Set(view);
+	tPerceptualHash viewHash, cropHash(crop);
+	viewHash.Set(view);
+	check
+	(
+		viewHash.IsValid() && (viewHash.DHash == cropHash.DHash) && (viewHash.PHash == cropHash.PHash),
+		"Hashing a view differs from hashing a copy."
+	);
+	check(!viewHash.Set(tPicture()) && !viewHash.IsValid(), "An invalid picture gave a valid hash.");
+
+	// The index against brute force. Some hashes are near copies of earlier ones so the searches find something.
+	uint64* hashes = new uint64[NumIndexHashes];
+	tHashIndex index;
+	for (int h = 0; h < NumIndexHashes; h++)
+	{
+		bool planted = (h > 0) && (h < NumPlanted);
+		hashes[h] = planted ? FlipBits(hashes[Random(seed, h)], Random(seed, 16), seed) : RandomHash(seed);
+		index.Add(hashes[h], h);
+	}
+
+	const int radii[] = { 0, 3, 7, 10, 13, 20 };
+	int numQueryErrors = 0;
+	for (int q = 0; q < NumQueries; q++)
+	{
+		uint64 query = FlipBits(hashes[Random(seed, NumPlanted)], Random(seed, 6), seed);
+		for (int radius : radii)
+		{
+			tArray<int> found;
+			int numFound = index.Find(found, query, radius);
+			if (numFound != found.GetNumElements())
+				numQueryErrors++;
+			else if (!MatchesBruteForce(found, hashes, NumIndexHashes, query, radius))
+				numQueryErrors++;
+		}
+	}
+	check(!numQueryErrors, "%d index searches differ from brute force.", numQueryErrors);
+
+	tList<tDuplicateCluster> single, all;
+	int numSingle = index.FindClusters(single, ClusterDistance, 1);
+	int numAll = index.FindClusters(all, ClusterDistance, -1);
+	tPrintf("%d hashes form %d clusters within %d bits\n", NumIndexHashes, numAll, ClusterDistance);
+	check(numSingle == single.GetNumItems(), "Returned %d clusters but appended %d.", numSingle, single.GetNumItems());
+	check(numAll > 0, "No clusters were found.");
+	int numClusterErrors = CountClusterErrors(single, hashes, NumIndexHashes, ClusterDistance);
+	check(!numClusterErrors, "%d hashes are in the wrong cluster on one thread.", numClusterErrors);
+	numClusterErrors = CountClusterErrors(all, hashes, NumIndexHashes, ClusterDistance);
+	check(!numClusterErrors, "%d hashes are in the wrong cluster on all threads.", numClusterErrors);
+	delete[] hashes;
+
+	// Round trip through a chunk file.
+	tString dir = GetDataDir("PerceptualHash");
+	tString hashFile = dir + "Hash.bin";
+	{
+		tChunkWriter writer(hashFile);
+		sceneHashes[0].Save(writer);
+	}
+	tPerceptualHash loaded;
+	{
+		tChunkReader reader(hashFile);
+		loaded.Load(reader.First());
+	}
+	check
+	(
+		loaded.IsValid() && (loaded.DHash == sceneHashes[0].DHash) && (loaded.PHash == sceneHashes[0].PHash),
+		"The hash did not survive a chunk round trip."
+	);
+	tSystem::tDeleteFile(hashFile);
+
+	// A scene, a brightened copy and a different scene. Only the first two are duplicates.
+	tList<tStringItem> files;
+	for (int f = 0; f < 3; f++)
+	{
+		tPicture picture;
+		MakeScenePicture(picture, (f == 2) ? 1001 : 1000);
+		if (f == 1)
+			EditPicture(picture, 1, seed);
+		tString file;
+		tsPrintf(file, "%sScene%d.tga", dir.Chars(), f);
+		picture.SaveTGA(file, tFileTGA::tFormat::Auto, tFileTGA::tCompression::None);
+		files.Append(new tStringItem(file));
+	}
+
+	tList<tDuplicateCluster> duplicates;
+	int numDuplicates = tFindDuplicates(duplicates, files);
+	const tDuplicateCluster* cluster = duplicates.First();
+	bool pair = (numDuplicates == 1) && cluster && (cluster->Members.GetNumItems() == 2);
+	pair = pair && (cluster->Members.First()->ID == 0) && (cluster->Members.Last()->ID == 1);
+	pair = pair && (cluster->Members.Last()->Filename == *files.First()->Next());
+	check(pair, "The edited copy was not the only duplicate found.");
+
+	for (const tStringItem* file = files.First(); file; file = file->Next())
+		tSystem::tDeleteFile(*file);
+
+	return check.Report();
+}
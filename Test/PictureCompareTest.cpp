@@ -0,0 +1,303 @@
+// PictureCompareTest.cpp
+//
+// Checks tPictureCompare against metrics computed here pixel by pixel and window by window in double precision, on
+// every pattern with noise added to some of the pixels. Also checks a case with a known error, identical pictures,
+// each size policy, the heat map, views of larger pictures, pictures smaller than the SSIM window, and that the
+// results don't change with the number of threads.
+//
+// Copyright (c) 2020 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <math.h>
+#include <Math/tFundamentals.h>
+#include <Image/tPictureCompare.h>
+#include "Fixtures.h"
+#include "Tests.h"
+using namespace tImage;
+
+
+namespace
+{
+	// Neither size is a multiple of the band height or the window step.
+	const int PictureWidth = 333;
+	const int PictureHeight = 250;
+
+	// The windows are summed in a different order here so SSIM only matches to rounding.
+	const double MaxSSIMError = 1.0e-9;
+
+	// The same constants and window placement tPictureCompare documents.
+	const int Window = 8;
+	const int Step = 4;
+	const double C1 = (0.01*255.0)*(0.01*255.0);
+	const double C2 = (0.03*255.0)*(0.03*255.0);
+
+	struct Reference
+	{
+		double MSE[tPictureCompare::tChannel_NumChannels];
+		double SSIM[tPictureCompare::tChannel_NumChannels];
+		int MaxAbsError[tPictureCompare::tChannel_NumChannels];
+		int NumDiffPixels;
+	};
+
+	// The window statistics are computed in two passes rather than from sums of squares.
+	double GetWindowSSIM(const tPictureView& a, const tPictureView& b, int x0, int y0, int w, int h, int c)
+	{
+		double n = double(w*h);
+		double meanA = 0.0, meanB = 0.0;
+		for (int y = y0; y < y0+h; y++)
+		{
+			for (int x = x0; x < x0+w; x++)
+			{
+				meanA += double(a[y][x].E[c]);
+				meanB += double(b[y][x].E[c]);
+			}
+		}
+		meanA /= n;
+		meanB /= n;
+
+		double varA = 0.0, varB = 0.0, covar = 0.0;
+		for (int y = y0; y < y0+h; y++)
+		{
+			for (int x = x0; x < x0+w; x++)
+			{
+				double da = double(a[y][x].E[c]) - meanA;
+				double db = double(b[y][x].E[c]) - meanB;
+				varA += da*da;
+				varB += db*db;
+				covar += da*db;
+			}
+		}
+		varA /= n;
+		varB /= n;
+		covar /= n;
+
+		return ((2.0*meanA*meanB + C1) * (2.0*covar + C2)) / ((meanA*meanA + meanB*meanB + C1) * (varA + varB + C2));
+	}
+
+	void ComputeReference(Reference& ref, const tPictureView& a, const tPictureView& b)
+	{
+		tStd::tMemset(&ref, 0, sizeof(Reference));
+		int width = a.GetWidth();
+		int height = a.GetHeight();
+		for (int y = 0; y < height; y++)
+		{
+			for (int x = 0; x < width; x++)
+			{
+				bool differs = false;
+				for (int c = 0; c < 4; c++)
+				{
+					int diff = tMath::tAbs(int(a[y][x].E[c]) - int(b[y][x].E[c]));
+					ref.MSE[c] += double(diff*diff);
+					ref.MaxAbsError[c] = tMath::tMax(ref.MaxAbsError[c], diff);
+					differs = differs || diff;
+				}
+				if (differs)
+					ref.NumDiffPixels++;
+			}
+		}
+
+		int winW = tMath::tMin(Window, width);
+		int winH = tMath::tMin(Window, height);
+		int numWindows = 0;
+		for (int y = 0; y + winH <= height; y += Step)
+		{
+			for (int x = 0; x + winW <= width; x += Step)
+			{
+				for (int c = 0; c < 4; c++)
+					ref.SSIM[c] += GetWindowSSIM(a, b, x, y, winW, winH, c);
+				numWindows++;
+			}
+		}
+
+		const int all = tPictureCompare::tChannel_All;
+		for (int c = 0; c < 4; c++)
+		{
+			ref.MSE[c] /= double(width*height);
+			ref.SSIM[c] /= double(numWindows);
+			ref.MSE[all] += ref.MSE[c] / 4.0;
+			ref.SSIM[all] += ref.SSIM[c] / 4.0;
+			ref.MaxAbsError[all] = tMath::tMax(ref.MaxAbsError[all], ref.MaxAbsError[c]);
+		}
+	}
+
+	// Returns the number of fields that don't match the reference. The MSE sums are exact integers in both.
+	int CountErrors(const tPictureCompare& compare, const Reference& ref, int width, int height)
+	{
+		int numErrors = 0;
+		if ((compare.Width != width) || (compare.Height != height) || (compare.NumPixels != width*height))
+			numErrors++;
+		if (compare.NumDiffPixels != ref.NumDiffPixels)
+			numErrors++;
+
+		for (int c = 0; c < tPictureCompare::tChannel_NumChannels; c++)
+		{
+			if (tMath::tAbs(compare.MSE[c] - ref.MSE[c]) > 1.0e-9*tMath::tMax(ref.MSE[c], 1.0))
+				numErrors++;
+			if (tMath::tAbs(compare.SSIM[c] - ref.SSIM[c]) > MaxSSIMError)
+				numErrors++;
+			if (compare.MaxAbsError[c] != ref.MaxAbsError[c])
+				numErrors++;
+
+			double psnr = (ref.MSE[c] > 0.0) ? 10.0*log10(255.0*255.0 / ref.MSE[c]) : tStd::tDoublePINF();
+			bool infinite = (ref.MSE[c] == 0.0);
+			if (infinite ? (compare.PSNR[c] != psnr) : (tMath::tAbs(compare.PSNR[c] - psnr) > 1.0e-6))
+				numErrors++;
+		}
+
+		return numErrors;
+	}
+
+	bool IsSame(const tPictureCompare& a, const tPictureCompare& b)
+	{
+		if ((a.Width != b.Width) || (a.Height != b.Height) || (a.NumDiffPixels != b.NumDiffPixels))
+			return false;
+
+		for (int c = 0; c < tPictureCompare::tChannel_NumChannels; c++)
+			if ((a.MSE[c] != b.MSE[c]) || (a.SSIM[c] != b.SSIM[c]) || (a.MaxAbsError[c] != b.MaxAbsError[c]))
+				return false;
+
+		return true;
+	}
+
+	// Adds up to amplitude to or from each channel of about one pixel in every skip.
+	void AddNoise(tPicture& picture, int amplitude, int skip, uint32& seed)
+	{
+		tPixel* pixels = picture.GetPixelPointer();
+		for (int p = 0; p < picture.GetNumPixels(); p++)
+		{
+			if (Test::Random(seed, skip))
+				continue;
+
+			for (int c = 0; c < 4; c++)
+			{
+				int v = int(pixels[p].E[c]) + Test::Random(seed, 2*amplitude + 1) - amplitude;
+				pixels[p].E[c] = uint8(tMath::tClamp(v, 0, 255));
+			}
+		}
+	}
+}
+
+
+bool Test::PictureCompare()
+{
+	Checks check("PictureCompare");
+	uint32 seed = 1;
+	tPicture a, b;
+	tPicture heatMap;
+	for (int pattern = 0; pattern < NumPatterns; pattern++)
+	{
+		tPixel* pixels = tPicture::AllocPixels(PictureWidth*PictureHeight);
+		MakePatternPixels(pixels, PictureWidth, PictureHeight, pattern, seed);
+		a.Set(PictureWidth, PictureHeight, pixels, false);
+		b.Set(a);
+		AddNoise(b, 3 + pattern*8, 3, seed);
+
+		Reference ref;
+		ComputeReference(ref, a.GetView(), b.GetView());
+		tPictureCompare single, all;
+		single.Compute(a, b, tPictureCompare::tSizePolicy::Fail, nullptr, 1.0f, 1);
+		all.Compute(a, b, tPictureCompare::tSizePolicy::Fail, &heatMap, 1.0f, -1);
+		int numErrors = CountErrors(single, ref, PictureWidth, PictureHeight);
+		check(!numErrors, "Pattern %d has %d fields that differ from the reference.", pattern, numErrors);
+		check(IsSame(single, all), "Pattern %d changes with the number of threads.", pattern);
+
+		// The heat map is black exactly where the pixels match.
+		int numHeatErrors = 0;
+		bool heatSize = (heatMap.GetWidth() == PictureWidth) && (heatMap.GetHeight() == PictureHeight);
+		for (int p = 0; heatSize && (p < heatMap.GetNumPixels()); p++)
+		{
+			bool black = (heatMap.GetPixels()[p].BP == tPixel::black.BP);
+			if (black != (a.GetPixels()[p] == b.GetPixels()[p]))
+				numHeatErrors++;
+		}
+		check(heatSize && !numHeatErrors, "The heat map of pattern %d has %d wrong pixels.", pattern, numHeatErrors);
+
+		// Comparing views of regions must be the same as comparing copies of them.
+		tPictureView viewA = a.GetView(21, 9, 150, 121);
+		tPictureView viewB = b.GetView(21, 9, 150, 121);
+		tPicture cropA, cropB;
+		cropA.Set(viewA);
+		cropB.Set(viewB);
+		tPictureCompare viewCompare, cropCompare;
+		viewCompare.Compute(viewA, viewB);
+		cropCompare.Compute(cropA, cropB);
+		check(IsSame(viewCompare, cropCompare), "Views of pattern %d differ from copies.", pattern);
+	}
+
+	// Adding 10 to every red value gives an MSE of exactly 100 in red and a quarter of that overall.
+	tPixel* pixels = tPicture::AllocPixels(PictureWidth*PictureHeight);
+	MakePatternPixels(pixels, PictureWidth, PictureHeight, 0, seed);
+	for (int p = 0; p < PictureWidth*PictureHeight; p++)
+		pixels[p].R = pixels[p].R % 200;
+	a.Set(PictureWidth, PictureHeight, pixels, false);
+	b.Set(a);
+	for (int p = 0; p < b.GetNumPixels(); p++)
+		b.GetPixelPointer()[p].R += 10;
+	tPictureCompare known(a, b);
+	check
+	(
+		(known.MSE[tPictureCompare::tChannel_R] == 100.0) && (known.MSE[tPictureCompare::tChannel_All] == 25.0) &&
+		(known.MaxAbsError[tPictureCompare::tChannel_R] == 10) && (known.NumDiffPixels == known.NumPixels),
+		"An offset of 10 in red gave an MSE of %f.", known.MSE[tPictureCompare::tChannel_R]
+	);
+	check
+	(
+		tMath::tAbs(known.PSNR[tPictureCompare::tChannel_R] - 10.0*log10(65025.0/100.0)) < 1.0e-9,
+		"An MSE of 100 gave a PSNR of %f.", known.PSNR[tPictureCompare::tChannel_R]
+	);
+
+	// Identical pictures.
+	tPictureCompare same(a, a);
+	bool identical = same.IsIdentical() && !same.MaxAbsError[tPictureCompare::tChannel_All];
+	for (int c = 0; c < tPictureCompare::tChannel_NumChannels; c++)
+		identical = identical && (same.PSNR[c] == tStd::tDoublePINF()) && (tMath::tAbs(same.SSIM[c] - 1.0) < 1.0e-12);
+	check(identical, "Identical pictures were not reported as identical.");
+
+	// Different sizes. The overlap is anchored at the lower-left. Resampling resizes b to the size of a.
+	tPicture small;
+	small.Set(a.GetView(0, 0, 200, 100));
+	tPictureCompare fail;
+	check(!fail.Compute(a, small) && !fail.IsValid(), "Different sizes did not fail with the Fail policy.");
+
+	tPictureCompare overlap, overlapCrop;
+	overlap.Compute(small, a, tPictureCompare::tSizePolicy::Overlap);
+	overlapCrop.Compute(small.GetView(), a.GetView(0, 0, 200, 100));
+	check
+	(
+		overlap.IsIdentical() && (overlap.Width == 200) && (overlap.Height == 100) && IsSame(overlap, overlapCrop),
+		"The overlap was not the lower-left region."
+	);
+
+	tPicture resampled;
+	resampled.Set(small);
+	resampled.Resample(PictureWidth, PictureHeight, tPicture::tFilter::Bilinear);
+	tPictureCompare resample, resampleCopy;
+	resample.Compute(a, small, tPictureCompare::tSizePolicy::Resample, &heatMap);
+	resampleCopy.Compute(a, resampled);
+	check
+	(
+		IsSame(resample, resampleCopy) &&
+		(heatMap.GetWidth() == PictureWidth) && (heatMap.GetHeight() == PictureHeight),
+		"Resampling did not compare against b resized to the size of a."
+	);
+
+	// Pictures smaller than the SSIM window use one window covering the whole picture.
+	tPicture tinyA, tinyB;
+	tinyA.Set(a.GetView(40, 40, 5, 3));
+	tinyB.Set(b.GetView(40, 40, 5, 3));
+	Reference ref;
+	ComputeReference(ref, tinyA.GetView(), tinyB.GetView());
+	tPictureCompare tiny(tinyA, tinyB);
+	int numErrors = CountErrors(tiny, ref, 5, 3);
+	check(!numErrors, "A 5x3 picture has %d fields that differ from the reference.", numErrors);
+
+	check(!fail.Compute(a, tPicture()), "Comparing with an invalid picture did not fail.");
+	return check.Report();
+}
@@ -0,0 +1,250 @@
+// PictureStatsTest.cpp
+//
+// Checks tPictureStats against statistics computed here pixel by pixel in double precision. Every pattern is run on a
+// picture big enough to be split into several chunks, with one thread and with all of them, and through a strided
+// view of a sub-rectangle. The distinct colour estimate is checked against pictures with a known number of colours.
+// Prints how long a large picture takes on one thread and on all of them.
+//
+// Copyright (c) 2020 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <math.h>
+#include <Math/tFundamentals.h>
+#include <System/tTime.h>
+#include <System/tPrint.h>
+#include <Image/tPictureStats.h>
+#include "Fixtures.h"
+#include "Tests.h"
+using namespace tImage;
+
+
+namespace
+{
+	// An odd size so neither the chunks nor the rows divide it evenly. It is about 8 chunks.
+	const int PictureWidth = 1031;
+	const int PictureHeight = 517;
+	const int TimingSize = 4096;
+
+	// The mean and standard deviation come from float fields so they are only checked to a little better than a
+	// thousandth of a level.
+	const double MaxMomentError = 0.001;
+
+	// The estimator has a standard error of about 1.6%, so this is around three of them. For a solid picture it
+	// means the estimate must be exactly one.
+	const double MaxDistinctError = 0.05;
+
+	struct Reference
+	{
+		uint32 Histograms[tPictureStats::tChannel_NumChannels][256];
+		int Min[tPictureStats::tChannel_NumChannels];
+		int Max[tPictureStats::tChannel_NumChannels];
+		double Mean[tPictureStats::tChannel_NumChannels];
+		double StdDev[tPictureStats::tChannel_NumChannels];
+		int NumOpaque;
+		int NumTransparent;
+	};
+
+	// The luminance has to use the same weights as tPictureStats for the histograms to match exactly.
+	int GetChannel(const tPixel& pixel, int channel)
+	{
+		switch (channel)
+		{
+			case tPictureStats::tChannel_R:		return pixel.R;
+			case tPictureStats::tChannel_G:		return pixel.G;
+			case tPictureStats::tChannel_B:		return pixel.B;
+			case tPictureStats::tChannel_A:		return pixel.A;
+		}
+		return (54*pixel.R + 183*pixel.G + 19*pixel.B) >> 8;
+	}
+
+	// Two passes, so the variance doesn't depend on the sum of squares trick tPictureStats uses.
+	void ComputeReference(Reference& ref, const tPictureView& view)
+	{
+		tStd::tMemset(&ref, 0, sizeof(Reference));
+		double numPixels = double(view.GetNumPixels());
+		for (int c = 0; c < tPictureStats::tChannel_NumChannels; c++)
+		{
+			ref.Min[c] = 255;
+			ref.Max[c] = 0;
+			double sum = 0.0;
+			for (int y = 0; y < view.GetHeight(); y++)
+			{
+				for (int x = 0; x < view.GetWidth(); x++)
+				{
+					int v = GetChannel(view[y][x], c);
+					ref.Histograms[c][v]++;
+					ref.Min[c] = tMath::tMin(ref.Min[c], v);
+					ref.Max[c] = tMath::tMax(ref.Max[c], v);
+					sum += double(v);
+				}
+			}
+			ref.Mean[c] = sum / numPixels;
+
+			double sumSq = 0.0;
+			for (int y = 0; y < view.GetHeight(); y++)
+			{
+				for (int x = 0; x < view.GetWidth(); x++)
+				{
+					double d = double(GetChannel(view[y][x], c)) - ref.Mean[c];
+					sumSq += d*d;
+				}
+			}
+			ref.StdDev[c] = sqrt(sumSq / numPixels);
+		}
+
+		for (int y = 0; y < view.GetHeight(); y++)
+		{
+			for (int x = 0; x < view.GetWidth(); x++)
+			{
+				if (view[y][x].A == 255)
+					ref.NumOpaque++;
+				else if (view[y][x].A == 0)
+					ref.NumTransparent++;
+			}
+		}
+	}
+
+	// Returns the number of fields that don't match the reference.
+	int CountErrors(const tPictureStats& stats, const Reference& ref, int numPixels)
+	{
+		int numErrors = 0;
+		if (stats.NumPixels != numPixels)
+			numErrors++;
+
+		for (int c = 0; c < tPictureStats::tChannel_NumChannels; c++)
+		{
+			tPictureStats::tChannel channel = tPictureStats::tChannel(c);
+			if (tStd::tMemcmp(stats.GetHistogram(channel), ref.Histograms[c], sizeof(ref.Histograms[c])))
+				numErrors++;
+			if ((stats.Min[c] != ref.Min[c]) || (stats.Max[c] != ref.Max[c]))
+				numErrors++;
+			if (tMath::tAbs(double(stats.Mean[c]) - ref.Mean[c]) > MaxMomentError)
+				numErrors++;
+			if (tMath::tAbs(double(stats.StdDev[c]) - ref.StdDev[c]) > MaxMomentError)
+				numErrors++;
+
+			uint32 maxBin = 0;
+			for (int v = 0; v < 256; v++)
+				maxBin = tMath::tMax(maxBin, ref.Histograms[c][v]);
+			if (stats.GetMaxBinCount(channel) != maxBin)
+				numErrors++;
+		}
+
+		if ((stats.NumOpaque != ref.NumOpaque) || (stats.NumTransparent != ref.NumTransparent))
+			numErrors++;
+		if (stats.NumTranslucent != numPixels - ref.NumOpaque - ref.NumTransparent)
+			numErrors++;
+		double coverage = double(numPixels - ref.NumTransparent) / double(numPixels);
+		if (tMath::tAbs(double(stats.AlphaCoverage) - coverage) > 1.0e-6)
+			numErrors++;
+
+		return numErrors;
+	}
+
+	bool IsSame(const tPictureStats& a, const tPictureStats& b)
+	{
+		for (int c = 0; c < tPictureStats::tChannel_NumChannels; c++)
+		{
+			tPictureStats::tChannel channel = tPictureStats::tChannel(c);
+			if (tStd::tMemcmp(a.GetHistogram(channel), b.GetHistogram(channel), 256*sizeof(uint32)))
+				return false;
+			if ((a.Mean[c] != b.Mean[c]) || (a.StdDev[c] != b.StdDev[c]))
+				return false;
+		}
+
+		return (a.NumPixels == b.NumPixels) && (a.NumDistinctColours == b.NumDistinctColours);
+	}
+
+	// Colour i is spread over all four channels by an odd multiplier, so the colours are all different and not in
+	// any order the estimator might favour. Neighbouring pixels differ unless there is only one colour.
+	void MakeColoursPixels(tPixel* pixels, int numPixels, int numColours)
+	{
+		for (int p = 0; p < numPixels; p++)
+			pixels[p].BP = uint32(p % numColours) * 2654435761u;
+	}
+}
+
+
+bool Test::PictureStats()
+{
+	Checks check("PictureStats");
+	int numPixels = PictureWidth*PictureHeight;
+	tPixel* pixels = tPicture::AllocPixels(numPixels);
+	uint32 seed = 1;
+	for (int pattern = 0; pattern < NumPatterns; pattern++)
+	{
+		MakePatternPixels(pixels, PictureWidth, PictureHeight, pattern, seed);
+		tPictureView view(pixels, PictureWidth, PictureHeight);
+		Reference ref;
+		ComputeReference(ref, view);
+
+		tPictureStats single;
+		single.Compute(view, 1);
+		tPictureStats all;
+		all.Compute(view, -1);
+		int numErrors = CountErrors(single, ref, numPixels);
+		check(!numErrors, "Pattern %d has %d fields that differ from the reference.", pattern, numErrors);
+		check(IsSame(single, all), "Pattern %d changes with the number of threads.", pattern);
+
+		// A view with a stride is processed a row at a time. It must give the same answer as a packed copy.
+		tPictureView subView = view.GetSubView(13, 7, 701, 409);
+		tPixel* copy = tPicture::AllocPixels(subView.GetNumPixels());
+		subView.CopyTo(copy);
+		ComputeReference(ref, subView);
+		tPictureStats sub;
+		sub.Compute(subView, -1);
+		tPictureStats packed;
+		packed.Compute(copy, subView.GetNumPixels(), -1);
+		tPicture::FreePixels(copy);
+		numErrors = CountErrors(sub, ref, subView.GetNumPixels());
+		check(!numErrors, "The view of pattern %d has %d fields that differ from the reference.", pattern, numErrors);
+		check(IsSame(sub, packed), "The view of pattern %d differs from a packed copy.", pattern);
+	}
+
+	// An invalid picture leaves the stats invalid.
+	tPictureStats invalid(tPicture(), -1);
+	check(!invalid.IsValid() && !invalid.NumPixels, "An invalid picture gave valid stats.");
+	tPicture::FreePixels(pixels);
+
+	// Known numbers of distinct colours. The picture must have room for the largest count.
+	const int distinctSize = 1024;
+	const int numDistinctPixels = distinctSize*distinctSize;
+	const int colourCounts[] = { 1, 7, 1000, 4000, 9000, 50000, 300000, 1000000 };
+	pixels = tPicture::AllocPixels(numDistinctPixels);
+	for (int count : colourCounts)
+	{
+		MakeColoursPixels(pixels, numDistinctPixels, count);
+		tPictureStats stats;
+		stats.Compute(pixels, numDistinctPixels, -1);
+		double error = tMath::tAbs(double(stats.NumDistinctColours - count)) / double(count);
+		tPrintf("%7d colours estimated as %7d (%.2f%%)\n", count, stats.NumDistinctColours, error*100.0);
+		check(error <= MaxDistinctError, "%d colours were estimated as %d.", count, stats.NumDistinctColours);
+	}
+	tPicture::FreePixels(pixels);
+
+	int numTimingPixels = TimingSize*TimingSize;
+	pixels = tPicture::AllocPixels(numTimingPixels);
+	MakePatternPixels(pixels, TimingSize, TimingSize, NumPatterns-1, seed);
+	double times[2];
+	for (int pass = 0; pass < 2; pass++)
+	{
+		double start = tSystem::tGetTimeDouble();
+		tPictureStats stats;
+		stats.Compute(pixels, numTimingPixels, pass ? -1 : 1);
+		times[pass] = tSystem::tGetTimeDouble() - start;
+	}
+	tPicture::FreePixels(pixels);
+	tPrintf
+	(
+		"%dx%d: %.1fms on one thread, %.1fms on all of them\n", TimingSize, TimingSize, times[0]*1000.0, times[1]*1000.0
+	);
+
+	return check.Report();
+}
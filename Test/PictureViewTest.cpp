@@ -0,0 +1,207 @@
+// PictureViewTest.cpp
+//
+// Checks that moving a tPicture hands over its pixel buffer without copying, that every pixel buffer is aligned, and
+// that views clip, nest, copy and compare correctly with the same pixels a crop gives. Prints how long it takes to
+// pass a large picture through a few stages by copying and by moving, and to crop it compared to taking a view.
+//
+// Copyright (c) 2020 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <utility>
+#include <Math/tFundamentals.h>
+#include <System/tTime.h>
+#include <System/tPrint.h>
+#include <Image/tPicture.h>
+#include <Image/tPictureView.h>
+#include "Fixtures.h"
+#include "Tests.h"
+using namespace tImage;
+
+
+namespace
+{
+	const int PictureWidth = 301;
+	const int PictureHeight = 199;
+	const int TimingSize = 4096;
+	const int NumStages = 4;
+
+	bool IsAligned(const tPixel* pixels)
+	{
+		return pixels && !(uint64(pixels) % uint64(tPicture::PixelAlignment));
+	}
+
+	// Counts the pixels of the view that aren't the coordinate pixel of (x0 + x, y0 + y).
+	int CountCoordErrors(const tPictureView& view, int x0, int y0)
+	{
+		int numErrors = 0;
+		for (int y = 0; y < view.GetHeight(); y++)
+			for (int x = 0; x < view.GetWidth(); x++)
+				if (view.GetPixel(x, y) != Test::GetCoordPixel(x0 + x, y0 + y))
+					numErrors++;
+		return numErrors;
+	}
+
+	void MakeCoordPicture(tPicture& picture, int width, int height)
+	{
+		tPixel* pixels = tPicture::AllocPixels(width*height);
+		for (int y = 0; y < height; y++)
+			for (int x = 0; x < width; x++)
+				pixels[y*width + x] = Test::GetCoordPixel(x, y);
+		picture.Set(width, height, pixels, false);
+	}
+
+	// A pipeline stage that hands its result back. Taking and returning by value copies unless the caller moves.
+	tPicture PassStage(tPicture picture)
+	{
+		picture.GetPixelPointer()[0].R++;
+		return picture;
+	}
+}
+
+
+bool Test::PictureView()
+{
+	Checks check("PictureView");
+
+	// Every size, including odd ones, starts on the alignment boundary.
+	bool aligned = true;
+	for (int numPixels = 1; numPixels < 200; numPixels += 7)
+	{
+		tPixel* pixels = tPicture::AllocPixels(numPixels);
+		aligned = aligned && IsAligned(pixels);
+		tPicture::FreePixels(pixels);
+	}
+	check(aligned, "A pixel buffer was not %d byte aligned.", tPicture::PixelAlignment);
+
+	tPicture picture;
+	MakeCoordPicture(picture, PictureWidth, PictureHeight);
+	tPicture copy(picture);
+	check(IsAligned(copy.GetPixels()) && (copy == picture), "A copied picture differs or is not aligned.");
+	copy.Crop(101, 57, 3, 5);
+	check(IsAligned(copy.GetPixels()), "A cropped picture is not aligned.");
+
+	// Moving hands over the buffer. The source is left invalid.
+	const tPixel* buffer = picture.GetPixels();
+	tPicture moved(std::move(picture));
+	check(!picture.IsValid() && (moved.GetPixels() == buffer), "The move constructor copied the pixels.");
+	check(!CountCoordErrors(moved.GetView(), 0, 0), "The moved picture has the wrong pixels.");
+
+	tPicture assigned;
+	assigned.Set(8, 8);
+	assigned = std::move(moved);
+	check
+	(
+		!moved.IsValid() && (assigned.GetPixels() == buffer) &&
+		(assigned.GetWidth() == PictureWidth) && (assigned.GetHeight() == PictureHeight),
+		"Move assignment copied the pixels or lost the size."
+	);
+
+	tPicture& self = assigned;
+	assigned = std::move(self);
+	check(assigned.GetPixels() == buffer, "Moving a picture into itself lost the pixels.");
+
+	tPixel* stolen = assigned.StealPixels();
+	check((stolen == buffer) && !assigned.IsValid(), "StealPixels did not give up the buffer.");
+	picture.Set(PictureWidth, PictureHeight, stolen, false);
+
+	// Views of sub-rectangles are clipped to the picture and read the same pixels as the picture.
+	tPictureView whole = picture.GetView();
+	check
+	(
+		whole.IsPacked() && (whole.GetStride() == PictureWidth) && !CountCoordErrors(whole, 0, 0),
+		"The whole picture view is wrong."
+	);
+
+	tPictureView sub = picture.GetView(17, 23, 100, 60);
+	check
+	(
+		!sub.IsPacked() && (sub.GetStride() == PictureWidth) && (sub.GetWidth() == 100) && (sub.GetHeight() == 60) &&
+		!CountCoordErrors(sub, 17, 23),
+		"A sub-rectangle view is wrong."
+	);
+
+	tPictureView nested = sub.GetSubView(10, 5, 20, 30);
+	check(!CountCoordErrors(nested, 27, 28) && (nested.GetWidth() == 20), "A view of a view is wrong.");
+
+	tPictureView clipped = picture.GetView(-10, PictureHeight - 20, 50, 100);
+	check
+	(
+		(clipped.GetWidth() == 40) && (clipped.GetHeight() == 20) && !CountCoordErrors(clipped, 0, PictureHeight - 20),
+		"A view over the edge was not clipped."
+	);
+	check(!picture.GetView(PictureWidth, 0, 10, 10).IsValid(), "A view outside the picture is valid.");
+	check(!tPicture().GetView().IsValid(), "A view of an invalid picture is valid.");
+
+	// Copying a view gives the same pixels as cropping. A picture can be cropped to a view of itself.
+	tPicture fromView(sub);
+	tPicture cropped(picture);
+	cropped.Crop(100, 60, 17, 23);
+	check(fromView == cropped, "Copying a view differs from cropping.");
+	check(IsAligned(fromView.GetPixels()), "A picture copied from a view is not aligned.");
+	check((sub == fromView.GetView()) && (sub != nested), "Views with different strides did not compare correctly.");
+
+	tPixel* packed = tPicture::AllocPixels(sub.GetNumPixels());
+	sub.CopyTo(packed);
+	check(tPictureView(packed, 100, 60) == fromView.GetView(), "CopyTo did not pack the rows.");
+	tPicture::FreePixels(packed);
+
+	tPicture selfCrop(picture);
+	selfCrop.Set(selfCrop.GetView(17, 23, 100, 60));
+	check(selfCrop == cropped, "Setting a picture from a view of itself did not crop it.");
+
+	// Only the pixels inside a view count towards its opacity.
+	for (int p = 0; p < picture.GetNumPixels(); p++)
+		picture.GetPixelPointer()[p].A = 255;
+	picture.GetPixelPointer()[0].A = 0;
+	check(!picture.GetView().IsOpaque() && sub.IsOpaque(), "A view's opacity included pixels outside it.");
+	picture.GetPixelPointer()[PictureWidth*30 + 40].A = 0;
+	check(!sub.IsOpaque(), "A view ignored a transparent pixel inside it.");
+
+	// Passing a large picture through a few stages. Each copy is a whole buffer that moving doesn't make.
+	tPicture large;
+	MakeCoordPicture(large, TimingSize, TimingSize);
+	double times[2];
+	bool kept = true;
+	for (int pass = 0; pass < 2; pass++)
+	{
+		tPicture stage(large);
+		const tPixel* start = stage.GetPixels();
+		double startTime = tSystem::tGetTimeDouble();
+		for (int s = 0; s < NumStages; s++)
+			stage = pass ? PassStage(std::move(stage)) : PassStage(stage);
+		times[pass] = tSystem::tGetTimeDouble() - startTime;
+		if (pass)
+			kept = (stage.GetPixels() == start);
+	}
+	check(kept, "Moving through the stages reallocated the pixels.");
+	tPrintf
+	(
+		"%d stages of %dx%d: %.1fms copying, %.3fms moving\n",
+		NumStages, TimingSize, TimingSize, times[0]*1000.0, times[1]*1000.0
+	);
+
+	// Cropping copies the region into a new buffer. A view of the same region is just a pointer and a stride.
+	tPicture crop(large);
+	double startTime = tSystem::tGetTimeDouble();
+	crop.Crop(TimingSize/2, TimingSize/2, TimingSize/4, TimingSize/4);
+	double cropTime = tSystem::tGetTimeDouble() - startTime;
+
+	startTime = tSystem::tGetTimeDouble();
+	tPictureView view = large.GetView(TimingSize/4, TimingSize/4, TimingSize/2, TimingSize/2);
+	double viewTime = tSystem::tGetTimeDouble() - startTime;
+	check(view == crop.GetView(), "The large view differs from the crop.");
+	tPrintf
+	(
+		"Quarter crop of %dx%d: %.1fms copying, %.3fms as a view\n",
+		TimingSize, TimingSize, cropTime*1000.0, viewTime*1000.0
+	);
+
+	return check.Report();
+}
@@ -0,0 +1,210 @@
+// PixelConvertTest.cpp
+//
+// Converts between every pair of normal pixel formats and checks the results. Every 16 bit source pixel value is tried,
+// and random values for the others. Checks that the SIMD kernels match the scalar path bit for bit, that every channel
+// is within rounding of an exact double precision conversion, and that converting to a format with at least as many
+// bits per channel and back gives the original pixels.
+//
+// Copyright (c) 2020 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <math.h>
+#include <Math/tFundamentals.h>
+#include <Image/tPixelConvert.h>
+#include "Fixtures.h"
+#include "Tests.h"
+using namespace tImage;
+
+
+namespace
+{
+	// Conversions are split into chunks of 64k pixels for threading. This is enough for more than one chunk so the
+	// threaded path runs, and not a multiple of 4 so the scalar tail of the SIMD kernels does too.
+	const int NumPixels = (1 << 16) + 4099;
+
+	// The Rec. 709 luma weights tConvertPixels uses when writing a luminance format.
+	const double LumR = 0.2126;
+	const double LumG = 0.7152;
+	const double LumB = 0.0722;
+
+	double GetMask(int bits)																							{ return double((uint64(1) << bits) - 1); }
+
+	// Reads a pixel in double precision without using any of the kernels. Missing colour channels are 0 and a missing
+	// alpha is 1.
+	void DecodeExact(double colour[4], const uint8* src, const tPixelLayout& layout)
+	{
+		for (int c = 0; c < 4; c++)
+		{
+			if (!layout.Bits[c])
+			{
+				colour[c] = (c == 3) ? 1.0 : 0.0;
+			}
+			else if (layout.Float)
+			{
+				float value;
+				tStd::tMemcpy(&value, src + layout.Shift[c]/8, sizeof(float));
+				colour[c] = double(value);
+			}
+			else
+			{
+				uint64 word = 0;
+				for (int b = 0; b < layout.BytesPerPixel; b++)
+					word |= uint64(src[b]) << (8*b);
+				uint64 mask = (uint64(1) << layout.Bits[c]) - 1;
+				colour[c] = double((word >> layout.Shift[c]) & mask) / double(mask);
+			}
+		}
+	}
+
+	// Returns true if converting from src to dest and back must give the original pixel.
+	bool IsWidening(const tPixelLayout& dest, const tPixelLayout& src)
+	{
+		// Luminance only survives a round trip through itself or a format that keeps the colour channels equal.
+		if (dest.Luminance && !src.Luminance)
+			return false;
+		if (src.Float && !dest.Float)
+			return false;
+
+		for (int c = 0; c < 4; c++)
+			if (src.Bits[c] && (!dest.Bits[c] || (!dest.Float && (dest.Bits[c] < src.Bits[c]))))
+				return false;
+
+		return true;
+	}
+
+	// Returns the number of bad pixels and describes the first one in error.
+	int TestPair(tPixelFormat destFormat, tPixelFormat srcFormat, const uint8* src, tString& error)
+	{
+		const tPixelLayout& dl = *tGetPixelLayout(destFormat);
+		const tPixelLayout& sl = *tGetPixelLayout(srcFormat);
+		uint8* dest = new uint8[NumPixels*dl.BytesPerPixel];
+		uint8* single = new uint8[dl.BytesPerPixel];
+		uint8* back = new uint8[NumPixels*sl.BytesPerPixel];
+		bool widening = IsWidening(dl, sl);
+
+		// The whole run goes through the SIMD kernels and threads. A single pixel only ever takes the scalar path.
+		tConvertPixels(dest, destFormat, src, srcFormat, NumPixels, -1);
+		if (widening)
+			tConvertPixels(back, srcFormat, dest, destFormat, NumPixels, -1);
+
+		int numBad = 0;
+		for (int p = 0; p < NumPixels; p++)
+		{
+			const uint8* s = src + p*sl.BytesPerPixel;
+			const uint8* d = dest + p*dl.BytesPerPixel;
+			const char* problem = nullptr;
+
+			tConvertPixels(single, destFormat, s, srcFormat, 1, 1);
+			if (tStd::tMemcmp(single, d, dl.BytesPerPixel))
+				problem = "SIMD and scalar results differ";
+
+			double in[4], out[4];
+			DecodeExact(in, s, sl);
+			DecodeExact(out, d, dl);
+			if (!dl.Float)
+				for (int c = 0; c < 4; c++)
+					in[c] = tMath::tClamp(in[c], 0.0, 1.0);
+
+			if (dl.Luminance)
+			{
+				// Luminance goes through float weights so it may land one step either side of the exact value.
+				double lum = in[0]*LumR + in[1]*LumG + in[2]*LumB;
+				double mask = GetMask(dl.Bits[0]);
+				if (!problem && (tMath::tAbs(out[0] - floor(lum*mask + 0.5)/mask) > 1.0001/mask))
+					problem = "Luminance is off by more than one step";
+			}
+
+			for (int c = dl.Luminance ? 3 : 0; (c < 4) && !problem; c++)
+			{
+				if (!dl.Bits[c])
+					continue;
+
+				double expected = sl.Bits[c] ? in[c] : ((c == 3) ? 1.0 : 0.0);
+				if (dl.Float)
+				{
+					// Integer sources are divided in float, so they are only as exact as a float.
+					double tolerance = sl.Float ? 0.0 : 1.0e-6;
+					if (tMath::tAbs(out[c] - expected) > tolerance)
+						problem = "Float channel is wrong";
+				}
+				else
+				{
+					double mask = GetMask(dl.Bits[c]);
+					if (tMath::tAbs(out[c]*mask - floor(expected*mask + 0.5)) > 0.001)
+						problem = "Channel is not rounded to the nearest value";
+				}
+			}
+
+			if (!problem && widening && tStd::tMemcmp(back + p*sl.BytesPerPixel, s, sl.BytesPerPixel))
+				problem = "Converting back does not give the original pixel";
+
+			if (problem && (numBad++ == 0))
+				tsPrintf(error, "%s at pixel %d", problem, p);
+		}
+
+		delete[] back;
+		delete[] single;
+		delete[] dest;
+		return numBad;
+	}
+}
+
+
+bool Test::PixelConvert()
+{
+	Checks check("PixelConvert");
+	uint32 seed = 1;
+	for (int s = int(tPixelFormat::FirstNormal); s <= int(tPixelFormat::LastNormal); s++)
+	{
+		tPixelFormat srcFormat = tPixelFormat(s);
+		const tPixelLayout& sl = *tGetPixelLayout(srcFormat);
+		uint8* src = new uint8[NumPixels*sl.BytesPerPixel];
+		for (int p = 0; p < NumPixels; p++)
+		{
+			uint8* pixel = src + p*sl.BytesPerPixel;
+			if (sl.Float)
+			{
+				// Mostly in range, some outside to check clamping, and the exact ends.
+				for (int c = 0; c < sl.BytesPerPixel/4; c++)
+				{
+					float value = float(Random(seed) % 30001) / 20000.0f - 0.25f;
+					if (p < 4)
+						value = float(p & 1);
+					tStd::tMemcpy(pixel + c*4, &value, sizeof(float));
+				}
+			}
+			else if ((sl.BytesPerPixel == 2) && (p < 0x10000))
+			{
+				pixel[0] = uint8(p);
+				pixel[1] = uint8(p >> 8);
+			}
+			else
+			{
+				for (int b = 0; b < sl.BytesPerPixel; b++)
+					pixel[b] = uint8(Random(seed));
+			}
+		}
+
+		for (int d = int(tPixelFormat::FirstNormal); d <= int(tPixelFormat::LastNormal); d++)
+		{
+			tPixelFormat destFormat = tPixelFormat(d);
+			tString error;
+			int numBad = TestPair(destFormat, srcFormat, src, error);
+			check
+			(
+				!numBad, "%s to %s. %d bad pixels. %s",
+				tGetPixelFormatName(srcFormat), tGetPixelFormatName(destFormat), numBad, error.Chars()
+			);
+		}
+		delete[] src;
+	}
+
+	return check.Report();
+}
@@ -0,0 +1,192 @@
+// QOITest.cpp
+//
+// Checks the qoi writer and reader against a file worked out by hand from the spec, round trips pictures of several
+// sizes and kinds with 3 and 4 channels, and checks that truncated files are rejected. The benchmark saves and loads a
+// large picture as qoi, png and tga and prints the times and file sizes.
+//
+// Copyright (c) 2020 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <Math/tFundamentals.h>
+#include <System/tFile.h>
+#include <System/tTime.h>
+#include <System/tPrint.h>
+#include <Image/tFileQOI.h>
+#include <Image/tPicture.h>
+#include "Fixtures.h"
+#include "Tests.h"
+using namespace tImage;
+
+
+namespace
+{
+	// From the qoi spec.
+	const int HeaderBytes = 14;
+	const int EndMarkerBytes = 8;
+}
+
+
+bool Test::QOI()
+{
+	Checks check("QOI");
+	tString dir = GetDataDir("QOI");
+
+	// Each op appears once, a run, diff, luma, index, rgb, and rgba in that order, then a run of two at the end. The
+	// file was worked out by hand from the spec so a mistake made the same way in the reader and the writer still
+	// shows up.
+	tPixel known[] =
+	{
+		tPixel(0, 0, 0, 255), tPixel(1, 1, 1, 255), tPixel(21, 21, 18, 255), tPixel(1, 1, 1, 255),
+		tPixel(200, 10, 50, 255), tPixel(200, 10, 50, 128), tPixel(200, 10, 50, 128), tPixel(200, 10, 50, 128)
+	};
+	const uint8 knownFile[] =
+	{
+		'q', 'o', 'i', 'f', 0, 0, 0, 8, 0, 0, 0, 1, 4, 0,
+		0xC0, 0x7F, 0xB4, 0x85, 0x04, 0xFE, 200, 10, 50, 0xFF, 200, 10, 50, 128, 0xC1,
+		0, 0, 0, 0, 0, 0, 0, 1
+	};
+	int numKnown = tNumElements(known);
+
+	tString file = dir + "Known.qoi";
+	int numBytes = 0;
+	uint8* saved = nullptr;
+	if (tFileQOI::Save(file, tPictureView(known, numKnown, 1), tFileQOI::tFormat::Bit32) == tFileQOI::tFormat::Bit32)
+		saved = tSystem::tLoadFile(file, nullptr, &numBytes);
+	check
+	(
+		saved && (numBytes == int(sizeof(knownFile))) && !tStd::tMemcmp(saved, knownFile, numBytes),
+		"The writer did not make the known file"
+	);
+	delete[] saved;
+
+	tFileQOI loaded(knownFile, sizeof(knownFile));
+	check
+	(
+		loaded.IsValid() && (loaded.GetWidth() == numKnown) && (loaded.GetHeight() == 1) &&
+		!CountDifferences(loaded.GetPixels(), known, numKnown),
+		"The reader did not decode the known file"
+	);
+
+	// Round trips. The odd sizes make sure runs carry over from one row to the next and that single pixel rows and
+	// columns work. With 3 channels the alpha must come back as 255. Truncating the data anywhere before the last op
+	// must make the load fail.
+	const int sizes[][2] = { { 1, 1 }, { 1, 37 }, { 63, 1 }, { 67, 45 }, { 256, 256 } };
+	uint32 seed = 1;
+	file = dir + "RoundTrip.qoi";
+	for (int s = 0; s < tNumElements(sizes); s++)
+	{
+		int width = sizes[s][0];
+		int height = sizes[s][1];
+		tPixel* pixels = tPicture::AllocPixels(width*height);
+		for (int pattern = 0; pattern < NumPatterns; pattern++)
+		{
+			MakePatternPixels(pixels, width, height, pattern, seed);
+			for (int channels = 3; channels <= 4; channels++)
+			{
+				tFileQOI::tFormat format = (channels == 3) ? tFileQOI::tFormat::Bit24 : tFileQOI::tFormat::Bit32;
+				const char* problem = nullptr;
+				if (tFileQOI::Save(file, tPictureView(pixels, width, height), format) != format)
+					problem = "Save failed.";
+
+				if (!problem)
+				{
+					loaded.Load(file);
+					if
+					(
+						!loaded.IsValid() || (loaded.GetWidth() != width) || (loaded.GetHeight() != height) ||
+						(loaded.SrcFileBitDepth != channels*8)
+					)
+						problem = "Load failed.";
+					else if (CountDifferences(loaded.GetPixels(), pixels, width*height, channels == 3))
+						problem = "Pixels changed.";
+				}
+
+				if (!problem)
+				{
+					uint8* data = tSystem::tLoadFile(file, nullptr, &numBytes);
+					int opBytes = numBytes - HeaderBytes - EndMarkerBytes;
+					int cuts[] = { HeaderBytes - 1, HeaderBytes + opBytes/2, HeaderBytes + opBytes - 1 };
+					for (int c = 0; (c < tNumElements(cuts)) && !problem; c++)
+						if (loaded.Set(data, cuts[c]))
+							problem = "Truncated file loaded.";
+					delete[] data;
+				}
+
+				check(!problem, "%dx%d pattern %d with %d channels. %s", width, height, pattern, channels, problem);
+			}
+		}
+		tPicture::FreePixels(pixels);
+	}
+
+	return check.Report();
+}
+
+
+bool Test::QOIBench()
+{
+	Checks check("QOIBench");
+	tString dir = GetDataDir("QOI");
+
+	// The picture mixes all the patterns and has alpha, so every format keeps all four channels. Each save and load is
+	// timed a few times and the best kept.
+	const int benchW = 2048;
+	const int benchH = 2048;
+	uint32 seed = 1;
+	tPicture source;
+	source.Set(benchW, benchH);
+	MakePatternPixels(source.GetPixelPointer(), benchW, benchH, NumPatterns-1, seed);
+
+	const char* names[] = { "qoi", "png", "tga", "tga rle" };
+	const char* files[] = { "Bench.qoi", "Bench.png", "Bench.tga", "BenchRLE.tga" };
+	const int numRepeats = 3;
+	for (int f = 0; f < tNumElements(files); f++)
+	{
+		tString file = dir + files[f];
+		double saveTime = 0.0;
+		double loadTime = 0.0;
+		bool same = true;
+		for (int r = 0; r < numRepeats; r++)
+		{
+			double start = tSystem::tGetTimeDouble();
+			bool saveOk = false;
+			switch (f)
+			{
+				case 0:	saveOk = source.SaveQOI(file);															break;
+				case 1:	saveOk = source.SavePNG(file);															break;
+				case 2:	saveOk = source.SaveTGA(file, tFileTGA::tFormat::Auto, tFileTGA::tCompression::None);	break;
+				case 3:	saveOk = source.SaveTGA(file, tFileTGA::tFormat::Auto, tFileTGA::tCompression::RLE);	break;
+			}
+			double time = tSystem::tGetTimeDouble() - start;
+			saveTime = (r == 0) ? time : tMath::tMin(saveTime, time);
+
+			start = tSystem::tGetTimeDouble();
+			tPicture picture;
+			bool loadOk = picture.Load(file);
+			time = tSystem::tGetTimeDouble() - start;
+			loadTime = (r == 0) ? time : tMath::tMin(loadTime, time);
+
+			if
+			(
+				!saveOk || !loadOk || (picture.GetWidth() != benchW) || (picture.GetHeight() != benchH) ||
+				CountDifferences(picture.GetPixels(), source.GetPixels(), benchW*benchH)
+			)
+				same = false;
+		}
+
+		tPrintf
+		(
+			"%-8s Save %7.1f ms  Load %7.1f ms  Size %6.2f MB\n", names[f], saveTime*1000.0, loadTime*1000.0,
+			double(tSystem::tGetFileSize(file))/(1024.0*1024.0)
+		);
+		check(same, "The %s file did not save and load back unchanged", names[f]);
+	}
+
+	return check.Report();
+}
@@ -0,0 +1,157 @@
+// SequenceTest.cpp
+//
+// Writes a thousand synthetic 720p png frames, plays them once through without a window, and prints the sustained
+// decode throughput. The first pass shows frames as fast as they decode and must show every one in order. The second
+// plays at 60 fps and must show or drop each frame exactly once. The frames are deleted afterwards.
+//
+// Copyright (c) 2020 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <Math/tFundamentals.h>
+#include <System/tFile.h>
+#include <System/tTime.h>
+#include <System/tPrint.h>
+#include "SequencePlayer.h"
+#include "Fixtures.h"
+#include "Tests.h"
+using namespace tImage;
+
+
+namespace
+{
+	const int NumFrames = 1000;
+	const int FrameWidth = 1280;
+	const int FrameHeight = 720;
+	const float TargetFPS = 60.0f;
+}
+
+
+bool Test::SequenceBench()
+{
+	Checks check("SequenceBench");
+	tString dir = GetDataDir("SequenceBench");
+
+	// Each frame is a gradient with a band that moves from frame to frame and a little noise, so the png filters and
+	// deflate have about as much work as they would with a render. The blue channel away from the band holds the
+	// frame number so a shown frame can be matched to its file.
+	tPrintf("Writing %d %dx%d frames to %s\n", NumFrames, FrameWidth, FrameHeight, dir.Chars());
+	tArray<tString> files;
+	double writeStart = tSystem::tGetTimeDouble();
+	bool written = true;
+	uint32 seed = 1;
+	for (int f = 0; (f < NumFrames) && written; f++)
+	{
+		tPixel* pixels = tPicture::AllocPixels(FrameWidth*FrameHeight);
+		int bandX = (f * 7) % FrameWidth;
+		for (int y = 0; y < FrameHeight; y++)
+		{
+			for (int x = 0; x < FrameWidth; x++)
+			{
+				uint8 noise = uint8(Random(seed) >> 21);
+				bool band = (tMath::tAbs(x - bandX) < 16);
+				pixels[y*FrameWidth + x] = tColouri
+				(
+					uint8((x*255)/FrameWidth) + noise, uint8((y*255)/FrameHeight) + noise,
+					band ? 255 : uint8(f), 255
+				);
+			}
+		}
+
+		tPicture picture(FrameWidth, FrameHeight, pixels, false);
+		tString file;
+		tsPrintf(file, "%sFrame_%04d.png", dir.Chars(), f);
+		written = picture.SavePNG(file, tFilePNG::tFormat::Auto, tFilePNG::tLevel::Fast);
+		files.Append(file);
+	}
+	if (written)
+		tPrintf("Wrote frames in %.2fs\n", tSystem::tGetTimeDouble() - writeStart);
+	check(written, "Could not write %s", files[files.GetNumElements()-1].Chars());
+
+	// The first pass shows every frame as soon as it is decoded, which is the sustained throughput. The second plays
+	// at the target rate and drops frames that aren't ready in time.
+	for (int pass = 0; (pass < 2) && written; pass++)
+	{
+		float passFPS = pass ? TargetFPS : 0.0f;
+		SequencePlayer player;
+		if (!check(player.Start(files, 0, passFPS, 32, 0, false), "Pass %d did not start.", pass))
+			break;
+
+		player.Play();
+		double start = tSystem::tGetTimeDouble();
+		tPicture frame;
+		int index = 0;
+		int lastIndex = -1;
+		bool inOrder = true;
+		bool rightFrame = true;
+		float minAchieved = -1.0f;
+		while (!player.IsFinished())
+		{
+			while (player.Update(frame, index))
+			{
+				// The pixel at the far end of the band is always outside it.
+				int farX = ((index * 7) % FrameWidth < FrameWidth/2) ? FrameWidth-1 : 0;
+				inOrder = inOrder && (index > lastIndex);
+				rightFrame = rightFrame && frame.IsValid() && (frame.GetPixel(farX, 0).B == uint8(index));
+				lastIndex = index;
+			}
+			tSystem::tSleep(1);
+
+			// The lowest rate seen over any second once the first second is up.
+			if (tSystem::tGetTimeDouble() - start > 1.0)
+			{
+				float achieved = player.GetStats().AchievedFPS;
+				if ((minAchieved < 0.0f) || (achieved < minAchieved))
+					minAchieved = achieved;
+			}
+		}
+
+		double seconds = tSystem::tGetTimeDouble() - start;
+		SequencePlayer::Stats stats = player.GetStats();
+		if (pass == 0)
+			tPrintf("Unthrottled: ");
+		else
+			tPrintf("At %.1f fps: ", TargetFPS);
+		tPrintf
+		(
+			"%d shown, %d dropped in %.2fs. %.1f fps average",
+			stats.NumShown, stats.NumDropped, seconds, double(stats.NumShown) / seconds
+		);
+		if (minAchieved >= 0.0f)
+			tPrintf(", %.1f fps lowest", minAchieved);
+		tPrintf
+		(
+			". %d threads decode %.1f fps, %.1fms a frame each.",
+			stats.NumThreads, stats.DecodeFPS, stats.DecodeTime*1000.0f
+		);
+		if (pass == 1)
+			tPrintf(" Headroom %.2fx.", stats.Headroom);
+		tPrintf("\n");
+
+		check(inOrder, "Pass %d showed frames out of order.", pass);
+		check(rightFrame, "Pass %d showed the wrong pixels for a frame.", pass);
+		if (pass == 0)
+			check
+			(
+				(stats.NumShown == NumFrames) && !stats.NumDropped,
+				"Unthrottled playback showed %d and dropped %d.", stats.NumShown, stats.NumDropped
+			);
+		else
+			check
+			(
+				stats.NumShown + stats.NumDropped == NumFrames,
+				"Playback at %.1f fps showed %d and dropped %d.", TargetFPS, stats.NumShown, stats.NumDropped
+			);
+	}
+
+	for (int f = 0; f < files.GetNumElements(); f++)
+		tSystem::tDeleteFile(files[f]);
+
+	return check.Report();
+}
@@ -0,0 +1,328 @@
+// SingleInstanceTest.cpp
+//
+// Listens on a private endpoint in this process and hands files off to it. Checks that file lists arrive intact, that
+// bad messages are rejected, and that a launch gives up in time on a listener that has hung, then times a thousand
+// round trips.
+//
+// Copyright (c) 2020 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <Math/tFundamentals.h>
+#include <System/tTime.h>
+#include <System/tPrint.h>
+#ifdef PLATFORM_WIN
+#include <Windows.h>
+#else
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <errno.h>
+#endif
+#include "SingleInstance.h"
+#include "Fixtures.h"
+#include "Tests.h"
+
+
+namespace
+{
+	const int NumHandoffs = 1000;
+
+	// Twice the second the listener gives a sender that has connected.
+	const int StalledTimeoutMS = 2000;
+
+	// A launch facing a hung listener should give up this long after it started, give or take scheduling.
+	const int HungTimeoutMS = 300;
+	const double HungSlack = 0.5;
+
+	// Waits a little for a request. The request is queued before the sender hears back, so it is normally already
+	// there.
+	SingleInstance::Request* WaitForRequest(SingleInstance& listener)
+	{
+		for (int wait = 0; wait < 100; wait++)
+		{
+			SingleInstance::Request* request = listener.Receive();
+			if (request)
+				return request;
+			tSystem::tSleep(10);
+		}
+		return nullptr;
+	}
+
+	bool SameFiles(const tList<tStringItem>& a, const tList<tStringItem>& b)
+	{
+		if (a.Count() != b.Count())
+			return false;
+		for (tStringItem* x = a.First(), *y = b.First(); x && y; x = x->Next(), y = y->Next())
+			if (*x != *y)
+				return false;
+		return true;
+	}
+
+	// Hands off to a listener that never answers. Returns true if the handoff failed within HungTimeoutMS.
+	bool GivesUpInTime(const tString& name, const tList<tStringItem>& files, double& seconds)
+	{
+		double start = SingleInstance::GetClock();
+		bool handed = SingleInstance::Handoff(name, files, start, HungTimeoutMS);
+		seconds = SingleInstance::GetClock() - start;
+		return !handed && (seconds < double(HungTimeoutMS)/1000.0 + HungSlack);
+	}
+
+	#ifndef PLATFORM_WIN
+	int MakeSocket(const tString& path, sockaddr_un& addr)
+	{
+		tStd::tMemset(&addr, 0, sizeof(addr));
+		addr.sun_family = AF_UNIX;
+		tStd::tStrcpy(addr.sun_path, path.Chars());
+		return socket(AF_UNIX, SOCK_STREAM, 0);
+	}
+	#endif
+}
+
+
+bool Test::InstanceHandoff()
+{
+	Checks check("InstanceHandoff");
+
+	// A name of its own so a viewer that happens to be running isn't disturbed.
+	tString name;
+	tsPrintf(name, "TacitViewerTest-%d", int(tSystem::tGetHardwareTimerCount() % 100000));
+	tString endpoint = SingleInstance::GetEndpoint(name);
+
+	tList<tStringItem> one;
+	one.Append(new tStringItem("C:/Images/Photo.jpg"));
+
+	tList<tStringItem> several;
+	several.Append(new tStringItem("/home/someone/My Pictures/first one.png"));
+	several.Append(new tStringItem("D:\\Art\\Sprites\\hero_walk_0001.tga"));
+	several.Append(new tStringItem("/Users/someone/Bilder/Schlo\xC3\x9F Sch\xC3\xB6nbrunn \xE2\x80\x93 Winter.webp"));
+
+	tList<tStringItem> many;
+	for (int f = 0; f < 2000; f++)
+	{
+		tString file;
+		tsPrintf(file, "/render/output/shot_%04d/beauty_pass_with_a_fairly_long_name.%04d.exr", f % 50, f);
+		many.Append(new tStringItem(file));
+	}
+
+	tList<tStringItem> none;
+
+	check(!SingleInstance::Handoff(name, one, 0.0, 200), "Handoff with no listener succeeded.");
+
+	SingleInstance listener;
+	check(listener.Listen(name), "Listen failed.");
+	SingleInstance second;
+	check(!second.Listen(name), "A second listener on the same name succeeded.");
+	check(listener.IsListening(), "The first listener stopped listening.");
+
+	#ifndef PLATFORM_WIN
+	tString socketDir = endpoint.Prefix(endpoint.FindChar('/', true));
+	struct stat info;
+	bool privateDir = (lstat(socketDir.Chars(), &info) == 0) && S_ISDIR(info.st_mode) && (info.st_uid == getuid());
+	check(privateDir && !(info.st_mode & (S_IRWXG | S_IRWXO)), "The socket directory is not private.");
+
+	// A socket in a directory others can enter is refused before connecting. If it weren't, the send would connect to
+	// this listener, which never replies, and only fail once the timeout was up.
+	tString openDir;
+	tsPrintf(openDir, "/tmp/%s-open", name.Chars());
+	mkdir(openDir.Chars(), S_IRWXU);
+	chmod(openDir.Chars(), S_IRWXU | S_IRGRP | S_IXGRP | S_IROTH | S_IXOTH);
+	sockaddr_un openAddr;
+	int openSocket = MakeSocket(openDir + "/Test.sock", openAddr);
+	bool openListening =
+		(bind(openSocket, (sockaddr*)&openAddr, sizeof(openAddr)) == 0) && (listen(openSocket, 8) == 0);
+	uint8 openReply = 0;
+	double openStart = SingleInstance::GetClock();
+	bool openSent = SingleInstance::Send(openDir + "/Test.sock", (const uint8*)"x", 1, StalledTimeoutMS, openReply);
+	double openSeconds = SingleInstance::GetClock() - openStart;
+	check(openListening && !openSent && (openSeconds < 1.0), "A directory others can enter was not refused.");
+	close(openSocket);
+	unlink(openAddr.sun_path);
+	rmdir(openDir.Chars());
+	#endif
+
+	tList<tStringItem>* lists[] = { &one, &several, &many, &none };
+	const char* listNames[] = { "One file", "Several files", "2000 files", "An empty list" };
+	for (int l = 0; l < 4; l++)
+	{
+		double launchTime = 100.0 + double(l);
+		bool handed = SingleInstance::Handoff(name, *lists[l], launchTime);
+		SingleInstance::Request* request = handed ? WaitForRequest(listener) : nullptr;
+		check
+		(
+			handed && request && SameFiles(request->Files, *lists[l]) && (request->LaunchTime == launchTime),
+			"%s did not arrive intact.", listNames[l]
+		);
+		delete request;
+	}
+
+	// Bad messages. Each is checked by Decode directly and over the connection, where it must get RejectReply.
+	int goodBytes = 0;
+	uint8* good = SingleInstance::Encode(goodBytes, several, 1.0);
+	const int headerBytes = SingleInstance::HeaderBytes;
+	struct Corrupt { const char* What; int Offset; uint8 Value; };
+	Corrupt corrupts[] =
+	{
+		{ "Wrong magic",			0,				'X' },
+		{ "Wrong payload size",		4,				uint8(goodBytes - headerBytes - 1) },
+		{ "Unterminated path",		goodBytes-1,	'x' },
+		{ "Empty path",				headerBytes,	'\0' }
+	};
+	for (const Corrupt& corrupt : corrupts)
+	{
+		uint8* bad = new uint8[goodBytes];
+		tStd::tMemcpy(bad, good, goodBytes);
+		bad[corrupt.Offset] = corrupt.Value;
+
+		SingleInstance::Request decoded;
+		bool decodeRejected = !SingleInstance::Decode(decoded, bad, goodBytes);
+		uint8 reply = SingleInstance::AcceptReply;
+		bool sent = SingleInstance::Send(endpoint, bad, goodBytes, 1000, reply);
+		check
+		(
+			decodeRejected && sent && (reply == SingleInstance::RejectReply),
+			"%s was not rejected.", corrupt.What
+		);
+		delete[] bad;
+	}
+
+	// A payload over the limit is rejected from the header alone, without the listener reading or allocating it.
+	uint8 oversize[SingleInstance::HeaderBytes];
+	tStd::tMemcpy(oversize, good, headerBytes);
+	uint32 hugeSize = SingleInstance::MaxPayloadBytes + 1;
+	tStd::tMemcpy(oversize+4, &hugeSize, 4);
+	uint8 reply = SingleInstance::AcceptReply;
+	bool oversizeSent = SingleInstance::Send(endpoint, oversize, headerBytes, 1000, reply);
+	check(oversizeSent && (reply == SingleInstance::RejectReply), "Oversize payload was not rejected.");
+
+	// A sender that stops halfway only holds the listener up for its serve timeout.
+	reply = SingleInstance::AcceptReply;
+	check(!SingleInstance::Send(endpoint, good, 6, StalledTimeoutMS, reply), "Truncated header got a reply.");
+	delete[] good;
+
+	SingleInstance::Request* leftover = listener.Receive();
+	check(!leftover, "A bad message was queued.");
+	delete leftover;
+
+	bool handedAfter = SingleInstance::Handoff(name, one, 1.0);
+	SingleInstance::Request* after = handedAfter ? WaitForRequest(listener) : nullptr;
+	check(handedAfter && after, "Handoff failed after bad messages.");
+	delete after;
+
+	// Round trip timing. A handoff returns once the listener has queued the files, so this is how long a second launch
+	// takes to get its files to the running viewer, not counting process startup.
+	double total = 0.0;
+	double fastest = 1.0e9;
+	double slowest = 0.0;
+	int numTimed = 0;
+	for (int h = 0; h < NumHandoffs; h++)
+	{
+		double start = SingleInstance::GetClock();
+		bool handed = SingleInstance::Handoff(name, several, start);
+		double elapsed = SingleInstance::GetClock() - start;
+		SingleInstance::Request* request = listener.Receive();
+		if (!handed || !request)
+		{
+			delete request;
+			continue;
+		}
+		delete request;
+
+		total += elapsed;
+		fastest = tMath::tMin(fastest, elapsed);
+		slowest = tMath::tMax(slowest, elapsed);
+		numTimed++;
+	}
+	check(numTimed == NumHandoffs, "%d of %d timed handoffs were accepted.", numTimed, NumHandoffs);
+	if (numTimed > 0)
+		tPrintf
+		(
+			"%d handoffs. Average %.3fms  Fastest %.3fms  Slowest %.3fms\n",
+			numTimed, 1000.0*total/double(numTimed), 1000.0*fastest, 1000.0*slowest
+		);
+
+	listener.Stop();
+	check(!listener.IsListening(), "Stop did not stop listening.");
+	check(!SingleInstance::Handoff(name, one, 0.0, 200), "Handoff after Stop succeeded.");
+	check(second.Listen(name), "Another listener could not take over after Stop.");
+	second.Stop();
+
+	// A viewer that has hung holds its endpoint but never serves it. The first launch gets connected and hears nothing
+	// back. Later ones find the endpoint full, which is a pipe that stays busy on Windows and a backlog that fills up
+	// elsewhere. Each must give up within its timeout so it can open a window of its own.
+	double seconds = 0.0;
+	#ifdef PLATFORM_WIN
+	HANDLE hung = CreateNamedPipeA
+	(
+		endpoint.Chars(), PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED,
+		PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS, 1, 4096, 4096, 0, nullptr
+	);
+	bool hungListening = (hung != INVALID_HANDLE_VALUE);
+	HANDLE queued[1] = { INVALID_HANDLE_VALUE };
+	int numQueued = 0;
+	#else
+	sockaddr_un hungAddr;
+	int hung = MakeSocket(endpoint, hungAddr);
+	bool hungListening = (bind(hung, (sockaddr*)&hungAddr, sizeof(hungAddr)) == 0) && (listen(hung, 0) == 0);
+	int queued[64];
+	int numQueued = 0;
+	#endif
+	check(hungListening, "Could not make a hung listener.");
+
+	bool gaveUp = hungListening && GivesUpInTime(name, one, seconds);
+	check(gaveUp, "Handoff to a listener that never replies took %.3fs.", seconds);
+
+	#ifdef PLATFORM_WIN
+	// The only instance of the pipe is taken, so the next launch finds it busy.
+	queued[numQueued] = CreateFileA
+	(
+		endpoint.Chars(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, FILE_FLAG_OVERLAPPED, nullptr
+	);
+	if (queued[numQueued] != INVALID_HANDLE_VALUE)
+		numQueued++;
+	#else
+	// Connections that are never accepted wait in the backlog until it is full.
+	for (; hungListening && (numQueued < 64); numQueued++)
+	{
+		sockaddr_un addr;
+		queued[numQueued] = MakeSocket(endpoint, addr);
+		fcntl(queued[numQueued], F_SETFL, fcntl(queued[numQueued], F_GETFL) | O_NONBLOCK);
+		if ((connect(queued[numQueued], (sockaddr*)&addr, sizeof(addr)) != 0) && (errno != EINPROGRESS))
+		{
+			close(queued[numQueued]);
+			break;
+		}
+	}
+	#endif
+
+	gaveUp = hungListening && GivesUpInTime(name, one, seconds);
+	check(gaveUp, "Handoff to a listener that is full took %.3fs.", seconds);
+
+	#ifdef PLATFORM_WIN
+	for (int q = 0; q < numQueued; q++)
+		CloseHandle(queued[q]);
+	if (hungListening)
+		CloseHandle(hung);
+	#else
+	for (int q = 0; q < numQueued; q++)
+		close(queued[q]);
+	close(hung);
+	unlink(endpoint.Chars());
+
+	// The directory is only removed if we made it. A runtime dir belongs to the system.
+	const char* runtimeDir = getenv("XDG_RUNTIME_DIR");
+	if (!runtimeDir || (runtimeDir[0] != '/'))
+		rmdir(socketDir.Chars());
+	#endif
+
+	return check.Report();
+}
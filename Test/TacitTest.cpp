@@ -0,0 +1,126 @@
+// TacitTest.cpp
+//
+// Runs the tests and benchmarks for the viewer and the Tacent Image module. With no options every test runs. Tests can
+// be picked by name with -r, and -b adds the benchmarks, which take longer and print timings. The exit code is the
+// number of tests that failed.
+//
+// Copyright (c) 2020 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <Foundation/tStandard.h>
+#include <System/tCommand.h>
+#include <System/tPrint.h>
+#include <System/tTime.h>
+#include "Tests.h"
+
+
+namespace TacitTest
+{
+	tCommand::tOption RunOption("Only run the named test or benchmark. May be given more than once.", "run", 'r', 1);
+	tCommand::tOption BenchOption("Run the benchmarks as well as the tests.", "bench", 'b');
+	tCommand::tOption ListOption("List the tests and benchmarks and exit.", "list", 'l');
+
+	struct Entry
+	{
+		const char* Name;
+		bool (*Run)();
+		bool IsBenchmark;
+	};
+
+	const Entry Entries[] =
+	{
+		{ "TiledPicture",		Test::TiledPicture,			false	},
+		{ "QOI",				Test::QOI,					false	},
+		{ "QOIBench",			Test::QOIBench,				true	},
+		{ "DDS",				Test::DDS,					false	},
+		{ "CubemapConvert",		Test::CubemapConvert,		false	},
+		{ "AtlasBench",			Test::AtlasBench,			true	},
+		{ "PixelConvert",		Test::PixelConvert,			false	},
+		{ "SequenceBench",		Test::SequenceBench,		true	},
+		{ "ExportSetBench",		Test::ExportSetBench,		true	},
+		{ "InstanceHandoff",	Test::InstanceHandoff,		false	},
+		{ "FrameSourceBench",	Test::FrameSourceBench,		true	},
+		{ "BlockCompressBench",	Test::BlockCompressBench,	true	},
+		{ "PictureStats",		Test::PictureStats,			false	},
+		{ "PictureCompare",		Test::PictureCompare,		false	},
+		{ "PerceptualHash",		Test::PerceptualHash,		false	},
+		{ "PictureView",		Test::PictureView,			false	},
+		{ "PNG",				Test::PNG,					false	},
+		{ "PNGBench",			Test::PNGBench,				true	},
+		{ "TextureChain",		Test::TextureChain,			false	},
+		{ "TextureChainBench",	Test::TextureChainBench,	true	},
+		{ "ImageProbe",			Test::ImageProbe,			false	},
+		{ "ImageProbeBench",	Test::ImageProbeBench,		true	},
+		{ "Catalog",			Test::Catalog,				false	},
+		{ "CatalogBench",		Test::CatalogBench,			true	},
+		{ "DDSThumbnail",		Test::DDSThumbnail,			false	},
+		{ "DDSThumbnailBench",	Test::DDSThumbnailBench,	true	},
+		{ "DecodeCache",		Test::DecodeCache,			false	},
+		{ "DecodeCacheBench",	Test::DecodeCacheBench,		true	},
+		{ "Undo",				Test::Undo,					false	},
+		{ "BandPipeline",		Test::BandPipeline,			false	},
+		{ "BandPipelineBench",	Test::BandPipelineBench,	true	},
+		{ "JPG",				Test::JPG,					false	},
+		{ "JPGBench",			Test::JPGBench,				true	}
+	};
+	const int NumEntries = sizeof(Entries)/sizeof(Entries[0]);
+
+	bool IsSelected(const Entry&);
+}
+
+
+bool TacitTest::IsSelected(const Entry& entry)
+{
+	// Naming a benchmark runs it even without -b.
+	if (!RunOption)
+		return !entry.IsBenchmark || BenchOption;
+
+	for (tStringItem* name = RunOption.Args.First(); name; name = name->Next())
+		if (name->IsEqualCI(entry.Name))
+			return true;
+
+	return false;
+}
+
+
+int main(int argc, char** argv)
+{
+	tCommand::tParse(argc, argv);
+	if (TacitTest::ListOption)
+	{
+		for (int e = 0; e < TacitTest::NumEntries; e++)
+		{
+			const TacitTest::Entry& entry = TacitTest::Entries[e];
+			tPrintf("%s%s\n", entry.Name, entry.IsBenchmark ? " (benchmark)" : "");
+		}
+		return 0;
+	}
+
+	int numRun = 0;
+	int numFailed = 0;
+	for (int e = 0; e < TacitTest::NumEntries; e++)
+	{
+		const TacitTest::Entry& entry = TacitTest::Entries[e];
+		if (!TacitTest::IsSelected(entry))
+			continue;
+
+		tPrintf("Running %s\n", entry.Name);
+		double start = tSystem::tGetTimeDouble();
+		bool passed = entry.Run();
+		tPrintf("%s %s in %.1f s.\n\n", passed ? "Passed" : "FAILED", entry.Name, tSystem::tGetTimeDouble() - start);
+
+		numRun++;
+		if (!passed)
+			numFailed++;
+	}
+
+	tPrintf("%d of %d run failed.\n", numFailed, numRun);
+	return numFailed;
+}
@@ -0,0 +1,119 @@
+// Tests.h
+//
+// Entry points of the tests and benchmarks in the TacitTest executable. Each returns false if any of its checks fail.
+// Benchmarks print timings but only fail on wrong output, never on how long something took.
+//
+// Copyright (c) 2020 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#pragma once
+
+
+namespace Test
+{
+	// A synthetic 64k by 64k picture is panned and sampled at several levels within a fixed cache budget.
+	bool TiledPicture();
+
+	// Checks the qoi reader and writer against a file made by hand from the spec and round trips many kinds of picture.
+	bool QOI();
+
+	// Times saving and loading a large picture as qoi, png and tga.
+	bool QOIBench();
+
+	// Saves and loads dds textures and cubemaps in every format the writer supports, with and without flipping rows.
+	bool DDS();
+
+	// Converts analytic direction patterns between faces, panoramas and crosses and checks the error against them.
+	bool CubemapConvert();
+
+	// Times packing thousands of sprites with each atlas method and checks every placement.
+	bool AtlasBench();
+
+	// Converts between every pair of normal pixel formats and checks against an exact double precision conversion.
+	bool PixelConvert();
+
+	// Times decoding and playing a thousand png frames and checks every frame is shown or dropped once.
+	bool SequenceBench();
+
+	// Times an export set against resampling every target from full size and checks the outputs match closely.
+	bool ExportSetBench();
+
+	// Hands files to a listener in this process, rejects bad messages, gives up on a hung one and times round trips.
+	bool InstanceHandoff();
+
+	// Times playing and seeking a 2000 frame gif and checks every frame against a composite made without the decoder.
+	bool FrameSourceBench();
+
+	// Times block compression in every BC format next to Texture Tools and checks the error against it.
+	bool BlockCompressBench();
+
+	// Checks the histograms, moments, alpha counts and distinct colour estimate against an exact reference.
+	bool PictureStats();
+
+	// Checks MSE, PSNR, SSIM, the heat map and the size policies against an exact reference.
+	bool PictureCompare();
+
+	// Checks both hashes survive common edits, the index against brute force, and finding duplicate files.
+	bool PerceptualHash();
+
+	// Checks moving pictures hands over the pixels, buffers are aligned, and views match crops. Times both.
+	bool PictureView();
+
+	// Saves pngs at every level, on any number of threads and a row at a time, and checks they load back unchanged.
+	bool PNG();
+
+	// Times saving a large png at every level on one thread, on all of them and with the row writer.
+	bool PNGBench();
+
+	// Copies, saves and loads contiguous and separate mip chains and checks corrupt chain descriptors are rejected.
+	bool TextureChain();
+
+	// Times making, copying, saving and loading thousands of small mip chains stored contiguously and separately.
+	bool TextureChainBench();
+
+	// Probes files from the writers and hand made headers and checks them against what was written and a full load.
+	bool ImageProbe();
+
+	// Times probing a folder of files next to loading them fully and checks the probed sizes match.
+	bool ImageProbeBench();
+
+	// Saves and loads a metadata catalog and checks stale, pruned and corrupt entries and files are handled.
+	bool Catalog();
+
+	// Times reopening a catalog of fifty thousand files and looking each one up, next to building it.
+	bool CatalogBench();
+
+	// Checks dds thumbnails read the closest mipmap unchanged and look like thumbnails of the main image.
+	bool DDSThumbnail();
+
+	// Times dds thumbnails from the closest mipmap against decoding the main image.
+	bool DDSThumbnailBench();
+
+	// Saves and loads decoded pictures in the pixel cache and checks hits, keys, budget and eviction.
+	bool DecodeCache();
+
+	// Times a pixel cache hit and save next to decoding a big png.
+	bool DecodeCacheBench();
+
+	// Undoes and redoes a long run of lossy and lossless edits and checks the history stays under its budget.
+	bool Undo();
+
+	// Runs pictures and files through every band stage and sink and compares them with the whole picture.
+	bool BandPipeline();
+
+	// Times cropping and halving a big targa into a png with bands and with the whole picture.
+	bool BandPipelineBench();
+
+	// Transforms jpgs losslessly with every orientation and checks them against the decoded whole picture.
+	bool JPG();
+
+	// Times a lossless jpg rotation next to decoding, rotating and encoding again.
+	bool JPGBench();
+}
@@ -0,0 +1,318 @@
+// TextureChainTest.cpp
+//
+// Checks that contiguous mip chains copy, save and load back as the same layers they were made from, with every level
+// on the chain alignment, and that chunk loads reject corrupt chain descriptors. The benchmark copies, saves and loads
+// many small chains stored both ways and prints the times.
+//
+// Copyright (c) 2020 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <Foundation/tMemory.h>
+#include <Math/tFundamentals.h>
+#include <System/tChunk.h>
+#include <System/tTime.h>
+#include <System/tPrint.h>
+#include <Image/tTexture.h>
+#include "Fixtures.h"
+#include "Tests.h"
+using namespace tImage;
+
+
+namespace
+{
+	const int BufferAlignment = 512;
+	const int NumBenchChains = 16384;
+	const int BenchSize = 32;
+
+	// Makes a full mip chain down to 1x1 with random bytes in every layer. Every layer owns its data.
+	void MakeChain(tTexture& texture, tPixelFormat format, int width, int height, uint32& seed)
+	{
+		tList<tLayer> layers;
+		while (true)
+		{
+			tLayer* layer = new tLayer();
+			layer->PixelFormat = format;
+			layer->Width = width;
+			layer->Height = height;
+			int dataSize = layer->GetDataSize();
+			layer->Data = new uint8[dataSize];
+			for (int b = 0; b < dataSize; b++)
+				layer->Data[b] = uint8(Test::Random(seed));
+			layers.Append(layer);
+
+			if ((width == 1) && (height == 1))
+				break;
+			width = tMath::tMax(1, width/2);
+			height = tMath::tMax(1, height/2);
+		}
+		texture.Set(layers);
+	}
+
+	bool LevelsAligned(const tTexture& texture)
+	{
+		for (tLayer* layer = texture.GetLayers().First(); layer; layer = layer->Next())
+			if (uint64(layer->Data) % uint64(tTexture::ChainAlignment))
+				return false;
+		return true;
+	}
+
+	// A chunk buffer big enough for the textures, with room for the chunk headers and padding.
+	uint8* AllocChunkBuffer(int64 pixelBytes, int numTextures, int& bufferSize)
+	{
+		bufferSize = int(pixelBytes + int64(numTextures)*1024 + 4096);
+		return (uint8*)tMem::tMalloc(bufferSize, BufferAlignment);
+	}
+
+	// Saves the textures to the buffer and returns the number of bytes written.
+	int SaveTextures(uint8* buffer, int bufferSize, const tTexture* textures, int numTextures)
+	{
+		tChunkWriter writer(buffer, bufferSize);
+		for (int t = 0; t < numTextures; t++)
+			textures[t].Save(writer);
+		return writer.GetNumBytesWritten();
+	}
+
+	// Loads every texture chunk in the buffer and returns how many were read.
+	int LoadTextures(uint8* buffer, int numBytes, tTexture* textures, int maxTextures)
+	{
+		tChunkReader reader(buffer, numBytes);
+		int numLoaded = 0;
+		for (tChunk chunk = reader.First(); chunk.IsValid() && (numLoaded < maxTextures); chunk = chunk.Next())
+			textures[numLoaded++].Load(chunk);
+		return numLoaded;
+	}
+
+	struct ChainDesc
+	{
+		tPixelFormat Format;
+		int Width, Height, Offset;
+	};
+
+	// Writes a contiguous texture chunk by hand so the descriptors can be anything. The layer count written may differ
+	// from the number of descriptors. The data is dataSize zero bytes. Returns the number of bytes written.
+	int WriteChain(uint8* buffer, int bufferSize, int numLayers, const ChainDesc* descs, int numDescs, int dataSize)
+	{
+		uint8* data = new uint8[dataSize];
+		tStd::tMemset(data, 0, dataSize);
+		tChunkWriter writer(buffer, bufferSize);
+		writer.Begin(tChunkID::Image_Texture);
+		{
+			writer.Begin(tChunkID::Image_TextureChain);
+			{
+				writer.Begin(tChunkID::Image_TextureChainProperties);
+				{
+					writer.Write(numLayers);
+					for (int d = 0; d < numDescs; d++)
+					{
+						writer.Write(descs[d].Format);
+						writer.Write(descs[d].Width);
+						writer.Write(descs[d].Height);
+						writer.Write(descs[d].Offset);
+					}
+				}
+				writer.End();
+
+				writer.Begin(tChunkID::Image_TextureChainData, tChunkWriter::Alignment::B16);
+				{
+					writer.Write(data, dataSize);
+				}
+				writer.End();
+			}
+			writer.End();
+		}
+		writer.End();
+		delete[] data;
+		return writer.GetNumBytesWritten();
+	}
+
+	// Returns true if the hand written chain loads as a valid texture.
+	bool ChainLoads(uint8* buffer, int bufferSize, int numLayers, const ChainDesc* descs, int numDescs, int dataSize)
+	{
+		int numBytes = WriteChain(buffer, bufferSize, numLayers, descs, numDescs, dataSize);
+		tTexture texture;
+		return (LoadTextures(buffer, numBytes, &texture, 1) == 1) && texture.IsValid();
+	}
+}
+
+
+bool Test::TextureChain()
+{
+	Checks check("TextureChain");
+	uint32 seed = 1;
+
+	// A block format chain, an odd sized 4 byte chain whose levels need padding, and a 16 byte float chain.
+	struct { tPixelFormat Format; int Width, Height; } kinds[] =
+	{
+		{ tPixelFormat::BC1_DXT1, 256, 128 },
+		{ tPixelFormat::R8G8B8A8, 37, 19 },
+		{ tPixelFormat::A32B32G32R32F, 9, 16 }
+	};
+
+	int bufferSize = 0;
+	uint8* buffer = AllocChunkBuffer(1024*1024, 4, bufferSize);
+	for (int k = 0; k < tNumElements(kinds); k++)
+	{
+		tTexture separate;
+		MakeChain(separate, kinds[k].Format, kinds[k].Width, kinds[k].Height, seed);
+		int numLayers = separate.GetNumLayers();
+		int dataSize = separate.GetTotalPixelDataSize();
+
+		tTexture contiguous;
+		contiguous.Set(separate);
+		check(!contiguous.IsContiguous() && (contiguous == separate), "Kind %d: a separate copy differs.", k);
+		contiguous.MakeContiguous();
+		check
+		(
+			contiguous.IsContiguous() && (contiguous == separate) && (contiguous.GetNumLayers() == numLayers),
+			"Kind %d: making the chain contiguous changed it.", k
+		);
+		check(LevelsAligned(contiguous), "Kind %d: a level is not on the chain alignment.", k);
+		check
+		(
+			(contiguous.GetChainDataSize() >= dataSize) &&
+			(contiguous.GetChainDataSize() < dataSize + numLayers*tTexture::ChainAlignment),
+			"Kind %d: the chain is %d bytes for %d bytes of layers.", k, int(contiguous.GetChainDataSize()), dataSize
+		);
+
+		tTexture copy;
+		copy.Set(contiguous);
+		check
+		(
+			copy.IsContiguous() && (copy == separate) && LevelsAligned(copy) &&
+			(copy.GetLayers().First()->Data != contiguous.GetLayers().First()->Data),
+			"Kind %d: a contiguous copy differs or shares the data.", k
+		);
+
+		// Each way of storing the chain loads back the same way.
+		tTexture textures[2];
+		textures[0].Set(separate);
+		textures[1].Set(contiguous);
+		tTexture loaded[2];
+		int numBytes = SaveTextures(buffer, bufferSize, textures, 2);
+		bool loadedBoth = LoadTextures(buffer, numBytes, loaded, 2) == 2;
+		check
+		(
+			loadedBoth && !loaded[0].IsContiguous() && (loaded[0] == separate),
+			"Kind %d: a separate chain did not load back unchanged.", k
+		);
+		check
+		(
+			loadedBoth && loaded[1].IsContiguous() && (loaded[1] == separate) && LevelsAligned(loaded[1]) &&
+			(loaded[1].GetChainDataSize() == contiguous.GetChainDataSize()),
+			"Kind %d: a contiguous chain did not load back unchanged.", k
+		);
+
+		contiguous.MakeSeparate();
+		check(!contiguous.IsContiguous() && (contiguous == separate), "Kind %d: making it separate changed it.", k);
+	}
+
+	// A good hand written chain of an 8x8 and a 4x4 BC1 level loads. Each corruption of it must not.
+	const int dataSize = 48;
+	ChainDesc good[2] = { { tPixelFormat::BC1_DXT1, 8, 8, 0 }, { tPixelFormat::BC1_DXT1, 4, 4, 32 } };
+	check(ChainLoads(buffer, bufferSize, 2, good, 2, dataSize), "A good hand written chain did not load.");
+
+	struct { const char* Name; int Layer; ChainDesc Desc; int NumLayers; } bad[] =
+	{
+		{ "an offset past the end",			1, { tPixelFormat::BC1_DXT1, 4, 4, 48 },				2 },
+		{ "a level running off the end",	1, { tPixelFormat::BC1_DXT1, 8, 8, 32 },				2 },
+		{ "a negative offset",				1, { tPixelFormat::BC1_DXT1, 4, 4, -8 },				2 },
+		{ "a zero width",					0, { tPixelFormat::BC1_DXT1, 0, 8, 0 },					2 },
+		{ "a negative height",				0, { tPixelFormat::BC1_DXT1, 8, -8, 0 },				2 },
+		{ "an invalid format",				0, { tPixelFormat::Invalid, 8, 8, 0 },					2 },
+		{ "a format past the last",			1, { tPixelFormat::NumPixelFormats, 4, 4, 32 },			2 },
+		{ "a size that overflows an int",	0, { tPixelFormat::A32B32G32R32F, 65536, 65536, 0 },	2 },
+		{ "a count past the descriptors",	0, { tPixelFormat::BC1_DXT1, 8, 8, 0 },					3 },
+		{ "a negative count",				0, { tPixelFormat::BC1_DXT1, 8, 8, 0 },					-1 }
+	};
+	for (int b = 0; b < tNumElements(bad); b++)
+	{
+		ChainDesc descs[2] = { good[0], good[1] };
+		descs[bad[b].Layer] = bad[b].Desc;
+		bool loads = ChainLoads(buffer, bufferSize, bad[b].NumLayers, descs, 2, dataSize);
+		check(!loads, "A chain with %s loaded.", bad[b].Name);
+	}
+
+	tMem::tFree(buffer);
+	return check.Report();
+}
+
+
+bool Test::TextureChainBench()
+{
+	Checks check("TextureChainBench");
+	uint32 seed = 1;
+
+	// Many small chains are where one allocation per level costs the most. Each is a full 32x32 BC1 chain.
+	tTexture* sources = new tTexture[NumBenchChains];
+	int64 pixelBytes = 0;
+	for (int t = 0; t < NumBenchChains; t++)
+	{
+		MakeChain(sources[t], tPixelFormat::BC1_DXT1, BenchSize, BenchSize, seed);
+		pixelBytes += sources[t].GetTotalPixelDataSize() + sources[t].GetNumLayers()*tTexture::ChainAlignment;
+	}
+	tPrintf("%d %dx%d BC1 chains of %d levels\n", NumBenchChains, BenchSize, BenchSize, sources[0].GetNumLayers());
+
+	int bufferSize = 0;
+	uint8* buffer = AllocChunkBuffer(pixelBytes, NumBenchChains, bufferSize);
+	tTexture* stored = new tTexture[NumBenchChains];
+	tTexture* copies = new tTexture[NumBenchChains];
+	const char* names[2] = { "Separate", "Contiguous" };
+	for (int pass = 0; pass < 2; pass++)
+	{
+		// Freeing what the last pass made isn't part of the timings.
+		for (int t = 0; t < NumBenchChains; t++)
+		{
+			stored[t].Clear();
+			copies[t].Clear();
+		}
+
+		double start = tSystem::tGetTimeDouble();
+		for (int t = 0; t < NumBenchChains; t++)
+		{
+			stored[t].Set(sources[t]);
+			if (pass)
+				stored[t].MakeContiguous();
+		}
+		double makeTime = tSystem::tGetTimeDouble() - start;
+
+		start = tSystem::tGetTimeDouble();
+		for (int t = 0; t < NumBenchChains; t++)
+			copies[t].Set(stored[t]);
+		double copyTime = tSystem::tGetTimeDouble() - start;
+		for (int t = 0; t < NumBenchChains; t++)
+			copies[t].Clear();
+
+		start = tSystem::tGetTimeDouble();
+		int numBytes = SaveTextures(buffer, bufferSize, stored, NumBenchChains);
+		double saveTime = tSystem::tGetTimeDouble() - start;
+
+		start = tSystem::tGetTimeDouble();
+		int numLoaded = LoadTextures(buffer, numBytes, copies, NumBenchChains);
+		double loadTime = tSystem::tGetTimeDouble() - start;
+
+		int numWrong = NumBenchChains - numLoaded;
+		for (int t = 0; t < numLoaded; t++)
+			if ((copies[t] != sources[t]) || (copies[t].IsContiguous() != (pass == 1)))
+				numWrong++;
+
+		tPrintf
+		(
+			"%-10s  Make %6.1f ms  Copy %6.1f ms  Save %6.1f ms  Load %6.1f ms\n",
+			names[pass], makeTime*1000.0, copyTime*1000.0, saveTime*1000.0, loadTime*1000.0
+		);
+		check(!numWrong, "%d %s chains did not load back unchanged.", numWrong, names[pass]);
+	}
+
+	delete[] copies;
+	delete[] stored;
+	delete[] sources;
+	tMem::tFree(buffer);
+	return check.Report();
+}
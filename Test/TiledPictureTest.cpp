@@ -0,0 +1,173 @@
+// TiledPictureTest.cpp
+//
+// Builds a synthetic 64k by 64k tTiledPicture whose pixels are computed from their coordinates, so nothing the size of
+// the image is ever allocated. A screen sized window is panned across level 0 and every tile it touches must be decoded
+// exactly once. Regions of levels 0 to 4 are then compared to pixels filtered directly from level 0, both with the
+// budget and with room for a single tile. The cache may never exceed its budget.
+//
+// Copyright (c) 2020 Tristan Grimmer.
+// Permission to use, copy, modify, and/or distribute this software for any purpose with or without fee is hereby
+// granted, provided that the above copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+// INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+// AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+// PERFORMANCE OF THIS SOFTWARE.
+
+#include <Math/tFundamentals.h>
+#include <System/tTime.h>
+#include <System/tPrint.h>
+#include <Image/tTiledPicture.h>
+#include "Fixtures.h"
+#include "Tests.h"
+using namespace tImage;
+
+
+namespace
+{
+	const int Size = 65536;
+	const int64 CacheBudget = 64*1024*1024;
+
+	// Computes a pixel of any level straight from the coordinate picture the same way the tiles are filtered, including
+	// the duplicated last row or column of odd sized levels. This costs 4^level coordinate pixels.
+	tPixel GetReferencePixel(const tTiledPicture& tiled, int level, int x, int y)
+	{
+		if (level == 0)
+			return Test::GetCoordPixel(x, y);
+
+		int x1 = tMath::tMin(2*x + 1, tiled.GetWidth(level-1) - 1);
+		int y1 = tMath::tMin(2*y + 1, tiled.GetHeight(level-1) - 1);
+		tPixel p00 = GetReferencePixel(tiled, level-1, 2*x, 2*y);
+		tPixel p10 = GetReferencePixel(tiled, level-1, x1, 2*y);
+		tPixel p01 = GetReferencePixel(tiled, level-1, 2*x, y1);
+		tPixel p11 = GetReferencePixel(tiled, level-1, x1, y1);
+
+		tPixel pixel;
+		for (int c = 0; c < 4; c++)
+			pixel.E[c] = uint8((p00.E[c] + p10.E[c] + p01.E[c] + p11.E[c] + 2) >> 2);
+
+		return pixel;
+	}
+
+	// Fetches a region of the level and compares every pixel to the reference. Returns the number that differ.
+	int CheckRegion(tTiledPicture& tiled, int level, int x, int y, int w, int h)
+	{
+		tPicture region;
+		if (!tiled.GetRegion(region, level, x, y, w, h) || (region.GetWidth() != w) || (region.GetHeight() != h))
+			return w*h;
+
+		int numBad = 0;
+		for (int row = 0; row < h; row++)
+			for (int col = 0; col < w; col++)
+				if (region.GetPixel(col, row) != GetReferencePixel(tiled, level, x + col, y + row))
+					numBad++;
+
+		return numBad;
+	}
+}
+
+
+bool Test::TiledPicture()
+{
+	Checks check("TiledPicture");
+	int64 numDecoded = 0;
+	auto provider = [&numDecoded](int x, int y, int w, int h, tPixel* dest, int destStride) -> bool
+	{
+		for (int row = 0; row < h; row++)
+			for (int col = 0; col < w; col++)
+				dest[row*destStride + col] = GetCoordPixel(x + col, y + row);
+
+		numDecoded += int64(w)*h;
+		return true;
+	};
+
+	// The levels checked below have to exist.
+	const int viewW = 1920;
+	const int viewH = 1080;
+	const int maxCheckLevel = 4;
+	tTiledPicture tiled;
+	bool made = tiled.Set(Size, Size, provider, CacheBudget) && (tiled.GetNumLevels() > maxCheckLevel);
+	if (!check(made, "Could not make a %d by %d tiled picture", Size, Size))
+		return check.Report();
+
+	// The window moves in steps that don't line up with the tiles. The tiles it is still over were all used by the
+	// last step, so as long as the budget holds two windows of tiles none of them are evicted and each tile is only
+	// decoded once. Every so often the whole window is checked.
+	const int step = 97;
+	const int tileSize = tTiledPicture::TileSize;
+	int viewY = Size/2 + 37;
+	int lastViewX = 0;
+	int numSteps = 0;
+	int numBadPixels = 0;
+	int numOverBudget = 0;
+	int64 peakCacheBytes = 0;
+	tPicture view;
+	double start = tSystem::tGetTimeDouble();
+	for (int viewX = 0; viewX + viewW <= Size; viewX += step, numSteps++)
+	{
+		tiled.GetRegion(view, 0, viewX, viewY, viewW, viewH);
+		peakCacheBytes = tMath::tMax(peakCacheBytes, tiled.GetCacheNumBytes());
+		if (tiled.GetCacheNumBytes() > tiled.GetCacheBudget())
+			numOverBudget++;
+		lastViewX = viewX;
+		if ((numSteps % 64) == 0)
+		{
+			for (int y = 0; y < viewH; y++)
+				for (int x = 0; x < viewW; x++)
+					if (view.GetPixel(x, y) != GetCoordPixel(viewX + x, viewY + y))
+						numBadPixels++;
+		}
+	}
+	double panTime = tSystem::tGetTimeDouble() - start;
+
+	int numTilesX = (lastViewX + viewW - 1)/tileSize + 1;
+	int numTilesY = (viewY + viewH - 1)/tileSize - viewY/tileSize + 1;
+	int numTilesTouched = numTilesX*numTilesY;
+	tPrintf
+	(
+		"Tiled %d by %d: Panned %d steps in %.1f ms. Decoded %d tiles for %d touched. %.1f Mpixels/s.\n",
+		Size, Size, numSteps, panTime*1000.0, tiled.GetNumProviderCalls(), numTilesTouched,
+		double(numDecoded)/(panTime*1000000.0)
+	);
+	check
+	(
+		tiled.GetNumProviderCalls() == numTilesTouched,
+		"Panning decoded %d tiles instead of %d", tiled.GetNumProviderCalls(), numTilesTouched
+	);
+	check(numBadPixels == 0, "Panning returned %d wrong pixels", numBadPixels);
+
+	// Regions straddle tile edges at every level checked. The second pass only lets one tile be cached, so every tile
+	// above level 0 is made while the tiles it is made from are evicted one after the other.
+	uint32 seed = 1;
+	const int regionW = 200;
+	const int regionH = 150;
+	for (int pass = 0; pass < 2; pass++)
+	{
+		tiled.SetCacheBudget((pass == 0) ? CacheBudget : tTiledPicture::TileNumBytes);
+		start = tSystem::tGetTimeDouble();
+		for (int level = 0; level <= maxCheckLevel; level++)
+		{
+			for (int r = 0; r < 2; r++)
+			{
+				int x = Random(seed, tiled.GetWidth(level) - regionW);
+				int y = Random(seed, tiled.GetHeight(level) - regionH);
+				int numBad = CheckRegion(tiled, level, x, y, regionW, regionH);
+				peakCacheBytes = tMath::tMax(peakCacheBytes, tiled.GetCacheNumBytes());
+				if (tiled.GetCacheNumBytes() > tiled.GetCacheBudget())
+					numOverBudget++;
+				check(numBad == 0, "Level %d region at (%d, %d) has %d wrong pixels", level, x, y, numBad);
+			}
+		}
+		tPrintf
+		(
+			"Tiled levels 0 to %d with a %d tile budget checked in %.1f ms.\n", maxCheckLevel,
+			int(tiled.GetCacheBudget() / tTiledPicture::TileNumBytes), (tSystem::tGetTimeDouble() - start)*1000.0
+		);
+	}
+
+	double megabyte = 1024.0*1024.0;
+	tPrintf("Peak cache %.1f MB of %.1f MB.\n", double(peakCacheBytes)/megabyte, double(CacheBudget)/megabyte);
+	check(numOverBudget == 0, "Cache was over its budget %d times", numOverBudget);
+	return check.Report();
+}